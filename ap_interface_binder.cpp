@@ -19,27 +19,61 @@
 #include <android-base/logging.h>
 
 #include "wificond/ap_interface_impl.h"
+#include "wificond/binder_call_dispatcher.h"
+#include "wificond/flight_recorder.h"
 
+using android::net::wifi::nl80211::BnApInterface;
+using android::net::wifi::nl80211::IApInterface;
 using android::net::wifi::nl80211::IApInterfaceEventCallback;
 using android::net::wifi::nl80211::NativeWifiClient;
+using android::net::wifi::nl80211::NativeWifiClientStats;
 
 namespace android {
 namespace wificond {
 
+namespace {
+
+// Only the latest channel switch matters to listeners.
+constexpr int32_t kChannelSwitchedCoalescingKey = 0;
+
+}  // namespace
+
 ApInterfaceBinder::ApInterfaceBinder(ApInterfaceImpl* impl)
-    : impl_{impl}, ap_interface_event_callback_(nullptr) {}
+    : impl_{impl},
+      callback_dispatcher_(nullptr),
+      ap_interface_event_callback_(nullptr) {}
 
 ApInterfaceBinder::~ApInterfaceBinder() {
 }
 
 void ApInterfaceBinder::NotifyConnectedClientsChanged(const NativeWifiClient client, bool isConnected) {
   if (ap_interface_event_callback_ != nullptr) {
-    ap_interface_event_callback_->onConnectedClientsChanged(client, isConnected);
+    sp<IApInterfaceEventCallback> callback = ap_interface_event_callback_;
+    CallbackDispatcher::Dispatch(
+        callback_dispatcher_, IInterface::asBinder(callback).get(),
+        CallbackDispatcher::kNoCoalescing, [callback, client, isConnected]() {
+          callback->onConnectedClientsChanged(client, isConnected);
+        });
+  }
+}
+
+void ApInterfaceBinder::NotifyConnectedClientsBatchChanged(
+    const std::vector<NativeWifiClient>& connected_clients,
+    const std::vector<NativeWifiClient>& disconnected_clients) {
+  if (ap_interface_event_callback_ != nullptr) {
+    sp<IApInterfaceEventCallback> callback = ap_interface_event_callback_;
+    CallbackDispatcher::Dispatch(
+        callback_dispatcher_, IInterface::asBinder(callback).get(),
+        CallbackDispatcher::kNoCoalescing,
+        [callback, connected_clients, disconnected_clients]() {
+          callback->onConnectedClientsBatchChanged(connected_clients,
+                                                   disconnected_clients);
+        });
   }
 }
 
 void ApInterfaceBinder::NotifySoftApChannelSwitched(
-    int frequency, ChannelBandwidth channel_bandwidth) {
+    int frequency, ChannelBandwidth channel_bandwidth, bool deferrable) {
   if (ap_interface_event_callback_ == nullptr) {
     return;
   }
@@ -70,7 +104,12 @@ void ApInterfaceBinder::NotifySoftApChannelSwitched(
     default:
       bandwidth = IApInterfaceEventCallback::BANDWIDTH_INVALID;
   }
-  ap_interface_event_callback_->onSoftApChannelSwitched(frequency, bandwidth);
+  sp<IApInterfaceEventCallback> callback = ap_interface_event_callback_;
+  CallbackDispatcher::Dispatch(
+      callback_dispatcher_, IInterface::asBinder(callback).get(),
+      kChannelSwitchedCoalescingKey, [callback, frequency, bandwidth]() {
+        callback->onSoftApChannelSwitched(frequency, bandwidth);
+      }, deferrable);
 }
 
 binder::Status ApInterfaceBinder::registerCallback(
@@ -85,5 +124,54 @@ binder::Status ApInterfaceBinder::getInterfaceName(std::string* out_name) {
   return binder::Status::ok();
 }
 
+binder::Status ApInterfaceBinder::getConnectedClientStats(
+    std::vector<NativeWifiClientStats>* out_client_stats) {
+  if (impl_ == nullptr) {
+    return binder::Status::ok();
+  }
+  impl_->GetConnectedClientStats(out_client_stats);
+  return binder::Status::ok();
+}
+
+binder::Status ApInterfaceBinder::setClientChangeCoalescingWindow(
+    int32_t window_ms, bool* out_success) {
+  *out_success = false;
+  if (impl_ == nullptr) {
+    LOG(WARNING) << "Cannot set coalescing window on dead ApInterface.";
+    return binder::Status::ok();
+  }
+  if (window_ms < 0 ||
+      window_ms > IApInterface::MAX_CLIENT_CHANGE_COALESCING_WINDOW_MS) {
+    LOG(ERROR) << "Invalid client change coalescing window: " << window_ms;
+    return binder::Status::ok();
+  }
+  impl_->SetClientChangeCoalescingWindow(window_ms);
+  *out_success = true;
+  return binder::Status::ok();
+}
+
+binder::Status ApInterfaceBinder::getRankedChannels(
+    std::vector<int32_t>* out_frequencies) {
+  if (impl_ == nullptr) {
+    LOG(WARNING) << "Cannot get ranked channels of dead ApInterface.";
+    return binder::Status::ok();
+  }
+  impl_->GetRankedChannels(out_frequencies);
+  return binder::Status::ok();
+}
+
+status_t ApInterfaceBinder::onTransact(uint32_t code,
+                                       const Parcel& data,
+                                       Parcel* reply,
+                                       uint32_t flags) {
+  // The interface name is the only state that does not change.
+  FlightRecorder::BinderCallScope call_record(FlightRecord::kApInterface, code);
+  status_t status = BinderCallDispatcher::DispatchTransaction(
+      [code]() { return code == TRANSACTION_getInterfaceName; },
+      [&]() { return BnApInterface::onTransact(code, data, reply, flags); });
+  call_record.SetResult(status);
+  return status;
+}
+
 }  // namespace wificond
 }  // namespace android
@@ -19,6 +19,7 @@
 
 #include <android-base/macros.h>
 
+#include "wificond/callback_dispatcher.h"
 #include "wificond/net/netlink_manager.h"
 
 #include "android/net/wifi/nl80211/BnApInterface.h"
@@ -42,20 +43,46 @@ class ApInterfaceBinder : public android::net::wifi::nl80211::BnApInterface {
   // by remote processes are possible.
   void NotifyImplDead() { impl_ = nullptr; }
 
+  // Calls the registered callback through |dispatcher| instead of on the
+  // event loop thread. |dispatcher| must outlive this binder.
+  void SetCallbackDispatcher(CallbackDispatcher* dispatcher) {
+    callback_dispatcher_ = dispatcher;
+  }
+
   // Called by |impl_| every time the access point's connected clients change.
   void NotifyConnectedClientsChanged(const NativeWifiClient client, bool isConnected);
 
+  // Called by |impl_| at the end of a window of coalesced station changes.
+  void NotifyConnectedClientsBatchChanged(
+      const std::vector<NativeWifiClient>& connected_clients,
+      const std::vector<NativeWifiClient>& disconnected_clients);
+
   // Called by |impl_| on every channel switch event.
+  // |deferrable| callbacks may be held back in low power mode.
   void NotifySoftApChannelSwitched(int frequency,
-                                   ChannelBandwidth channel_bandwidth);
+                                   ChannelBandwidth channel_bandwidth,
+                                   bool deferrable = false);
 
   binder::Status registerCallback(
       const sp<IApInterfaceEventCallback>& callback,
       bool* out_success) override;
   binder::Status getInterfaceName(std::string* out_name) override;
+  binder::Status getConnectedClientStats(
+      std::vector<android::net::wifi::nl80211::NativeWifiClientStats>*
+          out_client_stats) override;
+  binder::Status setClientChangeCoalescingWindow(
+      int32_t window_ms, bool* out_success) override;
+  binder::Status getRankedChannels(
+      std::vector<int32_t>* out_frequencies) override;
+  // Runs the transaction through BinderCallDispatcher.
+  status_t onTransact(uint32_t code,
+                      const Parcel& data,
+                      Parcel* reply,
+                      uint32_t flags) override;
 
  private:
   ApInterfaceImpl* impl_;
+  CallbackDispatcher* callback_dispatcher_;
 
   android::sp<IApInterfaceEventCallback>
       ap_interface_event_callback_;
@@ -16,6 +16,8 @@
 
 #include "wificond/ap_interface_impl.h"
 
+#include <algorithm>
+
 #include <android-base/logging.h>
 
 #include "wificond/net/netlink_utils.h"
@@ -26,6 +28,7 @@
 using android::net::wifi::nl80211::IApInterface;
 using android::wifi_system::InterfaceTool;
 using android::net::wifi::nl80211::NativeWifiClient;
+using android::net::wifi::nl80211::NativeWifiClientStats;
 using std::array;
 using std::endl;
 using std::string;
@@ -40,16 +43,22 @@ namespace wificond {
 ApInterfaceImpl::ApInterfaceImpl(const string& interface_name,
                                  uint32_t interface_index,
                                  NetlinkUtils* netlink_utils,
-                                 InterfaceTool* if_tool)
+                                 InterfaceTool* if_tool,
+                                 EventLoop* event_loop)
     : interface_name_(interface_name),
       interface_index_(interface_index),
       netlink_utils_(netlink_utils),
       if_tool_(if_tool),
-      binder_(new ApInterfaceBinder(this)) {
+      event_loop_(event_loop),
+      binder_(new ApInterfaceBinder(this)),
+      coalescing_window_ms_(0),
+      coalescing_timer_(EventLoop::kInvalidTimerId) {
   // This log keeps compiler happy.
   LOG(DEBUG) << "Created ap interface " << interface_name_
              << " with index " << interface_index_;
 
+  // Station events keep flowing while a client interface is busy.
+  netlink_utils_->CreateInterfaceStrand(interface_index_);
   netlink_utils_->SubscribeStationEvent(
       interface_index_,
       std::bind(&ApInterfaceImpl::OnStationEvent,
@@ -58,58 +67,231 @@ ApInterfaceImpl::ApInterfaceImpl(const string& interface_name,
   netlink_utils_->SubscribeChannelSwitchEvent(
       interface_index_,
       std::bind(&ApInterfaceImpl::OnChannelSwitchEvent, this, _1, _2));
-
+  netlink_utils_->SubscribeEventsLost(
+      interface_index_,
+      std::bind(&ApInterfaceImpl::OnEventsLost, this));
 }
 
 ApInterfaceImpl::~ApInterfaceImpl() {
+  if (coalescing_timer_ != EventLoop::kInvalidTimerId) {
+    event_loop_->CancelDelayedTask(coalescing_timer_);
+  }
   binder_->NotifyImplDead();
   if_tool_->SetUpState(interface_name_.c_str(), false);
   netlink_utils_->UnsubscribeStationEvent(interface_index_);
   netlink_utils_->UnsubscribeChannelSwitchEvent(interface_index_);
+  netlink_utils_->UnsubscribeEventsLost(interface_index_);
+  netlink_utils_->DestroyInterfaceStrand(interface_index_);
 }
 
 sp<IApInterface> ApInterfaceImpl::GetBinder() const {
   return binder_;
 }
 
+void ApInterfaceImpl::SetCallbackDispatcher(CallbackDispatcher* dispatcher) {
+  binder_->SetCallbackDispatcher(dispatcher);
+}
+
 void ApInterfaceImpl::Dump(std::stringstream* ss) const {
   *ss << "------- Dump of AP interface with index: "
       << interface_index_ << " and name: " << interface_name_
       << "-------" << endl;
+  *ss << "Connected stations: " << stations_.size() << endl;
+  channel_surveys_.Dump(ss);
   *ss << "------- Dump End -------" << endl;
 }
 
 void ApInterfaceImpl::OnStationEvent(
     StationEvent event,
     const array<uint8_t, ETH_ALEN>& mac_address) {
-  vector<uint8_t> mac_return_address = vector<uint8_t>(mac_address.begin(), mac_address.end());
-
-  NativeWifiClient station;
-  station.mac_address_ = mac_return_address;
-
   if (event == NEW_STATION) {
     LOG(INFO) << "New station "
-              << LoggingUtils::GetMacString(mac_address)
+              << LoggingUtils::FormatMac(mac_address)
               << " connected to hotspot"
               << " using interface "
               << interface_name_;
     LOG(INFO) << "Sending notifications for station add event";
-    binder_->NotifyConnectedClientsChanged(station, true);
+    NotifyStationChanged(mac_address, true);
   } else if (event == DEL_STATION) {
     LOG(INFO) << "Station "
-              << LoggingUtils::GetMacString(mac_address)
+              << LoggingUtils::FormatMac(mac_address)
               << " disassociated from hotspot";
     LOG(DEBUG) << "Sending notifications for station leave event";
-    binder_->NotifyConnectedClientsChanged(station, false);
+    NotifyStationChanged(mac_address, false);
+  }
+}
+
+void ApInterfaceImpl::NotifyStationChanged(
+    const array<uint8_t, ETH_ALEN>& mac_address,
+    bool connected) {
+  auto station = LowerBoundStation(mac_address);
+  bool known = station != stations_.end() &&
+               station->mac_address == mac_address;
+  if (connected && !known) {
+    StationStats new_station;
+    new_station.mac_address = mac_address;
+    stations_.insert(station, new_station);
+  } else if (!connected && known) {
+    stations_.erase(station);
+  }
+  if (coalescing_window_ms_ == 0) {
+    NativeWifiClient client;
+    client.mac_address_ =
+        vector<uint8_t>(mac_address.begin(), mac_address.end());
+    binder_->NotifyConnectedClientsChanged(client, connected);
+    return;
+  }
+  auto pending = std::find_if(
+      pending_station_changes_.begin(), pending_station_changes_.end(),
+      [&mac_address](const std::pair<array<uint8_t, ETH_ALEN>, bool>& change) {
+        return change.first == mac_address;
+      });
+  if (pending == pending_station_changes_.end()) {
+    pending_station_changes_.emplace_back(mac_address, connected);
+  } else if (pending->second != connected) {
+    // The station is back to the state of the last report.
+    pending_station_changes_.erase(pending);
+  }
+  if (coalescing_timer_ == EventLoop::kInvalidTimerId) {
+    coalescing_timer_ = event_loop_->PostCancelableDelayedTask(
+        std::bind(&ApInterfaceImpl::FlushStationChanges, this),
+        coalescing_window_ms_,
+        coalescing_window_ms_ / 4);
+  }
+}
+
+void ApInterfaceImpl::FlushStationChanges() {
+  coalescing_timer_ = EventLoop::kInvalidTimerId;
+  if (pending_station_changes_.empty()) {
+    return;
+  }
+  vector<NativeWifiClient> connected_clients;
+  vector<NativeWifiClient> disconnected_clients;
+  for (const auto& change : pending_station_changes_) {
+    NativeWifiClient client;
+    client.mac_address_ =
+        vector<uint8_t>(change.first.begin(), change.first.end());
+    if (change.second) {
+      connected_clients.push_back(client);
+    } else {
+      disconnected_clients.push_back(client);
+    }
   }
+  pending_station_changes_.clear();
+  LOG(DEBUG) << "Sending notifications for " << connected_clients.size()
+             << " connected and " << disconnected_clients.size()
+             << " disconnected stations";
+  binder_->NotifyConnectedClientsBatchChanged(connected_clients,
+                                              disconnected_clients);
 }
 
+void ApInterfaceImpl::SetClientChangeCoalescingWindow(int32_t window_ms) {
+  coalescing_window_ms_ = window_ms;
+  if (window_ms == 0 && coalescing_timer_ != EventLoop::kInvalidTimerId) {
+    event_loop_->CancelDelayedTask(coalescing_timer_);
+    FlushStationChanges();
+  }
+}
+
+vector<StationStats>::iterator ApInterfaceImpl::LowerBoundStation(
+    const array<uint8_t, ETH_ALEN>& mac_address) {
+  return std::lower_bound(
+      stations_.begin(), stations_.end(), mac_address,
+      [](const StationStats& station, const array<uint8_t, ETH_ALEN>& key) {
+        return station.mac_address < key;
+      });
+}
+
+bool ApInterfaceImpl::RefreshStations() {
+  vector<StationStats> stations;
+  if (!netlink_utils_->GetStationStatsList(interface_index_, &stations)) {
+    return false;
+  }
+  std::sort(stations.begin(), stations.end(),
+            [](const StationStats& lhs, const StationStats& rhs) {
+              return lhs.mac_address < rhs.mac_address;
+            });
+  // Both lists are sorted, so a single merge pass finds the differences.
+  vector<array<uint8_t, ETH_ALEN>> left_stations;
+  vector<array<uint8_t, ETH_ALEN>> new_stations;
+  auto known = stations_.begin();
+  auto fetched = stations.begin();
+  while (known != stations_.end() || fetched != stations.end()) {
+    if (fetched == stations.end() ||
+        (known != stations_.end() &&
+         known->mac_address < fetched->mac_address)) {
+      left_stations.push_back((known++)->mac_address);
+    } else if (known == stations_.end() ||
+               fetched->mac_address < known->mac_address) {
+      new_stations.push_back((fetched++)->mac_address);
+    } else {
+      known++;
+      fetched++;
+    }
+  }
+  for (const auto& mac_address : left_stations) {
+    NotifyStationChanged(mac_address, false);
+  }
+  for (const auto& mac_address : new_stations) {
+    NotifyStationChanged(mac_address, true);
+  }
+  stations_ = std::move(stations);
+  return true;
+}
+
+void ApInterfaceImpl::OnEventsLost() {
+  if (!RefreshStations()) {
+    LOG(ERROR) << "Failed to resync stations of interface " << interface_name_;
+    return;
+  }
+  LOG(INFO) << "Resync " << stations_.size() << " stations of interface "
+            << interface_name_;
+}
+
+bool ApInterfaceImpl::GetConnectedClientStats(
+    vector<NativeWifiClientStats>* out_client_stats) {
+  if (!RefreshStations()) {
+    LOG(ERROR) << "Failed to get stations of interface " << interface_name_;
+    return false;
+  }
+  out_client_stats->clear();
+  out_client_stats->reserve(stations_.size());
+  for (const StationStats& station : stations_) {
+    NativeWifiClientStats client_stats;
+    client_stats.mac_address_ = vector<uint8_t>(station.mac_address.begin(),
+                                                station.mac_address.end());
+    client_stats.rx_bytes_ = static_cast<int64_t>(station.rx_bytes);
+    client_stats.tx_bytes_ = static_cast<int64_t>(station.tx_bytes);
+    client_stats.signal_dbm_ = station.signal_dbm;
+    client_stats.inactive_time_ms_ =
+        static_cast<int32_t>(station.inactive_time_ms);
+    client_stats.connected_time_s_ =
+        static_cast<int32_t>(station.connected_time_s);
+    out_client_stats->push_back(client_stats);
+  }
+  return true;
+}
+
+bool ApInterfaceImpl::GetRankedChannels(vector<int32_t>* out_frequencies) {
+  vector<ChannelSurvey> surveys;
+  if (!netlink_utils_->GetChannelSurveys(interface_index_, &surveys)) {
+    LOG(ERROR) << "Failed to get channel surveys of interface "
+               << interface_name_;
+    return false;
+  }
+  channel_surveys_.Update(surveys);
+  vector<uint32_t> frequencies;
+  channel_surveys_.GetRankedFrequencies(&frequencies);
+  out_frequencies->assign(frequencies.begin(), frequencies.end());
+  return true;
+}
 
 void ApInterfaceImpl::OnChannelSwitchEvent(uint32_t frequency,
                                            ChannelBandwidth bandwidth) {
   LOG(INFO) << "New channel on frequency: " << frequency
             << " with bandwidth: " << LoggingUtils::GetBandwidthString(bandwidth);
-  binder_->NotifySoftApChannelSwitched(frequency, bandwidth);
+  // Without clients, the new channel is of no hurry to the framework.
+  binder_->NotifySoftApChannelSwitched(frequency, bandwidth, stations_.empty());
 }
 
 }  // namespace wificond
@@ -19,6 +19,7 @@
 
 #include <array>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <linux/if_ether.h>
@@ -26,7 +27,11 @@
 #include <android-base/macros.h>
 #include <wifi_system/interface_tool.h>
 
+#include "wificond/callback_dispatcher.h"
+#include "wificond/channel_survey_cache.h"
+#include "wificond/event_loop.h"
 #include "wificond/net/netlink_manager.h"
+#include "wificond/net/netlink_utils.h"
 
 #include "android/net/wifi/nl80211/IApInterface.h"
 
@@ -37,7 +42,6 @@ namespace android {
 namespace wificond {
 
 class ApInterfaceBinder;
-class NetlinkUtils;
 
 // Holds the guts of how we control network interfaces capable of exposing an AP
 // via hostapd.  Because remote processes may hold on to the corresponding
@@ -48,7 +52,8 @@ class ApInterfaceImpl {
   ApInterfaceImpl(const std::string& interface_name,
                   uint32_t interface_index,
                   NetlinkUtils* netlink_utils,
-                  wifi_system::InterfaceTool* if_tool);
+                  wifi_system::InterfaceTool* if_tool,
+                  EventLoop* event_loop);
   ~ApInterfaceImpl();
 
   // Get a pointer to the binder representing this ApInterfaceImpl.
@@ -56,16 +61,64 @@ class ApInterfaceImpl {
 
   std::string GetInterfaceName() { return interface_name_; }
   void Dump(std::stringstream* ss) const;
+  // Calls the callbacks of the framework through |dispatcher| instead of on
+  // the event loop thread. |dispatcher| must outlive this interface.
+  void SetCallbackDispatcher(CallbackDispatcher* dispatcher);
+
+  // Gets the connected stations, with their statistics fetched from kernel
+  // by a single station dump.
+  // Returns true on success.
+  bool GetConnectedClientStats(
+      std::vector<android::net::wifi::nl80211::NativeWifiClientStats>*
+          out_client_stats);
+
+  // Coalesces the station changes of |window_ms| milliseconds into a single
+  // callback. 0 reports every change right away.
+  void SetClientChangeCoalescingWindow(int32_t window_ms);
+
+  // Gets the frequencies of the channels the radio surveyed, the least busy
+  // first. The survey cache is refreshed with a survey dump first.
+  // Returns true on success.
+  bool GetRankedChannels(std::vector<int32_t>* out_frequencies);
 
  private:
   const std::string interface_name_;
   const uint32_t interface_index_;
   NetlinkUtils* const netlink_utils_;
   wifi_system::InterfaceTool* const if_tool_;
+  EventLoop* const event_loop_;
   const android::sp<ApInterfaceBinder> binder_;
+  // Stations we have reported as connected to the framework, with their
+  // last fetched statistics. Kept sorted by MAC address, so that a lookup is
+  // a binary search over a single vector.
+  std::vector<StationStats> stations_;
+  // See SetClientChangeCoalescingWindow().
+  int32_t coalescing_window_ms_;
+  // Net station changes of the current coalescing window, in the order
+  // they happened. true for a connection, false for a disconnection.
+  std::vector<std::pair<std::array<uint8_t, ETH_ALEN>, bool>>
+      pending_station_changes_;
+  // Timer that ends the current coalescing window, if any.
+  EventLoop::TimerId coalescing_timer_;
+  // How busy the channels the radio surveyed are. See GetRankedChannels().
+  ChannelSurveyCache channel_surveys_;
 
   void OnStationEvent(StationEvent event,
                       const std::array<uint8_t, ETH_ALEN>& mac_address);
+  void NotifyStationChanged(const std::array<uint8_t, ETH_ALEN>& mac_address,
+                            bool connected);
+  // Reports the station changes of the coalescing window that ends.
+  void FlushStationChanges();
+  // Returns the first station of |stations_| whose MAC address is not less
+  // than |mac_address|.
+  std::vector<StationStats>::iterator LowerBoundStation(
+      const std::array<uint8_t, ETH_ALEN>& mac_address);
+  // Fetches the stations and their statistics from kernel into |stations_|,
+  // and reports the stations that connected or left without an event.
+  // Returns true on success.
+  bool RefreshStations();
+  // Station events might have been lost. Resyncs |stations_| with kernel.
+  void OnEventsLost();
 
   void OnChannelSwitchEvent(uint32_t frequency, ChannelBandwidth bandwidth);
 
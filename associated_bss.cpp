@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/associated_bss.h"
+
+#include <algorithm>
+
+#include "android/net/wifi/nl80211/IWifiScannerImpl.h"
+#include "wificond/logging_utils.h"
+#include "wificond/scanning/info_element_utils.h"
+
+using android::net::wifi::nl80211::IWifiScannerImpl;
+using android::net::wifi::nl80211::InfoElementLocation;
+using android::net::wifi::nl80211::NativeScanResult;
+using std::array;
+using std::endl;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+// Decodes the information elements of an association frame. Returns false
+// if there are none.
+bool DecodeAssociationIes(const vector<uint8_t>& ies,
+                          vector<InfoElementLocation>* index,
+                          NativeScanResult* decoded) {
+  if (ies.empty()) {
+    return false;
+  }
+  InfoElementUtils::IndexInfoElements(ies.data(), ies.size(), index);
+  // Association frames do not say whether WEP is used, and it is not
+  // worth telling apart anyway.
+  InfoElementUtils::DecodeInfoElements(ies.data(), *index, 0, decoded);
+  return true;
+}
+
+ChannelBandwidth ToChannelBandwidth(int32_t channel_width,
+                                    int32_t wifi_standard) {
+  switch (channel_width) {
+    case IWifiScannerImpl::SCAN_RESULT_CHANNEL_WIDTH_20MHZ:
+      return wifi_standard == IWifiScannerImpl::SCAN_RESULT_WIFI_STANDARD_LEGACY
+          ? BW_20_NOHT : BW_20;
+    case IWifiScannerImpl::SCAN_RESULT_CHANNEL_WIDTH_40MHZ:
+      return BW_40;
+    case IWifiScannerImpl::SCAN_RESULT_CHANNEL_WIDTH_80MHZ:
+      return BW_80;
+    case IWifiScannerImpl::SCAN_RESULT_CHANNEL_WIDTH_160MHZ:
+      return BW_160;
+    case IWifiScannerImpl::SCAN_RESULT_CHANNEL_WIDTH_80P80MHZ:
+      return BW_80P80;
+    default:
+      return BW_INVALID;
+  }
+}
+
+}  // namespace
+
+AssociatedBss::AssociatedBss() {
+  OnDisassociated();
+}
+
+void AssociatedBss::OnAssociated(const array<uint8_t, ETH_ALEN>& bssid,
+                                 uint32_t frequency,
+                                 const vector<uint8_t>& request_ies,
+                                 const vector<uint8_t>& response_ies) {
+  OnDisassociated();
+  associated_ = true;
+  bssid_ = bssid;
+  frequency_ = frequency;
+
+  // The request carries the SSID and the security that the station picked,
+  // the response the operation parameters of the AP. Either side may lack
+  // a capability, so the link runs at the lowest standard of the two.
+  vector<InfoElementLocation> index;
+  NativeScanResult request;
+  request.wifi_standard = IWifiScannerImpl::SCAN_RESULT_WIFI_STANDARD_UNKNOWN;
+  if (DecodeAssociationIes(request_ies, &index, &request)) {
+    InfoElementUtils::GetSsid(request_ies.data(), index, &ssid_);
+    security_ = request.security;
+    wifi_standard_ = request.wifi_standard;
+  }
+  index.clear();
+  NativeScanResult response;
+  if (DecodeAssociationIes(response_ies, &index, &response)) {
+    if (wifi_standard_ == IWifiScannerImpl::SCAN_RESULT_WIFI_STANDARD_UNKNOWN) {
+      wifi_standard_ = response.wifi_standard;
+    } else if (response.wifi_standard !=
+               IWifiScannerImpl::SCAN_RESULT_WIFI_STANDARD_UNKNOWN) {
+      wifi_standard_ = std::min(wifi_standard_, response.wifi_standard);
+    }
+    bandwidth_ = ToChannelBandwidth(response.channel_width, wifi_standard_);
+  }
+}
+
+void AssociatedBss::OnDisassociated() {
+  associated_ = false;
+  bssid_.fill(0);
+  ssid_.clear();
+  frequency_ = 0;
+  bandwidth_ = BW_INVALID;
+  security_ = 0;
+  wifi_standard_ = IWifiScannerImpl::SCAN_RESULT_WIFI_STANDARD_UNKNOWN;
+  station_info_ = StationInfo();
+  station_info_time_ns_ = 0;
+}
+
+void AssociatedBss::OnChannelSwitch(uint32_t frequency,
+                                    ChannelBandwidth bandwidth) {
+  frequency_ = frequency;
+  bandwidth_ = bandwidth;
+  // Rates measured on the old channel no longer apply.
+  InvalidateStationInfo();
+}
+
+void AssociatedBss::SetStationInfo(const StationInfo& station_info,
+                                   nsecs_t time_ns) {
+  station_info_ = station_info;
+  station_info_time_ns_ = time_ns;
+}
+
+bool AssociatedBss::GetStationInfo(nsecs_t now_ns,
+                                   nsecs_t max_age_ns,
+                                   StationInfo* out_station_info) const {
+  if (!associated_ || station_info_time_ns_ == 0 ||
+      now_ns - station_info_time_ns_ >= max_age_ns) {
+    return false;
+  }
+  *out_station_info = station_info_;
+  return true;
+}
+
+void AssociatedBss::OnRssiChanged(int32_t rssi_dbm) {
+  station_info_.current_rssi = static_cast<int8_t>(rssi_dbm);
+}
+
+void AssociatedBss::Dump(std::stringstream* ss) const {
+  *ss << "Associated BSS:";
+  if (!associated_) {
+    *ss << " none" << endl;
+    return;
+  }
+  *ss << " " << LoggingUtils::FormatMac(bssid_)
+      << " ssid: " << LoggingUtils::FormatSsid(ssid_)
+      << " frequency: " << frequency_
+      << " bandwidth: " << LoggingUtils::GetBandwidthString(bandwidth_)
+      << " security: " << security_
+      << " standard: " << wifi_standard_ << endl;
+}
+
+}  // namespace wificond
+}  // namespace android
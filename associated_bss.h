@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_ASSOCIATED_BSS_H_
+#define WIFICOND_ASSOCIATED_BSS_H_
+
+#include <stdint.h>
+
+#include <array>
+#include <sstream>
+#include <vector>
+
+#include <linux/if_ether.h>
+
+#include <android-base/macros.h>
+#include <utils/Timers.h>
+
+#include "wificond/net/netlink_manager.h"
+#include "wificond/net/netlink_utils.h"
+
+namespace android {
+namespace wificond {
+
+// Snapshot of the BSS that a client interface is associated with, kept up
+// to date from MLME, channel switch and connection quality monitor events,
+// so that the link queries of a connected interface are served without
+// asking kernel.
+//
+// The SSID and the negotiated security, channel width and Wi-Fi standard
+// come from the information elements of the (re)association request and
+// response that connect and roam events carry. Events that don't carry
+// them leave these fields unknown until the next association.
+class AssociatedBss {
+ public:
+  AssociatedBss();
+
+  // Starts a snapshot of BSS |bssid|. |frequency| is 0 if the event did not
+  // report it. |request_ies| and |response_ies| are the information
+  // elements of the (re)association request and response, if any.
+  void OnAssociated(const std::array<uint8_t, ETH_ALEN>& bssid,
+                    uint32_t frequency,
+                    const std::vector<uint8_t>& request_ies,
+                    const std::vector<uint8_t>& response_ies);
+  void OnDisassociated();
+  // |bandwidth| is BW_INVALID if the event did not report it.
+  void OnChannelSwitch(uint32_t frequency, ChannelBandwidth bandwidth);
+  // Sets the frequency of the BSS, e.g. after querying it from kernel.
+  void SetFrequency(uint32_t frequency) { frequency_ = frequency; }
+
+  // Keeps |station_info| of the BSS, fetched from kernel at monotonic time
+  // |time_ns|.
+  void SetStationInfo(const StationInfo& station_info, nsecs_t time_ns);
+  // Gets the kept station info if it was fetched less than |max_age_ns|
+  // before monotonic time |now_ns|.
+  // Returns false otherwise.
+  bool GetStationInfo(nsecs_t now_ns,
+                      nsecs_t max_age_ns,
+                      StationInfo* out_station_info) const;
+  void InvalidateStationInfo() { station_info_time_ns_ = 0; }
+  // Updates the signal of the kept station info from a connection quality
+  // monitor event. The other fields are not refreshed by events, so this
+  // does not make the station info any younger.
+  void OnRssiChanged(int32_t rssi_dbm);
+
+  bool IsAssociated() const { return associated_; }
+  // All zeros while not associated.
+  const std::array<uint8_t, ETH_ALEN>& GetBssid() const { return bssid_; }
+  // Empty if unknown.
+  const std::vector<uint8_t>& GetSsid() const { return ssid_; }
+  // 0 if unknown.
+  uint32_t GetFrequency() const { return frequency_; }
+  ChannelBandwidth GetBandwidth() const { return bandwidth_; }
+  // One of the IWifiScannerImpl::SCAN_RESULT_SECURITY_* bits, 0 if unknown.
+  int32_t GetSecurity() const { return security_; }
+  // One of IWifiScannerImpl::SCAN_RESULT_WIFI_STANDARD_*.
+  int32_t GetWifiStandard() const { return wifi_standard_; }
+  void Dump(std::stringstream* ss) const;
+
+ private:
+  bool associated_;
+  std::array<uint8_t, ETH_ALEN> bssid_;
+  std::vector<uint8_t> ssid_;
+  uint32_t frequency_;
+  ChannelBandwidth bandwidth_;
+  int32_t security_;
+  int32_t wifi_standard_;
+  StationInfo station_info_;
+  // Monotonic time |station_info_| was fetched at, or 0 if it is not valid.
+  nsecs_t station_info_time_ns_;
+
+  DISALLOW_COPY_AND_ASSIGN(AssociatedBss);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_ASSOCIATED_BSS_H_
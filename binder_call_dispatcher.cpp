@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/binder_call_dispatcher.h"
+
+#include <condition_variable>
+#include <mutex>
+
+#include <binder/IPCThreadState.h>
+
+using android::IPCThreadState;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+BinderCallDispatcher* g_dispatcher = nullptr;
+
+}  // namespace
+
+BinderCallDispatcher::BinderCallDispatcher(EventLoop* event_loop)
+    : event_loop_(event_loop) {
+}
+
+status_t BinderCallDispatcher::Dispatch(
+    const std::function<bool()>& is_read_only,
+    const std::function<status_t()>& transaction) {
+  {
+    std::shared_lock<std::shared_mutex> lock(state_lock_);
+    if (is_read_only()) {
+      return transaction();
+    }
+  }
+
+  // Permission checks of the transaction look at the calling identity of the
+  // thread they run on, so the identity of the caller moves along with the
+  // transaction.
+  int64_t calling_identity = IPCThreadState::self()->clearCallingIdentity();
+  IPCThreadState::self()->restoreCallingIdentity(calling_identity);
+
+  std::mutex mutex;
+  std::condition_variable done_condition;
+  bool done = false;
+  status_t result = UNKNOWN_ERROR;
+  event_loop_->PostTask([&]() {
+    int64_t loop_identity = IPCThreadState::self()->clearCallingIdentity();
+    IPCThreadState::self()->restoreCallingIdentity(calling_identity);
+    status_t transaction_result = transaction();
+    IPCThreadState::self()->restoreCallingIdentity(loop_identity);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    result = transaction_result;
+    done = true;
+    done_condition.notify_one();
+  });
+  std::unique_lock<std::mutex> lock(mutex);
+  done_condition.wait(lock, [&done]() { return done; });
+  return result;
+}
+
+BinderCallDispatcher* BinderCallDispatcher::GetInstance() {
+  return g_dispatcher;
+}
+
+void BinderCallDispatcher::SetInstance(BinderCallDispatcher* dispatcher) {
+  g_dispatcher = dispatcher;
+}
+
+status_t BinderCallDispatcher::DispatchTransaction(
+    const std::function<bool()>& is_read_only,
+    const std::function<status_t()>& transaction) {
+  if (g_dispatcher == nullptr) {
+    return transaction();
+  }
+  return g_dispatcher->Dispatch(is_read_only, transaction);
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_BINDER_CALL_DISPATCHER_H_
+#define WIFICOND_BINDER_CALL_DISPATCHER_H_
+
+#include <functional>
+#include <shared_mutex>
+
+#include <android-base/macros.h>
+#include <utils/Errors.h>
+
+#include "wificond/event_loop.h"
+
+namespace android {
+namespace wificond {
+
+// BinderCallDispatcher decides on which thread an incoming binder transaction
+// of wificond runs.
+// By default wificond polls binder commands on its event loop thread, and
+// there is no dispatcher: every transaction runs right away on that thread.
+// When binder is served by a thread pool, transactions arrive on binder
+// threads instead:
+//   - A transaction that only reads cached state runs right away on its
+//     binder thread, holding |state_lock_| shared. The event loop holds
+//     |state_lock_| exclusively while it runs a callback, so such
+//     transactions run concurrently with each other but never with the event
+//     loop.
+//   - Any other transaction is posted to the event loop with PostTask(), and
+//     the binder thread waits for its completion. State changes therefore
+//     stay serialized on the event loop thread, like in polled mode.
+// Synchronous binder calls that the event loop makes must therefore not
+// wait for a transaction back into wificond, which could never run.
+class BinderCallDispatcher {
+ public:
+  // |event_loop| must outlive this object.
+  explicit BinderCallDispatcher(EventLoop* event_loop);
+  ~BinderCallDispatcher() = default;
+
+  // The lock that the event loop must hold exclusively while running its
+  // callbacks.
+  std::shared_mutex* GetStateLock() { return &state_lock_; }
+
+  // Runs |transaction| on the appropriate thread and returns its result.
+  // |is_read_only| is called with |state_lock_| held shared. It returns
+  // whether |transaction| only reads state, in which case |transaction| runs
+  // on the calling thread without releasing the lock.
+  status_t Dispatch(const std::function<bool()>& is_read_only,
+                    const std::function<status_t()>& transaction);
+
+  // Returns the dispatcher used by the binder objects of wificond, or nullptr
+  // in polled mode.
+  static BinderCallDispatcher* GetInstance();
+  static void SetInstance(BinderCallDispatcher* dispatcher);
+
+  // Runs |transaction| through the installed dispatcher, or directly if
+  // there is none.
+  // Binder objects of wificond call this from their onTransact().
+  static status_t DispatchTransaction(
+      const std::function<bool()>& is_read_only,
+      const std::function<status_t()>& transaction);
+
+ private:
+  EventLoop* const event_loop_;
+  std::shared_mutex state_lock_;
+
+  DISALLOW_COPY_AND_ASSIGN(BinderCallDispatcher);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_BINDER_CALL_DISPATCHER_H_
@@ -0,0 +1,264 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/callback_dispatcher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+#include <android-base/logging.h>
+#include <utils/Timers.h>
+
+using std::endl;
+using std::function;
+using std::lock_guard;
+using std::mutex;
+using std::unique_lock;
+
+namespace android {
+namespace wificond {
+
+constexpr int32_t CallbackDispatcher::kNoCoalescing;
+constexpr size_t CallbackDispatcher::kMaxQueuedCallbacks;
+constexpr int64_t CallbackDispatcher::kLowPowerFlushDelayMs;
+
+CallbackDispatcher::CallbackDispatcher()
+    : stopping_(false),
+      low_power_mode_(false),
+      release_time_ns_(0),
+      num_called_(0),
+      num_coalesced_(0),
+      num_dropped_(0),
+      num_held_(0),
+      max_queue_delay_ns_(0),
+      max_call_time_ns_(0),
+      thread_(&CallbackDispatcher::RunCallbacks, this) {
+}
+
+CallbackDispatcher::~CallbackDispatcher() {
+  {
+    lock_guard<mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  callback_posted_.notify_one();
+  thread_.join();
+}
+
+void CallbackDispatcher::Post(const void* listener,
+                              int32_t coalescing_key,
+                              const function<void()>& callback,
+                              bool deferrable) {
+  QueuedCallback queued_callback{coalescing_key,
+                                 callback,
+                                 systemTime(SYSTEM_TIME_MONOTONIC)};
+  {
+    lock_guard<mutex> lock(mutex_);
+    if (deferrable && low_power_mode_) {
+      if (held_callbacks_.empty()) {
+        release_time_ns_ = queued_callback.post_time_ns +
+            kLowPowerFlushDelayMs * 1000000;
+      }
+      Enqueue(&held_callbacks_[listener], std::move(queued_callback));
+      num_held_++;
+      // The dispatch thread waits for |release_time_ns_|.
+    } else {
+      ReleaseHeldCallbacks(listener);
+      std::deque<QueuedCallback>& queue = queues_[listener];
+      if (queue.empty()) {
+        turns_.push_back(listener);
+      }
+      Enqueue(&queue, std::move(queued_callback));
+    }
+  }
+  callback_posted_.notify_one();
+}
+
+void CallbackDispatcher::Dispatch(CallbackDispatcher* dispatcher,
+                                  const void* listener,
+                                  int32_t coalescing_key,
+                                  const function<void()>& callback,
+                                  bool deferrable) {
+  if (dispatcher == nullptr) {
+    callback();
+    return;
+  }
+  dispatcher->Post(listener, coalescing_key, callback, deferrable);
+}
+
+void CallbackDispatcher::SetLowPowerMode(bool enabled) {
+  {
+    lock_guard<mutex> lock(mutex_);
+    if (low_power_mode_ == enabled) {
+      return;
+    }
+    LOG(INFO) << (enabled ? "Enter" : "Leave") << " low power mode";
+    low_power_mode_ = enabled;
+    if (!enabled) {
+      ReleaseAllHeldCallbacks();
+    }
+  }
+  callback_posted_.notify_one();
+}
+
+void CallbackDispatcher::Enqueue(std::deque<QueuedCallback>* queue,
+                                 QueuedCallback callback) {
+  if (callback.coalescing_key != kNoCoalescing && !queue->empty() &&
+      queue->back().coalescing_key == callback.coalescing_key) {
+    // Keep the post time of the queued callback.
+    queue->back().callback = std::move(callback.callback);
+    num_coalesced_++;
+    return;
+  }
+  if (queue->size() >= kMaxQueuedCallbacks &&
+      !DropCallback(queue, callback) &&
+      queue->size() == kMaxQueuedCallbacks) {
+    LOG(WARNING) << "Queue of a listener that falls behind grows past "
+                 << kMaxQueuedCallbacks << " callbacks";
+  }
+  queue->push_back(std::move(callback));
+}
+
+bool CallbackDispatcher::DropCallback(std::deque<QueuedCallback>* queue,
+                                      const QueuedCallback& callback) {
+  auto dropped = queue->end();
+  for (auto it = queue->begin(); it != queue->end(); ++it) {
+    if (it->coalescing_key == kNoCoalescing) {
+      continue;
+    }
+    if (dropped == queue->end()) {
+      dropped = it;
+    }
+    // Nothing is lost if a later callback tells the same.
+    bool superseded = (callback.coalescing_key == it->coalescing_key) ||
+        std::any_of(it + 1, queue->end(),
+                    [it](const QueuedCallback& later) {
+                      return later.coalescing_key == it->coalescing_key;
+                    });
+    if (superseded) {
+      dropped = it;
+      break;
+    }
+  }
+  if (dropped == queue->end()) {
+    return false;
+  }
+  LOG(WARNING) << "Dropped a callback of a listener that falls behind";
+  queue->erase(dropped);
+  num_dropped_++;
+  return true;
+}
+
+void CallbackDispatcher::ReleaseHeldCallbacks(const void* listener) {
+  auto held = held_callbacks_.find(listener);
+  if (held == held_callbacks_.end()) {
+    return;
+  }
+  std::deque<QueuedCallback>& queue = queues_[listener];
+  if (queue.empty()) {
+    turns_.push_back(listener);
+  }
+  for (QueuedCallback& callback : held->second) {
+    Enqueue(&queue, std::move(callback));
+  }
+  held_callbacks_.erase(held);
+  if (held_callbacks_.empty()) {
+    release_time_ns_ = 0;
+  }
+}
+
+void CallbackDispatcher::ReleaseAllHeldCallbacks() {
+  while (!held_callbacks_.empty()) {
+    ReleaseHeldCallbacks(held_callbacks_.begin()->first);
+  }
+}
+
+void CallbackDispatcher::RunCallbacks() {
+  while (true) {
+    function<void()> callback;
+    {
+      unique_lock<mutex> lock(mutex_);
+      while (true) {
+        if (stopping_) {
+          return;
+        }
+        if (release_time_ns_ != 0 &&
+            systemTime(SYSTEM_TIME_MONOTONIC) >= release_time_ns_) {
+          ReleaseAllHeldCallbacks();
+        }
+        if (!turns_.empty()) {
+          break;
+        }
+        if (release_time_ns_ == 0) {
+          callback_posted_.wait(lock);
+        } else {
+          callback_posted_.wait_for(
+              lock,
+              std::chrono::nanoseconds(
+                  release_time_ns_ - systemTime(SYSTEM_TIME_MONOTONIC)));
+        }
+      }
+      const void* listener = turns_.front();
+      turns_.pop_front();
+      auto queue = queues_.find(listener);
+      QueuedCallback& queued_callback = queue->second.front();
+      max_queue_delay_ns_ = std::max(
+          max_queue_delay_ns_,
+          systemTime(SYSTEM_TIME_MONOTONIC) - queued_callback.post_time_ns);
+      callback = std::move(queued_callback.callback);
+      queue->second.pop_front();
+      if (queue->second.empty()) {
+        queues_.erase(queue);
+      } else {
+        turns_.push_back(listener);
+      }
+    }
+    int64_t start_time_ns = systemTime(SYSTEM_TIME_MONOTONIC);
+    callback();
+    // Release what the callback holds outside of the lock as well.
+    callback = nullptr;
+    int64_t call_time_ns = systemTime(SYSTEM_TIME_MONOTONIC) - start_time_ns;
+    lock_guard<mutex> lock(mutex_);
+    num_called_++;
+    max_call_time_ns_ = std::max(max_call_time_ns_, call_time_ns);
+  }
+}
+
+void CallbackDispatcher::Dump(std::stringstream* ss) const {
+  lock_guard<mutex> lock(mutex_);
+  size_t num_queued = 0;
+  for (const auto& queue : queues_) {
+    num_queued += queue.second.size();
+  }
+  size_t num_held_now = 0;
+  for (const auto& held : held_callbacks_) {
+    num_held_now += held.second.size();
+  }
+  *ss << "Callback dispatch:" << endl;
+  *ss << "Called: " << num_called_
+      << ", coalesced: " << num_coalesced_
+      << ", dropped: " << num_dropped_
+      << ", queued: " << num_queued
+      << " for " << queues_.size() << " listeners" << endl;
+  *ss << "Max queue delay in ms: " << max_queue_delay_ns_ / 1000000
+      << ", max call time in ms: " << max_call_time_ns_ / 1000000 << endl;
+  *ss << "Low power mode: " << low_power_mode_
+      << ", held back: " << num_held_
+      << ", held back now: " << num_held_now << endl;
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_CALLBACK_DISPATCHER_H_
+#define WIFICOND_CALLBACK_DISPATCHER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include <android-base/macros.h>
+
+namespace android {
+namespace wificond {
+
+// CallbackDispatcher calls the binder callbacks of listener processes on a
+// thread of its own, so that the event loop does not wait for the binder
+// driver or for listeners that fall behind.
+//
+// Every listener has a bounded queue, whose callbacks are called in the
+// order they were posted. Listeners take turns, one callback at a time, so
+// that a listener with a long queue does not hold up the others. A callback
+// posted with the coalescing key of the last callback queued for the same
+// listener replaces it, which suits callbacks that only tell that something
+// changed. A full queue drops one of these callbacks, preferably one that a
+// later callback of the same key supersedes. Callbacks that are never
+// coalesced report state transitions that listeners can not recover from
+// missing, so they are never dropped: the queue grows past its bound
+// instead.
+//
+// In low power mode, e.g. while the device dozes, deferrable callbacks are
+// held back, so that listeners are not woken up for every event that can
+// wait. They are called together kLowPowerFlushDelayMs after the first of
+// them was held, or right before the next callback of the same listener
+// that is not deferrable, so that every listener still gets its callbacks
+// in order.
+class CallbackDispatcher {
+ public:
+  // Callbacks that are never coalesced.
+  static constexpr int32_t kNoCoalescing = -1;
+  // Callbacks queued per listener at most, unless they are all never
+  // coalesced.
+  static constexpr size_t kMaxQueuedCallbacks = 64;
+  // Longest time a deferrable callback is held back in low power mode.
+  static constexpr int64_t kLowPowerFlushDelayMs = 30000;
+
+  CallbackDispatcher();
+  // Drops the callbacks that have not been called.
+  ~CallbackDispatcher();
+
+  // Queues |callback| for |listener|, which identifies the listener, e.g.
+  // its binder. |callback| must hold a reference to whatever it calls.
+  // |deferrable| callbacks may be held back in low power mode.
+  void Post(const void* listener,
+            int32_t coalescing_key,
+            const std::function<void()>& callback,
+            bool deferrable = false);
+  // Posts |callback| to |dispatcher|, or calls it right away if
+  // |dispatcher| is null.
+  static void Dispatch(CallbackDispatcher* dispatcher,
+                       const void* listener,
+                       int32_t coalescing_key,
+                       const std::function<void()>& callback,
+                       bool deferrable = false);
+  // Leaving low power mode calls the callbacks that were held back.
+  void SetLowPowerMode(bool enabled);
+  void Dump(std::stringstream* ss) const;
+
+ private:
+  struct QueuedCallback {
+    int32_t coalescing_key;
+    std::function<void()> callback;
+    // Monotonic time the callback was posted at.
+    int64_t post_time_ns;
+  };
+
+  void RunCallbacks();
+  // Appends |callback| to |queue|, which holds the callbacks of one
+  // listener, unless it is coalesced with the last one.
+  void Enqueue(std::deque<QueuedCallback>* queue, QueuedCallback callback);
+  // Drops a coalescable callback of the full |queue| to make room for
+  // |callback|. Returns false if all queued callbacks are never coalesced.
+  bool DropCallback(std::deque<QueuedCallback>* queue,
+                    const QueuedCallback& callback);
+  // Moves the held back callbacks of |listener| to |queues_|.
+  void ReleaseHeldCallbacks(const void* listener);
+  void ReleaseAllHeldCallbacks();
+
+  mutable std::mutex mutex_;
+  std::condition_variable callback_posted_;
+  // Queues of the listeners with callbacks left to call.
+  std::map<const void*, std::deque<QueuedCallback>> queues_;
+  // Listeners of |queues_| in the order they take turns.
+  std::deque<const void*> turns_;
+  bool stopping_;
+
+  bool low_power_mode_;
+  // Deferrable callbacks held back in low power mode, per listener.
+  std::map<const void*, std::deque<QueuedCallback>> held_callbacks_;
+  // Monotonic time to release |held_callbacks_| at, if there are any.
+  int64_t release_time_ns_;
+
+  // Statistics since the dispatcher was created.
+  int64_t num_called_;
+  int64_t num_coalesced_;
+  int64_t num_dropped_;
+  int64_t num_held_;
+  // Longest time a callback waited in its queue.
+  int64_t max_queue_delay_ns_;
+  // Longest time a callback took to be called.
+  int64_t max_call_time_ns_;
+
+  std::thread thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(CallbackDispatcher);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_CALLBACK_DISPATCHER_H_
@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/channel_survey_cache.h"
+
+#include <algorithm>
+
+using std::endl;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+// Returns the fraction of |interval| that the channel was busy with traffic
+// of other devices, in permille, or -1 if the interval is too short to tell.
+// Receive time stands in for busy time with drivers that only report the
+// former.
+int32_t GetBusyPermille(const ChannelSurvey& interval) {
+  uint64_t busy = interval.busy_time_ms != 0 ? interval.busy_time_ms
+                                             : interval.rx_time_ms;
+  uint64_t active = interval.active_time_ms;
+  if (active <= interval.tx_time_ms) {
+    return -1;
+  }
+  // Our own transmissions do not make the channel busy for us.
+  busy = busy > interval.tx_time_ms ? busy - interval.tx_time_ms : 0;
+  active -= interval.tx_time_ms;
+  return static_cast<int32_t>(std::min<uint64_t>(busy, active) * 1000 /
+                              active);
+}
+
+// Returns the counters of |current| accumulated since |last|. If the
+// counters went back, e.g. because the radio was restarted, all of
+// |current| is new.
+ChannelSurvey GetInterval(const ChannelSurvey& last,
+                          const ChannelSurvey& current) {
+  if (current.active_time_ms < last.active_time_ms ||
+      current.busy_time_ms < last.busy_time_ms ||
+      current.rx_time_ms < last.rx_time_ms ||
+      current.tx_time_ms < last.tx_time_ms) {
+    return current;
+  }
+  ChannelSurvey interval = current;
+  interval.active_time_ms -= last.active_time_ms;
+  interval.busy_time_ms -= last.busy_time_ms;
+  interval.rx_time_ms -= last.rx_time_ms;
+  interval.tx_time_ms -= last.tx_time_ms;
+  return interval;
+}
+
+}  // namespace
+
+void ChannelSurveyCache::Update(const vector<ChannelSurvey>& surveys) {
+  for (const ChannelSurvey& survey : surveys) {
+    auto channel = std::lower_bound(
+        channels_.begin(), channels_.end(), survey.frequency,
+        [](const Channel& channel, uint32_t frequency) {
+          return channel.last_survey.frequency < frequency;
+        });
+    ChannelSurvey interval = survey;
+    if (channel == channels_.end() ||
+        channel->last_survey.frequency != survey.frequency) {
+      channel = channels_.insert(channel, Channel());
+    } else {
+      interval = GetInterval(channel->last_survey, survey);
+    }
+    int32_t busy_permille = GetBusyPermille(interval);
+    if (busy_permille >= 0) {
+      channel->busy_permille =
+          channel->busy_permille < 0
+              ? busy_permille
+              : (channel->busy_permille + busy_permille) / 2;
+    }
+    ChannelSurvey last_survey = survey;
+    // Keep the last known noise level if this update has none.
+    if (!survey.has_noise) {
+      last_survey.has_noise = channel->last_survey.has_noise;
+      last_survey.noise_dbm = channel->last_survey.noise_dbm;
+    }
+    channel->last_survey = last_survey;
+  }
+}
+
+void ChannelSurveyCache::GetRankedFrequencies(
+    vector<uint32_t>* out_frequencies) const {
+  vector<const Channel*> ranked;
+  ranked.reserve(channels_.size());
+  for (const Channel& channel : channels_) {
+    if (channel.busy_permille >= 0) {
+      ranked.push_back(&channel);
+    }
+  }
+  // Channels without a noise level rank after those with one.
+  std::stable_sort(
+      ranked.begin(), ranked.end(),
+      [](const Channel* lhs, const Channel* rhs) {
+        if (lhs->busy_permille != rhs->busy_permille) {
+          return lhs->busy_permille < rhs->busy_permille;
+        }
+        if (lhs->last_survey.has_noise != rhs->last_survey.has_noise) {
+          return lhs->last_survey.has_noise;
+        }
+        return lhs->last_survey.noise_dbm < rhs->last_survey.noise_dbm;
+      });
+  out_frequencies->clear();
+  out_frequencies->reserve(ranked.size());
+  for (const Channel* channel : ranked) {
+    out_frequencies->push_back(channel->last_survey.frequency);
+  }
+}
+
+void ChannelSurveyCache::Dump(std::stringstream* ss) const {
+  for (const Channel& channel : channels_) {
+    *ss << "Channel " << channel.last_survey.frequency << " MHz: ";
+    if (channel.busy_permille >= 0) {
+      *ss << "busy " << channel.busy_permille / 10.0 << "%";
+    } else {
+      *ss << "busy unknown";
+    }
+    if (channel.last_survey.has_noise) {
+      *ss << ", noise " << static_cast<int>(channel.last_survey.noise_dbm)
+          << " dBm";
+    }
+    if (channel.last_survey.in_use) {
+      *ss << ", in use";
+    }
+    *ss << endl;
+  }
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_CHANNEL_SURVEY_CACHE_H_
+#define WIFICOND_CHANNEL_SURVEY_CACHE_H_
+
+#include <stdint.h>
+
+#include <sstream>
+#include <vector>
+
+#include <android-base/macros.h>
+
+#include "wificond/net/netlink_utils.h"
+
+namespace android {
+namespace wificond {
+
+// Keeps how busy each channel a radio surveyed is, so that an access point
+// can pick a quiet channel without running a scan first.
+//
+// Survey counters accumulate in kernel, so every update only looks at the
+// time that passed on a channel since its previous update. The busy ratio
+// of that interval is folded into a running average, and channels that an
+// update does not report keep what was learned about them before.
+class ChannelSurveyCache {
+ public:
+  ChannelSurveyCache() = default;
+
+  // Folds the surveys of a survey dump into the cache.
+  void Update(const std::vector<ChannelSurvey>& surveys);
+  // Gets the frequencies of the channels with a known busy ratio, the
+  // least busy first. Ties go to the channel with the lowest noise.
+  void GetRankedFrequencies(std::vector<uint32_t>* out_frequencies) const;
+  void Dump(std::stringstream* ss) const;
+
+ private:
+  struct Channel {
+    // The survey of the latest update, that the next one is compared to.
+    ChannelSurvey last_survey;
+    // Running average of the fraction of time the channel was busy with
+    // traffic of other devices, in permille. -1 until known.
+    int32_t busy_permille = -1;
+  };
+
+  // Channels sorted by frequency.
+  std::vector<Channel> channels_;
+
+  DISALLOW_COPY_AND_ASSIGN(ChannelSurveyCache);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_CHANNEL_SURVEY_CACHE_H_
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/client/native_connection_stats.h"
+
+#include <android-base/logging.h>
+
+#include "wificond/parcelable_utils.h"
+
+using android::status_t;
+
+namespace android {
+namespace net {
+namespace wifi {
+namespace nl80211 {
+
+status_t NativeConnectionEvent::writeToParcel(::android::Parcel* parcel) const {
+  RETURN_IF_FAILED(parcel->writeInt32(type_));
+  RETURN_IF_FAILED(parcel->writeInt64(timestamp_ns_));
+  RETURN_IF_FAILED(parcel->writeByteVector(bssid_));
+  RETURN_IF_FAILED(parcel->writeByteVector(previous_bssid_));
+  RETURN_IF_FAILED(parcel->writeInt32(status_code_));
+  RETURN_IF_FAILED(parcel->writeBool(is_timeout_));
+  RETURN_IF_FAILED(parcel->writeInt32(latency_ms_));
+  return ::android::OK;
+}
+
+status_t NativeConnectionEvent::readFromParcel(
+    const ::android::Parcel* parcel) {
+  RETURN_IF_FAILED(parcel->readInt32(&type_));
+  RETURN_IF_FAILED(parcel->readInt64(&timestamp_ns_));
+  RETURN_IF_FAILED(parcel->readByteVector(&bssid_));
+  RETURN_IF_FAILED(parcel->readByteVector(&previous_bssid_));
+  RETURN_IF_FAILED(parcel->readInt32(&status_code_));
+  RETURN_IF_FAILED(parcel->readBool(&is_timeout_));
+  RETURN_IF_FAILED(parcel->readInt32(&latency_ms_));
+  return ::android::OK;
+}
+
+status_t NativeConnectionStats::writeToParcel(::android::Parcel* parcel) const {
+  RETURN_IF_FAILED(parcel->writeInt32(num_connects_));
+  RETURN_IF_FAILED(parcel->writeInt32(num_connect_failures_));
+  RETURN_IF_FAILED(parcel->writeInt32(num_roams_));
+  RETURN_IF_FAILED(parcel->writeInt32(num_disconnects_));
+  RETURN_IF_FAILED(parcel->writeInt32Vector(latency_bucket_bounds_ms_));
+  RETURN_IF_FAILED(parcel->writeInt32Vector(connect_latency_histogram_));
+  RETURN_IF_FAILED(parcel->writeInt32Vector(roam_latency_histogram_));
+  RETURN_IF_FAILED(parcel->writeInt32(events_.size()));
+  for (const auto& event : events_) {
+    // For Java readTypedList():
+    // A leading number 1 means this object is not null.
+    RETURN_IF_FAILED(parcel->writeInt32(1));
+    RETURN_IF_FAILED(event.writeToParcel(parcel));
+  }
+  return ::android::OK;
+}
+
+status_t NativeConnectionStats::readFromParcel(
+    const ::android::Parcel* parcel) {
+  RETURN_IF_FAILED(parcel->readInt32(&num_connects_));
+  RETURN_IF_FAILED(parcel->readInt32(&num_connect_failures_));
+  RETURN_IF_FAILED(parcel->readInt32(&num_roams_));
+  RETURN_IF_FAILED(parcel->readInt32(&num_disconnects_));
+  RETURN_IF_FAILED(parcel->readInt32Vector(&latency_bucket_bounds_ms_));
+  RETURN_IF_FAILED(parcel->readInt32Vector(&connect_latency_histogram_));
+  RETURN_IF_FAILED(parcel->readInt32Vector(&roam_latency_histogram_));
+  int32_t num_events = 0;
+  RETURN_IF_FAILED(parcel->readInt32(&num_events));
+  events_.clear();
+  for (int i = 0; i < num_events; i++) {
+    NativeConnectionEvent event;
+    // From Java writeTypedList():
+    // A leading number 1 means this object is not null.
+    // We never expect a 0 or other values here.
+    int32_t leading_number = 0;
+    RETURN_IF_FAILED(parcel->readInt32(&leading_number));
+    if (leading_number != 1) {
+      LOG(ERROR) << "Unexpected leading number before an object: "
+                 << leading_number;
+      return ::android::BAD_VALUE;
+    }
+    RETURN_IF_FAILED(event.readFromParcel(parcel));
+    events_.push_back(std::move(event));
+  }
+  return ::android::OK;
+}
+
+}  // namespace nl80211
+}  // namespace wifi
+}  // namespace net
+}  // namespace android
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_NATIVE_CONNECTION_STATS_H_
+#define WIFICOND_NATIVE_CONNECTION_STATS_H_
+
+#include <vector>
+
+#include <binder/Parcel.h>
+#include <binder/Parcelable.h>
+
+namespace android {
+namespace net {
+namespace wifi {
+namespace nl80211 {
+
+// An MLME event of a client interface.
+// See |IClientInterface.getConnectionStats()|.
+class NativeConnectionEvent : public ::android::Parcelable {
+ public:
+  NativeConnectionEvent() = default;
+  bool operator==(const NativeConnectionEvent& rhs) const {
+    return type_ == rhs.type_ &&
+           timestamp_ns_ == rhs.timestamp_ns_ &&
+           bssid_ == rhs.bssid_ &&
+           previous_bssid_ == rhs.previous_bssid_ &&
+           status_code_ == rhs.status_code_ &&
+           is_timeout_ == rhs.is_timeout_ &&
+           latency_ms_ == rhs.latency_ms_;
+  }
+  ::android::status_t writeToParcel(::android::Parcel* parcel) const override;
+  ::android::status_t readFromParcel(const ::android::Parcel* parcel) override;
+
+  // |IClientInterface::CONNECTION_EVENT_*| value.
+  int32_t type_ = 0;
+  // CLOCK_BOOTTIME timestamp of the event in nanoseconds.
+  int64_t timestamp_ns_ = 0;
+  // BSSID the event is about. Empty if the event did not tell.
+  std::vector<uint8_t> bssid_;
+  // BSSID the interface was associated with before the event. Empty if it
+  // was not associated.
+  std::vector<uint8_t> previous_bssid_;
+  // Status code of association and connect events.
+  // Status codes definition: IEEE 802.11-2012, 8.4.1.9, Table 8-37
+  int32_t status_code_ = 0;
+  bool is_timeout_ = false;
+  // Time from the authentication that started the connection attempt to
+  // this event, for the event that completed the attempt. -1 otherwise.
+  int32_t latency_ms_ = -1;
+};
+
+// Connection and roaming statistics of a client interface.
+// See |IClientInterface.getConnectionStats()|.
+class NativeConnectionStats : public ::android::Parcelable {
+ public:
+  NativeConnectionStats() = default;
+  bool operator==(const NativeConnectionStats& rhs) const {
+    return num_connects_ == rhs.num_connects_ &&
+           num_connect_failures_ == rhs.num_connect_failures_ &&
+           num_roams_ == rhs.num_roams_ &&
+           num_disconnects_ == rhs.num_disconnects_ &&
+           latency_bucket_bounds_ms_ == rhs.latency_bucket_bounds_ms_ &&
+           connect_latency_histogram_ == rhs.connect_latency_histogram_ &&
+           roam_latency_histogram_ == rhs.roam_latency_histogram_ &&
+           events_ == rhs.events_;
+  }
+  ::android::status_t writeToParcel(::android::Parcel* parcel) const override;
+  ::android::status_t readFromParcel(const ::android::Parcel* parcel) override;
+
+  // Associations with a BSS while not associated.
+  int32_t num_connects_ = 0;
+  // Authentications, associations and connects that failed or timed out.
+  int32_t num_connect_failures_ = 0;
+  // Associations with another BSS while associated.
+  int32_t num_roams_ = 0;
+  // Losses of the association.
+  int32_t num_disconnects_ = 0;
+  // Inclusive upper bounds of the latency histogram buckets in milliseconds.
+  // The last bucket of a histogram has no upper bound, so histograms have
+  // one more bucket than there are bounds.
+  std::vector<int32_t> latency_bucket_bounds_ms_;
+  // Number of connects and roams per latency bucket. Only the attempts that
+  // started with an authentication event are measured, which drivers that
+  // connect and roam on their own do not send.
+  std::vector<int32_t> connect_latency_histogram_;
+  std::vector<int32_t> roam_latency_histogram_;
+  // The latest MLME events, the oldest first.
+  std::vector<NativeConnectionEvent> events_;
+};
+
+}  // namespace nl80211
+}  // namespace wifi
+}  // namespace net
+}  // namespace android
+
+#endif  // WIFICOND_NATIVE_CONNECTION_STATS_H_
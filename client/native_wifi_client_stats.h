@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_NATIVE_WIFI_CLIENT_STATS_H_
+#define WIFICOND_NATIVE_WIFI_CLIENT_STATS_H_
+
+#include <vector>
+
+#include <binder/Parcel.h>
+#include <binder/Parcelable.h>
+
+namespace android {
+namespace net {
+namespace wifi {
+namespace nl80211 {
+
+// Statistics of a client connected to an access point.
+// See |IApInterface.getConnectedClientStats()|.
+class NativeWifiClientStats : public ::android::Parcelable {
+ public:
+  NativeWifiClientStats() = default;
+  bool operator==(const NativeWifiClientStats& rhs) const {
+    return mac_address_ == rhs.mac_address_ &&
+           rx_bytes_ == rhs.rx_bytes_ &&
+           tx_bytes_ == rhs.tx_bytes_ &&
+           signal_dbm_ == rhs.signal_dbm_ &&
+           inactive_time_ms_ == rhs.inactive_time_ms_ &&
+           connected_time_s_ == rhs.connected_time_s_;
+  }
+  ::android::status_t writeToParcel(::android::Parcel* parcel) const override;
+  ::android::status_t readFromParcel(const ::android::Parcel* parcel) override;
+
+  std::vector<uint8_t> mac_address_;
+  // Bytes received from and transmitted to the client.
+  int64_t rx_bytes_ = 0;
+  int64_t tx_bytes_ = 0;
+  // Signal strength of the client in dBm, or 0 if unknown.
+  int32_t signal_dbm_ = 0;
+  // Time since the last activity of the client in milliseconds.
+  int32_t inactive_time_ms_ = 0;
+  // Time since the client connected in seconds.
+  int32_t connected_time_s_ = 0;
+};
+
+}  // namespace nl80211
+}  // namespace wifi
+}  // namespace net
+}  // namespace android
+
+#endif  // WIFICOND_NATIVE_WIFI_CLIENT_STATS_H_
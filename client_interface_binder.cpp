@@ -17,6 +17,7 @@
 #include "wificond/client_interface_binder.h"
 
 #include <algorithm>
+#include <utility>
 #include <vector>
 
 #include <linux/if_ether.h>
@@ -25,11 +26,20 @@
 
 #include <binder/Status.h>
 
+#include "wificond/binder_call_dispatcher.h"
 #include "wificond/client_interface_impl.h"
+#include "wificond/flight_recorder.h"
 
+using android::base::unique_fd;
 using android::binder::Status;
+using android::net::wifi::nl80211::BnClientInterface;
+using android::net::wifi::nl80211::IClientInterface;
+using android::net::wifi::nl80211::ILinkQualityEventCallback;
+using android::net::wifi::nl80211::ISendMgmtFrameBatchEvent;
 using android::net::wifi::nl80211::ISendMgmtFrameEvent;
 using android::net::wifi::nl80211::IWifiScannerImpl;
+using android::net::wifi::nl80211::NativeConnectionStats;
+using android::os::ParcelFileDescriptor;
 using std::vector;
 
 namespace android {
@@ -60,6 +70,15 @@ Status ClientInterfaceBinder::signalPoll(
   return Status::ok();
 }
 
+Status ClientInterfaceBinder::pollStationInfo(
+    vector<int32_t>* out_station_info) {
+  if (impl_ == nullptr) {
+    return Status::ok();
+  }
+  impl_->PollStationInfo(out_station_info);
+  return Status::ok();
+}
+
 Status ClientInterfaceBinder::getMacAddress(vector<uint8_t>* out_mac_address) {
   if (impl_ == nullptr) {
     return Status::ok();
@@ -98,5 +117,115 @@ Status ClientInterfaceBinder::SendMgmtFrame(const vector<uint8_t>& frame,
   return Status::ok();
 }
 
+Status ClientInterfaceBinder::SendMgmtFrameBatch(
+    const vector<uint8_t>& frame,
+    const sp<ISendMgmtFrameBatchEvent>& callback,
+    const vector<int32_t>& mcs_rates,
+    int32_t spacing_ms) {
+  if (impl_ == nullptr ||
+      mcs_rates.size() >
+          static_cast<size_t>(IClientInterface::MAX_MGMT_FRAME_BATCH_SIZE) ||
+      spacing_ms < 0 ||
+      spacing_ms > IClientInterface::MAX_MGMT_FRAME_BATCH_SPACING_MS) {
+    callback->OnResults(
+        vector<int32_t>(mcs_rates.size(), 0),
+        vector<int32_t>(mcs_rates.size(),
+                        ISendMgmtFrameEvent::SEND_MGMT_FRAME_ERROR_UNKNOWN));
+    return Status::ok();
+  }
+  impl_->SendMgmtFrameBatch(frame, callback, mcs_rates, spacing_ms);
+  return Status::ok();
+}
+
+Status ClientInterfaceBinder::registerLinkQualityCallback(
+    const sp<ILinkQualityEventCallback>& callback,
+    int32_t rssi_threshold_dbm,
+    int32_t rssi_hysteresis_db,
+    int32_t tx_error_rate_percent,
+    bool* out_success) {
+  *out_success = false;
+  if (impl_ == nullptr) {
+    return Status::ok();
+  }
+  if (rssi_hysteresis_db < 0 || tx_error_rate_percent < 0 ||
+      tx_error_rate_percent > 100) {
+    return Status::fromExceptionCode(Status::EX_ILLEGAL_ARGUMENT);
+  }
+  *out_success = impl_->RegisterLinkQualityCallback(callback,
+                                                    rssi_threshold_dbm,
+                                                    rssi_hysteresis_db,
+                                                    tx_error_rate_percent);
+  return Status::ok();
+}
+
+Status ClientInterfaceBinder::unregisterLinkQualityCallback() {
+  if (impl_ == nullptr) {
+    return Status::ok();
+  }
+  impl_->UnregisterLinkQualityCallback();
+  return Status::ok();
+}
+
+Status ClientInterfaceBinder::getLinkStatsMemory(
+    const sp<IBinder>& token,
+    int32_t refresh_interval_ms,
+    ParcelFileDescriptor* out_memory) {
+  if (impl_ == nullptr) {
+    return Status::fromExceptionCode(Status::EX_ILLEGAL_STATE,
+                                     "Client interface is torn down");
+  }
+  if (token == nullptr || refresh_interval_ms < 0) {
+    return Status::fromExceptionCode(Status::EX_ILLEGAL_ARGUMENT);
+  }
+  unique_fd memory;
+  if (!impl_->EnableLinkStatsPage(token, refresh_interval_ms, &memory)) {
+    return Status::fromExceptionCode(Status::EX_ILLEGAL_STATE,
+                                     "Failed to create link stats memory");
+  }
+  *out_memory = ParcelFileDescriptor(std::move(memory));
+  return Status::ok();
+}
+
+Status ClientInterfaceBinder::releaseLinkStatsMemory() {
+  if (impl_ == nullptr) {
+    return Status::ok();
+  }
+  impl_->DisableLinkStatsPage();
+  return Status::ok();
+}
+
+Status ClientInterfaceBinder::getConnectionStats(
+    NativeConnectionStats* out_connection_stats) {
+  if (impl_ == nullptr) {
+    return Status::ok();
+  }
+  impl_->GetConnectionStats(out_connection_stats);
+  return Status::ok();
+}
+
+status_t ClientInterfaceBinder::onTransact(uint32_t code,
+                                           const Parcel& data,
+                                           Parcel* reply,
+                                           uint32_t flags) {
+  FlightRecorder::BinderCallScope call_record(FlightRecord::kClientInterface, code);
+  status_t status = BinderCallDispatcher::DispatchTransaction(
+      [code]() { return IsReadOnlyTransaction(code); },
+      [&]() { return BnClientInterface::onTransact(code, data, reply, flags); });
+  call_record.SetResult(status);
+  return status;
+}
+
+bool ClientInterfaceBinder::IsReadOnlyTransaction(uint32_t code) {
+  // These only read constant properties of |impl_|.
+  switch (code) {
+    case TRANSACTION_getMacAddress:
+    case TRANSACTION_getInterfaceName:
+    case TRANSACTION_getWifiScannerImpl:
+      return true;
+    default:
+      return false;
+  }
+}
+
 }  // namespace wificond
 }  // namespace android
@@ -21,6 +21,8 @@
 #include <binder/Status.h>
 
 #include "android/net/wifi/nl80211/BnClientInterface.h"
+#include "android/net/wifi/nl80211/ILinkQualityEventCallback.h"
+#include "android/net/wifi/nl80211/ISendMgmtFrameBatchEvent.h"
 #include "android/net/wifi/nl80211/ISendMgmtFrameEvent.h"
 
 namespace android {
@@ -42,6 +44,8 @@ class ClientInterfaceBinder : public android::net::wifi::nl80211::BnClientInterf
       std::vector<int32_t>* out_packet_counters) override;
   ::android::binder::Status signalPoll(
       std::vector<int32_t>* out_signal_poll_results) override;
+  ::android::binder::Status pollStationInfo(
+      std::vector<int32_t>* out_station_info) override;
   ::android::binder::Status getMacAddress(
       std::vector<uint8_t>* out_mac_address) override;
   ::android::binder::Status getInterfaceName(std::string* out_name) override;
@@ -51,7 +55,38 @@ class ClientInterfaceBinder : public android::net::wifi::nl80211::BnClientInterf
       const ::std::vector<uint8_t>& frame,
       const sp<::android::net::wifi::nl80211::ISendMgmtFrameEvent>& callback,
       int32_t mcs) override;
+  ::android::binder::Status SendMgmtFrameBatch(
+      const ::std::vector<uint8_t>& frame,
+      const sp<::android::net::wifi::nl80211::ISendMgmtFrameBatchEvent>&
+          callback,
+      const ::std::vector<int32_t>& mcs_rates,
+      int32_t spacing_ms) override;
+  ::android::binder::Status registerLinkQualityCallback(
+      const sp<::android::net::wifi::nl80211::ILinkQualityEventCallback>&
+          callback,
+      int32_t rssi_threshold_dbm,
+      int32_t rssi_hysteresis_db,
+      int32_t tx_error_rate_percent,
+      bool* out_success) override;
+  ::android::binder::Status unregisterLinkQualityCallback() override;
+  ::android::binder::Status getLinkStatsMemory(
+      const ::android::sp<::android::IBinder>& token,
+      int32_t refresh_interval_ms,
+      ::android::os::ParcelFileDescriptor* out_memory) override;
+  ::android::binder::Status releaseLinkStatsMemory() override;
+  ::android::binder::Status getConnectionStats(
+      ::android::net::wifi::nl80211::NativeConnectionStats*
+          out_connection_stats) override;
+  // Runs the transaction through BinderCallDispatcher.
+  ::android::status_t onTransact(uint32_t code,
+                                 const ::android::Parcel& data,
+                                 ::android::Parcel* reply,
+                                 uint32_t flags) override;
  private:
+  // Returns whether transaction |code| only reads cached state, so that it
+  // can run outside of the event loop.
+  static bool IsReadOnlyTransaction(uint32_t code);
+
   ClientInterfaceImpl* impl_;
 
   DISALLOW_COPY_AND_ASSIGN(ClientInterfaceBinder);
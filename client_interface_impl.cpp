@@ -16,6 +16,7 @@
 
 #include "wificond/client_interface_impl.h"
 
+#include <algorithm>
 #include <vector>
 
 #include <android-base/logging.h>
@@ -26,12 +27,18 @@
 #include "wificond/net/mlme_event.h"
 #include "wificond/net/netlink_utils.h"
 #include "wificond/scanning/scan_result.h"
+#include "wificond/scanning/scan_result_query.h"
 #include "wificond/scanning/scan_utils.h"
 #include "wificond/scanning/scanner_impl.h"
 
+using android::base::unique_fd;
 using android::net::wifi::nl80211::IClientInterface;
+using android::net::wifi::nl80211::ILinkQualityEventCallback;
+using android::net::wifi::nl80211::ISendMgmtFrameBatchEvent;
 using android::net::wifi::nl80211::ISendMgmtFrameEvent;
+using android::net::wifi::nl80211::NativeConnectionStats;
 using android::net::wifi::nl80211::NativeScanResult;
+using android::net::wifi::nl80211::ScanResultQuery;
 using android::sp;
 using android::wifi_system::InterfaceTool;
 
@@ -45,6 +52,47 @@ using namespace std::placeholders;
 namespace android {
 namespace wificond {
 
+namespace {
+
+// Station info requests within this window share one NL80211_CMD_GET_STATION.
+constexpr int64_t kStationInfoCacheWindowMs = 100;
+
+// The tx error rate is checked every kTxErrorIntervalSeconds, once at least
+// kTxErrorPackets packets were attempted.
+constexpr uint32_t kTxErrorPackets = 50;
+constexpr uint32_t kTxErrorIntervalSeconds = 5;
+
+}  // namespace
+
+// Disables the link statistics memory when the binder of its user dies.
+// Death notifications can arrive on a binder thread, so the memory is
+// disabled on the event loop.
+class LinkStatsTokenDeathRecipient : public IBinder::DeathRecipient {
+ public:
+  LinkStatsTokenDeathRecipient(EventLoop* event_loop,
+                               ClientInterfaceImpl* client_interface)
+      : event_loop_(event_loop),
+        client_interface_(client_interface) {}
+
+  void binderDied(const wp<IBinder>& who) override {
+    sp<LinkStatsTokenDeathRecipient> self(this);
+    event_loop_->PostTask([self]() {
+      if (self->client_interface_ != nullptr) {
+        LOG(INFO) << "User of link statistics memory died";
+        self->client_interface_->DisableLinkStatsPage();
+      }
+    });
+  }
+
+  // Ignores a death that is reported from now on.
+  // This must be called on the event loop.
+  void Cancel() { client_interface_ = nullptr; }
+
+ private:
+  EventLoop* const event_loop_;
+  ClientInterfaceImpl* client_interface_;
+};
+
 MlmeEventHandlerImpl::MlmeEventHandlerImpl(ClientInterfaceImpl* client_interface)
     : client_interface_(client_interface) {
 }
@@ -53,47 +101,75 @@ MlmeEventHandlerImpl::~MlmeEventHandlerImpl() {
 }
 
 void MlmeEventHandlerImpl::OnConnect(unique_ptr<MlmeConnectEvent> event) {
+  client_interface_->connection_timeline_.OnConnect(
+      event->GetTimestampNanos(), event->GetBSSID(), event->GetStatusCode(),
+      event->IsTimeout());
   if (!event->IsTimeout() && event->GetStatusCode() == 0) {
-    client_interface_->is_associated_ = true;
-    client_interface_->RefreshAssociateFreq();
-    client_interface_->bssid_ = event->GetBSSID();
+    client_interface_->OnAssociated(event->GetBSSID(),
+                                    event->GetFrequency(),
+                                    event->GetRequestIEs(),
+                                    event->GetResponseIEs());
   } else {
     if (event->IsTimeout()) {
       LOG(INFO) << "Connect timeout";
     }
-    client_interface_->is_associated_ = false;
-    client_interface_->bssid_.fill(0);
+    client_interface_->associated_bss_.OnDisassociated();
   }
+  client_interface_->RefreshLinkStatsPage();
 }
 
 void MlmeEventHandlerImpl::OnRoam(unique_ptr<MlmeRoamEvent> event) {
-  client_interface_->is_associated_ = true;
-  client_interface_->RefreshAssociateFreq();
-  client_interface_->bssid_ = event->GetBSSID();
+  client_interface_->connection_timeline_.OnRoam(
+      event->GetTimestampNanos(), event->GetBSSID());
+  client_interface_->OnAssociated(event->GetBSSID(),
+                                  event->GetFrequency(),
+                                  event->GetRequestIEs(),
+                                  event->GetResponseIEs());
+  client_interface_->RefreshLinkStatsPage();
+}
+
+void MlmeEventHandlerImpl::OnAuthenticate(
+    unique_ptr<MlmeAuthenticateEvent> event) {
+  if (event->IsTimeout()) {
+    LOG(INFO) << "Authenticate timeout";
+  }
+  client_interface_->connection_timeline_.OnAuthenticate(
+      event->GetTimestampNanos(), event->GetBSSID(), event->IsTimeout());
 }
 
 void MlmeEventHandlerImpl::OnAssociate(unique_ptr<MlmeAssociateEvent> event) {
+  client_interface_->connection_timeline_.OnAssociate(
+      event->GetTimestampNanos(), event->GetBSSID(), event->GetStatusCode(),
+      event->IsTimeout());
   if (!event->IsTimeout() && event->GetStatusCode() == 0) {
-    client_interface_->is_associated_ = true;
-    client_interface_->RefreshAssociateFreq();
-    client_interface_->bssid_ = event->GetBSSID();
+    // The connect event that follows carries the frequency and the
+    // information elements of the association. Until then, the frequency
+    // is queried when it is first needed.
+    client_interface_->associated_bss_.OnAssociated(
+        event->GetBSSID(), 0, {}, {});
   } else {
     if (event->IsTimeout()) {
       LOG(INFO) << "Associate timeout";
     }
-    client_interface_->is_associated_ = false;
-    client_interface_->bssid_.fill(0);
+    client_interface_->associated_bss_.OnDisassociated();
   }
+  client_interface_->RefreshLinkStatsPage();
 }
 
 void MlmeEventHandlerImpl::OnDisconnect(unique_ptr<MlmeDisconnectEvent> event) {
-  client_interface_->is_associated_ = false;
-  client_interface_->bssid_.fill(0);
+  client_interface_->connection_timeline_.OnDisconnect(
+      event->GetTimestampNanos());
+  client_interface_->associated_bss_.OnDisassociated();
+  client_interface_->InvalidateScanResultCache();
+  client_interface_->RefreshLinkStatsPage();
 }
 
 void MlmeEventHandlerImpl::OnDisassociate(unique_ptr<MlmeDisassociateEvent> event) {
-  client_interface_->is_associated_ = false;
-  client_interface_->bssid_.fill(0);
+  client_interface_->connection_timeline_.OnDisassociate(
+      event->GetTimestampNanos());
+  client_interface_->associated_bss_.OnDisassociated();
+  client_interface_->InvalidateScanResultCache();
+  client_interface_->RefreshLinkStatsPage();
 }
 
 
@@ -104,7 +180,8 @@ ClientInterfaceImpl::ClientInterfaceImpl(
     const std::array<uint8_t, ETH_ALEN>& interface_mac_addr,
     InterfaceTool* if_tool,
     NetlinkUtils* netlink_utils,
-    ScanUtils* scan_utils)
+    ScanUtils* scan_utils,
+    EventLoop* event_loop)
     : wiphy_index_(wiphy_index),
       interface_name_(interface_name),
       interface_index_(interface_index),
@@ -112,29 +189,25 @@ ClientInterfaceImpl::ClientInterfaceImpl(
       if_tool_(if_tool),
       netlink_utils_(netlink_utils),
       scan_utils_(scan_utils),
+      event_loop_(event_loop),
       mlme_event_handler_(new MlmeEventHandlerImpl(this)),
       binder_(new ClientInterfaceBinder(this)),
-      is_associated_(false),
-      frame_tx_in_progress_(false),
-      frame_tx_status_cookie_(0),
-      on_frame_tx_status_event_handler_([](bool was_acked) {}) {
+      link_stats_refresh_interval_ms_(0),
+      link_stats_refresh_timer_(EventLoop::kInvalidTimerId),
+      low_power_mode_(false) {
+  // Scan and MLME events of this interface take turns with the events of
+  // other interfaces.
+  netlink_utils_->CreateInterfaceStrand(interface_index_);
   netlink_utils_->SubscribeMlmeEvent(
       interface_index_,
       mlme_event_handler_.get());
 
   netlink_utils_->SubscribeFrameTxStatusEvent(
       interface_index,
-      [this](uint64_t cookie, bool was_acked) {
-        if (frame_tx_in_progress_ && frame_tx_status_cookie_ == cookie) {
-          on_frame_tx_status_event_handler_(was_acked);
-          frame_tx_in_progress_ = false;
-          frame_tx_status_cookie_ = 0;
-          on_frame_tx_status_event_handler_ = [](bool was_acked) {};
-        }
-      });
+      std::bind(&ClientInterfaceImpl::OnFrameTxStatusEvent, this, _1, _2));
 
   netlink_utils_->SubscribeChannelSwitchEvent(interface_index_,
-      std::bind(&ClientInterfaceImpl::OnChannelSwitchEvent, this, _1));
+      std::bind(&ClientInterfaceImpl::OnChannelSwitchEvent, this, _1, _2));
 
   if (!netlink_utils_->GetWiphyInfo(wiphy_index_,
                                &band_info_,
@@ -148,7 +221,10 @@ ClientInterfaceImpl::ClientInterfaceImpl(
                              scan_capabilities_,
                              wiphy_features_,
                              this,
-                             scan_utils_);
+                             scan_utils_,
+                             event_loop_);
+  netlink_utils_->SubscribeEventsLost(interface_index_,
+      std::bind(&ScannerImpl::OnEventsLost, scanner_.get()));
   // Need to set the interface up (especially in scan mode since wpa_supplicant
   // is not started)
   if_tool_->SetUpState(interface_name_.c_str(), true);
@@ -158,8 +234,20 @@ ClientInterfaceImpl::~ClientInterfaceImpl() {
   binder_->NotifyImplDead();
   scanner_->Invalidate();
   netlink_utils_->UnsubscribeFrameTxStatusEvent(interface_index_);
+  for (const PendingFrameTx& frame_tx : pending_frame_txs_) {
+    event_loop_->CancelDelayedTask(frame_tx.timeout_timer);
+  }
+  for (const auto& batch : frame_tx_batches_) {
+    event_loop_->CancelDelayedTask(batch->next_frame_timer);
+  }
+  event_loop_->CancelDelayedTask(link_stats_refresh_timer_);
+  UnlinkLinkStatsToken();
   netlink_utils_->UnsubscribeMlmeEvent(interface_index_);
   netlink_utils_->UnsubscribeChannelSwitchEvent(interface_index_);
+  netlink_utils_->UnsubscribeEventsLost(interface_index_);
+  // Kernel keeps the monitor configured beyond the life of this object.
+  UnregisterLinkQualityCallback();
+  netlink_utils_->DestroyInterfaceStrand(interface_index_);
   if_tool_->SetUpState(interface_name_.c_str(), false);
 }
 
@@ -195,14 +283,37 @@ void ClientInterfaceImpl::Dump(std::stringstream* ss) const {
       << wiphy_features_.supports_random_mac_sched_scan << endl;
   *ss << "Device supports sending management frames at specified MCS rate: "
       << wiphy_features_.supports_tx_mgmt_frame_mcs << endl;
+  if (link_stats_page_ != nullptr) {
+    *ss << "Link statistics memory refresh interval in ms: "
+        << link_stats_refresh_interval_ms_
+        << (low_power_mode_ ? " (low power mode)" : "") << endl;
+  }
+  associated_bss_.Dump(ss);
+  connection_timeline_.Dump(ss);
+  scanner_->DumpScanStats(ss);
   *ss << "------- Dump End -------" << endl;
 }
 
+void ClientInterfaceImpl::SetCallbackDispatcher(
+    CallbackDispatcher* dispatcher) {
+  scanner_->SetCallbackDispatcher(dispatcher);
+}
+
+void ClientInterfaceImpl::SetLowPowerMode(bool enabled) {
+  if (low_power_mode_ == enabled) {
+    return;
+  }
+  low_power_mode_ = enabled;
+  if (link_stats_refresh_timer_ != EventLoop::kInvalidTimerId) {
+    // Restarts the periodic refresh with the interval of the new mode.
+    event_loop_->CancelDelayedTask(link_stats_refresh_timer_);
+    ScheduleLinkStatsRefresh();
+  }
+}
+
 bool ClientInterfaceImpl::GetPacketCounters(vector<int32_t>* out_packet_counters) {
   StationInfo station_info;
-  if (!netlink_utils_->GetStationInfo(interface_index_,
-                                      bssid_,
-                                      &station_info)) {
+  if (!GetStationInfo(&station_info)) {
     return false;
   }
   out_packet_counters->push_back(station_info.station_tx_packets);
@@ -218,11 +329,51 @@ bool ClientInterfaceImpl::SignalPoll(vector<int32_t>* out_signal_poll_results) {
   }
 
   StationInfo station_info;
+  if (!GetStationInfo(&station_info)) {
+    return false;
+  }
+  AppendSignalPollResults(station_info, out_signal_poll_results);
+
+  return true;
+}
+
+bool ClientInterfaceImpl::PollStationInfo(vector<int32_t>* out_station_info) {
+  if (!IsAssociated()) {
+    LOG(INFO) << "Fail station info polling because wifi is not associated.";
+    return false;
+  }
+
+  StationInfo station_info;
+  if (!GetStationInfo(&station_info)) {
+    return false;
+  }
+  AppendSignalPollResults(station_info, out_station_info);
+  out_station_info->push_back(station_info.station_tx_packets);
+  out_station_info->push_back(station_info.station_tx_failed);
+
+  return true;
+}
+
+bool ClientInterfaceImpl::GetStationInfo(StationInfo* out_station_info) {
+  nsecs_t now_ns = systemTime(SYSTEM_TIME_MONOTONIC);
+  if (associated_bss_.GetStationInfo(now_ns,
+                                     ms2ns(kStationInfoCacheWindowMs),
+                                     out_station_info)) {
+    return true;
+  }
   if (!netlink_utils_->GetStationInfo(interface_index_,
-                                      bssid_,
-                                      &station_info)) {
+                                      associated_bss_.GetBssid(),
+                                      out_station_info)) {
+    associated_bss_.InvalidateStationInfo();
     return false;
   }
+  associated_bss_.SetStationInfo(*out_station_info, now_ns);
+  return true;
+}
+
+void ClientInterfaceImpl::AppendSignalPollResults(
+    const StationInfo& station_info,
+    vector<int32_t>* out_signal_poll_results) {
   out_signal_poll_results->push_back(
       static_cast<int32_t>(station_info.current_rssi));
   // Convert from 100kbit/s to Mbps.
@@ -230,76 +381,411 @@ bool ClientInterfaceImpl::SignalPoll(vector<int32_t>* out_signal_poll_results) {
       static_cast<int32_t>(station_info.station_tx_bitrate/10));
   // Association frequency.
   out_signal_poll_results->push_back(
-      static_cast<int32_t>(associate_freq_));
+      static_cast<int32_t>(GetAssociateFreq()));
   // Convert from 100kbit/s to Mbps.
   out_signal_poll_results->push_back(
       static_cast<int32_t>(station_info.station_rx_bitrate/10));
-
-  return true;
 }
 
 const std::array<uint8_t, ETH_ALEN>& ClientInterfaceImpl::GetMacAddress() {
   return interface_mac_addr_;
 }
 
+void ClientInterfaceImpl::InvalidateScanResultCache() {
+  // The associated BSS is reported as part of the scan results.
+  scan_utils_->InvalidateScanResultCache(interface_index_);
+}
+
+void ClientInterfaceImpl::OnAssociated(
+    const std::array<uint8_t, ETH_ALEN>& bssid,
+    uint32_t event_frequency,
+    const vector<uint8_t>& request_ies,
+    const vector<uint8_t>& response_ies) {
+  associated_bss_.OnAssociated(bssid, event_frequency, request_ies,
+                               response_ies);
+  if (event_frequency == 0) {
+    RefreshAssociateFreq();
+  }
+}
+
+uint32_t ClientInterfaceImpl::GetAssociateFreq() {
+  if (associated_bss_.GetFrequency() == 0) {
+    RefreshAssociateFreq();
+  }
+  return associated_bss_.GetFrequency();
+}
+
 bool ClientInterfaceImpl::RefreshAssociateFreq() {
-  // wpa_supplicant fetches associate frequency using the latest scan result.
-  // We should follow the same method here before we find a better solution.
+  // The operating frequency of the interface is the frequency of the
+  // associated BSS. This avoids a scan result dump on the roaming path.
+  uint32_t frequency;
+  if (netlink_utils_->GetInterfaceFrequency(interface_index_, &frequency)) {
+    associated_bss_.SetFrequency(frequency);
+    return true;
+  }
+  // Fall back to the latest scan results like wpa_supplicant does, for
+  // drivers that do not report the frequency of the interface.
+  // Only the frequency of the associated BSS is needed.
+  InvalidateScanResultCache();
+  ScanResultQuery query;
+  query.associated_only = true;
   std::vector<NativeScanResult> scan_results;
-  if (!scan_utils_->GetScanResult(interface_index_, &scan_results)) {
+  if (!scan_utils_->QueryScanResults(interface_index_, query, &scan_results)) {
     return false;
   }
   for (auto& scan_result : scan_results) {
     if (scan_result.associated) {
-      associate_freq_ = scan_result.frequency;
+      associated_bss_.SetFrequency(scan_result.frequency);
+      return true;
     }
   }
   return false;
 }
 
-bool ClientInterfaceImpl::OnChannelSwitchEvent(uint32_t frequency) {
+bool ClientInterfaceImpl::OnChannelSwitchEvent(uint32_t frequency,
+                                               ChannelBandwidth bandwidth) {
   if(!frequency) {
     LOG(ERROR) << "Frequency value is null";
     return false;
   }
-  LOG(INFO) << "New channel on frequency: " << frequency;
-  associate_freq_ = frequency;
+  LOG(INFO) << "New channel on frequency: " << frequency << " with bandwidth: "
+            << LoggingUtils::GetBandwidthString(bandwidth);
+  associated_bss_.OnChannelSwitch(frequency, bandwidth);
+  RefreshLinkStatsPage();
+  return true;
+}
+
+void ClientInterfaceImpl::OnCqmEvent(CqmEvent event,
+                                     int32_t rssi_dbm,
+                                     uint32_t packets) {
+  // Older kernels do not report the RSSI level, in which case it is 0.
+  if ((event == CQM_RSSI_LOW || event == CQM_RSSI_HIGH) && rssi_dbm != 0) {
+    associated_bss_.OnRssiChanged(rssi_dbm);
+  }
+  RefreshLinkStatsPage();
+  if (link_quality_callback_ == nullptr) {
+    return;
+  }
+  int type;
+  switch (event) {
+    case CQM_RSSI_LOW:
+      type = ILinkQualityEventCallback::LINK_QUALITY_RSSI_LOW;
+      break;
+    case CQM_RSSI_HIGH:
+      type = ILinkQualityEventCallback::LINK_QUALITY_RSSI_HIGH;
+      break;
+    case CQM_BEACON_LOSS:
+      type = ILinkQualityEventCallback::LINK_QUALITY_BEACON_LOSS;
+      break;
+    case CQM_PACKET_LOSS:
+      type = ILinkQualityEventCallback::LINK_QUALITY_PACKET_LOSS;
+      break;
+    case CQM_TX_ERROR_RATE:
+      type = ILinkQualityEventCallback::LINK_QUALITY_TX_ERROR_RATE;
+      break;
+    default:
+      LOG(ERROR) << "Unknown connection quality monitor event: " << event;
+      return;
+  }
+  link_quality_callback_->onLinkQualityChanged(
+      type, rssi_dbm, static_cast<int32_t>(packets));
+}
+
+bool ClientInterfaceImpl::RegisterLinkQualityCallback(
+    const sp<ILinkQualityEventCallback>& callback,
+    int32_t rssi_threshold_dbm,
+    uint32_t rssi_hysteresis_db,
+    uint32_t tx_error_rate_percent) {
+  if (!netlink_utils_->SetCqmRssiConfig(interface_index_,
+                                        rssi_threshold_dbm,
+                                        rssi_hysteresis_db)) {
+    LOG(ERROR) << "Failed to configure RSSI monitoring";
+    return false;
+  }
+  if (tx_error_rate_percent != 0) {
+    // Tx error monitoring is an optional add-on, so RSSI events are still
+    // delivered if the driver does not support it.
+    if (!netlink_utils_->SetCqmTxErrorConfig(interface_index_,
+                                             tx_error_rate_percent,
+                                             kTxErrorPackets,
+                                             kTxErrorIntervalSeconds)) {
+      LOG(WARNING) << "Failed to configure tx error monitoring";
+    }
+  } else if (link_quality_callback_ != nullptr) {
+    netlink_utils_->SetCqmTxErrorConfig(interface_index_, 0, 0, 0);
+  }
+  if (link_quality_callback_ == nullptr) {
+    netlink_utils_->SubscribeCqmEvent(interface_index_,
+        std::bind(&ClientInterfaceImpl::OnCqmEvent, this, _1, _2, _3));
+  }
+  link_quality_callback_ = callback;
+  return true;
+}
+
+void ClientInterfaceImpl::UnregisterLinkQualityCallback() {
+  if (link_quality_callback_ == nullptr) {
+    return;
+  }
+  netlink_utils_->UnsubscribeCqmEvent(interface_index_);
+  link_quality_callback_ = nullptr;
+  // A threshold of 0 and an interval of 0 disable the monitor.
+  netlink_utils_->SetCqmRssiConfig(interface_index_, 0, 0);
+  netlink_utils_->SetCqmTxErrorConfig(interface_index_, 0, 0, 0);
+}
+
+bool ClientInterfaceImpl::EnableLinkStatsPage(const sp<IBinder>& token,
+                                              int32_t refresh_interval_ms,
+                                              unique_fd* out_memory) {
+  if (link_stats_page_ == nullptr) {
+    unique_ptr<LinkStatsPage> page(new LinkStatsPage());
+    if (!page->Init()) {
+      return false;
+    }
+    link_stats_page_ = std::move(page);
+  }
+  unique_fd memory = link_stats_page_->GetReadOnlyFd();
+  if (memory.get() < 0) {
+    return false;
+  }
+  if (refresh_interval_ms > 0) {
+    refresh_interval_ms = std::max<int32_t>(
+        refresh_interval_ms,
+        IClientInterface::MIN_LINK_STATS_REFRESH_INTERVAL_MS);
+  }
+  if (token != link_stats_token_) {
+    UnlinkLinkStatsToken();
+    sp<LinkStatsTokenDeathRecipient> death_recipient =
+        new LinkStatsTokenDeathRecipient(event_loop_, this);
+    if (token->linkToDeath(death_recipient) == OK) {
+      link_stats_token_ = token;
+      link_stats_death_recipient_ = death_recipient;
+    } else {
+      LOG(WARNING) << "Failed to watch the user of link statistics memory";
+    }
+  }
+  link_stats_refresh_interval_ms_ = refresh_interval_ms;
+  // Restarts the periodic refresh with the new interval.
+  event_loop_->CancelDelayedTask(link_stats_refresh_timer_);
+  OnLinkStatsRefreshTimer();
+  *out_memory = std::move(memory);
   return true;
 }
 
+void ClientInterfaceImpl::DisableLinkStatsPage() {
+  event_loop_->CancelDelayedTask(link_stats_refresh_timer_);
+  link_stats_refresh_timer_ = EventLoop::kInvalidTimerId;
+  link_stats_refresh_interval_ms_ = 0;
+  link_stats_page_.reset();
+  UnlinkLinkStatsToken();
+}
+
+void ClientInterfaceImpl::UnlinkLinkStatsToken() {
+  if (link_stats_death_recipient_ == nullptr) {
+    return;
+  }
+  link_stats_death_recipient_->Cancel();
+  link_stats_token_->unlinkToDeath(link_stats_death_recipient_);
+  link_stats_death_recipient_.clear();
+  link_stats_token_.clear();
+}
+
+void ClientInterfaceImpl::GetConnectionStats(
+    NativeConnectionStats* out_connection_stats) const {
+  *out_connection_stats = connection_timeline_.GetStats();
+}
+
+void ClientInterfaceImpl::RefreshLinkStatsPage() {
+  if (link_stats_page_ == nullptr) {
+    return;
+  }
+  UpdateLinkStatsPage();
+  // The statistics do not change while not associated, so there is nothing
+  // to poll kernel for until the next association.
+  if (link_stats_refresh_timer_ == EventLoop::kInvalidTimerId) {
+    ScheduleLinkStatsRefresh();
+  } else if (!IsAssociated()) {
+    event_loop_->CancelDelayedTask(link_stats_refresh_timer_);
+    link_stats_refresh_timer_ = EventLoop::kInvalidTimerId;
+  }
+}
+
+void ClientInterfaceImpl::UpdateLinkStatsPage() {
+  LinkStats stats;
+  stats.timestamp_ns = systemTime(SYSTEM_TIME_BOOTTIME);
+  if (IsAssociated()) {
+    StationInfo station_info;
+    if (!GetStationInfo(&station_info)) {
+      // Readers keep seeing the previous statistics, with their older
+      // timestamp.
+      return;
+    }
+    stats.associated = true;
+    stats.rssi_dbm = station_info.current_rssi;
+    stats.frequency_mhz = GetAssociateFreq();
+    // Convert from 100kbit/s to Mbps.
+    stats.tx_bitrate_mbps = station_info.station_tx_bitrate / 10;
+    stats.rx_bitrate_mbps = station_info.station_rx_bitrate / 10;
+    stats.tx_packets = station_info.station_tx_packets;
+    stats.tx_failed = station_info.station_tx_failed;
+  }
+  link_stats_page_->Update(stats);
+}
+
+void ClientInterfaceImpl::OnLinkStatsRefreshTimer() {
+  link_stats_refresh_timer_ = EventLoop::kInvalidTimerId;
+  RefreshLinkStatsPage();
+}
+
+void ClientInterfaceImpl::ScheduleLinkStatsRefresh() {
+  link_stats_refresh_timer_ = EventLoop::kInvalidTimerId;
+  if (link_stats_refresh_interval_ms_ == 0 || !IsAssociated()) {
+    return;
+  }
+  int32_t interval_ms = link_stats_refresh_interval_ms_;
+  if (low_power_mode_) {
+    interval_ms = std::max(interval_ms, kLowPowerLinkStatsRefreshIntervalMs);
+  }
+  // The refresh need not be precise, so it can share wakeups.
+  link_stats_refresh_timer_ = event_loop_->PostCancelableDelayedTask(
+      std::bind(&ClientInterfaceImpl::OnLinkStatsRefreshTimer, this),
+      interval_ms,
+      interval_ms / 10);
+}
+
 bool ClientInterfaceImpl::IsAssociated() const {
-  return is_associated_;
+  return associated_bss_.IsAssociated();
 }
 
 void ClientInterfaceImpl::SendMgmtFrame(const vector<uint8_t>& frame,
     const sp<ISendMgmtFrameEvent>& callback, int32_t mcs) {
+  StartFrameTx(frame, mcs,
+      [callback](int32_t failure_reason, int32_t elapsed_time_ms) {
+        if (failure_reason == 0) {
+          callback->OnAck(elapsed_time_ms);
+        } else {
+          callback->OnFailure(failure_reason);
+        }
+      });
+}
+
+void ClientInterfaceImpl::SendMgmtFrameBatch(
+    const vector<uint8_t>& frame,
+    const sp<ISendMgmtFrameBatchEvent>& callback,
+    const vector<int32_t>& mcs_rates,
+    int32_t spacing_ms) {
+  if (mcs_rates.empty()) {
+    callback->OnResults({}, {});
+    return;
+  }
+  unique_ptr<FrameTxBatch> batch(new FrameTxBatch{
+      frame, callback, mcs_rates, spacing_ms,
+      vector<int32_t>(mcs_rates.size(), 0),
+      vector<int32_t>(mcs_rates.size(), 0),
+      0, 0, EventLoop::kInvalidTimerId});
+  FrameTxBatch* batch_ptr = batch.get();
+  frame_tx_batches_.push_back(std::move(batch));
+  SendNextFrameOfBatch(batch_ptr);
+}
+
+void ClientInterfaceImpl::SendNextFrameOfBatch(FrameTxBatch* batch) {
+  size_t index = batch->num_frames_sent++;
+  batch->next_frame_timer = EventLoop::kInvalidTimerId;
+  if (batch->num_frames_sent < batch->mcs_rates.size()) {
+    batch->next_frame_timer = event_loop_->PostCancelableDelayedTask(
+        std::bind(&ClientInterfaceImpl::SendNextFrameOfBatch, this, batch),
+        batch->spacing_ms,
+        0);
+  }
+  // The last frame may complete the batch right away, which frees |batch|.
+  StartFrameTx(batch->frame, batch->mcs_rates[index],
+               std::bind(&ClientInterfaceImpl::OnBatchFrameTxDone, this,
+                         batch, index, _1, _2));
+}
+
+void ClientInterfaceImpl::OnBatchFrameTxDone(FrameTxBatch* batch,
+                                             size_t index,
+                                             int32_t failure_reason,
+                                             int32_t elapsed_time_ms) {
+  batch->failure_reasons[index] = failure_reason;
+  batch->elapsed_time_ms[index] = elapsed_time_ms;
+  if (++batch->num_frames_done < batch->mcs_rates.size()) {
+    return;
+  }
+  batch->callback->OnResults(batch->elapsed_time_ms, batch->failure_reasons);
+  frame_tx_batches_.erase(
+      std::find_if(frame_tx_batches_.begin(), frame_tx_batches_.end(),
+                   [batch](const unique_ptr<FrameTxBatch>& other) {
+                     return other.get() == batch;
+                   }));
+}
+
+void ClientInterfaceImpl::StartFrameTx(const vector<uint8_t>& frame,
+                                       int32_t mcs,
+                                       FrameTxDoneHandler done_handler) {
   if (mcs >= 0 && !wiphy_features_.supports_tx_mgmt_frame_mcs) {
-    callback->OnFailure(
-        ISendMgmtFrameEvent::SEND_MGMT_FRAME_ERROR_MCS_UNSUPPORTED);
+    done_handler(ISendMgmtFrameEvent::SEND_MGMT_FRAME_ERROR_MCS_UNSUPPORTED, 0);
+    return;
+  }
+  if (pending_frame_txs_.size() >= kMaxPendingFrameTxs) {
+    LOG(WARNING) << "Too many management frames in flight";
+    done_handler(ISendMgmtFrameEvent::SEND_MGMT_FRAME_ERROR_ALREADY_STARTED, 0);
     return;
   }
 
   uint64_t cookie;
   if (!netlink_utils_->SendMgmtFrame(interface_index_, frame, mcs, &cookie)) {
-    callback->OnFailure(ISendMgmtFrameEvent::SEND_MGMT_FRAME_ERROR_UNKNOWN);
+    done_handler(ISendMgmtFrameEvent::SEND_MGMT_FRAME_ERROR_UNKNOWN, 0);
     return;
   }
 
-  frame_tx_in_progress_ = true;
-  frame_tx_status_cookie_ = cookie;
-  nsecs_t start_time_ns = systemTime(SYSTEM_TIME_MONOTONIC);
-  on_frame_tx_status_event_handler_ =
-      [callback, start_time_ns](bool was_acked) {
-        if (was_acked) {
-          nsecs_t end_time_ns = systemTime(SYSTEM_TIME_MONOTONIC);
-          int32_t elapsed_time_ms = static_cast<int32_t>(
-              nanoseconds_to_milliseconds(end_time_ns - start_time_ns));
-          callback->OnAck(elapsed_time_ms);
-        } else {
-          callback->OnFailure(
-              ISendMgmtFrameEvent::SEND_MGMT_FRAME_ERROR_NO_ACK);
-        }
-      };
+  // Timeouts need not be precise, so they can share wakeups.
+  EventLoop::TimerId timeout_timer = event_loop_->PostCancelableDelayedTask(
+      std::bind(&ClientInterfaceImpl::OnFrameTxTimeout, this, cookie),
+      kFrameTxTimeoutMs,
+      kFrameTxTimeoutMs / 10);
+  pending_frame_txs_.push_back({cookie, std::move(done_handler),
+                                systemTime(SYSTEM_TIME_MONOTONIC),
+                                timeout_timer});
+}
+
+void ClientInterfaceImpl::OnFrameTxStatusEvent(uint64_t cookie,
+                                               bool was_acked) {
+  auto frame_tx = FindPendingFrameTx(cookie);
+  if (frame_tx == pending_frame_txs_.end()) {
+    return;
+  }
+  event_loop_->CancelDelayedTask(frame_tx->timeout_timer);
+  FrameTxDoneHandler done_handler = std::move(frame_tx->done_handler);
+  nsecs_t start_time_ns = frame_tx->start_time_ns;
+  pending_frame_txs_.erase(frame_tx);
+
+  if (was_acked) {
+    nsecs_t end_time_ns = systemTime(SYSTEM_TIME_MONOTONIC);
+    int32_t elapsed_time_ms = static_cast<int32_t>(
+        nanoseconds_to_milliseconds(end_time_ns - start_time_ns));
+    done_handler(0, elapsed_time_ms);
+  } else {
+    done_handler(ISendMgmtFrameEvent::SEND_MGMT_FRAME_ERROR_NO_ACK, 0);
+  }
+}
+
+void ClientInterfaceImpl::OnFrameTxTimeout(uint64_t cookie) {
+  auto frame_tx = FindPendingFrameTx(cookie);
+  if (frame_tx == pending_frame_txs_.end()) {
+    return;
+  }
+  LOG(WARNING) << "No tx status for management frame with cookie " << cookie;
+  FrameTxDoneHandler done_handler = std::move(frame_tx->done_handler);
+  pending_frame_txs_.erase(frame_tx);
+  done_handler(ISendMgmtFrameEvent::SEND_MGMT_FRAME_ERROR_TIMEOUT, 0);
+}
+
+vector<ClientInterfaceImpl::PendingFrameTx>::iterator
+ClientInterfaceImpl::FindPendingFrameTx(uint64_t cookie) {
+  return std::find_if(pending_frame_txs_.begin(), pending_frame_txs_.end(),
+                      [cookie](const PendingFrameTx& frame_tx) {
+                        return frame_tx.cookie == cookie;
+                      });
 }
 
 }  // namespace wificond
@@ -18,16 +18,28 @@
 #define WIFICOND_CLIENT_INTERFACE_IMPL_H_
 
 #include <array>
+#include <functional>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <linux/if_ether.h>
 
 #include <android-base/macros.h>
+#include <android-base/unique_fd.h>
+#include <binder/IBinder.h>
 #include <utils/StrongPointer.h>
+#include <utils/Timers.h>
 #include <wifi_system/interface_tool.h>
 
 #include "android/net/wifi/nl80211/IClientInterface.h"
+#include "android/net/wifi/nl80211/ILinkQualityEventCallback.h"
+#include "android/net/wifi/nl80211/ISendMgmtFrameBatchEvent.h"
 #include "android/net/wifi/nl80211/ISendMgmtFrameEvent.h"
+#include "wificond/associated_bss.h"
+#include "wificond/connection_timeline.h"
+#include "wificond/event_loop.h"
+#include "wificond/link_stats_page.h"
 #include "wificond/net/mlme_event_handler.h"
 #include "wificond/net/netlink_utils.h"
 #include "wificond/scanning/scanner_impl.h"
@@ -37,6 +49,7 @@ namespace wificond {
 
 class ClientInterfaceBinder;
 class ClientInterfaceImpl;
+class LinkStatsTokenDeathRecipient;
 class ScanUtils;
 
 class MlmeEventHandlerImpl : public MlmeEventHandler {
@@ -45,6 +58,7 @@ class MlmeEventHandlerImpl : public MlmeEventHandler {
   ~MlmeEventHandlerImpl() override;
   void OnConnect(std::unique_ptr<MlmeConnectEvent> event) override;
   void OnRoam(std::unique_ptr<MlmeRoamEvent> event) override;
+  void OnAuthenticate(std::unique_ptr<MlmeAuthenticateEvent> event) override;
   void OnAssociate(std::unique_ptr<MlmeAssociateEvent> event) override;
   void OnDisconnect(std::unique_ptr<MlmeDisconnectEvent> event) override;
   void OnDisassociate(std::unique_ptr<MlmeDisassociateEvent> event) override;
@@ -68,7 +82,8 @@ class ClientInterfaceImpl {
       const std::array<uint8_t, ETH_ALEN>& interface_mac_addr,
       android::wifi_system::InterfaceTool* if_tool,
       NetlinkUtils* netlink_utils,
-      ScanUtils* scan_utils);
+      ScanUtils* scan_utils,
+      EventLoop* event_loop);
   virtual ~ClientInterfaceImpl();
 
   // Get a pointer to the binder representing this ClientInterfaceImpl.
@@ -76,19 +91,153 @@ class ClientInterfaceImpl {
 
   bool GetPacketCounters(std::vector<int32_t>* out_packet_counters);
   bool SignalPoll(std::vector<int32_t>* out_signal_poll_results);
+  // Same as SignalPoll() followed by GetPacketCounters(), with a single
+  // station info request.
+  bool PollStationInfo(std::vector<int32_t>* out_station_info);
   const std::array<uint8_t, ETH_ALEN>& GetMacAddress();
   const std::string& GetInterfaceName() const { return interface_name_; }
+  uint32_t GetWiphyIndex() const { return wiphy_index_; }
+  const BandInfo& GetBandInfo() const { return band_info_; }
   const android::sp<ScannerImpl> GetScanner() { return scanner_; };
   virtual bool IsAssociated() const;
   void Dump(std::stringstream* ss) const;
+  // Calls the callbacks of the framework through |dispatcher| instead of on
+  // the event loop thread. |dispatcher| must outlive this interface.
+  void SetCallbackDispatcher(CallbackDispatcher* dispatcher);
+  // In low power mode, the link statistics memory is refreshed at most every
+  // |kLowPowerLinkStatsRefreshIntervalMs| by its periodic refresh.
+  void SetLowPowerMode(bool enabled);
+  // Sends |frame| and reports to |callback| whether it was acked.
+  // Up to |kMaxPendingFrameTxs| frames can be in flight at once. A frame whose
+  // tx status was not reported within |kFrameTxTimeoutMs| fails with
+  // SEND_MGMT_FRAME_ERROR_TIMEOUT.
   void SendMgmtFrame(
       const std::vector<uint8_t>& frame,
       const sp<::android::net::wifi::nl80211::ISendMgmtFrameEvent>& callback,
       int32_t mcs);
+  // Sends |frame| once at each MCS rate of |mcs_rates|, |spacing_ms| apart,
+  // and reports the results of all frames to |callback| at once.
+  void SendMgmtFrameBatch(
+      const std::vector<uint8_t>& frame,
+      const sp<::android::net::wifi::nl80211::ISendMgmtFrameBatchEvent>&
+          callback,
+      const std::vector<int32_t>& mcs_rates,
+      int32_t spacing_ms);
+  // Configures the connection quality monitor of the driver and forwards its
+  // events to |callback|, which replaces any previously registered one.
+  // Tx errors are only monitored if |tx_error_rate_percent| is non-zero.
+  // Returns false if the driver rejects the configuration.
+  bool RegisterLinkQualityCallback(
+      const sp<::android::net::wifi::nl80211::ILinkQualityEventCallback>&
+          callback,
+      int32_t rssi_threshold_dbm,
+      uint32_t rssi_hysteresis_db,
+      uint32_t tx_error_rate_percent);
+  void UnregisterLinkQualityCallback();
+  // Publishes the link statistics in shared memory, refreshed on connection
+  // and connection quality monitor events, and every |refresh_interval_ms|
+  // while associated, unless it is 0. Intervals below
+  // IClientInterface::MIN_LINK_STATS_REFRESH_INTERVAL_MS are rounded up.
+  // The memory is released like with DisableLinkStatsPage() when |token|,
+  // a binder of the caller, dies.
+  // Returns false if the shared memory cannot be created, otherwise
+  // |*out_memory| is a read-only fd of it.
+  bool EnableLinkStatsPage(const android::sp<android::IBinder>& token,
+                           int32_t refresh_interval_ms,
+                           android::base::unique_fd* out_memory);
+  // Stops refreshing the link statistics. Existing mappings of the memory
+  // stay valid.
+  void DisableLinkStatsPage();
+  void GetConnectionStats(
+      ::android::net::wifi::nl80211::NativeConnectionStats*
+          out_connection_stats) const;
+
+  static constexpr size_t kMaxPendingFrameTxs = 8;
+  static constexpr int32_t kLowPowerLinkStatsRefreshIntervalMs = 10000;
+  static constexpr int64_t kFrameTxTimeoutMs = 1000;
 
  private:
+  // Called when a frame was acked or failed. |failure_reason| is 0 if it was
+  // acked, or one of the ISendMgmtFrameEvent::SEND_MGMT_FRAME_ERROR_* codes.
+  // |elapsed_time_ms| is the time until the ack, or 0 on failure.
+  typedef std::function<void(int32_t failure_reason, int32_t elapsed_time_ms)>
+      FrameTxDoneHandler;
+
+  // A management frame waiting for its tx status.
+  struct PendingFrameTx {
+    uint64_t cookie;
+    FrameTxDoneHandler done_handler;
+    // Monotonic time the frame was sent at.
+    nsecs_t start_time_ns;
+    EventLoop::TimerId timeout_timer;
+  };
+
+  // Frames of a SendMgmtFrameBatch() call.
+  struct FrameTxBatch {
+    std::vector<uint8_t> frame;
+    sp<::android::net::wifi::nl80211::ISendMgmtFrameBatchEvent> callback;
+    std::vector<int32_t> mcs_rates;
+    int32_t spacing_ms;
+    // Results, indexed like |mcs_rates|.
+    std::vector<int32_t> elapsed_time_ms;
+    std::vector<int32_t> failure_reasons;
+    size_t num_frames_sent;
+    size_t num_frames_done;
+    // Timer for sending the next frame, if any.
+    EventLoop::TimerId next_frame_timer;
+  };
+
+  // Sends |frame| and calls |done_handler| once it was acked or failed,
+  // which may happen before this returns.
+  void StartFrameTx(const std::vector<uint8_t>& frame,
+                    int32_t mcs,
+                    FrameTxDoneHandler done_handler);
+  void SendNextFrameOfBatch(FrameTxBatch* batch);
+  void OnBatchFrameTxDone(FrameTxBatch* batch,
+                          size_t index,
+                          int32_t failure_reason,
+                          int32_t elapsed_time_ms);
+  void OnFrameTxStatusEvent(uint64_t cookie, bool was_acked);
+  void OnFrameTxTimeout(uint64_t cookie);
+  // Returns the pending frame tx of |cookie|, or |pending_frame_txs_.end()|.
+  std::vector<PendingFrameTx>::iterator FindPendingFrameTx(uint64_t cookie);
+  // Makes the next scan result query fetch the association status of all
+  // BSSs from kernel.
+  void InvalidateScanResultCache();
+  // Updates |associated_bss_| after a connect or roam.
+  // |event_frequency| is the frequency reported by the MLME event, or 0 if
+  // the event did not report it, in which case it is queried from kernel.
+  void OnAssociated(const std::array<uint8_t, ETH_ALEN>& bssid,
+                    uint32_t event_frequency,
+                    const std::vector<uint8_t>& request_ies,
+                    const std::vector<uint8_t>& response_ies);
+  // Returns the frequency of the associated BSS, querying kernel if no
+  // event reported it yet, or 0 if it is unknown.
+  uint32_t GetAssociateFreq();
+  // Queries kernel for the frequency of the associated BSS into
+  // |associated_bss_|.
+  // Returns true on success.
   bool RefreshAssociateFreq();
-  bool OnChannelSwitchEvent(uint32_t frequency);
+  bool OnChannelSwitchEvent(uint32_t frequency, ChannelBandwidth bandwidth);
+  void OnCqmEvent(CqmEvent event, int32_t rssi_dbm, uint32_t packets);
+  // Gets the station info of the associated AP.
+  // The framework polls the signal and the packet counters back to back, so
+  // station info fetched for the same association within a short window is
+  // served from |associated_bss_|.
+  // Returns true on success.
+  bool GetStationInfo(StationInfo* out_station_info);
+  void AppendSignalPollResults(const StationInfo& station_info,
+                               std::vector<int32_t>* out_signal_poll_results);
+  // Publishes the current link statistics to |link_stats_page_|, if any,
+  // and starts or stops its periodic refresh as the association changes.
+  void RefreshLinkStatsPage();
+  void UpdateLinkStatsPage();
+  void OnLinkStatsRefreshTimer();
+  // Schedules the next periodic refresh of |link_stats_page_|, if any and
+  // associated.
+  void ScheduleLinkStatsRefresh();
+  // Stops watching the death of |link_stats_token_|.
+  void UnlinkLinkStatsToken();
 
   const uint32_t wiphy_index_;
   const std::string interface_name_;
@@ -97,24 +246,42 @@ class ClientInterfaceImpl {
   android::wifi_system::InterfaceTool* const if_tool_;
   NetlinkUtils* const netlink_utils_;
   ScanUtils* const scan_utils_;
+  EventLoop* const event_loop_;
   const std::unique_ptr<MlmeEventHandlerImpl> mlme_event_handler_;
   const android::sp<ClientInterfaceBinder> binder_;
   android::sp<ScannerImpl> scanner_;
 
-  // Cached information for this connection.
-  bool is_associated_;
-  std::array<uint8_t, ETH_ALEN> bssid_;
-  uint32_t associate_freq_;
+  // Cached information for this connection, and the last station info
+  // fetched from kernel.
+  AssociatedBss associated_bss_;
+  // MLME events and connect and roam latencies of this interface.
+  ConnectionTimeline connection_timeline_;
 
   // Capability information for this wiphy/interface.
   BandInfo band_info_;
   ScanCapabilities scan_capabilities_;
   WiphyFeatures wiphy_features_;
 
-  // handler for frame tx status messages
-  bool frame_tx_in_progress_;
-  uint64_t frame_tx_status_cookie_;
-  std::function<void(bool was_acked)> on_frame_tx_status_event_handler_;
+  // Management frames waiting for their tx status, in the order they were
+  // sent. There are only a few, so this is searched linearly.
+  std::vector<PendingFrameTx> pending_frame_txs_;
+  // Batches with frames left to send or waiting for their tx status.
+  std::vector<std::unique_ptr<FrameTxBatch>> frame_tx_batches_;
+
+  // Receiver of connection quality monitor events, if any.
+  sp<::android::net::wifi::nl80211::ILinkQualityEventCallback>
+      link_quality_callback_;
+
+  // Shared memory with the link statistics, if enabled.
+  std::unique_ptr<LinkStatsPage> link_stats_page_;
+  // Periodic refresh interval of |link_stats_page_|, or 0 for none.
+  int32_t link_stats_refresh_interval_ms_;
+  EventLoop::TimerId link_stats_refresh_timer_;
+  // Binder of the caller of EnableLinkStatsPage(), and the recipient of its
+  // death.
+  android::sp<android::IBinder> link_stats_token_;
+  android::sp<LinkStatsTokenDeathRecipient> link_stats_death_recipient_;
+  bool low_power_mode_;
 
   DISALLOW_COPY_AND_ASSIGN(ClientInterfaceImpl);
   friend class MlmeEventHandlerImpl;
@@ -0,0 +1,269 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/connection_timeline.h"
+
+#include <algorithm>
+
+#include "android/net/wifi/nl80211/IClientInterface.h"
+#include "wificond/logging_utils.h"
+
+using android::net::wifi::nl80211::IClientInterface;
+using android::net::wifi::nl80211::NativeConnectionEvent;
+using std::array;
+using std::endl;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr int64_t kNanosPerMilli = 1000000;
+
+bool IsZeroBssid(const array<uint8_t, ETH_ALEN>& bssid) {
+  return std::all_of(bssid.begin(), bssid.end(),
+                     [](uint8_t byte) { return byte == 0; });
+}
+
+vector<uint8_t> BssidToVector(const array<uint8_t, ETH_ALEN>& bssid) {
+  if (IsZeroBssid(bssid)) {
+    return {};
+  }
+  return vector<uint8_t>(bssid.begin(), bssid.end());
+}
+
+const char* GetEventTypeString(int32_t type) {
+  switch (type) {
+    case IClientInterface::CONNECTION_EVENT_AUTHENTICATE:
+      return "authenticate";
+    case IClientInterface::CONNECTION_EVENT_ASSOCIATE:
+      return "associate";
+    case IClientInterface::CONNECTION_EVENT_CONNECT:
+      return "connect";
+    case IClientInterface::CONNECTION_EVENT_ROAM:
+      return "roam";
+    case IClientInterface::CONNECTION_EVENT_DISCONNECT:
+      return "disconnect";
+    case IClientInterface::CONNECTION_EVENT_DISASSOCIATE:
+      return "disassociate";
+  }
+  return "unknown";
+}
+
+std::string GetBssidString(const vector<uint8_t>& bssid) {
+  if (bssid.size() != ETH_ALEN) {
+    return "none";
+  }
+  array<uint8_t, ETH_ALEN> mac;
+  std::copy(bssid.begin(), bssid.end(), mac.begin());
+  return LoggingUtils::GetMacString(mac);
+}
+
+void DumpHistogram(const vector<int32_t>& bounds_ms,
+                   const vector<int32_t>& histogram,
+                   std::stringstream* ss) {
+  for (size_t i = 0; i < histogram.size(); i++) {
+    if (i < bounds_ms.size()) {
+      *ss << " <=" << bounds_ms[i] << ": " << histogram[i];
+    } else {
+      *ss << " >" << bounds_ms.back() << ": " << histogram[i];
+    }
+  }
+  *ss << endl;
+}
+
+}  // namespace
+
+constexpr std::array<int32_t, 6> ConnectionTimeline::kLatencyBucketBoundsMs;
+
+ConnectionTimeline::ConnectionTimeline()
+    : is_associated_(false),
+      bssid_{},
+      attempt_start_ns_(0) {
+  stats_.latency_bucket_bounds_ms_.assign(kLatencyBucketBoundsMs.begin(),
+                                          kLatencyBucketBoundsMs.end());
+  stats_.connect_latency_histogram_.assign(kLatencyBucketBoundsMs.size() + 1,
+                                           0);
+  stats_.roam_latency_histogram_.assign(kLatencyBucketBoundsMs.size() + 1, 0);
+}
+
+void ConnectionTimeline::OnAuthenticate(int64_t timestamp_ns,
+                                        const array<uint8_t, ETH_ALEN>& bssid,
+                                        bool is_timeout) {
+  NativeConnectionEvent* event = AddEvent(
+      IClientInterface::CONNECTION_EVENT_AUTHENTICATE, timestamp_ns, bssid);
+  event->is_timeout_ = is_timeout;
+  if (is_timeout) {
+    stats_.num_connect_failures_++;
+    attempt_start_ns_ = 0;
+    return;
+  }
+  // Some authentication methods, e.g. SAE, take several authentication
+  // frames, which all belong to the same attempt.
+  if (attempt_start_ns_ == 0 ||
+      timestamp_ns - attempt_start_ns_ > kMaxAttemptMs * kNanosPerMilli) {
+    attempt_start_ns_ = timestamp_ns;
+  }
+}
+
+void ConnectionTimeline::OnAssociate(int64_t timestamp_ns,
+                                     const array<uint8_t, ETH_ALEN>& bssid,
+                                     uint16_t status_code,
+                                     bool is_timeout) {
+  OnAssociationResult(IClientInterface::CONNECTION_EVENT_ASSOCIATE,
+                      timestamp_ns, bssid, status_code, is_timeout);
+}
+
+void ConnectionTimeline::OnConnect(int64_t timestamp_ns,
+                                   const array<uint8_t, ETH_ALEN>& bssid,
+                                   uint16_t status_code,
+                                   bool is_timeout) {
+  OnAssociationResult(IClientInterface::CONNECTION_EVENT_CONNECT,
+                      timestamp_ns, bssid, status_code, is_timeout);
+}
+
+void ConnectionTimeline::OnRoam(int64_t timestamp_ns,
+                                const array<uint8_t, ETH_ALEN>& bssid) {
+  OnAssociationResult(IClientInterface::CONNECTION_EVENT_ROAM,
+                      timestamp_ns, bssid, 0, false);
+}
+
+void ConnectionTimeline::OnDisconnect(int64_t timestamp_ns) {
+  OnAssociationLost(IClientInterface::CONNECTION_EVENT_DISCONNECT,
+                    timestamp_ns);
+}
+
+void ConnectionTimeline::OnDisassociate(int64_t timestamp_ns) {
+  OnAssociationLost(IClientInterface::CONNECTION_EVENT_DISASSOCIATE,
+                    timestamp_ns);
+}
+
+void ConnectionTimeline::OnAssociationResult(
+    int32_t type,
+    int64_t timestamp_ns,
+    const array<uint8_t, ETH_ALEN>& bssid,
+    uint16_t status_code,
+    bool is_timeout) {
+  NativeConnectionEvent* event = AddEvent(type, timestamp_ns, bssid);
+  event->status_code_ = status_code;
+  event->is_timeout_ = is_timeout;
+  if (is_timeout || status_code != 0) {
+    stats_.num_connect_failures_++;
+    is_associated_ = false;
+    bssid_.fill(0);
+    attempt_start_ns_ = 0;
+    return;
+  }
+  // Drivers with the SME in kernel report a connect event after the
+  // association event of the same BSS.
+  if (is_associated_ && bssid == bssid_) {
+    return;
+  }
+  bool is_roam = is_associated_;
+  if (is_roam) {
+    stats_.num_roams_++;
+  } else {
+    stats_.num_connects_++;
+  }
+  if (attempt_start_ns_ != 0 &&
+      timestamp_ns - attempt_start_ns_ <= kMaxAttemptMs * kNanosPerMilli) {
+    event->latency_ms_ =
+        static_cast<int32_t>((timestamp_ns - attempt_start_ns_) /
+                             kNanosPerMilli);
+    AddLatency(event->latency_ms_,
+               is_roam ? &stats_.roam_latency_histogram_
+                       : &stats_.connect_latency_histogram_);
+  }
+  attempt_start_ns_ = 0;
+  is_associated_ = true;
+  bssid_ = bssid;
+}
+
+void ConnectionTimeline::OnAssociationLost(int32_t type,
+                                           int64_t timestamp_ns) {
+  array<uint8_t, ETH_ALEN> no_bssid{};
+  AddEvent(type, timestamp_ns, no_bssid);
+  // A disassociation is usually followed by a disconnect.
+  if (is_associated_) {
+    stats_.num_disconnects_++;
+  }
+  is_associated_ = false;
+  bssid_.fill(0);
+  attempt_start_ns_ = 0;
+}
+
+NativeConnectionEvent* ConnectionTimeline::AddEvent(
+    int32_t type,
+    int64_t timestamp_ns,
+    const array<uint8_t, ETH_ALEN>& bssid) {
+  vector<NativeConnectionEvent>& events = stats_.events_;
+  if (events.size() == kMaxEvents) {
+    events.erase(events.begin());
+  }
+  events.emplace_back();
+  NativeConnectionEvent* event = &events.back();
+  event->type_ = type;
+  event->timestamp_ns_ = timestamp_ns;
+  event->bssid_ = BssidToVector(bssid);
+  if (is_associated_) {
+    event->previous_bssid_ = BssidToVector(bssid_);
+  }
+  return event;
+}
+
+void ConnectionTimeline::AddLatency(int32_t latency_ms,
+                                    vector<int32_t>* histogram) {
+  size_t bucket = std::lower_bound(kLatencyBucketBoundsMs.begin(),
+                                   kLatencyBucketBoundsMs.end(),
+                                   latency_ms) -
+                  kLatencyBucketBoundsMs.begin();
+  (*histogram)[bucket]++;
+}
+
+void ConnectionTimeline::Dump(std::stringstream* ss) const {
+  *ss << "Connection stats:" << endl;
+  *ss << "Connects: " << stats_.num_connects_
+      << ", failures: " << stats_.num_connect_failures_
+      << ", roams: " << stats_.num_roams_
+      << ", disconnects: " << stats_.num_disconnects_ << endl;
+  *ss << "Connect latency histogram in ms:";
+  DumpHistogram(stats_.latency_bucket_bounds_ms_,
+                stats_.connect_latency_histogram_, ss);
+  *ss << "Roam latency histogram in ms:";
+  DumpHistogram(stats_.latency_bucket_bounds_ms_,
+                stats_.roam_latency_histogram_, ss);
+  *ss << "Latest MLME events:" << endl;
+  for (const auto& event : stats_.events_) {
+    *ss << event.timestamp_ns_ / kNanosPerMilli << " ms "
+        << GetEventTypeString(event.type_)
+        << ", bssid " << GetBssidString(event.bssid_)
+        << ", previous bssid " << GetBssidString(event.previous_bssid_);
+    if (event.status_code_ != 0) {
+      *ss << ", status code " << event.status_code_;
+    }
+    if (event.is_timeout_) {
+      *ss << ", timed out";
+    }
+    if (event.latency_ms_ >= 0) {
+      *ss << ", latency " << event.latency_ms_ << " ms";
+    }
+    *ss << endl;
+  }
+}
+
+}  // namespace wificond
+}  // namespace android
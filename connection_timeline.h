@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_CONNECTION_TIMELINE_H_
+#define WIFICOND_CONNECTION_TIMELINE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <sstream>
+#include <vector>
+
+#include <linux/if_ether.h>
+
+#include <android-base/macros.h>
+
+#include "wificond/client/native_connection_stats.h"
+
+namespace android {
+namespace wificond {
+
+// Keeps the MLME events of a client interface, and how long its connects
+// and roams took.
+//
+// A connection attempt starts with an authentication, and is measured until
+// the association or connect event that completes it. An association while
+// not associated is a connect, and one with another BSS while associated is
+// a roam. Drivers that connect and roam on their own only send the final
+// connect or roam event, so those are counted without a latency.
+class ConnectionTimeline {
+ public:
+  // Number of events kept.
+  static constexpr size_t kMaxEvents = 32;
+  // Inclusive upper bounds of the latency histogram buckets.
+  static constexpr std::array<int32_t, 6> kLatencyBucketBoundsMs = {
+      {50, 100, 200, 500, 1000, 2000}};
+  // Attempts that were not completed within this time are dropped, so that
+  // a lost event does not make the next attempt look slow.
+  static constexpr int64_t kMaxAttemptMs = 10000;
+
+  ConnectionTimeline();
+
+  // |timestamp_ns| are CLOCK_BOOTTIME timestamps of the events.
+  void OnAuthenticate(int64_t timestamp_ns,
+                      const std::array<uint8_t, ETH_ALEN>& bssid,
+                      bool is_timeout);
+  void OnAssociate(int64_t timestamp_ns,
+                   const std::array<uint8_t, ETH_ALEN>& bssid,
+                   uint16_t status_code,
+                   bool is_timeout);
+  void OnConnect(int64_t timestamp_ns,
+                 const std::array<uint8_t, ETH_ALEN>& bssid,
+                 uint16_t status_code,
+                 bool is_timeout);
+  void OnRoam(int64_t timestamp_ns,
+              const std::array<uint8_t, ETH_ALEN>& bssid);
+  void OnDisconnect(int64_t timestamp_ns);
+  void OnDisassociate(int64_t timestamp_ns);
+
+  const android::net::wifi::nl80211::NativeConnectionStats& GetStats() const {
+    return stats_;
+  }
+  void Dump(std::stringstream* ss) const;
+
+ private:
+  // Adds an event to the timeline. |bssid| is all zeros if the event did not
+  // tell.
+  android::net::wifi::nl80211::NativeConnectionEvent* AddEvent(
+      int32_t type,
+      int64_t timestamp_ns,
+      const std::array<uint8_t, ETH_ALEN>& bssid);
+  void OnAssociationResult(int32_t type,
+                           int64_t timestamp_ns,
+                           const std::array<uint8_t, ETH_ALEN>& bssid,
+                           uint16_t status_code,
+                           bool is_timeout);
+  void OnAssociationLost(int32_t type, int64_t timestamp_ns);
+  static void AddLatency(int32_t latency_ms, std::vector<int32_t>* histogram);
+
+  android::net::wifi::nl80211::NativeConnectionStats stats_;
+  bool is_associated_;
+  std::array<uint8_t, ETH_ALEN> bssid_;
+  // CLOCK_BOOTTIME timestamp of the authentication that started the ongoing
+  // attempt, or 0 if there is none.
+  int64_t attempt_start_ns_;
+
+  DISALLOW_COPY_AND_ASSIGN(ConnectionTimeline);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_CONNECTION_TIMELINE_H_
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "device_wiphy_info.h"
+
+#include <android-base/logging.h>
+
+#include "wificond/parcelable_utils.h"
+
+using android::status_t;
+
+namespace android {
+namespace net {
+namespace wifi {
+namespace nl80211 {
+
+status_t DeviceWiphyInfo::writeToParcel(::android::Parcel* parcel) const {
+  RETURN_IF_FAILED(parcel->writeInt32Vector(band2gChannels_));
+  RETURN_IF_FAILED(parcel->writeInt32Vector(band5gNonDfsChannels_));
+  RETURN_IF_FAILED(parcel->writeInt32Vector(bandDfsChannels_));
+  RETURN_IF_FAILED(parcel->writeInt32Vector(band6gChannels_));
+  RETURN_IF_FAILED(capabilities_.writeToParcel(parcel));
+  return ::android::OK;
+}
+
+status_t DeviceWiphyInfo::readFromParcel(const ::android::Parcel* parcel) {
+  RETURN_IF_FAILED(parcel->readInt32Vector(&band2gChannels_));
+  RETURN_IF_FAILED(parcel->readInt32Vector(&band5gNonDfsChannels_));
+  RETURN_IF_FAILED(parcel->readInt32Vector(&bandDfsChannels_));
+  RETURN_IF_FAILED(parcel->readInt32Vector(&band6gChannels_));
+  RETURN_IF_FAILED(capabilities_.readFromParcel(parcel));
+  return ::android::OK;
+}
+
+}  // namespace nl80211
+}  // namespace wifi
+}  // namespace net
+}  // namespace android
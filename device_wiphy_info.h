@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_DEVICE_WIPHY_INFO_H_
+#define WIFICOND_DEVICE_WIPHY_INFO_H_
+
+#include <vector>
+
+#include <binder/Parcel.h>
+#include <binder/Parcelable.h>
+
+#include "wificond/device_wiphy_capabilities.h"
+
+namespace android {
+namespace net {
+namespace wifi {
+namespace nl80211 {
+
+// Available channels and capabilities of a wiphy, bundled so that they can
+// be fetched with a single binder transaction.
+class DeviceWiphyInfo : public ::android::Parcelable {
+ public:
+  DeviceWiphyInfo() = default;
+  bool operator==(const DeviceWiphyInfo& rhs) const {
+    return (band2gChannels_ == rhs.band2gChannels_
+            && band5gNonDfsChannels_ == rhs.band5gNonDfsChannels_
+            && bandDfsChannels_ == rhs.bandDfsChannels_
+            && band6gChannels_ == rhs.band6gChannels_
+            && capabilities_ == rhs.capabilities_);
+  }
+  ::android::status_t writeToParcel(::android::Parcel* parcel) const override;
+  ::android::status_t readFromParcel(const ::android::Parcel* parcel) override;
+
+  // Frequencies in MHz.
+  std::vector<int32_t> band2gChannels_;
+  std::vector<int32_t> band5gNonDfsChannels_;
+  std::vector<int32_t> bandDfsChannels_;
+  std::vector<int32_t> band6gChannels_;
+  DeviceWiphyCapabilities capabilities_;
+};
+
+}  // namespace nl80211
+}  // namespace wifi
+}  // namespace net
+}  // namespace android
+
+#endif  // WIFICOND_DEVICE_WIPHY_INFO_H_
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/dump_writer.h"
+
+#include <algorithm>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/strings.h>
+
+using android::base::Join;
+using android::base::WriteStringToFd;
+using std::string;
+using std::stringstream;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+DumpWriter::DumpWriter(int fd, const vector<string>& sections)
+    : fd_(fd),
+      picked_sections_(sections),
+      unknown_sections_(sections),
+      failed_(false) {
+}
+
+void DumpWriter::WriteSection(
+    const string& name,
+    const std::function<void(stringstream*)>& dump,
+    bool only_if_picked) {
+  if (std::find(section_names_.begin(), section_names_.end(), name) ==
+      section_names_.end()) {
+    section_names_.push_back(name);
+  }
+  unknown_sections_.erase(
+      std::remove(unknown_sections_.begin(), unknown_sections_.end(), name),
+      unknown_sections_.end());
+  if (failed_) {
+    return;
+  }
+  if (picked_sections_.empty() && only_if_picked) {
+    return;
+  }
+  if (!picked_sections_.empty() &&
+      std::find(picked_sections_.begin(), picked_sections_.end(), name) ==
+          picked_sections_.end()) {
+    return;
+  }
+  // Each section is flushed on its own, so that only one of them is held
+  // in memory at a time.
+  stringstream ss;
+  dump(&ss);
+  Write(ss.str());
+}
+
+bool DumpWriter::Finish() {
+  if (!unknown_sections_.empty()) {
+    Write("Unknown dump sections: " + Join(unknown_sections_, ", ") +
+          "\nDump sections: " + Join(section_names_, ", ") + "\n");
+    unknown_sections_.clear();
+  }
+  return !failed_;
+}
+
+bool DumpWriter::Write(const string& str) {
+  if (failed_) {
+    return false;
+  }
+  if (!WriteStringToFd(str, fd_)) {
+    PLOG(ERROR) << "Failed to dump state to fd " << fd_;
+    failed_ = true;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace wificond
+}  // namespace android
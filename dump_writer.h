@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_DUMP_WRITER_H_
+#define WIFICOND_DUMP_WRITER_H_
+
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <android-base/macros.h>
+
+namespace android {
+namespace wificond {
+
+// Writes dumpsys output to a file descriptor one section at a time, so that
+// a large dump is never built in memory as a whole. The sections to write
+// can be picked by name, e.g. with "dumpsys wificond netlink-stats".
+class DumpWriter {
+ public:
+  // Writes to |fd| the sections named in |sections|, or all sections if it
+  // is empty.
+  DumpWriter(int fd, const std::vector<std::string>& sections);
+  ~DumpWriter() = default;
+
+  // Appends the output of |dump| to |fd| if section |name| was picked.
+  // A section can be written in several parts, e.g. one per interface.
+  // Sections are skipped once a write failed.
+  // Sections that are |only_if_picked| are left out of dumps of all
+  // sections, e.g. bulky raw data.
+  void WriteSection(const std::string& name,
+                    const std::function<void(std::stringstream*)>& dump,
+                    bool only_if_picked = false);
+  // Writes the names of the picked sections that do not exist, if any,
+  // along with the names of all sections.
+  // Returns false if a write failed.
+  bool Finish();
+
+ private:
+  bool Write(const std::string& str);
+
+  const int fd_;
+  const std::vector<std::string> picked_sections_;
+  // Picked sections that were not seen yet.
+  std::vector<std::string> unknown_sections_;
+  std::vector<std::string> section_names_;
+  bool failed_;
+
+  DISALLOW_COPY_AND_ASSIGN(DumpWriter);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_DUMP_WRITER_H_
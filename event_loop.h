@@ -17,7 +17,10 @@
 #ifndef WIFICOND_EVENT_LOOP_H_
 #define WIFICOND_EVENT_LOOP_H_
 
+#include <cstdint>
 #include <functional>
+#include <sstream>
+#include <string>
 
 namespace android {
 namespace wificond {
@@ -30,18 +33,68 @@ class EventLoop {
       kModeOutput
   };
 
+  // Urgency of a posted task.
+  // |kPriorityHigh| is meant for latency critical work like MLME events and
+  // frame tx status, and |kPriorityLow| for bulk work like parsing scan
+  // results.
+  enum TaskPriority {
+      kPriorityHigh,
+      kPriorityNormal,
+      kPriorityLow
+  };
+
+  // Identifies a task posted with |PostCancelableDelayedTask|.
+  typedef uint64_t TimerId;
+  static constexpr TimerId kInvalidTimerId = 0;
+
   virtual ~EventLoop() {}
 
   // Enqueues a callback.
   // This function can be called on any thread.
   virtual void PostTask(const std::function<void()>& callback) = 0;
 
+  // Enqueues a callback with |priority|.
+  // Pending callbacks of a higher priority run first, and callbacks of the
+  // same priority run in the order they were posted. |PostTask| posts with
+  // |kPriorityNormal|.
+  // The default implementation ignores |priority|.
+  // This function can be called on any thread.
+  virtual void PostTaskWithPriority(const std::function<void()>& callback,
+                                    TaskPriority priority) {
+    PostTask(callback);
+  }
+
   // Enqueues a callback to be processed after a specified period of time.
   // |delay_ms| is delay time in milliseconds. It should not be negative.
   // This function can be called on any thread.
   virtual void PostDelayedTask(const std::function<void()>& callback,
                                int64_t delay_ms) = 0;
 
+  // Like |PostDelayedTask|, but the callback may run up to |slack_ms|
+  // milliseconds late, and it can be canceled with |CancelDelayedTask|.
+  // Callbacks whose windows overlap can then share one wakeup, which saves
+  // CPU wakeups for periodic work and timeouts that do not need to be
+  // precise.
+  // Returns the id of the timer.
+  // The default implementation ignores |slack_ms| and returns
+  // |kInvalidTimerId|, i.e. the callback cannot be canceled.
+  // This function can be called on any thread.
+  virtual TimerId PostCancelableDelayedTask(
+      const std::function<void()>& callback,
+      int64_t delay_ms,
+      int64_t slack_ms) {
+    PostDelayedTask(callback, delay_ms);
+    return kInvalidTimerId;
+  }
+
+  // Cancels the callback of timer |timer_id|.
+  // Returns true if the callback was pending, false if it already ran, was
+  // canceled before or |timer_id| is unknown.
+  // This function can be called on any thread.
+  virtual bool CancelDelayedTask(TimerId timer_id) {
+    return false;
+  }
+
   // Monitoring file descriptor for data.
   // Callback will be executed when specific file descriptor is ready.
   // File descriptor is provided as a parameter to this callback:
@@ -58,6 +111,18 @@ class EventLoop {
   // remove the file descriptor, or this file descriptor was not registered
   // for watching.
   virtual bool StopWatchFileDescriptor(int fd) = 0;
+
+  // Names file descriptor |fd| in the statistics appended by |Dump|, so that
+  // e.g. the netlink socket and the binder fd can be told apart.
+  // The default implementation does nothing.
+  // This function can be called on any thread.
+  virtual void SetFileDescriptorLabel(int fd, const std::string& label) {}
+
+  // Appends statistics about the latency of posted tasks and the run time of
+  // callbacks to |ss|.
+  // The default implementation does nothing.
+  // This function can be called on any thread.
+  virtual void Dump(std::stringstream* ss) const {}
 };
 
 }  // namespace wificond
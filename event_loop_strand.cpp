@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/event_loop_strand.h"
+
+#include <utility>
+
+using std::function;
+using std::weak_ptr;
+
+namespace android {
+namespace wificond {
+
+EventLoopStrand::EventLoopStrand(EventLoop* event_loop)
+    : event_loop_(event_loop),
+      tasks_(std::make_shared<Tasks>()) {
+}
+
+EventLoopStrand::~EventLoopStrand() {
+}
+
+void EventLoopStrand::PostTask(const function<void()>& callback) {
+  Enqueue(event_loop_, tasks_, callback, kPriorityNormal);
+}
+
+void EventLoopStrand::PostTaskWithPriority(const function<void()>& callback,
+                                           TaskPriority priority) {
+  Enqueue(event_loop_, tasks_, callback, priority);
+}
+
+void EventLoopStrand::PostDelayedTask(const function<void()>& callback,
+                                      int64_t delay_ms) {
+  PostCancelableDelayedTask(callback, delay_ms, 0);
+}
+
+EventLoop::TimerId EventLoopStrand::PostCancelableDelayedTask(
+    const function<void()>& callback,
+    int64_t delay_ms,
+    int64_t slack_ms) {
+  EventLoop* event_loop = event_loop_;
+  weak_ptr<Tasks> tasks = tasks_;
+  return event_loop_->PostCancelableDelayedTask(
+      [event_loop, tasks, callback]() {
+        Enqueue(event_loop, tasks, callback, kPriorityNormal);
+      },
+      delay_ms, slack_ms);
+}
+
+bool EventLoopStrand::CancelDelayedTask(TimerId timer_id) {
+  return event_loop_->CancelDelayedTask(timer_id);
+}
+
+bool EventLoopStrand::WatchFileDescriptor(
+    int fd,
+    ReadyMode mode,
+    const function<void(int)>& callback) {
+  EventLoop* event_loop = event_loop_;
+  weak_ptr<Tasks> tasks = tasks_;
+  return event_loop_->WatchFileDescriptor(
+      fd, mode,
+      [event_loop, tasks, callback](int ready_fd) {
+        Enqueue(event_loop, tasks, std::bind(callback, ready_fd),
+                kPriorityNormal);
+      });
+}
+
+bool EventLoopStrand::StopWatchFileDescriptor(int fd) {
+  return event_loop_->StopWatchFileDescriptor(fd);
+}
+
+void EventLoopStrand::Enqueue(EventLoop* event_loop,
+                              const weak_ptr<Tasks>& tasks,
+                              const function<void()>& callback,
+                              TaskPriority priority) {
+  std::shared_ptr<Tasks> locked_tasks = tasks.lock();
+  if (locked_tasks == nullptr) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(locked_tasks->mutex);
+  locked_tasks->queue.push_back({callback, priority});
+  if (!locked_tasks->scheduled) {
+    locked_tasks->scheduled = true;
+    event_loop->PostTaskWithPriority(
+        std::bind(&EventLoopStrand::RunNextTask, event_loop, tasks),
+        priority);
+  }
+}
+
+void EventLoopStrand::RunNextTask(EventLoop* event_loop,
+                                  const weak_ptr<Tasks>& tasks) {
+  function<void()> task;
+  {
+    std::shared_ptr<Tasks> locked_tasks = tasks.lock();
+    if (locked_tasks == nullptr) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(locked_tasks->mutex);
+    task = std::move(locked_tasks->queue.front().callback);
+    locked_tasks->queue.pop_front();
+  }
+  // |task| might destroy the strand.
+  task();
+
+  std::shared_ptr<Tasks> locked_tasks = tasks.lock();
+  if (locked_tasks == nullptr) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(locked_tasks->mutex);
+  if (locked_tasks->queue.empty()) {
+    locked_tasks->scheduled = false;
+    return;
+  }
+  // Let the other work of the event loop run before the next task.
+  event_loop->PostTaskWithPriority(
+      std::bind(&EventLoopStrand::RunNextTask, event_loop, tasks),
+      locked_tasks->queue.front().priority);
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_EVENT_LOOP_STRAND_H_
+#define WIFICOND_EVENT_LOOP_STRAND_H_
+
+#include "event_loop.h"
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include <android-base/macros.h>
+
+namespace android {
+namespace wificond {
+
+// EventLoopStrand is an executor on top of another EventLoop.
+// Tasks of a strand run in the order they were posted, on the thread of the
+// underlying event loop. Only one task of a strand is queued on the
+// underlying event loop at a time, with the priority of the oldest task of
+// the strand, and a strand runs one task per turn: with one strand per
+// interface, a burst of work for one interface is interleaved with the work
+// of other interfaces instead of delaying it until the burst is over.
+// Tasks that have not run yet are dropped when the strand is destroyed.
+class EventLoopStrand : public EventLoop {
+ public:
+  // |event_loop| must outlive this object.
+  explicit EventLoopStrand(EventLoop* event_loop);
+  ~EventLoopStrand() override;
+
+  // See event_loop.h
+  void PostTask(const std::function<void()>& callback) override;
+
+  // See event_loop.h
+  // |priority| only decides when it is the turn of this strand. Tasks of a
+  // strand never overtake each other.
+  void PostTaskWithPriority(const std::function<void()>& callback,
+                            TaskPriority priority) override;
+
+  // See event_loop.h
+  // |callback| is queued on this strand once |delay_ms| has elapsed.
+  void PostDelayedTask(const std::function<void()>& callback,
+                       int64_t delay_ms) override;
+
+  // See event_loop.h
+  // |callback| is queued on this strand once its timer fires. It cannot be
+  // canceled anymore after that.
+  TimerId PostCancelableDelayedTask(const std::function<void()>& callback,
+                                    int64_t delay_ms,
+                                    int64_t slack_ms) override;
+
+  // See event_loop.h
+  bool CancelDelayedTask(TimerId timer_id) override;
+
+  // See event_loop.h
+  // |callback| is queued on this strand every time |fd| is ready.
+  bool WatchFileDescriptor(
+      int fd,
+      ReadyMode mode,
+      const std::function<void(int)>& callback) override;
+
+  // See event_loop.h
+  bool StopWatchFileDescriptor(int fd) override;
+
+ private:
+  struct Task {
+    std::function<void()> callback;
+    TaskPriority priority;
+  };
+  struct Tasks {
+    std::mutex mutex;
+    std::deque<Task> queue;
+    // True if RunNextTask() is posted to the underlying event loop.
+    bool scheduled = false;
+  };
+
+  // Queues |callback| on the strand that owns |tasks|, unless that strand
+  // was destroyed.
+  static void Enqueue(EventLoop* event_loop,
+                      const std::weak_ptr<Tasks>& tasks,
+                      const std::function<void()>& callback,
+                      TaskPriority priority);
+  static void RunNextTask(EventLoop* event_loop,
+                          const std::weak_ptr<Tasks>& tasks);
+
+  EventLoop* const event_loop_;
+  // Shared with the tasks posted to |event_loop_|, which only keep a weak
+  // reference, so that they become no-ops once this strand is gone.
+  const std::shared_ptr<Tasks> tasks_;
+
+  DISALLOW_COPY_AND_ASSIGN(EventLoopStrand);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_EVENT_LOOP_STRAND_H_
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_FIXED_STRING_H_
+#define WIFICOND_FIXED_STRING_H_
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <ostream>
+
+namespace android {
+namespace wificond {
+
+// String with a fixed capacity of |N| - 1 characters, which lives on the
+// stack. It is meant for formatting log messages on hot paths without heap
+// allocations. Text that doesn't fit is dropped, and the string is marked as
+// truncated with a trailing "...".
+template <size_t N>
+class FixedString {
+ public:
+  FixedString() { buffer_[0] = '\0'; }
+
+  // Appends text formatted like printf().
+  __attribute__((format(printf, 2, 3)))
+  void Appendf(const char* format, ...) {
+    if (truncated_) {
+      return;
+    }
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(buffer_ + length_, N - length_, format, args);
+    va_end(args);
+    if (written < 0) {
+      buffer_[length_] = '\0';
+      return;
+    }
+    if (static_cast<size_t>(written) >= N - length_) {
+      Truncate();
+      return;
+    }
+    length_ += written;
+  }
+
+  void Append(char c) {
+    if (truncated_) {
+      return;
+    }
+    if (length_ + 1 >= N) {
+      Truncate();
+      return;
+    }
+    buffer_[length_++] = c;
+    buffer_[length_] = '\0';
+  }
+
+  const char* c_str() const { return buffer_; }
+  size_t size() const { return length_; }
+  bool empty() const { return length_ == 0; }
+  bool truncated() const { return truncated_; }
+
+ private:
+  static constexpr char kTruncationMark[] = "...";
+  static_assert(N > sizeof(kTruncationMark), "FixedString is too small");
+
+  void Truncate() {
+    length_ = N - sizeof(kTruncationMark);
+    memcpy(buffer_ + length_, kTruncationMark, sizeof(kTruncationMark));
+    length_ += sizeof(kTruncationMark) - 1;
+    truncated_ = true;
+  }
+
+  char buffer_[N];
+  size_t length_ = 0;
+  bool truncated_ = false;
+};
+
+template <size_t N>
+std::ostream& operator<<(std::ostream& stream, const FixedString<N>& str) {
+  return stream << str.c_str();
+}
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_FIXED_STRING_H_
@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/flight_recorder.h"
+
+#include <linux/netlink.h>
+#include <string.h>
+
+#include <iomanip>
+
+using std::endl;
+using std::stringstream;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+FlightRecorder* g_recorder = nullptr;
+
+size_t RoundUpToPowerOfTwo(size_t value) {
+  size_t result = 1;
+  while (result < value) {
+    result <<= 1;
+  }
+  return result;
+}
+
+const char* GetTypeName(uint8_t type) {
+  switch (type) {
+    case FlightRecord::kNetlinkSent:
+      return "nl-sent";
+    case FlightRecord::kNetlinkReceived:
+      return "nl-received";
+    case FlightRecord::kNetlinkCompleted:
+      return "nl-completed";
+    case FlightRecord::kNetlinkOverrun:
+      return "nl-overrun";
+    case FlightRecord::kBinderCall:
+      return "binder";
+    default:
+      return "unknown";
+  }
+}
+
+const char* GetControlTypeName(uint8_t control_type) {
+  switch (control_type) {
+    case NLMSG_NOOP:
+      return "noop";
+    case NLMSG_ERROR:
+      return "error";
+    case NLMSG_DONE:
+      return "done";
+    case NLMSG_OVERRUN:
+      return "overrun";
+    default:
+      return "control";
+  }
+}
+
+const char* GetBinderInterfaceName(uint8_t binder_interface) {
+  switch (binder_interface) {
+    case FlightRecord::kWificond:
+      return "IWificond";
+    case FlightRecord::kClientInterface:
+      return "IClientInterface";
+    case FlightRecord::kApInterface:
+      return "IApInterface";
+    case FlightRecord::kScanner:
+      return "IWifiScannerImpl";
+    default:
+      return "unknown";
+  }
+}
+
+}  // namespace
+
+FlightRecorder::FlightRecorder(size_t capacity)
+    : slots_(new Slot[RoundUpToPowerOfTwo(capacity)]),
+      capacity_(RoundUpToPowerOfTwo(capacity)),
+      next_index_(0) {
+}
+
+void FlightRecorder::Add(FlightRecord record) {
+  if (record.timestamp_ns == 0) {
+    record.timestamp_ns = systemTime(SYSTEM_TIME_MONOTONIC);
+  }
+  uint64_t words[kNumWords];
+  memcpy(words, &record, sizeof(words));
+  uint64_t index = next_index_.fetch_add(1, std::memory_order_relaxed);
+  Slot& slot = slots_[index & (capacity_ - 1)];
+  slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+  // Readers must not see the new words without the odd sequence.
+  std::atomic_thread_fence(std::memory_order_release);
+  for (size_t i = 0; i < kNumWords; i++) {
+    slot.words[i].store(words[i], std::memory_order_relaxed);
+  }
+  slot.sequence.store(2 * (index + 1), std::memory_order_release);
+}
+
+void FlightRecorder::GetRecords(vector<FlightRecord>* records) const {
+  uint64_t end = next_index_.load(std::memory_order_acquire);
+  uint64_t begin = end > capacity_ ? end - capacity_ : 0;
+  records->reserve(records->size() + (end - begin));
+  for (uint64_t index = begin; index < end; index++) {
+    const Slot& slot = slots_[index & (capacity_ - 1)];
+    uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence != 2 * (index + 1)) {
+      // Still being written, or already overwritten.
+      continue;
+    }
+    uint64_t words[kNumWords];
+    for (size_t i = 0; i < kNumWords; i++) {
+      words[i] = slot.words[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+      continue;
+    }
+    FlightRecord record;
+    memcpy(&record, words, sizeof(record));
+    records->push_back(record);
+  }
+}
+
+size_t FlightRecorder::GetMemoryUsage() const {
+  return capacity_ * sizeof(Slot);
+}
+
+void FlightRecorder::DumpDecoded(stringstream* ss, nsecs_t now) const {
+  vector<FlightRecord> records;
+  GetRecords(&records);
+  *ss << "Flight recorder: " << records.size() << " records" << endl;
+  for (const FlightRecord& record : records) {
+    *ss << std::fixed << std::setprecision(3)
+        << -static_cast<double>(now - record.timestamp_ns) / 1e6 << "ms "
+        << GetTypeName(record.type);
+    if (record.type == FlightRecord::kBinderCall) {
+      *ss << " " << GetBinderInterfaceName(record.command)
+          << " code=" << record.sequence;
+    } else if (record.control_type != 0) {
+      *ss << " " << GetControlTypeName(record.control_type);
+      if (record.control_type == NLMSG_ERROR) {
+        // An error of 0 acknowledges a request.
+        *ss << " errno=" << static_cast<int>(record.status);
+      }
+      *ss << " seq=" << record.sequence
+          << " len=" << record.length;
+    } else {
+      *ss << " cmd=" << static_cast<int>(record.command)
+          << " seq=" << record.sequence
+          << " if=" << record.interface_index
+          << " len=" << record.length;
+    }
+    if (record.type == FlightRecord::kNetlinkCompleted ||
+        record.type == FlightRecord::kBinderCall) {
+      *ss << " latency=" << record.latency_us << "us"
+          << " status=" << static_cast<int>(record.status);
+    }
+    *ss << endl;
+  }
+}
+
+void FlightRecorder::DumpRaw(stringstream* ss) const {
+  vector<FlightRecord> records;
+  GetRecords(&records);
+  *ss << "flight-recorder version=" << kRawFormatVersion
+      << " record_size=" << sizeof(FlightRecord)
+      << " records=" << records.size() << endl;
+  *ss << std::hex << std::setfill('0');
+  for (const FlightRecord& record : records) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&record);
+    for (size_t i = 0; i < sizeof(record); i++) {
+      *ss << std::setw(2) << static_cast<int>(bytes[i]);
+    }
+    *ss << endl;
+  }
+  *ss << std::dec << std::setfill(' ');
+}
+
+FlightRecorder* FlightRecorder::GetInstance() {
+  return g_recorder;
+}
+
+void FlightRecorder::SetInstance(FlightRecorder* recorder) {
+  g_recorder = recorder;
+}
+
+void FlightRecorder::Record(const FlightRecord& record) {
+  if (g_recorder != nullptr) {
+    g_recorder->Add(record);
+  }
+}
+
+FlightRecorder::BinderCallScope::BinderCallScope(
+    FlightRecord::BinderInterface binder_interface,
+    uint32_t code)
+    : binder_interface_(binder_interface),
+      code_(code),
+      start_time_(g_recorder != nullptr ?
+          systemTime(SYSTEM_TIME_MONOTONIC) : 0),
+      failed_(false) {
+}
+
+FlightRecorder::BinderCallScope::~BinderCallScope() {
+  if (g_recorder == nullptr) {
+    return;
+  }
+  FlightRecord record;
+  record.timestamp_ns = systemTime(SYSTEM_TIME_MONOTONIC);
+  record.type = FlightRecord::kBinderCall;
+  record.command = binder_interface_;
+  record.status = failed_ ? 1 : 0;
+  record.sequence = code_;
+  record.latency_us = ns2us(record.timestamp_ns - start_time_);
+  g_recorder->Add(record);
+}
+
+}  // namespace wificond
+}  // namespace android
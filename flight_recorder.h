@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_FLIGHT_RECORDER_H_
+#define WIFICOND_FLIGHT_RECORDER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#include <android-base/macros.h>
+#include <utils/Timers.h>
+
+namespace android {
+namespace wificond {
+
+// A compact record of a netlink message or binder call.
+// Records are dumped raw as they are laid out here, so new fields can only
+// take the place of |padding|.
+struct FlightRecord {
+  enum Type : uint8_t {
+    kNetlinkSent = 1,
+    kNetlinkReceived = 2,
+    // A synchronous request completed, failed or timed out.
+    kNetlinkCompleted = 3,
+    // Kernel dropped messages of a socket.
+    kNetlinkOverrun = 4,
+    kBinderCall = 5,
+  };
+  // Binder objects whose calls are recorded, in |command| of kBinderCall.
+  enum BinderInterface : uint8_t {
+    kWificond = 1,
+    kClientInterface = 2,
+    kApInterface = 3,
+    kScanner = 4,
+  };
+
+  // CLOCK_MONOTONIC time at which the record was added.
+  int64_t timestamp_ns = 0;
+  uint8_t type = 0;
+  // nl80211 command, or BinderInterface of kBinderCall. 0 for netlink
+  // control messages.
+  uint8_t command = 0;
+  // 0 on success. The RequestResult of kNetlinkCompleted, the errno of a
+  // received NLMSG_ERROR, 1 for binder calls that did not return OK.
+  uint8_t status = 0;
+  // Netlink control message type, e.g. NLMSG_ERROR, or 0 for nl80211
+  // messages.
+  uint8_t control_type = 0;
+  // Netlink message length in bytes.
+  uint32_t length = 0;
+  uint32_t interface_index = 0;
+  // Netlink sequence number, or binder transaction code, i.e. method id.
+  uint32_t sequence = 0;
+  // Latency of kNetlinkCompleted and kBinderCall in microseconds.
+  uint32_t latency_us = 0;
+  uint32_t padding = 0;
+};
+static_assert(sizeof(FlightRecord) == 32,
+              "Raw dumps depend on the size of FlightRecord");
+
+// FlightRecorder keeps the latest netlink and binder records in a fixed
+// size ring, so that field performance issues can be looked into with
+// "dumpsys wificond flight-recorder" without turning on verbose logging.
+// Adding a record takes no lock and does not allocate, so the recorder is
+// always on. Records can be added from any thread. A dump skips records
+// that are overwritten while it copies them.
+class FlightRecorder {
+ public:
+  static constexpr size_t kDefaultCapacity = 4096;
+  static constexpr uint32_t kRawFormatVersion = 1;
+
+  // |capacity| is rounded up to a power of two.
+  explicit FlightRecorder(size_t capacity = kDefaultCapacity);
+  ~FlightRecorder() = default;
+
+  // Adds |record|, stamped with the current time unless it has a timestamp.
+  void Add(FlightRecord record);
+  // Copies the records in the ring to |records|, oldest first.
+  void GetRecords(std::vector<FlightRecord>* records) const;
+  size_t GetMemoryUsage() const;
+
+  // One line per record, with times relative to |now|.
+  void DumpDecoded(std::stringstream* ss,
+                   nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC)) const;
+  // A header line, then each record as hex of its bytes in host order, one
+  // per line.
+  void DumpRaw(std::stringstream* ss) const;
+
+  // Returns the recorder that the helpers below add to, or nullptr if
+  // nothing is recorded.
+  static FlightRecorder* GetInstance();
+  static void SetInstance(FlightRecorder* recorder);
+  // Adds |record| to the installed recorder, if any.
+  static void Record(const FlightRecord& record);
+
+  // Records a binder call of |binder_interface| when it goes out of scope.
+  // Binder objects of wificond create one in their onTransact().
+  class BinderCallScope {
+   public:
+    BinderCallScope(FlightRecord::BinderInterface binder_interface,
+                    uint32_t code);
+    ~BinderCallScope();
+    void SetResult(int32_t status) { failed_ = status != 0; }
+
+   private:
+    const FlightRecord::BinderInterface binder_interface_;
+    const uint32_t code_;
+    const nsecs_t start_time_;
+    bool failed_;
+
+    DISALLOW_COPY_AND_ASSIGN(BinderCallScope);
+  };
+
+ private:
+  static constexpr size_t kNumWords = sizeof(FlightRecord) / sizeof(uint64_t);
+  // A slot is a seqlock: |sequence| is odd while the slot is written, and
+  // 2 * (index + 1) once record |index| is complete.
+  struct Slot {
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<uint64_t> words[kNumWords];
+  };
+
+  std::unique_ptr<Slot[]> slots_;
+  const size_t capacity_;
+  // Index of the next record to add.
+  std::atomic<uint64_t> next_index_;
+
+  DISALLOW_COPY_AND_ASSIGN(FlightRecorder);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_FLIGHT_RECORDER_H_
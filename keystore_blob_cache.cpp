@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/keystore_blob_cache.h"
+
+using std::lock_guard;
+using std::mutex;
+using std::string;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+bool KeystoreBlobCache::Get(const string& key,
+                            nsecs_t now,
+                            vector<uint8_t>* blob) {
+  lock_guard<mutex> lock(mutex_);
+  const auto iter = entries_.find(key);
+  if (iter == entries_.end()) {
+    return false;
+  }
+  if (now >= iter->second.expiry) {
+    entries_.erase(iter);
+    return false;
+  }
+  *blob = iter->second.blob;
+  return true;
+}
+
+void KeystoreBlobCache::Put(const string& key,
+                            const vector<uint8_t>& blob,
+                            nsecs_t now) {
+  lock_guard<mutex> lock(mutex_);
+  // Expired entries of aliases that are not looked up again would stay
+  // forever otherwise.
+  for (auto iter = entries_.begin(); iter != entries_.end();) {
+    if (now >= iter->second.expiry) {
+      iter = entries_.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+  entries_[key] = Entry{blob, now + ttl_};
+}
+
+void KeystoreBlobCache::Invalidate() {
+  lock_guard<mutex> lock(mutex_);
+  entries_.clear();
+}
+
+}  // namespace wificond
+}  // namespace android
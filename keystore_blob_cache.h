@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_KEYSTORE_BLOB_CACHE_H_
+#define WIFICOND_KEYSTORE_BLOB_CACHE_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <android-base/macros.h>
+#include <utils/Timers.h>
+
+namespace android {
+namespace wificond {
+
+// Short lived cache of public keystore blobs, e.g. certificates, keyed by
+// alias. Enterprise networks that reconnect at the same time look up the
+// same certificates, which then only take one keystore call each.
+// Entries expire after |ttl|, so that replaced certificates are picked up
+// soon, and Invalidate() drops all of them, e.g. when keystore restarts.
+// Only successful lookups are meant to be cached.
+// Thread safe: lookups come from all HIDL threads.
+class KeystoreBlobCache {
+ public:
+  static constexpr nsecs_t kDefaultTtl = s2ns(10);
+
+  explicit KeystoreBlobCache(nsecs_t ttl = kDefaultTtl) : ttl_(ttl) {}
+
+  // Copies the blob cached for |key| to |*blob|.
+  // Returns false if there is none, or if it expired by |now|.
+  bool Get(const std::string& key, nsecs_t now, std::vector<uint8_t>* blob);
+  bool Get(const std::string& key, std::vector<uint8_t>* blob) {
+    return Get(key, systemTime(SYSTEM_TIME_MONOTONIC), blob);
+  }
+  // Caches |blob| for |key|, fetched at |now|.
+  void Put(const std::string& key,
+           const std::vector<uint8_t>& blob,
+           nsecs_t now);
+  void Put(const std::string& key, const std::vector<uint8_t>& blob) {
+    Put(key, blob, systemTime(SYSTEM_TIME_MONOTONIC));
+  }
+  void Invalidate();
+
+ private:
+  struct Entry {
+    std::vector<uint8_t> blob;
+    nsecs_t expiry;
+  };
+
+  const nsecs_t ttl_;
+  std::mutex mutex_;
+  std::map<std::string, Entry> entries_;
+
+  DISALLOW_COPY_AND_ASSIGN(KeystoreBlobCache);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_KEYSTORE_BLOB_CACHE_H_
@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/link_stats_page.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <utility>
+
+#include <android-base/logging.h>
+
+using android::base::unique_fd;
+
+namespace android {
+namespace wificond {
+namespace {
+
+constexpr size_t kStatsSize = 48;
+constexpr uint32_t kFlagAssociated = 1 << 0;
+// Number of attempts a reader makes before giving up on a page that keeps
+// changing.
+constexpr int kMaxReadAttempts = 64;
+
+constexpr size_t kMagicOffset = 0;
+constexpr size_t kVersionOffset = 4;
+constexpr size_t kSizeOffset = 6;
+constexpr size_t kSequenceOffset = 8;
+constexpr size_t kFlagsOffset = 12;
+constexpr size_t kTimestampOffset = 16;
+constexpr size_t kRssiOffset = 24;
+constexpr size_t kFrequencyOffset = 28;
+constexpr size_t kTxBitrateOffset = 32;
+constexpr size_t kRxBitrateOffset = 36;
+constexpr size_t kTxPacketsOffset = 40;
+constexpr size_t kTxFailedOffset = 44;
+
+// Fields are accessed atomically, because readers in other processes may
+// load them while they are stored. Every offset is aligned to the size of
+// its field.
+template <typename T>
+void Store(uint8_t* page, size_t offset, T value) {
+  __atomic_store_n(reinterpret_cast<T*>(page + offset), value,
+                   __ATOMIC_RELAXED);
+}
+
+template <typename T>
+T Load(const uint8_t* page, size_t offset) {
+  return __atomic_load_n(reinterpret_cast<const T*>(page + offset),
+                         __ATOMIC_RELAXED);
+}
+
+uint32_t* Sequence(uint8_t* page) {
+  return reinterpret_cast<uint32_t*>(page + kSequenceOffset);
+}
+
+const uint32_t* Sequence(const uint8_t* page) {
+  return reinterpret_cast<const uint32_t*>(page + kSequenceOffset);
+}
+
+}  // namespace
+
+LinkStatsPage::~LinkStatsPage() {
+  if (page_ != nullptr) {
+    munmap(page_, kPageSize);
+  }
+}
+
+bool LinkStatsPage::Init() {
+  if (IsInitialized()) {
+    return true;
+  }
+  unique_fd fd(memfd_create("wificond_link_stats",
+                            MFD_CLOEXEC | MFD_ALLOW_SEALING));
+  if (fd.get() < 0) {
+    PLOG(ERROR) << "Failed to create memfd for link statistics";
+    return false;
+  }
+  if (ftruncate(fd.get(), kPageSize) != 0) {
+    PLOG(ERROR) << "Failed to resize memfd for link statistics";
+    return false;
+  }
+  void* page = mmap(nullptr, kPageSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    fd.get(), 0);
+  if (page == MAP_FAILED) {
+    PLOG(ERROR) << "Failed to map memfd for link statistics";
+    return false;
+  }
+  // Unlike F_SEAL_WRITE, F_SEAL_FUTURE_WRITE keeps our own mapping writable
+  // while it prevents any new writable mapping, i.e. one by a reader.
+  if (fcntl(fd.get(), F_ADD_SEALS,
+            F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_FUTURE_WRITE |
+                F_SEAL_SEAL) != 0) {
+    PLOG(ERROR) << "Failed to seal memfd for link statistics";
+    munmap(page, kPageSize);
+    return false;
+  }
+  page_ = static_cast<uint8_t*>(page);
+  fd_ = std::move(fd);
+  // A new memfd is zero filled, which is an even sequence counter and no
+  // statistics.
+  Store<uint32_t>(page_, kMagicOffset, kMagic);
+  Store<uint16_t>(page_, kVersionOffset, kVersion);
+  Store<uint16_t>(page_, kSizeOffset, kStatsSize);
+  return true;
+}
+
+void LinkStatsPage::Update(const LinkStats& stats) {
+  if (page_ == nullptr) {
+    return;
+  }
+  // This is the only writer, so there is no need for a read-modify-write.
+  uint32_t sequence = __atomic_load_n(Sequence(page_), __ATOMIC_RELAXED);
+  __atomic_store_n(Sequence(page_), sequence + 1, __ATOMIC_RELAXED);
+  // Orders the odd sequence counter before the statistics.
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  Store<uint32_t>(page_, kFlagsOffset,
+                  stats.associated ? kFlagAssociated : 0);
+  Store<int64_t>(page_, kTimestampOffset, stats.timestamp_ns);
+  Store<int32_t>(page_, kRssiOffset, stats.rssi_dbm);
+  Store<uint32_t>(page_, kFrequencyOffset, stats.frequency_mhz);
+  Store<uint32_t>(page_, kTxBitrateOffset, stats.tx_bitrate_mbps);
+  Store<uint32_t>(page_, kRxBitrateOffset, stats.rx_bitrate_mbps);
+  Store<int32_t>(page_, kTxPacketsOffset, stats.tx_packets);
+  Store<int32_t>(page_, kTxFailedOffset, stats.tx_failed);
+  __atomic_store_n(Sequence(page_), sequence + 2, __ATOMIC_RELEASE);
+}
+
+unique_fd LinkStatsPage::GetReadOnlyFd() const {
+  if (fd_.get() < 0) {
+    return unique_fd();
+  }
+  unique_fd fd(fcntl(fd_.get(), F_DUPFD_CLOEXEC, 0));
+  if (fd.get() < 0) {
+    PLOG(ERROR) << "Failed to duplicate memfd for link statistics";
+  }
+  return fd;
+}
+
+bool LinkStatsPage::Read(const uint8_t* page,
+                         size_t size,
+                         LinkStats* out_stats) {
+  if (size < kStatsSize ||
+      Load<uint32_t>(page, kMagicOffset) != kMagic ||
+      Load<uint16_t>(page, kSizeOffset) < kStatsSize) {
+    LOG(ERROR) << "Invalid link statistics page header";
+    return false;
+  }
+  for (int attempt = 0; attempt < kMaxReadAttempts; attempt++) {
+    uint32_t sequence = __atomic_load_n(Sequence(page), __ATOMIC_ACQUIRE);
+    if (sequence % 2 != 0) {
+      continue;
+    }
+    LinkStats stats;
+    stats.associated =
+        (Load<uint32_t>(page, kFlagsOffset) & kFlagAssociated) != 0;
+    stats.timestamp_ns = Load<int64_t>(page, kTimestampOffset);
+    stats.rssi_dbm = Load<int32_t>(page, kRssiOffset);
+    stats.frequency_mhz = Load<uint32_t>(page, kFrequencyOffset);
+    stats.tx_bitrate_mbps = Load<uint32_t>(page, kTxBitrateOffset);
+    stats.rx_bitrate_mbps = Load<uint32_t>(page, kRxBitrateOffset);
+    stats.tx_packets = Load<int32_t>(page, kTxPacketsOffset);
+    stats.tx_failed = Load<int32_t>(page, kTxFailedOffset);
+    // Orders the loads of the statistics before the second load of the
+    // sequence counter.
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(Sequence(page), __ATOMIC_RELAXED) == sequence) {
+      *out_stats = stats;
+      return true;
+    }
+  }
+  LOG(WARNING) << "Link statistics kept changing while being read";
+  return false;
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_LINK_STATS_PAGE_H_
+#define WIFICOND_LINK_STATS_PAGE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <android-base/macros.h>
+#include <android-base/unique_fd.h>
+
+namespace android {
+namespace wificond {
+
+// Link statistics of a client interface, as published by LinkStatsPage.
+struct LinkStats {
+  bool associated = false;
+  // CLOCK_BOOTTIME timestamp of the statistics in nanoseconds.
+  int64_t timestamp_ns = 0;
+  int32_t rssi_dbm = 0;
+  uint32_t frequency_mhz = 0;
+  uint32_t tx_bitrate_mbps = 0;
+  uint32_t rx_bitrate_mbps = 0;
+  int32_t tx_packets = 0;
+  int32_t tx_failed = 0;
+};
+
+// Publishes the link statistics of a client interface in shared memory, so
+// that the framework can read them without a binder call and a netlink
+// request per poll. wificond is the only writer. Readers map the memory
+// read-only and never block the writer: a sequence counter is odd while the
+// statistics are written, so that readers retry torn reads.
+//
+// All fields are in host byte order, at these offsets of the memory:
+//   offset size
+//   0      4    magic, kMagic
+//   4      2    layout version, kVersion
+//   6      2    size of the header and statistics in bytes
+//   8      4    sequence counter
+//   12     4    flags, bit 0 is set if the interface is associated
+//   16     8    CLOCK_BOOTTIME timestamp of the statistics in nanoseconds
+//   24     4    RSSI in dBm, signed
+//   28     4    associated frequency in MHz
+//   32     4    tx bitrate in Mbps
+//   36     4    rx bitrate in Mbps
+//   40     4    number of successfully transmitted packets
+//   44     4    number of transmission failures
+// Readers do this, with all accesses being atomic:
+//   1. Load the sequence counter, with acquire semantics. Retry while it is
+//      odd.
+//   2. Load the statistics.
+//   3. Issue an acquire fence and load the sequence counter again. Retry
+//      from 1. if it changed.
+// Readers must ignore bytes beyond the size of the header and statistics,
+// so that later versions can append fields.
+class LinkStatsPage {
+ public:
+  static constexpr uint32_t kMagic = 0x574c5350;  // "WLSP"
+  static constexpr uint16_t kVersion = 1;
+  // Size of the shared memory.
+  static constexpr size_t kPageSize = 4096;
+
+  LinkStatsPage() = default;
+  ~LinkStatsPage();
+
+  // Creates the shared memory, with no statistics.
+  // Returns true on success.
+  bool Init();
+  bool IsInitialized() const { return page_ != nullptr; }
+  // Publishes |stats|.
+  void Update(const LinkStats& stats);
+  // Returns a new fd of the shared memory, which can only be mapped
+  // read-only. Returns an invalid fd on failure.
+  android::base::unique_fd GetReadOnlyFd() const;
+
+  // Reads the statistics from |page| of |size| bytes, the way readers of
+  // the shared memory do.
+  // Returns false if |page| is malformed or kept changing.
+  static bool Read(const uint8_t* page, size_t size, LinkStats* out_stats);
+
+ private:
+  android::base::unique_fd fd_;
+  uint8_t* page_ = nullptr;
+
+  DISALLOW_COPY_AND_ASSIGN(LinkStatsPage);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_LINK_STATS_PAGE_H_
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_LOG_RATE_LIMITER_H_
+#define WIFICOND_LOG_RATE_LIMITER_H_
+
+#include <stdint.h>
+
+#include <android-base/logging.h>
+#include <utils/Timers.h>
+
+#include "wificond/fixed_string.h"
+
+namespace android {
+namespace wificond {
+
+// Lets at most |max_messages| log messages through per |interval|, so that
+// storms of events can't take over CPU and logd bandwidth. The number of
+// messages dropped is reported with the next message that is let through.
+// Not thread safe: each limiter is meant to guard a log call site on the
+// event loop thread.
+class LogRateLimiter {
+ public:
+  static constexpr uint32_t kDefaultMaxMessages = 10;
+  static constexpr nsecs_t kDefaultInterval = s2ns(10);
+
+  LogRateLimiter(uint32_t max_messages = kDefaultMaxMessages,
+                 nsecs_t interval = kDefaultInterval)
+      : max_messages_(max_messages),
+        interval_(interval) {}
+
+  // Returns whether a message can be logged at time |now|. Counts the
+  // message as suppressed otherwise.
+  bool ShouldLog(nsecs_t now) {
+    if (num_messages_ == 0 || now - interval_start_ >= interval_) {
+      interval_start_ = now;
+      num_messages_ = 0;
+    }
+    if (num_messages_ >= max_messages_) {
+      num_suppressed_++;
+      return false;
+    }
+    num_messages_++;
+    return true;
+  }
+  bool ShouldLog() { return ShouldLog(systemTime(SYSTEM_TIME_MONOTONIC)); }
+
+  // Returns a note on the messages suppressed since the last logged one, to
+  // prefix the next logged message with, and resets their count.
+  FixedString<48> TakeSuppressedNote() {
+    FixedString<48> note;
+    if (num_suppressed_ > 0) {
+      note.Appendf("(%u similar messages suppressed) ", num_suppressed_);
+      num_suppressed_ = 0;
+    }
+    return note;
+  }
+
+  uint32_t GetNumSuppressed() const { return num_suppressed_; }
+
+ private:
+  const uint32_t max_messages_;
+  const nsecs_t interval_;
+  nsecs_t interval_start_ = 0;
+  uint32_t num_messages_ = 0;
+  uint32_t num_suppressed_ = 0;
+};
+
+}  // namespace wificond
+}  // namespace android
+
+// Like LOG(severity), but only logs what |limiter| lets through, e.g.:
+//   static LogRateLimiter limiter;
+//   LOG_RATE_LIMITED(WARNING, limiter) << "No handler for message";
+#define LOG_RATE_LIMITED(severity, limiter) \
+  (limiter).ShouldLog() && LOG(severity) << (limiter).TakeSuppressedNote()
+
+#endif  // WIFICOND_LOG_RATE_LIMITER_H_
@@ -17,26 +17,71 @@
 #include "wificond/logging_utils.h"
 
 #include <array>
-#include <iomanip>
+#include <vector>
 
 #include <android-base/macros.h>
 
 using std::array;
 using std::string;
-using std::stringstream;
+using std::vector;
 
 namespace android {
 namespace wificond {
 
+namespace {
+
+template <size_t N>
+void AppendSsid(const vector<uint8_t>& ssid, FixedString<N>* str) {
+  for (uint8_t c : ssid) {
+    if (c >= 0x20 && c < 0x7f && c != '\\') {
+      str->Append(static_cast<char>(c));
+    } else {
+      str->Appendf("\\x%02x", c);
+    }
+  }
+}
+
+}  // namespace
+
 string LoggingUtils::GetMacString(const array<uint8_t, ETH_ALEN>& mac_address) {
-  stringstream ss;
-  for (const uint8_t& b : mac_address) {
-    ss << std::hex << std::setfill('0') << std::setw(2) << static_cast<int>(b);
-    if (&b != &mac_address.back()) {
-      ss << ":";
+  return FormatMac(mac_address).c_str();
+}
+
+FixedString<LoggingUtils::kMacStringSize> LoggingUtils::FormatMac(
+    const array<uint8_t, ETH_ALEN>& mac_address) {
+  FixedString<kMacStringSize> str;
+  str.Appendf("%02x:%02x:%02x:%02x:%02x:%02x",
+              mac_address[0], mac_address[1], mac_address[2],
+              mac_address[3], mac_address[4], mac_address[5]);
+  return str;
+}
+
+FixedString<LoggingUtils::kSsidStringSize> LoggingUtils::FormatSsid(
+    const vector<uint8_t>& ssid) {
+  FixedString<kSsidStringSize> str;
+  AppendSsid(ssid, &str);
+  return str;
+}
+
+FixedString<LoggingUtils::kListStringSize> LoggingUtils::FormatSsidList(
+    const vector<vector<uint8_t>>& ssids) {
+  FixedString<kListStringSize> str;
+  for (const auto& ssid : ssids) {
+    if (&ssid != &ssids.front()) {
+      str.Appendf(", ");
     }
+    AppendSsid(ssid, &str);
+  }
+  return str;
+}
+
+FixedString<LoggingUtils::kListStringSize> LoggingUtils::FormatFrequencies(
+    const vector<uint32_t>& frequencies) {
+  FixedString<kListStringSize> str;
+  for (uint32_t frequency : frequencies) {
+    str.Appendf(str.empty() ? "%u" : ", %u", frequency);
   }
-  return ss.str();
+  return str;
 }
 
 string LoggingUtils::GetBandwidthString(ChannelBandwidth bandwidth) {
@@ -19,11 +19,13 @@
 
 #include <array>
 #include <sstream>
+#include <vector>
 
 #include <linux/if_ether.h>
 
 #include <android-base/macros.h>
 
+#include "wificond/fixed_string.h"
 #include "wificond/net/netlink_manager.h"
 
 namespace android {
@@ -31,10 +33,29 @@ namespace wificond {
 
 class LoggingUtils {
  public:
+  // Room for a MAC address formatted as "xx:xx:xx:xx:xx:xx".
+  static constexpr size_t kMacStringSize = 3 * ETH_ALEN;
+  // Room for a 32 bytes SSID with every byte escaped.
+  static constexpr size_t kSsidStringSize = 4 * 32 + 1;
+  static constexpr size_t kListStringSize = 512;
+
   LoggingUtils() = default;
   static std::string GetMacString(const std::array<uint8_t, ETH_ALEN>& mac_address);
   static std::string GetBandwidthString(ChannelBandwidth bandwidth);
 
+  // Formatters that don't allocate, for logging on hot paths.
+  static FixedString<kMacStringSize> FormatMac(
+      const std::array<uint8_t, ETH_ALEN>& mac_address);
+  // Printable ASCII characters of |ssid| are kept as is, other bytes are
+  // escaped as "\xNN".
+  static FixedString<kSsidStringSize> FormatSsid(
+      const std::vector<uint8_t>& ssid);
+  // Comma separated lists. Lists that don't fit are truncated.
+  static FixedString<kListStringSize> FormatSsidList(
+      const std::vector<std::vector<uint8_t>>& ssids);
+  static FixedString<kListStringSize> FormatFrequencies(
+      const std::vector<uint32_t>& frequencies);
+
  private:
 
   DISALLOW_COPY_AND_ASSIGN(LoggingUtils);
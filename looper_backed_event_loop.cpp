@@ -14,30 +14,44 @@
  * limitations under the License.
  */
 
+#define ATRACE_TAG ATRACE_TAG_NETWORK
+
 #include "wificond/looper_backed_event_loop.h"
 
+#include <errno.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <vector>
+
 #include <android-base/logging.h>
+#include <cutils/trace.h>
 #include <utils/Looper.h>
 #include <utils/Timers.h>
 
+using std::placeholders::_1;
+
 namespace {
 
-class EventLoopCallback : public android::MessageHandler {
+class TimerHandler : public android::MessageHandler {
  public:
-  explicit EventLoopCallback(const std::function<void()>& callback)
-      : callback_(callback) {
+  explicit TimerHandler(const std::function<void()>& run_timers)
+      : run_timers_(run_timers) {
   }
 
-  ~EventLoopCallback() override = default;
+  ~TimerHandler() override = default;
 
   virtual void handleMessage(const android::Message& message) {
-    callback_();
+    run_timers_();
   }
 
  private:
-  const std::function<void()> callback_;
+  const std::function<void()> run_timers_;
 
-  DISALLOW_COPY_AND_ASSIGN(EventLoopCallback);
+  DISALLOW_COPY_AND_ASSIGN(TimerHandler);
 };
 
 class WatchFdCallback : public android::LooperCallback {
@@ -62,38 +76,338 @@ class WatchFdCallback : public android::LooperCallback {
   DISALLOW_COPY_AND_ASSIGN(WatchFdCallback);
 };
 
+const char* const kPriorityNames[] = {"high", "normal", "low"};
+
 }  // namespace
 
 namespace android {
 namespace wificond {
 
+constexpr uint32_t LooperBackedEventLoop::kTaskPoolSize;
 
 LooperBackedEventLoop::LooperBackedEventLoop()
-    : should_continue_(true) {
+    : should_continue_(true),
+      callback_lock_(nullptr),
+      task_pool_(new PostedTask[kTaskPoolSize]),
+      free_tasks_(1),
+      posted_tasks_(nullptr),
+      next_timer_id_(kInvalidTimerId + 1),
+      scheduled_wakeup_(0),
+      max_queued_tasks_(0),
+      longest_handler_run_time_(0) {
+  for (uint32_t i = 0; i < kTaskPoolSize; i++) {
+    task_pool_[i].pooled = true;
+    task_pool_[i].next_free.store(i + 1 < kTaskPoolSize ? i + 2 : 0,
+                                  std::memory_order_relaxed);
+  }
   looper_ = android::Looper::prepare(Looper::PREPARE_ALLOW_NON_CALLBACKS);
+  wakeup_fd_.reset(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
+  if (wakeup_fd_.get() < 0) {
+    PLOG(FATAL) << "Failed to create eventfd for posted tasks";
+  }
+  sp<android::LooperCallback> wakeup_callback = new WatchFdCallback(
+      std::bind(&LooperBackedEventLoop::RunPostedTasks, this));
+  looper_->addFd(wakeup_fd_.get(), 0, Looper::EVENT_INPUT, wakeup_callback,
+                 NULL);
+  timer_handler_ = new TimerHandler(
+      std::bind(&LooperBackedEventLoop::RunTimers, this));
 }
 
 LooperBackedEventLoop::~LooperBackedEventLoop() {
+  // |looper_| is shared by the thread, and might outlive this object.
+  looper_->removeFd(wakeup_fd_.get());
+  looper_->removeMessages(timer_handler_);
+  PostedTask* task = posted_tasks_.exchange(nullptr);
+  while (task != nullptr) {
+    PostedTask* next = task->next;
+    if (!task->pooled) {
+      delete task;
+    }
+    task = next;
+  }
+  for (TaskQueue& queue : tasks_) {
+    for (task = queue.head; task != nullptr;) {
+      PostedTask* next = task->next;
+      if (!task->pooled) {
+        delete task;
+      }
+      task = next;
+    }
+  }
 }
 
 void LooperBackedEventLoop::PostTask(const std::function<void()>& callback) {
-  sp<android::MessageHandler> event_loop_callback =
-      new EventLoopCallback(callback);
-  looper_->sendMessage(event_loop_callback, NULL);
+  PostTaskWithPriority(callback, kPriorityNormal);
+}
+
+void LooperBackedEventLoop::PostTaskWithPriority(
+    const std::function<void()>& callback,
+    TaskPriority priority) {
+  PostedTask* task = AcquireTask();
+  task->callback = callback;
+  task->priority = priority;
+  task->post_time = systemTime(SYSTEM_TIME_MONOTONIC);
+  PostedTask* head = posted_tasks_.load(std::memory_order_relaxed);
+  do {
+    task->next = head;
+  } while (!posted_tasks_.compare_exchange_weak(head, task,
+                                                std::memory_order_release,
+                                                std::memory_order_relaxed));
+  // Otherwise the event loop was already woken up for the tasks below.
+  if (head == nullptr) {
+    uint64_t value = 1;
+    if (TEMP_FAILURE_RETRY(write(wakeup_fd_.get(), &value, sizeof(value))) !=
+        sizeof(value)) {
+      PLOG(ERROR) << "Failed to wake up event loop";
+    }
+  }
 }
 
 void LooperBackedEventLoop::PostDelayedTask(
     const std::function<void()>& callback,
     int64_t delay_ms) {
-  sp<android::MessageHandler> looper_callback = new EventLoopCallback(callback);
-  looper_->sendMessageDelayed(ms2ns(delay_ms), looper_callback, NULL);
+  PostCancelableDelayedTask(callback, delay_ms, 0);
+}
+
+EventLoop::TimerId LooperBackedEventLoop::PostCancelableDelayedTask(
+    const std::function<void()>& callback,
+    int64_t delay_ms,
+    int64_t slack_ms) {
+  nsecs_t earliest = systemTime(SYSTEM_TIME_MONOTONIC) + ms2ns(delay_ms);
+  nsecs_t deadline = earliest + ms2ns(std::max<int64_t>(slack_ms, 0));
+  std::lock_guard<std::mutex> lock(timers_mutex_);
+  TimerId timer_id = next_timer_id_++;
+  timers_[timer_id] = {callback, earliest, deadline};
+  timer_deadlines_.emplace(deadline, timer_id);
+  ScheduleTimersWakeupLocked();
+  return timer_id;
+}
+
+bool LooperBackedEventLoop::CancelDelayedTask(TimerId timer_id) {
+  std::lock_guard<std::mutex> lock(timers_mutex_);
+  const auto timer = timers_.find(timer_id);
+  if (timer == timers_.end()) {
+    return false;
+  }
+  timer_deadlines_.erase({timer->second.deadline, timer_id});
+  timers_.erase(timer);
+  ScheduleTimersWakeupLocked();
+  return true;
+}
+
+void LooperBackedEventLoop::RunPostedTasks() {
+  uint64_t value;
+  // Wakeups may be spurious, there is not always something to read.
+  if (TEMP_FAILURE_RETRY(read(wakeup_fd_.get(), &value, sizeof(value))) < 0 &&
+      errno != EAGAIN) {
+    PLOG(ERROR) << "Failed to read wakeup eventfd";
+  }
+  TakePostedTasks();
+  size_t num_tasks = 0;
+  for (const TaskQueue& queue : tasks_) {
+    num_tasks += queue.size;
+  }
+  ATRACE_INT("wificond_queued_tasks", num_tasks);
+  {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    max_queued_tasks_ = std::max(max_queued_tasks_, num_tasks);
+  }
+  // Tasks posted in the meantime may overtake queued tasks of a lower
+  // priority, but they do not run before the next wakeup, so that a task
+  // that keeps posting tasks cannot starve file descriptor callbacks.
+  // Their posting already signaled |wakeup_fd_| again.
+  for (; num_tasks > 0; num_tasks--) {
+    PostedTask* task = nullptr;
+    size_t priority = 0;
+    for (; priority < tasks_.size(); priority++) {
+      TaskQueue& queue = tasks_[priority];
+      if (queue.head != nullptr) {
+        task = queue.head;
+        queue.head = task->next;
+        if (queue.head == nullptr) {
+          queue.tail = nullptr;
+        }
+        queue.size--;
+        break;
+      }
+    }
+    nsecs_t delay = systemTime(SYSTEM_TIME_MONOTONIC) - task->post_time;
+    nsecs_t run_time = RunWithCallbackLock(task->callback, "wificond task");
+    ReleaseTask(task);
+    {
+      std::lock_guard<std::mutex> lock(stats_mutex_);
+      task_delay_stats_[priority].Record(delay);
+      task_run_stats_.Record(run_time);
+      RecordHandlerLocked(
+          std::string(kPriorityNames[priority]) + " priority task", run_time);
+    }
+    TakePostedTasks();
+  }
+}
+
+void LooperBackedEventLoop::TakePostedTasks() {
+  PostedTask* task = posted_tasks_.exchange(nullptr, std::memory_order_acquire);
+  // The most recently posted task is on top of the stack.
+  PostedTask* oldest_task = nullptr;
+  while (task != nullptr) {
+    PostedTask* next = task->next;
+    task->next = oldest_task;
+    oldest_task = task;
+    task = next;
+  }
+  while (oldest_task != nullptr) {
+    PostedTask* next = oldest_task->next;
+    TaskQueue& queue = tasks_[oldest_task->priority];
+    oldest_task->next = nullptr;
+    if (queue.tail != nullptr) {
+      queue.tail->next = oldest_task;
+    } else {
+      queue.head = oldest_task;
+    }
+    queue.tail = oldest_task;
+    queue.size++;
+    oldest_task = next;
+  }
+}
+
+LooperBackedEventLoop::PostedTask* LooperBackedEventLoop::AcquireTask() {
+  uint64_t head = free_tasks_.load(std::memory_order_acquire);
+  while (static_cast<uint32_t>(head) != 0) {
+    PostedTask* task = &task_pool_[static_cast<uint32_t>(head) - 1];
+    uint64_t next = (((head >> 32) + 1) << 32) |
+        task->next_free.load(std::memory_order_relaxed);
+    if (free_tasks_.compare_exchange_weak(head, next,
+                                          std::memory_order_acquire,
+                                          std::memory_order_acquire)) {
+      return task;
+    }
+  }
+  // More tasks are pending than the pool holds.
+  return new PostedTask();
+}
+
+void LooperBackedEventLoop::ReleaseTask(PostedTask* task) {
+  if (!task->pooled) {
+    delete task;
+    return;
+  }
+  // Drops what the callback captured now rather than on reuse.
+  task->callback = nullptr;
+  uint32_t index = static_cast<uint32_t>(task - task_pool_.get());
+  uint64_t head = free_tasks_.load(std::memory_order_relaxed);
+  do {
+    task->next_free.store(static_cast<uint32_t>(head),
+                          std::memory_order_relaxed);
+  } while (!free_tasks_.compare_exchange_weak(
+      head, (head & ~uint64_t{UINT32_MAX}) | (index + 1),
+      std::memory_order_release, std::memory_order_relaxed));
+}
+
+void LooperBackedEventLoop::RunTimers() {
+  // Started timers run in the order they were due, regardless of slack.
+  std::vector<std::pair<nsecs_t, TimerId>> started_timers;
+  {
+    std::lock_guard<std::mutex> lock(timers_mutex_);
+    scheduled_wakeup_ = 0;
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    for (const auto& timer : timers_) {
+      if (timer.second.earliest <= now) {
+        started_timers.emplace_back(timer.second.earliest, timer.first);
+      }
+    }
+  }
+  std::sort(started_timers.begin(), started_timers.end());
+  for (const auto& started_timer : started_timers) {
+    TimerId timer_id = started_timer.second;
+    std::function<void()> task;
+    {
+      // A previous callback might have canceled this timer.
+      std::lock_guard<std::mutex> lock(timers_mutex_);
+      const auto timer = timers_.find(timer_id);
+      if (timer == timers_.end()) {
+        continue;
+      }
+      task = std::move(timer->second.callback);
+      timer_deadlines_.erase({timer->second.deadline, timer_id});
+      timers_.erase(timer);
+    }
+    nsecs_t delay = systemTime(SYSTEM_TIME_MONOTONIC) - started_timer.first;
+    nsecs_t run_time = RunWithCallbackLock(task, "wificond timer");
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    timer_delay_stats_.Record(delay);
+    timer_run_stats_.Record(run_time);
+    RecordHandlerLocked("timer", run_time);
+  }
+  std::lock_guard<std::mutex> lock(timers_mutex_);
+  ScheduleTimersWakeupLocked();
+}
+
+void LooperBackedEventLoop::ScheduleTimersWakeupLocked() {
+  nsecs_t wakeup =
+      timer_deadlines_.empty() ? 0 : timer_deadlines_.begin()->first;
+  if (wakeup == scheduled_wakeup_) {
+    return;
+  }
+  if (scheduled_wakeup_ != 0) {
+    looper_->removeMessages(timer_handler_);
+  }
+  scheduled_wakeup_ = wakeup;
+  if (wakeup != 0) {
+    looper_->sendMessageAtTime(wakeup, timer_handler_, Message());
+  }
+}
+
+nsecs_t LooperBackedEventLoop::RunWithCallbackLock(
+    const std::function<void()>& task,
+    const char* trace_name) {
+  std::unique_lock<std::shared_mutex> lock;
+  if (callback_lock_ != nullptr) {
+    lock = std::unique_lock<std::shared_mutex>(*callback_lock_);
+  }
+  ATRACE_BEGIN(trace_name);
+  nsecs_t start_time = systemTime(SYSTEM_TIME_MONOTONIC);
+  task();
+  nsecs_t run_time = systemTime(SYSTEM_TIME_MONOTONIC) - start_time;
+  ATRACE_END();
+  return run_time;
+}
+
+void LooperBackedEventLoop::RunFdCallback(
+    const std::function<void(int)>& callback,
+    int fd) {
+  std::string label;
+  {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    const auto itr = fd_labels_.find(fd);
+    label = itr != fd_labels_.end() ? itr->second : "fd " + std::to_string(fd);
+  }
+  nsecs_t run_time =
+      RunWithCallbackLock(std::bind(callback, fd), label.c_str());
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  fd_run_stats_[fd].Record(run_time);
+  RecordHandlerLocked(label + " callback", run_time);
+}
+
+void LooperBackedEventLoop::RecordHandlerLocked(const std::string& name,
+                                                nsecs_t run_time) {
+  if (run_time > longest_handler_run_time_) {
+    longest_handler_run_time_ = run_time;
+    longest_handler_ = name;
+  }
+}
+
+void LooperBackedEventLoop::LatencyStats::Record(nsecs_t latency) {
+  count++;
+  total += latency;
+  max = std::max(max, latency);
 }
 
 bool LooperBackedEventLoop::WatchFileDescriptor(
     int fd,
     ReadyMode mode,
     const std::function<void(int)>& callback) {
-  sp<android::LooperCallback>  watch_fd_callback = new WatchFdCallback(callback);
+  sp<android::LooperCallback> watch_fd_callback = new WatchFdCallback(
+      std::bind(&LooperBackedEventLoop::RunFdCallback, this, callback, _1));
   int event;
   if (mode == kModeInput) {
     event = Looper::EVENT_INPUT;
@@ -115,12 +429,61 @@ bool LooperBackedEventLoop::WatchFileDescriptor(
 }
 
 bool LooperBackedEventLoop::StopWatchFileDescriptor(int fd) {
+  {
+    // The number may be reused by an unrelated file descriptor.
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    fd_run_stats_.erase(fd);
+    fd_labels_.erase(fd);
+  }
   if (looper_->removeFd(fd) == 1) {
     return true;
   }
   return false;
 }
 
+void LooperBackedEventLoop::SetFileDescriptorLabel(int fd,
+                                                   const std::string& label) {
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  fd_labels_[fd] = label;
+}
+
+void LooperBackedEventLoop::Dump(std::stringstream* ss) const {
+  auto dump_latency = [ss](const char* name, const LatencyStats& stats) {
+    *ss << " " << name << " average "
+        << (stats.count == 0 ? 0 : ns2us(stats.total / stats.count))
+        << "us, max " << ns2us(stats.max) << "us";
+  };
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  *ss << "Event loop:" << std::endl;
+  for (size_t priority = 0; priority < task_delay_stats_.size(); priority++) {
+    *ss << "  " << kPriorityNames[priority] << " priority tasks: "
+        << task_delay_stats_[priority].count << ",";
+    dump_latency("delay", task_delay_stats_[priority]);
+    *ss << std::endl;
+  }
+  *ss << "  Tasks: " << task_run_stats_.count << ",";
+  dump_latency("run time", task_run_stats_);
+  *ss << ", max queued " << max_queued_tasks_ << std::endl;
+  *ss << "  Timers: " << timer_run_stats_.count << ",";
+  dump_latency("delay", timer_delay_stats_);
+  *ss << ",";
+  dump_latency("run time", timer_run_stats_);
+  *ss << std::endl;
+  for (const auto& itr : fd_run_stats_) {
+    const auto label = fd_labels_.find(itr.first);
+    *ss << "  "
+        << (label != fd_labels_.end() ? label->second
+                                      : "fd " + std::to_string(itr.first))
+        << " callbacks: " << itr.second.count << ",";
+    dump_latency("run time", itr.second);
+    *ss << std::endl;
+  }
+  if (longest_handler_run_time_ > 0) {
+    *ss << "  Longest handler: " << longest_handler_ << ", "
+        << ns2us(longest_handler_run_time_) << "us" << std::endl;
+  }
+}
+
 void LooperBackedEventLoop::Poll() {
   while (should_continue_) {
     looper_->pollOnce(-1);
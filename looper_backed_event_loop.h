@@ -19,8 +19,21 @@
 
 #include "event_loop.h"
 
+#include <array>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <sstream>
+#include <string>
+#include <utility>
+
 #include <android-base/macros.h>
+#include <android-base/unique_fd.h>
 #include <utils/Looper.h>
+#include <utils/Timers.h>
 
 namespace android {
 namespace wificond {
@@ -33,9 +46,22 @@ class LooperBackedEventLoop: public EventLoop {
   // See event_loop.h
   void PostTask(const std::function<void()>& callback) override;
 
+  // See event_loop.h
+  void PostTaskWithPriority(const std::function<void()>& callback,
+                            TaskPriority priority) override;
+
   // See event_loop.h
   void PostDelayedTask(const std::function<void()>& callback,
                        int64_t delay_ms) override;
+
+  // See event_loop.h
+  TimerId PostCancelableDelayedTask(const std::function<void()>& callback,
+                                    int64_t delay_ms,
+                                    int64_t slack_ms) override;
+
+  // See event_loop.h
+  bool CancelDelayedTask(TimerId timer_id) override;
+
   // See event_loop.h
   bool WatchFileDescriptor(
       int fd,
@@ -45,6 +71,12 @@ class LooperBackedEventLoop: public EventLoop {
   // See event_loop.h
   bool StopWatchFileDescriptor(int fd) override;
 
+  // See event_loop.h
+  void SetFileDescriptorLabel(int fd, const std::string& label) override;
+
+  // See event_loop.h
+  void Dump(std::stringstream* ss) const override;
+
   // Performs all pending callbacks and waiting for new events until
   // TriggerExit() is called.
   // This method can be called from any thread context.
@@ -58,9 +90,128 @@ class LooperBackedEventLoop: public EventLoop {
   // This method can be called from any thread context.
   void TriggerExit();
 
+  // Makes callbacks run with |lock| held exclusively, so that other threads
+  // can read the state that callbacks modify with |lock| held shared.
+  // This only applies to callbacks that are posted or watched afterwards, so
+  // it must be called before the event loop is used.
+  void SetCallbackLock(std::shared_mutex* lock) { callback_lock_ = lock; }
+
  private:
+  struct PostedTask;
+
+  // Runs the tasks that were posted before |wakeup_fd_| got signaled, by
+  // priority.
+  void RunPostedTasks();
+  // Moves the tasks of |posted_tasks_| to |tasks_|.
+  void TakePostedTasks();
+  // Takes a free node of |task_pool_|, or allocates one if all are in use.
+  // This method can be called from any thread context.
+  PostedTask* AcquireTask();
+  // Returns |task| to |task_pool_| once it ran, or deletes it if it was
+  // allocated. Only the event loop thread returns tasks.
+  void ReleaseTask(PostedTask* task);
+  // Runs all timers whose window has started.
+  void RunTimers();
+  // Makes sure that |looper_| wakes up at the earliest deadline of
+  // |timers_|, with a single message.
+  // |timers_mutex_| must be held.
+  void ScheduleTimersWakeupLocked();
+  // Runs |task| with |callback_lock_| held, if there is one.
+  // |trace_name| names the atrace slice of |task|.
+  // Returns how long |task| ran, not counting the wait for the lock.
+  nsecs_t RunWithCallbackLock(const std::function<void()>& task,
+                              const char* trace_name);
+  // Runs the callback of watched file descriptor |fd|.
+  void RunFdCallback(const std::function<void(int)>& callback, int fd);
+  // Records that handler |name| ran for |run_time|.
+  // |stats_mutex_| must be held.
+  void RecordHandlerLocked(const std::string& name, nsecs_t run_time);
+
   sp<android::Looper> looper_;
   bool should_continue_;
+  std::shared_mutex* callback_lock_;
+
+  // Posted tasks are pushed onto |posted_tasks_|, a lock free stack shared
+  // by all posting threads, instead of being handed to |looper_| one by one.
+  // Only a task that is pushed onto an empty stack signals |wakeup_fd_|, so
+  // a burst of posted tasks costs one wakeup. The event loop thread then
+  // takes the whole stack at once, and queues the tasks by priority in
+  // |tasks_|, which only the event loop thread accesses.
+  // The nodes of both are recycled through |task_pool_|, so that posting
+  // only allocates while more than |kTaskPoolSize| tasks are pending.
+  static constexpr uint32_t kTaskPoolSize = 128;
+  struct PostedTask {
+    std::function<void()> callback;
+    TaskPriority priority = kPriorityNormal;
+    nsecs_t post_time = 0;
+    // Next task of |posted_tasks_|, then of its queue in |tasks_|.
+    PostedTask* next = nullptr;
+    // Index + 1 of the next free node of |task_pool_|, 0 if there is none.
+    std::atomic<uint32_t> next_free{0};
+    // Whether this node belongs to |task_pool_|.
+    bool pooled = false;
+  };
+  // Tasks of one priority in posting order, linked by |PostedTask::next|.
+  struct TaskQueue {
+    PostedTask* head = nullptr;
+    PostedTask* tail = nullptr;
+    size_t size = 0;
+  };
+  std::unique_ptr<PostedTask[]> task_pool_;
+  // Index + 1 of the first free node of |task_pool_| in the low 32 bits, and
+  // the number of nodes taken so far in the high 32 bits, so that a thread
+  // cannot take a node that another thread took and returned in the meantime.
+  std::atomic<uint64_t> free_tasks_;
+  std::atomic<PostedTask*> posted_tasks_;
+  android::base::unique_fd wakeup_fd_;
+  std::array<TaskQueue, kPriorityLow + 1> tasks_;
+
+  // |looper_| delivers a message to |timer_handler_| at the earliest timer
+  // deadline.
+  sp<android::MessageHandler> timer_handler_;
+  std::mutex timers_mutex_;
+
+  // Delayed tasks run in a window from |earliest| to |deadline|, in uptime.
+  // |looper_| wakes up at the earliest deadline and runs every timer whose
+  // window has started, so timers with overlapping windows share a wakeup.
+  struct Timer {
+    std::function<void()> callback;
+    nsecs_t earliest;
+    nsecs_t deadline;
+  };
+  std::map<TimerId, Timer> timers_;
+  // Timer ids ordered by deadline, then by id, i.e. by posting order.
+  std::set<std::pair<nsecs_t, TimerId>> timer_deadlines_;
+  TimerId next_timer_id_;
+  // Deadline the timers message is sent for, or 0 if there is none.
+  nsecs_t scheduled_wakeup_;
+
+  // Count, total and maximum of a latency.
+  struct LatencyStats {
+    uint64_t count = 0;
+    nsecs_t total = 0;
+    nsecs_t max = 0;
+
+    void Record(nsecs_t latency);
+  };
+  // Statistics of the callbacks run so far, for |Dump|.
+  // Callbacks only run on the event loop thread, but |Dump| and
+  // |SetFileDescriptorLabel| may be called on other threads.
+  mutable std::mutex stats_mutex_;
+  // Time from posting a task until it starts running, by priority.
+  std::array<LatencyStats, kPriorityLow + 1> task_delay_stats_;
+  LatencyStats task_run_stats_;
+  // Time from the start of the window of a timer until it starts running.
+  LatencyStats timer_delay_stats_;
+  LatencyStats timer_run_stats_;
+  // Run time of the callbacks of each watched file descriptor.
+  std::map<int, LatencyStats> fd_run_stats_;
+  std::map<int, std::string> fd_labels_;
+  // Largest number of tasks that were queued at once.
+  size_t max_queued_tasks_;
+  // The handler that blocked the event loop for the longest time.
+  std::string longest_handler_;
+  nsecs_t longest_handler_run_time_;
 
   DISALLOW_COPY_AND_ASSIGN(LooperBackedEventLoop);
 };
@@ -18,7 +18,14 @@
 #include <sys/capability.h>
 
 #include <csignal>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include <android-base/logging.h>
 #include <android-base/macros.h>
@@ -28,8 +35,12 @@
 #include <cutils/properties.h>
 #include <libminijail.h>
 #include <utils/String16.h>
+#include <utils/Timers.h>
 #include <wifi_system/interface_tool.h>
 
+#include "wificond/binder_call_dispatcher.h"
+#include "wificond/callback_dispatcher.h"
+#include "wificond/flight_recorder.h"
 #include "wificond/ipc_constants.h"
 #include "wificond/looper_backed_event_loop.h"
 #include "wificond/net/netlink_manager.h"
@@ -39,9 +50,12 @@
 #include "wifi_keystore_hal_connector.h"
 
 using android::net::wifi::nl80211::IWificond;
+using android::wificond::BinderCallDispatcher;
+using android::wificond::FlightRecorder;
 using android::wifi_system::InterfaceTool;
 using android::wificond::ipc_constants::kServiceName;
 using android::wificond::WifiKeystoreHalConnector;
+using std::string;
 using std::unique_ptr;
 
 namespace {
@@ -77,6 +91,79 @@ class ScopedSignalHandler final {
 android::wificond::LooperBackedEventLoop*
     ScopedSignalHandler::s_event_loop_ = nullptr;
 
+// Times the phases of startup, which is on the critical path of Wi-Fi
+// recovery whenever wificond restarts.
+// Phases may run on different threads.
+class StartupProfile final {
+ public:
+  StartupProfile() : start_time_(systemTime(SYSTEM_TIME_MONOTONIC)) {}
+
+  // Runs |phase| and records how long it took under |name|.
+  void Time(const char* name, const std::function<void()>& phase) {
+    nsecs_t start_time = systemTime(SYSTEM_TIME_MONOTONIC);
+    phase();
+    nsecs_t duration = systemTime(SYSTEM_TIME_MONOTONIC) - start_time;
+    std::lock_guard<std::mutex> lock(lock_);
+    phases_.emplace_back(name, duration);
+  }
+
+  // Logs that |milestone| was reached, with the phases recorded so far.
+  void Log(const char* milestone) {
+    std::lock_guard<std::mutex> lock(lock_);
+    string phases;
+    for (const auto& phase : phases_) {
+      phases += (phases.empty() ? "" : ", ") + string(phase.first) + " " +
+          std::to_string(ns2ms(phase.second)) + "ms";
+    }
+    LOG(INFO) << milestone << " "
+              << ns2ms(systemTime(SYSTEM_TIME_MONOTONIC) - start_time_)
+              << "ms after startup (" << phases << ")";
+  }
+
+ private:
+  const nsecs_t start_time_;
+  std::mutex lock_;
+  std::vector<std::pair<const char*, nsecs_t>> phases_;
+
+  DISALLOW_COPY_AND_ASSIGN(StartupProfile);
+};
+
+// Number of binder threads serving wificond. 0 means binder commands are
+// polled on the event loop thread.
+constexpr char kBinderThreadsProperty[] = "ro.wificond.binder_threads";
+
+// Number of HIDL threads serving the keystore lookups of wpa_supplicant.
+// Enterprise networks that reconnect at the same time look up their
+// certificates concurrently with more than one.
+constexpr char kKeystoreThreadsProperty[] = "ro.wificond.keystore_threads";
+
+// Number of threads that large scan result dumps are parsed on. 0 means they
+// are parsed on the event loop thread.
+constexpr char kScanParseThreadsProperty[] = "ro.wificond.scan_parse_threads";
+
+// Memory budget of the caches and buffers of wificond, in KiB. Memory
+// pressure signals trim all of them while they use more. 0 means there is
+// no budget.
+constexpr char kMemoryBudgetProperty[] = "ro.wificond.memory_budget_kb";
+
+// If true, netlink events are drained from the socket on a thread of their
+// own, so that they are not dropped while the event loop is busy.
+constexpr char kNetlinkReceiveThreadProperty[] =
+    "ro.wificond.netlink_receive_thread";
+
+// Path of a file that all netlink traffic is recorded to, for replaying it
+// off-device. Capturing is off when this is empty.
+constexpr char kNetlinkCaptureProperty[] = "wificond.netlink_capture_path";
+
+// File that the channels of the networks seen in scan results are kept in,
+// to narrow down later scans for them.
+constexpr char kChannelHistoryPath[] =
+    "/data/misc/wifi/wificond_channel_history";
+
+// File that the wiphy capabilities are kept in, so that interfaces are
+// brought up without a wiphy dump as long as the device is the same.
+constexpr char kWiphySnapshotPath[] =
+    "/data/misc/wifi/wificond_wiphy_snapshot";
 
 // Setup our interface to the Binder driver or die trying.
 int SetupBinderOrCrash() {
@@ -89,6 +176,14 @@ int SetupBinderOrCrash() {
   return binder_fd;
 }
 
+// Setup a binder thread pool of |num_threads| threads. Transactions are
+// routed through |dispatcher|.
+void SetupBinderThreadPool(size_t num_threads,
+                           BinderCallDispatcher* dispatcher) {
+  BinderCallDispatcher::SetInstance(dispatcher);
+  android::ProcessState::self()->setThreadPoolMaxThreadCount(num_threads);
+}
+
 void RegisterServiceOrCrash(const android::sp<android::IBinder>& service) {
   android::sp<android::IServiceManager> sm = android::defaultServiceManager();
   CHECK_EQ(sm != NULL, true) << "Could not obtain IServiceManager";
@@ -106,34 +201,121 @@ void OnBinderReadReady(int fd) {
 int main(int argc, char** argv) {
   android::base::InitLogging(argv, android::base::LogdLogger(android::base::SYSTEM));
   LOG(INFO) << "wificond is starting up...";
+  StartupProfile startup_profile;
+
+  // Nothing in wificond depends on the keystore HAL, so it registers while
+  // the rest of wificond starts up.
+  WifiKeystoreHalConnector keystore_connector;
+  std::thread keystore_thread([&startup_profile, &keystore_connector]() {
+    startup_profile.Time("keystore", [&keystore_connector]() {
+      const int32_t num_keystore_threads =
+          property_get_int32(kKeystoreThreadsProperty, 0);
+      keystore_connector.start(num_keystore_threads > 0 ?
+          num_keystore_threads : WifiKeystoreHalConnector::kDefaultNumThreads);
+    });
+    startup_profile.Log("Keystore HAL registered");
+  });
 
   unique_ptr<android::wificond::LooperBackedEventLoop> event_dispatcher(
       new android::wificond::LooperBackedEventLoop());
   ScopedSignalHandler scoped_signal_handler(event_dispatcher.get());
 
-  int binder_fd = SetupBinderOrCrash();
-  CHECK(event_dispatcher->WatchFileDescriptor(
-      binder_fd,
-      android::wificond::EventLoop::kModeInput,
-      &OnBinderReadReady)) << "Failed to watch binder FD";
+  // Always on, so that field issues can be looked into from a dump.
+  // It must be installed before binder calls or netlink traffic start.
+  FlightRecorder flight_recorder;
+  FlightRecorder::SetInstance(&flight_recorder);
 
-  android::wificond::NetlinkManager netlink_manager(event_dispatcher.get());
-  if (!netlink_manager.Start()) {
-    LOG(ERROR) << "Failed to start netlink manager";
+  const int32_t num_binder_threads =
+      property_get_int32(kBinderThreadsProperty, 0);
+  unique_ptr<BinderCallDispatcher> binder_call_dispatcher;
+  // Held until wificond is ready to serve binder calls, see below.
+  std::unique_lock<std::shared_mutex> startup_lock;
+  if (num_binder_threads > 0) {
+    LOG(INFO) << "Serving binder with " << num_binder_threads << " threads";
+    binder_call_dispatcher.reset(
+        new BinderCallDispatcher(event_dispatcher.get()));
+    // This must happen before any callback is registered on the event loop.
+    event_dispatcher->SetCallbackLock(binder_call_dispatcher->GetStateLock());
+    SetupBinderThreadPool(num_binder_threads, binder_call_dispatcher.get());
+    startup_lock = std::unique_lock<std::shared_mutex>(
+        *binder_call_dispatcher->GetStateLock());
+    android::ProcessState::self()->startThreadPool();
+  } else {
+    int binder_fd = SetupBinderOrCrash();
+    CHECK(event_dispatcher->WatchFileDescriptor(
+        binder_fd,
+        android::wificond::EventLoop::kModeInput,
+        &OnBinderReadReady)) << "Failed to watch binder FD";
+    event_dispatcher->SetFileDescriptorLabel(binder_fd, "binder");
   }
+
+  android::wificond::NetlinkSocketConfig netlink_socket_config;
+  netlink_socket_config.async_event_filter = true;
+  netlink_socket_config.async_receive_thread =
+      property_get_bool(kNetlinkReceiveThreadProperty, false);
+  android::wificond::NetlinkManager netlink_manager(event_dispatcher.get(),
+                                                    netlink_socket_config);
   android::wificond::NetlinkUtils netlink_utils(&netlink_manager);
   android::wificond::ScanUtils scan_utils(&netlink_manager);
-
+  const int32_t num_scan_parse_threads =
+      property_get_int32(kScanParseThreadsProperty, 0);
+  if (num_scan_parse_threads > 0) {
+    scan_utils.SetNumParseThreads(num_scan_parse_threads);
+  }
+  // Listener processes that fall behind must not hold up the event loop.
+  android::wificond::CallbackDispatcher callback_dispatcher;
   android::sp<android::wificond::Server> server(new android::wificond::Server(
       unique_ptr<InterfaceTool>(new InterfaceTool),
+      event_dispatcher.get(),
       &netlink_utils,
       &scan_utils));
-  RegisterServiceOrCrash(server);
+  server->SetCallbackDispatcher(&callback_dispatcher);
+  const int32_t memory_budget_kb =
+      property_get_int32(kMemoryBudgetProperty, 0);
+  if (memory_budget_kb > 0) {
+    server->SetMemoryBudget(static_cast<size_t>(memory_budget_kb) * 1024);
+  }
 
-  WifiKeystoreHalConnector keystore_connector;
-  keystore_connector.start();
+  // The service is registered while netlink starts, so that clients can
+  // look it up early. Their calls are held back until wificond is ready:
+  //   - In polled mode, binder commands are only handled once the event loop
+  //     polls.
+  //   - With a binder thread pool, transactions are either posted to the
+  //     event loop, or wait for |startup_lock| to be released.
+  std::thread register_thread([&startup_profile, &server]() {
+    startup_profile.Time("service registration", [&server]() {
+      RegisterServiceOrCrash(server);
+    });
+  });
+
+  startup_profile.Time("netlink", [&netlink_manager]() {
+    char capture_path[PROPERTY_VALUE_MAX];
+    if (property_get(kNetlinkCaptureProperty, capture_path, "") > 0) {
+      // Started before the nl80211 family is discovered, so that replays can
+      // discover it as well.
+      netlink_manager.StartCapture(capture_path);
+    }
+    if (!netlink_manager.Start()) {
+      LOG(ERROR) << "Failed to start netlink manager";
+    }
+  });
+  startup_profile.Time("persistent state", [&scan_utils, &server]() {
+    if (!scan_utils.OpenChannelHistory(kChannelHistoryPath)) {
+      LOG(WARNING) << "Channel history is only kept in memory";
+    }
+    if (!server->OpenWiphySnapshot(kWiphySnapshotPath)) {
+      LOG(WARNING) << "Wiphy snapshot is only kept in memory";
+    }
+  });
+
+  register_thread.join();
+  if (startup_lock.owns_lock()) {
+    startup_lock.unlock();
+  }
+  startup_profile.Log("wificond is ready");
 
   event_dispatcher->Poll();
   LOG(INFO) << "wificond is about to exit";
+  keystore_thread.join();
   return 0;
 }
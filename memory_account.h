@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_MEMORY_ACCOUNT_H_
+#define WIFICOND_MEMORY_ACCOUNT_H_
+
+#include <stddef.h>
+
+namespace android {
+namespace wificond {
+
+// Approximate heap memory in bytes held by a part of wificond, e.g. a cache
+// or a set of buffers. Its owner updates it on every change, so that the
+// peak also covers what happens between two dumps.
+// Not thread safe: an account is meant to be updated by its owner on the
+// event loop thread.
+class MemoryAccount {
+ public:
+  // |name| must outlive the account, e.g. be a string literal.
+  explicit MemoryAccount(const char* name) : name_(name) {}
+  MemoryAccount(const char* name, size_t current, size_t peak)
+      : name_(name),
+        current_(current),
+        peak_(peak < current ? current : peak) {}
+
+  void Set(size_t bytes) {
+    current_ = bytes;
+    if (bytes > peak_) {
+      peak_ = bytes;
+    }
+  }
+  void Add(size_t bytes) { Set(current_ + bytes); }
+  void Subtract(size_t bytes) {
+    current_ = bytes < current_ ? current_ - bytes : 0;
+  }
+
+  const char* GetName() const { return name_; }
+  size_t GetCurrent() const { return current_; }
+  size_t GetPeak() const { return peak_; }
+
+ private:
+  const char* name_;
+  size_t current_ = 0;
+  size_t peak_ = 0;
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_MEMORY_ACCOUNT_H_
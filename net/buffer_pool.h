@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_NET_BUFFER_POOL_H_
+#define WIFICOND_NET_BUFFER_POOL_H_
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <array>
+#include <utility>
+#include <vector>
+
+namespace android {
+namespace wificond {
+
+// BufferPool keeps the storage of released vectors for reuse, so that the
+// buffers of short-lived objects, e.g. netlink packets, are not allocated
+// anew for each object.
+// Buffers are kept in free lists of power of two size classes, from
+// |kMinCapacity| to |kMaxCapacity| elements. Larger buffers are allocated
+// and freed as usual.
+// Free lists are per thread, so no locking is needed. A buffer acquired on
+// one thread and released on another one moves to the free lists of the
+// latter.
+template <typename T>
+class BufferPool {
+ public:
+  static constexpr size_t kMinCapacity = 64;
+  static constexpr size_t kNumSizeClasses = 11;
+  static constexpr size_t kMaxCapacity = kMinCapacity << (kNumSizeClasses - 1);
+  // Bytes of storage kept per thread at most. Buffers released once this is
+  // reached are freed.
+  static constexpr size_t kMaxCachedBytes = 256 * 1024;
+
+  // Returns an empty vector with capacity for at least |size| elements.
+  static std::vector<T> Acquire(size_t size) {
+    std::vector<T> buffer;
+    if (size > kMaxCapacity) {
+      buffer.reserve(size);
+      return buffer;
+    }
+    size_t size_class = GetSmallestClassFor(size);
+    FreeLists* free_lists = GetFreeLists();
+    if (free_lists != nullptr && !free_lists->buffers[size_class].empty()) {
+      buffer = std::move(free_lists->buffers[size_class].back());
+      free_lists->buffers[size_class].pop_back();
+      free_lists->cached_bytes -= buffer.capacity() * sizeof(T);
+      return buffer;
+    }
+    buffer.reserve(kMinCapacity << size_class);
+    return buffer;
+  }
+
+  // Keeps the storage of |buffer| for a later Acquire() on this thread.
+  static void Release(std::vector<T>&& buffer) {
+    size_t capacity = buffer.capacity();
+    if (capacity < kMinCapacity || capacity > kMaxCapacity) {
+      return;
+    }
+    FreeLists* free_lists = GetFreeLists();
+    if (free_lists == nullptr ||
+        free_lists->cached_bytes + capacity * sizeof(T) > kMaxCachedBytes) {
+      return;
+    }
+    buffer.clear();
+    free_lists->cached_bytes += capacity * sizeof(T);
+    free_lists->peak_cached_bytes =
+        std::max(free_lists->peak_cached_bytes, free_lists->cached_bytes);
+    free_lists->buffers[GetLargestClassWithin(capacity)].push_back(
+        std::move(buffer));
+  }
+
+  // Returns the bytes of storage kept for this thread now, and at most so
+  // far.
+  static size_t GetCachedBytes() {
+    FreeLists* free_lists = GetFreeLists();
+    return free_lists == nullptr ? 0 : free_lists->cached_bytes;
+  }
+  static size_t GetPeakCachedBytes() {
+    FreeLists* free_lists = GetFreeLists();
+    return free_lists == nullptr ? 0 : free_lists->peak_cached_bytes;
+  }
+
+  // Frees the storage kept for this thread, e.g. under memory pressure.
+  static void Trim() {
+    FreeLists* free_lists = GetFreeLists();
+    if (free_lists == nullptr) {
+      return;
+    }
+    for (auto& buffers : free_lists->buffers) {
+      std::vector<std::vector<T>>().swap(buffers);
+    }
+    free_lists->cached_bytes = 0;
+  }
+
+ private:
+  struct FreeLists {
+    ~FreeLists() { *GetDestroyed() = true; }
+
+    std::array<std::vector<std::vector<T>>, kNumSizeClasses> buffers;
+    size_t cached_bytes = 0;
+    size_t peak_cached_bytes = 0;
+  };
+
+  // Returns the free lists of this thread, or nullptr once they are
+  // destroyed at thread exit.
+  static FreeLists* GetFreeLists() {
+    if (*GetDestroyed()) {
+      return nullptr;
+    }
+    thread_local FreeLists free_lists;
+    return &free_lists;
+  }
+
+  // Trivially destructible, so that it can still be read after the free
+  // lists are destroyed.
+  static bool* GetDestroyed() {
+    thread_local bool destroyed = false;
+    return &destroyed;
+  }
+
+  // Returns the first size class whose buffers hold |size| elements.
+  static size_t GetSmallestClassFor(size_t size) {
+    size_t size_class = 0;
+    while ((kMinCapacity << size_class) < size) {
+      size_class++;
+    }
+    return size_class;
+  }
+
+  // Returns the last size class whose buffers fit in |capacity| elements.
+  static size_t GetLargestClassWithin(size_t capacity) {
+    size_t size_class = 0;
+    while (size_class + 1 < kNumSizeClasses &&
+           (kMinCapacity << (size_class + 1)) <= capacity) {
+      size_class++;
+    }
+    return size_class;
+  }
+};
+
+template <typename T>
+constexpr size_t BufferPool<T>::kMinCapacity;
+template <typename T>
+constexpr size_t BufferPool<T>::kNumSizeClasses;
+template <typename T>
+constexpr size_t BufferPool<T>::kMaxCapacity;
+template <typename T>
+constexpr size_t BufferPool<T>::kMaxCachedBytes;
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_NET_BUFFER_POOL_H_
@@ -0,0 +1,276 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_NET_CHANNEL_SET_H_
+#define WIFICOND_NET_CHANNEL_SET_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <vector>
+
+namespace android {
+namespace wificond {
+
+// Set of Wi-Fi channels, identified by their center frequency in MHz, as a
+// bitset. Union, intersection and membership take a few word operations,
+// and iteration goes in increasing frequency order.
+// Each channel of the following bands has a bit:
+//   2.4 GHz: channels 1 to 14, 2412 to 2484 MHz
+//   5 GHz:   channels 0 to 184, 5000 to 5920 MHz
+//   6 GHz:   channel 2 at 5935 MHz, and channels 1 to 233, 5955 to 7115 MHz
+// Frequencies off these channels can't be added.
+class ChannelSet {
+ public:
+  enum Band {
+    kBandNone,
+    kBand2Ghz,
+    kBand5Ghz,
+    kBand6Ghz,
+  };
+
+  static constexpr size_t kNum2GhzChannels = 14;
+  static constexpr size_t kNum5GhzChannels = 185;
+  // Every 5 MHz from 5935 to 7130 MHz.
+  static constexpr size_t kNum6GhzSlots = 240;
+  static constexpr size_t kNumSlots =
+      kNum2GhzChannels + kNum5GhzChannels + kNum6GhzSlots;
+  static constexpr int kInvalidIndex = -1;
+
+  constexpr ChannelSet() : words_{} {}
+  explicit ChannelSet(const std::vector<uint32_t>& frequencies) : words_{} {
+    for (uint32_t frequency : frequencies) {
+      Add(frequency);
+    }
+  }
+
+  // Returns the bit of |frequency|, or kInvalidIndex if it is off the
+  // channels of the set.
+  static constexpr int GetIndex(uint32_t frequency) {
+    if (frequency >= 2412 && frequency <= 2472 && (frequency - 2412) % 5 == 0) {
+      return (frequency - 2412) / 5;
+    }
+    if (frequency == 2484) {
+      return kNum2GhzChannels - 1;
+    }
+    if (frequency >= 5000 && frequency < 5000 + 5 * kNum5GhzChannels &&
+        frequency % 5 == 0) {
+      return kNum2GhzChannels + (frequency - 5000) / 5;
+    }
+    if (frequency >= 5935 && frequency < 5935 + 5 * kNum6GhzSlots &&
+        frequency % 5 == 0) {
+      return kNum2GhzChannels + kNum5GhzChannels + (frequency - 5935) / 5;
+    }
+    return kInvalidIndex;
+  }
+
+  // Returns the frequency of bit |index|.
+  static constexpr uint32_t GetFrequency(size_t index) {
+    if (index < kNum2GhzChannels) {
+      return index == kNum2GhzChannels - 1 ? 2484 : 2412 + 5 * index;
+    }
+    index -= kNum2GhzChannels;
+    if (index < kNum5GhzChannels) {
+      return 5000 + 5 * index;
+    }
+    return 5935 + 5 * (index - kNum5GhzChannels);
+  }
+
+  static constexpr Band GetBand(uint32_t frequency) {
+    int index = GetIndex(frequency);
+    if (index == kInvalidIndex) {
+      return kBandNone;
+    }
+    if (static_cast<size_t>(index) < kNum2GhzChannels) {
+      return kBand2Ghz;
+    }
+    if (static_cast<size_t>(index) < kNum2GhzChannels + kNum5GhzChannels) {
+      return kBand5Ghz;
+    }
+    return kBand6Ghz;
+  }
+
+  // Returns the channel number of |frequency|, or 0 if it is off the
+  // channels of the set.
+  static constexpr uint32_t GetChannel(uint32_t frequency) {
+    switch (GetBand(frequency)) {
+      case kBand2Ghz:
+        return frequency == 2484 ? 14 : (frequency - 2407) / 5;
+      case kBand5Ghz:
+        return (frequency - 5000) / 5;
+      case kBand6Ghz:
+        if (frequency == 5935) {
+          return 2;
+        }
+        return frequency > 5950 ? (frequency - 5950) / 5 : 0;
+      default:
+        return 0;
+    }
+  }
+
+  // Returns the frequency of |channel| in |band|, or 0 if there is none.
+  static constexpr uint32_t GetChannelFrequency(Band band, uint32_t channel) {
+    uint32_t frequency = 0;
+    switch (band) {
+      case kBand2Ghz:
+        frequency = channel == 14 ? 2484 : 2407 + 5 * channel;
+        break;
+      case kBand5Ghz:
+        frequency = 5000 + 5 * channel;
+        break;
+      case kBand6Ghz:
+        frequency = channel == 2 ? 5935 : 5950 + 5 * channel;
+        break;
+      default:
+        return 0;
+    }
+    return GetBand(frequency) == band && GetChannel(frequency) == channel ?
+        frequency : 0;
+  }
+
+  // Returns the set of all frequencies of |band| that a set can hold.
+  static constexpr ChannelSet GetBandChannels(Band band) {
+    ChannelSet channels;
+    for (size_t i = 0; i < kNumSlots; i++) {
+      if (GetBand(GetFrequency(i)) == band) {
+        channels.SetBit(i);
+      }
+    }
+    return channels;
+  }
+
+  // Adds |frequency|. Returns false if it is off the channels of the set.
+  constexpr bool Add(uint32_t frequency) {
+    int index = GetIndex(frequency);
+    if (index == kInvalidIndex) {
+      return false;
+    }
+    SetBit(index);
+    return true;
+  }
+
+  constexpr void Remove(uint32_t frequency) {
+    int index = GetIndex(frequency);
+    if (index != kInvalidIndex) {
+      words_[index / 64] &= ~(uint64_t{1} << (index % 64));
+    }
+  }
+
+  constexpr bool Contains(uint32_t frequency) const {
+    int index = GetIndex(frequency);
+    return index != kInvalidIndex &&
+        (words_[index / 64] & (uint64_t{1} << (index % 64))) != 0;
+  }
+
+  constexpr ChannelSet& operator|=(const ChannelSet& other) {
+    for (size_t i = 0; i < kNumWords; i++) {
+      words_[i] |= other.words_[i];
+    }
+    return *this;
+  }
+
+  constexpr ChannelSet& operator&=(const ChannelSet& other) {
+    for (size_t i = 0; i < kNumWords; i++) {
+      words_[i] &= other.words_[i];
+    }
+    return *this;
+  }
+
+  // Removes the channels of |other|.
+  constexpr ChannelSet& operator-=(const ChannelSet& other) {
+    for (size_t i = 0; i < kNumWords; i++) {
+      words_[i] &= ~other.words_[i];
+    }
+    return *this;
+  }
+
+  friend constexpr ChannelSet operator|(ChannelSet lhs,
+                                        const ChannelSet& rhs) {
+    return lhs |= rhs;
+  }
+  friend constexpr ChannelSet operator&(ChannelSet lhs,
+                                        const ChannelSet& rhs) {
+    return lhs &= rhs;
+  }
+  friend constexpr ChannelSet operator-(ChannelSet lhs,
+                                        const ChannelSet& rhs) {
+    return lhs -= rhs;
+  }
+
+  constexpr bool operator==(const ChannelSet& other) const {
+    for (size_t i = 0; i < kNumWords; i++) {
+      if (words_[i] != other.words_[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+  constexpr bool operator!=(const ChannelSet& other) const {
+    return !(*this == other);
+  }
+
+  constexpr bool empty() const {
+    for (uint64_t word : words_) {
+      if (word != 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  size_t size() const {
+    size_t size = 0;
+    for (uint64_t word : words_) {
+      size += __builtin_popcountll(word);
+    }
+    return size;
+  }
+
+  // Calls |function| with each frequency of the set, in increasing order.
+  template <typename Function>
+  void ForEach(Function function) const {
+    for (size_t i = 0; i < kNumWords; i++) {
+      for (uint64_t word = words_[i]; word != 0; word &= word - 1) {
+        function(GetFrequency(i * 64 + __builtin_ctzll(word)));
+      }
+    }
+  }
+
+  // Appends the frequencies of the set to |*out_frequencies|, in increasing
+  // order.
+  template <typename T>
+  void AppendTo(std::vector<T>* out_frequencies) const {
+    out_frequencies->reserve(out_frequencies->size() + size());
+    ForEach([out_frequencies](uint32_t frequency) {
+      out_frequencies->push_back(frequency);
+    });
+  }
+
+ private:
+  static constexpr size_t kNumWords = (kNumSlots + 63) / 64;
+
+  constexpr void SetBit(size_t index) {
+    words_[index / 64] |= uint64_t{1} << (index % 64);
+  }
+
+  std::array<uint64_t, kNumWords> words_;
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_NET_CHANNEL_SET_H_
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_NET_FLAT_HANDLER_MAP_H_
+#define WIFICOND_NET_FLAT_HANDLER_MAP_H_
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace android {
+namespace wificond {
+
+// FlatHandlerMap maps an interface or wiphy index to an event handler.
+// It supports the subset of the std::map interface that NetlinkManager uses
+// for its handler registries.
+// Entries are kept sorted in a single contiguous vector. A device only has a
+// handful of interfaces, so a lookup touches one or two cache lines instead
+// of chasing tree nodes, which matters because it runs for every multicast
+// event.
+// Like for a std::vector, iterators and references to handlers are
+// invalidated when an entry is added or removed. A handler that may subscribe
+// or unsubscribe while being run must be copied before it is run.
+template <typename Handler>
+class FlatHandlerMap {
+ public:
+  typedef std::pair<uint32_t, Handler> value_type;
+  typedef typename std::vector<value_type>::iterator iterator;
+  typedef typename std::vector<value_type>::const_iterator const_iterator;
+
+  // Returns the handler of |index|. A default constructed handler is inserted
+  // if there is none yet.
+  Handler& operator[](uint32_t index) {
+    auto it = LowerBound(index);
+    if (it == entries_.end() || it->first != index) {
+      it = entries_.emplace(it, index, Handler());
+    }
+    return it->second;
+  }
+
+  iterator find(uint32_t index) {
+    auto it = LowerBound(index);
+    if (it == entries_.end() || it->first != index) {
+      return entries_.end();
+    }
+    return it;
+  }
+
+  const_iterator find(uint32_t index) const {
+    return const_cast<FlatHandlerMap*>(this)->find(index);
+  }
+
+  // Returns the number of removed handlers.
+  size_t erase(uint32_t index) {
+    auto it = find(index);
+    if (it == entries_.end()) {
+      return 0;
+    }
+    entries_.erase(it);
+    return 1;
+  }
+
+  bool empty() const { return entries_.empty(); }
+  size_t size() const { return entries_.size(); }
+
+  iterator begin() { return entries_.begin(); }
+  iterator end() { return entries_.end(); }
+  const_iterator begin() const { return entries_.begin(); }
+  const_iterator end() const { return entries_.end(); }
+
+ private:
+  iterator LowerBound(uint32_t index) {
+    return std::lower_bound(
+        entries_.begin(), entries_.end(), index,
+        [](const value_type& entry, uint32_t key) {
+          return entry.first < key;
+        });
+  }
+
+  std::vector<value_type> entries_;
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_NET_FLAT_HANDLER_MAP_H_
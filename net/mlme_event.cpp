@@ -19,9 +19,12 @@
 #include <vector>
 
 #include <android-base/logging.h>
+#include <utils/Timers.h>
 
 #include "wificond/net/kernel-header-latest/nl80211.h"
-#include "wificond/net/nl80211_packet.h"
+#include "wificond/net/nl80211_attribute.h"
+#include "wificond/net/nl80211_attribute_schema.h"
+#include "wificond/net/nl80211_packet_view.h"
 
 using std::array;
 using std::unique_ptr;
@@ -32,7 +35,9 @@ namespace wificond {
 
 namespace {
 
-bool GetCommonFields(const NL80211Packet* packet,
+constexpr uint8_t kElemIdHtOperation = 61;
+
+bool GetCommonFields(const NL80211PacketView* packet,
                      uint32_t* if_index,
                      array<uint8_t, ETH_ALEN>* bssid) {
   if (!packet->GetAttributeValue(NL80211_ATTR_IFINDEX, if_index)) {
@@ -46,14 +51,84 @@ bool GetCommonFields(const NL80211Packet* packet,
   return true;
 }
 
+// Returns the frequency of the primary channel announced by the HT Operation
+// element in |ies|, or 0 if there is none.
+// HT Operation is not used on 6GHz, so the channel number is not ambiguous.
+uint32_t GetFrequencyFromHtOperation(const vector<uint8_t>& ies) {
+  size_t pos = 0;
+  while (pos + 2 <= ies.size()) {
+    uint8_t id = ies[pos];
+    uint8_t length = ies[pos + 1];
+    if (pos + 2 + length > ies.size()) {
+      break;
+    }
+    if (id == kElemIdHtOperation && length >= 1) {
+      uint32_t channel = ies[pos + 2];
+      if (channel >= 1 && channel <= 13) {
+        return 2407 + 5 * channel;
+      }
+      if (channel == 14) {
+        return 2484;
+      }
+      if (channel >= 32 && channel <= 177) {
+        return 5000 + 5 * channel;
+      }
+      return 0;
+    }
+    pos += 2 + length;
+  }
+  return 0;
+}
+
+// Fields of connect and roam events.
+// These carry a dozen attributes, which are decoded with a single walk over
+// the packet instead of one lookup per field.
+struct AssociationFields {
+  uint32_t interface_index = 0;
+  array<uint8_t, ETH_ALEN> bssid{};
+  uint16_t status_code = 0;
+  bool is_timeout = false;
+  uint32_t frequency = 0;
+  vector<uint8_t> request_ies;
+  vector<uint8_t> response_ies;
+};
+
+constexpr auto kAssociationFieldsSchema = MakeNL80211AttrSchema(
+    NL80211ValueField<&AssociationFields::interface_index>(
+        NL80211_ATTR_IFINDEX, true),
+    NL80211ValueField<&AssociationFields::bssid>(NL80211_ATTR_MAC),
+    NL80211ValueField<&AssociationFields::status_code>(
+        NL80211_ATTR_STATUS_CODE),
+    NL80211FlagField<&AssociationFields::is_timeout>(NL80211_ATTR_TIMED_OUT),
+    NL80211ValueField<&AssociationFields::frequency>(NL80211_ATTR_WIPHY_FREQ),
+    NL80211ValueField<&AssociationFields::request_ies>(NL80211_ATTR_REQ_IE),
+    NL80211ValueField<&AssociationFields::response_ies>(
+        NL80211_ATTR_RESP_IE));
+
+// Gets the fields that connect and roam events have in common.
+// The frequency of the new BSS comes from NL80211_ATTR_WIPHY_FREQ, which not
+// all kernels send, or else from the association response.
+bool GetAssociationFields(const NL80211PacketView* packet,
+                          AssociationFields* fields) {
+  if (!kAssociationFieldsSchema.Decode(*packet, fields)) {
+    LOG(ERROR) << "Failed to get NL80211_ATTR_IFINDEX";
+    return false;
+  }
+  if (fields->frequency == 0) {
+    fields->frequency = GetFrequencyFromHtOperation(fields->response_ies);
+  }
+  return true;
+}
+
 }  // namespace
 
 unique_ptr<MlmeAssociateEvent> MlmeAssociateEvent::InitFromPacket(
-    const NL80211Packet* packet) {
+    const NL80211PacketView* packet) {
   if (packet->GetCommand() != NL80211_CMD_ASSOCIATE) {
     return nullptr;
   }
   unique_ptr<MlmeAssociateEvent> associate_event(new MlmeAssociateEvent());
+  associate_event->timestamp_ns_ = systemTime(SYSTEM_TIME_BOOTTIME);
 
   if (!GetCommonFields(packet,
                        &(associate_event->interface_index_),
@@ -70,49 +145,74 @@ unique_ptr<MlmeAssociateEvent> MlmeAssociateEvent::InitFromPacket(
   return associate_event;
 }
 
-unique_ptr<MlmeConnectEvent> MlmeConnectEvent::InitFromPacket(
-    const NL80211Packet* packet) {
-  if (packet->GetCommand() != NL80211_CMD_CONNECT) {
+unique_ptr<MlmeAuthenticateEvent> MlmeAuthenticateEvent::InitFromPacket(
+    const NL80211PacketView* packet) {
+  if (packet->GetCommand() != NL80211_CMD_AUTHENTICATE) {
     return nullptr;
   }
-  unique_ptr<MlmeConnectEvent> connect_event(new MlmeConnectEvent());
+  unique_ptr<MlmeAuthenticateEvent> authenticate_event(
+      new MlmeAuthenticateEvent());
+  authenticate_event->timestamp_ns_ = systemTime(SYSTEM_TIME_BOOTTIME);
   if (!GetCommonFields(packet,
-                       &(connect_event->interface_index_),
-                       &(connect_event->bssid_))){
+                       &(authenticate_event->interface_index_),
+                       &(authenticate_event->bssid_))){
     return nullptr;
   }
+  authenticate_event->is_timeout_ =
+      packet->HasAttribute(NL80211_ATTR_TIMED_OUT);
+
+  return authenticate_event;
+}
 
-  if (!packet->GetAttributeValue(NL80211_ATTR_STATUS_CODE,
-                                 &(connect_event->status_code_))) {
-    LOG(WARNING) << "Failed to get NL80211_ATTR_STATUS_CODE";
-    connect_event->status_code_ = 0;
+unique_ptr<MlmeConnectEvent> MlmeConnectEvent::InitFromPacket(
+    const NL80211PacketView* packet) {
+  if (packet->GetCommand() != NL80211_CMD_CONNECT) {
+    return nullptr;
   }
-  connect_event->is_timeout_ = packet->HasAttribute(NL80211_ATTR_TIMED_OUT);
+  unique_ptr<MlmeConnectEvent> connect_event(new MlmeConnectEvent());
+  connect_event->timestamp_ns_ = systemTime(SYSTEM_TIME_BOOTTIME);
+  AssociationFields fields;
+  if (!GetAssociationFields(packet, &fields)) {
+    return nullptr;
+  }
+  connect_event->interface_index_ = fields.interface_index;
+  connect_event->bssid_ = fields.bssid;
+  connect_event->status_code_ = fields.status_code;
+  connect_event->is_timeout_ = fields.is_timeout;
+  connect_event->frequency_ = fields.frequency;
+  connect_event->request_ies_ = std::move(fields.request_ies);
+  connect_event->response_ies_ = std::move(fields.response_ies);
 
   return connect_event;
 }
 
 unique_ptr<MlmeRoamEvent> MlmeRoamEvent::InitFromPacket(
-    const NL80211Packet* packet) {
+    const NL80211PacketView* packet) {
   if (packet->GetCommand() != NL80211_CMD_ROAM) {
     return nullptr;
   }
   unique_ptr<MlmeRoamEvent> roam_event(new MlmeRoamEvent());
-  if (!GetCommonFields(packet,
-                       &(roam_event->interface_index_),
-                       &(roam_event->bssid_))){
+  roam_event->timestamp_ns_ = systemTime(SYSTEM_TIME_BOOTTIME);
+  AssociationFields fields;
+  if (!GetAssociationFields(packet, &fields)) {
     return nullptr;
   }
+  roam_event->interface_index_ = fields.interface_index;
+  roam_event->bssid_ = fields.bssid;
+  roam_event->frequency_ = fields.frequency;
+  roam_event->request_ies_ = std::move(fields.request_ies);
+  roam_event->response_ies_ = std::move(fields.response_ies);
 
   return roam_event;
 }
 
 unique_ptr<MlmeDisconnectEvent> MlmeDisconnectEvent::InitFromPacket(
-    const NL80211Packet* packet) {
+    const NL80211PacketView* packet) {
   if (packet->GetCommand() != NL80211_CMD_DISCONNECT) {
     return nullptr;
   }
   unique_ptr<MlmeDisconnectEvent> disconnect_event(new MlmeDisconnectEvent());
+  disconnect_event->timestamp_ns_ = systemTime(SYSTEM_TIME_BOOTTIME);
   if (!GetCommonFields(packet,
                        &(disconnect_event->interface_index_),
                        &(disconnect_event->bssid_))){
@@ -122,11 +222,12 @@ unique_ptr<MlmeDisconnectEvent> MlmeDisconnectEvent::InitFromPacket(
 }
 
 unique_ptr<MlmeDisassociateEvent> MlmeDisassociateEvent::InitFromPacket(
-    const NL80211Packet* packet) {
+    const NL80211PacketView* packet) {
   if (packet->GetCommand() != NL80211_CMD_DISASSOCIATE) {
     return nullptr;
   }
   unique_ptr<MlmeDisassociateEvent> disassociate_event(new MlmeDisassociateEvent());
+  disassociate_event->timestamp_ns_ = systemTime(SYSTEM_TIME_BOOTTIME);
   if (!GetCommonFields(packet,
                        &(disassociate_event->interface_index_),
                        &(disassociate_event->bssid_))){
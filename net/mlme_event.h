@@ -19,6 +19,7 @@
 
 #include <array>
 #include <memory>
+#include <vector>
 
 #include <linux/if_ether.h>
 
@@ -27,12 +28,12 @@
 namespace android {
 namespace wificond {
 
-class NL80211Packet;
+class NL80211PacketView;
 
 class MlmeConnectEvent {
  public:
   static std::unique_ptr<MlmeConnectEvent> InitFromPacket(
-      const NL80211Packet* packet);
+      const NL80211PacketView* packet);
   // Returns the BSSID of the associated AP.
   const std::array<uint8_t, ETH_ALEN>& GetBSSID() const { return bssid_; }
   // Get the status code of this connect event.
@@ -41,6 +42,16 @@ class MlmeConnectEvent {
   uint16_t GetStatusCode() const { return status_code_; }
   uint32_t GetInterfaceIndex() const { return interface_index_; }
   bool IsTimeout() const { return is_timeout_; }
+  // Returns the frequency of the associated BSS in MHz, or 0 if the event does
+  // not tell.
+  uint32_t GetFrequency() const { return frequency_; }
+  // Returns the information elements of the (re)association request and
+  // response frames. They are empty if the event does not carry them.
+  const std::vector<uint8_t>& GetRequestIEs() const { return request_ies_; }
+  const std::vector<uint8_t>& GetResponseIEs() const { return response_ies_; }
+  // Returns the CLOCK_BOOTTIME timestamp in nanoseconds of when the event
+  // was received.
+  int64_t GetTimestampNanos() const { return timestamp_ns_; }
 
  private:
   MlmeConnectEvent() = default;
@@ -49,6 +60,10 @@ class MlmeConnectEvent {
   std::array<uint8_t, ETH_ALEN> bssid_;
   uint16_t status_code_;
   bool is_timeout_;
+  uint32_t frequency_;
+  std::vector<uint8_t> request_ies_;
+  std::vector<uint8_t> response_ies_;
+  int64_t timestamp_ns_;
 
   DISALLOW_COPY_AND_ASSIGN(MlmeConnectEvent);
 };
@@ -56,7 +71,7 @@ class MlmeConnectEvent {
 class MlmeAssociateEvent {
  public:
   static std::unique_ptr<MlmeAssociateEvent> InitFromPacket(
-      const NL80211Packet* packet);
+      const NL80211PacketView* packet);
   // Returns the BSSID of the associated AP.
   const std::array<uint8_t, ETH_ALEN>& GetBSSID() const { return bssid_; }
   // Get the status code of this associate event.
@@ -65,6 +80,9 @@ class MlmeAssociateEvent {
   uint16_t GetStatusCode() const { return status_code_; }
   uint32_t GetInterfaceIndex() const { return interface_index_; }
   bool IsTimeout() const { return is_timeout_; }
+  // Returns the CLOCK_BOOTTIME timestamp in nanoseconds of when the event
+  // was received.
+  int64_t GetTimestampNanos() const { return timestamp_ns_; }
 
  private:
   MlmeAssociateEvent() = default;
@@ -73,23 +91,64 @@ class MlmeAssociateEvent {
   std::array<uint8_t, ETH_ALEN> bssid_;
   uint16_t status_code_;
   bool is_timeout_;
+  int64_t timestamp_ns_;
 
   DISALLOW_COPY_AND_ASSIGN(MlmeAssociateEvent);
 };
 
+// Authentication is the first step of an association that the kernel drives
+// (SME in userspace or the kernel). Drivers that handle the SME themselves
+// only report the final CONNECT or ROAM event.
+class MlmeAuthenticateEvent {
+ public:
+  static std::unique_ptr<MlmeAuthenticateEvent> InitFromPacket(
+      const NL80211PacketView* packet);
+  // Returns the BSSID of the AP we authenticated with.
+  const std::array<uint8_t, ETH_ALEN>& GetBSSID() const { return bssid_; }
+  uint32_t GetInterfaceIndex() const { return interface_index_; }
+  bool IsTimeout() const { return is_timeout_; }
+  // Returns the CLOCK_BOOTTIME timestamp in nanoseconds of when the event
+  // was received.
+  int64_t GetTimestampNanos() const { return timestamp_ns_; }
+
+ private:
+  MlmeAuthenticateEvent() = default;
+
+  uint32_t interface_index_;
+  std::array<uint8_t, ETH_ALEN> bssid_;
+  bool is_timeout_;
+  int64_t timestamp_ns_;
+
+  DISALLOW_COPY_AND_ASSIGN(MlmeAuthenticateEvent);
+};
+
 class MlmeRoamEvent {
  public:
   static std::unique_ptr<MlmeRoamEvent> InitFromPacket(
-      const NL80211Packet* packet);
+      const NL80211PacketView* packet);
   // Returns the BSSID of the associated AP.
   const std::array<uint8_t, ETH_ALEN>& GetBSSID() const { return bssid_; }
   uint32_t GetInterfaceIndex() const { return interface_index_; }
+  // Returns the frequency of the new BSS in MHz, or 0 if the event does
+  // not tell.
+  uint32_t GetFrequency() const { return frequency_; }
+  // Returns the information elements of the (re)association request and
+  // response frames. They are empty if the event does not carry them.
+  const std::vector<uint8_t>& GetRequestIEs() const { return request_ies_; }
+  const std::vector<uint8_t>& GetResponseIEs() const { return response_ies_; }
+  // Returns the CLOCK_BOOTTIME timestamp in nanoseconds of when the event
+  // was received.
+  int64_t GetTimestampNanos() const { return timestamp_ns_; }
 
  private:
   MlmeRoamEvent() = default;
 
   uint32_t interface_index_;
   std::array<uint8_t, ETH_ALEN> bssid_;
+  uint32_t frequency_;
+  std::vector<uint8_t> request_ies_;
+  std::vector<uint8_t> response_ies_;
+  int64_t timestamp_ns_;
 
   DISALLOW_COPY_AND_ASSIGN(MlmeRoamEvent);
 };
@@ -98,13 +157,17 @@ class MlmeRoamEvent {
 class MlmeDisconnectEvent {
  public:
   static std::unique_ptr<MlmeDisconnectEvent> InitFromPacket(
-      const NL80211Packet* packet);
+      const NL80211PacketView* packet);
   uint32_t GetInterfaceIndex() const { return interface_index_; }
+  // Returns the CLOCK_BOOTTIME timestamp in nanoseconds of when the event
+  // was received.
+  int64_t GetTimestampNanos() const { return timestamp_ns_; }
  private:
   MlmeDisconnectEvent() = default;
 
   uint32_t interface_index_;
   std::array<uint8_t, ETH_ALEN> bssid_;
+  int64_t timestamp_ns_;
 
   DISALLOW_COPY_AND_ASSIGN(MlmeDisconnectEvent);
 };
@@ -112,13 +175,17 @@ class MlmeDisconnectEvent {
 class MlmeDisassociateEvent {
  public:
   static std::unique_ptr<MlmeDisassociateEvent> InitFromPacket(
-      const NL80211Packet* packet);
+      const NL80211PacketView* packet);
   uint32_t GetInterfaceIndex() const { return interface_index_; }
+  // Returns the CLOCK_BOOTTIME timestamp in nanoseconds of when the event
+  // was received.
+  int64_t GetTimestampNanos() const { return timestamp_ns_; }
  private:
   MlmeDisassociateEvent() = default;
 
   uint32_t interface_index_;
   std::array<uint8_t, ETH_ALEN> bssid_;
+  int64_t timestamp_ns_;
 
   DISALLOW_COPY_AND_ASSIGN(MlmeDisassociateEvent);
 };
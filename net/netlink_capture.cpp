@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/net/netlink_capture.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+
+using std::string;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+bool NetlinkCaptureWriter::Open(const string& path) {
+  fd_.reset(TEMP_FAILURE_RETRY(
+      open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)));
+  if (fd_.get() < 0) {
+    PLOG(ERROR) << "Failed to open netlink capture file " << path;
+    return false;
+  }
+  const uint32_t file_header[] = {kNetlinkCaptureMagic,
+                                  kNetlinkCaptureVersion};
+  if (!android::base::WriteFully(fd_.get(), file_header,
+                                 sizeof(file_header))) {
+    PLOG(ERROR) << "Failed to write netlink capture file header";
+    fd_.reset();
+    return false;
+  }
+  return true;
+}
+
+void NetlinkCaptureWriter::Write(NetlinkCaptureRecord::Direction direction,
+                                 bool async_socket,
+                                 const struct iovec* iov,
+                                 size_t iov_count) {
+  if (fd_.get() < 0) {
+    return;
+  }
+  NetlinkCaptureRecordHeader header;
+  memset(&header, 0, sizeof(header));
+  header.direction = direction;
+  header.async_socket = async_socket ? 1 : 0;
+  header.timestamp = systemTime(SYSTEM_TIME_MONOTONIC);
+  // The record is written with a single writev(), so that it is not
+  // interleaved with a partial write.
+  vector<struct iovec> record = {{&header, sizeof(header)}};
+  size_t record_size = sizeof(header);
+  for (size_t i = 0; i < iov_count; i++) {
+    header.length += iov[i].iov_len;
+    record.push_back(iov[i]);
+    record_size += iov[i].iov_len;
+  }
+  ssize_t written =
+      TEMP_FAILURE_RETRY(writev(fd_.get(), record.data(), record.size()));
+  if (written != static_cast<ssize_t>(record_size)) {
+    PLOG(ERROR) << "Failed to write netlink capture record";
+  }
+}
+
+bool ReadNetlinkCapture(const string& path,
+                        vector<NetlinkCaptureRecord>* out_records) {
+  string content;
+  if (!android::base::ReadFileToString(path, &content)) {
+    PLOG(ERROR) << "Failed to read netlink capture file " << path;
+    return false;
+  }
+  const uint8_t* ptr = reinterpret_cast<const uint8_t*>(content.data());
+  const uint8_t* end = ptr + content.size();
+  uint32_t file_header[2];
+  if (content.size() < sizeof(file_header)) {
+    LOG(ERROR) << "Netlink capture file is too short";
+    return false;
+  }
+  memcpy(file_header, ptr, sizeof(file_header));
+  if (file_header[0] != kNetlinkCaptureMagic ||
+      file_header[1] != kNetlinkCaptureVersion) {
+    LOG(ERROR) << "Not a netlink capture file, or unsupported version";
+    return false;
+  }
+  ptr += sizeof(file_header);
+  while (ptr + sizeof(NetlinkCaptureRecordHeader) <= end) {
+    NetlinkCaptureRecordHeader header;
+    memcpy(&header, ptr, sizeof(header));
+    ptr += sizeof(header);
+    if (header.length > static_cast<size_t>(end - ptr)) {
+      LOG(WARNING) << "Dropping truncated netlink capture record";
+      break;
+    }
+    if (header.direction != NetlinkCaptureRecord::kSent &&
+        header.direction != NetlinkCaptureRecord::kReceived) {
+      LOG(ERROR) << "Invalid direction in netlink capture record";
+      return false;
+    }
+    NetlinkCaptureRecord record;
+    record.direction =
+        static_cast<NetlinkCaptureRecord::Direction>(header.direction);
+    record.async_socket = header.async_socket != 0;
+    record.timestamp = header.timestamp;
+    record.data.assign(ptr, ptr + header.length);
+    out_records->push_back(std::move(record));
+    ptr += header.length;
+  }
+  return true;
+}
+
+}  // namespace wificond
+}  // namespace android
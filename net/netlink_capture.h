@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_NET_NETLINK_CAPTURE_H_
+#define WIFICOND_NET_NETLINK_CAPTURE_H_
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+#include <sys/uio.h>
+
+#include <android-base/macros.h>
+#include <android-base/unique_fd.h>
+#include <utils/Timers.h>
+
+namespace android {
+namespace wificond {
+
+// A netlink capture file starts with a header of |kNetlinkCaptureMagic| and
+// |kNetlinkCaptureVersion|, both uint32_t, followed by one record per
+// datagram. A record is a |NetlinkCaptureRecordHeader| followed by the
+// datagram itself. All values are in host byte order, like netlink.
+constexpr uint32_t kNetlinkCaptureMagic = 0x434c4e57;  // "WNLC"
+constexpr uint32_t kNetlinkCaptureVersion = 1;
+
+struct NetlinkCaptureRecordHeader {
+  // One of |NetlinkCaptureRecord::Direction|.
+  uint8_t direction;
+  // 1 for the asynchronous socket, 0 for the synchronous socket.
+  uint8_t async_socket;
+  uint16_t reserved;
+  uint32_t length;
+  // CLOCK_MONOTONIC time in nanoseconds.
+  int64_t timestamp;
+};
+
+// A datagram read from a capture file.
+struct NetlinkCaptureRecord {
+  enum Direction : uint8_t {
+    kSent,
+    kReceived,
+  };
+  Direction direction;
+  bool async_socket;
+  nsecs_t timestamp;
+  std::vector<uint8_t> data;
+};
+
+// Appends the datagrams NetlinkManager sends and receives to a capture file.
+class NetlinkCaptureWriter {
+ public:
+  NetlinkCaptureWriter() = default;
+  ~NetlinkCaptureWriter() = default;
+
+  // Creates or truncates the capture file at |path| and writes its header.
+  // Returns true on success.
+  bool Open(const std::string& path);
+
+  // Appends the datagram made of the |iov_count| buffers of |iov|, with the
+  // current time.
+  // A failed write is logged, and the record is lost.
+  void Write(NetlinkCaptureRecord::Direction direction,
+             bool async_socket,
+             const struct iovec* iov,
+             size_t iov_count);
+
+ private:
+  android::base::unique_fd fd_;
+
+  DISALLOW_COPY_AND_ASSIGN(NetlinkCaptureWriter);
+};
+
+// Reads all records of the capture file at |path| into |*out_records|.
+// Returns false if the file cannot be read or is not a capture file. A
+// truncated last record, e.g. because the capture was cut short, is dropped.
+bool ReadNetlinkCapture(const std::string& path,
+                        std::vector<NetlinkCaptureRecord>* out_records);
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_NET_NETLINK_CAPTURE_H_
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/net/netlink_event_filter.h"
+
+#include <utility>
+
+#include <arpa/inet.h>
+#include <linux/genetlink.h>
+#include <linux/netlink.h>
+#include <stddef.h>
+
+#include <android-base/logging.h>
+
+#include "wificond/net/kernel-header-latest/nl80211.h"
+
+using std::map;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr uint32_t kAcceptPacket = 0xffffffff;
+constexpr uint32_t kDropPacket = 0;
+constexpr uint32_t kGenlCommandOffset =
+    NLMSG_HDRLEN + offsetof(genlmsghdr, cmd);
+constexpr uint32_t kAttributesOffset = NLMSG_HDRLEN + GENL_HDRLEN;
+// Number of instructions of an interface index rule, excluding the command
+// comparison and the comparisons with the interface indexes.
+constexpr size_t kInterfaceRuleOverhead = 8;
+// Jump offsets of classic BPF are 8 bit values, and every interface index
+// comparison jumps to the end of its rule.
+constexpr size_t kMaxInterfaceIndexesPerRule =
+    255 - kInterfaceRuleOverhead;
+
+// Load instructions of classic BPF read words and half words in network
+// byte order.
+void AppendInterfaceRule(uint8_t command,
+                         const vector<uint32_t>& interface_indexes,
+                         vector<sock_filter>* program) {
+  const uint8_t num_interfaces = interface_indexes.size();
+  const uint8_t rule_size = kInterfaceRuleOverhead + num_interfaces;
+  // A still holds the command. Skip this rule if it does not match.
+  program->push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, command,
+                              0, rule_size));
+  // Let kernel find NL80211_ATTR_IFINDEX: A is the offset to start from, X
+  // the attribute type. A is set to the attribute offset, or 0 if not found.
+  program->push_back(BPF_STMT(BPF_LD | BPF_IMM, kAttributesOffset));
+  program->push_back(BPF_STMT(BPF_LDX | BPF_IMM, NL80211_ATTR_IFINDEX));
+  program->push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+                              static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_NLATTR)));
+  program->push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0,
+                              static_cast<uint8_t>(num_interfaces + 2), 0));
+  program->push_back(BPF_STMT(BPF_MISC | BPF_TAX, 0));
+  program->push_back(BPF_STMT(BPF_LD | BPF_W | BPF_IND, NLA_HDRLEN));
+  for (uint8_t i = 0; i < num_interfaces; i++) {
+    program->push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,
+                                htonl(interface_indexes[i]),
+                                static_cast<uint8_t>(num_interfaces - i), 0));
+  }
+  program->push_back(BPF_STMT(BPF_RET | BPF_K, kDropPacket));
+  program->push_back(BPF_STMT(BPF_RET | BPF_K, kAcceptPacket));
+}
+
+}  // namespace
+
+bool BuildEventFilter(uint16_t family_id,
+                      const map<uint8_t, EventFilterRule>& rules,
+                      vector<sock_filter>* out_program) {
+  vector<sock_filter> program = {
+    // Replies to our own requests carry a sequence number.
+    BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(nlmsghdr, nlmsg_seq)),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 1, 0),
+    BPF_STMT(BPF_RET | BPF_K, kAcceptPacket),
+    // Only filter nl80211 messages.
+    BPF_STMT(BPF_LD | BPF_H | BPF_ABS, offsetof(nlmsghdr, nlmsg_type)),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htons(family_id), 1, 0),
+    BPF_STMT(BPF_RET | BPF_K, kAcceptPacket),
+    BPF_STMT(BPF_LD | BPF_B | BPF_ABS, kGenlCommandOffset),
+  };
+  for (const auto& rule : rules) {
+    if (rule.second.accept_all ||
+        rule.second.interface_indexes.size() > kMaxInterfaceIndexesPerRule) {
+      program.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, rule.first,
+                                 0, 1));
+      program.push_back(BPF_STMT(BPF_RET | BPF_K, kAcceptPacket));
+      continue;
+    }
+    if (rule.second.interface_indexes.empty()) {
+      continue;
+    }
+    AppendInterfaceRule(rule.first, rule.second.interface_indexes, &program);
+  }
+  program.push_back(BPF_STMT(BPF_RET | BPF_K, kDropPacket));
+
+  if (program.size() > BPF_MAXINSNS) {
+    LOG(ERROR) << "Event filter is too large: " << program.size()
+               << " instructions";
+    return false;
+  }
+  *out_program = std::move(program);
+  return true;
+}
+
+}  // namespace wificond
+}  // namespace android
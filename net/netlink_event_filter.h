@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_NET_NETLINK_EVENT_FILTER_H_
+#define WIFICOND_NET_NETLINK_EVENT_FILTER_H_
+
+#include <map>
+#include <vector>
+
+#include <linux/filter.h>
+#include <stdint.h>
+
+namespace android {
+namespace wificond {
+
+// Describes which multicast events with a given nl80211 command are wanted.
+struct EventFilterRule {
+  EventFilterRule() : accept_all(false) {}
+  // If true, all events with this command are wanted, e.g. because they are
+  // not dispatched by interface.
+  bool accept_all;
+  // Otherwise, only events whose NL80211_ATTR_IFINDEX is one of these are
+  // wanted.
+  std::vector<uint32_t> interface_indexes;
+};
+
+// Builds a classic BPF socket filter that drops the nl80211 multicast events
+// nobody is subscribed to, so that kernel does not wake us up for them.
+// |rules| maps an nl80211 command to the events of that command that pass
+// the filter. Events with any other command are dropped.
+// Messages that are not nl80211 multicast events, i.e. replies to our own
+// requests or messages of other families, always pass.
+// Returns true on success. The program is stored in |*out_program| and can
+// be attached with SO_ATTACH_FILTER.
+bool BuildEventFilter(uint16_t family_id,
+                      const std::map<uint8_t, EventFilterRule>& rules,
+                      std::vector<sock_filter>* out_program);
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_NET_NETLINK_EVENT_FILTER_H_
@@ -14,26 +14,39 @@
  * limitations under the License.
  */
 
+#define ATRACE_TAG ATRACE_TAG_NETWORK
+
 #include "net/netlink_manager.h"
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
 #include <linux/netlink.h>
 #include <poll.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 #include <android-base/logging.h>
 #include <utils/Timers.h>
+#include <utils/Trace.h>
 
+#include "flight_recorder.h"
+#include "log_rate_limiter.h"
+#include "net/buffer_pool.h"
 #include "net/kernel-header-latest/nl80211.h"
 #include "net/mlme_event.h"
 #include "net/mlme_event_handler.h"
+#include "net/netlink_capture.h"
+#include "net/netlink_event_filter.h"
+#include "net/netlink_receive_thread.h"
 #include "net/nl80211_attribute.h"
 #include "net/nl80211_packet.h"
+#include "net/nl80211_packet_view.h"
 
 using android::base::unique_fd;
 using std::array;
+using std::map;
 using std::placeholders::_1;
 using std::string;
 using std::unique_ptr;
@@ -46,13 +59,48 @@ namespace {
 
 // netlink.h suggests NLMSG_GOODSIZE to be at most 8192 bytes.
 constexpr int kReceiveBufferSize = 8 * 1024;
+// Default socket receive buffer sizes. Kernel doubles the requested value
+// to account for its bookkeeping overhead.
+constexpr int kDefaultSyncSocketReceiveBufferSize = 32 * 1024;
+constexpr int kDefaultAsyncSocketReceiveBufferSize = 256 * 1024;
+// Maximum number of datagrams read by one recvmmsg() call.
+constexpr size_t kReceiveBatchSize = 8;
+// Receive buffers grow up to this size when a datagram got truncated.
+constexpr size_t kMaximumReceiveBufferSize = 64 * 1024;
 constexpr uint32_t kBroadcastSequenceNumber = 0;
+// Default time budgets of synchronous requests. Dumps, e.g. of scan results,
+// can take many datagrams to complete.
 constexpr int kMaximumNetlinkMessageWaitMilliSeconds = 300;
-uint8_t ReceiveBuffer[kReceiveBufferSize];
+constexpr int kMaximumNetlinkDumpWaitMilliSeconds = 1000;
+// Asynchronous requests may time out this much later, so that their timers
+// can share wakeups.
+constexpr int kAsyncRequestTimeoutSlackMilliSeconds = 50;
 
 void AppendPacket(vector<unique_ptr<const NL80211Packet>>* vec,
-                  unique_ptr<const NL80211Packet> packet) {
-  vec->push_back(std::move(packet));
+                  const NL80211PacketView& packet) {
+  vec->push_back(std::make_unique<const NL80211Packet>(packet));
+}
+
+size_t GetResponsesSize(const vector<unique_ptr<const NL80211Packet>>& vec) {
+  size_t num_bytes = 0;
+  for (const auto& packet : vec) {
+    num_bytes += packet->GetConstData().size();
+  }
+  return num_bytes;
+}
+
+void RunHandlerWithOwnedPacket(
+    const std::function<void(unique_ptr<const NL80211Packet>)>& handler,
+    const NL80211PacketView& packet) {
+  handler(std::make_unique<const NL80211Packet>(packet));
+}
+
+template <typename Handler>
+void AppendInterfaceIndexes(const FlatHandlerMap<Handler>& handlers,
+                            EventFilterRule* rule) {
+  for (const auto& handler : handlers) {
+    rule->interface_indexes.push_back(handler.first);
+  }
 }
 
 // Convert enum nl80211_chan_width to enum ChannelBandwidth
@@ -75,15 +123,249 @@ ChannelBandwidth getBandwidthType(uint32_t bandwidth) {
   return BW_INVALID;
 }
 
+// Returns a printable name of nl80211 command |command|.
+string GetNl80211CommandName(uint8_t command) {
+  switch (command) {
+    case NL80211_CMD_GET_WIPHY:
+      return "NL80211_CMD_GET_WIPHY";
+    case NL80211_CMD_GET_INTERFACE:
+      return "NL80211_CMD_GET_INTERFACE";
+    case NL80211_CMD_GET_STATION:
+      return "NL80211_CMD_GET_STATION";
+    case NL80211_CMD_GET_SURVEY:
+      return "NL80211_CMD_GET_SURVEY";
+    case NL80211_CMD_GET_SCAN:
+      return "NL80211_CMD_GET_SCAN";
+    case NL80211_CMD_TRIGGER_SCAN:
+      return "NL80211_CMD_TRIGGER_SCAN";
+    case NL80211_CMD_ABORT_SCAN:
+      return "NL80211_CMD_ABORT_SCAN";
+    case NL80211_CMD_START_SCHED_SCAN:
+      return "NL80211_CMD_START_SCHED_SCAN";
+    case NL80211_CMD_STOP_SCHED_SCAN:
+      return "NL80211_CMD_STOP_SCHED_SCAN";
+    case NL80211_CMD_GET_REG:
+      return "NL80211_CMD_GET_REG";
+    case NL80211_CMD_GET_PROTOCOL_FEATURES:
+      return "NL80211_CMD_GET_PROTOCOL_FEATURES";
+    case NL80211_CMD_SET_CQM:
+      return "NL80211_CMD_SET_CQM";
+    case NL80211_CMD_FRAME:
+      return "NL80211_CMD_FRAME";
+  }
+  return "nl80211 command " + std::to_string(command);
+}
+
+// Returns the priority that multicast events with nl80211 command |command|
+// are dispatched with on an interface strand.
+EventLoop::TaskPriority GetEventPriority(uint8_t command) {
+  switch (command) {
+    case NL80211_CMD_CONNECT:
+    case NL80211_CMD_AUTHENTICATE:
+    case NL80211_CMD_ASSOCIATE:
+    case NL80211_CMD_ROAM:
+    case NL80211_CMD_DISCONNECT:
+    case NL80211_CMD_DISASSOCIATE:
+    case NL80211_CMD_FRAME_TX_STATUS:
+      return EventLoop::kPriorityHigh;
+    case NL80211_CMD_NEW_SCAN_RESULTS:
+    case NL80211_CMD_SCAN_ABORTED:
+    case NL80211_CMD_SCHED_SCAN_RESULTS:
+      // Handlers fetch and parse the scan results.
+      return EventLoop::kPriorityLow;
+    default:
+      return EventLoop::kPriorityNormal;
+  }
+}
+
+// Adds a flight record of |type| for netlink message |packet|.
+void RecordMessage(FlightRecord::Type type, const NL80211PacketView& packet) {
+  if (FlightRecorder::GetInstance() == nullptr) {
+    return;
+  }
+  FlightRecord record;
+  record.type = type;
+  record.length = packet.GetSize();
+  record.sequence = packet.GetMessageSequence();
+  uint16_t message_type = packet.GetMessageType();
+  if (message_type < NLMSG_MIN_TYPE) {
+    // Control messages have neither a genl header nor nl80211 attributes.
+    record.control_type = message_type;
+    if (message_type == NLMSG_ERROR &&
+        packet.GetSize() >= NLMSG_HDRLEN + sizeof(int)) {
+      int error_code = packet.GetErrorCode();
+      if (error_code > 0) {
+        record.status = std::min(error_code, static_cast<int>(UINT8_MAX));
+      }
+    }
+  } else {
+    record.command = packet.GetCommand();
+    packet.GetAttributeValue(NL80211_ATTR_IFINDEX, &record.interface_index);
+  }
+  FlightRecorder::Record(record);
+}
+
 }  // namespace
 
+NetlinkSocketConfig::NetlinkSocketConfig()
+    : sync_receive_buffer_size(kDefaultSyncSocketReceiveBufferSize),
+      async_receive_buffer_size(kDefaultAsyncSocketReceiveBufferSize),
+      async_no_enobufs(false),
+      async_event_filter(false),
+      async_receive_thread(false) {
+}
+
 NetlinkManager::NetlinkManager(EventLoop* event_loop)
+    : NetlinkManager(event_loop, NetlinkSocketConfig()) {
+}
+
+NetlinkManager::NetlinkManager(EventLoop* event_loop,
+                               const NetlinkSocketConfig& config)
     : started_(false),
       event_loop_(event_loop),
-      sequence_number_(0) {
+      socket_config_(config),
+      receive_buffers_(kReceiveBatchSize),
+      receive_buffer_size_(kReceiveBufferSize),
+      async_timeout_timer_(EventLoop::kInvalidTimerId),
+      async_timeout_deadline_(0),
+      receive_buffer_memory_("netlink receive buffers"),
+      response_memory_("netlink replies in flight"),
+      sequence_number_(0),
+      drop_rest_of_datagram_(false) {
+  InitEventDispatchTable();
+}
+
+void NetlinkManager::InitEventDispatchTable() {
+  // Scan was aborted, for unspecified reasons.partial scan results may be
+  // available.
+  SetEventParser({NL80211_CMD_NEW_SCAN_RESULTS, NL80211_CMD_SCAN_ABORTED},
+                 &NetlinkManager::OnScanResultsReady,
+                 std::bind(AppendInterfaceIndexes<OnScanResultsReadyHandler>,
+                           std::cref(on_scan_result_ready_handler_), _1));
+  SetEventParser(
+      {NL80211_CMD_SCHED_SCAN_RESULTS, NL80211_CMD_SCHED_SCAN_STOPPED},
+      &NetlinkManager::OnSchedScanResultsReady,
+      std::bind(AppendInterfaceIndexes<OnSchedScanResultsReadyHandler>,
+                std::cref(on_sched_scan_result_ready_handler_), _1));
+  // Driver which supports SME uses both NL80211_CMD_AUTHENTICATE and
+  // NL80211_CMD_ASSOCIATE, otherwise it uses NL80211_CMD_CONNECT
+  // to notify a combination of authentication and association processses.
+  // Currently we monitor CONNECT/ASSOCIATE/ROAM event for up-to-date
+  // frequency and bssid, and AUTHENTICATE for the start of connection
+  // attempts, which connect and roam latencies are measured from.
+  // TODO(nywang): Handle other MLME events, which help us track the
+  // connection state better.
+  SetEventParser({NL80211_CMD_CONNECT,
+                  NL80211_CMD_AUTHENTICATE,
+                  NL80211_CMD_ASSOCIATE,
+                  NL80211_CMD_ROAM,
+                  NL80211_CMD_DISCONNECT,
+                  NL80211_CMD_DISASSOCIATE},
+                 &NetlinkManager::OnMlmeEvent,
+                 std::bind(AppendInterfaceIndexes<MlmeEventHandler*>,
+                           std::cref(on_mlme_event_handler_), _1));
+  // Regulatory domain changes are not tied to an interface.
+  SetEventParser({NL80211_CMD_REG_CHANGE},
+                 &NetlinkManager::OnRegChangeEvent,
+                 [this](EventFilterRule* rule) {
+                   rule->accept_all = !on_reg_domain_changed_handler_.empty();
+                 });
+  // Interface events are tied to a wiphy, and their interface is new or
+  // gone, so they are not filtered by interface.
+  SetEventParser({NL80211_CMD_NEW_INTERFACE, NL80211_CMD_DEL_INTERFACE},
+                 &NetlinkManager::OnInterfaceEvent,
+                 [this](EventFilterRule* rule) {
+                   rule->accept_all = !on_interface_event_handler_.empty();
+                 });
+  // Station events for AP mode.
+  SetEventParser({NL80211_CMD_NEW_STATION, NL80211_CMD_DEL_STATION},
+                 &NetlinkManager::OnStationEvent,
+                 std::bind(AppendInterfaceIndexes<OnStationEventHandler>,
+                           std::cref(on_station_event_handler_), _1));
+  SetEventParser({NL80211_CMD_CH_SWITCH_NOTIFY},
+                 &NetlinkManager::OnChannelSwitchEvent,
+                 std::bind(AppendInterfaceIndexes<OnChannelSwitchEventHandler>,
+                           std::cref(on_channel_switch_event_handler_), _1));
+  SetEventParser({NL80211_CMD_FRAME_TX_STATUS},
+                 &NetlinkManager::OnFrameTxStatusEvent,
+                 std::bind(AppendInterfaceIndexes<OnFrameTxStatusEventHandler>,
+                           std::cref(on_frame_tx_status_event_handler_), _1));
+  // Connection quality monitor events, configured with NL80211_CMD_SET_CQM.
+  SetEventParser({NL80211_CMD_NOTIFY_CQM},
+                 &NetlinkManager::OnCqmEvent,
+                 std::bind(AppendInterfaceIndexes<OnCqmEventHandler>,
+                           std::cref(on_cqm_event_handler_), _1));
+}
+
+void NetlinkManager::SetEventParser(
+    std::initializer_list<uint8_t> commands,
+    EventParser parser,
+    std::function<void(EventFilterRule*)> add_filter_rule) {
+  for (uint8_t command : commands) {
+    event_dispatch_table_[command].parser = parser;
+    event_dispatch_table_[command].add_filter_rule = add_filter_rule;
+  }
+}
+
+void NetlinkManager::UpdateEventFilter() {
+  if (!socket_config_.async_event_filter ||
+      async_netlink_fd_.get() < 0 ||
+      message_types_.find(NL80211_GENL_NAME) == message_types_.end()) {
+    return;
+  }
+  map<uint8_t, EventFilterRule> rules;
+  for (size_t command = 0; command < event_dispatch_table_.size(); command++) {
+    const EventDispatchEntry& entry = event_dispatch_table_[command];
+    EventFilterRule rule;
+    if (entry.add_filter_rule) {
+      entry.add_filter_rule(&rule);
+    }
+    AppendInterfaceIndexes(entry.handlers, &rule);
+    if (!rule.accept_all && rule.interface_indexes.empty()) {
+      continue;
+    }
+    std::sort(rule.interface_indexes.begin(), rule.interface_indexes.end());
+    rule.interface_indexes.erase(
+        std::unique(rule.interface_indexes.begin(),
+                    rule.interface_indexes.end()),
+        rule.interface_indexes.end());
+    rules[command] = rule;
+  }
+
+  vector<sock_filter> program;
+  if (BuildEventFilter(GetFamilyId(), rules, &program)) {
+    struct sock_fprog filter;
+    filter.len = program.size();
+    filter.filter = program.data();
+    if (setsockopt(async_netlink_fd_.get(),
+                   SOL_SOCKET,
+                   SO_ATTACH_FILTER,
+                   &filter,
+                   sizeof(filter)) == 0) {
+      return;
+    }
+    PLOG(ERROR) << "Failed to attach netlink event filter";
+  }
+  // A stale filter might drop events somebody subscribed to in the meantime.
+  int dummy = 0;
+  if (setsockopt(async_netlink_fd_.get(),
+                 SOL_SOCKET,
+                 SO_DETACH_FILTER,
+                 &dummy,
+                 sizeof(dummy)) < 0 && errno != ENOENT) {
+    PLOG(ERROR) << "Failed to detach netlink event filter";
+  }
 }
 
 NetlinkManager::~NetlinkManager() {
+  if (receive_thread_ != nullptr) {
+    receive_thread_->Stop();
+    event_loop_->StopWatchFileDescriptor(receive_thread_->GetNotificationFd());
+  }
+  // The timeout timer refers to this object.
+  if (async_timeout_timer_ != EventLoop::kInvalidTimerId) {
+    event_loop_->CancelDelayedTask(async_timeout_timer_);
+  }
 }
 
 uint32_t NetlinkManager::GetSequenceNumber() {
@@ -93,77 +375,211 @@ uint32_t NetlinkManager::GetSequenceNumber() {
   return sequence_number_;
 }
 
-void NetlinkManager::ReceivePacketAndRunHandler(int fd) {
-  ssize_t len = read(fd, ReceiveBuffer, kReceiveBufferSize);
-  if (len == -1) {
-    LOG(ERROR) << "Failed to read packet from buffer";
-    return;
+bool NetlinkManager::ReceivePacketAndRunHandler(int fd) {
+  struct mmsghdr messages[kReceiveBatchSize];
+  struct iovec iovs[kReceiveBatchSize];
+  memset(messages, 0, sizeof(messages));
+  size_t num_buffer_bytes = 0;
+  for (size_t i = 0; i < kReceiveBatchSize; i++) {
+    receive_buffers_[i].resize(receive_buffer_size_);
+    iovs[i].iov_base = receive_buffers_[i].data();
+    iovs[i].iov_len = receive_buffers_[i].size();
+    messages[i].msg_hdr.msg_iov = &iovs[i];
+    messages[i].msg_hdr.msg_iovlen = 1;
+    num_buffer_bytes += receive_buffers_[i].capacity();
+  }
+  receive_buffer_memory_.Set(num_buffer_bytes);
+  // Drain all datagrams that are already queued, up to |kReceiveBatchSize|,
+  // with one system call. MSG_DONTWAIT makes sure that we don't block once
+  // the queue is empty.
+  int num_messages = TEMP_FAILURE_RETRY(
+      recvmmsg(fd, messages, kReceiveBatchSize, MSG_DONTWAIT, nullptr));
+  if (num_messages == -1) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      return true;
+    }
+    if (errno == ENOBUFS) {
+      // Kernel dropped messages because the socket receive buffer was full.
+      LOG(ERROR) << "Netlink socket receive buffer overrun, messages are lost";
+      OnReceiveBufferOverrun(fd);
+      return false;
+    }
+    PLOG(ERROR) << "Failed to read packet from buffer";
+    return true;
+  }
+
+  bool truncated = false;
+  for (int i = 0; i < num_messages; i++) {
+    const uint8_t* buffer = receive_buffers_[i].data();
+    size_t len = messages[i].msg_len;
+    if (messages[i].msg_hdr.msg_flags & MSG_TRUNC) {
+      // The rest of this datagram is lost. Fail the request it belongs to
+      // rather than handing an incomplete reply to the caller.
+      LOG(ERROR) << "Netlink datagram is larger than receive buffer size "
+                 << receive_buffer_size_;
+      truncated = true;
+      if (len >= sizeof(nlmsghdr)) {
+        uint32_t sequence =
+            reinterpret_cast<const nlmsghdr*>(buffer)->nlmsg_seq;
+        if (sequence != kBroadcastSequenceNumber) {
+          AbortRequest(sequence);
+        }
+      }
+      continue;
+    }
+    if (capture_writer_ != nullptr) {
+      struct iovec iov = {const_cast<uint8_t*>(buffer), len};
+      capture_writer_->Write(NetlinkCaptureRecord::kReceived,
+                             fd == async_netlink_fd_.get(), &iov, 1);
+    }
+    RunHandlersForDatagram(buffer, len);
   }
+  if (truncated) {
+    receive_buffer_size_ =
+        std::min(receive_buffer_size_ * 2, kMaximumReceiveBufferSize);
+  }
+  return true;
+}
+
+void NetlinkManager::RunHandlersForDatagram(const uint8_t* buffer,
+                                            size_t len) {
   if (len == 0) {
     return;
   }
   // There might be multiple message in one datagram payload.
-  uint8_t* ptr = ReceiveBuffer;
-  while (ptr < ReceiveBuffer + len) {
+  const uint8_t* ptr = buffer;
+  while (ptr < buffer + len) {
     // peek at the header.
-    if (ptr + sizeof(nlmsghdr) > ReceiveBuffer + len) {
+    if (ptr + sizeof(nlmsghdr) > buffer + len) {
       LOG(ERROR) << "payload is broken.";
       return;
     }
     const nlmsghdr* nl_header = reinterpret_cast<const nlmsghdr*>(ptr);
-    unique_ptr<NL80211Packet> packet(
-        new NL80211Packet(vector<uint8_t>(ptr, ptr + nl_header->nlmsg_len)));
-    ptr += nl_header->nlmsg_len;
-    if (!packet->IsValid()) {
+    // Parse the message in place. It is only copied out of the receive
+    // buffer if a handler needs to take ownership of it.
+    NL80211PacketView packet(
+        ptr,
+        std::min(static_cast<size_t>(nl_header->nlmsg_len),
+                 static_cast<size_t>(buffer + len - ptr)));
+    if (!packet.IsValid()) {
       LOG(ERROR) << "Receive invalid packet";
       return;
     }
-    // Some document says message from kernel should have port id equal 0.
-    // However in practice this is not always true so we don't check that.
+    ptr += NLMSG_ALIGN(nl_header->nlmsg_len);
+    if (!RunHandlersForMessage(packet)) {
+      return;
+    }
+  }
+}
 
-    uint32_t sequence_number = packet->GetMessageSequence();
+bool NetlinkManager::RunHandlersForMessage(const NL80211PacketView& packet) {
+  RecordMessage(FlightRecord::kNetlinkReceived, packet);
+  // Some document says message from kernel should have port id equal 0.
+  // However in practice this is not always true so we don't check that.
 
-    // Handle multicasts.
-    if (sequence_number == kBroadcastSequenceNumber) {
-      BroadcastHandler(std::move(packet));
-      continue;
-    }
+  uint32_t sequence_number = packet.GetMessageSequence();
 
-    auto itr = message_handlers_.find(sequence_number);
-    // There is no handler for this sequence number.
-    if (itr == message_handlers_.end()) {
-      LOG(WARNING) << "No handler for message: " << sequence_number;
-      return;
-    }
-    // A multipart message is terminated by NLMSG_DONE.
-    // In this case we don't need to run the handler.
-    // NLMSG_NOOP means no operation, message must be discarded.
-    uint32_t message_type =  packet->GetMessageType();
-    if (message_type == NLMSG_DONE || message_type == NLMSG_NOOP) {
-      message_handlers_.erase(itr);
-      return;
-    }
-    if (message_type == NLMSG_OVERRUN) {
-      LOG(ERROR) << "Get message overrun notification";
-      message_handlers_.erase(itr);
-      return;
-    }
+  // Handle multicasts.
+  if (sequence_number == kBroadcastSequenceNumber) {
+    BroadcastHandler(packet);
+    return true;
+  }
+
+  auto* handler = message_handlers_.Find(sequence_number);
+  // There is no handler for this sequence number.
+  if (handler == nullptr) {
+    static LogRateLimiter no_handler_log_limiter;
+    LOG_RATE_LIMITED(WARNING, no_handler_log_limiter)
+        << "No handler for message: " << sequence_number;
+    return false;
+  }
+  // A multipart message is terminated by NLMSG_DONE.
+  // In this case we don't need to run the handler.
+  // NLMSG_NOOP means no operation, message must be discarded.
+  uint32_t message_type =  packet.GetMessageType();
+  if (message_type == NLMSG_DONE || message_type == NLMSG_NOOP) {
+    message_handlers_.erase(sequence_number);
+    CompleteAsyncRequest(sequence_number, true);
+    return false;
+  }
+  if (message_type == NLMSG_OVERRUN) {
+    LOG(ERROR) << "Get message overrun notification";
+    AbortRequest(sequence_number);
+    return false;
+  }
 
-    // In case we receive a NLMSG_ERROR message:
-    // NLMSG_ERROR could be either an error or an ACK.
-    // It is an ACK message only when error code field is set to 0.
-    // An ACK could be return when we explicitly request that with NLM_F_ACK.
-    // An ERROR could be received on NLM_F_ACK or other failure cases.
-    // We should still run handler in this case, leaving it for the caller
-    // to decide what to do with the packet.
+  // In case we receive a NLMSG_ERROR message:
+  // NLMSG_ERROR could be either an error or an ACK.
+  // It is an ACK message only when error code field is set to 0.
+  // An ACK could be return when we explicitly request that with NLM_F_ACK.
+  // An ERROR could be received on NLM_F_ACK or other failure cases.
+  // We should still run handler in this case, leaving it for the caller
+  // to decide what to do with the packet.
 
-    bool is_multi = packet->IsMulti();
-    // Run the handler.
-    itr->second(std::move(packet));
-    // Remove handler after processing.
-    if (!is_multi) {
-      message_handlers_.erase(itr);
+  bool is_multi = packet.IsMulti();
+  // Run the handler.
+  (*handler)(packet);
+  // Remove handler after processing.
+  if (!is_multi) {
+    message_handlers_.erase(sequence_number);
+    CompleteAsyncRequest(sequence_number, true);
+  }
+  return true;
+}
+
+void NetlinkManager::AbortRequest(uint32_t sequence) {
+  message_handlers_.erase(sequence);
+  if (async_requests_.Find(sequence) != nullptr) {
+    CompleteAsyncRequest(sequence, false);
+    return;
+  }
+  // Let PollForResponses() know that this reply will never complete.
+  aborted_requests_.insert(sequence);
+}
+
+void NetlinkManager::OnReceiveBufferOverrun(int fd) {
+  FlightRecord record;
+  record.type = FlightRecord::kNetlinkOverrun;
+  FlightRecorder::Record(record);
+  if (fd != async_netlink_fd_.get()) {
+    // PollForResponses() fails the pending synchronous requests.
+    return;
+  }
+  // Any reply to a pending asynchronous request might have been dropped.
+  vector<uint32_t> sequences;
+  async_requests_.GetSequences(&sequences);
+  for (uint32_t sequence : sequences) {
+    AbortRequest(sequence);
+  }
+  // Multicast events might have been dropped as well.
+  // Handlers usually query kernel, so run them once the pending datagrams
+  // have been processed.
+  if (!on_events_lost_handler_.empty()) {
+    event_loop_->PostTask(std::bind(&NetlinkManager::OnEventsLost, this));
+  }
+}
+
+void NetlinkManager::OnEventsLost() {
+  // Handlers may subscribe or unsubscribe while being run.
+  vector<OnEventsLostHandler> handlers;
+  for (const auto& handler : on_events_lost_handler_) {
+    const auto strand = interface_strands_.find(handler.first);
+    if (strand == interface_strands_.end()) {
+      handlers.push_back(handler.second);
+      continue;
     }
+    // Run after the events that the strand already holds.
+    uint32_t if_index = handler.first;
+    strand->second->PostTask([this, if_index]() {
+      const auto strand_handler = on_events_lost_handler_.find(if_index);
+      if (strand_handler != on_events_lost_handler_.end()) {
+        OnEventsLostHandler events_lost_handler = strand_handler->second;
+        events_lost_handler();
+      }
+    });
+  }
+  for (const auto& handler : handlers) {
+    handler();
   }
 }
 
@@ -219,13 +635,17 @@ bool NetlinkManager::Start() {
     LOG(DEBUG) << "NetlinkManager is already started";
     return true;
   }
-  bool setup_rt = SetupSocket(&sync_netlink_fd_);
+  bool setup_rt = SetupSocket(&sync_netlink_fd_,
+                              socket_config_.sync_receive_buffer_size,
+                              false);
   if (!setup_rt) {
     LOG(ERROR) << "Failed to setup synchronous netlink socket";
     return false;
   }
 
-  setup_rt = SetupSocket(&async_netlink_fd_);
+  setup_rt = SetupSocket(&async_netlink_fd_,
+                         socket_config_.async_receive_buffer_size,
+                         socket_config_.async_no_enobufs);
   if (!setup_rt) {
     LOG(ERROR) << "Failed to setup asynchronous netlink socket";
     return false;
@@ -236,13 +656,24 @@ bool NetlinkManager::Start() {
     return false;
   }
   // Watch socket.
-  if (!WatchSocket(&async_netlink_fd_)) {
+  if (socket_config_.async_receive_thread) {
+    if (!StartReceiveThread()) {
+      return false;
+    }
+  } else if (!WatchSocket(&async_netlink_fd_)) {
     return false;
   }
+  // Install the event filter before any event can arrive.
+  UpdateEventFilter();
   // Subscribe kernel NL80211 broadcast of regulatory changes.
   if (!SubscribeToEvents(NL80211_MULTICAST_GROUP_REG)) {
     return false;
   }
+  // Subscribe kernel NL80211 broadcast of configuration changes, which
+  // include interface creation and deletion.
+  if (!SubscribeToEvents(NL80211_MULTICAST_GROUP_CONFIG)) {
+    return false;
+  }
   // Subscribe kernel NL80211 broadcast of scanning events.
   if (!SubscribeToEvents(NL80211_MULTICAST_GROUP_SCAN)) {
     return false;
@@ -270,59 +701,407 @@ bool NetlinkManager::RegisterHandlerAndSendMessage(
   if (!SendMessageInternal(packet, async_netlink_fd_.get())) {
     return false;
   }
-  message_handlers_[packet.GetMessageSequence()] = handler;
+  message_handlers_[packet.GetMessageSequence()] =
+      std::bind(RunHandlerWithOwnedPacket, handler, _1);
+  return true;
+}
+
+bool NetlinkManager::SendMessageAsync(const NL80211Packet& packet,
+                                      OnResponsesReceivedHandler handler) {
+  if (!SendMessageInternal(packet, async_netlink_fd_.get())) {
+    return false;
+  }
+  uint32_t sequence = packet.GetMessageSequence();
+  AsyncRequest& request = async_requests_[sequence];
+  request.handler = handler;
+  request.responses.clear();
+  message_handlers_[sequence] = std::bind(
+      &NetlinkManager::AppendResponse, this, &request.responses, _1);
+  async_requests_.SetDeadline(
+      sequence,
+      systemTime(SYSTEM_TIME_MONOTONIC) + ms2ns(GetResponseTimeoutMs(packet)));
+  ScheduleAsyncRequestTimeout();
   return true;
 }
 
+void NetlinkManager::ScheduleAsyncRequestTimeout() {
+  nsecs_t deadline = async_requests_.GetEarliestDeadline();
+  if (deadline == 0) {
+    if (async_timeout_timer_ != EventLoop::kInvalidTimerId) {
+      event_loop_->CancelDelayedTask(async_timeout_timer_);
+      async_timeout_timer_ = EventLoop::kInvalidTimerId;
+    }
+    return;
+  }
+  // A timer that fires early enough is kept, so that sending requests with
+  // the same timeout in a row arms a single timer.
+  if (async_timeout_timer_ != EventLoop::kInvalidTimerId) {
+    if (async_timeout_deadline_ <= deadline) {
+      return;
+    }
+    event_loop_->CancelDelayedTask(async_timeout_timer_);
+  }
+  async_timeout_deadline_ = deadline;
+  async_timeout_timer_ = event_loop_->PostCancelableDelayedTask(
+      std::bind(&NetlinkManager::OnAsyncRequestTimeout, this),
+      toMillisecondTimeoutDelay(systemTime(SYSTEM_TIME_MONOTONIC), deadline),
+      kAsyncRequestTimeoutSlackMilliSeconds);
+}
+
+void NetlinkManager::OnAsyncRequestTimeout() {
+  async_timeout_timer_ = EventLoop::kInvalidTimerId;
+  vector<uint32_t> expired;
+  async_requests_.GetExpired(systemTime(SYSTEM_TIME_MONOTONIC), &expired);
+  for (uint32_t sequence : expired) {
+    LOG(ERROR) << "Timeout waiting for netlink reply messages";
+    message_handlers_.erase(sequence);
+    CompleteAsyncRequest(sequence, false);
+  }
+  ScheduleAsyncRequestTimeout();
+}
+
+void NetlinkManager::CompleteAsyncRequest(uint32_t sequence, bool success) {
+  AsyncRequest* request = async_requests_.Find(sequence);
+  if (request == nullptr) {
+    return;
+  }
+  // Remove the request before running the handler, which might send a new
+  // request. A timer that fires once no request is left does nothing.
+  OnResponsesReceivedHandler handler = std::move(request->handler);
+  vector<unique_ptr<const NL80211Packet>> responses =
+      std::move(request->responses);
+  async_requests_.erase(sequence);
+  response_memory_.Subtract(GetResponsesSize(responses));
+  handler(success, std::move(responses));
+}
+
 bool NetlinkManager::SendMessageAndGetResponses(
     const NL80211Packet& packet,
     vector<unique_ptr<const NL80211Packet>>* response) {
+  const size_t num_bytes_before = GetResponsesSize(*response);
+  bool success = SendMessageAndStreamResponses(
+      packet,
+      std::bind(&NetlinkManager::AppendResponse, this, response, _1));
+  // The replies are the caller's from now on.
+  response_memory_.Subtract(GetResponsesSize(*response) - num_bytes_before);
+  return success;
+}
+
+bool NetlinkManager::SendMessageAndStreamResponses(
+    const NL80211Packet& packet,
+    std::function<void(const NL80211PacketView&)> handler) {
+  nsecs_t start_time = systemTime(SYSTEM_TIME_MONOTONIC);
   if (!SendMessageInternal(packet, sync_netlink_fd_.get())) {
+    RecordCommandLatency(packet, 0, kRequestFailed);
     return false;
   }
-  // Polling netlink socket, waiting for GetFamily reply.
-  struct pollfd netlink_output;
-  memset(&netlink_output, 0, sizeof(netlink_output));
-  netlink_output.fd = sync_netlink_fd_.get();
-  netlink_output.events = POLLIN;
-
   uint32_t sequence = packet.GetMessageSequence();
-
-  int time_remaining = kMaximumNetlinkMessageWaitMilliSeconds;
   // Multipart messages may come with seperated datagrams, ending with a
   // NLMSG_DONE message.
   // ReceivePacketAndRunHandler() will remove the handler after receiving a
   // NLMSG_DONE message.
-  message_handlers_[sequence] = std::bind(AppendPacket, response, _1);
+  message_handlers_[sequence] = CountResponses(packet, handler);
+  return PollForResponses({&packet}, start_time);
+}
 
-  while (time_remaining > 0 &&
-      message_handlers_.find(sequence) != message_handlers_.end()) {
-    nsecs_t interval = systemTime(SYSTEM_TIME_MONOTONIC);
-    int poll_return = poll(&netlink_output,
-                           1,
-                           time_remaining);
+bool NetlinkManager::SendMessagesAndGetResponses(
+    const vector<const NL80211Packet*>& packets,
+    vector<vector<unique_ptr<const NL80211Packet>>>* responses) {
+  for (const NL80211Packet* packet : packets) {
+    if (packet->IsDump()) {
+      LOG(ERROR) << "Do not batch dump requests !";
+      return false;
+    }
+  }
+  responses->clear();
+  responses->resize(packets.size());
+  vector<uint32_t> sequences;
+  for (size_t i = 0; i < packets.size(); i++) {
+    uint32_t sequence = packets[i]->GetMessageSequence();
+    if (message_handlers_.Find(sequence) != nullptr) {
+      LOG(ERROR) << "Duplicate sequence number in batch: " << sequence;
+      for (uint32_t registered : sequences) {
+        message_handlers_.erase(registered);
+      }
+      return false;
+    }
+    message_handlers_[sequence] = CountResponses(
+        *packets[i],
+        std::bind(&NetlinkManager::AppendResponse, this, &(*responses)[i],
+                  _1));
+    sequences.push_back(sequence);
+  }
+  nsecs_t start_time = systemTime(SYSTEM_TIME_MONOTONIC);
+  if (!SendMessagesInternal(packets, sync_netlink_fd_.get())) {
+    for (size_t i = 0; i < packets.size(); i++) {
+      message_handlers_.erase(sequences[i]);
+      RecordCommandLatency(*packets[i], 0, kRequestFailed);
+    }
+    return false;
+  }
+  bool success = PollForResponses(packets, start_time);
+  for (const auto& packet_responses : *responses) {
+    response_memory_.Subtract(GetResponsesSize(packet_responses));
+  }
+  return success;
+}
+
+bool NetlinkManager::PollForResponses(
+    const vector<const NL80211Packet*>& packets,
+    nsecs_t start_time) {
+  // Polling netlink socket, waiting for the replies.
+  struct pollfd netlink_output;
+  memset(&netlink_output, 0, sizeof(netlink_output));
+  netlink_output.fd = sync_netlink_fd_.get();
+  netlink_output.events = POLLIN;
+
+  // All replies of a batch are received together, so the batch gets the
+  // largest budget of its requests.
+  int timeout_ms = 0;
+  for (const NL80211Packet* packet : packets) {
+    timeout_ms = std::max(timeout_ms, GetResponseTimeoutMs(*packet));
+  }
+  // Waiting against an absolute deadline, so that the time spent handling
+  // replies counts towards the budget however short each poll() is.
+  const nsecs_t deadline = start_time + ms2ns(timeout_ms);
+
+  vector<bool> completed(packets.size(), false);
+  auto is_pending = [this](const NL80211Packet* packet) {
+    return message_handlers_.Find(packet->GetMessageSequence()) != nullptr;
+  };
+  // Records the latency of the requests that completed since the last call.
+  // Returns true if some requests are still pending.
+  auto update_completed = [&]() {
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    bool has_pending = false;
+    for (size_t i = 0; i < packets.size(); i++) {
+      if (completed[i]) {
+        continue;
+      }
+      if (is_pending(packets[i])) {
+        has_pending = true;
+        continue;
+      }
+      completed[i] = true;
+      RecordCommandLatency(*packets[i], now - start_time, kRequestCompleted);
+    }
+    return has_pending;
+  };
+  auto fail_pending = [&](RequestResult result) {
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    for (size_t i = 0; i < packets.size(); i++) {
+      if (!completed[i]) {
+        RecordCommandLatency(*packets[i], now - start_time, result);
+      }
+      message_handlers_.erase(packets[i]->GetMessageSequence());
+    }
+  };
+  // Returns true if any of |packets| was aborted.
+  auto take_aborted_requests = [this, &packets]() {
+    bool aborted = false;
+    for (const NL80211Packet* packet : packets) {
+      if (aborted_requests_.erase(packet->GetMessageSequence()) > 0) {
+        aborted = true;
+      }
+    }
+    return aborted;
+  };
+
+  while (update_completed()) {
+    int time_remaining = toMillisecondTimeoutDelay(
+        systemTime(SYSTEM_TIME_MONOTONIC), deadline);
+    int poll_return = 0;
+    if (time_remaining > 0) {
+      poll_return = poll(&netlink_output, 1, time_remaining);
+    }
 
     if (poll_return == 0) {
-      LOG(ERROR) << "Failed to poll netlink fd: time out ";
-      message_handlers_.erase(sequence);
+      LOG(ERROR) << "Timeout waiting for netlink reply messages of command "
+                 << static_cast<int>(packets[0]->GetCommand())
+                 << " after " << timeout_ms << "ms";
+      fail_pending(kRequestTimedOut);
       return false;
     } else if (poll_return == -1) {
       PLOG(ERROR) << "Failed to poll netlink fd";
-      message_handlers_.erase(sequence);
+      fail_pending(kRequestFailed);
+      return false;
+    }
+    if (!ReceivePacketAndRunHandler(sync_netlink_fd_.get())) {
+      // Replies might have been dropped by kernel.
+      fail_pending(kRequestFailed);
+      return false;
+    }
+    if (take_aborted_requests()) {
+      fail_pending(kRequestFailed);
       return false;
     }
-    ReceivePacketAndRunHandler(sync_netlink_fd_.get());
-    interval = systemTime(SYSTEM_TIME_MONOTONIC) - interval;
-    time_remaining -= static_cast<int>(ns2ms(interval));
   }
-  if (time_remaining <= 0) {
-    LOG(ERROR) << "Timeout waiting for netlink reply messages";
-    message_handlers_.erase(sequence);
+  return true;
+}
+
+int NetlinkManager::GetResponseTimeoutMs(const NL80211Packet& packet) const {
+  auto itr = response_timeouts_ms_.find(packet.GetCommand());
+  if (itr != response_timeouts_ms_.end()) {
+    return itr->second;
+  }
+  return packet.IsDump() ? kMaximumNetlinkDumpWaitMilliSeconds
+                         : kMaximumNetlinkMessageWaitMilliSeconds;
+}
+
+void NetlinkManager::SetResponseTimeout(uint8_t command, int timeout_ms) {
+  if (timeout_ms <= 0) {
+    response_timeouts_ms_.erase(command);
+    return;
+  }
+  response_timeouts_ms_[command] = timeout_ms;
+}
+
+void NetlinkManager::AppendResponse(
+    vector<unique_ptr<const NL80211Packet>>* responses,
+    const NL80211PacketView& packet) {
+  AppendPacket(responses, packet);
+  response_memory_.Add(packet.GetSize());
+}
+
+std::function<void(const NL80211PacketView&)> NetlinkManager::CountResponses(
+    const NL80211Packet& packet,
+    std::function<void(const NL80211PacketView&)> handler) {
+  std::pair<uint16_t, uint8_t> key(packet.GetMessageType(),
+                                   packet.GetCommand());
+  return [this, key, handler](const NL80211PacketView& response) {
+    CommandLatencyStats& stats = command_latency_stats_[key];
+    stats.num_messages++;
+    stats.num_bytes += response.GetSize();
+    if (response.GetMessageType() == NLMSG_ERROR &&
+        response.GetErrorCode() != 0) {
+      stats.num_errors++;
+    }
+    handler(response);
+  };
+}
+
+void NetlinkManager::RecordCommandLatency(const NL80211Packet& packet,
+                                          nsecs_t latency,
+                                          RequestResult result) {
+  FlightRecord record;
+  record.type = FlightRecord::kNetlinkCompleted;
+  record.command = packet.GetCommand();
+  record.status = result;
+  record.sequence = packet.GetMessageSequence();
+  record.latency_us = ns2us(latency);
+  FlightRecorder::Record(record);
+
+  CommandLatencyStats& stats =
+      command_latency_stats_[{packet.GetMessageType(), packet.GetCommand()}];
+  if (result == kRequestTimedOut) {
+    stats.num_timeouts++;
+    return;
+  }
+  if (result == kRequestFailed) {
+    stats.num_failed++;
+    return;
+  }
+  stats.num_completed++;
+  stats.total_latency += latency;
+  stats.max_latency = std::max(stats.max_latency, latency);
+  size_t bucket = 0;
+  while (bucket + 1 < CommandLatencyStats::kNumLatencyBuckets &&
+         ns2ms(latency) >= (1 << bucket)) {
+    bucket++;
+  }
+  stats.latency_histogram[bucket]++;
+}
+
+CommandLatencyStats NetlinkManager::GetCommandLatencyStats(
+    uint16_t message_type,
+    uint8_t command) const {
+  auto itr = command_latency_stats_.find({message_type, command});
+  if (itr == command_latency_stats_.end()) {
+    return CommandLatencyStats();
+  }
+  return itr->second;
+}
+
+void NetlinkManager::DumpCommandLatencies(std::stringstream* ss) const {
+  auto nl80211_family = message_types_.find(NL80211_GENL_NAME);
+  *ss << "Netlink command latencies:" << std::endl;
+  for (const auto& itr : command_latency_stats_) {
+    uint16_t message_type = itr.first.first;
+    uint8_t command = itr.first.second;
+    const CommandLatencyStats& stats = itr.second;
+    if (nl80211_family != message_types_.end() &&
+        message_type == nl80211_family->second.family_id) {
+      *ss << GetNl80211CommandName(command);
+    } else {
+      *ss << "Message type " << message_type
+          << " command " << static_cast<int>(command);
+    }
+    *ss << ": completed " << stats.num_completed
+        << ", errors " << stats.num_errors
+        << ", timeouts " << stats.num_timeouts
+        << ", failed " << stats.num_failed
+        << ", messages " << stats.num_messages
+        << ", bytes " << stats.num_bytes << std::endl;
+    if (stats.num_completed == 0) {
+      continue;
+    }
+    *ss << "  latency average " << ns2us(stats.total_latency /
+                                         stats.num_completed)
+        << "us, max " << ns2us(stats.max_latency) << "us, histogram:";
+    for (size_t i = 0; i < stats.latency_histogram.size(); i++) {
+      if (stats.latency_histogram[i] == 0) {
+        continue;
+      }
+      if (i == 0) {
+        *ss << " <1ms: ";
+      } else if (i + 1 == stats.latency_histogram.size()) {
+        *ss << " >=" << (1 << (i - 1)) << "ms: ";
+      } else {
+        *ss << " <" << (1 << i) << "ms: ";
+      }
+      *ss << stats.latency_histogram[i];
+    }
+    *ss << std::endl;
+  }
+}
+
+void NetlinkManager::GetMemoryAccounts(
+    vector<MemoryAccount>* accounts) const {
+  accounts->push_back(receive_buffer_memory_);
+  accounts->push_back(response_memory_);
+  accounts->emplace_back(
+      "netlink packet buffer pool",
+      BufferPool<uint8_t>::GetCachedBytes() +
+          BufferPool<uint32_t>::GetCachedBytes(),
+      BufferPool<uint8_t>::GetPeakCachedBytes() +
+          BufferPool<uint32_t>::GetPeakCachedBytes());
+}
+
+void NetlinkManager::TrimMemory() {
+  // The buffers keep their size, so that large datagrams are not truncated
+  // again once they are allocated anew.
+  for (vector<uint8_t>& buffer : receive_buffers_) {
+    vector<uint8_t>().swap(buffer);
+  }
+  receive_buffer_memory_.Set(0);
+  BufferPool<uint8_t>::Trim();
+  BufferPool<uint32_t>::Trim();
+}
+
+bool NetlinkManager::StartCapture(const string& path) {
+  unique_ptr<NetlinkCaptureWriter> writer(new NetlinkCaptureWriter());
+  if (!writer->Open(path)) {
     return false;
   }
+  capture_writer_ = std::move(writer);
+  LOG(INFO) << "Capturing netlink traffic to " << path;
   return true;
 }
 
+void NetlinkManager::StopCapture() {
+  capture_writer_.reset();
+}
+
 bool NetlinkManager::SendMessageAndGetSingleResponse(
     const NL80211Packet& packet,
     unique_ptr<const NL80211Packet>* response) {
@@ -335,6 +1114,10 @@ bool NetlinkManager::SendMessageAndGetSingleResponse(
     // In that case the caller should use |SendMessageAndGetAckOrError|.
     LOG(ERROR) << "Received error message: "
                << strerror(response_or_error->GetErrorCode());
+    string message;
+    if (response_or_error->GetExtendedAckMessage(&message)) {
+      LOG(ERROR) << "Kernel reported: " << message;
+    }
     return false;
   }
   *response = std::move(response_or_error);
@@ -370,6 +1153,10 @@ bool NetlinkManager::SendMessageAndGetAckOrError(const NL80211Packet& packet,
   }
 
   *error_code = response->GetErrorCode();
+  string message;
+  if (*error_code != 0 && response->GetExtendedAckMessage(&message)) {
+    LOG(WARNING) << "Kernel reported: " << message;
+  }
   return true;
 }
 
@@ -394,10 +1181,48 @@ bool NetlinkManager::SendMessageInternal(const NL80211Packet& packet, int fd) {
     PLOG(ERROR) << "Failed to send netlink message";
     return false;
   }
+  RecordMessage(FlightRecord::kNetlinkSent, packet.GetView());
+  if (capture_writer_ != nullptr) {
+    struct iovec iov = {const_cast<uint8_t*>(data.data()), data.size()};
+    capture_writer_->Write(NetlinkCaptureRecord::kSent,
+                           fd == async_netlink_fd_.get(), &iov, 1);
+  }
   return true;
 }
 
-bool NetlinkManager::SetupSocket(unique_fd* netlink_fd) {
+bool NetlinkManager::SendMessagesInternal(
+    const vector<const NL80211Packet*>& packets, int fd) {
+  // All messages go out in one datagram. Kernel parses and runs them in
+  // order, and replies to each one separately.
+  vector<struct iovec> iov;
+  iov.reserve(packets.size());
+  for (const NL80211Packet* packet : packets) {
+    const vector<uint8_t>& data = packet->GetConstData();
+    iov.push_back({const_cast<uint8_t*>(data.data()), data.size()});
+  }
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = iov.data();
+  msg.msg_iovlen = iov.size();
+  ssize_t bytes_sent = TEMP_FAILURE_RETRY(sendmsg(fd, &msg, 0));
+  if (bytes_sent == -1) {
+    PLOG(ERROR) << "Failed to send netlink messages";
+    return false;
+  }
+  for (const NL80211Packet* packet : packets) {
+    RecordMessage(FlightRecord::kNetlinkSent, packet->GetView());
+  }
+  if (capture_writer_ != nullptr) {
+    capture_writer_->Write(NetlinkCaptureRecord::kSent,
+                           fd == async_netlink_fd_.get(), iov.data(),
+                           iov.size());
+  }
+  return true;
+}
+
+bool NetlinkManager::SetupSocket(unique_fd* netlink_fd,
+                                 int receive_buffer_size,
+                                 bool no_enobufs) {
   struct sockaddr_nl nladdr;
 
   memset(&nladdr, 0, sizeof(nladdr));
@@ -414,11 +1239,40 @@ bool NetlinkManager::SetupSocket(unique_fd* netlink_fd) {
   if (setsockopt(netlink_fd->get(),
                  SOL_SOCKET,
                  SO_RCVBUFFORCE,
-                 &kReceiveBufferSize,
-                 sizeof(kReceiveBufferSize)) < 0) {
+                 &receive_buffer_size,
+                 sizeof(receive_buffer_size)) < 0) {
     PLOG(ERROR) << "Failed to set uevent socket SO_RCVBUFFORCE option";
     return false;
   }
+  if (no_enobufs) {
+    int enable = 1;
+    if (setsockopt(netlink_fd->get(),
+                   SOL_NETLINK,
+                   NETLINK_NO_ENOBUFS,
+                   &enable,
+                   sizeof(enable)) < 0) {
+      PLOG(ERROR) << "Failed to set netlink socket NETLINK_NO_ENOBUFS option";
+      return false;
+    }
+  }
+  // Acks of requests only echo the netlink header of the request instead of
+  // all of it, and errors carry a message explaining them.
+  // Older kernels lack these options, we then get the full acks.
+  int enable_ack_option = 1;
+  if (setsockopt(netlink_fd->get(),
+                 SOL_NETLINK,
+                 NETLINK_CAP_ACK,
+                 &enable_ack_option,
+                 sizeof(enable_ack_option)) < 0) {
+    PLOG(WARNING) << "Failed to set netlink socket NETLINK_CAP_ACK option";
+  }
+  if (setsockopt(netlink_fd->get(),
+                 SOL_NETLINK,
+                 NETLINK_EXT_ACK,
+                 &enable_ack_option,
+                 sizeof(enable_ack_option)) < 0) {
+    PLOG(WARNING) << "Failed to set netlink socket NETLINK_EXT_ACK option";
+  }
   if (bind(netlink_fd->get(),
            reinterpret_cast<struct sockaddr*>(&nladdr),
            sizeof(nladdr)) < 0) {
@@ -438,9 +1292,65 @@ bool NetlinkManager::WatchSocket(unique_fd* netlink_fd) {
     LOG(ERROR) << "Failed to watch fd: " << netlink_fd->get();
     return false;
   }
+  event_loop_->SetFileDescriptorLabel(netlink_fd->get(), "netlink");
+  return true;
+}
+
+bool NetlinkManager::StartReceiveThread() {
+  receive_thread_.reset(new NetlinkReceiveThread());
+  if (!receive_thread_->Start(async_netlink_fd_.get())) {
+    receive_thread_.reset();
+    return false;
+  }
+  int notification_fd = receive_thread_->GetNotificationFd();
+  if (!event_loop_->WatchFileDescriptor(
+          notification_fd,
+          EventLoop::kModeInput,
+          std::bind(&NetlinkManager::ConsumeReceivedRecords, this))) {
+    LOG(ERROR) << "Failed to watch fd: " << notification_fd;
+    receive_thread_.reset();
+    return false;
+  }
+  event_loop_->SetFileDescriptorLabel(notification_fd, "netlink");
   return true;
 }
 
+void NetlinkManager::ConsumeReceivedRecords() {
+  receive_thread_->ConsumeRecords(
+      [this](const NetlinkReceiveRecord& record) {
+        switch (record.type) {
+          case NetlinkReceiveRecord::kMessage: {
+            if (capture_writer_ != nullptr) {
+              struct iovec iov = {const_cast<uint8_t*>(record.data.data()),
+                                  record.data.size()};
+              capture_writer_->Write(NetlinkCaptureRecord::kReceived, true,
+                                     &iov, 1);
+            }
+            if (record.first_in_datagram) {
+              drop_rest_of_datagram_ = false;
+            }
+            // Messages were validated by the receive thread.
+            if (!drop_rest_of_datagram_) {
+              drop_rest_of_datagram_ = !RunHandlersForMessage(
+                  NL80211PacketView(record.data.data(), record.data.size()));
+            }
+            break;
+          }
+          case NetlinkReceiveRecord::kTruncated:
+            LOG(ERROR) << "Netlink datagram is larger than receive buffer";
+            if (record.sequence != kBroadcastSequenceNumber) {
+              AbortRequest(record.sequence);
+            }
+            break;
+          case NetlinkReceiveRecord::kOverrun:
+            LOG(ERROR) << "Netlink socket receive buffer overrun, "
+                       << "messages are lost";
+            OnReceiveBufferOverrun(async_netlink_fd_.get());
+            break;
+        }
+      });
+}
+
 uint16_t NetlinkManager::GetFamilyId() {
   return message_types_[NL80211_GENL_NAME].family_id;
 }
@@ -484,83 +1394,75 @@ bool NetlinkManager::SubscribeToEvents(const string& group) {
   return true;
 }
 
-void NetlinkManager::BroadcastHandler(unique_ptr<const NL80211Packet> packet) {
-  if (packet->GetMessageType() != GetFamilyId()) {
+void NetlinkManager::BroadcastHandler(const NL80211PacketView& packet) {
+  if (packet.GetMessageType() != GetFamilyId()) {
     LOG(ERROR) << "Wrong family id for multicast message";
     return;
   }
-  uint32_t command = packet->GetCommand();
+  uint32_t if_index;
+  if (!interface_strands_.empty() &&
+      packet.GetAttributeValue(NL80211_ATTR_IFINDEX, &if_index)) {
+    const auto strand = interface_strands_.find(if_index);
+    if (strand != interface_strands_.end()) {
+      // The receive buffer is reused for the next datagram.
+      std::shared_ptr<const NL80211Packet> event(new NL80211Packet(packet));
+      strand->second->PostTaskWithPriority(
+          [this, event]() { DispatchEvent(event->GetView()); },
+          GetEventPriority(packet.GetCommand()));
+      return;
+    }
+  }
+  DispatchEvent(packet);
+}
 
-  if (command == NL80211_CMD_NEW_SCAN_RESULTS ||
-      // Scan was aborted, for unspecified reasons.partial scan results may be
-      // available.
-      command == NL80211_CMD_SCAN_ABORTED) {
-    OnScanResultsReady(std::move(packet));
+void NetlinkManager::DispatchEvent(const NL80211PacketView& packet) {
+  const EventDispatchEntry& entry = event_dispatch_table_[packet.GetCommand()];
+  if (entry.parser != nullptr) {
+    (this->*entry.parser)(packet);
+  }
+  if (entry.handlers.empty()) {
     return;
   }
-
-  if (command == NL80211_CMD_SCHED_SCAN_RESULTS ||
-      command == NL80211_CMD_SCHED_SCAN_STOPPED) {
-    OnSchedScanResultsReady(std::move(packet));
+  uint32_t if_index;
+  if (!packet.GetAttributeValue(NL80211_ATTR_IFINDEX, &if_index)) {
+    LOG(DEBUG) << "Failed to get interface index from multicast event "
+               << static_cast<int>(packet.GetCommand());
     return;
   }
+  const auto handler = entry.handlers.find(if_index);
+  if (handler != entry.handlers.end()) {
+    // Copy the handler, it might unsubscribe while running.
+    OnEventHandler event_handler = handler->second;
+    event_handler(packet);
+  }
+}
 
-
-  // Driver which supports SME uses both NL80211_CMD_AUTHENTICATE and
-  // NL80211_CMD_ASSOCIATE, otherwise it uses NL80211_CMD_CONNECT
-  // to notify a combination of authentication and association processses.
-  // Currently we monitor CONNECT/ASSOCIATE/ROAM event for up-to-date
-  // frequency and bssid.
-  // TODO(nywang): Handle other MLME events, which help us track the
-  // connection state better.
-  if (command == NL80211_CMD_CONNECT ||
-      command == NL80211_CMD_ASSOCIATE ||
-      command == NL80211_CMD_ROAM ||
-      command == NL80211_CMD_DISCONNECT ||
-      command == NL80211_CMD_DISASSOCIATE) {
-      OnMlmeEvent(std::move(packet));
-     return;
-  }
-  if (command == NL80211_CMD_REG_CHANGE) {
-    OnRegChangeEvent(std::move(packet));
-    return;
-  }
-  // Station eventsFor AP mode.
-  if (command == NL80211_CMD_NEW_STATION ||
-      command == NL80211_CMD_DEL_STATION) {
-    uint32_t if_index;
-    if (!packet->GetAttributeValue(NL80211_ATTR_IFINDEX, &if_index)) {
-      LOG(WARNING) << "Failed to get interface index from station event";
+void NetlinkManager::OnStationEvent(const NL80211PacketView& packet) {
+  uint32_t if_index;
+  if (!packet.GetAttributeValue(NL80211_ATTR_IFINDEX, &if_index)) {
+    LOG(WARNING) << "Failed to get interface index from station event";
+    return;
+  }
+  const auto handler = on_station_event_handler_.find(if_index);
+  if (handler != on_station_event_handler_.end()) {
+    array<uint8_t, ETH_ALEN> mac_address;
+    if (!packet.GetAttributeValue(NL80211_ATTR_MAC, &mac_address)) {
+      LOG(WARNING) << "Failed to get mac address from station event";
       return;
     }
-    const auto handler = on_station_event_handler_.find(if_index);
-    if (handler != on_station_event_handler_.end()) {
-      array<uint8_t, ETH_ALEN> mac_address;
-      if (!packet->GetAttributeValue(NL80211_ATTR_MAC, &mac_address)) {
-        LOG(WARNING) << "Failed to get mac address from station event";
-        return;
-      }
-      if (command == NL80211_CMD_NEW_STATION) {
-        handler->second(NEW_STATION, mac_address);
-      } else {
-        handler->second(DEL_STATION, mac_address);
-      }
+    // The handler may unsubscribe while being run.
+    OnStationEventHandler station_event_handler = handler->second;
+    if (packet.GetCommand() == NL80211_CMD_NEW_STATION) {
+      station_event_handler(NEW_STATION, mac_address);
+    } else {
+      station_event_handler(DEL_STATION, mac_address);
     }
-    return;
-  }
-  if (command == NL80211_CMD_CH_SWITCH_NOTIFY) {
-    OnChannelSwitchEvent(std::move(packet));
-    return;
-  }
-  if (command == NL80211_CMD_FRAME_TX_STATUS) {
-    OnFrameTxStatusEvent(std::move(packet));
-    return;
   }
 }
 
-void NetlinkManager::OnRegChangeEvent(unique_ptr<const NL80211Packet> packet) {
+void NetlinkManager::OnRegChangeEvent(const NL80211PacketView& packet) {
   uint8_t reg_type;
-  if (!packet->GetAttributeValue(NL80211_ATTR_REG_TYPE, &reg_type)) {
+  if (!packet.GetAttributeValue(NL80211_ATTR_REG_TYPE, &reg_type)) {
     LOG(ERROR) << "Failed to get NL80211_ATTR_REG_TYPE";
   }
 
@@ -568,7 +1470,7 @@ void NetlinkManager::OnRegChangeEvent(unique_ptr<const NL80211Packet> packet) {
   // NL80211_REGDOM_TYPE_COUNTRY means the regulatory domain set is one that
   // pertains to a specific country
   if (reg_type == NL80211_REGDOM_TYPE_COUNTRY) {
-    if (!packet->GetAttributeValue(NL80211_ATTR_REG_ALPHA2, &country_code)) {
+    if (!packet.GetAttributeValue(NL80211_ATTR_REG_ALPHA2, &country_code)) {
       LOG(ERROR) << "Failed to get NL80211_ATTR_REG_ALPHA2";
       return;
     }
@@ -588,15 +1490,53 @@ void NetlinkManager::OnRegChangeEvent(unique_ptr<const NL80211Packet> packet) {
     return;
   }
 
+  // Handlers may subscribe or unsubscribe while being run.
+  vector<OnRegDomainChangedHandler> handlers;
   for (const auto& handler : on_reg_domain_changed_handler_) {
-    handler.second(country_code);
+    handlers.push_back(handler.second);
+  }
+  for (const auto& handler : handlers) {
+    handler(country_code);
+  }
+}
+
+void NetlinkManager::OnInterfaceEvent(const NL80211PacketView& packet) {
+  uint32_t wiphy_index;
+  if (!packet.GetAttributeValue(NL80211_ATTR_WIPHY, &wiphy_index)) {
+    LOG(ERROR) << "Failed to get wiphy index from an interface event";
+    return;
+  }
+  const auto handler = on_interface_event_handler_.find(wiphy_index);
+  if (handler == on_interface_event_handler_.end()) {
+    return;
+  }
+  // Like NetlinkUtils::GetInterfaces(), skip pseudo interfaces without a
+  // netdev.
+  uint32_t if_index;
+  if (!packet.GetAttributeValue(NL80211_ATTR_IFINDEX, &if_index)) {
+    return;
+  }
+  string if_name;
+  if (!packet.GetAttributeValue(NL80211_ATTR_IFNAME, &if_name)) {
+    LOG(WARNING) << "Failed to get interface name from an interface event";
+    return;
+  }
+  array<uint8_t, ETH_ALEN> mac_address;
+  if (!packet.GetAttributeValue(NL80211_ATTR_MAC, &mac_address)) {
+    LOG(WARNING) << "Failed to get mac address from an interface event";
+    return;
   }
+  InterfaceEvent event = packet.GetCommand() == NL80211_CMD_NEW_INTERFACE ?
+      NEW_INTERFACE : DEL_INTERFACE;
+  // The handler may unsubscribe while being run.
+  OnInterfaceEventHandler interface_event_handler = handler->second;
+  interface_event_handler(event, if_index, if_name, mac_address);
 }
 
-void NetlinkManager::OnMlmeEvent(unique_ptr<const NL80211Packet> packet) {
+void NetlinkManager::OnMlmeEvent(const NL80211PacketView& packet) {
   uint32_t if_index;
 
-  if (!packet->GetAttributeValue(NL80211_ATTR_IFINDEX, &if_index)) {
+  if (!packet.GetAttributeValue(NL80211_ATTR_IFINDEX, &if_index)) {
     LOG(ERROR) << "Failed to get interface index from a MLME event message";
     return;
   }
@@ -606,37 +1546,44 @@ void NetlinkManager::OnMlmeEvent(unique_ptr<const NL80211Packet> packet) {
                << " with index: " << if_index;
     return;
   }
-  uint32_t command = packet->GetCommand();
+  uint32_t command = packet.GetCommand();
   if (command == NL80211_CMD_CONNECT) {
-    auto event = MlmeConnectEvent::InitFromPacket(packet.get());
+    auto event = MlmeConnectEvent::InitFromPacket(&packet);
     if (event != nullptr) {
       handler->second->OnConnect(std::move(event));
     }
     return;
   }
+  if (command == NL80211_CMD_AUTHENTICATE) {
+    auto event = MlmeAuthenticateEvent::InitFromPacket(&packet);
+    if (event != nullptr) {
+      handler->second->OnAuthenticate(std::move(event));
+    }
+    return;
+  }
   if (command == NL80211_CMD_ASSOCIATE) {
-    auto event = MlmeAssociateEvent::InitFromPacket(packet.get());
+    auto event = MlmeAssociateEvent::InitFromPacket(&packet);
     if (event != nullptr) {
       handler->second->OnAssociate(std::move(event));
     }
     return;
   }
   if (command == NL80211_CMD_ROAM) {
-    auto event = MlmeRoamEvent::InitFromPacket(packet.get());
+    auto event = MlmeRoamEvent::InitFromPacket(&packet);
     if (event != nullptr) {
       handler->second->OnRoam(std::move(event));
     }
     return;
   }
   if (command == NL80211_CMD_DISCONNECT) {
-    auto event = MlmeDisconnectEvent::InitFromPacket(packet.get());
+    auto event = MlmeDisconnectEvent::InitFromPacket(&packet);
     if (event != nullptr) {
       handler->second->OnDisconnect(std::move(event));
     }
     return;
   }
   if (command == NL80211_CMD_DISASSOCIATE) {
-    auto event = MlmeDisassociateEvent::InitFromPacket(packet.get());
+    auto event = MlmeDisassociateEvent::InitFromPacket(&packet);
     if (event != nullptr) {
       handler->second->OnDisassociate(std::move(event));
     }
@@ -645,9 +1592,9 @@ void NetlinkManager::OnMlmeEvent(unique_ptr<const NL80211Packet> packet) {
 
 }
 
-void NetlinkManager::OnSchedScanResultsReady(unique_ptr<const NL80211Packet> packet) {
+void NetlinkManager::OnSchedScanResultsReady(const NL80211PacketView& packet) {
   uint32_t if_index;
-  if (!packet->GetAttributeValue(NL80211_ATTR_IFINDEX, &if_index)) {
+  if (!packet.GetAttributeValue(NL80211_ATTR_IFINDEX, &if_index)) {
     LOG(ERROR) << "Failed to get interface index from scan result notification";
     return;
   }
@@ -658,31 +1605,36 @@ void NetlinkManager::OnSchedScanResultsReady(unique_ptr<const NL80211Packet> pac
                << " interface with index: " << if_index;
     return;
   }
-  // Run scan result notification handler.
-  handler->second(if_index, packet->GetCommand() == NL80211_CMD_SCHED_SCAN_STOPPED);
+  // Run scan result notification handler, which may unsubscribe.
+  OnSchedScanResultsReadyHandler result_ready_handler = handler->second;
+  result_ready_handler(if_index,
+                       packet.GetCommand() == NL80211_CMD_SCHED_SCAN_STOPPED);
 }
 
-void NetlinkManager::OnScanResultsReady(unique_ptr<const NL80211Packet> packet) {
+void NetlinkManager::OnScanResultsReady(const NL80211PacketView& packet) {
+  ATRACE_CALL();
   uint32_t if_index;
-  if (!packet->GetAttributeValue(NL80211_ATTR_IFINDEX, &if_index)) {
+  if (!packet.GetAttributeValue(NL80211_ATTR_IFINDEX, &if_index)) {
     LOG(ERROR) << "Failed to get interface index from scan result notification";
     return;
   }
   bool aborted = false;
-  if (packet->GetCommand() == NL80211_CMD_SCAN_ABORTED) {
+  if (packet.GetCommand() == NL80211_CMD_SCAN_ABORTED) {
     aborted = true;
   }
 
   const auto handler = on_scan_result_ready_handler_.find(if_index);
   if (handler == on_scan_result_ready_handler_.end()) {
-    LOG(WARNING) << "No handler for scan result notification from interface"
-                 << " with index: " << if_index;
+    static LogRateLimiter no_handler_log_limiter;
+    LOG_RATE_LIMITED(WARNING, no_handler_log_limiter)
+        << "No handler for scan result notification from interface"
+        << " with index: " << if_index;
     return;
   }
 
   vector<vector<uint8_t>> ssids;
   NL80211NestedAttr ssids_attr(0);
-  if (!packet->GetAttribute(NL80211_ATTR_SCAN_SSIDS, &ssids_attr)) {
+  if (!packet.GetAttribute(NL80211_ATTR_SCAN_SSIDS, &ssids_attr)) {
     if (!aborted) {
       LOG(WARNING) << "Failed to get scan ssids from scan result notification";
     }
@@ -693,7 +1645,7 @@ void NetlinkManager::OnScanResultsReady(unique_ptr<const NL80211Packet> packet)
   }
   vector<uint32_t> freqs;
   NL80211NestedAttr freqs_attr(0);
-  if (!packet->GetAttribute(NL80211_ATTR_SCAN_FREQUENCIES, &freqs_attr)) {
+  if (!packet.GetAttribute(NL80211_ATTR_SCAN_FREQUENCIES, &freqs_attr)) {
     if (!aborted) {
       LOG(WARNING) << "Failed to get scan freqs from scan result notification";
     }
@@ -702,25 +1654,26 @@ void NetlinkManager::OnScanResultsReady(unique_ptr<const NL80211Packet> packet)
       return;
     }
   }
-  // Run scan result notification handler.
-  handler->second(if_index, aborted, ssids, freqs);
+  // Run scan result notification handler, which may unsubscribe.
+  OnScanResultsReadyHandler result_ready_handler = handler->second;
+  result_ready_handler(if_index, aborted, ssids, freqs);
 }
 
-void NetlinkManager::OnChannelSwitchEvent(unique_ptr<const NL80211Packet> packet) {
+void NetlinkManager::OnChannelSwitchEvent(const NL80211PacketView& packet) {
     uint32_t if_index = 0;
-    if (!packet->GetAttributeValue(NL80211_ATTR_IFINDEX, &if_index)) {
+    if (!packet.GetAttributeValue(NL80211_ATTR_IFINDEX, &if_index)) {
       LOG(WARNING) << "Failed to get NL80211_ATTR_IFINDEX"
                    << "from channel switch event";
       return;
     }
     uint32_t frequency = 0;
-    if (!packet->GetAttributeValue(NL80211_ATTR_WIPHY_FREQ, &frequency)) {
+    if (!packet.GetAttributeValue(NL80211_ATTR_WIPHY_FREQ, &frequency)) {
       LOG(WARNING) << "Failed to get NL80211_ATTR_WIPHY_FREQ"
                    << "from channel switch event";
       return;
     }
     uint32_t bandwidth = 0;
-    if (!packet->GetAttributeValue(NL80211_ATTR_CHANNEL_WIDTH, &bandwidth)) {
+    if (!packet.GetAttributeValue(NL80211_ATTR_CHANNEL_WIDTH, &bandwidth)) {
       LOG(WARNING) << "Failed to get NL80211_ATTR_CHANNEL_WIDTH"
                    << "from channel switch event";
       return;
@@ -728,104 +1681,227 @@ void NetlinkManager::OnChannelSwitchEvent(unique_ptr<const NL80211Packet> packet
 
     const auto handler = on_channel_switch_event_handler_.find(if_index);
     if (handler != on_channel_switch_event_handler_.end()) {
-      handler->second(frequency, getBandwidthType(bandwidth));
+      // The handler may unsubscribe while being run.
+      OnChannelSwitchEventHandler channel_switch_handler = handler->second;
+      channel_switch_handler(frequency, getBandwidthType(bandwidth));
     }
 }
 
 void NetlinkManager::OnFrameTxStatusEvent(
-    unique_ptr<const NL80211Packet> packet) {
+    const NL80211PacketView& packet) {
 
   uint32_t if_index;
-  if (!packet->GetAttributeValue(NL80211_ATTR_IFINDEX, &if_index)) {
+  if (!packet.GetAttributeValue(NL80211_ATTR_IFINDEX, &if_index)) {
     LOG(WARNING) << "Failed to get NL80211_ATTR_IFINDEX"
                  << "from NL80211_CMD_FRAME_TX_STATUS event";
     return;
   }
 
   uint64_t cookie;
-  if (!packet->GetAttributeValue(NL80211_ATTR_COOKIE, &cookie)) {
+  if (!packet.GetAttributeValue(NL80211_ATTR_COOKIE, &cookie)) {
     LOG(WARNING) << "Failed to get NL80211_ATTR_COOKIE"
                  << "from NL80211_CMD_FRAME_TX_STATUS event";
     return;
   }
 
-  bool was_acked = packet->HasAttribute(NL80211_ATTR_ACK);
+  bool was_acked = packet.HasAttribute(NL80211_ATTR_ACK);
 
   const auto handler = on_frame_tx_status_event_handler_.find(if_index);
   if (handler != on_frame_tx_status_event_handler_.end()) {
-    handler->second(cookie, was_acked);
+    // The handler may unsubscribe while being run.
+    OnFrameTxStatusEventHandler tx_status_handler = handler->second;
+    tx_status_handler(cookie, was_acked);
   }
 }
 
+void NetlinkManager::OnCqmEvent(const NL80211PacketView& packet) {
+  uint32_t if_index;
+  if (!packet.GetAttributeValue(NL80211_ATTR_IFINDEX, &if_index)) {
+    LOG(WARNING) << "Failed to get NL80211_ATTR_IFINDEX "
+                 << "from NL80211_CMD_NOTIFY_CQM event";
+    return;
+  }
+  const auto handler = on_cqm_event_handler_.find(if_index);
+  if (handler == on_cqm_event_handler_.end()) {
+    return;
+  }
+
+  NL80211NestedAttr cqm(0);
+  if (!packet.GetAttribute(NL80211_ATTR_CQM, &cqm)) {
+    LOG(WARNING) << "Failed to get NL80211_ATTR_CQM "
+                 << "from NL80211_CMD_NOTIFY_CQM event";
+    return;
+  }
+  CqmEvent event;
+  int32_t rssi_dbm = 0;
+  uint32_t packets = 0;
+  uint32_t rssi_event;
+  if (cqm.GetAttributeValue(NL80211_ATTR_CQM_RSSI_THRESHOLD_EVENT,
+                            &rssi_event)) {
+    if (rssi_event == NL80211_CQM_RSSI_THRESHOLD_EVENT_LOW) {
+      event = CQM_RSSI_LOW;
+    } else if (rssi_event == NL80211_CQM_RSSI_THRESHOLD_EVENT_HIGH) {
+      event = CQM_RSSI_HIGH;
+    } else {
+      event = CQM_BEACON_LOSS;
+    }
+    // Older kernels do not report the RSSI level.
+    cqm.GetAttributeValue(NL80211_ATTR_CQM_RSSI_LEVEL, &rssi_dbm);
+  } else if (cqm.GetAttributeValue(NL80211_ATTR_CQM_PKT_LOSS_EVENT,
+                                   &packets)) {
+    event = CQM_PACKET_LOSS;
+  } else if (cqm.HasAttribute(NL80211_ATTR_CQM_BEACON_LOSS_EVENT)) {
+    event = CQM_BEACON_LOSS;
+  } else if (cqm.GetAttributeValue(NL80211_ATTR_CQM_TXE_PKTS, &packets)) {
+    event = CQM_TX_ERROR_RATE;
+  } else {
+    LOG(WARNING) << "Unknown NL80211_CMD_NOTIFY_CQM event";
+    return;
+  }
+  // The handler may unsubscribe while being run.
+  OnCqmEventHandler cqm_event_handler = handler->second;
+  cqm_event_handler(event, rssi_dbm, packets);
+}
+
 void NetlinkManager::SubscribeStationEvent(
     uint32_t interface_index,
     OnStationEventHandler handler) {
   on_station_event_handler_[interface_index] = handler;
+  UpdateEventFilter();
 }
 
 void NetlinkManager::UnsubscribeStationEvent(uint32_t interface_index) {
   on_station_event_handler_.erase(interface_index);
+  UpdateEventFilter();
+}
+
+void NetlinkManager::Subscribe(uint8_t command,
+                               uint32_t interface_index,
+                               OnEventHandler handler) {
+  event_dispatch_table_[command].handlers[interface_index] = handler;
+  UpdateEventFilter();
+}
+
+void NetlinkManager::Unsubscribe(uint8_t command, uint32_t interface_index) {
+  event_dispatch_table_[command].handlers.erase(interface_index);
+  UpdateEventFilter();
+}
+
+void NetlinkManager::SubscribeEventsLost(uint32_t interface_index,
+                                         OnEventsLostHandler handler) {
+  on_events_lost_handler_[interface_index] = handler;
+}
+
+void NetlinkManager::UnsubscribeEventsLost(uint32_t interface_index) {
+  on_events_lost_handler_.erase(interface_index);
+}
+
+void NetlinkManager::CreateInterfaceStrand(uint32_t interface_index) {
+  unique_ptr<EventLoopStrand>& strand =
+      interface_strands_[interface_index];
+  if (strand == nullptr) {
+    strand.reset(new EventLoopStrand(event_loop_));
+  }
+}
+
+void NetlinkManager::DestroyInterfaceStrand(uint32_t interface_index) {
+  interface_strands_.erase(interface_index);
 }
 
 void NetlinkManager::SubscribeChannelSwitchEvent(
       uint32_t interface_index,
       OnChannelSwitchEventHandler handler) {
   on_channel_switch_event_handler_[interface_index] = handler;
+  UpdateEventFilter();
 }
 
 void NetlinkManager::UnsubscribeChannelSwitchEvent(uint32_t interface_index) {
   on_channel_switch_event_handler_.erase(interface_index);
+  UpdateEventFilter();
 }
 
 
+void NetlinkManager::SubscribeCqmEvent(uint32_t interface_index,
+                                       OnCqmEventHandler handler) {
+  on_cqm_event_handler_[interface_index] = handler;
+  UpdateEventFilter();
+}
+
+void NetlinkManager::UnsubscribeCqmEvent(uint32_t interface_index) {
+  on_cqm_event_handler_.erase(interface_index);
+  UpdateEventFilter();
+}
+
 void NetlinkManager::SubscribeRegDomainChange(
     uint32_t wiphy_index,
     OnRegDomainChangedHandler handler) {
   on_reg_domain_changed_handler_[wiphy_index] = handler;
+  UpdateEventFilter();
 }
 
 void NetlinkManager::UnsubscribeRegDomainChange(uint32_t wiphy_index) {
   on_reg_domain_changed_handler_.erase(wiphy_index);
+  UpdateEventFilter();
+}
+
+void NetlinkManager::SubscribeInterfaceEvent(
+    uint32_t wiphy_index,
+    OnInterfaceEventHandler handler) {
+  on_interface_event_handler_[wiphy_index] = handler;
+  UpdateEventFilter();
+}
+
+void NetlinkManager::UnsubscribeInterfaceEvent(uint32_t wiphy_index) {
+  on_interface_event_handler_.erase(wiphy_index);
+  UpdateEventFilter();
 }
 
 void NetlinkManager::SubscribeScanResultNotification(
     uint32_t interface_index,
     OnScanResultsReadyHandler handler) {
   on_scan_result_ready_handler_[interface_index] = handler;
+  UpdateEventFilter();
 }
 
 void NetlinkManager::UnsubscribeScanResultNotification(
     uint32_t interface_index) {
   on_scan_result_ready_handler_.erase(interface_index);
+  UpdateEventFilter();
 }
 
 void NetlinkManager::SubscribeMlmeEvent(uint32_t interface_index,
                                         MlmeEventHandler* handler) {
   on_mlme_event_handler_[interface_index] = handler;
+  UpdateEventFilter();
 }
 
 void NetlinkManager::UnsubscribeMlmeEvent(uint32_t interface_index) {
   on_mlme_event_handler_.erase(interface_index);
+  UpdateEventFilter();
 }
 
 void NetlinkManager::SubscribeSchedScanResultNotification(
       uint32_t interface_index,
       OnSchedScanResultsReadyHandler handler) {
   on_sched_scan_result_ready_handler_[interface_index] = handler;
+  UpdateEventFilter();
 }
 
 void NetlinkManager::UnsubscribeSchedScanResultNotification(
     uint32_t interface_index) {
   on_sched_scan_result_ready_handler_.erase(interface_index);
+  UpdateEventFilter();
 }
 
 void NetlinkManager::SubscribeFrameTxStatusEvent(
     uint32_t interface_index, OnFrameTxStatusEventHandler handler) {
   on_frame_tx_status_event_handler_[interface_index] = handler;
+  UpdateEventFilter();
 }
 
 void NetlinkManager::UnsubscribeFrameTxStatusEvent(uint32_t interface_index) {
   on_frame_tx_status_event_handler_.erase(interface_index);
+  UpdateEventFilter();
 }
 
 }  // namespace wificond
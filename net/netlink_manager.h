@@ -19,21 +19,36 @@
 
 #include <array>
 #include <functional>
+#include <initializer_list>
 #include <map>
 #include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include <linux/if_ether.h>
 
 #include <android-base/macros.h>
 #include <android-base/unique_fd.h>
+#include <utils/Timers.h>
 
 #include "event_loop.h"
+#include "event_loop_strand.h"
+#include "wificond/memory_account.h"
+#include "wificond/net/flat_handler_map.h"
+#include "wificond/net/request_table.h"
 
 namespace android {
 namespace wificond {
 
+struct EventFilterRule;
 class MlmeEventHandler;
+class NetlinkCaptureWriter;
+class NetlinkReceiveThread;
 class NL80211Packet;
+class NL80211PacketView;
 
 // Encapsulates all the different things we know about a specific message
 // type like its name, and its id.
@@ -87,6 +102,23 @@ typedef std::function<void(
 typedef std::function<void(
     std::string& country_code)> OnRegDomainChangedHandler;
 
+// Enum used for identifying the type of an interface event.
+// This is used by function |OnInterfaceEventHandler|.
+enum InterfaceEvent {
+    NEW_INTERFACE,
+    DEL_INTERFACE
+};
+
+// This describes a type of function handling interface events.
+// |event| specifies the type of this event.
+// |if_index|, |if_name| and |mac_address| describe the interface that was
+// created or deleted.
+typedef std::function<void(
+    InterfaceEvent event,
+    uint32_t if_index,
+    const std::string& if_name,
+    const std::array<uint8_t, ETH_ALEN>& mac_address)> OnInterfaceEventHandler;
+
 // Enum used for identifying channel bandwidth.
 // This is used by function |OnChannelSwitchEventHandler|.
 enum ChannelBandwidth {
@@ -125,9 +157,104 @@ typedef std::function<void(
 typedef std::function<void(
     uint64_t cookie, bool was_acked)> OnFrameTxStatusEventHandler;
 
+// Enum used for identifying the type of a connection quality monitor event.
+// This is used by function |OnCqmEventHandler|.
+enum CqmEvent {
+    CQM_RSSI_LOW,
+    CQM_RSSI_HIGH,
+    CQM_BEACON_LOSS,
+    CQM_PACKET_LOSS,
+    CQM_TX_ERROR_RATE
+};
+
+// This describes a type of function handling connection quality monitor
+// notifications.
+// |event| specifies the type of this event.
+// |rssi_dbm| is the RSSI that triggered a CQM_RSSI_* event, or 0 if kernel
+// does not report it.
+// |packets| is the number of unacknowledged packets of a CQM_PACKET_LOSS
+// event, or the number of attempted packets of a CQM_TX_ERROR_RATE event.
+typedef std::function<void(
+    CqmEvent event,
+    int32_t rssi_dbm,
+    uint32_t packets)> OnCqmEventHandler;
+
+// This describes a type of function handling the completion of a request
+// sent by |SendMessageAsync|.
+// |success| is false if the request could not be completed, for example
+// because no complete reply was received in time.
+// |responses| holds the reply messages in the order they were received,
+// including NLMSG_ERROR messages.
+typedef std::function<void(
+    bool success,
+    std::vector<std::unique_ptr<const NL80211Packet>> responses)>
+    OnResponsesReceivedHandler;
+
+// This describes a type of function handling a raw multicast event.
+// |packet| is only valid during the call.
+typedef std::function<void(const NL80211PacketView& packet)> OnEventHandler;
+
+// This describes a type of function handling the loss of multicast events.
+// It is called after kernel dropped events because the asynchronous socket
+// receive buffer overran. Subscribers should re-query the state they track
+// from kernel instead of relying on the events they might have missed.
+typedef std::function<void()> OnEventsLostHandler;
+
+// Receive buffer settings of the netlink sockets used by NetlinkManager.
+struct NetlinkSocketConfig {
+  NetlinkSocketConfig();
+  // Receive buffer size in bytes of the synchronous socket, applied with
+  // SO_RCVBUFFORCE. It only has to hold the replies of requests in flight.
+  int sync_receive_buffer_size;
+  // Receive buffer size in bytes of the asynchronous socket, applied with
+  // SO_RCVBUFFORCE. It has to absorb bursts of multicast events, e.g.
+  // scan results or station events, while the event loop is busy.
+  int async_receive_buffer_size;
+  // If true, NETLINK_NO_ENOBUFS is set on the asynchronous socket.
+  // Kernel then silently drops events on overrun instead of reporting
+  // ENOBUFS, so |OnEventsLostHandler|s are never run.
+  bool async_no_enobufs;
+  // If true, a socket filter is attached to the asynchronous socket that only
+  // lets through the multicast events somebody is subscribed to, i.e. whose
+  // command and interface index have a handler. The filter is rebuilt every
+  // time a subscription changes.
+  bool async_event_filter;
+  // If true, the asynchronous socket is drained by a NetlinkReceiveThread
+  // instead of the event loop, so that bursts of events are taken off the
+  // socket receive buffer while the event loop is busy.
+  bool async_receive_thread;
+};
+
+// Latency of the synchronous requests with a given command, measured from
+// sending the request until its complete reply has been received.
+struct CommandLatencyStats {
+  // Latency histogram buckets: bucket 0 counts replies received in less
+  // than 1ms, bucket i > 0 those received in [2^(i-1), 2^i) ms, and the
+  // last bucket all slower replies.
+  static constexpr size_t kNumLatencyBuckets = 12;
+
+  // Number of requests whose complete reply was received.
+  uint32_t num_completed = 0;
+  // Number of completed requests that kernel answered with an error code.
+  uint32_t num_errors = 0;
+  // Number of requests whose reply did not arrive within the time budget.
+  uint32_t num_timeouts = 0;
+  // Number of requests that failed otherwise, e.g. because replies were
+  // dropped.
+  uint32_t num_failed = 0;
+  // Number and total size in bytes of the reply messages received.
+  uint64_t num_messages = 0;
+  uint64_t num_bytes = 0;
+  // Sum and maximum of the latencies of the completed requests.
+  nsecs_t total_latency = 0;
+  nsecs_t max_latency = 0;
+  std::array<uint32_t, kNumLatencyBuckets> latency_histogram = {};
+};
+
 class NetlinkManager {
  public:
   explicit NetlinkManager(EventLoop* event_loop);
+  NetlinkManager(EventLoop* event_loop, const NetlinkSocketConfig& config);
   virtual ~NetlinkManager();
   // Initialize netlink manager.
   // This includes setting up socket and requesting nl80211 family id from kernel.
@@ -147,12 +274,46 @@ class NetlinkManager {
   // Returns true on success.
   virtual bool RegisterHandlerAndSendMessage(const NL80211Packet& packet,
       std::function<void(std::unique_ptr<const NL80211Packet>)> handler);
+  // Send |packet| to kernel without blocking the event loop.
+  // Replies are received on the asynchronous socket while the event loop is
+  // running. |handler| is run exactly once: either when the complete reply
+  // has been received, or with |success| set to false if that does not
+  // happen within the same time budget the synchronous interface uses.
+  // Unlike |RegisterHandlerAndSendMessage|, |handler| is also run for
+  // requests that are answered with a NLMSG_ERROR or a multipart reply.
+  // Returns true if the message was sent. |handler| is not run otherwise.
+  virtual bool SendMessageAsync(const NL80211Packet& packet,
+                                OnResponsesReceivedHandler handler);
   // Synchronous version of |RegisterHandlerAndSendMessage|.
   // Returns true on successfully receiving an valid reply.
   // Reply packets will be stored in |*response|.
   virtual bool SendMessageAndGetResponses(
       const NL80211Packet& packet,
       std::vector<std::unique_ptr<const NL80211Packet>>* response);
+  // Streaming version of |SendMessageAndGetResponses|.
+  // |handler| is run for each reply message as soon as it is received, so
+  // that large dumps can be parsed without keeping all raw packets around.
+  // NLMSG_ERROR messages are passed to |handler| as well.
+  // The view passed to |handler| is only valid during the call.
+  // Returns true on successfully receiving the complete reply.
+  virtual bool SendMessageAndStreamResponses(
+      const NL80211Packet& packet,
+      std::function<void(const NL80211PacketView&)> handler);
+  // Batched version of |SendMessageAndGetResponses|.
+  // All |packets| are written to kernel with a single sendmsg() call, so that
+  // kernel can process them back to back instead of waiting one round trip
+  // per request. Each packet must carry a distinct sequence number.
+  // Replies are sorted by sequence number: |(*responses)[i]| will hold the
+  // reply packets of |packets[i]|.
+  // Replies to all |packets| are queued in the socket receive buffer at the
+  // same time, and kernel only runs one dump at a time on a socket. For these
+  // reasons dump requests cannot be batched.
+  // Returns true on successfully receiving the complete reply for every
+  // packet.
+  virtual bool SendMessagesAndGetResponses(
+      const std::vector<const NL80211Packet*>& packets,
+      std::vector<std::vector<std::unique_ptr<const NL80211Packet>>>*
+          responses);
   // Wrapper of |SendMessageAndGetResponses| for messages with a single
   // response.
   // Returns true on successfully receiving an valid reply.
@@ -183,6 +344,38 @@ class NetlinkManager {
   // is an ACK.
   virtual bool SendMessageAndGetAck(const NL80211Packet& packet);
 
+  // Synchronous requests fail if their complete reply does not arrive within
+  // a time budget. The budget defaults to 300ms, or 1s for dump requests.
+  // This overrides the budget of requests with nl80211 command |command|.
+  // A budget of 0 or less restores the default.
+  // Commands of other generic netlink families share the budget of the
+  // nl80211 command that has the same value.
+  virtual void SetResponseTimeout(uint8_t command, int timeout_ms);
+  // Returns the latency of the synchronous requests sent so far with command
+  // |command| of generic netlink family |message_type|.
+  virtual CommandLatencyStats GetCommandLatencyStats(uint16_t message_type,
+                                                     uint8_t command) const;
+  // Appends the latency stats of every command sent so far to |ss|.
+  virtual void DumpCommandLatencies(std::stringstream* ss) const;
+
+  // Appends the memory held by the receive buffers, the replies of requests
+  // in flight and the pooled packet buffers to |accounts|.
+  // Packet buffers are pooled per thread, those of the calling thread are
+  // reported. This should be the event loop thread, which builds and parses
+  // the packets.
+  virtual void GetMemoryAccounts(std::vector<MemoryAccount>* accounts) const;
+  // Frees the receive buffers, which the next receive allocates again, and
+  // the pooled packet buffers of the calling thread.
+  virtual void TrimMemory();
+
+  // Records every datagram sent and received from now on to the capture file
+  // at |path|, which is truncated first. See netlink_capture.h for the file
+  // format.
+  // Returns true on success.
+  virtual bool StartCapture(const std::string& path);
+  // Stops recording and closes the capture file.
+  virtual void StopCapture();
+
   // Sign up to receive and log multicast events of a specific type.
   // |group| is one of the string NL80211_MULTICAST_GROUP_* in nl80211.h.
   virtual bool SubscribeToEvents(const std::string& group);
@@ -244,6 +437,18 @@ class NetlinkManager {
   // from wiphy with index |wiphy_index|.
   virtual void UnsubscribeRegDomainChange(uint32_t wiphy_index);
 
+  // Sign up to be notified when an interface of wiphy |wiphy_index| is
+  // created or deleted.
+  // Only one handler can be registered per wiphy index.
+  // New handler will replace the registered handler if they are for the
+  // same wiphy index.
+  virtual void SubscribeInterfaceEvent(uint32_t wiphy_index,
+                                       OnInterfaceEventHandler handler);
+
+  // Cancel the sign-up of receiving interface events from wiphy with index
+  // |wiphy_index|.
+  virtual void UnsubscribeInterfaceEvent(uint32_t wiphy_index);
+
   // Sign up to be notified when there is a station event.
   // Only one handler can be registered per interface index.
   // New handler will replace the registered handler if they are for the
@@ -272,19 +477,150 @@ class NetlinkManager {
   // Cancel the sign-up of receiving frame tx status events.
   virtual void UnsubscribeFrameTxStatusEvent(uint32_t interface_index);
 
+  // Sign up to be notified of connection quality monitor events.
+  // Only one handler can be registered per interface index.
+  // New handler will replace the registered handler if they are for the
+  // same interface index.
+  virtual void SubscribeCqmEvent(uint32_t interface_index,
+                                 OnCqmEventHandler handler);
+
+  // Cancel the sign-up of receiving connection quality monitor events.
+  virtual void UnsubscribeCqmEvent(uint32_t interface_index);
+
+  // Sign up to receive multicast events with nl80211 command |command| from
+  // interface with index |interface_index|.
+  // This is the generic counterpart of the typed Subscribe* functions, for
+  // events that have no dedicated handler type. It can be combined with them:
+  // typed handlers run first.
+  // Only one handler can be registered per command and interface index.
+  // New handler will replace the registered handler if they are for the
+  // same command and interface index.
+  virtual void Subscribe(uint8_t command,
+                         uint32_t interface_index,
+                         OnEventHandler handler);
+
+  // Cancel the sign-up of receiving events with nl80211 command |command|
+  // from interface with index |interface_index|.
+  virtual void Unsubscribe(uint8_t command, uint32_t interface_index);
+
+  // Sign up to be notified when multicast events might have been lost.
+  // Events are not tagged with an interface before they are parsed, so
+  // |handler| is run for any loss, not only for events of |interface_index|.
+  // Only one handler can be registered per interface index.
+  // New handler will replace the registered handler if they are for the
+  // same interface index.
+  virtual void SubscribeEventsLost(uint32_t interface_index,
+                                   OnEventsLostHandler handler);
+
+  // Cancel the sign-up of receiving events lost notification.
+  virtual void UnsubscribeEventsLost(uint32_t interface_index);
+
+  // Makes the handlers of multicast events from interface |interface_index|
+  // run on a strand of their own, see EventLoopStrand.
+  // Events are then parsed and dispatched once it is the turn of the strand,
+  // after the datagrams that are currently queued were read. This way
+  // independent interfaces take turns instead of waiting for each other's
+  // event bursts. Events of an interface are still handled in order, and
+  // handlers are looked up when the event is dispatched.
+  virtual void CreateInterfaceStrand(uint32_t interface_index);
+
+  // Makes events from interface |interface_index| run right away again.
+  // Events that were not dispatched yet are dropped.
+  virtual void DestroyInterfaceStrand(uint32_t interface_index);
+
+ protected:
+  // Reads all datagrams that are queued on |fd| and runs their handlers.
+  // Returns false if kernel reported that messages were dropped because the
+  // socket receive buffer overran.
+  // Load generators of tests call this on their own sockets.
+  bool ReceivePacketAndRunHandler(int fd);
+  // Messages are parsed in place from the receive buffer.
+  // Only handlers that keep a message copy it into an owned NL80211Packet.
+  // Backends that do not receive from kernel, like the replay backend of
+  // tests, feed their datagrams through this.
+  void RunHandlersForDatagram(const uint8_t* buffer, size_t len);
+  // Runs the handler of message |packet|. Returns false if the rest of the
+  // datagram of |packet| is to be dropped.
+  bool RunHandlersForMessage(const NL80211PacketView& packet);
+  // Requests the nl80211 family id and multicast groups.
+  bool DiscoverFamilyId();
+
  private:
-  bool SetupSocket(android::base::unique_fd* netlink_fd);
+  typedef void (NetlinkManager::*EventParser)(const NL80211PacketView&);
+
+  bool SetupSocket(android::base::unique_fd* netlink_fd,
+                   int receive_buffer_size,
+                   bool no_enobufs);
   bool WatchSocket(android::base::unique_fd* netlink_fd);
-  void ReceivePacketAndRunHandler(int fd);
-  bool DiscoverFamilyId();
+  // Starts |receive_thread_| on the asynchronous socket, and watches its
+  // notifications instead of the socket.
+  bool StartReceiveThread();
+  // Runs the handlers of the records that |receive_thread_| handed over.
+  void ConsumeReceivedRecords();
+  // Removes the handler of request |sequence| and fails the request, because
+  // its reply cannot be received completely.
+  void AbortRequest(uint32_t sequence);
+  void OnReceiveBufferOverrun(int fd);
+  // Runs all |OnEventsLostHandler|s.
+  void OnEventsLost();
   bool SendMessageInternal(const NL80211Packet& packet, int fd);
-  void BroadcastHandler(std::unique_ptr<const NL80211Packet> packet);
-  void OnRegChangeEvent(std::unique_ptr<const NL80211Packet> packet);
-  void OnMlmeEvent(std::unique_ptr<const NL80211Packet> packet);
-  void OnScanResultsReady(std::unique_ptr<const NL80211Packet> packet);
-  void OnSchedScanResultsReady(std::unique_ptr<const NL80211Packet> packet);
-  void OnChannelSwitchEvent(std::unique_ptr<const NL80211Packet> packet);
-  void OnFrameTxStatusEvent(std::unique_ptr<const NL80211Packet> packet);
+  bool SendMessagesInternal(const std::vector<const NL80211Packet*>& packets,
+                            int fd);
+  // Polls the synchronous socket until the handlers of all |packets| have
+  // been removed, i.e. until all replies have been received, or until the
+  // largest time budget of |packets| has elapsed since |start_time|.
+  // On failure, the remaining handlers are removed.
+  bool PollForResponses(const std::vector<const NL80211Packet*>& packets,
+                        nsecs_t start_time);
+  // Returns the time budget of synchronous request |packet|.
+  int GetResponseTimeoutMs(const NL80211Packet& packet) const;
+  // Appends |packet| to |responses|, accounting for its memory until it is
+  // handed over to the caller.
+  void AppendResponse(std::vector<std::unique_ptr<const NL80211Packet>>*
+                          responses,
+                      const NL80211PacketView& packet);
+  // Wraps |handler| so that it also counts the replies to |packet|.
+  std::function<void(const NL80211PacketView&)> CountResponses(
+      const NL80211Packet& packet,
+      std::function<void(const NL80211PacketView&)> handler);
+  enum RequestResult {
+    kRequestCompleted,
+    kRequestTimedOut,
+    kRequestFailed,
+  };
+  void RecordCommandLatency(const NL80211Packet& packet,
+                            nsecs_t latency,
+                            RequestResult result);
+  // Runs and removes the completion handler of asynchronous request
+  // |sequence|, if there is one.
+  void CompleteAsyncRequest(uint32_t sequence, bool success);
+  // Arms |async_timeout_timer_| for the earliest deadline of the
+  // asynchronous requests, unless it fires before already.
+  void ScheduleAsyncRequestTimeout();
+  void OnAsyncRequestTimeout();
+  // Fills |event_dispatch_table_| with the parsers of the events that have a
+  // typed handler.
+  void InitEventDispatchTable();
+  void SetEventParser(std::initializer_list<uint8_t> commands,
+                      EventParser parser,
+                      std::function<void(EventFilterRule*)> add_filter_rule);
+  // Regenerates the socket filter of the asynchronous socket from the
+  // current subscriptions, if |async_event_filter| is enabled.
+  void UpdateEventFilter();
+  // Dispatches |packet| on the strand of its interface, or right away if
+  // there is none.
+  void BroadcastHandler(const NL80211PacketView& packet);
+  // Runs the parser and generic handler of multicast event |packet|.
+  void DispatchEvent(const NL80211PacketView& packet);
+  void OnStationEvent(const NL80211PacketView& packet);
+  void OnRegChangeEvent(const NL80211PacketView& packet);
+  void OnInterfaceEvent(const NL80211PacketView& packet);
+  void OnMlmeEvent(const NL80211PacketView& packet);
+  void OnScanResultsReady(const NL80211PacketView& packet);
+  void OnSchedScanResultsReady(const NL80211PacketView& packet);
+  void OnChannelSwitchEvent(const NL80211PacketView& packet);
+  void OnFrameTxStatusEvent(const NL80211PacketView& packet);
+  void OnCqmEvent(const NL80211PacketView& packet);
 
   // This handler revceives mapping from NL80211 family name to family id,
   // as well as mapping from group name to group id.
@@ -300,36 +636,103 @@ class NetlinkManager {
   android::base::unique_fd sync_netlink_fd_;
   android::base::unique_fd async_netlink_fd_;
   EventLoop* event_loop_;
+  const NetlinkSocketConfig socket_config_;
+
+  // One buffer per datagram read by recvmmsg().
+  // All buffers have |receive_buffer_size_| bytes. This starts at
+  // NLMSG_GOODSIZE and is doubled every time a datagram is truncated.
+  std::vector<std::vector<uint8_t>> receive_buffers_;
+  size_t receive_buffer_size_;
 
   // This is a collection of message handlers, for each sequence number.
-  std::map<uint32_t,
-      std::function<void(std::unique_ptr<const NL80211Packet>)>> message_handlers_;
+  RequestTable<std::function<void(const NL80211PacketView&)>>
+      message_handlers_;
+
+  // Requests sent by |SendMessageAsync| that are waiting for a reply, for
+  // each sequence number.
+  // Their deadline is the time by which a complete reply must arrive.
+  struct AsyncRequest {
+    OnResponsesReceivedHandler handler;
+    std::vector<std::unique_ptr<const NL80211Packet>> responses;
+  };
+  RequestTable<AsyncRequest> async_requests_;
+  // Fails the asynchronous requests whose deadline passed. It is armed for
+  // |async_timeout_deadline_|, the earliest deadline when it was armed.
+  EventLoop::TimerId async_timeout_timer_;
+  nsecs_t async_timeout_deadline_;
+  // Synchronous requests whose reply was lost, e.g. because it was truncated.
+  std::set<uint32_t> aborted_requests_;
+  // Time budgets set by |SetResponseTimeout|, for each nl80211 command.
+  std::map<uint8_t, int> response_timeouts_ms_;
+  // Latency of synchronous requests, for each message type and command.
+  std::map<std::pair<uint16_t, uint8_t>, CommandLatencyStats>
+      command_latency_stats_;
+  MemoryAccount receive_buffer_memory_;
+  // Replies received for requests that are not complete yet.
+  MemoryAccount response_memory_;
+
+  // Multicast events are dispatched by nl80211 command, which is an 8 bit
+  // value.
+  // |parser| decodes the event for the typed handler registry of the command,
+  // if there is one. |add_filter_rule| adds the subscriptions of that
+  // registry to the socket filter rule of the command. |handlers| are the
+  // handlers registered with the generic |Subscribe|, keyed by interface
+  // index.
+  struct EventDispatchEntry {
+    EventParser parser = nullptr;
+    std::function<void(EventFilterRule*)> add_filter_rule;
+    FlatHandlerMap<OnEventHandler> handlers;
+  };
+  std::array<EventDispatchEntry, 256> event_dispatch_table_;
 
   // A mapping from interface index to the handler registered to receive
   // scan results notifications.
-  std::map<uint32_t, OnScanResultsReadyHandler> on_scan_result_ready_handler_;
+  FlatHandlerMap<OnScanResultsReadyHandler> on_scan_result_ready_handler_;
   // A mapping from interface index to the handler registered to receive
   // scheduled scan results notifications.
-  std::map<uint32_t, OnSchedScanResultsReadyHandler>
+  FlatHandlerMap<OnSchedScanResultsReadyHandler>
       on_sched_scan_result_ready_handler_;
 
-  std::map<uint32_t, MlmeEventHandler*> on_mlme_event_handler_;
+  FlatHandlerMap<MlmeEventHandler*> on_mlme_event_handler_;
 
   // A mapping from wiphy index to the handler registered to receive
   // regulatory domain change notifications.
-  std::map<uint32_t, OnRegDomainChangedHandler> on_reg_domain_changed_handler_;
-  std::map<uint32_t, OnStationEventHandler> on_station_event_handler_;
-  std::map<uint32_t, OnChannelSwitchEventHandler> on_channel_switch_event_handler_;
+  FlatHandlerMap<OnRegDomainChangedHandler> on_reg_domain_changed_handler_;
+  // A mapping from wiphy index to the handler registered to receive
+  // interface events.
+  FlatHandlerMap<OnInterfaceEventHandler> on_interface_event_handler_;
+  FlatHandlerMap<OnStationEventHandler> on_station_event_handler_;
+  FlatHandlerMap<OnChannelSwitchEventHandler> on_channel_switch_event_handler_;
 
   // mapping from interface_index to frame tx status event handler
-  std::map<uint32_t, OnFrameTxStatusEventHandler>
+  FlatHandlerMap<OnFrameTxStatusEventHandler>
       on_frame_tx_status_event_handler_;
 
+  // mapping from interface_index to connection quality monitor event handler
+  FlatHandlerMap<OnCqmEventHandler> on_cqm_event_handler_;
+
+  // mapping from interface_index to events lost handler
+  FlatHandlerMap<OnEventsLostHandler> on_events_lost_handler_;
+
+  // mapping from interface_index to the strand running its event handlers
+  FlatHandlerMap<std::unique_ptr<EventLoopStrand>> interface_strands_;
+
   // Mapping from family name to family id, and group name to group id.
   std::map<std::string, MessageType> message_types_;
 
   uint32_t sequence_number_;
 
+  // Set while a capture is running.
+  std::unique_ptr<NetlinkCaptureWriter> capture_writer_;
+
+  // Set while the records of |receive_thread_| that remain of the current
+  // datagram are to be dropped, see RunHandlersForMessage().
+  bool drop_rest_of_datagram_;
+
+  // Set if |async_receive_thread| is enabled. It is declared last, so that
+  // it is stopped before the members its records are dispatched to go away.
+  std::unique_ptr<NetlinkReceiveThread> receive_thread_;
+
   DISALLOW_COPY_AND_ASSIGN(NetlinkManager);
 };
 
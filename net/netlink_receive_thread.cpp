@@ -0,0 +1,260 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/net/netlink_receive_thread.h"
+
+#include <errno.h>
+#include <linux/netlink.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <android-base/logging.h>
+
+#include "wificond/log_rate_limiter.h"
+#include "wificond/net/nl80211_packet_view.h"
+
+using android::base::unique_fd;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+// Same sizes as the receive buffers of NetlinkManager.
+constexpr size_t kReceiveBufferSize = 8 * 1024;
+constexpr size_t kMaximumReceiveBufferSize = 64 * 1024;
+constexpr size_t kReceiveBatchSize = 8;
+// How long the thread sleeps while the ring is full.
+constexpr int kRingFullWaitMs = 1;
+
+}  // namespace
+
+NetlinkReceiveThread::NetlinkReceiveThread(size_t ring_capacity)
+    : ring_(ring_capacity),
+      socket_fd_(-1),
+      receive_buffers_(kReceiveBatchSize),
+      receive_buffer_size_(kReceiveBufferSize),
+      notification_pending_(false),
+      num_ring_full_waits_(0) {
+}
+
+NetlinkReceiveThread::~NetlinkReceiveThread() {
+  Stop();
+}
+
+bool NetlinkReceiveThread::Start(int socket_fd) {
+  if (thread_.joinable()) {
+    LOG(ERROR) << "Netlink receive thread is already running";
+    return false;
+  }
+  notification_fd_.reset(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
+  stop_fd_.reset(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
+  if (notification_fd_.get() < 0 || stop_fd_.get() < 0) {
+    PLOG(ERROR) << "Failed to create eventfd for netlink receive thread";
+    return false;
+  }
+  socket_fd_ = socket_fd;
+  thread_ = std::thread(&NetlinkReceiveThread::Run, this);
+  return true;
+}
+
+void NetlinkReceiveThread::Stop() {
+  if (!thread_.joinable()) {
+    return;
+  }
+  uint64_t value = 1;
+  if (TEMP_FAILURE_RETRY(write(stop_fd_.get(), &value, sizeof(value))) < 0) {
+    PLOG(ERROR) << "Failed to stop netlink receive thread";
+  }
+  thread_.join();
+}
+
+size_t NetlinkReceiveThread::ConsumeRecords(
+    const std::function<void(const NetlinkReceiveRecord&)>& handler) {
+  uint64_t value;
+  // Records pushed after this read signal the eventfd again.
+  if (TEMP_FAILURE_RETRY(read(notification_fd_.get(), &value,
+                              sizeof(value))) < 0 &&
+      errno != EAGAIN) {
+    PLOG(ERROR) << "Failed to read netlink receive thread eventfd";
+  }
+  size_t num_records = 0;
+  for (NetlinkReceiveRecord* record = ring_.Front(); record != nullptr;
+       record = ring_.Front()) {
+    handler(*record);
+    ring_.Pop();
+    num_records++;
+  }
+  return num_records;
+}
+
+void NetlinkReceiveThread::Run() {
+  struct pollfd fds[2];
+  memset(fds, 0, sizeof(fds));
+  fds[0].fd = socket_fd_;
+  fds[0].events = POLLIN;
+  fds[1].fd = stop_fd_.get();
+  fds[1].events = POLLIN;
+  while (true) {
+    if (TEMP_FAILURE_RETRY(poll(fds, 2, -1)) < 0) {
+      PLOG(ERROR) << "Failed to poll netlink socket";
+      return;
+    }
+    if (fds[1].revents != 0) {
+      return;
+    }
+    if (!ReceiveDatagrams()) {
+      return;
+    }
+  }
+}
+
+bool NetlinkReceiveThread::ReceiveDatagrams() {
+  while (true) {
+    struct mmsghdr messages[kReceiveBatchSize];
+    struct iovec iovs[kReceiveBatchSize];
+    memset(messages, 0, sizeof(messages));
+    for (size_t i = 0; i < kReceiveBatchSize; i++) {
+      receive_buffers_[i].resize(receive_buffer_size_);
+      iovs[i].iov_base = receive_buffers_[i].data();
+      iovs[i].iov_len = receive_buffers_[i].size();
+      messages[i].msg_hdr.msg_iov = &iovs[i];
+      messages[i].msg_hdr.msg_iovlen = 1;
+    }
+    int num_messages = TEMP_FAILURE_RETRY(recvmmsg(
+        socket_fd_, messages, kReceiveBatchSize, MSG_DONTWAIT, nullptr));
+    if (num_messages == -1) {
+      if (errno == ENOBUFS) {
+        // Datagrams queued after the overrun are still to be read.
+        NetlinkReceiveRecord* record = WaitForSlot();
+        if (record == nullptr) {
+          return false;
+        }
+        record->type = NetlinkReceiveRecord::kOverrun;
+        CommitRecord();
+        continue;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        PLOG(ERROR) << "Failed to read packet from buffer";
+      }
+      Notify();
+      return true;
+    }
+
+    bool truncated = false;
+    for (int i = 0; i < num_messages; i++) {
+      const uint8_t* buffer = receive_buffers_[i].data();
+      size_t len = messages[i].msg_len;
+      if (!(messages[i].msg_hdr.msg_flags & MSG_TRUNC)) {
+        if (!PushMessages(buffer, len)) {
+          return false;
+        }
+        continue;
+      }
+      truncated = true;
+      NetlinkReceiveRecord* record = WaitForSlot();
+      if (record == nullptr) {
+        return false;
+      }
+      record->type = NetlinkReceiveRecord::kTruncated;
+      record->sequence = len >= sizeof(nlmsghdr)
+          ? reinterpret_cast<const nlmsghdr*>(buffer)->nlmsg_seq : 0;
+      CommitRecord();
+    }
+    if (truncated) {
+      receive_buffer_size_ =
+          std::min(receive_buffer_size_ * 2, kMaximumReceiveBufferSize);
+    }
+    // Hand over each batch right away, the event loop can start on it while
+    // the next one is read.
+    Notify();
+    if (static_cast<size_t>(num_messages) < kReceiveBatchSize) {
+      return true;
+    }
+  }
+}
+
+bool NetlinkReceiveThread::PushMessages(const uint8_t* buffer, size_t len) {
+  const uint8_t* ptr = buffer;
+  while (ptr + sizeof(nlmsghdr) <= buffer + len) {
+    const nlmsghdr* nl_header = reinterpret_cast<const nlmsghdr*>(ptr);
+    size_t message_len = std::min(static_cast<size_t>(nl_header->nlmsg_len),
+                                  static_cast<size_t>(buffer + len - ptr));
+    if (!NL80211PacketView(ptr, message_len).IsValid()) {
+      static LogRateLimiter invalid_packet_log_limiter;
+      LOG_RATE_LIMITED(ERROR, invalid_packet_log_limiter)
+          << "Receive invalid packet";
+      break;
+    }
+    NetlinkReceiveRecord* record = WaitForSlot();
+    if (record == nullptr) {
+      return false;
+    }
+    record->type = NetlinkReceiveRecord::kMessage;
+    record->first_in_datagram = ptr == buffer;
+    // The slot keeps the capacity of the message it held before.
+    record->data.assign(ptr, ptr + message_len);
+    CommitRecord();
+    ptr += NLMSG_ALIGN(nl_header->nlmsg_len);
+  }
+  return true;
+}
+
+NetlinkReceiveRecord* NetlinkReceiveThread::WaitForSlot() {
+  NetlinkReceiveRecord* record = ring_.BeginPush();
+  if (record != nullptr) {
+    return record;
+  }
+  // The consumer has to know about the records it is to make room from.
+  Notify();
+  num_ring_full_waits_.fetch_add(1, std::memory_order_relaxed);
+  struct pollfd stop_poll_fd;
+  memset(&stop_poll_fd, 0, sizeof(stop_poll_fd));
+  stop_poll_fd.fd = stop_fd_.get();
+  stop_poll_fd.events = POLLIN;
+  while ((record = ring_.BeginPush()) == nullptr) {
+    if (TEMP_FAILURE_RETRY(poll(&stop_poll_fd, 1, kRingFullWaitMs)) != 0) {
+      return nullptr;
+    }
+  }
+  return record;
+}
+
+void NetlinkReceiveThread::CommitRecord() {
+  ring_.CommitPush();
+  notification_pending_ = true;
+}
+
+void NetlinkReceiveThread::Notify() {
+  if (!notification_pending_) {
+    return;
+  }
+  notification_pending_ = false;
+  uint64_t value = 1;
+  if (TEMP_FAILURE_RETRY(write(notification_fd_.get(), &value,
+                               sizeof(value))) < 0) {
+    PLOG(ERROR) << "Failed to notify netlink records";
+  }
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_NET_NETLINK_RECEIVE_THREAD_H_
+#define WIFICOND_NET_NETLINK_RECEIVE_THREAD_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include <android-base/macros.h>
+#include <android-base/unique_fd.h>
+
+#include "wificond/net/spsc_ring.h"
+
+namespace android {
+namespace wificond {
+
+// What the receive thread found on the socket, in the order it was found.
+struct NetlinkReceiveRecord {
+  enum Type {
+    // |data| holds a netlink message that passed
+    // NL80211PacketView::IsValid(). Messages sharing a datagram get a record
+    // each.
+    kMessage,
+    // A datagram was larger than the receive buffer. |sequence| is the
+    // sequence number in its header, or 0 if not even that was received.
+    kTruncated,
+    // Kernel dropped datagrams because the socket receive buffer overran.
+    kOverrun,
+  };
+  Type type = kMessage;
+  std::vector<uint8_t> data;
+  uint32_t sequence = 0;
+  // Whether this kMessage record holds the first message of its datagram.
+  // The consumer can tell datagram boundaries from it, e.g. to drop the
+  // rest of a datagram like NetlinkManager::RunHandlersForDatagram() does.
+  bool first_in_datagram = false;
+};
+
+// NetlinkReceiveThread drains a netlink socket on a thread of its own, so
+// that kernel events are taken off the socket receive buffer as fast as they
+// arrive, even while the event loop is busy, e.g. serving binder calls.
+// Records are handed over to the event loop through a lock-free ring, and
+// the event loop is woken up through an eventfd it watches.
+// The ring does not grow. When it is full, the thread stops reading until
+// the event loop catches up, and the socket receive buffer absorbs events in
+// the meantime as it does without the thread.
+class NetlinkReceiveThread {
+ public:
+  static constexpr size_t kDefaultRingCapacity = 1024;
+
+  explicit NetlinkReceiveThread(size_t ring_capacity = kDefaultRingCapacity);
+  // Stops the thread.
+  ~NetlinkReceiveThread();
+
+  // Starts draining |socket_fd|, which must outlive the thread.
+  // Returns false if the thread could not be set up.
+  bool Start(int socket_fd);
+  // Waits for the thread to exit. Records that are not consumed yet are
+  // kept.
+  void Stop();
+
+  // File descriptor that is readable while records might be pending.
+  // The consumer watches it, and calls ConsumeRecords() once it is readable.
+  int GetNotificationFd() const { return notification_fd_.get(); }
+  // Runs |handler| on each pending record, oldest first, on the consumer
+  // thread. A record is only valid during its |handler| call.
+  // Returns the number of records handled.
+  size_t ConsumeRecords(
+      const std::function<void(const NetlinkReceiveRecord&)>& handler);
+
+  // Number of times the thread waited for room in the ring.
+  uint32_t GetNumRingFullWaits() const {
+    return num_ring_full_waits_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  void Run();
+  // Reads all datagrams that are queued on the socket into records.
+  // Returns false if the thread is asked to stop while waiting for room.
+  bool ReceiveDatagrams();
+  // Splits datagram |buffer| into message records.
+  bool PushMessages(const uint8_t* buffer, size_t len);
+  // Returns a free slot of the ring, waiting for one if needed, or nullptr
+  // if the thread is asked to stop first.
+  NetlinkReceiveRecord* WaitForSlot();
+  void CommitRecord();
+  void Notify();
+
+  SpscRing<NetlinkReceiveRecord> ring_;
+  int socket_fd_;
+  // eventfd signaling the consumer that records were pushed.
+  android::base::unique_fd notification_fd_;
+  // eventfd asking the thread to exit.
+  android::base::unique_fd stop_fd_;
+  // One buffer per datagram read by recvmmsg(). Only used by the thread.
+  std::vector<std::vector<uint8_t>> receive_buffers_;
+  size_t receive_buffer_size_;
+  // Records were committed since the consumer was last notified.
+  bool notification_pending_;
+  std::atomic<uint32_t> num_ring_full_waits_;
+  std::thread thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(NetlinkReceiveThread);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_NET_NETLINK_RECEIVE_THREAD_H_
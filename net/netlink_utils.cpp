@@ -19,7 +19,6 @@
 #include <array>
 #include <algorithm>
 #include <bitset>
-#include <map>
 #include <string>
 #include <vector>
 
@@ -28,15 +27,15 @@
 
 #include <android-base/logging.h>
 
+#include "wificond/net/channel_set.h"
 #include "wificond/net/kernel-header-latest/nl80211.h"
 #include "wificond/net/mlme_event_handler.h"
+#include "wificond/net/nl80211_attribute_schema.h"
 #include "wificond/net/nl80211_packet.h"
 
 using std::array;
 using std::make_pair;
 using std::make_unique;
-using std::map;
-using std::move;
 using std::pair;
 using std::string;
 using std::unique_ptr;
@@ -87,8 +86,40 @@ bool IsExtFeatureFlagSet(
       ext_feature_flags_bytes[ext_feature_flag_byte_pos];
   return (ext_feature_flag_byte & (1U << ext_feature_flag_bit_pos));
 }
+
+// Fields of NL80211_ATTR_STA_INFO read by GetStationInfo().
+// Missing bitrates are reported as 0, i.e. invalid, rather than failing the
+// whole request.
+struct StationInfoFields {
+  int32_t tx_good = 0;
+  int32_t tx_bad = 0;
+  int8_t current_rssi = 0;
+  uint32_t tx_bitrate = 0;
+  uint32_t rx_bitrate = 0;
+};
+
+constexpr auto kStationTxBitrateSchema = MakeNL80211AttrSchema(
+    NL80211ValueField<&StationInfoFields::tx_bitrate>(
+        NL80211_RATE_INFO_BITRATE32));
+
+constexpr auto kStationRxBitrateSchema = MakeNL80211AttrSchema(
+    NL80211ValueField<&StationInfoFields::rx_bitrate>(
+        NL80211_RATE_INFO_BITRATE32));
+
+constexpr auto kStationInfoSchema = MakeNL80211AttrSchema(
+    NL80211ValueField<&StationInfoFields::tx_good>(
+        NL80211_STA_INFO_TX_PACKETS, true),
+    NL80211ValueField<&StationInfoFields::tx_bad>(
+        NL80211_STA_INFO_TX_FAILED, true),
+    NL80211ValueField<&StationInfoFields::current_rssi>(
+        NL80211_STA_INFO_SIGNAL, true),
+    NL80211NestedField<kStationTxBitrateSchema>(NL80211_STA_INFO_TX_BITRATE),
+    NL80211NestedField<kStationRxBitrateSchema>(NL80211_STA_INFO_RX_BITRATE));
+
 }  // namespace
 
+constexpr size_t NetlinkUtils::kMaxCommandRepliesSize;
+
 WiphyFeatures::WiphyFeatures(uint32_t feature_flags,
                              const std::vector<uint8_t>& ext_feature_flags_bytes)
     : supports_random_mac_oneshot_scan(
@@ -133,7 +164,7 @@ bool NetlinkUtils::GetWiphyIndex(uint32_t* out_wiphy_index,
   get_wiphy.AddFlag(NLM_F_DUMP);
   if (!iface_name.empty()) {
     int ifindex = if_nametoindex(iface_name.c_str());
-    get_wiphy.AddAttribute(NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, ifindex));
+    get_wiphy.AddAttributeValue<uint32_t>(NL80211_ATTR_IFINDEX, ifindex);
   }
   vector<unique_ptr<const NL80211Packet>> response;
   if (!netlink_manager_->SendMessageAndGetResponses(get_wiphy, &response))  {
@@ -182,8 +213,7 @@ bool NetlinkUtils::GetInterfaces(uint32_t wiphy_index,
       getpid());
 
   get_interfaces.AddFlag(NLM_F_DUMP);
-  get_interfaces.AddAttribute(
-      NL80211Attr<uint32_t>(NL80211_ATTR_WIPHY, wiphy_index));
+  get_interfaces.AddAttributeValue<uint32_t>(NL80211_ATTR_WIPHY, wiphy_index);
   vector<unique_ptr<const NL80211Packet>> response;
   if (!netlink_manager_->SendMessageAndGetResponses(get_interfaces, &response)) {
     LOG(ERROR) << "NL80211_CMD_GET_INTERFACE dump failed";
@@ -244,6 +274,35 @@ bool NetlinkUtils::GetInterfaces(uint32_t wiphy_index,
   return true;
 }
 
+bool NetlinkUtils::GetInterfaceFrequency(uint32_t interface_index,
+                                         uint32_t* out_frequency) {
+  NL80211Packet get_interface(
+      netlink_manager_->GetFamilyId(),
+      NL80211_CMD_GET_INTERFACE,
+      netlink_manager_->GetSequenceNumber(),
+      getpid());
+  get_interface.AddAttributeValue<uint32_t>(NL80211_ATTR_IFINDEX,
+                                            interface_index);
+  unique_ptr<const NL80211Packet> response;
+  if (!netlink_manager_->SendMessageAndGetSingleResponse(get_interface,
+                                                         &response)) {
+    LOG(ERROR) << "NL80211_CMD_GET_INTERFACE failed";
+    return false;
+  }
+  if (response->GetCommand() != NL80211_CMD_NEW_INTERFACE) {
+    LOG(ERROR) << "Wrong command in response to a get interface request: "
+               << static_cast<int>(response->GetCommand());
+    return false;
+  }
+  // Kernel only reports the frequency while the interface is on a channel.
+  if (!response->GetAttributeValue(NL80211_ATTR_WIPHY_FREQ, out_frequency)) {
+    LOG(DEBUG) << "No NL80211_ATTR_WIPHY_FREQ for interface "
+               << interface_index;
+    return false;
+  }
+  return true;
+}
+
 bool NetlinkUtils::SetInterfaceMode(uint32_t interface_index,
                                     InterfaceMode mode) {
   uint32_t set_to_mode = NL80211_IFTYPE_UNSPECIFIED;
@@ -262,10 +321,10 @@ bool NetlinkUtils::SetInterfaceMode(uint32_t interface_index,
   // Force an ACK response upon success.
   set_interface_mode.AddFlag(NLM_F_ACK);
 
-  set_interface_mode.AddAttribute(
-      NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, interface_index));
-  set_interface_mode.AddAttribute(
-      NL80211Attr<uint32_t>(NL80211_ATTR_IFTYPE, set_to_mode));
+  set_interface_mode.AddAttributeValue<uint32_t>(NL80211_ATTR_IFINDEX,
+                                                 interface_index);
+  set_interface_mode.AddAttributeValue<uint32_t>(NL80211_ATTR_IFTYPE,
+                                                 set_to_mode);
 
   if (!netlink_manager_->SendMessageAndGetAck(set_interface_mode)) {
     LOG(ERROR) << "NL80211_CMD_SET_INTERFACE failed";
@@ -275,6 +334,59 @@ bool NetlinkUtils::SetInterfaceMode(uint32_t interface_index,
   return true;
 }
 
+bool NetlinkUtils::SetCqmRssiConfig(uint32_t interface_index,
+                                    int32_t rssi_threshold_dbm,
+                                    uint32_t rssi_hysteresis_db) {
+  NL80211Packet set_cqm(
+      netlink_manager_->GetFamilyId(),
+      NL80211_CMD_SET_CQM,
+      netlink_manager_->GetSequenceNumber(),
+      getpid());
+  // Force an ACK response upon success.
+  set_cqm.AddFlag(NLM_F_ACK);
+
+  set_cqm.AddAttributeValue<uint32_t>(NL80211_ATTR_IFINDEX, interface_index);
+  size_t cqm = set_cqm.BeginNestedAttribute(NL80211_ATTR_CQM);
+  set_cqm.AddAttributeValue<int32_t>(NL80211_ATTR_CQM_RSSI_THOLD,
+                                     rssi_threshold_dbm);
+  set_cqm.AddAttributeValue<uint32_t>(NL80211_ATTR_CQM_RSSI_HYST,
+                                      rssi_hysteresis_db);
+  set_cqm.EndNestedAttribute(cqm);
+
+  if (!netlink_manager_->SendMessageAndGetAck(set_cqm)) {
+    LOG(ERROR) << "NL80211_CMD_SET_CQM for RSSI failed";
+    return false;
+  }
+  return true;
+}
+
+bool NetlinkUtils::SetCqmTxErrorConfig(uint32_t interface_index,
+                                       uint32_t rate_percent,
+                                       uint32_t packets,
+                                       uint32_t interval_seconds) {
+  NL80211Packet set_cqm(
+      netlink_manager_->GetFamilyId(),
+      NL80211_CMD_SET_CQM,
+      netlink_manager_->GetSequenceNumber(),
+      getpid());
+  // Force an ACK response upon success.
+  set_cqm.AddFlag(NLM_F_ACK);
+
+  set_cqm.AddAttributeValue<uint32_t>(NL80211_ATTR_IFINDEX, interface_index);
+  size_t cqm = set_cqm.BeginNestedAttribute(NL80211_ATTR_CQM);
+  set_cqm.AddAttributeValue<uint32_t>(NL80211_ATTR_CQM_TXE_RATE, rate_percent);
+  set_cqm.AddAttributeValue<uint32_t>(NL80211_ATTR_CQM_TXE_PKTS, packets);
+  set_cqm.AddAttributeValue<uint32_t>(NL80211_ATTR_CQM_TXE_INTVL,
+                                      interval_seconds);
+  set_cqm.EndNestedAttribute(cqm);
+
+  if (!netlink_manager_->SendMessageAndGetAck(set_cqm)) {
+    LOG(ERROR) << "NL80211_CMD_SET_CQM for tx errors failed";
+    return false;
+  }
+  return true;
+}
+
 bool NetlinkUtils::GetProtocolFeatures(uint32_t* features) {
   NL80211Packet get_protocol_features(
       netlink_manager_->GetFamilyId(),
@@ -304,7 +416,7 @@ bool NetlinkUtils::GetWiphyInfo(
       NL80211_CMD_GET_WIPHY,
       netlink_manager_->GetSequenceNumber(),
       getpid());
-  get_wiphy.AddAttribute(NL80211Attr<uint32_t>(NL80211_ATTR_WIPHY, wiphy_index));
+  get_wiphy.AddAttributeValue<uint32_t>(NL80211_ATTR_WIPHY, wiphy_index);
   if (supports_split_wiphy_dump_) {
     get_wiphy.AddFlagAttribute(NL80211_ATTR_SPLIT_WIPHY_DUMP);
     get_wiphy.AddFlag(NLM_F_DUMP);
@@ -315,25 +427,19 @@ bool NetlinkUtils::GetWiphyInfo(
     return false;
   }
 
-  vector<NL80211Packet> packet_per_wiphy;
   if (supports_split_wiphy_dump_) {
-    if (!MergePacketsForSplitWiphyDump(response, &packet_per_wiphy)) {
-      LOG(WARNING) << "Failed to merge responses from split wiphy dump";
-    }
-  } else {
-    for (auto& packet : response) {
-      packet_per_wiphy.push_back(move(*(packet.release())));
-    }
+    return ParseSplitWiphyDump(response, wiphy_index, out_band_info,
+                               out_scan_capabilities, out_wiphy_features);
   }
 
-  for (const auto& packet : packet_per_wiphy) {
+  for (const auto& packet : response) {
     uint32_t current_wiphy_index;
-    if (!packet.GetAttributeValue(NL80211_ATTR_WIPHY, &current_wiphy_index) ||
+    if (!packet->GetAttributeValue(NL80211_ATTR_WIPHY, &current_wiphy_index) ||
         // Not the wihpy we requested.
         current_wiphy_index != wiphy_index) {
       continue;
     }
-    if (ParseWiphyInfoFromPacket(packet, out_band_info,
+    if (ParseWiphyInfoFromPacket(*packet, out_band_info,
                                  out_scan_capabilities, out_wiphy_features)) {
       return true;
     }
@@ -427,13 +533,18 @@ bool NetlinkUtils::ParseBandInfo(const NL80211Packet* const packet,
     LOG(ERROR) << "Failed to get NL80211_ATTR_WIPHY_BANDS";
     return false;
   }
+  *out_band_info = BandInfo();
+  return AppendBandInfo(bands_attr, out_band_info);
+}
+
+bool NetlinkUtils::AppendBandInfo(const NL80211NestedAttr& bands_attr,
+                                  BandInfo* out_band_info) {
   vector<NL80211NestedAttr> bands;
   if (!bands_attr.GetListOfNestedAttributes(&bands)) {
     LOG(ERROR) << "Failed to get bands within NL80211_ATTR_WIPHY_BANDS";
     return false;
   }
 
-  *out_band_info = BandInfo();
   for (auto& band : bands) {
     NL80211NestedAttr freqs_attr(0);
     if (band.GetAttribute(NL80211_BAND_ATTR_FREQS, &freqs_attr)) {
@@ -493,6 +604,7 @@ void NetlinkUtils::handleBandFreqAttributes(const NL80211NestedAttr& freqs_attr,
     }
     // Channel is disabled in current regulatory domain.
     if (freq.HasAttribute(NL80211_FREQUENCY_ATTR_DISABLED)) {
+      out_band_info->band_disabled.push_back(frequency_value);
       continue;
     }
 
@@ -679,10 +791,10 @@ bool NetlinkUtils::GetStationInfo(uint32_t interface_index,
       NL80211_CMD_GET_STATION,
       netlink_manager_->GetSequenceNumber(),
       getpid());
-  get_station.AddAttribute(NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX,
-                                                 interface_index));
-  get_station.AddAttribute(NL80211Attr<array<uint8_t, ETH_ALEN>>(
-      NL80211_ATTR_MAC, mac_address));
+  get_station.AddAttributeValue<uint32_t>(NL80211_ATTR_IFINDEX,
+                                          interface_index);
+  get_station.AddAttributeBytes(NL80211_ATTR_MAC, mac_address.data(),
+                                mac_address.size());
 
   unique_ptr<const NL80211Packet> response;
   if (!netlink_manager_->SendMessageAndGetSingleResponse(get_station,
@@ -695,101 +807,275 @@ bool NetlinkUtils::GetStationInfo(uint32_t interface_index,
                << static_cast<int>(response->GetCommand());
     return false;
   }
-  NL80211NestedAttr sta_info(0);
-  if (!response->GetAttribute(NL80211_ATTR_STA_INFO, &sta_info)) {
+  const uint8_t* sta_info;
+  size_t sta_info_length;
+  if (!response->GetAttributePayload(NL80211_ATTR_STA_INFO,
+                                     &sta_info,
+                                     &sta_info_length)) {
     LOG(ERROR) << "Failed to get NL80211_ATTR_STA_INFO";
     return false;
   }
-  int32_t tx_good, tx_bad;
-  if (!sta_info.GetAttributeValue(NL80211_STA_INFO_TX_PACKETS, &tx_good)) {
-    LOG(ERROR) << "Failed to get NL80211_STA_INFO_TX_PACKETS";
+  StationInfoFields fields;
+  if (!kStationInfoSchema.Decode(sta_info, sta_info_length, &fields)) {
+    LOG(ERROR) << "Failed to get NL80211_STA_INFO_TX_PACKETS, "
+               << "NL80211_STA_INFO_TX_FAILED or NL80211_STA_INFO_SIGNAL";
     return false;
   }
-  if (!sta_info.GetAttributeValue(NL80211_STA_INFO_TX_FAILED, &tx_bad)) {
-    LOG(ERROR) << "Failed to get NL80211_STA_INFO_TX_FAILED";
+  *out_station_info = StationInfo(fields.tx_good, fields.tx_bad,
+                                  fields.tx_bitrate, fields.current_rssi,
+                                  fields.rx_bitrate);
+  return true;
+}
+
+bool NetlinkUtils::GetStationList(
+    uint32_t interface_index,
+    vector<array<uint8_t, ETH_ALEN>>* out_mac_addresses) {
+  NL80211Packet get_station(
+      netlink_manager_->GetFamilyId(),
+      NL80211_CMD_GET_STATION,
+      netlink_manager_->GetSequenceNumber(),
+      getpid());
+  get_station.AddFlag(NLM_F_DUMP);
+  get_station.AddAttributeValue<uint32_t>(NL80211_ATTR_IFINDEX,
+                                          interface_index);
+  vector<unique_ptr<const NL80211Packet>> response;
+  if (!netlink_manager_->SendMessageAndGetResponses(get_station, &response)) {
+    LOG(ERROR) << "NL80211_CMD_GET_STATION dump failed";
     return false;
   }
-  int8_t current_rssi;
-  if (!sta_info.GetAttributeValue(NL80211_STA_INFO_SIGNAL, &current_rssi)) {
-    LOG(ERROR) << "Failed to get NL80211_STA_INFO_SIGNAL";
+  out_mac_addresses->clear();
+  for (auto& packet : response) {
+    if (packet->GetMessageType() == NLMSG_ERROR) {
+      LOG(ERROR) << "Receive ERROR message: "
+                 << strerror(packet->GetErrorCode());
+      return false;
+    }
+    if (packet->GetMessageType() != netlink_manager_->GetFamilyId()) {
+      LOG(ERROR) << "Wrong message type for new station message: "
+                 << packet->GetMessageType();
+      return false;
+    }
+    if (packet->GetCommand() != NL80211_CMD_NEW_STATION) {
+      LOG(ERROR) << "Wrong command in response to a station dump request: "
+                 << static_cast<int>(packet->GetCommand());
+      return false;
+    }
+    array<uint8_t, ETH_ALEN> mac_address;
+    if (!packet->GetAttributeValue(NL80211_ATTR_MAC, &mac_address)) {
+      LOG(ERROR) << "Failed to get station mac address";
+      return false;
+    }
+    out_mac_addresses->push_back(mac_address);
+  }
+  return true;
+}
+
+bool NetlinkUtils::GetStationStatsList(
+    uint32_t interface_index,
+    vector<StationStats>* out_station_stats) {
+  NL80211Packet get_station(
+      netlink_manager_->GetFamilyId(),
+      NL80211_CMD_GET_STATION,
+      netlink_manager_->GetSequenceNumber(),
+      getpid());
+  get_station.AddFlag(NLM_F_DUMP);
+  get_station.AddAttributeValue<uint32_t>(NL80211_ATTR_IFINDEX,
+                                          interface_index);
+  vector<unique_ptr<const NL80211Packet>> response;
+  if (!netlink_manager_->SendMessageAndGetResponses(get_station, &response)) {
+    LOG(ERROR) << "NL80211_CMD_GET_STATION dump failed";
     return false;
   }
-  NL80211NestedAttr tx_bitrate_attr(0);
-  uint32_t tx_bitrate = 0;
-  if (sta_info.GetAttribute(NL80211_STA_INFO_TX_BITRATE,
-                            &tx_bitrate_attr)) {
-    if (!tx_bitrate_attr.GetAttributeValue(NL80211_RATE_INFO_BITRATE32,
-                                         &tx_bitrate)) {
-      // Return invalid tx rate to avoid breaking the get station cmd
-      tx_bitrate = 0;
+  out_station_stats->clear();
+  for (auto& packet : response) {
+    if (packet->GetMessageType() == NLMSG_ERROR) {
+      LOG(ERROR) << "Receive ERROR message: "
+                 << strerror(packet->GetErrorCode());
+      return false;
+    }
+    if (packet->GetMessageType() != netlink_manager_->GetFamilyId()) {
+      LOG(ERROR) << "Wrong message type for new station message: "
+                 << packet->GetMessageType();
+      return false;
     }
+    if (packet->GetCommand() != NL80211_CMD_NEW_STATION) {
+      LOG(ERROR) << "Wrong command in response to a station dump request: "
+                 << static_cast<int>(packet->GetCommand());
+      return false;
+    }
+    StationStats station_stats;
+    if (!packet->GetAttributeValue(NL80211_ATTR_MAC,
+                                   &station_stats.mac_address)) {
+      LOG(ERROR) << "Failed to get station mac address";
+      return false;
+    }
+    NL80211NestedAttr sta_info(0);
+    if (packet->GetAttribute(NL80211_ATTR_STA_INFO, &sta_info)) {
+      // Older kernels only report 32 bit byte counters.
+      if (!sta_info.GetAttributeValue(NL80211_STA_INFO_RX_BYTES64,
+                                      &station_stats.rx_bytes)) {
+        uint32_t rx_bytes = 0;
+        sta_info.GetAttributeValue(NL80211_STA_INFO_RX_BYTES, &rx_bytes);
+        station_stats.rx_bytes = rx_bytes;
+      }
+      if (!sta_info.GetAttributeValue(NL80211_STA_INFO_TX_BYTES64,
+                                      &station_stats.tx_bytes)) {
+        uint32_t tx_bytes = 0;
+        sta_info.GetAttributeValue(NL80211_STA_INFO_TX_BYTES, &tx_bytes);
+        station_stats.tx_bytes = tx_bytes;
+      }
+      sta_info.GetAttributeValue(NL80211_STA_INFO_SIGNAL,
+                                 &station_stats.signal_dbm);
+      sta_info.GetAttributeValue(NL80211_STA_INFO_INACTIVE_TIME,
+                                 &station_stats.inactive_time_ms);
+      sta_info.GetAttributeValue(NL80211_STA_INFO_CONNECTED_TIME,
+                                 &station_stats.connected_time_s);
+    }
+    out_station_stats->push_back(station_stats);
   }
-  NL80211NestedAttr rx_bitrate_attr(0);
-  uint32_t rx_bitrate = 0;
-  if (sta_info.GetAttribute(NL80211_STA_INFO_RX_BITRATE,
-                            &rx_bitrate_attr)) {
-    if (!rx_bitrate_attr.GetAttributeValue(NL80211_RATE_INFO_BITRATE32,
-                                         &rx_bitrate)) {
-      // Return invalid rx rate to avoid breaking the get station cmd
-      rx_bitrate = 0;
+  return true;
+}
+
+bool NetlinkUtils::GetChannelSurveys(
+    uint32_t interface_index,
+    vector<ChannelSurvey>* out_surveys) {
+  NL80211Packet get_survey(
+      netlink_manager_->GetFamilyId(),
+      NL80211_CMD_GET_SURVEY,
+      netlink_manager_->GetSequenceNumber(),
+      getpid());
+  get_survey.AddFlag(NLM_F_DUMP);
+  get_survey.AddAttributeValue<uint32_t>(NL80211_ATTR_IFINDEX,
+                                         interface_index);
+  vector<unique_ptr<const NL80211Packet>> response;
+  if (!netlink_manager_->SendMessageAndGetResponses(get_survey, &response)) {
+    LOG(ERROR) << "NL80211_CMD_GET_SURVEY dump failed";
+    return false;
+  }
+  out_surveys->clear();
+  for (auto& packet : response) {
+    if (packet->GetMessageType() == NLMSG_ERROR) {
+      LOG(ERROR) << "Receive ERROR message: "
+                 << strerror(packet->GetErrorCode());
+      return false;
+    }
+    if (packet->GetMessageType() != netlink_manager_->GetFamilyId()) {
+      LOG(ERROR) << "Wrong message type for new survey message: "
+                 << packet->GetMessageType();
+      return false;
     }
+    if (packet->GetCommand() != NL80211_CMD_NEW_SURVEY_RESULTS) {
+      LOG(ERROR) << "Wrong command in response to a survey dump request: "
+                 << static_cast<int>(packet->GetCommand());
+      return false;
+    }
+    NL80211NestedAttr survey_info(0);
+    if (!packet->GetAttribute(NL80211_ATTR_SURVEY_INFO, &survey_info)) {
+      LOG(ERROR) << "Failed to get survey info";
+      return false;
+    }
+    ChannelSurvey survey;
+    if (!survey_info.GetAttributeValue(NL80211_SURVEY_INFO_FREQUENCY,
+                                       &survey.frequency)) {
+      LOG(ERROR) << "Failed to get survey frequency";
+      return false;
+    }
+    survey.in_use = survey_info.HasAttribute(NL80211_SURVEY_INFO_IN_USE);
+    // The noise level is a u8 attribute that holds a signed dBm value.
+    survey.has_noise = survey_info.GetAttributeValue(
+        NL80211_SURVEY_INFO_NOISE, &survey.noise_dbm);
+    survey_info.GetAttributeValue(NL80211_SURVEY_INFO_TIME,
+                                  &survey.active_time_ms);
+    survey_info.GetAttributeValue(NL80211_SURVEY_INFO_TIME_BUSY,
+                                  &survey.busy_time_ms);
+    survey_info.GetAttributeValue(NL80211_SURVEY_INFO_TIME_RX,
+                                  &survey.rx_time_ms);
+    survey_info.GetAttributeValue(NL80211_SURVEY_INFO_TIME_TX,
+                                  &survey.tx_time_ms);
+    out_surveys->push_back(survey);
   }
-  *out_station_info = StationInfo(tx_good, tx_bad, tx_bitrate, current_rssi, rx_bitrate);
   return true;
 }
 
-// This is a helper function for merging split NL80211_CMD_NEW_WIPHY packets.
-// For example:
-// First NL80211_CMD_NEW_WIPHY has attribute A with payload 0x1234.
-// Second NL80211_CMD_NEW_WIPHY has attribute A with payload 0x5678.
-// The generated NL80211_CMD_NEW_WIPHY will have attribute A with
-// payload 0x12345678.
-// NL80211_ATTR_WIPHY, NL80211_ATTR_IFINDEX, and NL80211_ATTR_WDEV
-// are used for filtering packets so we know which packets should
-// be merged together.
-bool NetlinkUtils::MergePacketsForSplitWiphyDump(
+// A split wiphy dump spreads the attributes of a wiphy over several
+// NL80211_CMD_NEW_WIPHY messages. Bands, and the frequencies within a band,
+// may be cut into several fragments, each carried by its own
+// NL80211_ATTR_WIPHY_BANDS attribute. Every band fragment is parsed as it
+// comes, since parsing a band only ever adds to |BandInfo|. Other attributes
+// are only sent once, by one of the messages.
+// Messages are parsed in place, rather than merged into a single packet
+// first, so that the cost stays linear in the number of messages.
+bool NetlinkUtils::ParseSplitWiphyDump(
     const vector<unique_ptr<const NL80211Packet>>& split_dump_info,
-    vector<NL80211Packet>* packet_per_wiphy) {
-  map<uint32_t, map<int, BaseNL80211Attr>> attr_by_wiphy_and_id;
+    uint32_t wiphy_index,
+    BandInfo* out_band_info,
+    ScanCapabilities* out_scan_capabilities,
+    WiphyFeatures* out_wiphy_features) {
+  BandInfo band_info;
+  bool has_bands = false;
+  bool has_scan_capabilities = false;
+  bool has_feature_flags = false;
+  uint32_t feature_flags = 0;
+  vector<uint8_t> ext_feature_flags_bytes;
 
-  // Construct the map using input packets.
   for (const auto& packet : split_dump_info) {
-    uint32_t wiphy_index;
-    if (!packet->GetAttributeValue(NL80211_ATTR_WIPHY, &wiphy_index)) {
+    uint32_t current_wiphy_index;
+    if (!packet->GetAttributeValue(NL80211_ATTR_WIPHY, &current_wiphy_index)) {
       LOG(ERROR) << "Failed to get NL80211_ATTR_WIPHY from wiphy split dump";
-      return false;
+      continue;
     }
-    vector<BaseNL80211Attr> attributes;
-    if (!packet->GetAllAttributes(&attributes)) {
+    // Not the wihpy we requested.
+    if (current_wiphy_index != wiphy_index) {
+      continue;
+    }
+    if (packet->GetCommand() != NL80211_CMD_NEW_WIPHY) {
+      LOG(ERROR) << "Wrong command in response to a get wiphy request: "
+                 << static_cast<int>(packet->GetCommand());
       return false;
     }
-    for (auto& attr : attributes) {
-      int attr_id = attr.GetAttributeId();
-      if (attr_id != NL80211_ATTR_WIPHY &&
-          attr_id != NL80211_ATTR_IFINDEX &&
-              attr_id != NL80211_ATTR_WDEV) {
-          auto attr_id_and_attr =
-              attr_by_wiphy_and_id[wiphy_index].find(attr_id);
-          if (attr_id_and_attr == attr_by_wiphy_and_id[wiphy_index].end()) {
-            attr_by_wiphy_and_id[wiphy_index].
-                insert(make_pair(attr_id, move(attr)));
-          } else {
-            attr_id_and_attr->second.Merge(attr);
-          }
+    NL80211NestedAttr bands_attr(0);
+    if (packet->GetAttribute(NL80211_ATTR_WIPHY_BANDS, &bands_attr)) {
+      if (!AppendBandInfo(bands_attr, &band_info)) {
+        return false;
+      }
+      has_bands = true;
+    }
+    if (!has_scan_capabilities &&
+        packet->HasAttribute(NL80211_ATTR_MAX_NUM_SCAN_SSIDS)) {
+      if (!ParseScanCapabilities(packet.get(), out_scan_capabilities)) {
+        return false;
       }
+      has_scan_capabilities = true;
+    }
+    if (!has_feature_flags &&
+        packet->GetAttributeValue(NL80211_ATTR_FEATURE_FLAGS,
+                                  &feature_flags)) {
+      has_feature_flags = true;
+    }
+    if (ext_feature_flags_bytes.empty()) {
+      packet->GetAttributeValue(NL80211_ATTR_EXT_FEATURES,
+                                &ext_feature_flags_bytes);
     }
   }
 
-  // Generate output packets using the constructed map.
-  for (const auto& wiphy_and_attributes : attr_by_wiphy_and_id) {
-    NL80211Packet new_wiphy(0, NL80211_CMD_NEW_WIPHY, 0, 0);
-    new_wiphy.AddAttribute(
-        NL80211Attr<uint32_t>(NL80211_ATTR_WIPHY, wiphy_and_attributes.first));
-    for (const auto& attr : wiphy_and_attributes.second) {
-      new_wiphy.AddAttribute(attr.second);
-    }
-    packet_per_wiphy->emplace_back(move(new_wiphy));
+  if (!has_bands) {
+    LOG(ERROR) << "Failed to get NL80211_ATTR_WIPHY_BANDS";
+    return false;
+  }
+  if (!has_scan_capabilities) {
+    LOG(ERROR) << "Failed to get the capacity of maximum number of scan ssids";
+    return false;
+  }
+  if (!has_feature_flags) {
+    LOG(ERROR) << "Failed to get NL80211_ATTR_FEATURE_FLAGS";
+    return false;
   }
+  if (ext_feature_flags_bytes.empty()) {
+    LOG(WARNING) << "Failed to get NL80211_ATTR_EXT_FEATURES";
+  }
+  *out_band_info = std::move(band_info);
+  *out_wiphy_features = WiphyFeatures(feature_flags,
+                                      ext_feature_flags_bytes);
   return true;
 }
 
@@ -812,6 +1098,108 @@ bool NetlinkUtils::GetCountryCode(string* out_country_code) {
   return true;
 }
 
+bool NetlinkUtils::GetRegDomain(RegDomain* out_reg_domain) {
+  NL80211Packet get_reg(
+      netlink_manager_->GetFamilyId(),
+      NL80211_CMD_GET_REG,
+      netlink_manager_->GetSequenceNumber(),
+      getpid());
+  unique_ptr<const NL80211Packet> response;
+  if (!netlink_manager_->SendMessageAndGetSingleResponse(get_reg,
+                                                         &response)) {
+    LOG(ERROR) << "NL80211_CMD_GET_REG failed";
+    return false;
+  }
+  RegDomain reg_domain;
+  if (!response->GetAttributeValue(NL80211_ATTR_REG_ALPHA2,
+                                   &reg_domain.country_code)) {
+    LOG(ERROR) << "Get NL80211_ATTR_REG_ALPHA2 failed";
+    return false;
+  }
+  NL80211NestedAttr rules_attr(0);
+  vector<NL80211NestedAttr> rules;
+  if (!response->GetAttribute(NL80211_ATTR_REG_RULES, &rules_attr) ||
+      !rules_attr.GetListOfNestedAttributes(&rules)) {
+    LOG(WARNING) << "Failed to get NL80211_ATTR_REG_RULES";
+  }
+  for (const auto& rule_attr : rules) {
+    RegRule rule;
+    if (!rule_attr.GetAttributeValue(NL80211_ATTR_FREQ_RANGE_START,
+                                     &rule.start_freq_khz) ||
+        !rule_attr.GetAttributeValue(NL80211_ATTR_FREQ_RANGE_END,
+                                     &rule.end_freq_khz)) {
+      LOG(WARNING) << "Ignoring regulatory rule without frequency range";
+      continue;
+    }
+    rule_attr.GetAttributeValue(NL80211_ATTR_FREQ_RANGE_MAX_BW,
+                                &rule.max_bandwidth_khz);
+    rule_attr.GetAttributeValue(NL80211_ATTR_REG_RULE_FLAGS, &rule.flags);
+    reg_domain.rules.push_back(rule);
+  }
+  *out_reg_domain = std::move(reg_domain);
+  return true;
+}
+
+bool NetlinkUtils::ApplyRegDomain(const RegDomain& reg_domain,
+                                  BandInfo* band_info) {
+  // Channel lists come from a wiphy dump, whose per channel flags also
+  // reflect restrictions of the driver that the rules do not tell. So a
+  // restricted channel is never lifted here.
+  const ChannelSet disabled(band_info->band_disabled);
+  const ChannelSet dfs(band_info->band_dfs);
+  ChannelSet frequencies = disabled | dfs;
+  for (const auto* band : {&band_info->band_2g, &band_info->band_5g,
+                           &band_info->band_6g}) {
+    frequencies |= ChannelSet(*band);
+  }
+  band_info->band_2g.clear();
+  band_info->band_5g.clear();
+  band_info->band_dfs.clear();
+  band_info->band_6g.clear();
+  band_info->band_disabled.clear();
+
+  // Like kernel, a channel is allowed if a rule covers all of its 20MHz.
+  constexpr uint32_t kHalfChannelWidthKhz = 10000;
+  bool exact = true;
+  frequencies.ForEach([&reg_domain, &disabled, &dfs, &exact, band_info](
+      uint32_t frequency) {
+    const uint32_t frequency_khz = frequency * 1000;
+    const RegRule* rule = nullptr;
+    for (const auto& candidate : reg_domain.rules) {
+      if (candidate.start_freq_khz + kHalfChannelWidthKhz <= frequency_khz &&
+          frequency_khz + kHalfChannelWidthKhz <= candidate.end_freq_khz) {
+        rule = &candidate;
+        break;
+      }
+    }
+    if (disabled.Contains(frequency)) {
+      band_info->band_disabled.push_back(frequency);
+      exact = exact && rule == nullptr;
+    } else if (rule == nullptr) {
+      band_info->band_disabled.push_back(frequency);
+    } else if (frequency > k2GHzFrequencyLowerBound &&
+        frequency < k2GHzFrequencyUpperBound) {
+      band_info->band_2g.push_back(frequency);
+    } else if (frequency > k5GHzFrequencyLowerBound &&
+        frequency <= k5GHzFrequencyUpperBound) {
+      // Like handleBandFreqAttributes(), put passive-only channels into the
+      // dfs category too.
+      const bool rule_restricts =
+          (rule->flags & (NL80211_RRF_DFS | NL80211_RRF_NO_IR)) != 0;
+      if (rule_restricts || dfs.Contains(frequency)) {
+        band_info->band_dfs.push_back(frequency);
+        exact = exact && rule_restricts;
+      } else {
+        band_info->band_5g.push_back(frequency);
+      }
+    } else if (frequency > k6GHzFrequencyLowerBound &&
+        frequency < k6GHzFrequencyUpperBound) {
+      band_info->band_6g.push_back(frequency);
+    }
+  });
+  return exact;
+}
+
 bool NetlinkUtils::SendMgmtFrame(uint32_t interface_index,
     const vector<uint8_t>& frame, int32_t mcs, uint64_t* out_cookie) {
 
@@ -821,11 +1209,11 @@ bool NetlinkUtils::SendMgmtFrame(uint32_t interface_index,
       netlink_manager_->GetSequenceNumber(),
       getpid());
 
-  send_mgmt_frame.AddAttribute(
-      NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, interface_index));
+  send_mgmt_frame.AddAttributeValue<uint32_t>(NL80211_ATTR_IFINDEX,
+                                              interface_index);
 
-  send_mgmt_frame.AddAttribute(
-      NL80211Attr<vector<uint8_t>>(NL80211_ATTR_FRAME, frame));
+  send_mgmt_frame.AddAttributeBytes(NL80211_ATTR_FRAME, frame.data(),
+                                    frame.size());
 
   if (mcs >= 0) {
     // TODO (b/112029045) if mcs >= 0, add MCS attribute
@@ -846,6 +1234,78 @@ bool NetlinkUtils::SendMgmtFrame(uint32_t interface_index,
   return true;
 }
 
+bool NetlinkUtils::SendCommandAsync(uint32_t interface_index,
+                                    uint8_t command,
+                                    uint16_t flags,
+                                    const vector<uint8_t>& attributes,
+                                    OnCommandRepliesHandler handler) {
+  // Walk the top level attributes, so that a malformed stream can't spill
+  // into the header of the next message or target another interface.
+  size_t offset = 0;
+  while (offset < attributes.size()) {
+    if (attributes.size() - offset < NLA_HDRLEN) {
+      LOG(ERROR) << "Truncated attribute header in command " << int(command);
+      return false;
+    }
+    const nlattr* header =
+        reinterpret_cast<const nlattr*>(attributes.data() + offset);
+    if (header->nla_len < NLA_HDRLEN ||
+        header->nla_len > attributes.size() - offset) {
+      LOG(ERROR) << "Invalid attribute length in command " << int(command);
+      return false;
+    }
+    uint16_t type = header->nla_type & NLA_TYPE_MASK;
+    if (type == NL80211_ATTR_IFINDEX || type == NL80211_ATTR_WDEV ||
+        type == NL80211_ATTR_WIPHY) {
+      LOG(ERROR) << "Command " << int(command)
+                 << " must not name a device of its own";
+      return false;
+    }
+    offset += NLA_ALIGN(header->nla_len);
+  }
+  if (offset != attributes.size()) {
+    LOG(ERROR) << "Unpadded attributes in command " << int(command);
+    return false;
+  }
+
+  NL80211Packet header(
+      netlink_manager_->GetFamilyId(),
+      command,
+      netlink_manager_->GetSequenceNumber(),
+      getpid());
+  header.AddFlag(flags);
+  header.AddAttributeValue<uint32_t>(NL80211_ATTR_IFINDEX, interface_index);
+
+  vector<uint8_t> data(header.GetConstData());
+  data.insert(data.end(), attributes.begin(), attributes.end());
+  reinterpret_cast<nlmsghdr*>(data.data())->nlmsg_len = data.size();
+  NL80211Packet packet(data);
+
+  return netlink_manager_->SendMessageAsync(
+      packet,
+      [handler, command](bool success,
+                         vector<unique_ptr<const NL80211Packet>> responses) {
+        size_t size = 0;
+        for (const auto& response : responses) {
+          size += response->GetConstData().size();
+        }
+        if (size > kMaxCommandRepliesSize) {
+          LOG(ERROR) << "Replies to command " << int(command) << " take "
+                     << size << " bytes, more than "
+                     << kMaxCommandRepliesSize;
+          handler(false, {});
+          return;
+        }
+        vector<uint8_t> replies;
+        replies.reserve(size);
+        for (const auto& response : responses) {
+          const vector<uint8_t>& data = response->GetConstData();
+          replies.insert(replies.end(), data.begin(), data.end());
+        }
+        handler(success, std::move(replies));
+      });
+}
+
 void NetlinkUtils::SubscribeMlmeEvent(uint32_t interface_index,
                                       MlmeEventHandler* handler) {
   netlink_manager_->SubscribeMlmeEvent(interface_index, handler);
@@ -865,6 +1325,15 @@ void NetlinkUtils::UnsubscribeRegDomainChange(uint32_t wiphy_index) {
   netlink_manager_->UnsubscribeRegDomainChange(wiphy_index);
 }
 
+void NetlinkUtils::SubscribeInterfaceEvent(uint32_t wiphy_index,
+                                           OnInterfaceEventHandler handler) {
+  netlink_manager_->SubscribeInterfaceEvent(wiphy_index, handler);
+}
+
+void NetlinkUtils::UnsubscribeInterfaceEvent(uint32_t wiphy_index) {
+  netlink_manager_->UnsubscribeInterfaceEvent(wiphy_index);
+}
+
 void NetlinkUtils::SubscribeStationEvent(uint32_t interface_index,
                                          OnStationEventHandler handler) {
   netlink_manager_->SubscribeStationEvent(interface_index, handler);
@@ -892,5 +1361,43 @@ void NetlinkUtils::UnsubscribeFrameTxStatusEvent(uint32_t interface_index) {
   netlink_manager_->UnsubscribeFrameTxStatusEvent(interface_index);
 }
 
+void NetlinkUtils::SubscribeCqmEvent(uint32_t interface_index,
+                                     OnCqmEventHandler handler) {
+  netlink_manager_->SubscribeCqmEvent(interface_index, handler);
+}
+
+void NetlinkUtils::UnsubscribeCqmEvent(uint32_t interface_index) {
+  netlink_manager_->UnsubscribeCqmEvent(interface_index);
+}
+
+void NetlinkUtils::SubscribeEventsLost(uint32_t interface_index,
+                                       OnEventsLostHandler handler) {
+  netlink_manager_->SubscribeEventsLost(interface_index, handler);
+}
+
+void NetlinkUtils::UnsubscribeEventsLost(uint32_t interface_index) {
+  netlink_manager_->UnsubscribeEventsLost(interface_index);
+}
+
+void NetlinkUtils::CreateInterfaceStrand(uint32_t interface_index) {
+  netlink_manager_->CreateInterfaceStrand(interface_index);
+}
+
+void NetlinkUtils::DestroyInterfaceStrand(uint32_t interface_index) {
+  netlink_manager_->DestroyInterfaceStrand(interface_index);
+}
+
+void NetlinkUtils::DumpCommandLatencies(std::stringstream* ss) {
+  netlink_manager_->DumpCommandLatencies(ss);
+}
+
+void NetlinkUtils::GetMemoryAccounts(vector<MemoryAccount>* accounts) {
+  netlink_manager_->GetMemoryAccounts(accounts);
+}
+
+void NetlinkUtils::TrimMemory() {
+  netlink_manager_->TrimMemory();
+}
+
 }  // namespace wificond
 }  // namespace android
@@ -66,6 +66,9 @@ struct BandInfo {
   std::vector<uint32_t> band_dfs;
   // Frequencies for 6 GHz band.
   std::vector<uint32_t> band_6g;
+  // Frequencies the hardware supports but that are disabled, by the
+  // regulatory domain or by the driver. See NetlinkUtils::ApplyRegDomain().
+  std::vector<uint32_t> band_disabled;
   // support for 802.11n
   bool is_80211n_supported;
   // support for 802.11ac
@@ -169,6 +172,73 @@ struct StationInfo {
   // We will add them once we find them useful.
 };
 
+// Statistics of a station associated with an AP interface.
+// Counters that kernel does not report are 0.
+struct StationStats {
+  std::array<uint8_t, ETH_ALEN> mac_address;
+  // Bytes received from and transmitted to the station.
+  uint64_t rx_bytes = 0;
+  uint64_t tx_bytes = 0;
+  // Signal strength of the station in dBm.
+  int8_t signal_dbm = 0;
+  // Time since the last activity of the station.
+  uint32_t inactive_time_ms = 0;
+  // Time since the station connected.
+  uint32_t connected_time_s = 0;
+};
+
+// Survey of a channel, from NL80211_ATTR_SURVEY_INFO.
+// Times are in ms and accumulate since the radio was brought up.
+// Counters that kernel does not report are 0.
+struct ChannelSurvey {
+  // Center frequency of the channel in MHz.
+  uint32_t frequency = 0;
+  // Whether the radio is currently on this channel.
+  bool in_use = false;
+  // Whether kernel reported |noise_dbm|.
+  bool has_noise = false;
+  int8_t noise_dbm = 0;
+  // Time the radio spent on the channel.
+  uint64_t active_time_ms = 0;
+  // Time the channel was sensed busy, own transmissions included.
+  uint64_t busy_time_ms = 0;
+  // Time the radio spent receiving and transmitting.
+  uint64_t rx_time_ms = 0;
+  uint64_t tx_time_ms = 0;
+};
+
+// A rule of a regulatory domain, from NL80211_ATTR_REG_RULES.
+struct RegRule {
+  // Frequency range the rule applies to, in kHz.
+  uint32_t start_freq_khz = 0;
+  uint32_t end_freq_khz = 0;
+  // Widest channel allowed within the range, in kHz.
+  uint32_t max_bandwidth_khz = 0;
+  // Set of NL80211_RRF_* flags.
+  uint32_t flags = 0;
+};
+
+// The regulatory domain currently applied by kernel.
+struct RegDomain {
+  // Alpha2 country code, "00" for the world regulatory domain.
+  std::string country_code;
+  std::vector<RegRule> rules;
+};
+
+// Everything NetlinkUtils::GetWiphyInfo() reports about a wiphy.
+struct WiphyInfo {
+  BandInfo band_info;
+  ScanCapabilities scan_capabilities;
+  WiphyFeatures wiphy_features;
+};
+
+// This describes a type of function handling the completion of a command
+// sent by NetlinkUtils::SendCommandAsync().
+// |replies| holds the reply messages back to back, including NLMSG_ERROR
+// and NLMSG_DONE messages, in the order they were received.
+typedef std::function<void(bool success, std::vector<uint8_t> replies)>
+    OnCommandRepliesHandler;
+
 class MlmeEventHandler;
 class NetlinkManager;
 class NL80211Packet;
@@ -200,6 +270,13 @@ class NetlinkUtils {
   virtual bool GetInterfaces(uint32_t wiphy_index,
                              std::vector<InterfaceInfo>* interface_info);
 
+  // Get the operating frequency of interface |interface_index| from kernel.
+  // For a station interface this is the frequency of the associated BSS.
+  // |*out_frequency| is the frequency in MHz.
+  // Returns false on error or when the interface is not on a channel.
+  virtual bool GetInterfaceFrequency(uint32_t interface_index,
+                                     uint32_t* out_frequency);
+
   // Set the mode of interface.
   // |interface_index| is the interface index.
   // |mode| is one of the values in |enum InterfaceMode|.
@@ -207,6 +284,25 @@ class NetlinkUtils {
   virtual bool SetInterfaceMode(uint32_t interface_index,
                                 InterfaceMode mode);
 
+  // Configure the connection quality monitor of interface |interface_index|
+  // to send an event when the RSSI crosses |rssi_threshold_dbm|.
+  // |rssi_hysteresis_db| is the minimum RSSI change between two events.
+  // A |rssi_threshold_dbm| of 0 disables RSSI monitoring.
+  // Returns true on success.
+  virtual bool SetCqmRssiConfig(uint32_t interface_index,
+                                int32_t rssi_threshold_dbm,
+                                uint32_t rssi_hysteresis_db);
+
+  // Configure the connection quality monitor of interface |interface_index|
+  // to send an event when at least |rate_percent| percent of the |packets|
+  // packets attempted within |interval_seconds| failed.
+  // An |interval_seconds| of 0 disables tx error monitoring.
+  // Returns true on success.
+  virtual bool SetCqmTxErrorConfig(uint32_t interface_index,
+                                   uint32_t rate_percent,
+                                   uint32_t packets,
+                                   uint32_t interval_seconds);
+
   // Get wiphy capability information from kernel.
   // Returns true on success.
   virtual bool GetWiphyInfo(uint32_t wiphy_index,
@@ -221,6 +317,27 @@ class NetlinkUtils {
                               const std::array<uint8_t, ETH_ALEN>& mac_address,
                               StationInfo* out_station_info);
 
+  // Get the mac addresses of all stations associated with interface
+  // |interface_index| from kernel.
+  // Returns true on success.
+  virtual bool GetStationList(
+      uint32_t interface_index,
+      std::vector<std::array<uint8_t, ETH_ALEN>>* out_mac_addresses);
+
+  // Same as |GetStationList|, but also gets the statistics of each station,
+  // with the same single station dump.
+  // Returns true on success.
+  virtual bool GetStationStatsList(
+      uint32_t interface_index,
+      std::vector<StationStats>* out_station_stats);
+
+  // Get the channel surveys of the radio of interface |interface_index|
+  // from kernel, with a single survey dump.
+  // Returns true on success.
+  virtual bool GetChannelSurveys(
+      uint32_t interface_index,
+      std::vector<ChannelSurvey>* out_surveys);
+
   // Get a bitmap for nl80211 protocol features,
   // i.e. features for the nl80211 protocol rather than device features.
   // See enum nl80211_protocol_features in nl80211.h for decoding the bitmap.
@@ -231,6 +348,23 @@ class NetlinkUtils {
   // Returns true on success.
   virtual bool GetCountryCode(std::string* out_country_code);
 
+  // Get current regulatory domain from kernel, with its rules.
+  // Returns true on success.
+  virtual bool GetRegDomain(RegDomain* out_reg_domain);
+
+  // Recomputes the channel lists of |band_info| for the rules of
+  // |reg_domain|, without querying kernel. Channels that no rule covers are
+  // moved to |band_info->band_disabled|, and 5GHz channels that require DFS
+  // or passive scanning to |band_info->band_dfs|.
+  // Channels that |band_info| already lists as disabled or DFS keep that
+  // restriction, since it may come from the driver rather than from the
+  // previous regulatory domain.
+  // Returns false if the rules would lift such a restriction. The channel
+  // lists are then conservative, and a new wiphy dump tells the actual
+  // channels.
+  static bool ApplyRegDomain(const RegDomain& reg_domain,
+                             BandInfo* band_info);
+
   // Sign up to be notified when there is MLME event.
   // Only one handler can be registered per interface index.
   // New handler will replace the registered handler if they are for the
@@ -256,6 +390,18 @@ class NetlinkUtils {
   // from wiphy with index |wiphy_index|.
   virtual void UnsubscribeRegDomainChange(uint32_t wiphy_index);
 
+  // Sign up to be notified when an interface of wiphy |wiphy_index| is
+  // created or deleted.
+  // Only one handler can be registered per wiphy index.
+  // New handler will replace the registered handler if they are for the
+  // same wiphy index.
+  virtual void SubscribeInterfaceEvent(uint32_t wiphy_index,
+                                       OnInterfaceEventHandler handler);
+
+  // Cancel the sign-up of receiving interface events from wiphy with index
+  // |wiphy_index|.
+  virtual void UnsubscribeInterfaceEvent(uint32_t wiphy_index);
+
   // Sign up to be notified when there is a station event.
   // Only one handler can be registered per interface index.
   // New handler will replace the registered handler if they are for the
@@ -283,9 +429,61 @@ class NetlinkUtils {
   // Cancel the sign-up of receiving frame tx status events.
   virtual void UnsubscribeFrameTxStatusEvent(uint32_t interface_index);
 
+  // Sign up to be notified of connection quality monitor events.
+  // Events are only sent after the monitor is configured with
+  // SetCqmRssiConfig() or SetCqmTxErrorConfig().
+  virtual void SubscribeCqmEvent(uint32_t interface_index,
+                                 OnCqmEventHandler handler);
+
+  // Cancel the sign-up of receiving connection quality monitor events.
+  virtual void UnsubscribeCqmEvent(uint32_t interface_index);
+
+  // Sign up to be notified when multicast events might have been lost.
+  // See NetlinkManager::SubscribeEventsLost for details.
+  virtual void SubscribeEventsLost(uint32_t interface_index,
+                                   OnEventsLostHandler handler);
+
+  // Cancel the sign-up of receiving events lost notification.
+  virtual void UnsubscribeEventsLost(uint32_t interface_index);
+
+  // Makes the event handlers of interface |interface_index| run on a strand
+  // of their own.
+  // See NetlinkManager::CreateInterfaceStrand for details.
+  virtual void CreateInterfaceStrand(uint32_t interface_index);
+
+  // Makes the event handlers of interface |interface_index| run right away
+  // again.
+  virtual void DestroyInterfaceStrand(uint32_t interface_index);
+
+  // Appends the latency of the netlink commands sent so far to |ss|.
+  // See NetlinkManager::DumpCommandLatencies for details.
+  virtual void DumpCommandLatencies(std::stringstream* ss);
+  // See NetlinkManager::GetMemoryAccounts and NetlinkManager::TrimMemory.
+  virtual void GetMemoryAccounts(std::vector<MemoryAccount>* accounts);
+  virtual void TrimMemory();
+
   virtual bool SendMgmtFrame(uint32_t interface_index,
     const std::vector<uint8_t>& frame, int32_t mcs, uint64_t* out_cookie);
 
+  // Sends nl80211 |command| for interface |interface_index| without blocking,
+  // with |attributes|, a stream of attributes prebuilt by the caller,
+  // appended as they are. |flags| are NLM_F_* flags added to the request,
+  // e.g. NLM_F_DUMP.
+  // The interface index attribute is added here, so |attributes| must not
+  // name an interface, wdev or wiphy of their own.
+  // |handler| is run as described in NetlinkManager::SendMessageAsync.
+  // It fails with no replies if the replies take more than
+  // |kMaxCommandRepliesSize| bytes, so that they fit into one oneway binder
+  // transaction.
+  // Returns false, without running |handler|, if |attributes| are malformed
+  // or the command could not be sent.
+  static constexpr size_t kMaxCommandRepliesSize = 128 * 1024;
+  virtual bool SendCommandAsync(uint32_t interface_index,
+                                uint8_t command,
+                                uint16_t flags,
+                                const std::vector<uint8_t>& attributes,
+                                OnCommandRepliesHandler handler);
+
   // Visible for testing.
   bool supports_split_wiphy_dump_;
 
@@ -297,6 +495,10 @@ class NetlinkUtils {
       WiphyFeatures* out_wiphy_features);
   bool ParseBandInfo(const NL80211Packet* const packet,
                      BandInfo* out_band_info);
+  // Adds the bands of a NL80211_ATTR_WIPHY_BANDS attribute to
+  // |*out_band_info|.
+  bool AppendBandInfo(const NL80211NestedAttr& bands_attr,
+                      BandInfo* out_band_info);
   void ParseIfTypeDataAttributes(const NL80211NestedAttr& iftype_data_attr,
                                  BandInfo* out_band_info);
   void ParseHtVhtPhyCapabilities(const NL80211NestedAttr& band,
@@ -318,9 +520,14 @@ class NetlinkUtils {
   bool ParseScanCapabilities(const NL80211Packet* const packet,
                              ScanCapabilities* out_scan_capabilities);
 
-  bool MergePacketsForSplitWiphyDump(
+  // Parses the wiphy info of wiphy |wiphy_index| from the messages of a
+  // split wiphy dump.
+  bool ParseSplitWiphyDump(
       const std::vector<std::unique_ptr<const NL80211Packet>>& split_dump_info,
-      std::vector<NL80211Packet>* packet_per_wiphy);
+      uint32_t wiphy_index,
+      BandInfo* out_band_info,
+      ScanCapabilities* out_scan_capabilities,
+      WiphyFeatures* out_wiphy_features);
   void handleBandFreqAttributes(const NL80211NestedAttr& freqs_attr,
       BandInfo* out_band_info);
 
@@ -16,6 +16,8 @@
 
 #include "wificond/net/nl80211_attribute.h"
 
+#include "wificond/net/buffer_pool.h"
+
 using std::string;
 using std::vector;
 
@@ -90,6 +92,119 @@ bool BaseNL80211Attr::GetAttributeImpl(const uint8_t* buf,
   return false;
 }
 
+bool BaseNL80211Attr::GetPayloadImpl(const uint8_t* attr_start,
+                                     const uint8_t* attr_end,
+                                     const uint8_t** payload,
+                                     size_t* payload_length) {
+  if (attr_start == nullptr || attr_end == nullptr ||
+      attr_end < attr_start + NLA_HDRLEN) {
+    return false;
+  }
+  const nlattr* header = reinterpret_cast<const nlattr*>(attr_start);
+  if (header->nla_len < NLA_HDRLEN ||
+      NLA_ALIGN(header->nla_len) != static_cast<size_t>(attr_end - attr_start)) {
+    return false;
+  }
+  *payload = attr_start + NLA_HDRLEN;
+  *payload_length = header->nla_len - NLA_HDRLEN;
+  return true;
+}
+
+bool NL80211AttrValueDecoder<vector<uint8_t>>::Decode(
+    const uint8_t* attr_start,
+    const uint8_t* attr_end,
+    vector<uint8_t>* value) {
+  const uint8_t* payload;
+  size_t payload_length;
+  if (!BaseNL80211Attr::GetPayloadImpl(
+          attr_start, attr_end, &payload, &payload_length)) {
+    return false;
+  }
+  value->assign(payload, payload + payload_length);
+  return true;
+}
+
+bool NL80211AttrValueDecoder<string>::Decode(const uint8_t* attr_start,
+                                             const uint8_t* attr_end,
+                                             string* value) {
+  const uint8_t* payload;
+  size_t payload_length;
+  if (!BaseNL80211Attr::GetPayloadImpl(
+          attr_start, attr_end, &payload, &payload_length)) {
+    return false;
+  }
+  // Remove trailing zeros, the same way as NL80211Attr<string>::GetValue().
+  while (payload_length > 0 && payload[payload_length - 1] == 0) {
+    payload_length--;
+  }
+  value->assign(reinterpret_cast<const char*>(payload), payload_length);
+  return true;
+}
+
+bool NL80211AttrIndex::Find(const uint8_t* buf,
+                            size_t len,
+                            int attr_id,
+                            uint8_t** attr_start,
+                            uint8_t** attr_end) {
+  if (attr_id < 0 || attr_id > kMaxIndexedAttributeId) {
+    return BaseNL80211Attr::GetAttributeImpl(
+        buf, len, attr_id, attr_start, attr_end);
+  }
+  if (!built_ || built_len_ != len) {
+    Build(buf, len);
+  }
+  if (static_cast<size_t>(attr_id) >= offsets_.size() ||
+      offsets_[attr_id] == 0) {
+    return false;
+  }
+  const uint8_t* ptr = buf + offsets_[attr_id] - 1;
+  const nlattr* header = reinterpret_cast<const nlattr*>(ptr);
+  if (attr_start != nullptr && attr_end != nullptr) {
+    *attr_start = const_cast<uint8_t*>(ptr);
+    *attr_end = const_cast<uint8_t*>(ptr + NLA_ALIGN(header->nla_len));
+  }
+  return true;
+}
+
+NL80211AttrIndex::~NL80211AttrIndex() {
+  BufferPool<uint32_t>::Release(std::move(offsets_));
+}
+
+void NL80211AttrIndex::Reset() {
+  offsets_.clear();
+  built_ = false;
+  built_len_ = 0;
+}
+
+void NL80211AttrIndex::Build(const uint8_t* buf, size_t len) {
+  if (offsets_.capacity() == 0) {
+    offsets_ = BufferPool<uint32_t>::Acquire(kMaxIndexedAttributeId + 1);
+  }
+  offsets_.clear();
+  const uint8_t* ptr = buf;
+  const uint8_t* end_ptr = buf + len;
+  while (ptr + NLA_HDRLEN <= end_ptr) {
+    const nlattr* header = reinterpret_cast<const nlattr*>(ptr);
+    // Attributes after a broken one can't be located.
+    if (header->nla_len < NLA_HDRLEN ||
+        ptr + NLA_ALIGN(header->nla_len) > end_ptr) {
+      break;
+    }
+    int id = header->nla_type;
+    if (id <= kMaxIndexedAttributeId) {
+      if (static_cast<size_t>(id) >= offsets_.size()) {
+        offsets_.resize(id + 1, 0);
+      }
+      // Keep the first attribute with a given id, like GetAttributeImpl().
+      if (offsets_[id] == 0) {
+        offsets_[id] = ptr - buf + 1;
+      }
+    }
+    ptr += NLA_ALIGN(header->nla_len);
+  }
+  built_ = true;
+  built_len_ = len;
+}
 
 bool BaseNL80211Attr::Merge(const BaseNL80211Attr& other_attr) {
   if (!other_attr.IsValid()) {
@@ -200,20 +315,14 @@ void NL80211NestedAttr::AddFlagAttribute(int attribute_id) {
 }
 
 bool NL80211NestedAttr::HasAttribute(int id) const {
-  return BaseNL80211Attr::GetAttributeImpl(data_.data() + NLA_HDRLEN,
-                                           data_.size() - NLA_HDRLEN,
-                                           id, nullptr, nullptr);
+  return FindAttribute(id, nullptr, nullptr);
 }
 
 bool NL80211NestedAttr::GetAttribute(int id,
     NL80211NestedAttr* attribute) const {
   uint8_t* start = nullptr;
   uint8_t* end = nullptr;
-  if (!BaseNL80211Attr::GetAttributeImpl(data_.data() + NLA_HDRLEN,
-                                         data_.size() - NLA_HDRLEN,
-                                         id, &start, &end) ||
-      start == nullptr ||
-      end == nullptr) {
+  if (!FindAttribute(id, &start, &end)) {
     return false;
   }
   *attribute = NL80211NestedAttr(vector<uint8_t>(start, end));
@@ -247,6 +356,35 @@ bool NL80211NestedAttr::GetListOfNestedAttributes(
 }
 
 
+bool NL80211NestedAttr::GetAttributePayload(int id,
+                                            const uint8_t** payload,
+                                            size_t* payload_length) const {
+  uint8_t* start = nullptr;
+  uint8_t* end = nullptr;
+  if (!FindAttribute(id, &start, &end)) {
+    return false;
+  }
+  return BaseNL80211Attr::GetPayloadImpl(start, end, payload, payload_length);
+}
+
+bool NL80211NestedAttr::FindAttribute(int id,
+                                      uint8_t** start,
+                                      uint8_t** end) const {
+  if (data_.size() < NLA_HDRLEN) {
+    return false;
+  }
+  if (!attr_index_.Find(data_.data() + NLA_HDRLEN,
+                        data_.size() - NLA_HDRLEN,
+                        id, start, end)) {
+    return false;
+  }
+  if (start != nullptr && end != nullptr &&
+      (*start == nullptr || *end == nullptr)) {
+    return false;
+  }
+  return true;
+}
+
 void NL80211NestedAttr::DebugLog() const {
   const uint8_t* ptr = data_.data() + NLA_HDRLEN;
   const uint8_t* end_ptr = data_.data() + data_.size();
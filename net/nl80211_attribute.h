@@ -17,6 +17,8 @@
 #ifndef WIFICOND_NET_NL80211_ATTRIBUTE_H_
 #define WIFICOND_NET_NL80211_ATTRIBUTE_H_
 
+#include <array>
+#include <cstring>
 #include <memory>
 #include <string>
 #include <type_traits>
@@ -49,6 +51,14 @@ class BaseNL80211Attr {
                               int attr_id,
                               uint8_t** attr_start,
                               uint8_t** attr_end);
+  // Returns the payload of the attribute stored in [|attr_start|, |attr_end|),
+  // as located by GetAttributeImpl(). Nothing is copied: |*payload| points
+  // into the original buffer.
+  // Returns false if the attribute header is inconsistent with the range.
+  static bool GetPayloadImpl(const uint8_t* attr_start,
+                             const uint8_t* attr_end,
+                             const uint8_t** payload,
+                             size_t* payload_length);
   // Merge the payload of |attr| to current attribute.
   // This is only used for merging attribute from the response of split dump.
   // Returns true on success.
@@ -61,6 +71,43 @@ class BaseNL80211Attr {
   std::vector<uint8_t> data_;
 };
 
+// An index of the attributes in a buffer of nl80211 attributes, keyed by
+// attribute id. It is built in one pass on the first lookup, so that later
+// lookups don't need to walk the buffer again.
+// The index remembers the length of the buffer it was built from and is
+// rebuilt when the length changes, e.g. after an attribute is appended or
+// merged. Any other modification of the buffer must call Reset().
+class NL80211AttrIndex {
+ public:
+  NL80211AttrIndex() = default;
+  NL80211AttrIndex(const NL80211AttrIndex&) = default;
+  NL80211AttrIndex(NL80211AttrIndex&&) = default;
+  NL80211AttrIndex& operator=(const NL80211AttrIndex&) = default;
+  NL80211AttrIndex& operator=(NL80211AttrIndex&&) = default;
+  // Gives the storage of the index back to the BufferPool it came from.
+  ~NL80211AttrIndex();
+
+  // Same as BaseNL80211Attr::GetAttributeImpl().
+  bool Find(const uint8_t* buf,
+            size_t len,
+            int attr_id,
+            uint8_t** attr_start,
+            uint8_t** attr_end);
+  void Reset();
+
+ private:
+  // Attribute ids larger than this are looked up with a linear walk.
+  static constexpr int kMaxIndexedAttributeId = 511;
+
+  void Build(const uint8_t* buf, size_t len);
+
+  // |offsets_[id]| is the offset of the first attribute with |id| from the
+  // start of the buffer, plus one. 0 means there is no such attribute.
+  std::vector<uint32_t> offsets_;
+  bool built_ = false;
+  size_t built_len_ = 0;
+};
+
 template <typename T>
 class NL80211Attr : public BaseNL80211Attr {
  public:
@@ -152,6 +199,64 @@ extern template class NL80211Attr<uint64_t>;
 extern template class NL80211Attr<std::vector<uint8_t>>;
 extern template class NL80211Attr<std::string>;
 
+// Decodes the value of an attribute stored in [|attr_start|, |attr_end|)
+// directly from that buffer, with the same validation and trimming rules
+// as NL80211Attr<T>, but without building an NL80211Attr<T> temporary.
+// Integral and fixed size array values are read in place. Byte vectors and
+// strings are copied exactly once into |*value|.
+template <typename T>
+struct NL80211AttrValueDecoder {
+  static bool Decode(const uint8_t* attr_start,
+                     const uint8_t* attr_end,
+                     T* value) {
+    static_assert(
+        std::is_integral<T>::value,
+        "Failed to decode NL80211Attr value with non-integral type");
+    const uint8_t* payload;
+    size_t payload_length;
+    if (!BaseNL80211Attr::GetPayloadImpl(
+            attr_start, attr_end, &payload, &payload_length) ||
+        payload_length != sizeof(T) ||
+        static_cast<size_t>(attr_end - attr_start) !=
+            NLA_ALIGN(sizeof(T)) + NLA_HDRLEN) {
+      return false;
+    }
+    memcpy(value, payload, sizeof(T));
+    return true;
+  }
+};
+
+template <size_t N>
+struct NL80211AttrValueDecoder<std::array<uint8_t, N>> {
+  static bool Decode(const uint8_t* attr_start,
+                     const uint8_t* attr_end,
+                     std::array<uint8_t, N>* value) {
+    const uint8_t* payload;
+    size_t payload_length;
+    if (!BaseNL80211Attr::GetPayloadImpl(
+            attr_start, attr_end, &payload, &payload_length) ||
+        payload_length < N) {
+      return false;
+    }
+    std::copy_n(payload, N, value->begin());
+    return true;
+  }
+};
+
+template <>
+struct NL80211AttrValueDecoder<std::vector<uint8_t>> {
+  static bool Decode(const uint8_t* attr_start,
+                     const uint8_t* attr_end,
+                     std::vector<uint8_t>* value);
+};
+
+template <>
+struct NL80211AttrValueDecoder<std::string> {
+  static bool Decode(const uint8_t* attr_start,
+                     const uint8_t* attr_end,
+                     std::string* value);
+};
+
 class NL80211NestedAttr : public BaseNL80211Attr {
  public:
   explicit NL80211NestedAttr(int id);
@@ -170,20 +275,21 @@ class NL80211NestedAttr : public BaseNL80211Attr {
   // The reason is that we may have multiple attributes having the same
   // attribute id, nested within different level of |this|.
   bool GetAttribute(int id, NL80211NestedAttr* attribute) const;
+  // Returns a pointer to the payload of attribute |id| nested within |this|
+  // and its length, without copying it.
+  // |*payload| is invalidated when |this| is modified or destroyed.
+  bool GetAttributePayload(int id,
+                           const uint8_t** payload,
+                           size_t* payload_length) const;
 
   template <typename T>
   bool GetAttributeValue(int id, T* value) const {
-    std::vector<uint8_t> empty_vec;
-    // All data in |attribute| created here will be overwritten by
-    // GetAttribute(). So we use an empty vector to initialize it,
-    // regardless of the fact that an empty buffer is not qualified
-    // for creating a valid attribute.
-    NL80211Attr<T> attribute(empty_vec);
-    if (!GetAttribute(id, &attribute)) {
+    uint8_t* start = nullptr;
+    uint8_t* end = nullptr;
+    if (!FindAttribute(id, &start, &end)) {
       return false;
     }
-    *value = attribute.GetValue();
-    return true;
+    return NL80211AttrValueDecoder<T>::Decode(start, end, value);
   }
 
   // Some of the nested attribute contains a list of same type sub-attributes.
@@ -264,11 +370,7 @@ class NL80211NestedAttr : public BaseNL80211Attr {
   bool GetAttribute(int id, NL80211Attr<T>* attribute) const {
     uint8_t* start = nullptr;
     uint8_t* end = nullptr;
-    if (!BaseNL80211Attr::GetAttributeImpl(data_.data() + NLA_HDRLEN,
-                                           data_.size() - NLA_HDRLEN,
-                                           id, &start, &end) ||
-        start == nullptr ||
-        end == nullptr) {
+    if (!FindAttribute(id, &start, &end)) {
       return false;
     }
     *attribute = NL80211Attr<T>(std::vector<uint8_t>(start, end));
@@ -280,6 +382,11 @@ class NL80211NestedAttr : public BaseNL80211Attr {
 
   void DebugLog() const;
 
+ private:
+  // Locates attribute |id| nested within |this|.
+  bool FindAttribute(int id, uint8_t** start, uint8_t** end) const;
+
+  mutable NL80211AttrIndex attr_index_;
 };
 
 }  // namespace wificond
@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_NET_NL80211_ATTRIBUTE_SCHEMA_H_
+#define WIFICOND_NET_NL80211_ATTRIBUTE_SCHEMA_H_
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include <linux/genetlink.h>
+#include <linux/netlink.h>
+
+#include "wificond/net/nl80211_attribute.h"
+#include "wificond/net/nl80211_packet_view.h"
+
+namespace android {
+namespace wificond {
+
+// How an attribute of a schema is decoded.
+enum class NL80211AttrKind {
+  // The payload is decoded by NL80211AttrValueDecoder<T>, with the same size
+  // checks as NL80211Attr<T>.
+  kValue,
+  // The presence of the attribute sets a bool field.
+  kFlag,
+  // The payload is a nested attribute decoded with another schema of the same
+  // struct.
+  kNested,
+};
+
+// An entry of a NL80211AttrSchema: attribute |id| is decoded into a field of
+// |Struct|. Entries are built with NL80211ValueField(), NL80211FlagField() and
+// NL80211NestedField().
+template <typename Struct>
+struct NL80211AttrField {
+  int id;
+  NL80211AttrKind kind;
+  // A missing or invalid required attribute fails decoding.
+  // The field of an optional one is then left untouched.
+  bool required;
+  // Decodes the attribute stored in [|attr_start|, |attr_end|) into |*out|.
+  // Returns false if the attribute is invalid.
+  bool (*decode)(const uint8_t* attr_start,
+                 const uint8_t* attr_end,
+                 Struct* out);
+};
+
+// Deduces the struct and field types of a pointer to data member.
+template <typename MemberPointer>
+struct NL80211MemberTraits;
+
+template <typename S, typename T>
+struct NL80211MemberTraits<T S::*> {
+  using Struct = S;
+  using Type = T;
+};
+
+// A compile time table of the attributes of a nl80211 message, or of a nested
+// attribute, that are decoded into a plain struct. Decode() walks the
+// attributes once, and dispatches each of them through a table indexed by
+// attribute id instead of looking up every field separately:
+//
+//   struct StaInfo {
+//     uint32_t tx_packets = 0;
+//     int8_t signal = 0;
+//   };
+//   constexpr auto kStaInfoSchema = MakeNL80211AttrSchema(
+//       NL80211ValueField<&StaInfo::tx_packets>(NL80211_STA_INFO_TX_PACKETS,
+//                                               true),
+//       NL80211ValueField<&StaInfo::signal>(NL80211_STA_INFO_SIGNAL));
+//   StaInfo sta_info;
+//   if (!kStaInfoSchema.Decode(payload, payload_length, &sta_info)) ...
+//
+// Like lookups by id, only the first attribute with a given id is decoded.
+template <typename Struct, size_t N>
+class NL80211AttrSchema {
+ public:
+  using StructType = Struct;
+
+  // Attribute ids of a schema can't be larger than this.
+  static constexpr int kMaxAttributeId = 511;
+
+  constexpr explicit NL80211AttrSchema(
+      const std::array<NL80211AttrField<Struct>, N>& fields)
+      : fields_(fields),
+        slots_() {
+    static_assert(N < 256, "Too many attributes in NL80211AttrSchema");
+    for (size_t i = 0; i < N; i++) {
+      // An out of range id fails to compile, as the index is out of bounds.
+      slots_[fields_[i].id] = static_cast<uint8_t>(i + 1);
+    }
+  }
+
+  // Decodes the attributes in the |len| bytes at |buf| into |*out|.
+  // Returns false if a required attribute is missing or invalid.
+  bool Decode(const uint8_t* buf, size_t len, Struct* out) const {
+    std::bitset<N> seen;
+    const uint8_t* ptr = buf;
+    const uint8_t* end_ptr = buf + len;
+    while (ptr + NLA_HDRLEN <= end_ptr) {
+      const nlattr* header = reinterpret_cast<const nlattr*>(ptr);
+      // Attributes after a broken one can't be located.
+      if (header->nla_len < NLA_HDRLEN ||
+          ptr + NLA_ALIGN(header->nla_len) > end_ptr) {
+        break;
+      }
+      const uint8_t* attr_end = ptr + NLA_ALIGN(header->nla_len);
+      int id = header->nla_type;
+      size_t slot = id <= kMaxAttributeId ? slots_[id] : 0;
+      if (slot != 0 && !seen[slot - 1]) {
+        const NL80211AttrField<Struct>& field = fields_[slot - 1];
+        seen[slot - 1] = true;
+        if (!field.decode(ptr, attr_end, out) && field.required) {
+          return false;
+        }
+      }
+      ptr = attr_end;
+    }
+    for (size_t i = 0; i < N; i++) {
+      if (fields_[i].required && !seen[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Same as above, for the top level attributes of |packet|.
+  bool Decode(const NL80211PacketView& packet, Struct* out) const {
+    if (packet.GetSize() < NLMSG_HDRLEN + GENL_HDRLEN) {
+      return false;
+    }
+    return Decode(packet.GetData() + NLMSG_HDRLEN + GENL_HDRLEN,
+                  packet.GetSize() - NLMSG_HDRLEN - GENL_HDRLEN,
+                  out);
+  }
+
+ private:
+  std::array<NL80211AttrField<Struct>, N> fields_;
+  // |slots_[id]| is the index of the entry of attribute |id| in |fields_|,
+  // plus one. 0 means the attribute is not part of the schema.
+  std::array<uint8_t, kMaxAttributeId + 1> slots_;
+};
+
+template <typename Struct, typename... Fields>
+constexpr NL80211AttrSchema<Struct, sizeof...(Fields) + 1>
+MakeNL80211AttrSchema(const NL80211AttrField<Struct>& field,
+                      const Fields&... fields) {
+  return NL80211AttrSchema<Struct, sizeof...(Fields) + 1>(
+      std::array<NL80211AttrField<Struct>, sizeof...(Fields) + 1>{
+          {field, fields...}});
+}
+
+// Attribute |id| holds the value of field |Member|.
+template <auto Member>
+constexpr NL80211AttrField<typename NL80211MemberTraits<decltype(Member)>::Struct>
+NL80211ValueField(int id, bool required = false) {
+  using Struct = typename NL80211MemberTraits<decltype(Member)>::Struct;
+  using Type = typename NL80211MemberTraits<decltype(Member)>::Type;
+  return {id, NL80211AttrKind::kValue, required,
+          [](const uint8_t* attr_start, const uint8_t* attr_end, Struct* out) {
+            return NL80211AttrValueDecoder<Type>::Decode(
+                attr_start, attr_end, &(out->*Member));
+          }};
+}
+
+// Flag attribute |id| sets bool field |Member| when present.
+template <auto Member>
+constexpr NL80211AttrField<typename NL80211MemberTraits<decltype(Member)>::Struct>
+NL80211FlagField(int id) {
+  using Struct = typename NL80211MemberTraits<decltype(Member)>::Struct;
+  static_assert(
+      std::is_same<typename NL80211MemberTraits<decltype(Member)>::Type,
+                   bool>::value,
+      "Flag attributes can only be decoded into bool fields");
+  return {id, NL80211AttrKind::kFlag, false,
+          [](const uint8_t*, const uint8_t*, Struct* out) {
+            out->*Member = true;
+            return true;
+          }};
+}
+
+// Nested attribute |id| is decoded with |Schema|.
+template <const auto& Schema>
+constexpr NL80211AttrField<
+    typename std::decay_t<decltype(Schema)>::StructType>
+NL80211NestedField(int id, bool required = false) {
+  using Struct = typename std::decay_t<decltype(Schema)>::StructType;
+  return {id, NL80211AttrKind::kNested, required,
+          [](const uint8_t* attr_start, const uint8_t* attr_end, Struct* out) {
+            const uint8_t* payload;
+            size_t payload_length;
+            return BaseNL80211Attr::GetPayloadImpl(
+                       attr_start, attr_end, &payload, &payload_length) &&
+                   Schema.Decode(payload, payload_length, out);
+          }};
+}
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_NET_NL80211_ATTRIBUTE_SCHEMA_H_
@@ -16,27 +16,75 @@
 
 #include "wificond/net/nl80211_packet.h"
 
+#include <string.h>
+
+#include <algorithm>
+
 #include <android-base/logging.h>
 
+#include "wificond/net/buffer_pool.h"
+
+using std::string;
 using std::vector;
 
 namespace android {
 namespace wificond {
 
+namespace {
+
+// Number of freed packets whose memory is kept per thread.
+constexpr size_t kMaxFreePackets = 64;
+
+// Memory of freed packets, for reuse by new ones of the same thread.
+struct FreePackets {
+  ~FreePackets();
+
+  void* blocks[kMaxFreePackets];
+  size_t num_blocks = 0;
+};
+
+// Trivially destructible, so that it can still be read after the free
+// packets of a thread are destroyed at thread exit.
+thread_local bool free_packets_destroyed = false;
+
+FreePackets::~FreePackets() {
+  free_packets_destroyed = true;
+  for (size_t i = 0; i < num_blocks; i++) {
+    ::operator delete(blocks[i]);
+  }
+}
+
+FreePackets* GetFreePackets() {
+  if (free_packets_destroyed) {
+    return nullptr;
+  }
+  thread_local FreePackets free_packets;
+  return &free_packets;
+}
+
+}  // namespace
+
 NL80211Packet::NL80211Packet(const vector<uint8_t>& data)
-    : data_(data) {
-  data_ = data;
+    : data_(BufferPool<uint8_t>::Acquire(data.size())) {
+  data_.assign(data.begin(), data.end());
+}
+
+NL80211Packet::NL80211Packet(const NL80211PacketView& view)
+    : data_(BufferPool<uint8_t>::Acquire(view.GetSize())) {
+  data_.assign(view.GetData(), view.GetData() + view.GetSize());
 }
 
-NL80211Packet::NL80211Packet(const NL80211Packet& packet) {
-  data_ = packet.data_;
+NL80211Packet::NL80211Packet(const NL80211Packet& packet)
+    : data_(BufferPool<uint8_t>::Acquire(packet.data_.size())) {
+  data_.assign(packet.data_.begin(), packet.data_.end());
   LOG(WARNING) << "Copy constructor is only used for unit tests";
 }
 
 NL80211Packet::NL80211Packet(uint16_t type,
                              uint8_t command,
                              uint32_t sequence,
-                             uint32_t pid) {
+                             uint32_t pid)
+    : data_(BufferPool<uint8_t>::Acquire(NLMSG_HDRLEN + GENL_HDRLEN)) {
   // Initialize the netlink header and generic netlink header.
   // NLMSG_HDRLEN and GENL_HDRLEN already include the padding size.
   data_.resize(NLMSG_HDRLEN + GENL_HDRLEN, 0);
@@ -56,42 +104,31 @@ NL80211Packet::NL80211Packet(uint16_t type,
   // genl_header->reserved is aready 0.
 }
 
-bool NL80211Packet::IsValid() const {
-  // Verify the size of packet.
-  if (data_.size() < NLMSG_HDRLEN) {
-    LOG(ERROR) << "Cannot retrieve netlink header.";
-    return false;
-  }
-
-  const nlmsghdr* nl_header = reinterpret_cast<const nlmsghdr*>(data_.data());
+NL80211Packet::~NL80211Packet() {
+  BufferPool<uint8_t>::Release(std::move(data_));
+}
 
-  // If type < NLMSG_MIN_TYPE, this should be a reserved control message,
-  // which doesn't carry a generic netlink header.
-  if (GetMessageType() >= NLMSG_MIN_TYPE) {
-    if (data_.size() < NLMSG_HDRLEN + GENL_HDRLEN ||
-        nl_header->nlmsg_len < NLMSG_HDRLEN + GENL_HDRLEN) {
-      LOG(ERROR) << "Cannot retrieve generic netlink header.";
-      return false;
-    }
-  }
-  // If it is an ERROR message, it should be long enough to carry an extra error
-  // code field.
-  // Kernel uses int for this field.
-  if (GetMessageType() == NLMSG_ERROR) {
-    if (data_.size() < NLMSG_HDRLEN + sizeof(int) ||
-        nl_header->nlmsg_len < NLMSG_HDRLEN + sizeof(int)) {
-     LOG(ERROR) << "Broken error message.";
-     return false;
-    }
+void* NL80211Packet::operator new(size_t size) {
+  FreePackets* free_packets = GetFreePackets();
+  if (size == sizeof(NL80211Packet) && free_packets != nullptr &&
+      free_packets->num_blocks > 0) {
+    return free_packets->blocks[--free_packets->num_blocks];
   }
+  return ::operator new(size);
+}
 
-  // Verify the netlink header.
-  if (data_.size() < nl_header->nlmsg_len ||
-      nl_header->nlmsg_len < sizeof(nlmsghdr)) {
-    LOG(ERROR) << "Discarding incomplete / invalid message.";
-    return false;
+void NL80211Packet::operator delete(void* ptr, size_t size) {
+  FreePackets* free_packets = GetFreePackets();
+  if (size == sizeof(NL80211Packet) && free_packets != nullptr &&
+      free_packets->num_blocks < kMaxFreePackets) {
+    free_packets->blocks[free_packets->num_blocks++] = ptr;
+    return;
   }
-  return true;
+  ::operator delete(ptr);
+}
+
+bool NL80211Packet::IsValid() const {
+  return GetView().IsValid();
 }
 
 bool NL80211Packet::IsDump() const {
@@ -102,6 +139,10 @@ bool NL80211Packet::IsMulti() const {
   return GetFlags() & NLM_F_MULTI;
 }
 
+bool NL80211Packet::IsDumpFiltered() const {
+  return GetFlags() & NLM_F_DUMP_FILTERED;
+}
+
 uint8_t NL80211Packet::GetCommand() const {
   const genlmsghdr* genl_header = reinterpret_cast<const genlmsghdr*>(
       data_.data() + NLMSG_HDRLEN);
@@ -132,10 +173,18 @@ int NL80211Packet::GetErrorCode() const {
   return -*reinterpret_cast<const int*>(data_.data() + NLMSG_HDRLEN);
 }
 
+bool NL80211Packet::GetExtendedAckMessage(string* message) const {
+  return GetView().GetExtendedAckMessage(message);
+}
+
 const vector<uint8_t>& NL80211Packet::GetConstData() const {
   return data_;
 }
 
+NL80211PacketView NL80211Packet::GetView() const {
+  return NL80211PacketView(data_.data(), data_.size());
+}
+
 void NL80211Packet::SetCommand(uint8_t command) {
   genlmsghdr* genl_header = reinterpret_cast<genlmsghdr*>(
       data_.data() + NLMSG_HDRLEN);
@@ -169,6 +218,7 @@ void NL80211Packet::SetPortId(uint32_t pid) {
 
 void NL80211Packet::AddAttribute(const BaseNL80211Attr& attribute) {
   const vector<uint8_t>& append_data = attribute.GetConstData();
+  EnsureCapacity(data_.size() + append_data.size());
   // Append the data of |attribute| to |this|.
   data_.insert(data_.end(), append_data.begin(), append_data.end());
   nlmsghdr* nl_header = reinterpret_cast<nlmsghdr*>(data_.data());
@@ -180,6 +230,7 @@ void NL80211Packet::AddAttribute(const BaseNL80211Attr& attribute) {
 void NL80211Packet::AddFlagAttribute(int attribute_id) {
   // We only need to append a header for flag attribute.
   // Make space for the new attribute.
+  EnsureCapacity(data_.size() + NLA_HDRLEN);
   data_.resize(data_.size() + NLA_HDRLEN, 0);
   nlattr* flag_header =
       reinterpret_cast<nlattr*>(data_.data() + data_.size() - NLA_HDRLEN);
@@ -189,23 +240,62 @@ void NL80211Packet::AddFlagAttribute(int attribute_id) {
   nl_header->nlmsg_len += NLA_HDRLEN;
 }
 
+void NL80211Packet::Reserve(size_t size) {
+  EnsureCapacity(data_.size() + size);
+}
+
+void NL80211Packet::EnsureCapacity(size_t size) {
+  if (size <= data_.capacity()) {
+    return;
+  }
+  // Grow geometrically, like the vector would.
+  vector<uint8_t> data =
+      BufferPool<uint8_t>::Acquire(std::max(size, data_.capacity() * 2));
+  data.assign(data_.begin(), data_.end());
+  BufferPool<uint8_t>::Release(std::move(data_));
+  data_ = std::move(data);
+}
+
+void NL80211Packet::AddAttributeBytes(int id,
+                                      const void* payload,
+                                      size_t length) {
+  size_t offset = data_.size();
+  EnsureCapacity(offset + GetAttributeSize(length));
+  // Padding is zero-initialized by resize().
+  data_.resize(offset + GetAttributeSize(length), 0);
+  nlattr* header = reinterpret_cast<nlattr*>(data_.data() + offset);
+  header->nla_type = id;
+  header->nla_len = NLA_HDRLEN + length;
+  if (length > 0) {
+    memcpy(data_.data() + offset + NLA_HDRLEN, payload, length);
+  }
+  nlmsghdr* nl_header = reinterpret_cast<nlmsghdr*>(data_.data());
+  nl_header->nlmsg_len = data_.size();
+}
+
+size_t NL80211Packet::BeginNestedAttribute(int id) {
+  size_t marker = data_.size();
+  AddAttributeBytes(id, nullptr, 0);
+  return marker;
+}
+
+void NL80211Packet::EndNestedAttribute(size_t marker) {
+  nlattr* header = reinterpret_cast<nlattr*>(data_.data() + marker);
+  // All attributes nested within are padded already.
+  header->nla_len = data_.size() - marker;
+  // The length of the packet did not change, so the index would not notice.
+  attr_index_.Reset();
+}
+
 bool NL80211Packet::HasAttribute(int id) const {
-  return BaseNL80211Attr::GetAttributeImpl(
-      data_.data() + NLMSG_HDRLEN + GENL_HDRLEN,
-      data_.size() - NLMSG_HDRLEN - GENL_HDRLEN,
-      id, nullptr, nullptr);
+  return FindAttribute(id, nullptr, nullptr);
 }
 
 bool NL80211Packet::GetAttribute(int id,
     NL80211NestedAttr* attribute) const {
   uint8_t* start = nullptr;
   uint8_t* end = nullptr;
-  if (!BaseNL80211Attr::GetAttributeImpl(
-          data_.data() + NLMSG_HDRLEN + GENL_HDRLEN,
-          data_.size() - NLMSG_HDRLEN - GENL_HDRLEN,
-          id, &start, &end) ||
-      start == nullptr ||
-      end == nullptr) {
+  if (!FindAttribute(id, &start, &end)) {
     return false;
   }
   *attribute = NL80211NestedAttr(vector<uint8_t>(start, end));
@@ -234,6 +324,35 @@ bool NL80211Packet::GetAllAttributes(
   return true;
 }
 
+bool NL80211Packet::GetAttributePayload(int id,
+                                        const uint8_t** payload,
+                                        size_t* payload_length) const {
+  uint8_t* start = nullptr;
+  uint8_t* end = nullptr;
+  if (!FindAttribute(id, &start, &end)) {
+    return false;
+  }
+  return BaseNL80211Attr::GetPayloadImpl(start, end, payload, payload_length);
+}
+
+bool NL80211Packet::FindAttribute(int id,
+                                  uint8_t** start,
+                                  uint8_t** end) const {
+  if (data_.size() < NLMSG_HDRLEN + GENL_HDRLEN) {
+    return false;
+  }
+  if (!attr_index_.Find(data_.data() + NLMSG_HDRLEN + GENL_HDRLEN,
+                        data_.size() - NLMSG_HDRLEN - GENL_HDRLEN,
+                        id, start, end)) {
+    return false;
+  }
+  if (start != nullptr && end != nullptr &&
+      (*start == nullptr || *end == nullptr)) {
+    return false;
+  }
+  return true;
+}
+
 void NL80211Packet::DebugLog() const {
   const uint8_t* ptr = data_.data() + NLMSG_HDRLEN + GENL_HDRLEN;
   const uint8_t* end_ptr = data_.data() + data_.size();
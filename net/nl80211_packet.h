@@ -18,6 +18,8 @@
 #define WIFICOND_NET_NL80211_PACKET_H_
 
 #include <memory>
+#include <string>
+#include <type_traits>
 #include <vector>
 
 #include <linux/genetlink.h>
@@ -26,6 +28,7 @@
 #include <android-base/macros.h>
 
 #include "wificond/net/nl80211_attribute.h"
+#include "wificond/net/nl80211_packet_view.h"
 
 namespace android {
 namespace wificond {
@@ -37,10 +40,17 @@ namespace wificond {
 // few types of netlink control messages. In this way the API user is supposed to
 // call IsValid() and GetMessageType() in the first place to avoid misuse of
 // this class.
+// Packets are allocated often, e.g. one per reply to a request. Their data
+// buffers are taken from and given back to a BufferPool, and the memory of
+// packets allocated with new is kept in a per-thread free list, so that
+// steady state traffic does not go through the heap.
 class NL80211Packet {
  public:
   // This is used for creating a NL80211Packet from buffer.
   explicit NL80211Packet(const std::vector<uint8_t>& data);
+  // This is used for creating an owned copy of a packet that is only
+  // available as a view, e.g. one that still lives in the receive buffer.
+  explicit NL80211Packet(const NL80211PacketView& view);
   // This is used for creating an empty NL80211Packet to be filled later.
   // See comment of SetMessageType() for |type|.
   // See comment of SetCommand() for |command|.
@@ -57,7 +67,11 @@ class NL80211Packet {
   // Explicitly specify the move constructor. Otherwise, copy constructor will
   // be called on if we move a NL80211Packet object.
   NL80211Packet(NL80211Packet&& packet) = default;
-  ~NL80211Packet() = default;
+  ~NL80211Packet();
+
+  // Reuse the memory of freed packets of this thread.
+  static void* operator new(size_t size);
+  static void operator delete(void* ptr, size_t size);
 
   // Returns whether a packet has consistent header fields.
   bool IsValid() const;
@@ -71,6 +85,10 @@ class NL80211Packet {
   // Multipart messages are terminated by NLMSG_DONE, which should be returned
   // by GetMessageType().
   bool IsMulti() const;
+  // Kernel sets this on the messages of a dump that it only filled with
+  // objects matching the attributes of the request, e.g. its interface index.
+  // Such messages do not have to be filtered again.
+  bool IsDumpFiltered() const;
 
   // Getter functions.
   uint8_t GetCommand() const;
@@ -82,7 +100,12 @@ class NL80211Packet {
   // NLMSG_ERROR message before calling GetErrorCode().
   // Returns an error number defined in errno.h
   int GetErrorCode() const;
+  // See NL80211PacketView::GetExtendedAckMessage().
+  bool GetExtendedAckMessage(std::string* message) const;
   const std::vector<uint8_t>& GetConstData() const;
+  // Returns a view over the data of this packet.
+  // The view is invalidated by any setter or AddAttribute() call.
+  NL80211PacketView GetView() const;
 
   // Setter functions.
 
@@ -113,6 +136,40 @@ class NL80211Packet {
   // For NLA_FLAG attribute
   void AddFlagAttribute(int attribute_id);
 
+  // Helpers that write attributes in place into the packet buffer, without
+  // building NL80211Attr temporaries first. Large requests should reserve
+  // their size first, so that they are built with a single allocation:
+  //   packet.Reserve(size);
+  //   size_t ssids = packet.BeginNestedAttribute(NL80211_ATTR_SCAN_SSIDS);
+  //   packet.AddAttributeBytes(0, ssid.data(), ssid.size());
+  //   packet.EndNestedAttribute(ssids);
+  // Nested attributes can be nested in each other, like with libnl's
+  // nla_nest_start() and nla_nest_end().
+
+  // Returns the number of bytes that an attribute with a payload of
+  // |payload_length| bytes takes in a packet, padding included.
+  static size_t GetAttributeSize(size_t payload_length) {
+    return NLA_HDRLEN + NLA_ALIGN(payload_length);
+  }
+  // Reserves room for |size| more bytes of attributes.
+  void Reserve(size_t size);
+  // Appends attribute |id| with a copy of the |length| bytes at |payload|.
+  void AddAttributeBytes(int id, const void* payload, size_t length);
+  template <typename T>
+  void AddAttributeValue(int id, T value) {
+    static_assert(
+        std::is_integral<T>::value,
+        "Failed to add attribute value with non-integral type");
+    AddAttributeBytes(id, &value, sizeof(T));
+  }
+  // Starts nested attribute |id|. Attributes added until the matching
+  // EndNestedAttribute() call are nested within it.
+  // Returns the marker to pass to EndNestedAttribute().
+  size_t BeginNestedAttribute(int id);
+  // Ends the nested attribute whose BeginNestedAttribute() call returned
+  // |marker|.
+  void EndNestedAttribute(size_t marker);
+
   bool HasAttribute(int id) const;
   bool GetAttribute(int id, NL80211NestedAttr* attribute) const;
   // Get all attributes to |*attribute| as a vector.
@@ -121,31 +178,28 @@ class NL80211Packet {
   bool GetAllAttributes(
       std::vector<BaseNL80211Attr>* attributes) const;
 
+  // Returns a pointer to the payload of attribute |id| and its length,
+  // without copying it.
+  // |*payload| is only valid as long as the packet data is unchanged.
+  bool GetAttributePayload(int id,
+                           const uint8_t** payload,
+                           size_t* payload_length) const;
+
   template <typename T>
   bool GetAttributeValue(int id, T* value) const {
-    std::vector<uint8_t> empty_vec;
-    // All data in |attribute| created here will be overwritten by
-    // GetAttribute(). So we use an empty vector to initialize it,
-    // regardless of the fact that an empty buffer is not qualified
-    // for creating a valid attribute.
-    NL80211Attr<T> attribute(empty_vec);
-    if (!GetAttribute(id, &attribute)) {
+    uint8_t* start = nullptr;
+    uint8_t* end = nullptr;
+    if (!FindAttribute(id, &start, &end)) {
       return false;
     }
-    *value = attribute.GetValue();
-    return true;
+    return NL80211AttrValueDecoder<T>::Decode(start, end, value);
   }
 
   template <typename T>
   bool GetAttribute(int id, NL80211Attr<T>* attribute) const {
     uint8_t* start = nullptr;
     uint8_t* end = nullptr;
-    if (!BaseNL80211Attr::GetAttributeImpl(
-            data_.data() + NLMSG_HDRLEN + GENL_HDRLEN,
-            data_.size() - NLMSG_HDRLEN - GENL_HDRLEN,
-            id, &start, &end) ||
-        start == nullptr ||
-        end == nullptr) {
+    if (!FindAttribute(id, &start, &end)) {
       return false;
     }
     *attribute = NL80211Attr<T>(std::vector<uint8_t>(start, end));
@@ -158,7 +212,15 @@ class NL80211Packet {
   void DebugLog() const;
 
  private:
+  // Locates attribute |id| in the payload of this packet.
+  bool FindAttribute(int id, uint8_t** start, uint8_t** end) const;
+  // Makes room for |size| bytes of data in total, moving the data to a
+  // larger pooled buffer if needed.
+  void EnsureCapacity(size_t size);
+
   std::vector<uint8_t> data_;
+  // Built on the first attribute lookup.
+  mutable NL80211AttrIndex attr_index_;
 };
 
 }  // namespace wificond
@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/net/nl80211_packet_view.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include <android-base/logging.h>
+
+using std::string;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+NL80211PacketView::NL80211PacketView(const uint8_t* data, size_t size)
+    : data_(data),
+      size_(size) {
+}
+
+bool NL80211PacketView::IsValid() const {
+  // Verify the size of packet.
+  if (data_ == nullptr || size_ < NLMSG_HDRLEN) {
+    LOG(ERROR) << "Cannot retrieve netlink header.";
+    return false;
+  }
+
+  const nlmsghdr* nl_header = reinterpret_cast<const nlmsghdr*>(data_);
+
+  // If type < NLMSG_MIN_TYPE, this should be a reserved control message,
+  // which doesn't carry a generic netlink header.
+  if (GetMessageType() >= NLMSG_MIN_TYPE) {
+    if (size_ < NLMSG_HDRLEN + GENL_HDRLEN ||
+        nl_header->nlmsg_len < NLMSG_HDRLEN + GENL_HDRLEN) {
+      LOG(ERROR) << "Cannot retrieve generic netlink header.";
+      return false;
+    }
+  }
+  // If it is an ERROR message, it should be long enough to carry an extra error
+  // code field.
+  // Kernel uses int for this field.
+  if (GetMessageType() == NLMSG_ERROR) {
+    if (size_ < NLMSG_HDRLEN + sizeof(int) ||
+        nl_header->nlmsg_len < NLMSG_HDRLEN + sizeof(int)) {
+     LOG(ERROR) << "Broken error message.";
+     return false;
+    }
+  }
+
+  // Verify the netlink header.
+  if (size_ < nl_header->nlmsg_len ||
+      nl_header->nlmsg_len < sizeof(nlmsghdr)) {
+    LOG(ERROR) << "Discarding incomplete / invalid message.";
+    return false;
+  }
+  return true;
+}
+
+bool NL80211PacketView::IsDump() const {
+  return GetFlags() & NLM_F_DUMP;
+}
+
+bool NL80211PacketView::IsMulti() const {
+  return GetFlags() & NLM_F_MULTI;
+}
+
+bool NL80211PacketView::IsDumpFiltered() const {
+  return GetFlags() & NLM_F_DUMP_FILTERED;
+}
+
+uint8_t NL80211PacketView::GetCommand() const {
+  const genlmsghdr* genl_header = reinterpret_cast<const genlmsghdr*>(
+      data_ + NLMSG_HDRLEN);
+  return genl_header->cmd;
+}
+
+uint16_t NL80211PacketView::GetFlags() const {
+  const nlmsghdr* nl_header = reinterpret_cast<const nlmsghdr*>(data_);
+  return nl_header->nlmsg_flags;
+}
+
+uint16_t NL80211PacketView::GetMessageType() const {
+  const nlmsghdr* nl_header = reinterpret_cast<const nlmsghdr*>(data_);
+  return nl_header->nlmsg_type;
+}
+
+uint32_t NL80211PacketView::GetMessageSequence() const {
+  const nlmsghdr* nl_header = reinterpret_cast<const nlmsghdr*>(data_);
+  return nl_header->nlmsg_seq;
+}
+
+uint32_t NL80211PacketView::GetPortId() const {
+  const nlmsghdr* nl_header = reinterpret_cast<const nlmsghdr*>(data_);
+  return nl_header->nlmsg_pid;
+}
+
+int NL80211PacketView::GetErrorCode() const {
+  return -*reinterpret_cast<const int*>(data_ + NLMSG_HDRLEN);
+}
+
+bool NL80211PacketView::GetExtendedAckMessage(string* message) const {
+  const nlmsghdr* nl_header = reinterpret_cast<const nlmsghdr*>(data_);
+  if (!(nl_header->nlmsg_flags & NLM_F_ACK_TLVS)) {
+    return false;
+  }
+  // The error code is followed by the header of the request, and also by its
+  // payload unless the ack is capped (NETLINK_CAP_ACK).
+  size_t offset = NLMSG_HDRLEN + sizeof(nlmsgerr);
+  if (!(nl_header->nlmsg_flags & NLM_F_CAPPED)) {
+    if (size_ < offset) {
+      return false;
+    }
+    const nlmsgerr* error = reinterpret_cast<const nlmsgerr*>(
+        data_ + NLMSG_HDRLEN);
+    offset = NLMSG_HDRLEN + sizeof(int) + NLMSG_ALIGN(error->msg.nlmsg_len);
+  }
+  const size_t end = std::min(size_, static_cast<size_t>(nl_header->nlmsg_len));
+  while (offset + NLA_HDRLEN <= end) {
+    const nlattr* attr = reinterpret_cast<const nlattr*>(data_ + offset);
+    if (attr->nla_len < NLA_HDRLEN || offset + attr->nla_len > end) {
+      return false;
+    }
+    if ((attr->nla_type & NLA_TYPE_MASK) == NLMSGERR_ATTR_MSG) {
+      const char* str = reinterpret_cast<const char*>(data_ + offset +
+                                                      NLA_HDRLEN);
+      *message = string(str, strnlen(str, attr->nla_len - NLA_HDRLEN));
+      return true;
+    }
+    offset += NLA_ALIGN(attr->nla_len);
+  }
+  return false;
+}
+
+bool NL80211PacketView::HasAttribute(int id) const {
+  return FindAttribute(id, nullptr, nullptr);
+}
+
+bool NL80211PacketView::GetAttribute(int id,
+    NL80211NestedAttr* attribute) const {
+  uint8_t* start = nullptr;
+  uint8_t* end = nullptr;
+  if (!FindAttribute(id, &start, &end)) {
+    return false;
+  }
+  *attribute = NL80211NestedAttr(vector<uint8_t>(start, end));
+  if (!attribute->IsValid()) {
+    return false;
+  }
+  return true;
+}
+
+bool NL80211PacketView::GetAttributePayload(int id,
+                                            const uint8_t** payload,
+                                            size_t* payload_length) const {
+  uint8_t* start = nullptr;
+  uint8_t* end = nullptr;
+  if (!FindAttribute(id, &start, &end)) {
+    return false;
+  }
+  return BaseNL80211Attr::GetPayloadImpl(start, end, payload, payload_length);
+}
+
+bool NL80211PacketView::FindAttribute(int id,
+                                      uint8_t** start,
+                                      uint8_t** end) const {
+  if (size_ < NLMSG_HDRLEN + GENL_HDRLEN) {
+    return false;
+  }
+  if (!BaseNL80211Attr::GetAttributeImpl(
+          data_ + NLMSG_HDRLEN + GENL_HDRLEN,
+          size_ - NLMSG_HDRLEN - GENL_HDRLEN,
+          id, start, end)) {
+    return false;
+  }
+  if (start != nullptr && end != nullptr &&
+      (*start == nullptr || *end == nullptr)) {
+    return false;
+  }
+  return true;
+}
+
+}  // namespace wificond
+}  // namespace android
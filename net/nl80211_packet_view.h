@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_NET_NL80211_PACKET_VIEW_H_
+#define WIFICOND_NET_NL80211_PACKET_VIEW_H_
+
+#include <string>
+#include <vector>
+
+#include <linux/genetlink.h>
+#include <linux/netlink.h>
+
+#include "wificond/net/nl80211_attribute.h"
+
+namespace android {
+namespace wificond {
+
+// NL80211PacketView is a non-owning, read-only view of a single netlink
+// message that lives in a buffer owned by somebody else, typically the
+// receive buffer of NetlinkManager.
+// It provides the same header and attribute accessors as NL80211Packet, so a
+// message can be inspected in place without first being copied into a
+// std::vector. A view is only valid as long as the underlying buffer is
+// valid and unchanged. Code that needs to keep a message around should
+// create an owned NL80211Packet from the view.
+class NL80211PacketView {
+ public:
+  // |data| points to the beginning of the netlink header.
+  // |size| is the number of bytes available from |data|.
+  NL80211PacketView(const uint8_t* data, size_t size);
+  ~NL80211PacketView() = default;
+
+  // Returns whether a packet has consistent header fields.
+  bool IsValid() const;
+
+  // See NL80211Packet for the meaning of these helpers.
+  bool IsDump() const;
+  bool IsMulti() const;
+  bool IsDumpFiltered() const;
+
+  // Getter functions.
+  uint8_t GetCommand() const;
+  uint16_t GetFlags() const;
+  uint16_t GetMessageType() const;
+  uint32_t GetMessageSequence() const;
+  uint32_t GetPortId() const;
+  // Caller is responsible for checking that this is a valid
+  // NLMSG_ERROR message before calling GetErrorCode().
+  // Returns an error number defined in errno.h
+  int GetErrorCode() const;
+  // Retrieves the error message that kernel attached to this NLMSG_ERROR
+  // message as an extended ack (NLMSGERR_ATTR_MSG).
+  // Returns false if there is none, e.g. because the socket does not have
+  // NETLINK_EXT_ACK set.
+  bool GetExtendedAckMessage(std::string* message) const;
+  const uint8_t* GetData() const { return data_; }
+  size_t GetSize() const { return size_; }
+
+  bool HasAttribute(int id) const;
+  bool GetAttribute(int id, NL80211NestedAttr* attribute) const;
+
+  // Returns a pointer to the payload of attribute |id| and its length,
+  // without copying it.
+  // |*payload| is only valid as long as the packet data is unchanged.
+  bool GetAttributePayload(int id,
+                           const uint8_t** payload,
+                           size_t* payload_length) const;
+
+  template <typename T>
+  bool GetAttributeValue(int id, T* value) const {
+    uint8_t* start = nullptr;
+    uint8_t* end = nullptr;
+    if (!FindAttribute(id, &start, &end)) {
+      return false;
+    }
+    return NL80211AttrValueDecoder<T>::Decode(start, end, value);
+  }
+
+  template <typename T>
+  bool GetAttribute(int id, NL80211Attr<T>* attribute) const {
+    uint8_t* start = nullptr;
+    uint8_t* end = nullptr;
+    if (!FindAttribute(id, &start, &end)) {
+      return false;
+    }
+    *attribute = NL80211Attr<T>(std::vector<uint8_t>(start, end));
+    if (!attribute->IsValid()) {
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  // Locates attribute |id| in the payload of this packet.
+  bool FindAttribute(int id, uint8_t** start, uint8_t** end) const;
+
+  const uint8_t* data_;
+  size_t size_;
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_NET_NL80211_PACKET_VIEW_H_
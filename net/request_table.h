@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_NET_REQUEST_TABLE_H_
+#define WIFICOND_NET_REQUEST_TABLE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <map>
+#include <vector>
+
+#include <utils/Timers.h>
+
+namespace android {
+namespace wificond {
+
+// RequestTable keeps a value, e.g. a reply handler, for each netlink request
+// in flight, keyed by the sequence number of the request.
+// Sequence numbers are handed out in order and only a few requests are in
+// flight at a time, so requests are kept in a fixed ring of slots indexed by
+// sequence number modulo |kNumSlots|. Adding and removing a request does not
+// allocate. A request whose slot is still taken by an older one that is in
+// flight, e.g. one that waits for a long timeout, goes to an overflow map.
+// Each request can have a deadline, so that timeouts of all requests are
+// found with one scan of the table rather than with a timer per request.
+// Values stay at the same address until their request is removed.
+template <typename Value>
+class RequestTable {
+ public:
+  static constexpr size_t kNumSlots = 64;
+
+  RequestTable() = default;
+
+  // Returns the value of request |sequence|, or nullptr if there is none.
+  Value* Find(uint32_t sequence) {
+    Entry* entry = FindEntry(sequence);
+    return entry != nullptr ? &entry->value : nullptr;
+  }
+  const Value* Find(uint32_t sequence) const {
+    return const_cast<RequestTable*>(this)->Find(sequence);
+  }
+
+  // Returns the value of request |sequence|. A default constructed value
+  // without a deadline is added if there is none yet.
+  Value& operator[](uint32_t sequence) {
+    Entry* entry = FindEntry(sequence);
+    if (entry != nullptr) {
+      return entry->value;
+    }
+    Entry& slot = slots_[sequence % kNumSlots];
+    entry = slot.in_use ? &overflow_[sequence] : &slot;
+    entry->sequence = sequence;
+    entry->in_use = true;
+    entry->deadline = 0;
+    num_requests_++;
+    return entry->value;
+  }
+
+  // Returns the number of removed requests.
+  size_t erase(uint32_t sequence) {
+    Entry& slot = slots_[sequence % kNumSlots];
+    if (slot.in_use && slot.sequence == sequence) {
+      slot.in_use = false;
+      // Release whatever the value holds, e.g. the captures of a handler.
+      slot.value = Value();
+      num_requests_--;
+      return 1;
+    }
+    if (overflow_.erase(sequence) > 0) {
+      num_requests_--;
+      return 1;
+    }
+    return 0;
+  }
+
+  bool empty() const { return num_requests_ == 0; }
+  size_t size() const { return num_requests_; }
+
+  // Sets the time after which request |sequence| times out. 0 means never.
+  // Does nothing if there is no such request.
+  void SetDeadline(uint32_t sequence, nsecs_t deadline) {
+    Entry* entry = FindEntry(sequence);
+    if (entry != nullptr) {
+      entry->deadline = deadline;
+    }
+  }
+
+  // Returns the earliest deadline of all requests, or 0 if none has one.
+  nsecs_t GetEarliestDeadline() const {
+    nsecs_t earliest = 0;
+    ForEachEntry([&earliest](const Entry& entry) {
+      if (entry.deadline != 0 &&
+          (earliest == 0 || entry.deadline < earliest)) {
+        earliest = entry.deadline;
+      }
+    });
+    return earliest;
+  }
+
+  // Appends the sequence numbers of the requests whose deadline is at or
+  // before |now| to |sequences|.
+  void GetExpired(nsecs_t now, std::vector<uint32_t>* sequences) const {
+    ForEachEntry([now, sequences](const Entry& entry) {
+      if (entry.deadline != 0 && entry.deadline <= now) {
+        sequences->push_back(entry.sequence);
+      }
+    });
+  }
+
+  // Appends the sequence numbers of all requests to |sequences|.
+  void GetSequences(std::vector<uint32_t>* sequences) const {
+    ForEachEntry([sequences](const Entry& entry) {
+      sequences->push_back(entry.sequence);
+    });
+  }
+
+ private:
+  struct Entry {
+    uint32_t sequence = 0;
+    bool in_use = false;
+    nsecs_t deadline = 0;
+    Value value;
+  };
+
+  Entry* FindEntry(uint32_t sequence) {
+    Entry& slot = slots_[sequence % kNumSlots];
+    if (slot.in_use && slot.sequence == sequence) {
+      return &slot;
+    }
+    if (overflow_.empty()) {
+      return nullptr;
+    }
+    auto it = overflow_.find(sequence);
+    return it != overflow_.end() ? &it->second : nullptr;
+  }
+
+  template <typename Function>
+  void ForEachEntry(Function function) const {
+    for (const Entry& slot : slots_) {
+      if (slot.in_use) {
+        function(slot);
+      }
+    }
+    for (const auto& entry : overflow_) {
+      function(entry.second);
+    }
+  }
+
+  std::array<Entry, kNumSlots> slots_;
+  std::map<uint32_t, Entry> overflow_;
+  size_t num_requests_ = 0;
+};
+
+template <typename Value>
+constexpr size_t RequestTable<Value>::kNumSlots;
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_NET_REQUEST_TABLE_H_
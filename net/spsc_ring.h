@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_NET_SPSC_RING_H_
+#define WIFICOND_NET_SPSC_RING_H_
+
+#include <stddef.h>
+
+#include <atomic>
+#include <vector>
+
+#include <android-base/macros.h>
+
+namespace android {
+namespace wificond {
+
+// SpscRing is a bounded lock-free queue between exactly one producer thread
+// and one consumer thread.
+// Slots are filled in place and keep their value once popped, so that the
+// buffers of a slot, e.g. the capacity of a vector, are reused by the next
+// element pushed to it instead of being allocated anew:
+//   T* slot = ring.BeginPush();
+//   if (slot != nullptr) {
+//     slot->data.assign(...);
+//     ring.CommitPush();
+//   }
+template <typename T>
+class SpscRing {
+ public:
+  // |capacity| is rounded up to a power of two.
+  explicit SpscRing(size_t capacity)
+      : slots_(RoundUpToPowerOfTwo(capacity)),
+        mask_(slots_.size() - 1),
+        head_(0),
+        tail_(0) {}
+
+  size_t capacity() const { return slots_.size(); }
+
+  // Producer side.
+
+  // Returns the slot to fill in, or nullptr if the ring is full.
+  T* BeginPush() {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == slots_.size()) {
+      return nullptr;
+    }
+    return &slots_[tail & mask_];
+  }
+  // Hands the slot of the last BeginPush() over to the consumer.
+  void CommitPush() {
+    tail_.store(tail_.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+  }
+
+  // Consumer side.
+
+  // Returns the oldest element, or nullptr if the ring is empty.
+  // It stays valid until Pop().
+  T* Front() {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    return &slots_[head & mask_];
+  }
+  // Hands the slot of Front() back to the producer.
+  void Pop() {
+    head_.store(head_.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+  }
+
+ private:
+  static size_t RoundUpToPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+      result <<= 1;
+    }
+    return result;
+  }
+
+  std::vector<T> slots_;
+  const size_t mask_;
+  // Index of the next element to pop. Only written by the consumer.
+  // The indexes are on cache lines of their own, so that the threads do not
+  // invalidate each other's line on every push and pop.
+  alignas(64) std::atomic<size_t> head_;
+  // Index of the next slot to push to. Only written by the producer.
+  alignas(64) std::atomic<size_t> tail_;
+
+  DISALLOW_COPY_AND_ASSIGN(SpscRing);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_NET_SPSC_RING_H_
@@ -0,0 +1,277 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/net/wiphy_snapshot.h"
+
+#include <errno.h>
+#include <linux/ethtool.h>
+#include <linux/sockios.h>
+#include <net/if.h>
+#include <stdio.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/strings.h>
+#include <android-base/unique_fd.h>
+
+using android::base::ReadFileToString;
+using android::base::Trim;
+using android::base::unique_fd;
+using android::base::WriteStringToFile;
+using std::string;
+using std::vector;
+
+namespace android {
+namespace wificond {
+namespace {
+
+template <typename T>
+void PutField(string* buffer, T value) {
+  buffer->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void PutFrequencies(string* buffer, const vector<uint32_t>& frequencies) {
+  PutField<uint32_t>(buffer, frequencies.size());
+  for (uint32_t frequency : frequencies) {
+    PutField<uint32_t>(buffer, frequency);
+  }
+}
+
+// Reads fields in order, failing once the end of the buffer is reached.
+class FieldReader {
+ public:
+  explicit FieldReader(const string& buffer) : buffer_(buffer), offset_(0) {}
+
+  template <typename T>
+  bool Get(T* value) {
+    if (buffer_.size() - offset_ < sizeof(T)) {
+      return false;
+    }
+    memcpy(value, buffer_.data() + offset_, sizeof(T));
+    offset_ += sizeof(T);
+    return true;
+  }
+
+  bool GetString(size_t length, string* value) {
+    if (buffer_.size() - offset_ < length) {
+      return false;
+    }
+    value->assign(buffer_, offset_, length);
+    offset_ += length;
+    return true;
+  }
+
+  bool GetFrequencies(vector<uint32_t>* frequencies) {
+    uint32_t count;
+    if (!Get(&count) || (buffer_.size() - offset_) / sizeof(uint32_t) < count) {
+      return false;
+    }
+    frequencies->resize(count);
+    for (uint32_t& frequency : *frequencies) {
+      Get(&frequency);
+    }
+    return true;
+  }
+
+ private:
+  const string& buffer_;
+  size_t offset_;
+};
+
+string Serialize(const string& key, const WiphyInfo& wiphy_info) {
+  string buffer;
+  PutField<uint32_t>(&buffer, WiphySnapshot::kMagic);
+  PutField<uint16_t>(&buffer, WiphySnapshot::kVersion);
+  PutField<uint16_t>(&buffer, 0);
+  PutField<uint32_t>(&buffer, key.size());
+  buffer.append(key);
+
+  const BandInfo& band_info = wiphy_info.band_info;
+  PutFrequencies(&buffer, band_info.band_2g);
+  PutFrequencies(&buffer, band_info.band_5g);
+  PutFrequencies(&buffer, band_info.band_dfs);
+  PutFrequencies(&buffer, band_info.band_6g);
+  PutFrequencies(&buffer, band_info.band_disabled);
+  PutField<uint8_t>(&buffer, band_info.is_80211n_supported);
+  PutField<uint8_t>(&buffer, band_info.is_80211ac_supported);
+  PutField<uint8_t>(&buffer, band_info.is_80211ax_supported);
+  PutField<uint8_t>(&buffer, band_info.is_160_mhz_supported);
+  PutField<uint8_t>(&buffer, band_info.is_80p80_mhz_supported);
+  PutField<uint32_t>(&buffer, band_info.max_tx_streams);
+  PutField<uint32_t>(&buffer, band_info.max_rx_streams);
+
+  const ScanCapabilities& scan_capabilities = wiphy_info.scan_capabilities;
+  PutField<uint8_t>(&buffer, scan_capabilities.max_num_scan_ssids);
+  PutField<uint8_t>(&buffer, scan_capabilities.max_num_sched_scan_ssids);
+  PutField<uint8_t>(&buffer, scan_capabilities.max_match_sets);
+  PutField<uint32_t>(&buffer, scan_capabilities.max_num_scan_plans);
+  PutField<uint32_t>(&buffer, scan_capabilities.max_scan_plan_interval);
+  PutField<uint32_t>(&buffer, scan_capabilities.max_scan_plan_iterations);
+
+  const WiphyFeatures& features = wiphy_info.wiphy_features;
+  PutField<uint8_t>(&buffer, features.supports_random_mac_oneshot_scan);
+  PutField<uint8_t>(&buffer, features.supports_random_mac_sched_scan);
+  PutField<uint8_t>(&buffer, features.supports_low_span_oneshot_scan);
+  PutField<uint8_t>(&buffer, features.supports_low_power_oneshot_scan);
+  PutField<uint8_t>(&buffer, features.supports_high_accuracy_oneshot_scan);
+  PutField<uint8_t>(&buffer, features.supports_tx_mgmt_frame_mcs);
+  PutField<uint8_t>(&buffer, features.supports_ext_sched_scan_relative_rssi);
+  return buffer;
+}
+
+bool GetFlag(FieldReader* reader, bool* value) {
+  uint8_t byte;
+  if (!reader->Get(&byte)) {
+    return false;
+  }
+  *value = byte != 0;
+  return true;
+}
+
+bool Deserialize(const string& buffer, string* out_key,
+                 WiphyInfo* out_wiphy_info) {
+  FieldReader reader(buffer);
+  uint32_t magic;
+  uint16_t version;
+  uint16_t reserved;
+  uint32_t key_length;
+  if (!reader.Get(&magic) || magic != WiphySnapshot::kMagic ||
+      !reader.Get(&version) || version != WiphySnapshot::kVersion ||
+      !reader.Get(&reserved) ||
+      !reader.Get(&key_length) ||
+      !reader.GetString(key_length, out_key)) {
+    return false;
+  }
+
+  BandInfo& band_info = out_wiphy_info->band_info;
+  ScanCapabilities& scan_capabilities = out_wiphy_info->scan_capabilities;
+  WiphyFeatures& features = out_wiphy_info->wiphy_features;
+  return reader.GetFrequencies(&band_info.band_2g) &&
+      reader.GetFrequencies(&band_info.band_5g) &&
+      reader.GetFrequencies(&band_info.band_dfs) &&
+      reader.GetFrequencies(&band_info.band_6g) &&
+      reader.GetFrequencies(&band_info.band_disabled) &&
+      GetFlag(&reader, &band_info.is_80211n_supported) &&
+      GetFlag(&reader, &band_info.is_80211ac_supported) &&
+      GetFlag(&reader, &band_info.is_80211ax_supported) &&
+      GetFlag(&reader, &band_info.is_160_mhz_supported) &&
+      GetFlag(&reader, &band_info.is_80p80_mhz_supported) &&
+      reader.Get(&band_info.max_tx_streams) &&
+      reader.Get(&band_info.max_rx_streams) &&
+      reader.Get(&scan_capabilities.max_num_scan_ssids) &&
+      reader.Get(&scan_capabilities.max_num_sched_scan_ssids) &&
+      reader.Get(&scan_capabilities.max_match_sets) &&
+      reader.Get(&scan_capabilities.max_num_scan_plans) &&
+      reader.Get(&scan_capabilities.max_scan_plan_interval) &&
+      reader.Get(&scan_capabilities.max_scan_plan_iterations) &&
+      GetFlag(&reader, &features.supports_random_mac_oneshot_scan) &&
+      GetFlag(&reader, &features.supports_random_mac_sched_scan) &&
+      GetFlag(&reader, &features.supports_low_span_oneshot_scan) &&
+      GetFlag(&reader, &features.supports_low_power_oneshot_scan) &&
+      GetFlag(&reader, &features.supports_high_accuracy_oneshot_scan) &&
+      GetFlag(&reader, &features.supports_tx_mgmt_frame_mcs) &&
+      GetFlag(&reader, &features.supports_ext_sched_scan_relative_rssi);
+}
+
+}  // namespace
+
+WiphySnapshot::WiphySnapshot() {
+}
+
+bool WiphySnapshot::Open(const string& path) {
+  path_ = path;
+  string content;
+  if (!ReadFileToString(path, &content)) {
+    if (errno == ENOENT) {
+      return true;
+    }
+    PLOG(ERROR) << "Failed to read wiphy snapshot " << path;
+    return false;
+  }
+  string key;
+  WiphyInfo wiphy_info;
+  if (!Deserialize(content, &key, &wiphy_info)) {
+    LOG(INFO) << "Discarding wiphy snapshot of unknown layout in " << path;
+    return true;
+  }
+  key_ = std::move(key);
+  wiphy_info_ = std::move(wiphy_info);
+  return true;
+}
+
+const WiphyInfo* WiphySnapshot::Get(const string& key) const {
+  if (key_.empty() || key != key_) {
+    return nullptr;
+  }
+  return &wiphy_info_;
+}
+
+void WiphySnapshot::Put(const string& key, const WiphyInfo& wiphy_info) {
+  key_ = key;
+  wiphy_info_ = wiphy_info;
+  if (path_.empty()) {
+    return;
+  }
+  // Write a new file and rename it over the old one, so that a crash never
+  // leaves a partial snapshot behind.
+  const string new_path = path_ + ".new";
+  if (!WriteStringToFile(Serialize(key, wiphy_info), new_path)) {
+    PLOG(ERROR) << "Failed to write wiphy snapshot " << new_path;
+    return;
+  }
+  if (rename(new_path.c_str(), path_.c_str()) != 0) {
+    PLOG(ERROR) << "Failed to replace wiphy snapshot " << path_;
+    unlink(new_path.c_str());
+  }
+}
+
+bool WiphySnapshot::GetDeviceKey(const string& iface_name, string* out_key) {
+  string wiphy_name;
+  if (!ReadFileToString("/sys/class/net/" + iface_name + "/phy80211/name",
+                        &wiphy_name)) {
+    PLOG(WARNING) << "Failed to get wiphy name of " << iface_name;
+    return false;
+  }
+  unique_fd sock(socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0));
+  if (sock.get() < 0) {
+    PLOG(ERROR) << "Failed to open socket";
+    return false;
+  }
+  // cfg80211 reports the kernel release as driver version.
+  struct ethtool_drvinfo drvinfo;
+  memset(&drvinfo, 0, sizeof(drvinfo));
+  drvinfo.cmd = ETHTOOL_GDRVINFO;
+  struct ifreq ifr;
+  memset(&ifr, 0, sizeof(ifr));
+  strncpy(ifr.ifr_name, iface_name.c_str(), IFNAMSIZ - 1);
+  ifr.ifr_data = reinterpret_cast<char*>(&drvinfo);
+  if (ioctl(sock.get(), SIOCETHTOOL, &ifr) != 0) {
+    PLOG(WARNING) << "Failed to get driver info of " << iface_name;
+    return false;
+  }
+  *out_key = Trim(wiphy_name) + " " + drvinfo.driver + " " + drvinfo.version +
+      " " + drvinfo.fw_version + " " + drvinfo.bus_info;
+  return true;
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_NET_WIPHY_SNAPSHOT_H_
+#define WIFICOND_NET_WIPHY_SNAPSHOT_H_
+
+#include <string>
+
+#include <android-base/macros.h>
+
+#include "wificond/net/netlink_utils.h"
+
+namespace android {
+namespace wificond {
+
+// Keeps the WiphyInfo of a device, so that bringing up its interfaces again,
+// also after a restart of wificond, doesn't need a wiphy dump.
+//
+// A snapshot is only valid for the device it was taken from, identified by a
+// key made of the wiphy name, driver, kernel release, firmware version and
+// bus of the device. See GetDeviceKey().
+//
+// All fields are in host byte order. The file is:
+//   offset size
+//   0      4    magic, kMagic
+//   4      2    layout version, kVersion
+//   6      2    reserved, 0
+//   8      4    length of the key in bytes, n
+//   12     n    key
+// followed by the WiphyInfo fields, lists of frequencies being a 4 byte
+// count followed by 4 bytes per frequency. A file of another layout is
+// discarded.
+class WiphySnapshot {
+ public:
+  static constexpr uint32_t kMagic = 0x57575053;  // "WWPS"
+  static constexpr uint16_t kVersion = 1;
+
+  WiphySnapshot();
+  ~WiphySnapshot() = default;
+
+  // Loads the snapshot in the file at |path|, if any, and saves later
+  // snapshots to it. Until a file is opened, snapshots are only kept in
+  // memory.
+  // Returns false if the file exists but cannot be read.
+  bool Open(const std::string& path);
+  // Returns the snapshot of the device with |key|, or nullptr if there is
+  // none.
+  const WiphyInfo* Get(const std::string& key) const;
+  // Keeps |wiphy_info| as the snapshot of the device with |key|, replacing
+  // the previous snapshot.
+  void Put(const std::string& key, const WiphyInfo& wiphy_info);
+
+  // Gets the key of the device of interface |iface_name|. This only takes
+  // one ioctl and a sysfs read.
+  // Returns true on success.
+  static bool GetDeviceKey(const std::string& iface_name,
+                           std::string* out_key);
+
+ private:
+  // Empty if no file is opened.
+  std::string path_;
+  // Empty if there is no snapshot.
+  std::string key_;
+  WiphyInfo wiphy_info_;
+
+  DISALLOW_COPY_AND_ASSIGN(WiphySnapshot);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_NET_WIPHY_SNAPSHOT_H_
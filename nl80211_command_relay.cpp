@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/nl80211_command_relay.h"
+
+#include <tuple>
+#include <utility>
+
+#include <android-base/logging.h>
+
+#include "wificond/net/kernel-header-latest/nl80211.h"
+
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+// Returns whether |command| only reads state from kernel, so that identical
+// queries in flight can share one reply.
+bool IsReadOnlyCommand(uint8_t command) {
+  switch (command) {
+    case NL80211_CMD_GET_WIPHY:
+    case NL80211_CMD_GET_INTERFACE:
+    case NL80211_CMD_GET_STATION:
+    case NL80211_CMD_GET_SCAN:
+    case NL80211_CMD_GET_SURVEY:
+    case NL80211_CMD_GET_REG:
+    case NL80211_CMD_GET_PROTOCOL_FEATURES:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Returns whether the reply to |command| describes state that rarely
+// changes, so that it can be cached. Scan results are served by the scanner
+// of each interface instead, see IWifiScannerImpl.queryScanResults().
+bool IsCacheableCommand(uint8_t command) {
+  return command == NL80211_CMD_GET_WIPHY ||
+         command == NL80211_CMD_GET_REG ||
+         command == NL80211_CMD_GET_PROTOCOL_FEATURES;
+}
+
+}  // namespace
+
+constexpr nsecs_t Nl80211CommandRelay::kReplyCacheTtl;
+constexpr size_t Nl80211CommandRelay::kMaxCachedReplies;
+
+bool Nl80211CommandRelay::CommandKey::operator<(
+    const CommandKey& other) const {
+  return std::tie(interface_index, command, flags, attributes) <
+         std::tie(other.interface_index, other.command, other.flags,
+                  other.attributes);
+}
+
+Nl80211CommandRelay::Nl80211CommandRelay(NetlinkUtils* netlink_utils)
+    : netlink_utils_(netlink_utils),
+      use_counter_(0),
+      generation_(0),
+      memory_("nl80211 command relay") {
+}
+
+bool Nl80211CommandRelay::IsCommandAllowed(uint8_t command) {
+  return command == NL80211_CMD_VENDOR || IsReadOnlyCommand(command);
+}
+
+bool Nl80211CommandRelay::SendCommand(uint32_t interface_index,
+                                      uint8_t command,
+                                      uint16_t flags,
+                                      const vector<uint8_t>& attributes,
+                                      nsecs_t now,
+                                      OnCommandRepliesHandler handler) {
+  if (!IsCommandAllowed(command)) {
+    LOG(ERROR) << "Refusing to relay nl80211 command " << int(command);
+    return false;
+  }
+  if (!IsReadOnlyCommand(command)) {
+    return netlink_utils_->SendCommandAsync(
+        interface_index, command, flags, attributes, handler);
+  }
+
+  CommandKey key{interface_index, command, flags, attributes};
+  auto cached = cache_.find(key);
+  if (cached != cache_.end()) {
+    if (now - cached->second.query_time < kReplyCacheTtl) {
+      cached->second.last_use = ++use_counter_;
+      handler(true, cached->second.replies);
+      return true;
+    }
+    cache_.erase(cached);
+    UpdateMemory();
+  }
+
+  auto in_flight = in_flight_.find(key);
+  if (in_flight != in_flight_.end()) {
+    in_flight->second.push_back(handler);
+    return true;
+  }
+  in_flight_[key].push_back(handler);
+  uint64_t generation = generation_;
+  if (!netlink_utils_->SendCommandAsync(
+          interface_index, command, flags, attributes,
+          [this, key, generation, now](bool success, vector<uint8_t> replies) {
+            OnRepliesReceived(key, generation, now, success,
+                              std::move(replies));
+          })) {
+    in_flight_.erase(key);
+    return false;
+  }
+  return true;
+}
+
+void Nl80211CommandRelay::OnRepliesReceived(const CommandKey& key,
+                                            uint64_t generation,
+                                            nsecs_t send_time,
+                                            bool success,
+                                            vector<uint8_t> replies) {
+  auto in_flight = in_flight_.find(key);
+  if (in_flight == in_flight_.end()) {
+    return;
+  }
+  vector<OnCommandRepliesHandler> handlers = std::move(in_flight->second);
+  in_flight_.erase(in_flight);
+
+  if (success && generation == generation_ &&
+      IsCacheableCommand(key.command)) {
+    CacheReplies(key, send_time, replies);
+  }
+  for (const auto& handler : handlers) {
+    handler(success, replies);
+  }
+}
+
+void Nl80211CommandRelay::CacheReplies(const CommandKey& key,
+                                       nsecs_t query_time,
+                                       const vector<uint8_t>& replies) {
+  if (cache_.size() >= kMaxCachedReplies) {
+    auto least_recently_used = cache_.begin();
+    for (auto it = cache_.begin(); it != cache_.end(); ++it) {
+      if (it->second.last_use < least_recently_used->second.last_use) {
+        least_recently_used = it;
+      }
+    }
+    cache_.erase(least_recently_used);
+  }
+  cache_[key] = CachedReply{replies, query_time, ++use_counter_};
+  UpdateMemory();
+}
+
+void Nl80211CommandRelay::Invalidate() {
+  generation_++;
+  cache_.clear();
+  UpdateMemory();
+}
+
+void Nl80211CommandRelay::UpdateMemory() {
+  size_t num_bytes = 0;
+  for (const auto& cached : cache_) {
+    num_bytes += sizeof(cached) + cached.first.attributes.capacity() +
+                 cached.second.replies.capacity();
+  }
+  memory_.Set(num_bytes);
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_NL80211_COMMAND_RELAY_H_
+#define WIFICOND_NL80211_COMMAND_RELAY_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <vector>
+
+#include <android-base/macros.h>
+#include <utils/Timers.h>
+
+#include "wificond/memory_account.h"
+#include "wificond/net/netlink_utils.h"
+
+namespace android {
+namespace wificond {
+
+// Runs nl80211 commands prebuilt by other processes, e.g. vendor services,
+// on their behalf, so that they don't need a nl80211 socket of their own and
+// their queries share wificond's requests and caches:
+// - Only vendor commands and a set of read-only queries are relayed.
+// - A query identical to one in flight is answered by the reply of the
+//   latter, instead of being sent to kernel again.
+// - Replies of queries about state that rarely changes, i.e. the wiphy, the
+//   regulatory domain and the protocol features, are served from a cache
+//   for up to |kReplyCacheTtl|. The cache is invalidated on regulatory
+//   domain and interface changes.
+// Vendor commands may have side effects, so they are neither merged nor
+// cached.
+class Nl80211CommandRelay {
+ public:
+  static constexpr nsecs_t kReplyCacheTtl = s2ns(10);
+  // Most cached replies kept. The least recently used one is dropped to
+  // make room for another.
+  static constexpr size_t kMaxCachedReplies = 8;
+
+  explicit Nl80211CommandRelay(NetlinkUtils* netlink_utils);
+
+  // Returns whether |command| may be relayed.
+  static bool IsCommandAllowed(uint8_t command);
+
+  // Runs nl80211 |command| with |flags| and |attributes| for interface
+  // |interface_index| at |now|. See NetlinkUtils::SendCommandAsync() for the
+  // arguments. |handler| is run right away with a cached reply, or once the
+  // reply has been received.
+  // Returns false, without running |handler|, if |command| is not allowed or
+  // could not be sent.
+  bool SendCommand(uint32_t interface_index,
+                   uint8_t command,
+                   uint16_t flags,
+                   const std::vector<uint8_t>& attributes,
+                   nsecs_t now,
+                   OnCommandRepliesHandler handler);
+  // Drops the cached replies, and makes replies still in flight bypass the
+  // cache.
+  void Invalidate();
+  const MemoryAccount& GetMemoryAccount() const { return memory_; }
+
+ private:
+  struct CommandKey {
+    uint32_t interface_index;
+    uint8_t command;
+    uint16_t flags;
+    std::vector<uint8_t> attributes;
+
+    bool operator<(const CommandKey& other) const;
+  };
+  struct CachedReply {
+    std::vector<uint8_t> replies;
+    // When the query that |replies| answer was sent.
+    nsecs_t query_time;
+    // Value of |use_counter_| when the reply was last served.
+    uint64_t last_use;
+  };
+
+  void OnRepliesReceived(const CommandKey& key,
+                         uint64_t generation,
+                         nsecs_t send_time,
+                         bool success,
+                         std::vector<uint8_t> replies);
+  void CacheReplies(const CommandKey& key,
+                    nsecs_t query_time,
+                    const std::vector<uint8_t>& replies);
+  void UpdateMemory();
+
+  NetlinkUtils* const netlink_utils_;
+  // Handlers waiting for each read-only query in flight.
+  std::map<CommandKey, std::vector<OnCommandRepliesHandler>> in_flight_;
+  std::map<CommandKey, CachedReply> cache_;
+  uint64_t use_counter_;
+  // Incremented by Invalidate(), so that replies to queries sent before are
+  // not cached.
+  uint64_t generation_;
+  MemoryAccount memory_;
+
+  DISALLOW_COPY_AND_ASSIGN(Nl80211CommandRelay);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_NL80211_COMMAND_RELAY_H_
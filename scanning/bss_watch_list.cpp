@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/scanning/bss_watch_list.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <set>
+
+using android::net::wifi::nl80211::BssWatchSettings;
+using android::net::wifi::nl80211::NativeScanResult;
+using android::net::wifi::nl80211::NativeScanResultsDelta;
+using std::array;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+bool BssWatchList::Set(const BssWatchSettings& settings) {
+  bsses_.clear();
+  for (const BssWatchSettings::WatchedBss& bss : settings.bsses) {
+    if (bss.bssid.size() != ETH_ALEN || bss.signal_delta_mbm < 0) {
+      bsses_.clear();
+      return false;
+    }
+    array<uint8_t, ETH_ALEN> bssid;
+    std::copy(bss.bssid.begin(), bss.bssid.end(), bssid.begin());
+    bsses_[bssid].signal_delta_mbm = bss.signal_delta_mbm;
+  }
+  return true;
+}
+
+bool BssWatchList::Update(const vector<NativeScanResult>& scan_results,
+                          NativeScanResultsDelta* changes) {
+  std::set<array<uint8_t, ETH_ALEN>> seen_bssids;
+  for (const NativeScanResult& scan_result : scan_results) {
+    auto iter = bsses_.find(scan_result.bssid);
+    if (iter == bsses_.end() ||
+        !seen_bssids.insert(scan_result.bssid).second) {
+      continue;
+    }
+    WatchedBss& bss = iter->second;
+    if (bss.present &&
+        abs(scan_result.signal_mbm - bss.signal_mbm) < bss.signal_delta_mbm &&
+        scan_result.frequency == bss.frequency) {
+      continue;
+    }
+    bss.present = true;
+    bss.signal_mbm = scan_result.signal_mbm;
+    bss.frequency = scan_result.frequency;
+    NativeScanResult change;
+    change.bssid = scan_result.bssid;
+    change.frequency = scan_result.frequency;
+    change.signal_mbm = scan_result.signal_mbm;
+    change.associated = scan_result.associated;
+    changes->updated_scan_results.push_back(std::move(change));
+  }
+  for (auto& it : bsses_) {
+    if (it.second.present && seen_bssids.count(it.first) == 0) {
+      it.second.present = false;
+      changes->removed_bssids.push_back(it.first);
+      changes->removed_frequencies.push_back(it.second.frequency);
+    }
+  }
+  return !changes->updated_scan_results.empty() ||
+         !changes->removed_bssids.empty();
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_SCANNING_BSS_WATCH_LIST_H_
+#define WIFICOND_SCANNING_BSS_WATCH_LIST_H_
+
+#include <stdint.h>
+
+#include <array>
+#include <map>
+#include <vector>
+
+#include <linux/if_ether.h>
+
+#include "wificond/scanning/bss_watch_settings.h"
+#include "wificond/scanning/scan_result.h"
+#include "wificond/scanning/scan_results_delta.h"
+
+namespace android {
+namespace wificond {
+
+// Tracks the BSSs of a watch list across scan result updates, so that only
+// the BSSs whose signal strength moved by their threshold, or that showed
+// up or disappeared, are reported to the watcher.
+class BssWatchList {
+ public:
+  BssWatchList() = default;
+
+  // Watches the BSSs of |settings| from now on. None of them is known to
+  // be present until the first Update().
+  // Returns false, and watches nothing, if a BSSID is not |ETH_ALEN| bytes
+  // long or a threshold is negative.
+  bool Set(const android::net::wifi::nl80211::BssWatchSettings& settings);
+  bool empty() const { return bsses_.empty(); }
+
+  // Compares the watched BSSs with the latest |scan_results|, and adds
+  // those to report to |changes|. The signal strength of a reported BSS is
+  // what later updates are compared with.
+  // Returns whether anything is to be reported.
+  bool Update(
+      const std::vector<android::net::wifi::nl80211::NativeScanResult>&
+          scan_results,
+      android::net::wifi::nl80211::NativeScanResultsDelta* changes);
+
+ private:
+  struct WatchedBss {
+    int32_t signal_delta_mbm = 0;
+    bool present = false;
+    // Last reported signal strength and frequency, if |present|.
+    int32_t signal_mbm = 0;
+    uint32_t frequency = 0;
+  };
+
+  std::map<std::array<uint8_t, ETH_ALEN>, WatchedBss> bsses_;
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_SCANNING_BSS_WATCH_LIST_H_
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/scanning/bss_watch_settings.h"
+
+#include <android-base/logging.h>
+
+#include "wificond/parcelable_utils.h"
+
+using android::status_t;
+
+namespace android {
+namespace net {
+namespace wifi {
+namespace nl80211 {
+
+status_t BssWatchSettings::writeToParcel(::android::Parcel* parcel) const {
+  RETURN_IF_FAILED(parcel->writeInt32(bsses.size()));
+  for (const WatchedBss& bss : bsses) {
+    RETURN_IF_FAILED(parcel->writeByteVector(bss.bssid));
+    RETURN_IF_FAILED(parcel->writeInt32(bss.signal_delta_mbm));
+  }
+  return ::android::OK;
+}
+
+status_t BssWatchSettings::readFromParcel(const ::android::Parcel* parcel) {
+  int32_t num_bsses;
+  RETURN_IF_FAILED(parcel->readInt32(&num_bsses));
+  if (num_bsses < 0) {
+    return ::android::BAD_VALUE;
+  }
+  bsses.clear();
+  for (int32_t i = 0; i < num_bsses; i++) {
+    WatchedBss bss;
+    RETURN_IF_FAILED(parcel->readByteVector(&bss.bssid));
+    RETURN_IF_FAILED(parcel->readInt32(&bss.signal_delta_mbm));
+    bsses.push_back(std::move(bss));
+  }
+  return ::android::OK;
+}
+
+}  // namespace nl80211
+}  // namespace wifi
+}  // namespace net
+}  // namespace android
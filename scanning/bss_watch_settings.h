@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_SCANNING_BSS_WATCH_SETTINGS_H_
+#define WIFICOND_SCANNING_BSS_WATCH_SETTINGS_H_
+
+#include <vector>
+
+#include <binder/Parcel.h>
+#include <binder/Parcelable.h>
+
+namespace android {
+namespace net {
+namespace wifi {
+namespace nl80211 {
+
+// BSSs to watch the signal strength of. See
+// |IWifiScannerImpl.watchBsses()|.
+class BssWatchSettings : public ::android::Parcelable {
+ public:
+  struct WatchedBss {
+    std::vector<uint8_t> bssid;
+    // Smallest change of the signal strength in (100 * dBm) that is
+    // reported.
+    int32_t signal_delta_mbm = 0;
+  };
+
+  BssWatchSettings() = default;
+  ::android::status_t writeToParcel(::android::Parcel* parcel) const override;
+  ::android::status_t readFromParcel(const ::android::Parcel* parcel) override;
+
+  std::vector<WatchedBss> bsses;
+};
+
+}  // namespace nl80211
+}  // namespace wifi
+}  // namespace net
+}  // namespace android
+
+#endif  // WIFICOND_SCANNING_BSS_WATCH_SETTINGS_H_
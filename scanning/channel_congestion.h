@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_SCANNING_CHANNEL_CONGESTION_H_
+#define WIFICOND_SCANNING_CHANNEL_CONGESTION_H_
+
+#include <binder/Parcel.h>
+#include <binder/Parcelable.h>
+
+namespace android {
+namespace net {
+namespace wifi {
+namespace nl80211 {
+
+// How congested a channel of the cached scan results is.
+// See |IWifiScannerImpl.getChannelCongestion()|.
+class NativeChannelCongestion : public ::android::Parcelable {
+ public:
+  NativeChannelCongestion() = default;
+  bool operator==(const NativeChannelCongestion& rhs) const {
+    return frequency_ == rhs.frequency_ &&
+           num_bss_ == rhs.num_bss_ &&
+           num_bss_with_load_ == rhs.num_bss_with_load_ &&
+           num_stations_ == rhs.num_stations_ &&
+           channel_utilization_ == rhs.channel_utilization_ &&
+           congestion_percent_ == rhs.congestion_percent_;
+  }
+  ::android::status_t writeToParcel(::android::Parcel* parcel) const override;
+  ::android::status_t readFromParcel(const ::android::Parcel* parcel) override;
+
+  // Primary channel frequency in MHz.
+  int32_t frequency_ = 0;
+  // BSSs on the channel.
+  int32_t num_bss_ = 0;
+  // BSSs on the channel that advertise a BSS Load element.
+  int32_t num_bss_with_load_ = 0;
+  // Stations associated with the BSSs that advertise their load.
+  int32_t num_stations_ = 0;
+  // Average channel utilization the BSSs advertise, scaled to 255.
+  // -1 if no BSS on the channel advertises its load.
+  int32_t channel_utilization_ = -1;
+  // Congestion of the channel from 0 to 100, from both the channel
+  // utilization and the number of BSSs on the channel.
+  int32_t congestion_percent_ = 0;
+};
+
+}  // namespace nl80211
+}  // namespace wifi
+}  // namespace net
+}  // namespace android
+
+#endif  // WIFICOND_SCANNING_CHANNEL_CONGESTION_H_
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/scanning/channel_congestion_map.h"
+
+#include <algorithm>
+
+#include "wificond/scanning/info_element_utils.h"
+
+using android::net::wifi::nl80211::NativeChannelCongestion;
+using android::net::wifi::nl80211::NativeScanResult;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+constexpr int32_t ChannelCongestionMap::kMaxBssPerChannel;
+
+void ChannelCongestionMap::Assign(const vector<NativeScanResult>& scan_results) {
+  channels_.clear();
+  // Sum of the channel utilization of each channel.
+  vector<int32_t> utilization_sums;
+  for (const NativeScanResult& scan_result : scan_results) {
+    int32_t frequency = static_cast<int32_t>(scan_result.frequency);
+    auto channel = std::lower_bound(
+        channels_.begin(), channels_.end(), frequency,
+        [](const NativeChannelCongestion& channel, int32_t frequency) {
+          return channel.frequency_ < frequency;
+        });
+    size_t position = channel - channels_.begin();
+    if (channel == channels_.end() || channel->frequency_ != frequency) {
+      channel = channels_.insert(channel, NativeChannelCongestion());
+      channel->frequency_ = frequency;
+      utilization_sums.insert(utilization_sums.begin() + position, 0);
+    }
+    channel->num_bss_++;
+    BssLoad bss_load;
+    if (InfoElementUtils::GetBssLoad(scan_result.info_element.data(),
+                                     scan_result.info_element_index,
+                                     &bss_load)) {
+      channel->num_bss_with_load_++;
+      channel->num_stations_ += bss_load.station_count;
+      utilization_sums[position] += bss_load.channel_utilization;
+    }
+  }
+  for (size_t i = 0; i < channels_.size(); i++) {
+    NativeChannelCongestion& channel = channels_[i];
+    // The denser the channel, the more airtime its BSSs compete for even
+    // when they do not advertise their load.
+    int32_t density_percent =
+        std::min(channel.num_bss_, kMaxBssPerChannel) * 100 /
+        kMaxBssPerChannel;
+    if (channel.num_bss_with_load_ == 0) {
+      channel.congestion_percent_ = density_percent;
+      continue;
+    }
+    channel.channel_utilization_ =
+        utilization_sums[i] / channel.num_bss_with_load_;
+    int32_t utilization_percent = channel.channel_utilization_ * 100 / 255;
+    // What utilization leaves of the airtime is shared by the BSSs.
+    channel.congestion_percent_ =
+        utilization_percent +
+        (100 - utilization_percent) * density_percent / 100;
+  }
+}
+
+}  // namespace wificond
+}  // namespace android
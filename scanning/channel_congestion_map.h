@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_SCANNING_CHANNEL_CONGESTION_MAP_H_
+#define WIFICOND_SCANNING_CHANNEL_CONGESTION_MAP_H_
+
+#include <vector>
+
+#include "wificond/scanning/channel_congestion.h"
+#include "wificond/scanning/scan_result.h"
+
+namespace android {
+namespace wificond {
+
+// Per-channel congestion of a set of scan results, from the BSS Load
+// elements the BSSs advertise and from how many BSSs share each channel.
+// It is built once per scan result dump, from the information element
+// index of the scan results, so that queries do not parse any element.
+class ChannelCongestionMap {
+ public:
+  // Number of BSSs on a channel that make it fully congested by themselves.
+  static constexpr int32_t kMaxBssPerChannel = 20;
+
+  ChannelCongestionMap() = default;
+
+  // Rebuilds the map from |scan_results|.
+  void Assign(
+      const std::vector<android::net::wifi::nl80211::NativeScanResult>&
+          scan_results);
+  // Returns the congestion of each channel with BSSs, in ascending
+  // frequency order.
+  const std::vector<android::net::wifi::nl80211::NativeChannelCongestion>&
+  GetChannels() const {
+    return channels_;
+  }
+
+ private:
+  std::vector<android::net::wifi::nl80211::NativeChannelCongestion>
+      channels_;
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_SCANNING_CHANNEL_CONGESTION_MAP_H_
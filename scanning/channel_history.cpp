@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/scanning/channel_history.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include <android-base/logging.h>
+#include <android-base/unique_fd.h>
+
+using android::base::unique_fd;
+using std::string;
+using std::vector;
+
+namespace android {
+namespace wificond {
+namespace {
+
+constexpr size_t kHeaderSize = 16;
+constexpr size_t kMaxSsidLength = 32;
+constexpr size_t kFrequencySize = 4;
+
+// Header field offsets.
+constexpr size_t kMagicOffset = 0;
+constexpr size_t kVersionOffset = 4;
+constexpr size_t kEntrySizeOffset = 6;
+constexpr size_t kNumEntriesOffset = 8;
+constexpr size_t kClockOffset = 12;
+
+// Entry field offsets.
+constexpr size_t kSsidLengthOffset = 0;
+constexpr size_t kNumFrequenciesOffset = 1;
+constexpr size_t kLastUpdateOffset = 4;
+constexpr size_t kSsidOffset = 8;
+constexpr size_t kFrequenciesOffset = 40;
+
+constexpr size_t kEntrySize =
+    kFrequenciesOffset + ChannelHistory::kMaxFrequencies * kFrequencySize;
+
+template <typename T>
+void PutField(uint8_t* buffer, size_t offset, T value) {
+  memcpy(buffer + offset, &value, sizeof(value));
+}
+
+template <typename T>
+T GetField(const uint8_t* buffer, size_t offset) {
+  T value;
+  memcpy(&value, buffer + offset, sizeof(value));
+  return value;
+}
+
+// FNV-1a.
+size_t HashSsid(const vector<uint8_t>& ssid) {
+  uint32_t hash = 2166136261u;
+  for (uint8_t byte : ssid) {
+    hash = (hash ^ byte) * 16777619u;
+  }
+  return hash;
+}
+
+bool IsEntryOf(const uint8_t* entry, const vector<uint8_t>& ssid) {
+  return entry[kSsidLengthOffset] == ssid.size() &&
+         memcmp(entry + kSsidOffset, ssid.data(), ssid.size()) == 0;
+}
+
+}  // namespace
+
+ChannelHistory::ChannelHistory() {
+  void* buffer = mmap(nullptr, GetSize(), PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (buffer == MAP_FAILED) {
+    PLOG(ERROR) << "Failed to map channel history";
+    buffer_ = nullptr;
+    return;
+  }
+  buffer_ = static_cast<uint8_t*>(buffer);
+  Reset();
+}
+
+ChannelHistory::~ChannelHistory() {
+  if (buffer_ != nullptr) {
+    munmap(buffer_, GetSize());
+  }
+}
+
+size_t ChannelHistory::GetSize() {
+  return kHeaderSize + kNumEntries * kEntrySize;
+}
+
+bool ChannelHistory::Open(const string& path) {
+  unique_fd fd(TEMP_FAILURE_RETRY(
+      open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600)));
+  if (fd.get() < 0) {
+    PLOG(ERROR) << "Failed to open channel history " << path;
+    return false;
+  }
+  struct stat file_stat;
+  if (fstat(fd.get(), &file_stat) != 0) {
+    PLOG(ERROR) << "Failed to stat channel history " << path;
+    return false;
+  }
+  bool resized = static_cast<size_t>(file_stat.st_size) != GetSize();
+  if (resized && ftruncate(fd.get(), GetSize()) != 0) {
+    PLOG(ERROR) << "Failed to resize channel history " << path;
+    return false;
+  }
+  void* buffer = mmap(nullptr, GetSize(), PROT_READ | PROT_WRITE, MAP_SHARED,
+                      fd.get(), 0);
+  if (buffer == MAP_FAILED) {
+    PLOG(ERROR) << "Failed to map channel history " << path;
+    return false;
+  }
+  if (buffer_ != nullptr) {
+    munmap(buffer_, GetSize());
+  }
+  buffer_ = static_cast<uint8_t*>(buffer);
+  if (resized ||
+      GetField<uint32_t>(buffer_, kMagicOffset) != kMagic ||
+      GetField<uint16_t>(buffer_, kVersionOffset) != kVersion ||
+      GetField<uint16_t>(buffer_, kEntrySizeOffset) != kEntrySize ||
+      GetField<uint32_t>(buffer_, kNumEntriesOffset) != kNumEntries) {
+    LOG(INFO) << "Starting a new channel history in " << path;
+    Reset();
+  }
+  return true;
+}
+
+void ChannelHistory::Reset() {
+  memset(buffer_, 0, GetSize());
+  PutField<uint32_t>(buffer_, kMagicOffset, kMagic);
+  PutField<uint16_t>(buffer_, kVersionOffset, kVersion);
+  PutField<uint16_t>(buffer_, kEntrySizeOffset, kEntrySize);
+  PutField<uint32_t>(buffer_, kNumEntriesOffset, kNumEntries);
+}
+
+uint8_t* ChannelHistory::FindEntry(const vector<uint8_t>& ssid) const {
+  size_t slot = HashSsid(ssid) % kNumEntries;
+  for (size_t i = 0; i < kMaxProbes; i++) {
+    uint8_t* entry =
+        buffer_ + kHeaderSize + (slot + i) % kNumEntries * kEntrySize;
+    if (IsEntryOf(entry, ssid)) {
+      return entry;
+    }
+  }
+  return nullptr;
+}
+
+void ChannelHistory::Add(const vector<uint8_t>& ssid, uint32_t frequency) {
+  // Hidden networks have no SSID in their beacons.
+  if (buffer_ == nullptr || ssid.empty() || ssid.size() > kMaxSsidLength) {
+    return;
+  }
+  uint32_t clock = GetField<uint32_t>(buffer_, kClockOffset) + 1;
+  PutField<uint32_t>(buffer_, kClockOffset, clock);
+
+  uint8_t* entry = FindEntry(ssid);
+  if (entry == nullptr) {
+    // Take a free slot, or else the least recently updated one.
+    size_t slot = HashSsid(ssid) % kNumEntries;
+    uint32_t oldest_age = 0;
+    for (size_t i = 0; i < kMaxProbes; i++) {
+      uint8_t* candidate =
+          buffer_ + kHeaderSize + (slot + i) % kNumEntries * kEntrySize;
+      if (candidate[kSsidLengthOffset] == 0) {
+        entry = candidate;
+        break;
+      }
+      uint32_t age = clock - GetField<uint32_t>(candidate, kLastUpdateOffset);
+      if (entry == nullptr || age > oldest_age) {
+        entry = candidate;
+        oldest_age = age;
+      }
+    }
+    memset(entry, 0, kEntrySize);
+    entry[kSsidLengthOffset] = ssid.size();
+    memcpy(entry + kSsidOffset, ssid.data(), ssid.size());
+  }
+  PutField<uint32_t>(entry, kLastUpdateOffset, clock);
+
+  // Move |frequency| to the front, dropping the least recently seen
+  // frequency if there is no room.
+  size_t num_frequencies =
+      std::min<size_t>(entry[kNumFrequenciesOffset], kMaxFrequencies);
+  size_t position = 0;
+  while (position < num_frequencies &&
+         GetField<uint32_t>(entry, kFrequenciesOffset + position * kFrequencySize) !=
+             frequency) {
+    position++;
+  }
+  if (position == num_frequencies) {
+    if (num_frequencies < kMaxFrequencies) {
+      num_frequencies++;
+    } else {
+      position--;
+    }
+  }
+  memmove(entry + kFrequenciesOffset + kFrequencySize,
+          entry + kFrequenciesOffset,
+          position * kFrequencySize);
+  PutField<uint32_t>(entry, kFrequenciesOffset, frequency);
+  entry[kNumFrequenciesOffset] = num_frequencies;
+}
+
+bool ChannelHistory::Get(const vector<uint8_t>& ssid,
+                         vector<uint32_t>* out_frequencies) const {
+  if (buffer_ == nullptr || ssid.empty() || ssid.size() > kMaxSsidLength) {
+    return false;
+  }
+  const uint8_t* entry = FindEntry(ssid);
+  if (entry == nullptr) {
+    return false;
+  }
+  // The file might have been written by a crashing process.
+  size_t num_frequencies =
+      std::min<size_t>(entry[kNumFrequenciesOffset], kMaxFrequencies);
+  out_frequencies->clear();
+  for (size_t i = 0; i < num_frequencies; i++) {
+    out_frequencies->push_back(
+        GetField<uint32_t>(entry, kFrequenciesOffset + i * kFrequencySize));
+  }
+  return !out_frequencies->empty();
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_SCANNING_CHANNEL_HISTORY_H_
+#define WIFICOND_SCANNING_CHANNEL_HISTORY_H_
+
+#include <string>
+#include <vector>
+
+#include <android-base/macros.h>
+
+namespace android {
+namespace wificond {
+
+// Remembers the channels each SSID was seen on, so that scans for known
+// networks can skip the other channels.
+//
+// The history is a fixed size table that is kept in a memory mapped file, so
+// that it survives restarts without being parsed or written out. Until a file
+// is opened, it is only kept in memory.
+//
+// All fields are in host byte order. The file starts with a header:
+//   offset size
+//   0      4    magic, kMagic
+//   4      2    layout version, kVersion
+//   6      2    entry size in bytes
+//   8      4    number of entries, kNumEntries
+//   12     4    clock, bumped every time an entry is updated
+// Then kNumEntries entries, each one in the slot the hash of its SSID
+// points to, or in one of the following kMaxProbes - 1 slots:
+//   0      1    length of the SSID in bytes, 0 if the slot is free
+//   1      1    number of frequencies
+//   2      2    reserved, 0
+//   4      4    clock when the entry was last updated
+//   8      32   SSID
+//   40     4*n  frequencies in MHz, the most recently seen first
+// A file of another layout is discarded.
+class ChannelHistory {
+ public:
+  static constexpr uint32_t kMagic = 0x57434853;  // "WCHS"
+  static constexpr uint16_t kVersion = 1;
+  static constexpr size_t kNumEntries = 256;
+  static constexpr size_t kMaxProbes = 8;
+  // Number of frequencies kept per SSID.
+  static constexpr size_t kMaxFrequencies = 8;
+
+  ChannelHistory();
+  ~ChannelHistory();
+
+  // Keeps the history in the file at |path|, creating it if needed.
+  // The history kept so far is replaced by the one of the file.
+  // Returns true on success.
+  bool Open(const std::string& path);
+  // Records that |ssid| was seen on |frequency|. If all slots |ssid| can
+  // take are used, the least recently updated SSID is forgotten.
+  void Add(const std::vector<uint8_t>& ssid, uint32_t frequency);
+  // Gets the frequencies |ssid| was seen on, the most recently seen first.
+  // Returns false if there is no history of |ssid|.
+  bool Get(const std::vector<uint8_t>& ssid,
+           std::vector<uint32_t>* out_frequencies) const;
+
+  // Returns the size of the history file.
+  static size_t GetSize();
+
+ private:
+  // Returns the entry of |ssid|, or nullptr if there is none.
+  uint8_t* FindEntry(const std::vector<uint8_t>& ssid) const;
+  // Writes an empty header to |buffer_|.
+  void Reset();
+
+  // Mapping of GetSize() bytes. nullptr if mapping failed.
+  uint8_t* buffer_;
+
+  DISALLOW_COPY_AND_ASSIGN(ChannelHistory);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_SCANNING_CHANNEL_HISTORY_H_
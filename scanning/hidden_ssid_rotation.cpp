@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/scanning/hidden_ssid_rotation.h"
+
+#include <algorithm>
+#include <map>
+#include <numeric>
+#include <vector>
+
+using std::map;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+void HiddenSsidRotation::Pick(const vector<vector<uint8_t>>& ssids,
+                              size_t max_ssids,
+                              vector<vector<uint8_t>>* out_picked,
+                              vector<vector<uint8_t>>* out_skipped) {
+  num_picks_++;
+  // SSIDs that were never picked sort first, with a last pick of 0.
+  vector<uint64_t> last_picked(ssids.size(), 0);
+  for (size_t i = 0; i < ssids.size(); i++) {
+    const auto it = last_picked_.find(ssids[i]);
+    if (it != last_picked_.end()) {
+      last_picked[i] = it->second;
+    }
+  }
+  vector<size_t> order(ssids.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&last_picked](size_t lhs, size_t rhs) {
+                     return last_picked[lhs] < last_picked[rhs];
+                   });
+  vector<bool> picked(ssids.size(), false);
+  for (size_t i = 0; i < std::min(max_ssids, order.size()); i++) {
+    picked[order[i]] = true;
+  }
+
+  map<vector<uint8_t>, uint64_t> updated_last_picked;
+  for (size_t i = 0; i < ssids.size(); i++) {
+    if (picked[i]) {
+      out_picked->push_back(ssids[i]);
+      updated_last_picked[ssids[i]] = num_picks_;
+    } else {
+      out_skipped->push_back(ssids[i]);
+      updated_last_picked.emplace(ssids[i], last_picked[i]);
+    }
+  }
+  last_picked_ = std::move(updated_last_picked);
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_SCANNING_HIDDEN_SSID_ROTATION_H_
+#define WIFICOND_SCANNING_HIDDEN_SSID_ROTATION_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <vector>
+
+#include <android-base/macros.h>
+
+namespace android {
+namespace wificond {
+
+// Picks the hidden SSIDs that single scans probe for, when there are more of
+// them than a scan request has room for.
+// The SSIDs that were probed the longest ago are picked first, so that as
+// long as the same n SSIDs are asked for with room for k of them, each one
+// is probed at least once every ceil(n / k) scans.
+class HiddenSsidRotation {
+ public:
+  HiddenSsidRotation() = default;
+  ~HiddenSsidRotation() = default;
+
+  // Picks up to |max_ssids| of |ssids| to probe for in the next scan and
+  // appends them to |*out_picked|, in the order of |ssids|. The others are
+  // appended to |*out_skipped|. Among SSIDs that were probed as long ago,
+  // the ones that come first in |ssids| are picked.
+  void Pick(const std::vector<std::vector<uint8_t>>& ssids,
+            size_t max_ssids,
+            std::vector<std::vector<uint8_t>>* out_picked,
+            std::vector<std::vector<uint8_t>>* out_skipped);
+
+ private:
+  uint64_t num_picks_ = 0;
+  // Number of the Pick() call each SSID was last picked in. Only holds the
+  // SSIDs of the last Pick() call.
+  std::map<std::vector<uint8_t>, uint64_t> last_picked_;
+
+  DISALLOW_COPY_AND_ASSIGN(HiddenSsidRotation);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_SCANNING_HIDDEN_SSID_ROTATION_H_
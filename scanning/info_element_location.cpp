@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/logging.h>
+
+#include "wificond/parcelable_utils.h"
+#include "wificond/scanning/info_element_location.h"
+
+using android::status_t;
+
+namespace android {
+namespace net {
+namespace wifi {
+namespace nl80211 {
+
+status_t InfoElementLocation::writeToParcel(::android::Parcel* parcel) const {
+  RETURN_IF_FAILED(parcel->writeInt32(id));
+  RETURN_IF_FAILED(parcel->writeInt32(extension_id));
+  RETURN_IF_FAILED(parcel->writeInt32(offset));
+  RETURN_IF_FAILED(parcel->writeInt32(length));
+  return ::android::OK;
+}
+
+status_t InfoElementLocation::readFromParcel(const ::android::Parcel* parcel) {
+  RETURN_IF_FAILED(parcel->readInt32(&id));
+  RETURN_IF_FAILED(parcel->readInt32(&extension_id));
+  RETURN_IF_FAILED(parcel->readInt32(&offset));
+  RETURN_IF_FAILED(parcel->readInt32(&length));
+  return ::android::OK;
+}
+
+}  // namespace nl80211
+}  // namespace wifi
+}  // namespace net
+}  // namespace android
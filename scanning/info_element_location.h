@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_SCANNING_INFO_ELEMENT_LOCATION_H_
+#define WIFICOND_SCANNING_INFO_ELEMENT_LOCATION_H_
+
+#include <binder/Parcel.h>
+#include <binder/Parcelable.h>
+
+namespace android {
+namespace net {
+namespace wifi {
+namespace nl80211 {
+
+// Location of one information element within the information elements of a
+// scan result.
+class InfoElementLocation : public ::android::Parcelable {
+ public:
+  InfoElementLocation(int32_t id,
+                      int32_t extension_id,
+                      int32_t offset,
+                      int32_t length)
+      : id(id), extension_id(extension_id), offset(offset), length(length) {}
+  InfoElementLocation()
+      : id(0), extension_id(0), offset(0), length(0) {}
+  bool operator==(const InfoElementLocation& rhs) const {
+    return id == rhs.id && extension_id == rhs.extension_id &&
+           offset == rhs.offset && length == rhs.length;
+  }
+  ::android::status_t writeToParcel(::android::Parcel* parcel) const override;
+  ::android::status_t readFromParcel(const ::android::Parcel* parcel) override;
+
+  // Element ID.
+  int32_t id;
+  // Element ID Extension, for elements with Element ID 255. 0 otherwise.
+  int32_t extension_id;
+  // Offset of the element payload, which follows the Element ID and Length
+  // fields. For elements with Element ID 255 the payload starts with the
+  // Element ID Extension.
+  int32_t offset;
+  // Length of the element payload in bytes.
+  int32_t length;
+};
+
+}  // namespace nl80211
+}  // namespace wifi
+}  // namespace net
+}  // namespace android
+
+#endif  // WIFICOND_SCANNING_INFO_ELEMENT_LOCATION_H_
@@ -0,0 +1,448 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/scanning/info_element_utils.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "android/net/wifi/nl80211/IWifiScannerImpl.h"
+
+using android::net::wifi::nl80211::IWifiScannerImpl;
+using android::net::wifi::nl80211::InfoElementLocation;
+using android::net::wifi::nl80211::NativeScanResult;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr uint8_t kElemIdSsid = 0;
+constexpr uint8_t kElemIdBssLoad = 11;
+constexpr uint8_t kElemIdHtCapabilities = 45;
+constexpr uint8_t kElemIdRsn = 48;
+constexpr uint8_t kElemIdHtOperation = 61;
+constexpr uint8_t kElemIdVhtCapabilities = 191;
+constexpr uint8_t kElemIdVhtOperation = 192;
+constexpr uint8_t kElemIdReducedNeighborReport = 201;
+constexpr uint8_t kElemIdVendorSpecific = 221;
+constexpr uint8_t kElemIdExtension = 255;
+constexpr uint8_t kElemIdExtHeCapabilities = 35;
+constexpr uint8_t kElemIdExtHeOperation = 36;
+constexpr uint8_t kElemIdExtEhtCapabilities = 108;
+
+// Bit 4 of the capability field.
+constexpr uint16_t kCapabilityPrivacy = 1 << 4;
+
+constexpr size_t kSuiteSelectorSize = 4;
+const uint8_t kRsnOui[] = {0x00, 0x0f, 0xac};
+const uint8_t kWpaOui[] = {0x00, 0x50, 0xf2};
+constexpr uint8_t kWpaVendorType = 1;
+
+// HE Operation Parameters bits. See IEEE Std 802.11ax: 9.4.2.249
+constexpr uint32_t kHeOperationVhtInfoPresent = 1 << 14;
+constexpr uint32_t kHeOperationCoHostedBss = 1 << 15;
+constexpr uint32_t kHeOperation6GhzInfoPresent = 1 << 17;
+
+// Reduced Neighbor Report TBTT Information Header fields.
+// See IEEE Std 802.11ax: 9.4.2.170.2
+constexpr uint16_t kTbttInfoFieldTypeMask = 0x0003;
+constexpr int kTbttInfoCountShift = 4;
+constexpr uint16_t kTbttInfoCountMask = 0x000f;
+constexpr int kTbttInfoLengthShift = 8;
+// TBTT Information Header, Operating Class and Channel Number.
+constexpr size_t kNeighborApInfoHeaderSize = 4;
+// Offsets in the TBTT Information field, after the Neighbor AP TBTT Offset.
+constexpr size_t kTbttInfoBssidOffset = 1;
+
+uint16_t GetLe16(const uint8_t* ptr) {
+  return ptr[0] | (ptr[1] << 8);
+}
+
+uint32_t GetLe32(const uint8_t* ptr) {
+  return ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) |
+         (static_cast<uint32_t>(ptr[3]) << 24);
+}
+
+// Returns the frequency of channel |channel| of global operating class
+// |operating_class|, or 0 if the operating class is unknown.
+// See IEEE Std 802.11: Table E-4 Global operating classes.
+uint32_t GetOperatingClassFrequency(uint8_t operating_class,
+                                    uint8_t channel) {
+  if (operating_class == 81) {
+    return 2407 + 5 * channel;
+  }
+  if (operating_class == 82) {
+    return 2484;
+  }
+  if (operating_class >= 115 && operating_class <= 130) {
+    return 5000 + 5 * channel;
+  }
+  if (operating_class == 136) {
+    // The only 20 MHz channel below channel 1.
+    return 5935;
+  }
+  if (operating_class >= 131 && operating_class <= 137) {
+    return 5950 + 5 * channel;
+  }
+  return 0;
+}
+
+// Decodes the Neighbor AP Information fields of a Reduced Neighbor Report
+// element that spans |ptr| to |end|.
+void DecodeReducedNeighborReport(const uint8_t* ptr,
+                                 const uint8_t* end,
+                                 vector<ReducedNeighbor>* neighbors) {
+  while (static_cast<size_t>(end - ptr) >= kNeighborApInfoHeaderSize) {
+    uint16_t header = GetLe16(ptr);
+    size_t count = ((header >> kTbttInfoCountShift) & kTbttInfoCountMask) + 1;
+    size_t length = header >> kTbttInfoLengthShift;
+    uint32_t frequency = GetOperatingClassFrequency(ptr[2], ptr[3]);
+    ptr += kNeighborApInfoHeaderSize;
+    if (static_cast<size_t>(end - ptr) < count * length) {
+      return;
+    }
+    // Only TBTT Information field type 0 is defined.
+    bool known_type = (header & kTbttInfoFieldTypeMask) == 0;
+    for (size_t i = 0; i < count; i++, ptr += length) {
+      if (frequency == 0) {
+        continue;
+      }
+      ReducedNeighbor neighbor;
+      neighbor.frequency = frequency;
+      // The TBTT Information field carries a BSSID, a Short SSID, or both,
+      // depending on its length.
+      const uint8_t* short_ssid = nullptr;
+      if (known_type) {
+        switch (length) {
+          case 5:
+          case 6:
+            short_ssid = ptr + 1;
+            break;
+          case 7:
+          case 8:
+          case 9:
+            neighbor.has_bssid = true;
+            break;
+          default:
+            if (length >= 11) {
+              neighbor.has_bssid = true;
+              short_ssid = ptr + kTbttInfoBssidOffset + ETH_ALEN;
+            }
+            break;
+        }
+      }
+      if (neighbor.has_bssid) {
+        std::copy(ptr + kTbttInfoBssidOffset,
+                  ptr + kTbttInfoBssidOffset + ETH_ALEN,
+                  neighbor.bssid.begin());
+      }
+      if (short_ssid != nullptr) {
+        neighbor.has_short_ssid = true;
+        neighbor.short_ssid = GetLe32(short_ssid);
+      }
+      neighbors->push_back(neighbor);
+    }
+  }
+}
+
+// Returns the |IWifiScannerImpl::SCAN_RESULT_SECURITY_*| bit of AKM suite
+// |suite_type|. RSN and WPA AKM suite types share their meaning.
+int32_t GetAkmSuiteSecurity(uint8_t suite_type) {
+  switch (suite_type) {
+    case 1:   // 802.1X
+    case 3:   // FT over 802.1X
+    case 5:   // 802.1X with SHA-256
+    case 11:  // Suite B
+    case 12:  // Suite B 192-bit
+    case 13:  // FT over 802.1X with SHA-384
+      return IWifiScannerImpl::SCAN_RESULT_SECURITY_EAP;
+    case 2:   // PSK
+    case 4:   // FT with PSK
+    case 6:   // PSK with SHA-256
+    case 19:  // FT with PSK and SHA-384
+    case 20:  // PSK with SHA-384
+      return IWifiScannerImpl::SCAN_RESULT_SECURITY_PSK;
+    case 8:   // SAE
+    case 9:   // FT over SAE
+    case 24:  // SAE with group-dependent hash
+    case 25:  // FT over SAE with group-dependent hash
+      return IWifiScannerImpl::SCAN_RESULT_SECURITY_SAE;
+    case 18:  // OWE
+      return IWifiScannerImpl::SCAN_RESULT_SECURITY_OWE;
+    default:
+      return 0;
+  }
+}
+
+// Decodes the AKM suites of a RSN element, or of a WPA element after its
+// OUI and vendor type. Both start with a version, a group data cipher suite,
+// a pairwise cipher suite list and an AKM suite list.
+int32_t DecodeAkmSuites(const uint8_t* ptr,
+                        const uint8_t* end,
+                        const uint8_t* oui) {
+  // The AKM suite list defaults to 802.1X if it is left out.
+  if (end - ptr < 2 + 4 + 2) {
+    return IWifiScannerImpl::SCAN_RESULT_SECURITY_EAP;
+  }
+  size_t num_pairwise_suites = GetLe16(ptr + 6);
+  ptr += 8;
+  if (static_cast<size_t>(end - ptr) / kSuiteSelectorSize <
+      num_pairwise_suites) {
+    return 0;
+  }
+  ptr += num_pairwise_suites * kSuiteSelectorSize;
+  if (end - ptr < 2) {
+    return IWifiScannerImpl::SCAN_RESULT_SECURITY_EAP;
+  }
+  size_t num_akm_suites = GetLe16(ptr);
+  ptr += 2;
+  int32_t security = 0;
+  for (size_t i = 0;
+       i < num_akm_suites &&
+           static_cast<size_t>(end - ptr) >= kSuiteSelectorSize;
+       i++, ptr += kSuiteSelectorSize) {
+    if (memcmp(ptr, oui, 3) == 0) {
+      security |= GetAkmSuiteSecurity(ptr[3]);
+    }
+  }
+  return security;
+}
+
+int32_t DecodeSecurity(const uint8_t* ie,
+                       const vector<InfoElementLocation>& index,
+                       uint16_t capability) {
+  int32_t security = 0;
+  for (const auto& location : index) {
+    const uint8_t* payload = ie + location.offset;
+    const uint8_t* end = payload + location.length;
+    if (location.id == kElemIdRsn) {
+      security |= IWifiScannerImpl::SCAN_RESULT_SECURITY_RSN |
+                  DecodeAkmSuites(payload, end, kRsnOui);
+    } else if (location.id == kElemIdVendorSpecific &&
+               location.length >= 4 &&
+               memcmp(payload, kWpaOui, 3) == 0 &&
+               payload[3] == kWpaVendorType) {
+      security |= IWifiScannerImpl::SCAN_RESULT_SECURITY_WPA |
+                  DecodeAkmSuites(payload + 4, end, kWpaOui);
+    }
+  }
+  if (security == 0 && (capability & kCapabilityPrivacy)) {
+    security = IWifiScannerImpl::SCAN_RESULT_SECURITY_WEP;
+  }
+  return security;
+}
+
+// Returns the width of a channel that is at least 80 MHz wide, from its
+// channel center frequency segments.
+int32_t GetWideChannelWidth(uint8_t segment0, uint8_t segment1) {
+  if (segment1 == 0) {
+    return IWifiScannerImpl::SCAN_RESULT_CHANNEL_WIDTH_80MHZ;
+  }
+  int distance = abs(segment1 - segment0);
+  if (distance == 8) {
+    return IWifiScannerImpl::SCAN_RESULT_CHANNEL_WIDTH_160MHZ;
+  }
+  if (distance > 16) {
+    return IWifiScannerImpl::SCAN_RESULT_CHANNEL_WIDTH_80P80MHZ;
+  }
+  return IWifiScannerImpl::SCAN_RESULT_CHANNEL_WIDTH_80MHZ;
+}
+
+int32_t DecodeChannelWidth(const uint8_t* ie,
+                           const vector<InfoElementLocation>& index) {
+  int32_t channel_width = IWifiScannerImpl::SCAN_RESULT_CHANNEL_WIDTH_UNKNOWN;
+  // See IEEE Std 802.11: 9.4.2.57 HT Operation element.
+  const InfoElementLocation* ht_operation =
+      InfoElementUtils::Find(index, kElemIdHtOperation);
+  if (ht_operation != nullptr && ht_operation->length >= 2) {
+    // A secondary channel offset makes the channel 40 MHz wide.
+    channel_width = (ie[ht_operation->offset + 1] & 0x03) ?
+        IWifiScannerImpl::SCAN_RESULT_CHANNEL_WIDTH_40MHZ :
+        IWifiScannerImpl::SCAN_RESULT_CHANNEL_WIDTH_20MHZ;
+  }
+  // See IEEE Std 802.11: 9.4.2.159 VHT Operation element.
+  const InfoElementLocation* vht_operation =
+      InfoElementUtils::Find(index, kElemIdVhtOperation);
+  if (vht_operation != nullptr && vht_operation->length >= 3) {
+    const uint8_t* payload = ie + vht_operation->offset;
+    switch (payload[0]) {
+      case 1:
+        channel_width = GetWideChannelWidth(payload[1], payload[2]);
+        break;
+      case 2:
+        channel_width = IWifiScannerImpl::SCAN_RESULT_CHANNEL_WIDTH_160MHZ;
+        break;
+      case 3:
+        channel_width = IWifiScannerImpl::SCAN_RESULT_CHANNEL_WIDTH_80P80MHZ;
+        break;
+      default:
+        // 20 or 40 MHz, as given by the HT Operation element.
+        break;
+    }
+  }
+  // 6 GHz BSSs only carry their channel width in the HE Operation element.
+  const InfoElementLocation* he_operation =
+      InfoElementUtils::Find(index, kElemIdExtension, kElemIdExtHeOperation);
+  if (he_operation != nullptr && he_operation->length >= 7) {
+    const uint8_t* payload = ie + he_operation->offset;
+    uint32_t parameters = payload[1] | (payload[2] << 8) | (payload[3] << 16);
+    // Element ID Extension, HE Operation Parameters, BSS Color Information
+    // and Basic HE-MCS And NSS Set.
+    size_t offset = 7;
+    if (parameters & kHeOperationVhtInfoPresent) {
+      offset += 3;
+    }
+    if (parameters & kHeOperationCoHostedBss) {
+      offset += 1;
+    }
+    // The 6 GHz Operation Information field is 5 bytes long.
+    if ((parameters & kHeOperation6GhzInfoPresent) &&
+        static_cast<size_t>(he_operation->length) >= offset + 5) {
+      const uint8_t* info = payload + offset;
+      switch (info[1] & 0x03) {
+        case 0:
+          channel_width = IWifiScannerImpl::SCAN_RESULT_CHANNEL_WIDTH_20MHZ;
+          break;
+        case 1:
+          channel_width = IWifiScannerImpl::SCAN_RESULT_CHANNEL_WIDTH_40MHZ;
+          break;
+        case 2:
+          channel_width = IWifiScannerImpl::SCAN_RESULT_CHANNEL_WIDTH_80MHZ;
+          break;
+        case 3:
+          channel_width = GetWideChannelWidth(info[2], info[3]);
+          break;
+      }
+    }
+  }
+  return channel_width;
+}
+
+int32_t DecodeWifiStandard(const vector<InfoElementLocation>& index) {
+  if (InfoElementUtils::Find(index, kElemIdExtension,
+                             kElemIdExtEhtCapabilities) != nullptr) {
+    return IWifiScannerImpl::SCAN_RESULT_WIFI_STANDARD_11BE;
+  }
+  if (InfoElementUtils::Find(index, kElemIdExtension,
+                             kElemIdExtHeCapabilities) != nullptr) {
+    return IWifiScannerImpl::SCAN_RESULT_WIFI_STANDARD_11AX;
+  }
+  if (InfoElementUtils::Find(index, kElemIdVhtCapabilities) != nullptr) {
+    return IWifiScannerImpl::SCAN_RESULT_WIFI_STANDARD_11AC;
+  }
+  if (InfoElementUtils::Find(index, kElemIdHtCapabilities) != nullptr) {
+    return IWifiScannerImpl::SCAN_RESULT_WIFI_STANDARD_11N;
+  }
+  return IWifiScannerImpl::SCAN_RESULT_WIFI_STANDARD_LEGACY;
+}
+
+}  // namespace
+
+bool InfoElementUtils::IndexInfoElements(const uint8_t* ie,
+                                         size_t ie_length,
+                                         vector<InfoElementLocation>* index) {
+  index->clear();
+  // Information elements are stored in 'TLV' format.
+  // Field:  |   Type     |          Length           |      Value      |
+  // Length: |     1      |             1             |     variable    |
+  // Content:| Element ID | Length of the Value field | Element payload |
+  size_t offset = 0;
+  while (offset + 2 <= ie_length) {
+    uint8_t id = ie[offset];
+    uint8_t length = ie[offset + 1];
+    offset += 2;
+    if (length > ie_length - offset) {
+      return false;
+    }
+    uint8_t extension_id = 0;
+    if (id == kElemIdExtension && length > 0) {
+      extension_id = ie[offset];
+    }
+    index->emplace_back(id, extension_id, offset, length);
+    offset += length;
+  }
+  return offset == ie_length;
+}
+
+const InfoElementLocation* InfoElementUtils::Find(
+    const vector<InfoElementLocation>& index,
+    uint8_t id,
+    uint8_t extension_id) {
+  for (const auto& location : index) {
+    if (location.id == id &&
+        (id != kElemIdExtension || location.extension_id == extension_id)) {
+      return &location;
+    }
+  }
+  return nullptr;
+}
+
+bool InfoElementUtils::GetSsid(const uint8_t* ie,
+                               const vector<InfoElementLocation>& index,
+                               vector<uint8_t>* ssid) {
+  const InfoElementLocation* location = Find(index, kElemIdSsid);
+  if (location == nullptr) {
+    return false;
+  }
+  const uint8_t* payload = ie + location->offset;
+  ssid->assign(payload, payload + location->length);
+  return true;
+}
+
+void InfoElementUtils::DecodeInfoElements(
+    const uint8_t* ie,
+    const vector<InfoElementLocation>& index,
+    uint16_t capability,
+    NativeScanResult* scan_result) {
+  scan_result->security = DecodeSecurity(ie, index, capability);
+  scan_result->channel_width = DecodeChannelWidth(ie, index);
+  scan_result->wifi_standard = DecodeWifiStandard(index);
+}
+
+bool InfoElementUtils::GetBssLoad(const uint8_t* ie,
+                                  const vector<InfoElementLocation>& index,
+                                  BssLoad* bss_load) {
+  // Station Count (2 bytes, little endian), Channel Utilization (1 byte)
+  // and Available Admission Capacity (2 bytes).
+  const InfoElementLocation* location = Find(index, kElemIdBssLoad);
+  if (location == nullptr || location->length < 5) {
+    return false;
+  }
+  const uint8_t* payload = ie + location->offset;
+  bss_load->station_count = payload[0] | (payload[1] << 8);
+  bss_load->channel_utilization = payload[2];
+  return true;
+}
+
+void InfoElementUtils::GetReducedNeighbors(
+    const uint8_t* ie,
+    const vector<InfoElementLocation>& index,
+    vector<ReducedNeighbor>* neighbors) {
+  for (const auto& location : index) {
+    if (location.id == kElemIdReducedNeighborReport) {
+      const uint8_t* payload = ie + location.offset;
+      DecodeReducedNeighborReport(payload, payload + location.length,
+                                  neighbors);
+    }
+  }
+}
+
+}  // namespace wificond
+}  // namespace android
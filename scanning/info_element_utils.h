@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_SCANNING_INFO_ELEMENT_UTILS_H_
+#define WIFICOND_SCANNING_INFO_ELEMENT_UTILS_H_
+
+#include <array>
+#include <vector>
+
+#include <linux/if_ether.h>
+
+#include <android-base/macros.h>
+
+#include "wificond/scanning/info_element_location.h"
+#include "wificond/scanning/scan_result.h"
+
+namespace android {
+namespace wificond {
+
+// An AP that a Reduced Neighbor Report element of a scan result lists, e.g.
+// a 6 GHz AP colocated with a 2.4 or 5 GHz one.
+// See IEEE Std 802.11ax: 9.4.2.170 Reduced Neighbor Report element.
+struct ReducedNeighbor {
+  uint32_t frequency = 0;
+  bool has_bssid = false;
+  std::array<uint8_t, ETH_ALEN> bssid{};
+  // The short SSID is the CRC-32 of the SSID of the AP.
+  bool has_short_ssid = false;
+  uint32_t short_ssid = 0;
+};
+
+// Load of a BSS, from its BSS Load element.
+// See IEEE Std 802.11: 9.4.2.27 BSS Load element.
+struct BssLoad {
+  // Stations associated with the BSS.
+  uint16_t station_count = 0;
+  // Fraction of time the AP sensed the medium busy, scaled to 255.
+  uint8_t channel_utilization = 0;
+};
+
+// Parses the information elements of scan results in a single pass, so that
+// their consumers do not have to walk the elements again.
+class InfoElementUtils {
+ public:
+  InfoElementUtils() = default;
+
+  // Indexes the |ie_length| bytes of information elements at |ie|.
+  // Returns false if an element overruns the information elements, in which
+  // case the elements before it are still indexed.
+  static bool IndexInfoElements(
+      const uint8_t* ie,
+      size_t ie_length,
+      std::vector<android::net::wifi::nl80211::InfoElementLocation>* index);
+  // Returns the first element with Element ID |id| in |index|, or nullptr.
+  // For Element ID 255, |extension_id| is the Element ID Extension to find.
+  static const android::net::wifi::nl80211::InfoElementLocation* Find(
+      const std::vector<android::net::wifi::nl80211::InfoElementLocation>&
+          index,
+      uint8_t id,
+      uint8_t extension_id = 0);
+  // Copies the SSID of the information elements at |ie| to |ssid|.
+  // Returns false if there is no SSID element.
+  static bool GetSsid(
+      const uint8_t* ie,
+      const std::vector<android::net::wifi::nl80211::InfoElementLocation>&
+          index,
+      std::vector<uint8_t>* ssid);
+  // Fills the security, channel width and Wi-Fi standard of |scan_result|
+  // from the indexed information elements at |ie|.
+  // |capability| is the capability field of the BSS, which tells WEP
+  // apart from open networks.
+  static void DecodeInfoElements(
+      const uint8_t* ie,
+      const std::vector<android::net::wifi::nl80211::InfoElementLocation>&
+          index,
+      uint16_t capability,
+      android::net::wifi::nl80211::NativeScanResult* scan_result);
+  // Copies the BSS Load element of the indexed information elements at |ie|
+  // to |bss_load|.
+  // Returns false if there is no valid BSS Load element.
+  static bool GetBssLoad(
+      const uint8_t* ie,
+      const std::vector<android::net::wifi::nl80211::InfoElementLocation>&
+          index,
+      BssLoad* bss_load);
+  // Appends the APs that the Reduced Neighbor Report elements of the indexed
+  // information elements at |ie| list to |neighbors|. APs on channels of
+  // unknown operating classes are skipped.
+  static void GetReducedNeighbors(
+      const uint8_t* ie,
+      const std::vector<android::net::wifi::nl80211::InfoElementLocation>&
+          index,
+      std::vector<ReducedNeighbor>* neighbors);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(InfoElementUtils);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_SCANNING_INFO_ELEMENT_UTILS_H_
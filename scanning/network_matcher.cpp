@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/scanning/network_matcher.h"
+
+#include <algorithm>
+#include <cstring>
+
+using std::array;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+// Compares two SSIDs zero-padded to |length| bytes, 8 bytes at a time.
+// There is no early exit, so that the loop is vectorized.
+bool PaddedSsidEquals(const uint8_t* lhs, const uint8_t* rhs, size_t length) {
+  uint64_t diff = 0;
+  for (size_t i = 0; i < length; i += sizeof(uint64_t)) {
+    uint64_t lhs_word;
+    uint64_t rhs_word;
+    memcpy(&lhs_word, lhs + i, sizeof(lhs_word));
+    memcpy(&rhs_word, rhs + i, sizeof(rhs_word));
+    diff |= lhs_word ^ rhs_word;
+  }
+  return diff == 0;
+}
+
+}  // namespace
+
+constexpr size_t SsidMatcher::kMaxSsidLength;
+
+SsidMatcher::SsidMatcher(const vector<vector<uint8_t>>& ssids) {
+  entries_.reserve(ssids.size());
+  for (const auto& ssid : ssids) {
+    Add(ssid);
+  }
+}
+
+void SsidMatcher::Add(const vector<uint8_t>& ssid) {
+  if (ssid.size() > kMaxSsidLength) {
+    long_ssids_.push_back(ssid);
+    return;
+  }
+  Entry entry;
+  entry.hash = Hash(ssid.data(), ssid.size());
+  entry.length = ssid.size();
+  entry.padded_ssid.fill(0);
+  std::copy(ssid.begin(), ssid.end(), entry.padded_ssid.begin());
+  auto position = std::upper_bound(
+      entries_.begin(), entries_.end(), entry.hash,
+      [](uint32_t hash, const Entry& other) { return hash < other.hash; });
+  entries_.insert(position, entry);
+  length_mask_ |= uint64_t{1} << ssid.size();
+}
+
+bool SsidMatcher::Matches(const uint8_t* ssid, size_t length) const {
+  if (length > kMaxSsidLength) {
+    for (const auto& long_ssid : long_ssids_) {
+      if (long_ssid.size() == length &&
+          memcmp(long_ssid.data(), ssid, length) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+  if ((length_mask_ & (uint64_t{1} << length)) == 0) {
+    return false;
+  }
+  const uint32_t hash = Hash(ssid, length);
+  auto entry = std::lower_bound(
+      entries_.begin(), entries_.end(), hash,
+      [](const Entry& other, uint32_t hash) { return other.hash < hash; });
+  if (entry == entries_.end() || entry->hash != hash) {
+    return false;
+  }
+  array<uint8_t, kMaxSsidLength> padded_ssid = {};
+  memcpy(padded_ssid.data(), ssid, length);
+  for (; entry != entries_.end() && entry->hash == hash; ++entry) {
+    if (entry->length == length &&
+        PaddedSsidEquals(entry->padded_ssid.data(), padded_ssid.data(),
+                         kMaxSsidLength)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+uint32_t SsidMatcher::Hash(const uint8_t* ssid, size_t length) {
+  // FNV-1a.
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; i++) {
+    hash = (hash ^ ssid[i]) * 16777619u;
+  }
+  return hash;
+}
+
+bool BssidMatcher::Add(const vector<uint8_t>& bssid) {
+  if (bssid.size() != ETH_ALEN) {
+    return false;
+  }
+  uint64_t key = ToKey(bssid.data());
+  bssids_.insert(std::upper_bound(bssids_.begin(), bssids_.end(), key), key);
+  return true;
+}
+
+bool BssidMatcher::Matches(const array<uint8_t, ETH_ALEN>& bssid) const {
+  return Matches(bssid.data());
+}
+
+bool BssidMatcher::Matches(const uint8_t* bssid) const {
+  return std::binary_search(bssids_.begin(), bssids_.end(), ToKey(bssid));
+}
+
+uint64_t BssidMatcher::ToKey(const uint8_t* bssid) {
+  uint64_t key = 0;
+  memcpy(&key, bssid, ETH_ALEN);
+  return key;
+}
+
+}  // namespace wificond
+}  // namespace android
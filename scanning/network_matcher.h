@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_SCANNING_NETWORK_MATCHER_H_
+#define WIFICOND_SCANNING_NETWORK_MATCHER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <vector>
+
+#include <linux/if_ether.h>
+
+namespace android {
+namespace wificond {
+
+// Set of SSIDs, e.g. those of saved networks or PNO match sets, that scan
+// results are matched against. A candidate SSID is first checked against
+// the lengths and hashes of the set, so that most candidates are rejected
+// without comparing any bytes. The remaining ones are compared as
+// zero-padded 32 byte blocks, in a loop without branches that the compiler
+// vectorizes.
+class SsidMatcher {
+ public:
+  SsidMatcher() = default;
+  explicit SsidMatcher(const std::vector<std::vector<uint8_t>>& ssids);
+
+  void Add(const std::vector<uint8_t>& ssid);
+  bool empty() const { return entries_.empty() && long_ssids_.empty(); }
+
+  // Returns true if the |length| bytes at |ssid| are one of the SSIDs of
+  // the set.
+  bool Matches(const uint8_t* ssid, size_t length) const;
+  bool Matches(const std::vector<uint8_t>& ssid) const {
+    return Matches(ssid.data(), ssid.size());
+  }
+
+ private:
+  // SSIDs are at most this long, see IEEE 802.11 9.4.2.2.
+  static constexpr size_t kMaxSsidLength = 32;
+
+  struct Entry {
+    uint32_t hash;
+    uint32_t length;
+    std::array<uint8_t, kMaxSsidLength> padded_ssid;
+  };
+
+  static uint32_t Hash(const uint8_t* ssid, size_t length);
+
+  // Sorted by hash.
+  std::vector<Entry> entries_;
+  // Bit i is set if the set has an SSID of length i.
+  uint64_t length_mask_ = 0;
+  // SSIDs longer than |kMaxSsidLength|, which are not valid but still
+  // compared exactly.
+  std::vector<std::vector<uint8_t>> long_ssids_;
+};
+
+// Set of BSSIDs, e.g. those of blocked APs. BSSIDs are kept as integers, so
+// that each candidate is found with a binary search of integer compares.
+class BssidMatcher {
+ public:
+  BssidMatcher() = default;
+
+  // Adds |bssid|. Returns false, and does not add it, if it is not
+  // |ETH_ALEN| bytes long.
+  bool Add(const std::vector<uint8_t>& bssid);
+  bool empty() const { return bssids_.empty(); }
+
+  bool Matches(const std::array<uint8_t, ETH_ALEN>& bssid) const;
+  bool Matches(const uint8_t* bssid) const;
+
+ private:
+  static uint64_t ToKey(const uint8_t* bssid);
+
+  // Sorted.
+  std::vector<uint64_t> bssids_;
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_SCANNING_NETWORK_MATCHER_H_
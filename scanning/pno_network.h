@@ -32,7 +32,9 @@ class PnoNetwork : public ::android::Parcelable {
   PnoNetwork() = default;
   bool operator==(const PnoNetwork& rhs) const {
     return is_hidden_ == rhs.is_hidden_ &&
-           ssid_ == rhs.ssid_;
+           ssid_ == rhs.ssid_ &&
+           num_connections_ == rhs.num_connections_ &&
+           last_connected_ms_ == rhs.last_connected_ms_;
   }
   ::android::status_t writeToParcel(::android::Parcel* parcel) const override;
   ::android::status_t readFromParcel(const ::android::Parcel* parcel) override;
@@ -40,6 +42,13 @@ class PnoNetwork : public ::android::Parcelable {
   bool is_hidden_;
   std::vector<uint8_t> ssid_;
   std::vector<int32_t> frequencies_;
+  // Usage hints to prioritize networks when firmware can not match all of
+  // them: how many times this network was connected to, and when it was last
+  // connected to (0 if never).
+  // They are not part of the parcel of a network, but of the optional tail
+  // of PnoSettings, so that the layout of the list stays the framework's.
+  int32_t num_connections_ = 0;
+  int64_t last_connected_ms_ = 0;
 };
 
 }  // namespace nl80211
@@ -42,6 +42,12 @@ status_t PnoSettings::writeToParcel(::android::Parcel* parcel) const {
     RETURN_IF_FAILED(parcel->writeInt32(1));
     RETURN_IF_FAILED(network.writeToParcel(parcel));
   }
+  // Optional tail, after the layout that the framework has always written.
+  RETURN_IF_FAILED(parcel->writeInt32(enable_network_rotation_ ? 1 : 0));
+  for (const auto& network : pno_networks_) {
+    RETURN_IF_FAILED(parcel->writeInt32(network.num_connections_));
+    RETURN_IF_FAILED(parcel->writeInt64(network.last_connected_ms_));
+  }
   return ::android::OK;
 }
 
@@ -67,6 +73,18 @@ status_t PnoSettings::readFromParcel(const ::android::Parcel* parcel) {
     RETURN_IF_FAILED(network.readFromParcel(parcel));
     pno_networks_.push_back(network);
   }
+  // Framework versions that do not know about the optional tail end the
+  // parcel here, and get the defaults.
+  if (parcel->dataAvail() == 0) {
+    return ::android::OK;
+  }
+  int32_t enable_network_rotation = 0;
+  RETURN_IF_FAILED(parcel->readInt32(&enable_network_rotation));
+  enable_network_rotation_ = (enable_network_rotation != 0);
+  for (auto& network : pno_networks_) {
+    RETURN_IF_FAILED(parcel->readInt32(&network.num_connections_));
+    RETURN_IF_FAILED(parcel->readInt64(&network.last_connected_ms_));
+  }
   return ::android::OK;
 }
 
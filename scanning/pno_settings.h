@@ -38,12 +38,14 @@ class PnoSettings : public ::android::Parcelable {
       : interval_ms_(0),
         min_2g_rssi_(0),
         min_5g_rssi_(0),
-        min_6g_rssi_(0) {}
+        min_6g_rssi_(0),
+        enable_network_rotation_(false) {}
   bool operator==(const PnoSettings& rhs) const {
     return (pno_networks_ == rhs.pno_networks_ &&
             min_2g_rssi_ == rhs.min_2g_rssi_ &&
             min_5g_rssi_ == rhs.min_5g_rssi_ &&
-            min_6g_rssi_ == rhs.min_6g_rssi_);
+            min_6g_rssi_ == rhs.min_6g_rssi_ &&
+            enable_network_rotation_ == rhs.enable_network_rotation_);
   }
   ::android::status_t writeToParcel(::android::Parcel* parcel) const override;
   ::android::status_t readFromParcel(const ::android::Parcel* parcel) override;
@@ -53,6 +55,11 @@ class PnoSettings : public ::android::Parcelable {
   int32_t min_5g_rssi_;
   int32_t min_6g_rssi_;
   std::vector<PnoNetwork> pno_networks_;
+  // When there are more networks than firmware can match, take turns
+  // matching the lower priority ones instead of leaving them out.
+  // This and the usage hints of |pno_networks_| are an optional tail of the
+  // parcel, which older framework versions do not write.
+  bool enable_network_rotation_;
 };
 
 }  // namespace nl80211
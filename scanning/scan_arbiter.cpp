@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/scanning/scan_arbiter.h"
+
+#include <algorithm>
+
+#include <private/android_filesystem_config.h>
+
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+ScanArbiter::ScanArbiter(size_t max_scans_per_window,
+                         nsecs_t quota_window,
+                         nsecs_t recent_scan_window)
+    : max_scans_per_window_(max_scans_per_window),
+      quota_window_(quota_window),
+      recent_scan_window_(recent_scan_window),
+      recent_scan_time_(0),
+      num_throttled_(0),
+      num_served_by_recent_scan_(0) {
+}
+
+bool ScanArbiter::TryAcquireQuota(uid_t uid, nsecs_t now) {
+  if (IsExempt(uid)) {
+    return true;
+  }
+  std::deque<nsecs_t>& scan_times = scan_times_[uid];
+  while (!scan_times.empty() && now - scan_times.front() >= quota_window_) {
+    scan_times.pop_front();
+  }
+  if (scan_times.size() >= max_scans_per_window_) {
+    num_throttled_++;
+    return false;
+  }
+  scan_times.push_back(now);
+  // Drop uids that have not scanned for a while, so that the map does not
+  // grow with every caller ever seen.
+  for (auto it = scan_times_.begin(); it != scan_times_.end();) {
+    if (now - it->second.back() >= quota_window_) {
+      it = scan_times_.erase(it);
+    } else {
+      it++;
+    }
+  }
+  return true;
+}
+
+void ScanArbiter::OnScanCompleted(const SingleScanRequest& request,
+                                  nsecs_t now) {
+  recent_scan_ = request;
+  recent_scan_time_ = now;
+}
+
+void ScanArbiter::ForgetRecentScan() {
+  recent_scan_ = SingleScanRequest();
+  recent_scan_time_ = 0;
+}
+
+bool ScanArbiter::TryServeFromRecentScan(const SingleScanRequest& request,
+                                         nsecs_t now) {
+  if (recent_scan_time_ == 0 ||
+      now - recent_scan_time_ >= recent_scan_window_ ||
+      !ScanRequestScheduler::Covers(recent_scan_, request)) {
+    return false;
+  }
+  num_served_by_recent_scan_++;
+  return true;
+}
+
+void ScanArbiter::AddWaitingCaller(uid_t uid, bool follow_up) {
+  AddUnique(uid, follow_up ? &follow_up_callers_ : &waiting_callers_);
+}
+
+vector<uid_t> ScanArbiter::TakeWaitingCallers() {
+  vector<uid_t> callers = std::move(waiting_callers_);
+  waiting_callers_.clear();
+  return callers;
+}
+
+void ScanArbiter::PromoteFollowUpCallers() {
+  for (uid_t uid : follow_up_callers_) {
+    AddUnique(uid, &waiting_callers_);
+  }
+  follow_up_callers_.clear();
+}
+
+void ScanArbiter::Clear() {
+  waiting_callers_.clear();
+  follow_up_callers_.clear();
+  ForgetRecentScan();
+}
+
+bool ScanArbiter::IsExempt(uid_t uid) {
+  return uid == AID_ROOT || uid == AID_SYSTEM || uid == AID_WIFI;
+}
+
+void ScanArbiter::AddUnique(uid_t uid, vector<uid_t>* uids) {
+  if (std::find(uids->begin(), uids->end(), uid) == uids->end()) {
+    uids->push_back(uid);
+  }
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_SCANNING_SCAN_ARBITER_H_
+#define WIFICOND_SCANNING_SCAN_ARBITER_H_
+
+#include <deque>
+#include <map>
+#include <vector>
+
+#include <sys/types.h>
+
+#include <android-base/macros.h>
+#include <utils/Timers.h>
+
+#include "wificond/scanning/scan_request_scheduler.h"
+
+namespace android {
+namespace wificond {
+
+// Arbitrates the single scan requests that the binder clients of an
+// interface, e.g. the framework, location and vendor services, send.
+// ScanRequestScheduler merges the requests that arrive while a scan is in
+// flight. On top of that, this class:
+// - Limits how many scans each caller uid triggers in a time window. Scans
+//   of the wifi stack itself are not limited.
+// - Serves requests that a scan done a moment ago already covers with the
+//   results of that scan, instead of scanning again.
+// - Keeps track of the callers waiting for the scan in flight and for the
+//   follow-up scan, so that the results of one scan are sent to all of them.
+class ScanArbiter {
+ public:
+  // Default limit of scans each caller uid triggers within
+  // |kDefaultQuotaWindow|.
+  static constexpr size_t kDefaultMaxScansPerWindow = 4;
+  static constexpr nsecs_t kDefaultQuotaWindow = s2ns(120);
+  // Default time for which the results of a scan serve new requests.
+  static constexpr nsecs_t kDefaultRecentScanWindow = ms2ns(2000);
+
+  ScanArbiter(size_t max_scans_per_window = kDefaultMaxScansPerWindow,
+              nsecs_t quota_window = kDefaultQuotaWindow,
+              nsecs_t recent_scan_window = kDefaultRecentScanWindow);
+  ~ScanArbiter() = default;
+
+  // Returns whether uid |uid| may trigger another scan at |now|, in which
+  // case the scan is counted against its quota.
+  bool TryAcquireQuota(uid_t uid, nsecs_t now);
+  // Records that a scan of |request| completed at |now| with up to date
+  // results.
+  void OnScanCompleted(const SingleScanRequest& request, nsecs_t now);
+  // Forgets the scan recorded by OnScanCompleted(), e.g. when its results
+  // might be outdated.
+  void ForgetRecentScan();
+  // Returns whether the results of the scan recorded by OnScanCompleted()
+  // still serve |request| at |now|, in which case no scan is needed.
+  bool TryServeFromRecentScan(const SingleScanRequest& request, nsecs_t now);
+
+  // Records that |uid| waits for the results of the scan in flight, or of
+  // the follow-up scan if |follow_up|.
+  void AddWaitingCaller(uid_t uid, bool follow_up);
+  // Returns the callers waiting for the scan in flight and forgets them.
+  std::vector<uid_t> TakeWaitingCallers();
+  // Callers waiting for the follow-up scan wait for the scan in flight
+  // instead. Called when the follow-up scan starts, or when it is dropped
+  // along with an aborted scan in flight.
+  void PromoteFollowUpCallers();
+  // Forgets all waiting callers and the recent scan.
+  void Clear();
+
+  size_t GetNumThrottled() const { return num_throttled_; }
+  size_t GetNumServedByRecentScan() const {
+    return num_served_by_recent_scan_;
+  }
+
+  // Returns whether scans of |uid| are exempt from quotas.
+  static bool IsExempt(uid_t uid);
+
+ private:
+  static void AddUnique(uid_t uid, std::vector<uid_t>* uids);
+
+  const size_t max_scans_per_window_;
+  const nsecs_t quota_window_;
+  const nsecs_t recent_scan_window_;
+  // Times of the scans of each uid within the quota window, oldest first.
+  std::map<uid_t, std::deque<nsecs_t>> scan_times_;
+  SingleScanRequest recent_scan_;
+  // 0 if there is no recent scan.
+  nsecs_t recent_scan_time_;
+  std::vector<uid_t> waiting_callers_;
+  std::vector<uid_t> follow_up_callers_;
+  size_t num_throttled_;
+  size_t num_served_by_recent_scan_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScanArbiter);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_SCANNING_SCAN_ARBITER_H_
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/scanning/scan_request_cache.h"
+
+#include <utility>
+
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+// FNV-1a.
+constexpr uint64_t kFnvOffsetBasis = 0xcbf29ce484222325;
+constexpr uint64_t kFnvPrime = 0x100000001b3;
+
+uint64_t HashBytes(uint64_t hash, const void* data, size_t size) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * kFnvPrime;
+  }
+  return hash;
+}
+
+template <typename T>
+uint64_t HashValue(uint64_t hash, T value) {
+  return HashBytes(hash, &value, sizeof(value));
+}
+
+}  // namespace
+
+NL80211Packet* ScanRequestCache::Find(uint32_t interface_index,
+                                      bool request_random_mac,
+                                      int scan_type,
+                                      const vector<vector<uint8_t>>& ssids,
+                                      const vector<uint32_t>& freqs) {
+  const uint64_t fingerprint = GetFingerprint(
+      interface_index, request_random_mac, scan_type, ssids, freqs);
+  for (auto iter = templates_.begin(); iter != templates_.end(); ++iter) {
+    if (iter->fingerprint == fingerprint &&
+        iter->interface_index == interface_index &&
+        iter->request_random_mac == request_random_mac &&
+        iter->scan_type == scan_type &&
+        iter->ssids == ssids &&
+        iter->freqs == freqs) {
+      templates_.splice(templates_.begin(), templates_, iter);
+      return &templates_.front().request;
+    }
+  }
+  return nullptr;
+}
+
+NL80211Packet* ScanRequestCache::Insert(uint32_t interface_index,
+                                        bool request_random_mac,
+                                        int scan_type,
+                                        const vector<vector<uint8_t>>& ssids,
+                                        const vector<uint32_t>& freqs,
+                                        NL80211Packet request) {
+  if (templates_.size() >= kMaxNumTemplates) {
+    templates_.pop_back();
+  }
+  templates_.push_front(Template{
+      GetFingerprint(interface_index, request_random_mac, scan_type, ssids,
+                     freqs),
+      interface_index, request_random_mac, scan_type, ssids, freqs,
+      std::move(request)});
+  return &templates_.front().request;
+}
+
+uint64_t ScanRequestCache::GetFingerprint(
+    uint32_t interface_index,
+    bool request_random_mac,
+    int scan_type,
+    const vector<vector<uint8_t>>& ssids,
+    const vector<uint32_t>& freqs) {
+  uint64_t hash = kFnvOffsetBasis;
+  hash = HashValue(hash, interface_index);
+  hash = HashValue(hash, request_random_mac);
+  hash = HashValue(hash, scan_type);
+  // Lengths tell apart SSID lists that only differ in where they split.
+  for (const vector<uint8_t>& ssid : ssids) {
+    hash = HashValue(hash, ssid.size());
+    hash = HashBytes(hash, ssid.data(), ssid.size());
+  }
+  hash = HashValue(hash, ssids.size());
+  return HashBytes(hash, freqs.data(), freqs.size() * sizeof(uint32_t));
+}
+
+}  // namespace wificond
+}  // namespace android
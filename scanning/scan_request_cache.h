@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_SCANNING_SCAN_REQUEST_CACHE_H_
+#define WIFICOND_SCANNING_SCAN_REQUEST_CACHE_H_
+
+#include <stdint.h>
+
+#include <list>
+#include <vector>
+
+#include <android-base/macros.h>
+
+#include "wificond/net/nl80211_packet.h"
+
+namespace android {
+namespace wificond {
+
+// Keeps the NL80211_CMD_TRIGGER_SCAN requests of recent scan settings as
+// templates. Periodic scans mostly repeat the same settings, and their
+// requests only differ in the sequence number and port id, which are
+// patched in before each send. Building the request attribute by attribute
+// once per scan settings keeps the cost of a scan independent of the
+// number of SSIDs and frequencies.
+// Settings are looked up by a fingerprint, and compared in full on a match.
+// Not thread safe.
+class ScanRequestCache {
+ public:
+  // Scans alternate between a few settings at most, e.g. with and without
+  // hidden networks.
+  static constexpr size_t kMaxNumTemplates = 4;
+
+  ScanRequestCache() = default;
+
+  // Returns the template of the given scan settings, or nullptr if there is
+  // none. See ScanUtils::Scan() for the settings.
+  NL80211Packet* Find(uint32_t interface_index,
+                      bool request_random_mac,
+                      int scan_type,
+                      const std::vector<std::vector<uint8_t>>& ssids,
+                      const std::vector<uint32_t>& freqs);
+  // Keeps |request| as the template of the given scan settings, evicting the
+  // least recently used template if there are too many.
+  // Returns the template.
+  NL80211Packet* Insert(uint32_t interface_index,
+                        bool request_random_mac,
+                        int scan_type,
+                        const std::vector<std::vector<uint8_t>>& ssids,
+                        const std::vector<uint32_t>& freqs,
+                        NL80211Packet request);
+  void Clear() { templates_.clear(); }
+  size_t GetNumTemplates() const { return templates_.size(); }
+
+ private:
+  struct Template {
+    uint64_t fingerprint;
+    uint32_t interface_index;
+    bool request_random_mac;
+    int scan_type;
+    std::vector<std::vector<uint8_t>> ssids;
+    std::vector<uint32_t> freqs;
+    NL80211Packet request;
+  };
+
+  static uint64_t GetFingerprint(
+      uint32_t interface_index,
+      bool request_random_mac,
+      int scan_type,
+      const std::vector<std::vector<uint8_t>>& ssids,
+      const std::vector<uint32_t>& freqs);
+
+  // Most recently used first.
+  std::list<Template> templates_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScanRequestCache);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_SCANNING_SCAN_REQUEST_CACHE_H_
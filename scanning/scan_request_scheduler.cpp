@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/scanning/scan_request_scheduler.h"
+
+#include <algorithm>
+
+#include <android-base/logging.h>
+
+#include "android/net/wifi/nl80211/IWifiScannerImpl.h"
+#include "wificond/scanning/scan_result_table.h"
+
+using android::net::wifi::nl80211::IWifiScannerImpl;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+template <typename T>
+bool Contains(const vector<T>& values, const T& value) {
+  return std::find(values.begin(), values.end(), value) != values.end();
+}
+
+// Returns the scan type of a scan that serves requests of |scan_type| and
+// |other_scan_type|. High accuracy is never downgraded, other mixes of
+// scan types fall back to the default one.
+int MergeScanType(int scan_type, int other_scan_type) {
+  if (scan_type == other_scan_type) {
+    return scan_type;
+  }
+  if (scan_type == IWifiScannerImpl::SCAN_TYPE_HIGH_ACCURACY ||
+      other_scan_type == IWifiScannerImpl::SCAN_TYPE_HIGH_ACCURACY) {
+    return IWifiScannerImpl::SCAN_TYPE_HIGH_ACCURACY;
+  }
+  return IWifiScannerImpl::SCAN_TYPE_DEFAULT;
+}
+
+}  // namespace
+
+ScanRequestScheduler::ScanRequestScheduler(size_t max_num_scan_ssids)
+    : max_num_scan_ssids_(max_num_scan_ssids),
+      has_follow_up_scan_(false) {
+}
+
+void ScanRequestScheduler::OnScanStarted(const SingleScanRequest& request) {
+  in_flight_scan_ = request;
+}
+
+bool ScanRequestScheduler::AddRequest(const SingleScanRequest& request) {
+  if (Covers(in_flight_scan_, request)) {
+    return false;
+  }
+  if (!has_follow_up_scan_) {
+    follow_up_scan_ = request;
+    has_follow_up_scan_ = true;
+    return true;
+  }
+
+  follow_up_scan_.scan_type =
+      MergeScanType(follow_up_scan_.scan_type, request.scan_type);
+  // An empty list of frequencies covers all of them.
+  if (request.freqs.empty()) {
+    follow_up_scan_.freqs.clear();
+  } else if (!follow_up_scan_.freqs.empty()) {
+    for (uint32_t freq : request.freqs) {
+      if (!Contains(follow_up_scan_.freqs, freq)) {
+        follow_up_scan_.freqs.push_back(freq);
+      }
+    }
+  }
+  size_t num_skipped_ssids = 0;
+  for (const auto& ssid : request.ssids) {
+    if (Contains(follow_up_scan_.ssids, ssid)) {
+      continue;
+    }
+    if (follow_up_scan_.ssids.size() >= max_num_scan_ssids_) {
+      num_skipped_ssids++;
+      continue;
+    }
+    follow_up_scan_.ssids.push_back(ssid);
+  }
+  if (num_skipped_ssids > 0) {
+    LOG(WARNING) << "Skip " << num_skipped_ssids
+                 << " hidden ssids for follow-up scan";
+  }
+  return true;
+}
+
+bool ScanRequestScheduler::TakeFollowUpScan(SingleScanRequest* out_request) {
+  if (!has_follow_up_scan_) {
+    return false;
+  }
+  *out_request = std::move(follow_up_scan_);
+  follow_up_scan_ = SingleScanRequest();
+  has_follow_up_scan_ = false;
+  return true;
+}
+
+void ScanRequestScheduler::Clear() {
+  follow_up_scan_ = SingleScanRequest();
+  has_follow_up_scan_ = false;
+}
+
+vector<SubScanRequest> ScanRequestScheduler::SplitByBand(
+    const SingleScanRequest& request,
+    const BandInfo& band_info) {
+  vector<uint32_t> freqs = request.freqs;
+  if (freqs.empty()) {
+    for (const vector<uint32_t>* band : {&band_info.band_2g,
+                                         &band_info.band_5g,
+                                         &band_info.band_dfs,
+                                         &band_info.band_6g}) {
+      freqs.insert(freqs.end(), band->begin(), band->end());
+    }
+  }
+
+  vector<SubScanRequest> sub_scans;
+  for (int32_t band : {IWifiScannerImpl::SCAN_RESULT_BAND_2G,
+                       IWifiScannerImpl::SCAN_RESULT_BAND_5G,
+                       IWifiScannerImpl::SCAN_RESULT_BAND_6G}) {
+    SubScanRequest sub_scan;
+    sub_scan.bands = band;
+    for (uint32_t freq : freqs) {
+      if (ScanResultTable::GetBand(freq) == band) {
+        sub_scan.request.freqs.push_back(freq);
+      }
+    }
+    if (sub_scan.request.freqs.empty()) {
+      continue;
+    }
+    sub_scan.request.scan_type = request.scan_type;
+    sub_scan.request.ssids = request.ssids;
+    sub_scans.push_back(std::move(sub_scan));
+  }
+  if (sub_scans.empty()) {
+    return sub_scans;
+  }
+  for (uint32_t freq : freqs) {
+    if (ScanResultTable::GetBand(freq) == 0) {
+      sub_scans.back().request.freqs.push_back(freq);
+    }
+  }
+  return sub_scans;
+}
+
+bool ScanRequestScheduler::Covers(const SingleScanRequest& scan,
+                                  const SingleScanRequest& request) {
+  if (scan.scan_type != request.scan_type &&
+      request.scan_type == IWifiScannerImpl::SCAN_TYPE_HIGH_ACCURACY) {
+    return false;
+  }
+  if (!scan.freqs.empty()) {
+    if (request.freqs.empty()) {
+      return false;
+    }
+    for (uint32_t freq : request.freqs) {
+      if (!Contains(scan.freqs, freq)) {
+        return false;
+      }
+    }
+  }
+  for (const auto& ssid : request.ssids) {
+    if (!Contains(scan.ssids, ssid)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_SCANNING_SCAN_REQUEST_SCHEDULER_H_
+#define WIFICOND_SCANNING_SCAN_REQUEST_SCHEDULER_H_
+
+#include <vector>
+
+#include <android-base/macros.h>
+
+#include "android/net/wifi/nl80211/IWifiScannerImpl.h"
+#include "wificond/net/netlink_utils.h"
+
+namespace android {
+namespace wificond {
+
+// A single scan request, in the form it is sent to kernel.
+struct SingleScanRequest {
+  // One of |IWifiScannerImpl::SCAN_TYPE_*|.
+  int scan_type =
+      android::net::wifi::nl80211::IWifiScannerImpl::SCAN_TYPE_DEFAULT;
+  // SSIDs to probe. The first one is the empty SSID of a wild card scan.
+  std::vector<std::vector<uint8_t>> ssids;
+  // Frequencies to scan. Empty for all supported frequencies.
+  std::vector<uint32_t> freqs;
+};
+
+// One sub-scan of a single scan that is split by band.
+struct SubScanRequest {
+  // Bitwise OR of |IWifiScannerImpl::SCAN_RESULT_BAND_*| values.
+  int32_t bands;
+  SingleScanRequest request;
+};
+
+// Coalesces single scan requests that arrive while a scan is in flight.
+// Kernel rejects a second NL80211_CMD_TRIGGER_SCAN until the first one is
+// done, so such requests are merged into one follow-up scan instead: it
+// covers the union of their frequencies and of their hidden SSIDs. Requests
+// that the scan in flight already covers need no follow-up scan at all.
+class ScanRequestScheduler {
+ public:
+  // |max_num_scan_ssids| is the number of SSIDs that the wiphy can probe in
+  // one scan, the wild card one included.
+  explicit ScanRequestScheduler(size_t max_num_scan_ssids);
+  ~ScanRequestScheduler() = default;
+
+  // Records |request| as the scan in flight.
+  void OnScanStarted(const SingleScanRequest& request);
+  // Handles |request|, which arrived while a scan is in flight.
+  // Returns true if it was merged into the follow-up scan, or false if the
+  // scan in flight already covers its frequencies and hidden SSIDs.
+  // Hidden SSIDs beyond |max_num_scan_ssids| are dropped.
+  bool AddRequest(const SingleScanRequest& request);
+  // Called when the scan in flight is done. Returns whether a follow-up
+  // scan is pending, in which case it is moved to |*out_request|.
+  bool TakeFollowUpScan(SingleScanRequest* out_request);
+  bool HasFollowUpScan() const { return has_follow_up_scan_; }
+  // Returns whether the scan in flight also scans everything of |request|.
+  bool IsCoveredByScanInFlight(const SingleScanRequest& request) const {
+    return Covers(in_flight_scan_, request);
+  }
+  const SingleScanRequest& GetScanInFlight() const { return in_flight_scan_; }
+  // Drops the follow-up scan, e.g. when the scan in flight is aborted.
+  void Clear();
+
+  // Splits |request| into one sub-scan per band, in the 2.4GHz, 5GHz, 6GHz
+  // order. An empty frequency list stands for the frequencies of
+  // |band_info|. Frequencies that are in none of these bands go to the last
+  // sub-scan. Returns no sub-scans if the frequencies to scan are unknown.
+  static std::vector<SubScanRequest> SplitByBand(
+      const SingleScanRequest& request,
+      const BandInfo& band_info);
+  // Returns whether a scan of |scan| also scans everything of |request|.
+  static bool Covers(const SingleScanRequest& scan,
+                     const SingleScanRequest& request);
+
+ private:
+
+  const size_t max_num_scan_ssids_;
+  SingleScanRequest in_flight_scan_;
+  SingleScanRequest follow_up_scan_;
+  bool has_follow_up_scan_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScanRequestScheduler);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_SCANNING_SCAN_REQUEST_SCHEDULER_H_
@@ -71,6 +71,17 @@ status_t NativeScanResult::writeToParcel(::android::Parcel* parcel) const {
     RETURN_IF_FAILED(parcel->writeInt32(1));
     RETURN_IF_FAILED(radio_chain_info.writeToParcel(parcel));
   }
+  if (!parcel_ie_index) {
+    return ::android::OK;
+  }
+  RETURN_IF_FAILED(parcel->writeInt32(info_element_index.size()));
+  for (const auto& location : info_element_index) {
+    RETURN_IF_FAILED(parcel->writeInt32(1));
+    RETURN_IF_FAILED(location.writeToParcel(parcel));
+  }
+  RETURN_IF_FAILED(parcel->writeInt32(security));
+  RETURN_IF_FAILED(parcel->writeInt32(channel_width));
+  RETURN_IF_FAILED(parcel->writeInt32(wifi_standard));
   return ::android::OK;
 }
 
@@ -111,6 +122,26 @@ status_t NativeScanResult::readFromParcel(const ::android::Parcel* parcel) {
     RETURN_IF_FAILED(radio_chain_info.readFromParcel(parcel));
     radio_chain_infos.push_back(radio_chain_info);
   }
+  if (!parcel_ie_index) {
+    return ::android::OK;
+  }
+  int32_t num_locations = 0;
+  RETURN_IF_FAILED(parcel->readInt32(&num_locations));
+  for (int i = 0; i < num_locations; i++) {
+    InfoElementLocation location;
+    int32_t leading_number = 0;
+    RETURN_IF_FAILED(parcel->readInt32(&leading_number));
+    if (leading_number != 1) {
+      LOG(ERROR) << "Unexpected leading number before an object: "
+                 << leading_number;
+      return ::android::BAD_VALUE;
+    }
+    RETURN_IF_FAILED(location.readFromParcel(parcel));
+    info_element_index.push_back(location);
+  }
+  RETURN_IF_FAILED(parcel->readInt32(&security));
+  RETURN_IF_FAILED(parcel->readInt32(&channel_width));
+  RETURN_IF_FAILED(parcel->readInt32(&wifi_standard));
   return ::android::OK;
 }
 
@@ -131,6 +162,10 @@ void NativeScanResult::DebugLog() {
     LOG(INFO) << "RADIO CHAIN ID: " << radio_chain_info.chain_id;
     LOG(INFO) << "RADIO CHAIN LEVEL: " << radio_chain_info.level;
   }
+  LOG(INFO) << "INFORMATION ELEMENTS INDEXED: " << info_element_index.size();
+  LOG(INFO) << "SECURITY: " << security;
+  LOG(INFO) << "CHANNEL WIDTH: " << channel_width;
+  LOG(INFO) << "WIFI STANDARD: " << wifi_standard;
 
 }
 
@@ -25,6 +25,7 @@
 #include <binder/Parcel.h>
 #include <binder/Parcelable.h>
 
+#include "wificond/scanning/info_element_location.h"
 #include "wificond/scanning/radio_chain_info.h"
 
 namespace android {
@@ -84,6 +85,22 @@ class NativeScanResult : public ::android::Parcelable {
   uint16_t capability;
   bool associated;
   std::vector<RadioChainInfo> radio_chain_infos;
+  // Locations of the information elements within |info_element|, in the
+  // order they appear, so that they do not have to be parsed again.
+  std::vector<InfoElementLocation> info_element_index;
+  // Fields decoded from |info_element|.
+  // Bit mask of |IWifiScannerImpl::SCAN_RESULT_SECURITY_*| values.
+  int32_t security = 0;
+  // One of |IWifiScannerImpl::SCAN_RESULT_CHANNEL_WIDTH_*| values.
+  int32_t channel_width = 0;
+  // One of |IWifiScannerImpl::SCAN_RESULT_WIFI_STANDARD_*| values.
+  int32_t wifi_standard = 0;
+  // Whether the parcel carries |info_element_index| and the fields decoded
+  // from it after the fields above. Only replies to queries that ask for
+  // |IWifiScannerImpl::SCAN_RESULT_FIELD_IE_INDEX| set this, so that the
+  // other methods keep the layout the framework reads. This is not parceled
+  // itself: readers set it before reading.
+  bool parcel_ie_index = false;
 };
 
 }  // namespace nl80211
@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/scanning/scan_result_batch.h"
+
+#include <string.h>
+
+#include <android-base/logging.h>
+
+using android::net::wifi::nl80211::NativeScanResult;
+using android::status_t;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+// For Java readTypedList():
+// A leading number 1 means an object is not null.
+constexpr int32_t kNotNull = 1;
+// A radio chain is stored as a leading 1, its chain id and its level.
+constexpr size_t kRadioChainInfoSize = 3 * sizeof(int32_t);
+// An information element location is stored as a leading 1, its id,
+// extension id, offset and length.
+constexpr size_t kInfoElementLocationSize = 5 * sizeof(int32_t);
+
+uint8_t* Append(uint8_t* ptr, const void* data, size_t length) {
+  if (length > 0) {
+    memcpy(ptr, data, length);
+  }
+  return ptr + length;
+}
+
+template <typename T>
+uint8_t* Put(uint8_t* ptr, T value) {
+  return Append(ptr, &value, sizeof(value));
+}
+
+const uint8_t* Take(const uint8_t* ptr, int32_t* values, size_t num_values) {
+  memcpy(values, ptr, num_values * sizeof(int32_t));
+  return ptr + num_values * sizeof(int32_t);
+}
+
+// Returns the number of bytes a byte array of |length| bytes takes in a
+// parcel: its length, then its bytes padded to 4 bytes.
+size_t GetByteArrayParcelSize(size_t length) {
+  return sizeof(int32_t) + ((length + 3) & ~static_cast<size_t>(3));
+}
+
+// Writes |length| bytes at |data| to |ptr| the same way
+// Parcel::writeByteVector() writes them. The padding at |ptr| must be zero
+// filled already.
+uint8_t* PutByteArray(uint8_t* ptr, const uint8_t* data, size_t length) {
+  Append(Put<int32_t>(ptr, length), data, length);
+  return ptr + GetByteArrayParcelSize(length);
+}
+
+}  // namespace
+
+void ScanResultBatch::Clear() {
+  records_.clear();
+  arena_.clear();
+}
+
+void ScanResultBatch::Assign(const vector<NativeScanResult>& scan_results) {
+  Clear();
+  size_t arena_size = 0;
+  for (const auto& scan_result : scan_results) {
+    arena_size += GetArenaSize(scan_result);
+  }
+  records_.reserve(scan_results.size());
+  arena_.reserve(arena_size);
+  for (const auto& scan_result : scan_results) {
+    Add(scan_result);
+  }
+}
+
+void ScanResultBatch::Add(const NativeScanResult& scan_result) {
+  Record record;
+  record.bssid = scan_result.bssid;
+  record.fields.frequency = scan_result.frequency;
+  record.fields.signal_mbm = scan_result.signal_mbm;
+  record.fields.tsf = scan_result.tsf;
+  record.fields.capability = scan_result.capability;
+  record.fields.associated = scan_result.associated ? 1 : 0;
+  record.fields.num_radio_chain_infos = scan_result.radio_chain_infos.size();
+  record.security = scan_result.security;
+  record.channel_width = scan_result.channel_width;
+  record.wifi_standard = scan_result.wifi_standard;
+  record.arena_offset = arena_.size();
+  record.ssid_length = scan_result.ssid.size();
+  record.info_element_length = scan_result.info_element.size();
+  record.num_info_element_locations = scan_result.info_element_index.size();
+
+  arena_.resize(arena_.size() + GetArenaSize(scan_result));
+  uint8_t* ptr = arena_.data() + record.arena_offset;
+  ptr = Append(ptr, scan_result.ssid.data(), scan_result.ssid.size());
+  ptr = Append(ptr, scan_result.info_element.data(),
+               scan_result.info_element.size());
+  for (const auto& radio_chain_info : scan_result.radio_chain_infos) {
+    int32_t values[] = {kNotNull,
+                        radio_chain_info.chain_id,
+                        radio_chain_info.level};
+    ptr = Append(ptr, values, sizeof(values));
+  }
+  for (const auto& location : scan_result.info_element_index) {
+    int32_t values[] = {kNotNull, location.id, location.extension_id,
+                        location.offset, location.length};
+    ptr = Append(ptr, values, sizeof(values));
+  }
+  records_.push_back(record);
+}
+
+NativeScanResult ScanResultBatch::Get(size_t index) const {
+  const Record& record = records_[index];
+  NativeScanResult scan_result;
+  scan_result.bssid = record.bssid;
+  scan_result.frequency = record.fields.frequency;
+  scan_result.signal_mbm = record.fields.signal_mbm;
+  scan_result.tsf = record.fields.tsf;
+  scan_result.capability = record.fields.capability;
+  scan_result.associated = record.fields.associated != 0;
+  scan_result.security = record.security;
+  scan_result.channel_width = record.channel_width;
+  scan_result.wifi_standard = record.wifi_standard;
+  const uint8_t* ptr = arena_.data() + record.arena_offset;
+  scan_result.ssid.assign(ptr, ptr + record.ssid_length);
+  ptr += record.ssid_length;
+  scan_result.info_element.assign(ptr, ptr + record.info_element_length);
+  ptr += record.info_element_length;
+  for (int32_t i = 0; i < record.fields.num_radio_chain_infos; i++) {
+    int32_t values[3];
+    ptr = Take(ptr, values, 3);
+    scan_result.radio_chain_infos.emplace_back(values[1], values[2]);
+  }
+  for (uint32_t i = 0; i < record.num_info_element_locations; i++) {
+    int32_t values[5];
+    ptr = Take(ptr, values, 5);
+    scan_result.info_element_index.emplace_back(values[1], values[2],
+                                                values[3], values[4]);
+  }
+  return scan_result;
+}
+
+size_t ScanResultBatch::GetParcelSize() const {
+  size_t size = sizeof(int32_t);
+  for (const Record& record : records_) {
+    size += sizeof(kNotNull) +
+            GetByteArrayParcelSize(record.ssid_length) +
+            GetByteArrayParcelSize(ETH_ALEN) +
+            GetByteArrayParcelSize(record.info_element_length) +
+            sizeof(ParcelFields) +
+            record.fields.num_radio_chain_infos * kRadioChainInfoSize;
+  }
+  return size;
+}
+
+status_t ScanResultBatch::WriteToParcel(::android::Parcel* parcel) const {
+  size_t size = GetParcelSize();
+  uint8_t* out = static_cast<uint8_t*>(parcel->writeInplace(size));
+  if (out == nullptr) {
+    LOG(ERROR) << "Failed to reserve " << size << " bytes for scan results";
+    return ::android::NO_MEMORY;
+  }
+  // Zero fills the padding of byte arrays.
+  memset(out, 0, size);
+  out = Put<int32_t>(out, records_.size());
+  for (const Record& record : records_) {
+    const uint8_t* ptr = arena_.data() + record.arena_offset;
+    // Fields are written in the order of NativeScanResult::writeToParcel().
+    // Like getScanResults() replies, the index of the information elements
+    // and the fields decoded from it are not parceled.
+    out = Put<int32_t>(out, kNotNull);
+    out = PutByteArray(out, ptr, record.ssid_length);
+    ptr += record.ssid_length;
+    out = PutByteArray(out, record.bssid.data(), ETH_ALEN);
+    out = PutByteArray(out, ptr, record.info_element_length);
+    ptr += record.info_element_length;
+    out = Append(out, &record.fields, sizeof(record.fields));
+    size_t radio_chain_infos_size =
+        record.fields.num_radio_chain_infos * kRadioChainInfoSize;
+    out = Append(out, ptr, radio_chain_infos_size);
+  }
+  return ::android::OK;
+}
+
+size_t ScanResultBatch::GetArenaSize(const NativeScanResult& scan_result) {
+  return scan_result.ssid.size() +
+         scan_result.info_element.size() +
+         scan_result.radio_chain_infos.size() * kRadioChainInfoSize +
+         scan_result.info_element_index.size() * kInfoElementLocationSize;
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_SCANNING_SCAN_RESULT_BATCH_H_
+#define WIFICOND_SCANNING_SCAN_RESULT_BATCH_H_
+
+#include <array>
+#include <vector>
+
+#include <linux/if_ether.h>
+
+#include <android-base/macros.h>
+#include <binder/Parcel.h>
+
+#include "wificond/scanning/scan_result.h"
+
+namespace android {
+namespace wificond {
+
+// Holds the scan results of one query, with the variable length fields of
+// all results in a single contiguous arena instead of in vectors owned by
+// each result.
+// A batch that is cleared and refilled reuses its storage, so that
+// returning scan results does not allocate once the batch has grown to the
+// usual number of results.
+class ScanResultBatch {
+ public:
+  ScanResultBatch() = default;
+
+  // Removes all scan results, but keeps the storage.
+  void Clear();
+  // Replaces the scan results of this batch with copies of |scan_results|.
+  // Storage grows at most once.
+  void Assign(
+      const std::vector<android::net::wifi::nl80211::NativeScanResult>&
+          scan_results);
+  // Appends a copy of |scan_result|.
+  void Add(const android::net::wifi::nl80211::NativeScanResult& scan_result);
+
+  size_t size() const { return records_.size(); }
+  bool empty() const { return records_.empty(); }
+  // Returns a copy of scan result |index|.
+  android::net::wifi::nl80211::NativeScanResult Get(size_t index) const;
+
+  // Writes the scan results to |parcel| as a NativeScanResult[], the same
+  // way a vector of NativeScanResult is written.
+  // The exact size of the scan results is computed first, so that |parcel|
+  // checks its capacity and grows once. The arena is then copied over
+  // sequentially, with one copy per run of fields that have the same
+  // layout in the arena and in the parcel.
+  ::android::status_t WriteToParcel(::android::Parcel* parcel) const;
+  // Returns the number of bytes that WriteToParcel() writes.
+  size_t GetParcelSize() const;
+
+ private:
+  // Fields that NativeScanResult::writeToParcel() writes back to back after
+  // the information elements, in their parcel layout.
+  struct __attribute__((packed)) ParcelFields {
+    uint32_t frequency;
+    int32_t signal_mbm;
+    uint64_t tsf;
+    uint32_t capability;
+    int32_t associated;
+    int32_t num_radio_chain_infos;
+  };
+  static_assert(sizeof(ParcelFields) == 28,
+                "ParcelFields must not have any padding");
+  struct Record {
+    std::array<uint8_t, ETH_ALEN> bssid;
+    ParcelFields fields;
+    int32_t security;
+    int32_t channel_width;
+    int32_t wifi_standard;
+    // The variable length fields are stored back to back in |arena_|,
+    // starting at |arena_offset|: SSID, information elements, radio chains
+    // and the information element index. Radio chains and information
+    // element locations are stored in their parcel layout.
+    size_t arena_offset;
+    uint32_t ssid_length;
+    uint32_t info_element_length;
+    uint32_t num_info_element_locations;
+  };
+
+  // Returns the number of arena bytes that |scan_result| takes.
+  static size_t GetArenaSize(
+      const android::net::wifi::nl80211::NativeScanResult& scan_result);
+
+  std::vector<Record> records_;
+  std::vector<uint8_t> arena_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScanResultBatch);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_SCANNING_SCAN_RESULT_BATCH_H_
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/scanning/scan_result_query.h"
+
+#include <android-base/logging.h>
+
+#include "wificond/parcelable_utils.h"
+
+using android::status_t;
+
+namespace android {
+namespace net {
+namespace wifi {
+namespace nl80211 {
+
+namespace {
+
+status_t WriteByteVectors(::android::Parcel* parcel,
+                          const std::vector<std::vector<uint8_t>>& vectors) {
+  RETURN_IF_FAILED(parcel->writeInt32(vectors.size()));
+  for (const auto& bytes : vectors) {
+    RETURN_IF_FAILED(parcel->writeByteVector(bytes));
+  }
+  return ::android::OK;
+}
+
+status_t ReadByteVectors(const ::android::Parcel* parcel,
+                         std::vector<std::vector<uint8_t>>* vectors) {
+  int32_t size;
+  RETURN_IF_FAILED(parcel->readInt32(&size));
+  if (size < 0) {
+    return ::android::BAD_VALUE;
+  }
+  vectors->clear();
+  for (int32_t i = 0; i < size; i++) {
+    std::vector<uint8_t> bytes;
+    RETURN_IF_FAILED(parcel->readByteVector(&bytes));
+    vectors->push_back(std::move(bytes));
+  }
+  return ::android::OK;
+}
+
+}  // namespace
+
+status_t ScanResultQuery::writeToParcel(::android::Parcel* parcel) const {
+  RETURN_IF_FAILED(parcel->writeInt32(fields));
+  RETURN_IF_FAILED(parcel->writeInt32(associated_only ? 1 : 0));
+  RETURN_IF_FAILED(parcel->writeInt32(bands));
+  RETURN_IF_FAILED(parcel->writeByteVector(ssid));
+  RETURN_IF_FAILED(parcel->writeInt32(min_signal_mbm));
+  RETURN_IF_FAILED(parcel->writeInt32(max_results));
+  RETURN_IF_FAILED(parcel->writeInt64(max_age_ms));
+  RETURN_IF_FAILED(WriteByteVectors(parcel, ssids));
+  RETURN_IF_FAILED(WriteByteVectors(parcel, excluded_bssids));
+  RETURN_IF_FAILED(parcel->writeInt32(max_results_per_ssid));
+  RETURN_IF_FAILED(parcel->writeInt32(max_results_per_band));
+  return ::android::OK;
+}
+
+status_t ScanResultQuery::readFromParcel(const ::android::Parcel* parcel) {
+  RETURN_IF_FAILED(parcel->readInt32(&fields));
+  int32_t associated_only_value = 0;
+  RETURN_IF_FAILED(parcel->readInt32(&associated_only_value));
+  associated_only = (associated_only_value != 0);
+  RETURN_IF_FAILED(parcel->readInt32(&bands));
+  RETURN_IF_FAILED(parcel->readByteVector(&ssid));
+  RETURN_IF_FAILED(parcel->readInt32(&min_signal_mbm));
+  RETURN_IF_FAILED(parcel->readInt32(&max_results));
+  RETURN_IF_FAILED(parcel->readInt64(&max_age_ms));
+  RETURN_IF_FAILED(ReadByteVectors(parcel, &ssids));
+  RETURN_IF_FAILED(ReadByteVectors(parcel, &excluded_bssids));
+  RETURN_IF_FAILED(parcel->readInt32(&max_results_per_ssid));
+  RETURN_IF_FAILED(parcel->readInt32(&max_results_per_band));
+  return ::android::OK;
+}
+
+}  // namespace nl80211
+}  // namespace wifi
+}  // namespace net
+}  // namespace android
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_SCANNING_SCAN_RESULT_QUERY_H_
+#define WIFICOND_SCANNING_SCAN_RESULT_QUERY_H_
+
+#include <limits>
+#include <vector>
+
+#include <binder/Parcel.h>
+#include <binder/Parcelable.h>
+
+namespace android {
+namespace net {
+namespace wifi {
+namespace nl80211 {
+
+// Selects which scan results to return and which of their fields to fill.
+// See |IWifiScannerImpl.queryScanResults()|.
+class ScanResultQuery : public ::android::Parcelable {
+ public:
+  ScanResultQuery() = default;
+  ::android::status_t writeToParcel(::android::Parcel* parcel) const override;
+  ::android::status_t readFromParcel(const ::android::Parcel* parcel) override;
+
+  // Bit mask of |IWifiScannerImpl.SCAN_RESULT_FIELD_*| values.
+  // BSSID, frequency, signal strength and association status are always
+  // filled. Other fields are left empty or 0.
+  int32_t fields = 0;
+  // Only return the associated BSS.
+  bool associated_only = false;
+  // Bit mask of |IWifiScannerImpl.SCAN_RESULT_BAND_*| values.
+  // 0 means all bands.
+  int32_t bands = 0;
+  // Only return BSSs with this SSID. Empty means any SSID.
+  std::vector<uint8_t> ssid;
+  // Only return BSSs with one of these SSIDs, e.g. those of saved networks.
+  // Combined with |ssid| if both are set. Empty means any SSID.
+  std::vector<std::vector<uint8_t>> ssids;
+  // Never return BSSs with one of these BSSIDs, e.g. those of blocked APs.
+  // BSSIDs that are not 6 bytes long are ignored.
+  std::vector<std::vector<uint8_t>> excluded_bssids;
+  // Only return BSSs with at least this signal strength in (100 * dBm).
+  int32_t min_signal_mbm = std::numeric_limits<int32_t>::min();
+  // Only return up to this many BSSs, those with the strongest signal.
+  // 0 means no limit.
+  int32_t max_results = 0;
+  // Only return up to this many BSSs per SSID, e.g. 1 for the best BSS of
+  // each network, those with the strongest signal. 0 means no limit.
+  int32_t max_results_per_ssid = 0;
+  // Only return up to this many BSSs per band of
+  // |IWifiScannerImpl.SCAN_RESULT_BAND_*|, those with the strongest signal.
+  // 0 means no limit.
+  // Results are ordered from the strongest to the weakest if any of the
+  // limits above is set. Only the returned BSSs are written to the reply.
+  int32_t max_results_per_band = 0;
+  // Only return BSSs last seen at most this many milliseconds ago, going by
+  // the boot time kernel last received a frame of them. 0 means any age.
+  int64_t max_age_ms = 0;
+};
+
+}  // namespace nl80211
+}  // namespace wifi
+}  // namespace net
+}  // namespace android
+
+#endif  // WIFICOND_SCANNING_SCAN_RESULT_QUERY_H_
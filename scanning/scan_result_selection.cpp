@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/scanning/scan_result_selection.h"
+
+#include "wificond/scanning/scan_result_table.h"
+
+using android::net::wifi::nl80211::ScanResultQuery;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+ScanResultQuota::ScanResultQuota(const ScanResultQuery& query)
+    : max_results_per_ssid_(std::max(query.max_results_per_ssid, 0)),
+      max_results_per_band_(std::max(query.max_results_per_band, 0)) {
+}
+
+bool ScanResultQuota::Take(uint32_t frequency, const vector<uint8_t>& ssid) {
+  size_t* num_ssid_results = nullptr;
+  if (max_results_per_ssid_ > 0) {
+    num_ssid_results = &num_results_per_ssid_[ssid];
+    if (*num_ssid_results >= max_results_per_ssid_) {
+      return false;
+    }
+  }
+  size_t* num_band_results = nullptr;
+  if (max_results_per_band_ > 0) {
+    num_band_results =
+        &num_results_per_band_[ScanResultTable::GetBand(frequency)];
+    if (*num_band_results >= max_results_per_band_) {
+      return false;
+    }
+  }
+  if (num_ssid_results != nullptr) {
+    (*num_ssid_results)++;
+  }
+  if (num_band_results != nullptr) {
+    (*num_band_results)++;
+  }
+  return true;
+}
+
+}  // namespace wificond
+}  // namespace android
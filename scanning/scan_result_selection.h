@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_SCANNING_SCAN_RESULT_SELECTION_H_
+#define WIFICOND_SCANNING_SCAN_RESULT_SELECTION_H_
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <android-base/macros.h>
+
+#include "wificond/scanning/scan_result_query.h"
+
+namespace android {
+namespace wificond {
+
+// Counts the scan results picked per SSID and per band against the caps of
+// a ScanResultQuery.
+class ScanResultQuota {
+ public:
+  explicit ScanResultQuota(
+      const android::net::wifi::nl80211::ScanResultQuery& query);
+
+  // Returns whether the query caps any SSID or band.
+  bool IsLimited() const {
+    return max_results_per_ssid_ > 0 || max_results_per_band_ > 0;
+  }
+  // Returns whether a scan result on |frequency| with SSID |ssid| still fits
+  // in the caps, and counts it if it does.
+  bool Take(uint32_t frequency, const std::vector<uint8_t>& ssid);
+
+ private:
+  const size_t max_results_per_ssid_;
+  const size_t max_results_per_band_;
+  std::map<std::vector<uint8_t>, size_t> num_results_per_ssid_;
+  std::map<int32_t, size_t> num_results_per_band_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScanResultQuota);
+};
+
+// Keeps the strongest items of |items| from |begin| on that |take| accepts,
+// up to |max_items| of them, ordered from the strongest to the weakest.
+// 0 means no limit. Items are popped off a heap from the strongest on, so
+// only as many are ordered and passed to |take| as it takes to fill
+// |max_items|.
+template <typename T, typename IsStronger, typename Take>
+void SelectStrongest(size_t max_items,
+                     size_t begin,
+                     IsStronger is_stronger,
+                     Take take,
+                     std::vector<T>* items) {
+  auto is_weaker = [&is_stronger](const T& lhs, const T& rhs) {
+    return is_stronger(rhs, lhs);
+  };
+  auto first = items->begin() + begin;
+  auto heap_end = items->end();
+  std::make_heap(first, heap_end, is_weaker);
+  std::vector<T> selected;
+  while (heap_end != first &&
+         (max_items == 0 || selected.size() < max_items)) {
+    std::pop_heap(first, heap_end, is_weaker);
+    --heap_end;
+    if (take(*heap_end)) {
+      selected.push_back(std::move(*heap_end));
+    }
+  }
+  items->erase(first, items->end());
+  items->insert(items->end(),
+                std::make_move_iterator(selected.begin()),
+                std::make_move_iterator(selected.end()));
+}
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_SCANNING_SCAN_RESULT_SELECTION_H_
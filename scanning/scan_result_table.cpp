@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/scanning/scan_result_table.h"
+
+#include <algorithm>
+
+#include "android/net/wifi/nl80211/IWifiScannerImpl.h"
+
+using android::net::wifi::nl80211::IWifiScannerImpl;
+using android::net::wifi::nl80211::NativeScanResult;
+using android::net::wifi::nl80211::ScanResultQuery;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr uint32_t k2GHzFrequencyLowerBound = 2400;
+constexpr uint32_t k2GHzFrequencyUpperBound = 2500;
+constexpr uint32_t k5GHzFrequencyLowerBound = 5000;
+constexpr uint32_t k5GHzFrequencyUpperBound = 5865;
+constexpr uint32_t k6GHzFrequencyLowerBound = 5925;
+constexpr uint32_t k6GHzFrequencyUpperBound = 7125;
+
+// Band of frequencies that are in none of the |SCAN_RESULT_BAND_*| bands.
+// It only matches queries for all bands.
+constexpr uint8_t kBandOther = 0x80;
+
+}  // namespace
+
+void ScanResultTable::Assign(const vector<NativeScanResult>& scan_results) {
+  size_t num_rows = scan_results.size();
+  bssids_.resize(num_rows);
+  frequencies_.resize(num_rows);
+  signal_mbms_.resize(num_rows);
+  bands_.resize(num_rows);
+  associated_.resize(num_rows);
+  last_seen_microseconds_.resize(num_rows);
+  for (size_t row = 0; row < num_rows; row++) {
+    const NativeScanResult& scan_result = scan_results[row];
+    bssids_[row] = scan_result.bssid;
+    frequencies_[row] = scan_result.frequency;
+    signal_mbms_[row] = scan_result.signal_mbm;
+    int32_t band = GetBand(scan_result.frequency);
+    bands_[row] = band != 0 ? band : kBandOther;
+    associated_[row] = scan_result.associated ? 1 : 0;
+    last_seen_microseconds_[row] = scan_result.tsf;
+  }
+}
+
+void ScanResultTable::Filter(const ScanResultQuery& query,
+                             vector<uint32_t>* rows,
+                             uint64_t min_last_seen_microseconds) const {
+  size_t num_rows = size();
+  const uint8_t band_mask = query.bands == 0 ? 0xff : query.bands;
+  const uint8_t min_associated = query.associated_only ? 1 : 0;
+  const int32_t min_signal_mbm = query.min_signal_mbm;
+  const uint8_t* bands = bands_.data();
+  const uint8_t* associated = associated_.data();
+  const int32_t* signal_mbms = signal_mbms_.data();
+  const uint64_t* last_seen = last_seen_microseconds_.data();
+
+  // The predicates are evaluated without branches, so that the compiler
+  // can vectorize this loop. Matching rows are collected afterwards.
+  vector<uint8_t> matches(num_rows);
+  uint8_t* match = matches.data();
+  for (size_t row = 0; row < num_rows; row++) {
+    match[row] = ((bands[row] & band_mask) != 0) &
+                 (associated[row] >= min_associated) &
+                 (signal_mbms[row] >= min_signal_mbm) &
+                 (last_seen[row] >= min_last_seen_microseconds);
+  }
+  for (size_t row = 0; row < num_rows; row++) {
+    if (match[row]) {
+      rows->push_back(row);
+    }
+  }
+}
+
+void ScanResultTable::KeepStrongest(size_t max_rows,
+                                    vector<uint32_t>* rows) const {
+  const int32_t* signal_mbms = signal_mbms_.data();
+  auto is_stronger = [signal_mbms](uint32_t lhs, uint32_t rhs) {
+    if (signal_mbms[lhs] != signal_mbms[rhs]) {
+      return signal_mbms[lhs] > signal_mbms[rhs];
+    }
+    return lhs < rhs;
+  };
+  if (rows->size() > max_rows) {
+    std::nth_element(rows->begin(), rows->begin() + max_rows, rows->end(),
+                     is_stronger);
+    rows->resize(max_rows);
+  }
+  std::sort(rows->begin(), rows->end(), is_stronger);
+}
+
+int32_t ScanResultTable::GetBand(uint32_t frequency) {
+  if (frequency > k2GHzFrequencyLowerBound &&
+      frequency < k2GHzFrequencyUpperBound) {
+    return IWifiScannerImpl::SCAN_RESULT_BAND_2G;
+  }
+  if (frequency > k5GHzFrequencyLowerBound &&
+      frequency <= k5GHzFrequencyUpperBound) {
+    return IWifiScannerImpl::SCAN_RESULT_BAND_5G;
+  }
+  if (frequency > k6GHzFrequencyLowerBound &&
+      frequency < k6GHzFrequencyUpperBound) {
+    return IWifiScannerImpl::SCAN_RESULT_BAND_6G;
+  }
+  return 0;
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_SCANNING_SCAN_RESULT_TABLE_H_
+#define WIFICOND_SCANNING_SCAN_RESULT_TABLE_H_
+
+#include <array>
+#include <vector>
+
+#include <linux/if_ether.h>
+
+#include "wificond/scanning/scan_result.h"
+#include "wificond/scanning/scan_result_query.h"
+
+namespace android {
+namespace wificond {
+
+// Columnar copy of the fields of scan results that filtering and sorting
+// look at: BSSID, frequency band, signal strength and association status.
+// Each field is kept in an array of its own, so that filters run as simple
+// loops over contiguous values. Row i of the table describes
+// |scan_results[i]| of the last Assign() call, which keeps the cold fields,
+// e.g. the information elements.
+class ScanResultTable {
+ public:
+  ScanResultTable() = default;
+
+  // Rebuilds the table from |scan_results|.
+  void Assign(
+      const std::vector<android::net::wifi::nl80211::NativeScanResult>&
+          scan_results);
+
+  size_t size() const { return frequencies_.size(); }
+  const std::array<uint8_t, ETH_ALEN>& GetBssid(size_t row) const {
+    return bssids_[row];
+  }
+  uint32_t GetFrequency(size_t row) const { return frequencies_[row]; }
+  int32_t GetSignalMbm(size_t row) const { return signal_mbms_[row]; }
+  bool IsAssociated(size_t row) const { return associated_[row] != 0; }
+
+  // Appends the rows that match the associated status, band and signal
+  // strength predicates of |query| to |rows|, in order. The SSID predicate
+  // of |query| is not checked, as the SSID is a cold field.
+  // Rows last seen before |min_last_seen_microseconds| since boot are left
+  // out as well.
+  void Filter(const android::net::wifi::nl80211::ScanResultQuery& query,
+              std::vector<uint32_t>* rows,
+              uint64_t min_last_seen_microseconds = 0) const;
+  // Keeps the |max_rows| rows of |rows| with the strongest signal, ordered
+  // from the strongest to the weakest. Rows with the same signal strength
+  // keep their order.
+  void KeepStrongest(size_t max_rows, std::vector<uint32_t>* rows) const;
+
+  // Returns the |IWifiScannerImpl::SCAN_RESULT_BAND_*| value of the band
+  // that |frequency| is in, or 0 if it is in none of them.
+  static int32_t GetBand(uint32_t frequency);
+
+ private:
+  std::vector<std::array<uint8_t, ETH_ALEN>> bssids_;
+  std::vector<uint32_t> frequencies_;
+  std::vector<int32_t> signal_mbms_;
+  // |IWifiScannerImpl::SCAN_RESULT_BAND_*| value of each row. Rows in none
+  // of those bands have a bit of their own, which only queries for all
+  // bands match.
+  std::vector<uint8_t> bands_;
+  // 1 for the associated BSS, 0 otherwise.
+  std::vector<uint8_t> associated_;
+  // Microseconds since boot of when each row was last seen.
+  std::vector<uint64_t> last_seen_microseconds_;
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_SCANNING_SCAN_RESULT_TABLE_H_
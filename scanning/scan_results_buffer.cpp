@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/scanning/scan_results_buffer.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include <android-base/logging.h>
+
+using android::base::unique_fd;
+using android::net::wifi::nl80211::NativeScanResult;
+using android::net::wifi::nl80211::RadioChainInfo;
+using std::vector;
+
+namespace android {
+namespace wificond {
+namespace {
+
+constexpr size_t kHeaderSize = 16;
+constexpr size_t kRecordHeaderSize = 36;
+constexpr size_t kRadioChainSize = 8;
+constexpr size_t kRecordAlignment = 8;
+constexpr uint8_t kFlagAssociated = 1 << 0;
+
+// Header field offsets.
+constexpr size_t kMagicOffset = 0;
+constexpr size_t kVersionOffset = 4;
+constexpr size_t kHeaderSizeOffset = 6;
+constexpr size_t kNumRecordsOffset = 8;
+constexpr size_t kTotalSizeOffset = 12;
+
+// Record field offsets.
+constexpr size_t kRecordSizeOffset = 0;
+constexpr size_t kFrequencyOffset = 4;
+constexpr size_t kTsfOffset = 8;
+constexpr size_t kSignalMbmOffset = 16;
+constexpr size_t kIeLengthOffset = 20;
+constexpr size_t kCapabilityOffset = 24;
+constexpr size_t kBssidOffset = 26;
+constexpr size_t kSsidLengthOffset = 32;
+constexpr size_t kFlagsOffset = 33;
+constexpr size_t kNumRadioChainsOffset = 34;
+
+template <typename T>
+void Put(uint8_t* buffer, size_t offset, T value) {
+  memcpy(buffer + offset, &value, sizeof(value));
+}
+
+template <typename T>
+T Get(const uint8_t* buffer, size_t offset) {
+  T value;
+  memcpy(&value, buffer + offset, sizeof(value));
+  return value;
+}
+
+// Lengths are stored in one byte each.
+size_t GetSsidLength(const NativeScanResult& scan_result) {
+  return std::min<size_t>(scan_result.ssid.size(), UINT8_MAX);
+}
+
+size_t GetNumRadioChains(const NativeScanResult& scan_result) {
+  return std::min<size_t>(scan_result.radio_chain_infos.size(), UINT8_MAX);
+}
+
+size_t GetRecordSize(const NativeScanResult& scan_result) {
+  size_t size = kRecordHeaderSize +
+                GetNumRadioChains(scan_result) * kRadioChainSize +
+                GetSsidLength(scan_result) +
+                scan_result.info_element.size();
+  return (size + kRecordAlignment - 1) / kRecordAlignment * kRecordAlignment;
+}
+
+}  // namespace
+
+size_t ScanResultsBuffer::GetSize(const vector<NativeScanResult>& scan_results) {
+  size_t size = kHeaderSize;
+  for (const auto& scan_result : scan_results) {
+    size += GetRecordSize(scan_result);
+  }
+  return size;
+}
+
+void ScanResultsBuffer::Write(const vector<NativeScanResult>& scan_results,
+                              uint8_t* buffer) {
+  size_t offset = kHeaderSize;
+  for (const auto& scan_result : scan_results) {
+    uint8_t* record = buffer + offset;
+    size_t record_size = GetRecordSize(scan_result);
+    size_t ssid_length = GetSsidLength(scan_result);
+    size_t num_radio_chains = GetNumRadioChains(scan_result);
+    Put<uint32_t>(record, kRecordSizeOffset, record_size);
+    Put<uint32_t>(record, kFrequencyOffset, scan_result.frequency);
+    Put<uint64_t>(record, kTsfOffset, scan_result.tsf);
+    Put<int32_t>(record, kSignalMbmOffset, scan_result.signal_mbm);
+    Put<uint32_t>(record, kIeLengthOffset, scan_result.info_element.size());
+    Put<uint16_t>(record, kCapabilityOffset, scan_result.capability);
+    memcpy(record + kBssidOffset, scan_result.bssid.data(), ETH_ALEN);
+    record[kSsidLengthOffset] = ssid_length;
+    record[kFlagsOffset] = scan_result.associated ? kFlagAssociated : 0;
+    record[kNumRadioChainsOffset] = num_radio_chains;
+    uint8_t* ptr = record + kRecordHeaderSize;
+    for (size_t i = 0; i < num_radio_chains; i++) {
+      Put<int32_t>(ptr, 0, scan_result.radio_chain_infos[i].chain_id);
+      Put<int32_t>(ptr, 4, scan_result.radio_chain_infos[i].level);
+      ptr += kRadioChainSize;
+    }
+    memcpy(ptr, scan_result.ssid.data(), ssid_length);
+    ptr += ssid_length;
+    memcpy(ptr, scan_result.info_element.data(),
+           scan_result.info_element.size());
+    offset += record_size;
+  }
+  Put<uint32_t>(buffer, kMagicOffset, kMagic);
+  Put<uint16_t>(buffer, kVersionOffset, kVersion);
+  Put<uint16_t>(buffer, kHeaderSizeOffset, kHeaderSize);
+  Put<uint32_t>(buffer, kNumRecordsOffset, scan_results.size());
+  Put<uint32_t>(buffer, kTotalSizeOffset, offset);
+}
+
+bool ScanResultsBuffer::Read(const uint8_t* buffer,
+                             size_t size,
+                             vector<NativeScanResult>* out_scan_results) {
+  if (size < kHeaderSize ||
+      Get<uint32_t>(buffer, kMagicOffset) != kMagic) {
+    LOG(ERROR) << "Invalid scan results buffer header";
+    return false;
+  }
+  size_t header_size = Get<uint16_t>(buffer, kHeaderSizeOffset);
+  uint32_t num_records = Get<uint32_t>(buffer, kNumRecordsOffset);
+  size_t total_size = Get<uint32_t>(buffer, kTotalSizeOffset);
+  if (header_size < kHeaderSize || total_size > size ||
+      header_size > total_size) {
+    LOG(ERROR) << "Invalid scan results buffer size";
+    return false;
+  }
+  size_t offset = header_size;
+  for (uint32_t i = 0; i < num_records; i++) {
+    if (total_size - offset < kRecordHeaderSize) {
+      LOG(ERROR) << "Truncated scan result record";
+      return false;
+    }
+    const uint8_t* record = buffer + offset;
+    size_t record_size = Get<uint32_t>(record, kRecordSizeOffset);
+    size_t ie_length = Get<uint32_t>(record, kIeLengthOffset);
+    size_t ssid_length = record[kSsidLengthOffset];
+    size_t num_radio_chains = record[kNumRadioChainsOffset];
+    if (record_size > total_size - offset ||
+        record_size < kRecordHeaderSize ||
+        ie_length > record_size ||
+        kRecordHeaderSize + num_radio_chains * kRadioChainSize +
+            ssid_length + ie_length > record_size) {
+      LOG(ERROR) << "Invalid scan result record size";
+      return false;
+    }
+    NativeScanResult scan_result;
+    scan_result.frequency = Get<uint32_t>(record, kFrequencyOffset);
+    scan_result.tsf = Get<uint64_t>(record, kTsfOffset);
+    scan_result.signal_mbm = Get<int32_t>(record, kSignalMbmOffset);
+    scan_result.capability = Get<uint16_t>(record, kCapabilityOffset);
+    std::copy_n(record + kBssidOffset, ETH_ALEN, scan_result.bssid.begin());
+    scan_result.associated = record[kFlagsOffset] & kFlagAssociated;
+    const uint8_t* ptr = record + kRecordHeaderSize;
+    for (size_t j = 0; j < num_radio_chains; j++) {
+      scan_result.radio_chain_infos.emplace_back(Get<int32_t>(ptr, 0),
+                                                 Get<int32_t>(ptr, 4));
+      ptr += kRadioChainSize;
+    }
+    scan_result.ssid.assign(ptr, ptr + ssid_length);
+    ptr += ssid_length;
+    scan_result.info_element.assign(ptr, ptr + ie_length);
+    out_scan_results->push_back(std::move(scan_result));
+    offset += record_size;
+  }
+  return true;
+}
+
+unique_fd ScanResultsBuffer::CreateSharedMemory(
+    const vector<NativeScanResult>& scan_results) {
+  size_t size = GetSize(scan_results);
+  unique_fd fd(memfd_create("wificond_scan_results",
+                            MFD_CLOEXEC | MFD_ALLOW_SEALING));
+  if (fd.get() < 0) {
+    PLOG(ERROR) << "Failed to create memfd for scan results";
+    return unique_fd();
+  }
+  if (ftruncate(fd.get(), size) != 0) {
+    PLOG(ERROR) << "Failed to resize memfd for scan results";
+    return unique_fd();
+  }
+  void* buffer = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      fd.get(), 0);
+  if (buffer == MAP_FAILED) {
+    PLOG(ERROR) << "Failed to map memfd for scan results";
+    return unique_fd();
+  }
+  // A new memfd is zero filled.
+  Write(scan_results, static_cast<uint8_t*>(buffer));
+  munmap(buffer, size);
+  // F_SEAL_WRITE only succeeds once there is no writable mapping left.
+  if (fcntl(fd.get(), F_ADD_SEALS,
+            F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) != 0) {
+    PLOG(ERROR) << "Failed to seal memfd for scan results";
+    return unique_fd();
+  }
+  return fd;
+}
+
+}  // namespace wificond
+}  // namespace android
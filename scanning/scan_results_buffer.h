@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_SCANNING_SCAN_RESULTS_BUFFER_H_
+#define WIFICOND_SCANNING_SCAN_RESULTS_BUFFER_H_
+
+#include <vector>
+
+#include <android-base/macros.h>
+#include <android-base/unique_fd.h>
+
+#include "wificond/scanning/scan_result.h"
+
+namespace android {
+namespace wificond {
+
+// Serializes scan results into a flat buffer that is handed out as sealed
+// shared memory, so bulk scan results do not have to go through a binder
+// parcel.
+//
+// All fields are in host byte order. The buffer starts with a header:
+//   offset size
+//   0      4    magic, kMagic
+//   4      2    layout version, kVersion
+//   6      2    header size in bytes, from the start of the buffer to the
+//               first record
+//   8      4    number of records
+//   12     4    total size of the buffer in bytes
+// Then one record per scan result. Records start at 8 byte aligned offsets:
+//   0      4    record size in bytes, including padding, so that the next
+//               record starts at this offset plus the record size
+//   4      4    frequency in MHz
+//   8      8    TSF
+//   16     4    signal strength in (100 * dBm), signed
+//   20     4    length of the information elements in bytes
+//   24     2    capability
+//   26     6    BSSID
+//   32     1    length of the SSID in bytes
+//   33     1    flags, bit 0 is set if the BSS is associated
+//   34     1    number of radio chains
+//   35     1    reserved, 0
+//   36     8*n  radio chains, each a signed 4 byte chain id followed by a
+//               signed 4 byte level in dBm
+//   ...         SSID, followed by the information elements
+// Readers must skip any header bytes and record bytes that they do not know
+// about, so that later versions can append fields.
+class ScanResultsBuffer {
+ public:
+  static constexpr uint32_t kMagic = 0x57534352;  // "WSCR"
+  static constexpr uint16_t kVersion = 1;
+
+  ScanResultsBuffer() = default;
+
+  // Returns the size of the buffer holding |scan_results|.
+  static size_t GetSize(
+      const std::vector<android::net::wifi::nl80211::NativeScanResult>&
+          scan_results);
+  // Writes |scan_results| to |buffer|, which must be zero filled and
+  // |GetSize(scan_results)| bytes long.
+  static void Write(
+      const std::vector<android::net::wifi::nl80211::NativeScanResult>&
+          scan_results,
+      uint8_t* buffer);
+  // Parses a buffer of |size| bytes written by |Write|.
+  // Returns false if the buffer is malformed.
+  static bool Read(
+      const uint8_t* buffer,
+      size_t size,
+      std::vector<android::net::wifi::nl80211::NativeScanResult>*
+          out_scan_results);
+  // Creates a read-only, sealed memfd holding |scan_results|.
+  // The results are written straight into the shared memory.
+  // Returns an invalid fd on failure.
+  static android::base::unique_fd CreateSharedMemory(
+      const std::vector<android::net::wifi::nl80211::NativeScanResult>&
+          scan_results);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ScanResultsBuffer);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_SCANNING_SCAN_RESULTS_BUFFER_H_
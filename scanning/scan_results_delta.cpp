@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/scanning/scan_results_delta.h"
+
+#include <algorithm>
+
+#include <android-base/logging.h>
+
+#include "wificond/parcelable_utils.h"
+
+using android::status_t;
+
+namespace android {
+namespace net {
+namespace wifi {
+namespace nl80211 {
+
+status_t NativeScanResultsDelta::writeToParcel(
+    ::android::Parcel* parcel) const {
+  RETURN_IF_FAILED(parcel->writeInt64(generation));
+  RETURN_IF_FAILED(parcel->writeInt32(is_full ? 1 : 0));
+  RETURN_IF_FAILED(parcel->writeInt32(updated_scan_results.size()));
+  for (const auto& scan_result : updated_scan_results) {
+    // For Java readTypedList():
+    // A leading number 1 means this object is not null.
+    RETURN_IF_FAILED(parcel->writeInt32(1));
+    RETURN_IF_FAILED(scan_result.writeToParcel(parcel));
+  }
+  if (removed_bssids.size() != removed_frequencies.size()) {
+    LOG(ERROR) << "Mismatched removed BSSIDs and frequencies";
+    return ::android::BAD_VALUE;
+  }
+  RETURN_IF_FAILED(parcel->writeInt32(removed_bssids.size()));
+  for (size_t i = 0; i < removed_bssids.size(); i++) {
+    RETURN_IF_FAILED(parcel->writeByteVector(
+        std::vector<uint8_t>(removed_bssids[i].begin(),
+                             removed_bssids[i].end())));
+    RETURN_IF_FAILED(parcel->writeUint32(removed_frequencies[i]));
+  }
+  return ::android::OK;
+}
+
+status_t NativeScanResultsDelta::readFromParcel(
+    const ::android::Parcel* parcel) {
+  RETURN_IF_FAILED(parcel->readInt64(&generation));
+  int32_t is_full_value = 0;
+  RETURN_IF_FAILED(parcel->readInt32(&is_full_value));
+  is_full = (is_full_value != 0);
+  int32_t num_updated_scan_results = 0;
+  RETURN_IF_FAILED(parcel->readInt32(&num_updated_scan_results));
+  for (int i = 0; i < num_updated_scan_results; i++) {
+    NativeScanResult scan_result;
+    // From Java writeTypedList():
+    // A leading number 1 means this object is not null.
+    // We never expect a 0 or other values here.
+    int32_t leading_number = 0;
+    RETURN_IF_FAILED(parcel->readInt32(&leading_number));
+    if (leading_number != 1) {
+      LOG(ERROR) << "Unexpected leading number before an object: "
+                 << leading_number;
+      return ::android::BAD_VALUE;
+    }
+    RETURN_IF_FAILED(scan_result.readFromParcel(parcel));
+    updated_scan_results.push_back(std::move(scan_result));
+  }
+  int32_t num_removed_bssids = 0;
+  RETURN_IF_FAILED(parcel->readInt32(&num_removed_bssids));
+  for (int i = 0; i < num_removed_bssids; i++) {
+    std::vector<uint8_t> bssid_vec;
+    RETURN_IF_FAILED(parcel->readByteVector(&bssid_vec));
+    if (bssid_vec.size() != ETH_ALEN) {
+      LOG(ERROR) << "bssid length expected " << ETH_ALEN << " bytes, but got "
+                 << bssid_vec.size() << " bytes";
+      return ::android::BAD_VALUE;
+    }
+    std::array<uint8_t, ETH_ALEN> bssid;
+    std::copy_n(bssid_vec.begin(), ETH_ALEN, bssid.begin());
+    uint32_t frequency = 0;
+    RETURN_IF_FAILED(parcel->readUint32(&frequency));
+    removed_bssids.push_back(bssid);
+    removed_frequencies.push_back(frequency);
+  }
+  return ::android::OK;
+}
+
+}  // namespace nl80211
+}  // namespace wifi
+}  // namespace net
+}  // namespace android
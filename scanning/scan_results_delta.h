@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_SCANNING_SCAN_RESULTS_DELTA_H_
+#define WIFICOND_SCANNING_SCAN_RESULTS_DELTA_H_
+
+#include <array>
+#include <vector>
+
+#include <linux/if_ether.h>
+
+#include <binder/Parcel.h>
+#include <binder/Parcelable.h>
+
+#include "wificond/scanning/scan_result.h"
+
+namespace android {
+namespace net {
+namespace wifi {
+namespace nl80211 {
+
+// Scan results that changed since a previous generation of the scan results
+// of an interface.
+class NativeScanResultsDelta : public ::android::Parcelable {
+ public:
+  NativeScanResultsDelta() = default;
+  ::android::status_t writeToParcel(::android::Parcel* parcel) const override;
+  ::android::status_t readFromParcel(const ::android::Parcel* parcel) override;
+
+  // Generation of the scan results this delta brings the caller up to.
+  // This is to be passed in with the next delta query.
+  int64_t generation = 0;
+  // If true, |updated_scan_results| holds all scan results and any scan
+  // results the caller kept from earlier generations are to be dropped.
+  // This happens when the requested generation is unknown or too old.
+  bool is_full = false;
+  // BSSs that were added or updated.
+  std::vector<NativeScanResult> updated_scan_results;
+  // BSSs that expired, identified by BSSID and frequency in MHz.
+  // Removals are to be applied before updates, because a BSS might expire
+  // and show up again within one delta.
+  std::vector<std::array<uint8_t, ETH_ALEN>> removed_bssids;
+  std::vector<uint32_t> removed_frequencies;
+};
+
+}  // namespace nl80211
+}  // namespace wifi
+}  // namespace net
+}  // namespace android
+
+#endif  // WIFICOND_SCANNING_SCAN_RESULTS_DELTA_H_
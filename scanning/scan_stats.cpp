@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/scanning/scan_stats.h"
+
+#include "wificond/parcelable_utils.h"
+
+using android::status_t;
+
+namespace android {
+namespace net {
+namespace wifi {
+namespace nl80211 {
+
+status_t NativeScanStats::writeToParcel(::android::Parcel* parcel) const {
+  RETURN_IF_FAILED(parcel->writeInt32(source_));
+  RETURN_IF_FAILED(parcel->writeInt32(scan_type_));
+  RETURN_IF_FAILED(parcel->writeInt32(band_));
+  RETURN_IF_FAILED(parcel->writeInt64(num_scans_));
+  RETURN_IF_FAILED(parcel->writeInt64(num_aborted_scans_));
+  RETURN_IF_FAILED(parcel->writeInt64(num_channels_));
+  RETURN_IF_FAILED(parcel->writeInt64(total_latency_ms_));
+  RETURN_IF_FAILED(parcel->writeInt64(max_latency_ms_));
+  RETURN_IF_FAILED(parcel->writeInt64(num_bss_));
+  return ::android::OK;
+}
+
+status_t NativeScanStats::readFromParcel(const ::android::Parcel* parcel) {
+  RETURN_IF_FAILED(parcel->readInt32(&source_));
+  RETURN_IF_FAILED(parcel->readInt32(&scan_type_));
+  RETURN_IF_FAILED(parcel->readInt32(&band_));
+  RETURN_IF_FAILED(parcel->readInt64(&num_scans_));
+  RETURN_IF_FAILED(parcel->readInt64(&num_aborted_scans_));
+  RETURN_IF_FAILED(parcel->readInt64(&num_channels_));
+  RETURN_IF_FAILED(parcel->readInt64(&total_latency_ms_));
+  RETURN_IF_FAILED(parcel->readInt64(&max_latency_ms_));
+  RETURN_IF_FAILED(parcel->readInt64(&num_bss_));
+  return ::android::OK;
+}
+
+}  // namespace nl80211
+}  // namespace wifi
+}  // namespace net
+}  // namespace android
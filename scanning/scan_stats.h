@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_SCANNING_SCAN_STATS_H_
+#define WIFICOND_SCANNING_SCAN_STATS_H_
+
+#include <binder/Parcel.h>
+#include <binder/Parcelable.h>
+
+namespace android {
+namespace net {
+namespace wifi {
+namespace nl80211 {
+
+// Cost of the scans of one scan type, band and trigger source of an
+// interface. See |IWifiScannerImpl.getScanStats()|.
+class NativeScanStats : public ::android::Parcelable {
+ public:
+  NativeScanStats() = default;
+  bool operator==(const NativeScanStats& rhs) const {
+    return source_ == rhs.source_ &&
+           scan_type_ == rhs.scan_type_ &&
+           band_ == rhs.band_ &&
+           num_scans_ == rhs.num_scans_ &&
+           num_aborted_scans_ == rhs.num_aborted_scans_ &&
+           num_channels_ == rhs.num_channels_ &&
+           total_latency_ms_ == rhs.total_latency_ms_ &&
+           max_latency_ms_ == rhs.max_latency_ms_ &&
+           num_bss_ == rhs.num_bss_;
+  }
+  ::android::status_t writeToParcel(::android::Parcel* parcel) const override;
+  ::android::status_t readFromParcel(const ::android::Parcel* parcel) override;
+
+  // |IWifiScannerImpl::SCAN_SOURCE_*| value.
+  int32_t source_ = 0;
+  // |IWifiScannerImpl::SCAN_TYPE_*| value.
+  int32_t scan_type_ = 0;
+  // |IWifiScannerImpl::SCAN_RESULT_BAND_*| value.
+  int32_t band_ = 0;
+  // Scans that covered channels of |band_|, the aborted ones included.
+  int64_t num_scans_ = 0;
+  int64_t num_aborted_scans_ = 0;
+  // Channels of |band_| scanned in total.
+  int64_t num_channels_ = 0;
+  // Time from triggering scans to their results. This is only known for
+  // the single scans that wificond triggers.
+  int64_t total_latency_ms_ = 0;
+  int64_t max_latency_ms_ = 0;
+  // BSSs of |band_| that the scan results held after the scans that were
+  // not aborted.
+  int64_t num_bss_ = 0;
+};
+
+}  // namespace nl80211
+}  // namespace wifi
+}  // namespace net
+}  // namespace android
+
+#endif  // WIFICOND_SCANNING_SCAN_STATS_H_
@@ -14,26 +14,53 @@
  * limitations under the License.
  */
 
+#define ATRACE_TAG ATRACE_TAG_NETWORK
+
 #include "android/net/wifi/nl80211/IWifiScannerImpl.h"
 #include "wificond/scanning/scan_utils.h"
 
+#include <algorithm>
 #include <array>
+#include <functional>
+#include <future>
+#include <limits>
+#include <queue>
+#include <string_view>
+#include <unordered_set>
 #include <vector>
 
 #include <linux/netlink.h>
 #include <linux/if_ether.h>
 
 #include <android-base/logging.h>
+#include <utils/Timers.h>
+#include <utils/Trace.h>
 
+#include "wificond/log_rate_limiter.h"
+#include "wificond/net/channel_set.h"
 #include "wificond/net/kernel-header-latest/nl80211.h"
 #include "wificond/net/netlink_manager.h"
 #include "wificond/net/nl80211_packet.h"
+#include "wificond/net/nl80211_packet_view.h"
+#include "wificond/scanning/info_element_utils.h"
+#include "wificond/scanning/network_matcher.h"
 #include "wificond/scanning/scan_result.h"
+#include "wificond/scanning/scan_result_batch.h"
+#include "wificond/scanning/scan_result_query.h"
+#include "wificond/scanning/scan_result_selection.h"
+#include "wificond/scanning/scan_result_table.h"
+#include "wificond/scanning/scan_results_delta.h"
+#include "wificond/worker_pool.h"
 
 using android::net::wifi::nl80211::IWifiScannerImpl;
+using android::net::wifi::nl80211::InfoElementLocation;
+using android::net::wifi::nl80211::NativeChannelCongestion;
 using android::net::wifi::nl80211::NativeScanResult;
+using android::net::wifi::nl80211::NativeScanResultsDelta;
 using android::net::wifi::nl80211::RadioChainInfo;
+using android::net::wifi::nl80211::ScanResultQuery;
 using std::array;
+using std::string;
 using std::unique_ptr;
 using std::vector;
 
@@ -43,11 +70,222 @@ namespace {
 
 constexpr uint8_t kElemIdSsid = 0;
 constexpr unsigned int kMsecPerSec = 1000;
+// NL80211_BSS_STATUS value used when kernel does not report a status.
+constexpr uint32_t kBssStatusNone = 0xffffffff;
+// Number of expired BSSs kept per interface to compute scan result deltas.
+// Deltas from older generations are sent as full scan results.
+constexpr size_t kMaxRemovedBssHistory = 256;
+// Default maximum number of BSSs cached per interface.
+constexpr size_t kDefaultScanResultCacheCapacity = 1024;
+// Number of BSSs of a dump that a worker thread parses at once. Dumps with
+// fewer BSSs to parse are parsed on the calling thread.
+constexpr size_t kParseBatchSize = 64;
+
+// Decodes attribute |id| from the payload of a nested attribute in place.
+template <typename T>
+bool GetNestedAttributeValue(const uint8_t* payload,
+                             size_t payload_length,
+                             int id,
+                             T* value) {
+  uint8_t* start = nullptr;
+  uint8_t* end = nullptr;
+  if (!BaseNL80211Attr::GetAttributeImpl(payload, payload_length, id,
+                                         &start, &end)) {
+    return false;
+  }
+  return NL80211AttrValueDecoder<T>::Decode(start, end, value);
+}
+
+// Returns the size of a nested attribute listing |ssids|.
+size_t GetSsidListSize(const vector<vector<uint8_t>>& ssids) {
+  size_t size = NL80211Packet::GetAttributeSize(0);
+  for (const vector<uint8_t>& ssid : ssids) {
+    size += NL80211Packet::GetAttributeSize(ssid.size());
+  }
+  return size;
+}
+
+// Returns the size of a nested attribute listing |freqs|.
+size_t GetFrequencyListSize(const vector<uint32_t>& freqs) {
+  return NL80211Packet::GetAttributeSize(0) +
+      freqs.size() * NL80211Packet::GetAttributeSize(sizeof(uint32_t));
+}
+
+// Appends nested attribute |id| to |packet|, listing |ssids| with ids from 0.
+void AddSsidList(NL80211Packet* packet,
+                 int id,
+                 const vector<vector<uint8_t>>& ssids) {
+  size_t ssids_attr = packet->BeginNestedAttribute(id);
+  for (size_t i = 0; i < ssids.size(); i++) {
+    packet->AddAttributeBytes(i, ssids[i].data(), ssids[i].size());
+  }
+  packet->EndNestedAttribute(ssids_attr);
+}
+
+// Appends nested attribute |id| to |packet|, listing |freqs| with ids from 0.
+void AddFrequencyList(NL80211Packet* packet,
+                      int id,
+                      const vector<uint32_t>& freqs) {
+  size_t freqs_attr = packet->BeginNestedAttribute(id);
+  for (size_t i = 0; i < freqs.size(); i++) {
+    packet->AddAttributeValue<uint32_t>(i, freqs[i]);
+  }
+  packet->EndNestedAttribute(freqs_attr);
+}
+
+bool IsAssociatedBssStatus(uint32_t bss_status) {
+  return bss_status == NL80211_BSS_STATUS_AUTHENTICATED ||
+         bss_status == NL80211_BSS_STATUS_ASSOCIATED;
+}
+
+bool IsInBands(uint32_t frequency, int32_t bands) {
+  return bands == 0 || (ScanResultTable::GetBand(frequency) & bands) != 0;
+}
+
+// Checks the predicates of |query| except for the SSID.
+bool MatchesQuery(const ScanResultQuery& query,
+                  uint32_t frequency,
+                  int32_t signal_mbm,
+                  bool associated) {
+  return (!query.associated_only || associated) &&
+         IsInBands(frequency, query.bands) &&
+         signal_mbm >= query.min_signal_mbm;
+}
+
+// Reads the microseconds since boot of when kernel last received a frame of
+// the BSS whose attributes are the |bss_length| bytes at |bss|.
+// Falls back to the TSF of the BSS on kernels that do not report the boot
+// time.
+bool GetBssLastSeen(const uint8_t* bss,
+                    size_t bss_length,
+                    uint64_t* last_seen_since_boot_microseconds) {
+  uint64_t last_seen_since_boot_nanoseconds;
+  if (GetNestedAttributeValue(bss, bss_length, NL80211_BSS_LAST_SEEN_BOOTTIME,
+                              &last_seen_since_boot_nanoseconds)) {
+    *last_seen_since_boot_microseconds = last_seen_since_boot_nanoseconds / 1000;
+    return true;
+  }
+  if (!GetNestedAttributeValue(bss, bss_length, NL80211_BSS_TSF,
+                               last_seen_since_boot_microseconds)) {
+    return false;
+  }
+  uint64_t beacon_tsf_microseconds;
+  if (GetNestedAttributeValue(bss, bss_length, NL80211_BSS_BEACON_TSF,
+                              &beacon_tsf_microseconds)) {
+    *last_seen_since_boot_microseconds = std::max(
+        *last_seen_since_boot_microseconds, beacon_tsf_microseconds);
+  }
+  return true;
+}
+
+// Returns true if the BSSID of the BSS whose attributes are the
+// |bss_length| bytes at |bss| is one of |excluded_bssids|.
+bool IsExcludedBss(const uint8_t* bss,
+                   size_t bss_length,
+                   const BssidMatcher& excluded_bssids) {
+  uint8_t* start = nullptr;
+  uint8_t* end = nullptr;
+  const uint8_t* bssid;
+  size_t bssid_length;
+  return BaseNL80211Attr::GetAttributeImpl(bss, bss_length, NL80211_BSS_BSSID,
+                                           &start, &end) &&
+         BaseNL80211Attr::GetPayloadImpl(start, end, &bssid, &bssid_length) &&
+         bssid_length == ETH_ALEN &&
+         excluded_bssids.Matches(bssid);
+}
+
+// Returns the microseconds since boot before which BSSs are too old for
+// |query|, or 0 if |query| takes BSSs of any age.
+uint64_t GetMinLastSeen(const ScanResultQuery& query) {
+  if (query.max_age_ms <= 0) {
+    return 0;
+  }
+  int64_t now_microseconds = ns2us(systemTime(SYSTEM_TIME_BOOTTIME));
+  int64_t max_age_microseconds = query.max_age_ms * 1000;
+  if (now_microseconds <= max_age_microseconds) {
+    return 0;
+  }
+  return now_microseconds - max_age_microseconds;
+}
+
+// Returns when |scan_result| was last seen, for leaving out the BSSs seen
+// least recently once a cache is full. The associated BSS is never left out.
+uint64_t GetLastSeen(const NativeScanResult& scan_result) {
+  return scan_result.associated ? std::numeric_limits<uint64_t>::max()
+                                : scan_result.tsf;
+}
+
+// Keeps the |max_results| scan results of |scan_results| from |begin| on
+// with the strongest signal, ordered from the strongest to the weakest.
+void KeepStrongestScanResults(size_t max_results,
+                              size_t begin,
+                              vector<NativeScanResult>* scan_results) {
+  std::stable_sort(scan_results->begin() + begin, scan_results->end(),
+                   [](const NativeScanResult& lhs,
+                      const NativeScanResult& rhs) {
+                     return lhs.signal_mbm > rhs.signal_mbm;
+                   });
+  if (scan_results->size() - begin > max_results) {
+    scan_results->erase(scan_results->begin() + begin + max_results,
+                        scan_results->end());
+  }
+}
+
+// Copies the fields of |scan_result| that |fields| asks for.
+NativeScanResult ProjectScanResult(const NativeScanResult& scan_result,
+                                   int32_t fields) {
+  NativeScanResult projection;
+  projection.bssid = scan_result.bssid;
+  projection.frequency = scan_result.frequency;
+  projection.signal_mbm = scan_result.signal_mbm;
+  projection.associated = scan_result.associated;
+  projection.tsf = 0;
+  projection.capability = 0;
+  if (fields & IWifiScannerImpl::SCAN_RESULT_FIELD_SSID) {
+    projection.ssid = scan_result.ssid;
+  }
+  if (fields & IWifiScannerImpl::SCAN_RESULT_FIELD_INFO_ELEMENT) {
+    projection.info_element = scan_result.info_element;
+  }
+  if (fields & IWifiScannerImpl::SCAN_RESULT_FIELD_TSF) {
+    projection.tsf = scan_result.tsf;
+  }
+  if (fields & IWifiScannerImpl::SCAN_RESULT_FIELD_CAPABILITY) {
+    projection.capability = scan_result.capability;
+  }
+  if (fields & IWifiScannerImpl::SCAN_RESULT_FIELD_RADIO_CHAIN_INFOS) {
+    projection.radio_chain_infos = scan_result.radio_chain_infos;
+  }
+  if (fields & IWifiScannerImpl::SCAN_RESULT_FIELD_IE_INDEX) {
+    projection.info_element_index = scan_result.info_element_index;
+    projection.security = scan_result.security;
+    projection.channel_width = scan_result.channel_width;
+    projection.wifi_standard = scan_result.wifi_standard;
+  }
+  return projection;
+}
+
+// Reads the error code of the NLMSG_ERROR message acknowledging a request
+// that was sent with NLM_F_ACK, from its |response|.
+bool GetAckErrorCode(const vector<unique_ptr<const NL80211Packet>>& response,
+                     int* error_code) {
+  if (response.size() != 1 ||
+      response[0]->GetMessageType() != NLMSG_ERROR) {
+    LOG(ERROR) << "Unexpected response to a request with NLM_F_ACK";
+    return false;
+  }
+  *error_code = response[0]->GetErrorCode();
+  return true;
+}
 
 }  // namespace
 
 ScanUtils::ScanUtils(NetlinkManager* netlink_manager)
-    : netlink_manager_(netlink_manager) {
+    : netlink_manager_(netlink_manager),
+      last_scan_results_generation_(0),
+      scan_result_cache_capacity_(kDefaultScanResultCacheCapacity),
+      num_evicted_bss_(0),
+      scan_result_memory_("scan result cache") {
   if (!netlink_manager_->IsStarted()) {
     netlink_manager_->Start();
   }
@@ -55,21 +293,173 @@ ScanUtils::ScanUtils(NetlinkManager* netlink_manager)
 
 ScanUtils::~ScanUtils() {}
 
+void ScanUtils::SetScanResultCacheCapacity(size_t max_bss) {
+  scan_result_cache_capacity_ = std::max<size_t>(max_bss, 1);
+}
+
+void ScanUtils::SetNumParseThreads(size_t num_threads) {
+  parse_pool_.reset(num_threads > 0 ? new WorkerPool(num_threads) : nullptr);
+}
+
+void ScanUtils::DumpScanResultCache(std::stringstream* ss) const {
+  size_t num_bss = 0;
+  size_t num_bytes = 0;
+  size_t num_duplicate_ie_bytes = 0;
+  for (const auto& cache : scan_result_cache_) {
+    num_bss += cache.second.scan_results.size();
+    num_bytes += cache.second.num_bytes;
+    num_duplicate_ie_bytes += cache.second.num_duplicate_ie_bytes;
+  }
+  *ss << "Scan result cache: " << num_bss << " BSSs of "
+      << scan_result_cache_.size() << " interfaces in " << num_bytes
+      << " bytes, " << num_duplicate_ie_bytes
+      << " bytes of duplicate information elements, capacity "
+      << scan_result_cache_capacity_ << " BSSs per interface, "
+      << num_evicted_bss_ << " BSSs evicted" << std::endl;
+}
+
+void ScanUtils::GetMemoryAccounts(vector<MemoryAccount>* accounts) const {
+  accounts->push_back(scan_result_memory_);
+}
+
+void ScanUtils::TrimScanResultCache() {
+  scan_result_cache_.clear();
+  UpdateScanResultMemoryAccount();
+}
+
 void ScanUtils::SubscribeScanResultNotification(
     uint32_t interface_index,
     OnScanResultsReadyHandler handler) {
-  netlink_manager_->SubscribeScanResultNotification(interface_index, handler);
+  netlink_manager_->SubscribeScanResultNotification(
+      interface_index,
+      [this, handler](uint32_t interface_index,
+                      bool aborted,
+                      vector<vector<uint8_t>>& ssids,
+                      vector<uint32_t>& frequencies) {
+        // Partial results are available even if the scan was aborted.
+        MarkScanResultsChanged(interface_index);
+        handler(interface_index, aborted, ssids, frequencies);
+      });
 }
 
 void ScanUtils::UnsubscribeScanResultNotification(uint32_t interface_index) {
   netlink_manager_->UnsubscribeScanResultNotification(interface_index);
+  scan_result_cache_.erase(interface_index);
+  UpdateScanResultMemoryAccount();
 }
 
 void ScanUtils::SubscribeSchedScanResultNotification(
     uint32_t interface_index,
     OnSchedScanResultsReadyHandler handler) {
-  netlink_manager_->SubscribeSchedScanResultNotification(interface_index,
-                                                         handler);
+  netlink_manager_->SubscribeSchedScanResultNotification(
+      interface_index,
+      [this, handler](uint32_t interface_index, bool scan_stopped) {
+        MarkScanResultsChanged(interface_index);
+        handler(interface_index, scan_stopped);
+      });
+}
+
+void ScanUtils::MarkScanResultsChanged(uint32_t interface_index) {
+  scan_result_cache_[interface_index].up_to_date = false;
+  for (const auto& peers : peer_radio_interfaces_) {
+    if (std::find(peers.second.begin(), peers.second.end(),
+                  interface_index) == peers.second.end()) {
+      continue;
+    }
+    auto cache = scan_result_cache_.find(peers.first);
+    if (cache != scan_result_cache_.end()) {
+      cache->second.up_to_date = false;
+    }
+  }
+}
+
+bool ScanUtils::HasUpToDateScanResults(uint32_t interface_index) const {
+  const auto cache = scan_result_cache_.find(interface_index);
+  return cache != scan_result_cache_.end() && cache->second.up_to_date;
+}
+
+bool ScanUtils::UpdateScanResultCache(uint32_t interface_index) {
+  ATRACE_CALL();
+  return GetUpToDateScanResultCache(interface_index) != nullptr;
+}
+
+size_t ScanUtils::GetNumScanResults(uint32_t interface_index,
+                                    int32_t band) const {
+  const auto cache = scan_result_cache_.find(interface_index);
+  if (cache == scan_result_cache_.end()) {
+    return 0;
+  }
+  const ScanResultTable& table = cache->second.table;
+  size_t num_scan_results = 0;
+  for (size_t row = 0; row < table.size(); row++) {
+    if (ScanResultTable::GetBand(table.GetFrequency(row)) == band) {
+      num_scan_results++;
+    }
+  }
+  return num_scan_results;
+}
+
+void ScanUtils::GetColocated6GhzFrequencies(
+    uint32_t interface_index,
+    vector<uint32_t>* out_frequencies) const {
+  out_frequencies->clear();
+  const auto cache = scan_result_cache_.find(interface_index);
+  if (cache == scan_result_cache_.end()) {
+    return;
+  }
+  vector<ReducedNeighbor> neighbors;
+  for (const auto& scan_result : cache->second.scan_results) {
+    InfoElementUtils::GetReducedNeighbors(scan_result.info_element.data(),
+                                          scan_result.info_element_index,
+                                          &neighbors);
+  }
+  ChannelSet frequencies;
+  for (const auto& neighbor : neighbors) {
+    if (ScanResultTable::GetBand(neighbor.frequency) ==
+        IWifiScannerImpl::SCAN_RESULT_BAND_6G) {
+      frequencies.Add(neighbor.frequency);
+    }
+  }
+  frequencies.AppendTo(out_frequencies);
+}
+
+bool ScanUtils::GetChannelCongestion(
+    uint32_t interface_index,
+    vector<NativeChannelCongestion>* out_channels) {
+  const ScanResultCache* cache = GetUpToDateScanResultCache(interface_index);
+  if (cache == nullptr) {
+    return false;
+  }
+  *out_channels = cache->congestion.GetChannels();
+  return true;
+}
+
+void ScanUtils::InvalidateScanResultCache(uint32_t interface_index) {
+  auto cache = scan_result_cache_.find(interface_index);
+  if (cache != scan_result_cache_.end()) {
+    cache->second.up_to_date = false;
+    cache->second.has_generation = false;
+  }
+}
+
+void ScanUtils::SetPeerRadioInterfaces(
+    uint32_t interface_index,
+    const vector<uint32_t>& peer_interface_indices) {
+  if (peer_interface_indices.empty()) {
+    peer_radio_interfaces_.erase(interface_index);
+  } else {
+    peer_radio_interfaces_[interface_index] = peer_interface_indices;
+  }
+  InvalidateScanResultCache(interface_index);
+}
+
+bool ScanUtils::OpenChannelHistory(const string& path) {
+  return channel_history_.Open(path);
+}
+
+bool ScanUtils::GetChannelHistory(const vector<uint8_t>& ssid,
+                                  vector<uint32_t>* out_frequencies) const {
+  return channel_history_.Get(ssid, out_frequencies);
 }
 
 void ScanUtils::UnsubscribeSchedScanResultNotification(
@@ -79,64 +469,652 @@ void ScanUtils::UnsubscribeSchedScanResultNotification(
 
 bool ScanUtils::GetScanResult(uint32_t interface_index,
                               vector<NativeScanResult>* out_scan_results) {
+  ATRACE_CALL();
+  const ScanResultCache* cache = GetUpToDateScanResultCache(interface_index);
+  if (cache == nullptr) {
+    return false;
+  }
+  out_scan_results->insert(out_scan_results->end(),
+                           cache->scan_results.begin(),
+                           cache->scan_results.end());
+  return true;
+}
+
+bool ScanUtils::GetScanResultBatch(uint32_t interface_index,
+                                   ScanResultBatch* out_batch) {
+  ATRACE_CALL();
+  const ScanResultCache* cache = GetUpToDateScanResultCache(interface_index);
+  if (cache == nullptr) {
+    return false;
+  }
+  out_batch->Assign(cache->scan_results);
+  return true;
+}
+
+bool ScanUtils::GetScanResult(uint32_t interface_index,
+                              const SsidMatcher& ssids,
+                              vector<NativeScanResult>* out_scan_results) {
+  ATRACE_CALL();
+  const ScanResultCache* cache = GetUpToDateScanResultCache(interface_index);
+  if (cache == nullptr) {
+    return false;
+  }
+  for (const NativeScanResult& scan_result : cache->scan_results) {
+    if (ssids.Matches(scan_result.ssid)) {
+      out_scan_results->push_back(scan_result);
+    }
+  }
+  return true;
+}
+
+bool ScanUtils::GetScanResultBatch(uint32_t interface_index,
+                                   const SsidMatcher& ssids,
+                                   ScanResultBatch* out_batch) {
+  ATRACE_CALL();
+  const ScanResultCache* cache = GetUpToDateScanResultCache(interface_index);
+  if (cache == nullptr) {
+    return false;
+  }
+  out_batch->Clear();
+  for (const NativeScanResult& scan_result : cache->scan_results) {
+    if (ssids.Matches(scan_result.ssid)) {
+      out_batch->Add(scan_result);
+    }
+  }
+  return true;
+}
+
+bool ScanUtils::GetScanResultDelta(uint32_t interface_index,
+                                   int64_t generation,
+                                   NativeScanResultsDelta* out_delta) {
+  const ScanResultCache* cache = GetUpToDateScanResultCache(interface_index);
+  if (cache == nullptr) {
+    return false;
+  }
+  out_delta->generation = cache->results_generation;
+  if (generation < cache->oldest_generation ||
+      generation > cache->results_generation) {
+    out_delta->is_full = true;
+    out_delta->updated_scan_results.insert(
+        out_delta->updated_scan_results.end(),
+        cache->scan_results.begin(),
+        cache->scan_results.end());
+    return true;
+  }
+  out_delta->is_full = false;
+  for (const auto& removed_bss : cache->removed_bsss) {
+    if (removed_bss.generation > generation) {
+      out_delta->removed_bssids.push_back(removed_bss.key.first);
+      out_delta->removed_frequencies.push_back(removed_bss.key.second);
+    }
+  }
+  for (const auto& cached_bss : cache->bss_index) {
+    if (cached_bss.second.generation > generation) {
+      out_delta->updated_scan_results.push_back(
+          cache->scan_results[cached_bss.second.index]);
+    }
+  }
+  return true;
+}
+
+bool ScanUtils::QueryScanResults(uint32_t interface_index,
+                                 const ScanResultQuery& query,
+                                 vector<NativeScanResult>* out_scan_results) {
+  // Stale BSSs are left out before any of their fields are copied.
+  const uint64_t min_last_seen = GetMinLastSeen(query);
+  SsidMatcher ssids(query.ssids);
+  if (!query.ssid.empty()) {
+    ssids.Add(query.ssid);
+  }
+  BssidMatcher excluded_bssids;
+  for (const auto& bssid : query.excluded_bssids) {
+    if (!excluded_bssids.Add(bssid)) {
+      LOG(WARNING) << "Ignore excluded BSSID of invalid length "
+                   << bssid.size();
+    }
+  }
+  auto cache = scan_result_cache_.find(interface_index);
+  if ((cache == scan_result_cache_.end() || !cache->second.up_to_date) &&
+      peer_radio_interfaces_.count(interface_index) > 0) {
+    // Scan results of peer radios are only merged in the cache.
+    if (GetUpToDateScanResultCache(interface_index) == nullptr) {
+      return false;
+    }
+    cache = scan_result_cache_.find(interface_index);
+  }
+  if (cache != scan_result_cache_.end() && cache->second.up_to_date) {
+    // Rows are selected from the hot columns of the table. Only the
+    // selected scan results are touched.
+    const vector<NativeScanResult>& scan_results = cache->second.scan_results;
+    vector<uint32_t> rows;
+    const ScanResultTable& table = cache->second.table;
+    table.Filter(query, &rows, min_last_seen);
+    if (!ssids.empty() || !excluded_bssids.empty()) {
+      rows.erase(std::remove_if(rows.begin(), rows.end(),
+                                [&](uint32_t row) {
+                                  return (!ssids.empty() &&
+                                          !ssids.Matches(
+                                              scan_results[row].ssid)) ||
+                                         (!excluded_bssids.empty() &&
+                                          excluded_bssids.Matches(
+                                              table.GetBssid(row)));
+                                }),
+                 rows.end());
+    }
+    ScanResultQuota quota(query);
+    if (quota.IsLimited()) {
+      SelectStrongest(
+          std::max(query.max_results, 0), 0,
+          [&table](uint32_t lhs, uint32_t rhs) {
+            if (table.GetSignalMbm(lhs) != table.GetSignalMbm(rhs)) {
+              return table.GetSignalMbm(lhs) > table.GetSignalMbm(rhs);
+            }
+            return lhs < rhs;
+          },
+          [&](uint32_t row) {
+            return quota.Take(table.GetFrequency(row),
+                              scan_results[row].ssid);
+          },
+          &rows);
+    } else if (query.max_results > 0) {
+      table.KeepStrongest(query.max_results, &rows);
+    }
+    for (uint32_t row : rows) {
+      out_scan_results->push_back(
+          ProjectScanResult(scan_results[row], query.fields));
+    }
+    return true;
+  }
+
+  // The cache is not refreshed, because that would parse every field of
+  // every BSS.
+  int32_t fields = query.fields;
+  ScanResultQuota quota(query);
+  // SSIDs that the caps count by are cleared after the selection.
+  const bool keep_ssids = query.max_results_per_ssid > 0;
+  if (!ssids.empty() || keep_ssids) {
+    fields |= IWifiScannerImpl::SCAN_RESULT_FIELD_SSID;
+  }
+  auto handler = [&](const NL80211PacketView& packet) {
+    if (!IsScanResultOfInterface(packet, interface_index)) {
+      return;
+    }
+    // Skip BSSs that do not match before parsing them.
+    // BSSs missing these attributes are rejected by |ParseScanResult|.
+    const uint8_t* bss;
+    size_t bss_length;
+    uint32_t frequency;
+    int32_t signal_mbm;
+    uint32_t bss_status;
+    if (packet.GetAttributePayload(NL80211_ATTR_BSS, &bss, &bss_length) &&
+        GetNestedAttributeValue(bss, bss_length, NL80211_BSS_FREQUENCY,
+                                &frequency) &&
+        GetNestedAttributeValue(bss, bss_length, NL80211_BSS_SIGNAL_MBM,
+                                &signal_mbm)) {
+      bool associated =
+          GetNestedAttributeValue(bss, bss_length, NL80211_BSS_STATUS,
+                                  &bss_status) &&
+          IsAssociatedBssStatus(bss_status);
+      if (!MatchesQuery(query, frequency, signal_mbm, associated)) {
+        return;
+      }
+    }
+    if (!excluded_bssids.empty() &&
+        packet.GetAttributePayload(NL80211_ATTR_BSS, &bss, &bss_length) &&
+        IsExcludedBss(bss, bss_length, excluded_bssids)) {
+      return;
+    }
+    uint64_t last_seen;
+    if (min_last_seen > 0 &&
+        packet.GetAttributePayload(NL80211_ATTR_BSS, &bss, &bss_length) &&
+        GetBssLastSeen(bss, bss_length, &last_seen) &&
+        last_seen < min_last_seen) {
+      return;
+    }
+    NativeScanResult scan_result;
+    if (!ParseScanResult(packet, fields, &scan_result)) {
+      LOG(DEBUG) << "Ignore invalid scan result";
+      return;
+    }
+    if (!ssids.empty() && !ssids.Matches(scan_result.ssid)) {
+      return;
+    }
+    if (!(query.fields & IWifiScannerImpl::SCAN_RESULT_FIELD_SSID) &&
+        !keep_ssids) {
+      scan_result.ssid.clear();
+    }
+    out_scan_results->push_back(std::move(scan_result));
+  };
+  size_t begin = out_scan_results->size();
+  if (!DumpScanResults(interface_index, handler)) {
+    return false;
+  }
+  if (quota.IsLimited()) {
+    SelectStrongest(
+        std::max(query.max_results, 0), begin,
+        [](const NativeScanResult& lhs, const NativeScanResult& rhs) {
+          return lhs.signal_mbm > rhs.signal_mbm;
+        },
+        [&quota](const NativeScanResult& scan_result) {
+          return quota.Take(scan_result.frequency, scan_result.ssid);
+        },
+        out_scan_results);
+    if (!(query.fields & IWifiScannerImpl::SCAN_RESULT_FIELD_SSID)) {
+      for (size_t i = begin; i < out_scan_results->size(); i++) {
+        (*out_scan_results)[i].ssid.clear();
+      }
+    }
+  } else if (query.max_results > 0) {
+    KeepStrongestScanResults(query.max_results, begin, out_scan_results);
+  }
+  return true;
+}
+
+bool ScanUtils::DumpScanResults(
+    uint32_t interface_index,
+    const std::function<void(const NL80211PacketView&)>& handler) {
   NL80211Packet get_scan(
       netlink_manager_->GetFamilyId(),
       NL80211_CMD_GET_SCAN,
       netlink_manager_->GetSequenceNumber(),
       getpid());
   get_scan.AddFlag(NLM_F_DUMP);
-  NL80211Attr<uint32_t> ifindex(NL80211_ATTR_IFINDEX, interface_index);
-  get_scan.AddAttribute(ifindex);
-
-  vector<unique_ptr<const NL80211Packet>> response;
-  if (!netlink_manager_->SendMessageAndGetResponses(get_scan, &response))  {
+  get_scan.AddAttributeValue<uint32_t>(NL80211_ATTR_IFINDEX, interface_index);
+  if (!netlink_manager_->SendMessageAndStreamResponses(get_scan, handler)) {
     LOG(ERROR) << "NL80211_CMD_GET_SCAN dump failed";
     return false;
   }
-  if (response.empty()) {
-    LOG(INFO) << "Unexpected empty scan result!";
+  return true;
+}
+
+bool ScanUtils::IsScanResultOfInterface(const NL80211PacketView& packet,
+                                        uint32_t interface_index) {
+  if (packet.GetMessageType() == NLMSG_ERROR) {
+    LOG(ERROR) << "Receive ERROR message: "
+               << strerror(packet.GetErrorCode());
+    return false;
+  }
+  if (packet.GetMessageType() != netlink_manager_->GetFamilyId()) {
+    LOG(ERROR) << "Wrong message type: "
+               << packet.GetMessageType();
+    return false;
+  }
+  // Kernel already left out the scan results of other interfaces.
+  if (packet.IsDumpFiltered()) {
     return true;
   }
+  uint32_t if_index;
+  if (!packet.GetAttributeValue(NL80211_ATTR_IFINDEX, &if_index)) {
+    LOG(ERROR) << "No interface index in scan result.";
+    return false;
+  }
+  if (if_index != interface_index) {
+    static LogRateLimiter uninteresting_result_log_limiter;
+    LOG_RATE_LIMITED(WARNING, uninteresting_result_log_limiter)
+        << "Uninteresting scan result for interface: " << if_index;
+    return false;
+  }
+  return true;
+}
 
-  for (auto& packet : response) {
-    if (packet->GetMessageType() == NLMSG_ERROR) {
-      LOG(ERROR) << "Receive ERROR message: "
-                 << strerror(packet->GetErrorCode());
-      continue;
+struct ScanUtils::PendingBss {
+  // Owned copy, since the received message is gone by the time a worker
+  // thread parses it.
+  NL80211Packet packet;
+  BssFingerprint fingerprint;
+  bool has_fingerprint;
+  bool from_peer;
+  NativeScanResult scan_result;
+  // Whether |scan_result| was parsed from |packet|.
+  bool parsed;
+};
+
+const ScanUtils::ScanResultCache* ScanUtils::GetUpToDateScanResultCache(
+    uint32_t interface_index) {
+  // Up to date results are looked up without inserting into the map, so
+  // concurrent readers of an up to date cache do not race.
+  const auto up_to_date_cache = scan_result_cache_.find(interface_index);
+  if (up_to_date_cache != scan_result_cache_.end() &&
+      up_to_date_cache->second.up_to_date) {
+    return &up_to_date_cache->second;
+  }
+  ATRACE_NAME("ScanUtils::ParseScanResults");
+  ScanResultCache& cache = scan_result_cache_[interface_index];
+
+  // Each BSS is parsed as soon as its message arrives, so the raw dump is
+  // never held in memory as a whole.
+  // Parsed results of BSSs kernel did not update since the last dump are
+  // moved over from |cache|.
+  ScanResultCache new_cache;
+  bool unchanged = false;
+  // Interface whose dump is being parsed. Dumps of peer radios follow the
+  // one of |interface_index|.
+  const auto peers = peer_radio_interfaces_.find(interface_index);
+  const bool has_peers = peers != peer_radio_interfaces_.end();
+  uint32_t source_index = interface_index;
+  size_t num_messages = 0;
+  size_t num_bytes = 0;
+  // BSSs of |new_cache| by the time they were last seen, so that the one
+  // seen least recently is evicted once the cache is full.
+  typedef std::pair<uint64_t, BssKey> LastSeenBss;
+  std::priority_queue<LastSeenBss,
+                      vector<LastSeenBss>,
+                      std::greater<LastSeenBss>> least_recently_seen;
+  // Makes room in |new_cache| for a BSS last seen at |last_seen|.
+  // Returns false if that BSS is the one to leave out.
+  auto make_room = [&](uint64_t last_seen) {
+    if (new_cache.scan_results.size() < scan_result_cache_capacity_) {
+      return true;
     }
-    if (packet->GetMessageType() != netlink_manager_->GetFamilyId()) {
-      LOG(ERROR) << "Wrong message type: "
-                 << packet->GetMessageType();
-      continue;
+    num_evicted_bss_++;
+    if (least_recently_seen.empty() ||
+        last_seen <= least_recently_seen.top().first) {
+      return false;
     }
-    uint32_t if_index;
-    if (!packet->GetAttributeValue(NL80211_ATTR_IFINDEX, &if_index)) {
-      LOG(ERROR) << "No interface index in scan result.";
-      continue;
+    EvictBss(least_recently_seen.top().second, &cache, &new_cache);
+    least_recently_seen.pop();
+    return true;
+  };
+  // Adds |scan_result|, which was parsed from the dump, to |new_cache|.
+  auto add_parsed = [&](NativeScanResult* scan_result,
+                        const BssFingerprint& fingerprint,
+                        bool has_fingerprint,
+                        bool from_peer) {
+    BssKey key(scan_result->bssid, scan_result->frequency);
+    if (from_peer) {
+      if (new_cache.bss_index.find(key) != new_cache.bss_index.end()) {
+        return;
+      }
+      // The association is one of the peer radio.
+      scan_result->associated = false;
     }
-    if (if_index != interface_index) {
-      LOG(WARNING) << "Uninteresting scan result for interface: " << if_index;
-      continue;
+    // Only BSSs kernel updated since the last dump get here.
+    channel_history_.Add(scan_result->ssid, scan_result->frequency);
+    uint64_t last_seen = GetLastSeen(*scan_result);
+    if (!make_room(last_seen)) {
+      return;
+    }
+    least_recently_seen.push({last_seen, key});
+    cache.bss_index.erase(key);
+    new_cache.bss_index[key] = {fingerprint,
+                                has_fingerprint,
+                                new_cache.scan_results.size(),
+                                0};
+    new_cache.scan_results.push_back(std::move(*scan_result));
+  };
+  // BSSs still to parse on |parse_pool_|, in batches in the order of the
+  // dump. A batch is handed to the pool once it is full.
+  unique_ptr<vector<PendingBss>> parse_batch;
+  vector<unique_ptr<vector<PendingBss>>> parse_batches;
+  vector<std::future<void>> parse_results;
+  auto handler = [&](const NL80211PacketView& packet) {
+    num_messages++;
+    num_bytes += packet.GetSize();
+    if (unchanged || !IsScanResultOfInterface(packet, source_index)) {
+      return;
+    }
+    const bool from_peer = source_index != interface_index;
+    uint32_t generation;
+    // The generation of one dump says nothing about the merged ones.
+    if (!has_peers &&
+        packet.GetAttributeValue(NL80211_ATTR_GENERATION, &generation)) {
+      // Kernel bumps the generation every time its BSS table changes.
+      if (cache.has_generation && generation == cache.generation &&
+          !new_cache.has_generation) {
+        unchanged = true;
+        return;
+      }
+      new_cache.has_generation = true;
+      new_cache.generation = generation;
     }
 
+    BssKey key;
+    BssFingerprint fingerprint;
+    bool has_fingerprint = GetBssFingerprint(packet, &key, &fingerprint);
+    if (has_fingerprint && from_peer &&
+        new_cache.bss_index.find(key) != new_cache.bss_index.end()) {
+      return;
+    }
+    if (has_fingerprint) {
+      const auto cached_bss = cache.bss_index.find(key);
+      if (cached_bss != cache.bss_index.end() &&
+          cached_bss->second.has_fingerprint &&
+          cached_bss->second.fingerprint == fingerprint) {
+        uint64_t last_seen = GetLastSeen(
+            cache.scan_results[cached_bss->second.index]);
+        if (!make_room(last_seen)) {
+          return;
+        }
+        least_recently_seen.push({last_seen, key});
+        new_cache.bss_index[key] = {fingerprint,
+                                    true,
+                                    new_cache.scan_results.size(),
+                                    cached_bss->second.generation};
+        new_cache.scan_results.push_back(
+            std::move(cache.scan_results[cached_bss->second.index]));
+        cache.bss_index.erase(cached_bss);
+        return;
+      }
+    }
+
+    if (parse_pool_ != nullptr) {
+      // Parsed on |parse_pool_|, and added by finish_parsing().
+      if (parse_batch == nullptr) {
+        parse_batch.reset(new vector<PendingBss>());
+        parse_batch->reserve(kParseBatchSize);
+      }
+      parse_batch->push_back({NL80211Packet(packet), fingerprint,
+                              has_fingerprint, from_peer,
+                              NativeScanResult(), false});
+      if (parse_batch->size() == kParseBatchSize) {
+        vector<PendingBss>* batch = parse_batch.get();
+        auto task = std::make_shared<std::packaged_task<void()>>(
+            [this, batch]() { ParsePendingBsss(batch); });
+        parse_results.push_back(task->get_future());
+        parse_batches.push_back(std::move(parse_batch));
+        parse_pool_->PostTask([task]() { (*task)(); });
+      }
+      return;
+    }
     NativeScanResult scan_result;
-    if (!ParseScanResult(std::move(packet), &scan_result)) {
+    if (!ParseScanResult(packet, IWifiScannerImpl::SCAN_RESULT_FIELD_ALL,
+                         &scan_result)) {
       LOG(DEBUG) << "Ignore invalid scan result";
-      continue;
+      return;
     }
-    out_scan_results->push_back(std::move(scan_result));
+    add_parsed(&scan_result, fingerprint, has_fingerprint, from_peer);
+  };
+  // Waits for the BSSs parsed on |parse_pool_| and adds them in the order
+  // of the dump. The last batch is parsed on this thread meanwhile.
+  auto finish_parsing = [&]() {
+    if (parse_batch != nullptr) {
+      ParsePendingBsss(parse_batch.get());
+      parse_results.emplace_back();
+      parse_batches.push_back(std::move(parse_batch));
+    }
+    for (size_t i = 0; i < parse_batches.size(); i++) {
+      if (parse_results[i].valid()) {
+        parse_results[i].wait();
+      }
+      for (PendingBss& bss : *parse_batches[i]) {
+        if (!bss.parsed) {
+          LOG(DEBUG) << "Ignore invalid scan result";
+          continue;
+        }
+        add_parsed(&bss.scan_result, bss.fingerprint, bss.has_fingerprint,
+                   bss.from_peer);
+      }
+    }
+    parse_results.clear();
+    parse_batches.clear();
+  };
+  bool dumped = DumpScanResults(interface_index, handler);
+  // Own BSSs are all added before those of peer radios are checked against
+  // them.
+  finish_parsing();
+  if (!dumped) {
+    // Some cached results might have been moved out already.
+    scan_result_cache_.erase(interface_index);
+    UpdateScanResultMemoryAccount();
+    return nullptr;
+  }
+  if (has_peers) {
+    for (uint32_t peer_index : peers->second) {
+      source_index = peer_index;
+      if (!DumpScanResults(peer_index, handler)) {
+        LOG(WARNING) << "Failed to get scan results of peer radio interface "
+                     << peer_index;
+      }
+      finish_parsing();
+    }
+  }
+  if (num_messages == 0) {
+    LOG(INFO) << "Unexpected empty scan result!";
+  }
+  ATRACE_INT64("wificond_scan_bytes_parsed", num_bytes);
+  if (!unchanged) {
+    UpdateScanResultGeneration(&cache, &new_cache);
+    cache = std::move(new_cache);
+    cache.table.Assign(cache.scan_results);
+    cache.congestion.Assign(cache.scan_results);
+    UpdateScanResultCacheMemory(&cache);
+    UpdateScanResultMemoryAccount();
+  }
+  cache.up_to_date = true;
+  ATRACE_INT("wificond_scan_bss_count", cache.scan_results.size());
+  return &cache;
+}
+
+void ScanUtils::ParsePendingBsss(vector<PendingBss>* batch) {
+  for (PendingBss& bss : *batch) {
+    bss.parsed = ParseScanResult(bss.packet.GetView(),
+                                 IWifiScannerImpl::SCAN_RESULT_FIELD_ALL,
+                                 &bss.scan_result);
+  }
+}
+
+void ScanUtils::EvictBss(const BssKey& key,
+                         ScanResultCache* cache,
+                         ScanResultCache* new_cache) {
+  const auto evicted_bss = new_cache->bss_index.find(key);
+  size_t index = evicted_bss->second.index;
+  new_cache->bss_index.erase(evicted_bss);
+  // The last scan result takes the place of the evicted one.
+  if (index + 1 != new_cache->scan_results.size()) {
+    NativeScanResult& last = new_cache->scan_results.back();
+    new_cache->bss_index[BssKey(last.bssid, last.frequency)].index = index;
+    new_cache->scan_results[index] = std::move(last);
+  }
+  new_cache->scan_results.pop_back();
+  cache->bss_index[key] = {BssFingerprint(), false, 0, 0};
+}
+
+void ScanUtils::UpdateScanResultCacheMemory(ScanResultCache* cache) {
+  size_t num_bytes =
+      cache->scan_results.capacity() * sizeof(NativeScanResult) +
+      cache->bss_index.size() * (sizeof(BssKey) + sizeof(CachedBss));
+  size_t num_duplicate_ie_bytes = 0;
+  std::unordered_set<std::string_view> info_elements;
+  for (const NativeScanResult& scan_result : cache->scan_results) {
+    num_bytes += scan_result.ssid.capacity() +
+        scan_result.info_element.capacity() +
+        scan_result.radio_chain_infos.capacity() * sizeof(RadioChainInfo) +
+        scan_result.info_element_index.capacity() *
+            sizeof(InfoElementLocation);
+    std::string_view info_element(
+        reinterpret_cast<const char*>(scan_result.info_element.data()),
+        scan_result.info_element.size());
+    if (!info_elements.insert(info_element).second) {
+      num_duplicate_ie_bytes += info_element.size();
+    }
+  }
+  cache->num_bytes = num_bytes;
+  cache->num_duplicate_ie_bytes = num_duplicate_ie_bytes;
+}
+
+void ScanUtils::UpdateScanResultMemoryAccount() {
+  size_t num_bytes = 0;
+  for (const auto& cache : scan_result_cache_) {
+    num_bytes += cache.second.num_bytes;
+  }
+  scan_result_memory_.Set(num_bytes);
+}
+
+void ScanUtils::UpdateScanResultGeneration(ScanResultCache* cache,
+                                           ScanResultCache* new_cache) {
+  // BSSs left in the index of |cache| are not part of the new dump.
+  bool changed = cache->results_generation == 0 || !cache->bss_index.empty();
+  for (const auto& cached_bss : new_cache->bss_index) {
+    if (cached_bss.second.generation == 0) {
+      changed = true;
+      break;
+    }
+  }
+  new_cache->removed_bsss = std::move(cache->removed_bsss);
+  if (!changed) {
+    new_cache->results_generation = cache->results_generation;
+    new_cache->oldest_generation = cache->oldest_generation;
+    return;
+  }
+
+  int64_t generation = ++last_scan_results_generation_;
+  for (auto& cached_bss : new_cache->bss_index) {
+    if (cached_bss.second.generation == 0) {
+      cached_bss.second.generation = generation;
+    }
+  }
+  for (const auto& removed_bss : cache->bss_index) {
+    new_cache->removed_bsss.push_back({removed_bss.first, generation});
+  }
+  new_cache->results_generation = generation;
+  new_cache->oldest_generation =
+      cache->results_generation == 0 ? generation : cache->oldest_generation;
+  while (new_cache->removed_bsss.size() > kMaxRemovedBssHistory) {
+    // A delta from an older generation would miss this BSS.
+    new_cache->oldest_generation = new_cache->removed_bsss.front().generation;
+    new_cache->removed_bsss.pop_front();
+  }
+}
+
+bool ScanUtils::GetBssFingerprint(const NL80211PacketView& packet,
+                                  BssKey* key,
+                                  BssFingerprint* fingerprint) {
+  const uint8_t* bss;
+  size_t bss_length;
+  if (!packet.GetAttributePayload(NL80211_ATTR_BSS, &bss, &bss_length)) {
+    return false;
+  }
+  if (!GetNestedAttributeValue(bss, bss_length, NL80211_BSS_BSSID,
+                               &key->first) ||
+      !GetNestedAttributeValue(bss, bss_length, NL80211_BSS_FREQUENCY,
+                               &key->second)) {
+    return false;
+  }
+  // Without any timestamp updates of the BSS cannot be detected.
+  bool has_last_seen = GetNestedAttributeValue(
+      bss, bss_length, NL80211_BSS_LAST_SEEN_BOOTTIME,
+      &fingerprint->last_seen_boottime);
+  bool has_tsf = GetNestedAttributeValue(
+      bss, bss_length, NL80211_BSS_TSF, &fingerprint->tsf);
+  if (!has_last_seen && !has_tsf) {
+    return false;
+  }
+  if (!GetNestedAttributeValue(bss, bss_length, NL80211_BSS_STATUS,
+                               &fingerprint->status)) {
+    fingerprint->status = kBssStatusNone;
   }
   return true;
 }
 
-bool ScanUtils::ParseScanResult(unique_ptr<const NL80211Packet> packet,
+bool ScanUtils::ParseScanResult(const NL80211PacketView& packet,
+                                int32_t fields,
                                 NativeScanResult* scan_result) {
-  if (packet->GetCommand() != NL80211_CMD_NEW_SCAN_RESULTS) {
+  if (packet.GetCommand() != NL80211_CMD_NEW_SCAN_RESULTS) {
     LOG(ERROR) << "Wrong command for new scan result message";
     return false;
   }
   NL80211NestedAttr bss(0);
-  if (packet->GetAttribute(NL80211_ATTR_BSS, &bss)) {
+  if (packet.GetAttribute(NL80211_ATTR_BSS, &bss)) {
     array<uint8_t, ETH_ALEN> bssid;
     if (!bss.GetAttributeValue(NL80211_BSS_BSSID, &bssid)) {
       LOG(ERROR) << "Failed to get BSSID from scan result packet";
@@ -147,13 +1125,27 @@ bool ScanUtils::ParseScanResult(unique_ptr<const NL80211Packet> packet,
       LOG(ERROR) << "Failed to get Frequency from scan result packet";
       return false;
     }
-    vector<uint8_t> ie;
-    if (!bss.GetAttributeValue(NL80211_BSS_INFORMATION_ELEMENTS, &ie)) {
+    // The IE blob is only copied once, into |scan_result|, after the
+    // scan result is known to be valid.
+    const uint8_t* ie;
+    size_t ie_length;
+    if (!bss.GetAttributePayload(NL80211_BSS_INFORMATION_ELEMENTS,
+                                 &ie, &ie_length)) {
       LOG(ERROR) << "Failed to get Information Element from scan result packet";
       return false;
     }
+    // Indexing walks all elements, while looking for the SSID alone
+    // usually stops at the first one.
+    vector<InfoElementLocation> ie_index;
     vector<uint8_t> ssid;
-    if (!GetSSIDFromInfoElement(ie, &ssid)) {
+    bool has_ssid;
+    if (fields & IWifiScannerImpl::SCAN_RESULT_FIELD_IE_INDEX) {
+      InfoElementUtils::IndexInfoElements(ie, ie_length, &ie_index);
+      has_ssid = InfoElementUtils::GetSsid(ie, ie_index, &ssid);
+    } else {
+      has_ssid = GetSSIDFromInfoElement(ie, ie_length, &ssid);
+    }
+    if (!has_ssid) {
       // Skip BSS without SSID IE.
       // These scan results are considered as malformed.
       return false;
@@ -176,17 +1168,37 @@ bool ScanUtils::ParseScanResult(unique_ptr<const NL80211Packet> packet,
     bool associated = false;
     uint32_t bss_status;
     if (bss.GetAttributeValue(NL80211_BSS_STATUS, &bss_status) &&
-            (bss_status == NL80211_BSS_STATUS_AUTHENTICATED ||
-                bss_status == NL80211_BSS_STATUS_ASSOCIATED)) {
+            IsAssociatedBssStatus(bss_status)) {
       associated = true;
     }
-    std::vector<RadioChainInfo> radio_chain_infos;
-    ParseRadioChainInfos(bss, &radio_chain_infos);
 
-    *scan_result =
-        NativeScanResult(ssid, bssid, ie, freq, signal,
-                         last_seen_since_boot_microseconds,
-                         capability, associated, radio_chain_infos);
+    // Fields that are not asked for are validated above, but not copied.
+    scan_result->bssid = bssid;
+    scan_result->frequency = freq;
+    scan_result->signal_mbm = signal;
+    scan_result->associated = associated;
+    scan_result->tsf = 0;
+    scan_result->capability = 0;
+    if (fields & IWifiScannerImpl::SCAN_RESULT_FIELD_SSID) {
+      scan_result->ssid = std::move(ssid);
+    }
+    if (fields & IWifiScannerImpl::SCAN_RESULT_FIELD_INFO_ELEMENT) {
+      scan_result->info_element.assign(ie, ie + ie_length);
+    }
+    if (fields & IWifiScannerImpl::SCAN_RESULT_FIELD_TSF) {
+      scan_result->tsf = last_seen_since_boot_microseconds;
+    }
+    if (fields & IWifiScannerImpl::SCAN_RESULT_FIELD_CAPABILITY) {
+      scan_result->capability = capability;
+    }
+    if (fields & IWifiScannerImpl::SCAN_RESULT_FIELD_RADIO_CHAIN_INFOS) {
+      ParseRadioChainInfos(bss, &scan_result->radio_chain_infos);
+    }
+    if (fields & IWifiScannerImpl::SCAN_RESULT_FIELD_IE_INDEX) {
+      InfoElementUtils::DecodeInfoElements(ie, ie_index, capability,
+                                           scan_result);
+      scan_result->info_element_index = std::move(ie_index);
+    }
   }
   return true;
 }
@@ -199,22 +1211,11 @@ bool ScanUtils::GetBssTimestampForTesting(
 
 bool ScanUtils::GetBssTimestamp(const NL80211NestedAttr& bss,
                                 uint64_t* last_seen_since_boot_microseconds){
-  uint64_t last_seen_since_boot_nanoseconds;
-  if (bss.GetAttributeValue(NL80211_BSS_LAST_SEEN_BOOTTIME,
-                            &last_seen_since_boot_nanoseconds)) {
-    *last_seen_since_boot_microseconds = last_seen_since_boot_nanoseconds / 1000;
-  } else {
-    // Fall back to use TSF if we can't find NL80211_BSS_LAST_SEEN_BOOTTIME
-    // attribute.
-    if (!bss.GetAttributeValue(NL80211_BSS_TSF, last_seen_since_boot_microseconds)) {
-      LOG(ERROR) << "Failed to get TSF from scan result packet";
-      return false;
-    }
-    uint64_t beacon_tsf_microseconds;
-    if (bss.GetAttributeValue(NL80211_BSS_BEACON_TSF, &beacon_tsf_microseconds)) {
-      *last_seen_since_boot_microseconds = std::max(*last_seen_since_boot_microseconds,
-                                                    beacon_tsf_microseconds);
-    }
+  const vector<uint8_t>& data = bss.GetConstData();
+  if (!GetBssLastSeen(data.data() + NLA_HDRLEN, data.size() - NLA_HDRLEN,
+                      last_seen_since_boot_microseconds)) {
+    LOG(ERROR) << "Failed to get TSF from scan result packet";
+    return false;
   }
   return true;
 }
@@ -244,14 +1245,15 @@ bool ScanUtils::ParseRadioChainInfos(
   return true;
 }
 
-bool ScanUtils::GetSSIDFromInfoElement(const vector<uint8_t>& ie,
+bool ScanUtils::GetSSIDFromInfoElement(const uint8_t* ie,
+                                       size_t ie_length,
                                        vector<uint8_t>* ssid) {
   // Information elements are stored in 'TLV' format.
   // Field:  |   Type     |          Length           |      Value      |
   // Length: |     1      |             1             |     variable    |
   // Content:| Element ID | Length of the Value field | Element payload |
-  const uint8_t* end = ie.data() + ie.size();
-  const uint8_t* ptr = ie.data();
+  const uint8_t* end = ie + ie_length;
+  const uint8_t* ptr = ie;
   // +1 means we must have space for the length field.
   while (ptr + 1  < end) {
     uint8_t type = *ptr;
@@ -281,11 +1283,44 @@ bool ScanUtils::Scan(uint32_t interface_index,
                      const vector<vector<uint8_t>>& ssids,
                      const vector<uint32_t>& freqs,
                      int* error_code) {
+  return Scan(interface_index, request_random_mac, scan_type, ssids, freqs,
+              nullptr, error_code);
+}
+
+bool ScanUtils::Scan(uint32_t interface_index,
+                     bool request_random_mac,
+                     int scan_type,
+                     const vector<vector<uint8_t>>& ssids,
+                     const vector<uint32_t>& freqs,
+                     ScanRequestCache* request_cache,
+                     int* error_code) {
+  ATRACE_CALL();
+  if (request_cache == nullptr) {
+    NL80211Packet trigger_scan = CreateScanRequest(
+        interface_index, request_random_mac, scan_type, ssids, freqs);
+    return SendScanRequest(&trigger_scan, error_code);
+  }
+  NL80211Packet* trigger_scan = request_cache->Find(
+      interface_index, request_random_mac, scan_type, ssids, freqs);
+  if (trigger_scan == nullptr) {
+    trigger_scan = request_cache->Insert(
+        interface_index, request_random_mac, scan_type, ssids, freqs,
+        CreateScanRequest(interface_index, request_random_mac, scan_type,
+                          ssids, freqs));
+  }
+  return SendScanRequest(trigger_scan, error_code);
+}
+
+NL80211Packet ScanUtils::CreateScanRequest(uint32_t interface_index,
+                                           bool request_random_mac,
+                                           int scan_type,
+                                           const vector<vector<uint8_t>>& ssids,
+                                           const vector<uint32_t>& freqs) {
   NL80211Packet trigger_scan(
       netlink_manager_->GetFamilyId(),
       NL80211_CMD_TRIGGER_SCAN,
-      netlink_manager_->GetSequenceNumber(),
-      getpid());
+      0,
+      0);
   // If we do not use NLM_F_ACK, we only receive a unicast repsonse
   // when there is an error. If everything is good, scan results notification
   // will only be sent through multicast.
@@ -293,23 +1328,19 @@ bool ScanUtils::Scan(uint32_t interface_index,
   // ERROR or an ACK message. The handler will always be called and removed by
   // NetlinkManager.
   trigger_scan.AddFlag(NLM_F_ACK);
-  NL80211Attr<uint32_t> if_index_attr(NL80211_ATTR_IFINDEX, interface_index);
-
-  NL80211NestedAttr ssids_attr(NL80211_ATTR_SCAN_SSIDS);
-  for (size_t i = 0; i < ssids.size(); i++) {
-    ssids_attr.AddAttribute(NL80211Attr<vector<uint8_t>>(i, ssids[i]));
-  }
-  NL80211NestedAttr freqs_attr(NL80211_ATTR_SCAN_FREQUENCIES);
-  for (size_t i = 0; i < freqs.size(); i++) {
-    freqs_attr.AddAttribute(NL80211Attr<uint32_t>(i, freqs[i]));
-  }
-
-  trigger_scan.AddAttribute(if_index_attr);
-  trigger_scan.AddAttribute(ssids_attr);
+  // Attributes are written in place, into a buffer reserved for all of them.
+  trigger_scan.Reserve(
+      NL80211Packet::GetAttributeSize(sizeof(uint32_t)) +
+      GetSsidListSize(ssids) +
+      GetFrequencyListSize(freqs) +
+      NL80211Packet::GetAttributeSize(sizeof(uint32_t)));
+  trigger_scan.AddAttributeValue<uint32_t>(NL80211_ATTR_IFINDEX,
+                                           interface_index);
+  AddSsidList(&trigger_scan, NL80211_ATTR_SCAN_SSIDS, ssids);
   // An absence of NL80211_ATTR_SCAN_FREQUENCIES attribue informs kernel to
   // scan all supported frequencies.
   if (!freqs.empty()) {
-    trigger_scan.AddAttribute(freqs_attr);
+    AddFrequencyList(&trigger_scan, NL80211_ATTR_SCAN_FREQUENCIES, freqs);
   }
 
   uint32_t scan_flags = 0;
@@ -332,16 +1363,19 @@ bool ScanUtils::Scan(uint32_t interface_index,
       CHECK(0) << "Invalid scan type received: " << scan_type;
   }
   if (scan_flags) {
-    trigger_scan.AddAttribute(
-        NL80211Attr<uint32_t>(NL80211_ATTR_SCAN_FLAGS,
-                              scan_flags));
+    trigger_scan.AddAttributeValue<uint32_t>(NL80211_ATTR_SCAN_FLAGS,
+                                             scan_flags);
   }
+  return trigger_scan;
+}
+
+bool ScanUtils::SendScanRequest(NL80211Packet* request, int* error_code) {
+  request->SetMessageSequence(netlink_manager_->GetSequenceNumber());
+  request->SetPortId(getpid());
   // We are receiving an ERROR/ACK message instead of the actual
   // scan results here, so it is OK to expect a timely response because
   // kernel is supposed to send the ERROR/ACK back before the scan starts.
-  vector<unique_ptr<const NL80211Packet>> response;
-  if (!netlink_manager_->SendMessageAndGetAckOrError(trigger_scan,
-                                                     error_code)) {
+  if (!netlink_manager_->SendMessageAndGetAckOrError(*request, error_code)) {
     // Logging is done inside |SendMessageAndGetAckOrError|.
     return false;
   }
@@ -360,8 +1394,8 @@ bool ScanUtils::StopScheduledScan(uint32_t interface_index) {
       getpid());
   // Force an ACK response upon success.
   stop_sched_scan.AddFlag(NLM_F_ACK);
-  stop_sched_scan.AddAttribute(
-      NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, interface_index));
+  stop_sched_scan.AddAttributeValue<uint32_t>(NL80211_ATTR_IFINDEX,
+                                              interface_index);
   vector<unique_ptr<const NL80211Packet>> response;
   int error_code;
   if (!netlink_manager_->SendMessageAndGetAckOrError(stop_sched_scan,
@@ -390,8 +1424,8 @@ bool ScanUtils::AbortScan(uint32_t interface_index) {
 
   // Force an ACK response upon success.
   abort_scan.AddFlag(NLM_F_ACK);
-  abort_scan.AddAttribute(
-      NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, interface_index));
+  abort_scan.AddAttributeValue<uint32_t>(NL80211_ATTR_IFINDEX,
+                                         interface_index);
 
   if (!netlink_manager_->SendMessageAndGetAck(abort_scan)) {
     LOG(ERROR) << "NL80211_CMD_ABORT_SCAN failed";
@@ -400,7 +1434,7 @@ bool ScanUtils::AbortScan(uint32_t interface_index) {
   return true;
 }
 
-bool ScanUtils::StartScheduledScan(
+NL80211Packet ScanUtils::CreateStartSchedScanRequest(
     uint32_t interface_index,
     const SchedScanIntervalSetting& interval_setting,
     int32_t rssi_threshold_2g,
@@ -409,8 +1443,7 @@ bool ScanUtils::StartScheduledScan(
     const SchedScanReqFlags& req_flags,
     const std::vector<std::vector<uint8_t>>& scan_ssids,
     const std::vector<std::vector<uint8_t>>& match_ssids,
-    const std::vector<uint32_t>& freqs,
-    int* error_code) {
+    const std::vector<uint32_t>& freqs) {
   NL80211Packet start_sched_scan(
       netlink_manager_->GetFamilyId(),
       NL80211_CMD_START_SCHED_SCAN,
@@ -419,29 +1452,42 @@ bool ScanUtils::StartScheduledScan(
   // Force an ACK response upon success.
   start_sched_scan.AddFlag(NLM_F_ACK);
 
-  NL80211NestedAttr scan_ssids_attr(NL80211_ATTR_SCAN_SSIDS);
-  for (size_t i = 0; i < scan_ssids.size(); i++) {
-    scan_ssids_attr.AddAttribute(NL80211Attr<vector<uint8_t>>(i, scan_ssids[i]));
-  }
-  NL80211NestedAttr freqs_attr(NL80211_ATTR_SCAN_FREQUENCIES);
-  for (size_t i = 0; i < freqs.size(); i++) {
-    freqs_attr.AddAttribute(NL80211Attr<uint32_t>(i, freqs[i]));
+  // Attributes are written in place, into a buffer reserved for all of them.
+  size_t match_sets_size = NL80211Packet::GetAttributeSize(0);
+  for (const vector<uint8_t>& match_ssid : match_ssids) {
+    match_sets_size += NL80211Packet::GetAttributeSize(0) +
+        NL80211Packet::GetAttributeSize(match_ssid.size()) +
+        NL80211Packet::GetAttributeSize(sizeof(int32_t));
   }
+  start_sched_scan.Reserve(
+      match_sets_size +
+      NL80211Packet::GetAttributeSize(
+          sizeof(struct nl80211_bss_select_rssi_adjust)) +
+      NL80211Packet::GetAttributeSize(sizeof(uint32_t)) +
+      GetSsidListSize(scan_ssids) +
+      GetFrequencyListSize(freqs) +
+      NL80211Packet::GetAttributeSize(0) +
+      (interval_setting.plans.size() + 1) *
+          NL80211Packet::GetAttributeSize(
+              2 * NL80211Packet::GetAttributeSize(sizeof(uint32_t))) +
+      NL80211Packet::GetAttributeSize(sizeof(uint32_t)));
 
   //   Structure of attributes of scheduled scan filters:
   // |                                Nested Attribute: id: NL80211_ATTR_SCHED_SCAN_MATCH                           |
   // |     Nested Attributed: id: 0       |    Nested Attributed: id: 1         |      Nested Attr: id: 2     | ... |
   // | MATCH_SSID  | MATCH_RSSI(optional) | MATCH_SSID  | MACTCH_RSSI(optional) | MATCH_RSSI(optinal, global) | ... |
-  NL80211NestedAttr scan_match_attr(NL80211_ATTR_SCHED_SCAN_MATCH);
+  size_t scan_match_attr =
+      start_sched_scan.BeginNestedAttribute(NL80211_ATTR_SCHED_SCAN_MATCH);
   for (size_t i = 0; i < match_ssids.size(); i++) {
-    NL80211NestedAttr match_group(i);
-    match_group.AddAttribute(
-        NL80211Attr<vector<uint8_t>>(NL80211_SCHED_SCAN_MATCH_ATTR_SSID, match_ssids[i]));
-    match_group.AddAttribute(
-        NL80211Attr<int32_t>(NL80211_SCHED_SCAN_MATCH_ATTR_RSSI, rssi_threshold_5g));
-    scan_match_attr.AddAttribute(match_group);
+    size_t match_group = start_sched_scan.BeginNestedAttribute(i);
+    start_sched_scan.AddAttributeBytes(NL80211_SCHED_SCAN_MATCH_ATTR_SSID,
+                                       match_ssids[i].data(),
+                                       match_ssids[i].size());
+    start_sched_scan.AddAttributeValue<int32_t>(
+        NL80211_SCHED_SCAN_MATCH_ATTR_RSSI, rssi_threshold_5g);
+    start_sched_scan.EndNestedAttribute(match_group);
   }
-  start_sched_scan.AddAttribute(scan_match_attr);
+  start_sched_scan.EndNestedAttribute(scan_match_attr);
 
   // We set 5g threshold for default and ajust threshold for 2g band.
   // check sched_scan supported before set NL80211_ATTR_SCHED_SCAN_RSSI_ADJUST attribute.
@@ -449,49 +1495,47 @@ bool ScanUtils::StartScheduledScan(
       struct nl80211_bss_select_rssi_adjust rssi_adjust;
       rssi_adjust.band = NL80211_BAND_2GHZ;
       rssi_adjust.delta = static_cast<int8_t>(rssi_threshold_2g - rssi_threshold_5g);
-      NL80211Attr<vector<uint8_t>> rssi_adjust_attr(
-          NL80211_ATTR_SCHED_SCAN_RSSI_ADJUST,
-          vector<uint8_t>(
-              reinterpret_cast<uint8_t*>(&rssi_adjust),
-              reinterpret_cast<uint8_t*>(&rssi_adjust) + sizeof(rssi_adjust)));
-      start_sched_scan.AddAttribute(rssi_adjust_attr);
+      start_sched_scan.AddAttributeBytes(NL80211_ATTR_SCHED_SCAN_RSSI_ADJUST,
+                                         &rssi_adjust, sizeof(rssi_adjust));
   }
 
   //TODO: No adjustment is possible now for 6GHz due to lack of definition in
   //nl80211.h for NL80211_BAND_6GHZ attribute
 
   // Append all attributes to the NL80211_CMD_START_SCHED_SCAN packet.
-  start_sched_scan.AddAttribute(
-      NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, interface_index));
-  start_sched_scan.AddAttribute(scan_ssids_attr);
+  start_sched_scan.AddAttributeValue<uint32_t>(NL80211_ATTR_IFINDEX,
+                                               interface_index);
+  AddSsidList(&start_sched_scan, NL80211_ATTR_SCAN_SSIDS, scan_ssids);
   // An absence of NL80211_ATTR_SCAN_FREQUENCIES attribue informs kernel to
   // scan all supported frequencies.
   if (!freqs.empty()) {
-    start_sched_scan.AddAttribute(freqs_attr);
+    AddFrequencyList(&start_sched_scan, NL80211_ATTR_SCAN_FREQUENCIES, freqs);
   }
 
   if (!interval_setting.plans.empty()) {
-    NL80211NestedAttr scan_plans(NL80211_ATTR_SCHED_SCAN_PLANS);
+    size_t scan_plans =
+        start_sched_scan.BeginNestedAttribute(NL80211_ATTR_SCHED_SCAN_PLANS);
     for (unsigned int i = 0; i < interval_setting.plans.size(); i++) {
-      NL80211NestedAttr scan_plan(i + 1);
-      scan_plan.AddAttribute(
-          NL80211Attr<uint32_t>(NL80211_SCHED_SCAN_PLAN_INTERVAL,
-                                interval_setting.plans[i].interval_ms / kMsecPerSec));
-      scan_plan.AddAttribute(
-          NL80211Attr<uint32_t>(NL80211_SCHED_SCAN_PLAN_ITERATIONS,
-                                interval_setting.plans[i].n_iterations));
-      scan_plans.AddAttribute(scan_plan);
-    }
-    NL80211NestedAttr last_scan_plan(interval_setting.plans.size() + 1);
-    last_scan_plan.AddAttribute(
-        NL80211Attr<uint32_t>(NL80211_SCHED_SCAN_PLAN_INTERVAL,
-                              interval_setting.final_interval_ms / kMsecPerSec));
-    scan_plans.AddAttribute(last_scan_plan);
-    start_sched_scan.AddAttribute(scan_plans);
+      size_t scan_plan = start_sched_scan.BeginNestedAttribute(i + 1);
+      start_sched_scan.AddAttributeValue<uint32_t>(
+          NL80211_SCHED_SCAN_PLAN_INTERVAL,
+          interval_setting.plans[i].interval_ms / kMsecPerSec);
+      start_sched_scan.AddAttributeValue<uint32_t>(
+          NL80211_SCHED_SCAN_PLAN_ITERATIONS,
+          interval_setting.plans[i].n_iterations);
+      start_sched_scan.EndNestedAttribute(scan_plan);
+    }
+    size_t last_scan_plan = start_sched_scan.BeginNestedAttribute(
+        interval_setting.plans.size() + 1);
+    start_sched_scan.AddAttributeValue<uint32_t>(
+        NL80211_SCHED_SCAN_PLAN_INTERVAL,
+        interval_setting.final_interval_ms / kMsecPerSec);
+    start_sched_scan.EndNestedAttribute(last_scan_plan);
+    start_sched_scan.EndNestedAttribute(scan_plans);
   } else {
-    start_sched_scan.AddAttribute(
-        NL80211Attr<uint32_t>(NL80211_ATTR_SCHED_SCAN_INTERVAL,
-                              interval_setting.final_interval_ms));
+    start_sched_scan.AddAttributeValue<uint32_t>(
+        NL80211_ATTR_SCHED_SCAN_INTERVAL,
+        interval_setting.final_interval_ms);
   }
   uint32_t scan_flags = 0;
   if (req_flags.request_random_mac) {
@@ -501,10 +1545,26 @@ bool ScanUtils::StartScheduledScan(
     scan_flags |= NL80211_SCAN_FLAG_LOW_POWER;
   }
   if (scan_flags) {
-    start_sched_scan.AddAttribute(
-        NL80211Attr<uint32_t>(NL80211_ATTR_SCAN_FLAGS,
-                              scan_flags));
+    start_sched_scan.AddAttributeValue<uint32_t>(NL80211_ATTR_SCAN_FLAGS,
+                                                 scan_flags);
   }
+  return start_sched_scan;
+}
+
+bool ScanUtils::StartScheduledScan(
+    uint32_t interface_index,
+    const SchedScanIntervalSetting& interval_setting,
+    int32_t rssi_threshold_2g,
+    int32_t rssi_threshold_5g,
+    int32_t rssi_threshold_6g,
+    const SchedScanReqFlags& req_flags,
+    const std::vector<std::vector<uint8_t>>& scan_ssids,
+    const std::vector<std::vector<uint8_t>>& match_ssids,
+    const std::vector<uint32_t>& freqs,
+    int* error_code) {
+  NL80211Packet start_sched_scan = CreateStartSchedScanRequest(
+      interface_index, interval_setting, rssi_threshold_2g, rssi_threshold_5g,
+      rssi_threshold_6g, req_flags, scan_ssids, match_ssids, freqs);
 
   vector<unique_ptr<const NL80211Packet>> response;
   if (!netlink_manager_->SendMessageAndGetAckOrError(start_sched_scan,
@@ -520,5 +1580,54 @@ bool ScanUtils::StartScheduledScan(
   return true;
 }
 
+bool ScanUtils::RestartScheduledScan(
+    uint32_t interface_index,
+    const SchedScanIntervalSetting& interval_setting,
+    int32_t rssi_threshold_2g,
+    int32_t rssi_threshold_5g,
+    int32_t rssi_threshold_6g,
+    const SchedScanReqFlags& req_flags,
+    const std::vector<std::vector<uint8_t>>& scan_ssids,
+    const std::vector<std::vector<uint8_t>>& match_ssids,
+    const std::vector<uint32_t>& freqs,
+    int* error_code) {
+  NL80211Packet stop_sched_scan(
+      netlink_manager_->GetFamilyId(),
+      NL80211_CMD_STOP_SCHED_SCAN,
+      netlink_manager_->GetSequenceNumber(),
+      getpid());
+  // Force an ACK response upon success.
+  stop_sched_scan.AddFlag(NLM_F_ACK);
+  stop_sched_scan.AddAttributeValue<uint32_t>(NL80211_ATTR_IFINDEX,
+                                              interface_index);
+  NL80211Packet start_sched_scan = CreateStartSchedScanRequest(
+      interface_index, interval_setting, rssi_threshold_2g, rssi_threshold_5g,
+      rssi_threshold_6g, req_flags, scan_ssids, match_ssids, freqs);
+
+  // Both requests go out with a single sendmsg() call, and kernel handles
+  // them back to back.
+  vector<vector<unique_ptr<const NL80211Packet>>> responses;
+  if (!netlink_manager_->SendMessagesAndGetResponses(
+          {&stop_sched_scan, &start_sched_scan}, &responses)) {
+    LOG(ERROR) << "Failed to restart scheduled scan";
+    return false;
+  }
+  int stop_error_code = 0;
+  if (!GetAckErrorCode(responses[0], &stop_error_code) ||
+      !GetAckErrorCode(responses[1], error_code)) {
+    return false;
+  }
+  // ENOENT means that no scheduled scan was running, which is fine.
+  if (stop_error_code != 0 && stop_error_code != ENOENT) {
+    LOG(WARNING) << "NL80211_CMD_STOP_SCHED_SCAN failed: "
+                 << strerror(stop_error_code);
+  }
+  if (*error_code != 0) {
+    LOG(ERROR) << "NL80211_CMD_START_SCHED_SCAN failed: " << strerror(*error_code);
+    return false;
+  }
+  return true;
+}
+
 }  // namespace wificond
 }  // namespace android
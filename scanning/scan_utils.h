@@ -17,12 +17,25 @@
 #ifndef WIFICOND_SCANNING_SCAN_UTILS_H_
 #define WIFICOND_SCANNING_SCAN_UTILS_H_
 
+#include <array>
+#include <deque>
+#include <functional>
+#include <map>
 #include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
 #include <vector>
 
+#include <linux/if_ether.h>
+
 #include <android-base/macros.h>
 
 #include "wificond/net/netlink_manager.h"
+#include "wificond/scanning/channel_congestion_map.h"
+#include "wificond/scanning/channel_history.h"
+#include "wificond/scanning/scan_request_cache.h"
+#include "wificond/scanning/scan_result_table.h"
 
 namespace android {
 namespace net {
@@ -30,7 +43,9 @@ namespace wifi {
 namespace nl80211 {
 
 class NativeScanResult;
+class NativeScanResultsDelta;
 class RadioChainInfo;
+class ScanResultQuery;
 
 }  // namespace nl80211
 }  // namespace wifi
@@ -42,6 +57,10 @@ namespace wificond {
 
 class NL80211NestedAttr;
 class NL80211Packet;
+class NL80211PacketView;
+class ScanResultBatch;
+class SsidMatcher;
+class WorkerPool;
 
 struct SchedScanIntervalSetting {
   struct ScanPlan {
@@ -70,11 +89,134 @@ class ScanUtils {
   // |interface_index| is the index of interface we want to get scan results
   // from.
   // A vector of ScanResult object will be returned by |*out_scan_results|.
+  // Results are cached per interface. Kernel is only queried again once a
+  // scan result notification arrived or the cache was invalidated. Even
+  // then, a BSS that kernel did not update is not parsed again.
   // Returns true on success.
   virtual bool GetScanResult(
       uint32_t interface_index,
       std::vector<android::net::wifi::nl80211::NativeScanResult>* out_scan_results);
 
+  // Same as |GetScanResult|, but replaces the scan results in |out_batch|,
+  // which keeps them in a single arena.
+  virtual bool GetScanResultBatch(uint32_t interface_index,
+                                  ScanResultBatch* out_batch);
+
+  // Same as |GetScanResult| and |GetScanResultBatch|, but only gets the scan
+  // results whose SSID is matched by |ssids|.
+  virtual bool GetScanResult(
+      uint32_t interface_index,
+      const SsidMatcher& ssids,
+      std::vector<android::net::wifi::nl80211::NativeScanResult>* out_scan_results);
+  virtual bool GetScanResultBatch(uint32_t interface_index,
+                                  const SsidMatcher& ssids,
+                                  ScanResultBatch* out_batch);
+
+  // Gets the scan results of interface |interface_index| that were added,
+  // updated or expired since |generation|, which is the generation of an
+  // earlier returned delta.
+  // All scan results are returned in a delta marked as full if |generation|
+  // is unknown, e.g. 0, or if the history of expired BSSs was trimmed since.
+  // Kernel is queried the same way as by |GetScanResult|.
+  // Returns true on success.
+  virtual bool GetScanResultDelta(
+      uint32_t interface_index,
+      int64_t generation,
+      android::net::wifi::nl80211::NativeScanResultsDelta* out_delta);
+
+  // Gets the scan results of interface |interface_index| that match |query|,
+  // with only the fields |query| asks for.
+  // Results come from the cache if it is up to date. Otherwise kernel is
+  // queried, but the cache is not refreshed: BSSs that do not match are
+  // skipped before parsing, and fields that were not asked for are not
+  // copied.
+  // Returns true on success.
+  virtual bool QueryScanResults(
+      uint32_t interface_index,
+      const android::net::wifi::nl80211::ScanResultQuery& query,
+      std::vector<android::net::wifi::nl80211::NativeScanResult>*
+          out_scan_results);
+
+  // Returns whether the cached scan results of interface |interface_index|
+  // are up to date, i.e. whether |GetScanResult|, |GetScanResultDelta| and
+  // |QueryScanResults| would not query kernel. Those calls then do not modify
+  // the cache either.
+  virtual bool HasUpToDateScanResults(uint32_t interface_index) const;
+
+  // Fetches the scan results of interface |interface_index| from kernel into
+  // the cache, unless it is up to date already. Later |GetScanResult| calls
+  // are then served from the cache.
+  // Returns true on success.
+  virtual bool UpdateScanResultCache(uint32_t interface_index);
+
+  // Makes the next |GetScanResult| call for interface |interface_index| fetch
+  // all scan results from kernel. This is needed when the state of a BSS
+  // changes without kernel updating its BSS table, e.g. when it becomes the
+  // associated BSS.
+  virtual void InvalidateScanResultCache(uint32_t interface_index);
+
+  // Merges the scan results of the interfaces |peer_interface_indices|, which
+  // are on other radios of the device, into the cached scan results of
+  // interface |interface_index|. A BSS that both radios found is reported as
+  // |interface_index| found it. An empty list stops merging.
+  virtual void SetPeerRadioInterfaces(
+      uint32_t interface_index,
+      const std::vector<uint32_t>& peer_interface_indices);
+
+  // Limits the scan results cached per interface to |max_bss| BSSs, at
+  // least one. Once kernel reports more BSSs, those seen least recently are
+  // left out of the cache, except the associated one, and reported as
+  // expired by |GetScanResultDelta|.
+  void SetScanResultCacheCapacity(size_t max_bss);
+
+  // Parses the BSSs of large scan dumps on |num_threads| worker threads
+  // while the dump is still being received, instead of on the calling
+  // thread. 0, the default, parses all of them on the calling thread.
+  void SetNumParseThreads(size_t num_threads);
+
+  // Appends the number of cached scan results, their memory use and the
+  // number of BSSs left out of the cache so far to |ss|.
+  virtual void DumpScanResultCache(std::stringstream* ss) const;
+
+  // Appends the memory held by the cached scan results to |accounts|.
+  void GetMemoryAccounts(std::vector<MemoryAccount>* accounts) const;
+  // Drops the cached scan results of all interfaces, e.g. under memory
+  // pressure. They are dumped from kernel again when they are asked for
+  // next, and reported in a full delta by |GetScanResultDelta|.
+  virtual void TrimScanResultCache();
+
+  // Returns the number of cached scan results of interface |interface_index|
+  // in band |band|, one of |IWifiScannerImpl::SCAN_RESULT_BAND_*|.
+  virtual size_t GetNumScanResults(uint32_t interface_index,
+                                   int32_t band) const;
+
+  // Gets the 6 GHz frequencies that the Reduced Neighbor Report elements of
+  // the cached scan results of interface |interface_index| list APs on,
+  // without duplicates and in ascending order.
+  virtual void GetColocated6GhzFrequencies(
+      uint32_t interface_index,
+      std::vector<uint32_t>* out_frequencies) const;
+
+  // Gets the congestion of each channel of the cached scan results of
+  // interface |interface_index|, in ascending frequency order.
+  // Returns true on success.
+  virtual bool GetChannelCongestion(
+      uint32_t interface_index,
+      std::vector<android::net::wifi::nl80211::NativeChannelCongestion>*
+          out_channels);
+
+  // Keeps the history of the channels SSIDs were seen on in the file at
+  // |path|, so that it is remembered across restarts. Until then, the
+  // history is only kept in memory.
+  // Returns true on success.
+  bool OpenChannelHistory(const std::string& path);
+
+  // Gets the frequencies BSSs of |ssid| were seen on in past scan results,
+  // the most recently seen first.
+  // Returns false if |ssid| was never seen.
+  virtual bool GetChannelHistory(const std::vector<uint8_t>& ssid,
+                                 std::vector<uint32_t>* out_frequencies) const;
+
   // Send scan request to kernel for interface with index |interface_index|.
   // - |request_random_mac| If true, request device/driver to use a random MAC
   // address during scan. Requires |supports_random_mac_sched_scan|
@@ -101,6 +243,15 @@ class ScanUtils {
                     const std::vector<std::vector<uint8_t>>& ssids,
                     const std::vector<uint32_t>& freqs,
                     int* error_code);
+  // Like above, but reuses the request of earlier scans of the same
+  // settings from |request_cache|, and keeps the request there otherwise.
+  virtual bool Scan(uint32_t interface_index,
+                    bool request_random_mac,
+                    int scan_type,
+                    const std::vector<std::vector<uint8_t>>& ssids,
+                    const std::vector<uint32_t>& freqs,
+                    ScanRequestCache* request_cache,
+                    int* error_code);
 
   // Send scan request to kernel for interface with index |interface_index|.
   // - |inteval_ms| is the expected scan interval in milliseconds.
@@ -140,6 +291,24 @@ class ScanUtils {
       const std::vector<uint32_t>& freqs,
       int* error_code);
 
+  // Replaces the scheduled scan running on interface |interface_index|, if
+  // any, with a scheduled scan of the given settings. See
+  // StartScheduledScan() for the settings.
+  // The stop and start requests are sent together, so that kernel stops
+  // scanning for as short as possible.
+  // Returns true on success.
+  virtual bool RestartScheduledScan(
+      uint32_t interface_index,
+      const SchedScanIntervalSetting& interval_setting,
+      int32_t rssi_threshold_2g,
+      int32_t rssi_threshold_5g,
+      int32_t rssi_threshold_6g,
+      const SchedScanReqFlags& req_flags,
+      const std::vector<std::vector<uint8_t>>& scan_ssids,
+      const std::vector<std::vector<uint8_t>>& match_ssids,
+      const std::vector<uint32_t>& freqs,
+      int* error_code);
+
   // Stop existing scheduled scan on interface with index |interface_index|.
   // Returns true on success.
   // Returns false on error or when there is no scheduled scan running.
@@ -184,21 +353,166 @@ class ScanUtils {
   virtual void UnsubscribeSchedScanResultNotification(uint32_t interface_index);
 
  private:
+  // Identifies a BSS entry of kernel.
+  typedef std::pair<std::array<uint8_t, ETH_ALEN>, uint32_t> BssKey;
+  // Fields kernel changes whenever it updates a BSS entry, plus the
+  // association status.
+  struct BssFingerprint {
+    bool operator==(const BssFingerprint& rhs) const {
+      return last_seen_boottime == rhs.last_seen_boottime &&
+             tsf == rhs.tsf && status == rhs.status;
+    }
+    uint64_t last_seen_boottime = 0;
+    uint64_t tsf = 0;
+    uint32_t status = 0;
+  };
+  struct CachedBss {
+    BssFingerprint fingerprint;
+    // False if |fingerprint| could not be read, in which case the BSS is
+    // always parsed again.
+    bool has_fingerprint;
+    size_t index;
+    // Generation of the scan results in which the BSS was last updated.
+    // 0 until the dump the BSS was parsed from is complete.
+    int64_t generation;
+  };
+  struct RemovedBss {
+    BssKey key;
+    // Generation of the scan results in which the BSS first was missing.
+    int64_t generation;
+  };
+  // Scan results of one interface.
+  struct ScanResultCache {
+    // False once kernel might have new scan results.
+    bool up_to_date = false;
+    // Whether |generation| is the NL80211_ATTR_GENERATION of the dump
+    // |scan_results| come from, and can be used to skip the next dump.
+    bool has_generation = false;
+    uint32_t generation = 0;
+    std::vector<android::net::wifi::nl80211::NativeScanResult> scan_results;
+    // Hot fields of |scan_results|, for filtering.
+    ScanResultTable table;
+    // Congestion of the channels of |scan_results|.
+    ChannelCongestionMap congestion;
+    // Position of each BSS in |scan_results|.
+    std::map<BssKey, CachedBss> bss_index;
+    // Generation of |scan_results|, which is bumped whenever a BSS was
+    // added, updated or removed. 0 before the first dump.
+    // Unlike the kernel generation it is unique across interfaces and
+    // caches, so that a stale generation from a caller is never mistaken
+    // for a current one.
+    int64_t results_generation = 0;
+    // Oldest generation a delta can be computed from.
+    int64_t oldest_generation = 0;
+    // BSSs that expired after |oldest_generation|, oldest first.
+    std::deque<RemovedBss> removed_bsss;
+    // Approximate heap memory of |scan_results|, in bytes.
+    size_t num_bytes = 0;
+    // Bytes of |scan_results| taken by information elements identical to
+    // those of another BSS, e.g. of the BSSs of a multi-BSSID AP.
+    size_t num_duplicate_ie_bytes = 0;
+  };
+
+  // Marks the cached scan results of |interface_index|, and those that merge
+  // them in as a peer radio, as out of date.
+  void MarkScanResultsChanged(uint32_t interface_index);
+  // BSS of a scan dump that is parsed on |parse_pool_|.
+  struct PendingBss;
+  // Parses the BSSs of |batch|. Runs on worker threads, so it must not touch
+  // the state of this object.
+  void ParsePendingBsss(std::vector<PendingBss>* batch);
+  // Returns the up to date scan result cache of |interface_index|.
+  // Returns nullptr if kernel failed to dump its scan results.
+  const ScanResultCache* GetUpToDateScanResultCache(uint32_t interface_index);
+  // Moves the generation and history of expired BSSs of |cache| over to
+  // |new_cache|, which was built from a newer dump.
+  void UpdateScanResultGeneration(ScanResultCache* cache,
+                                  ScanResultCache* new_cache);
+  // Drops the BSS |key| from |new_cache|, which is being built from a new
+  // dump, and leaves it in the index of |cache| so that it is reported as
+  // expired.
+  void EvictBss(const BssKey& key,
+                ScanResultCache* cache,
+                ScanResultCache* new_cache);
+  // Recomputes the memory accounting of |cache|.
+  static void UpdateScanResultCacheMemory(ScanResultCache* cache);
+  // Updates |scan_result_memory_| from the caches of all interfaces.
+  void UpdateScanResultMemoryAccount();
+  // Sends a NL80211_CMD_GET_SCAN dump request for |interface_index| and
+  // passes each reply message to |handler|.
+  // Returns true on success.
+  bool DumpScanResults(
+      uint32_t interface_index,
+      const std::function<void(const NL80211PacketView&)>& handler);
+  // Checks that |packet| is a scan result of interface |interface_index|.
+  // Results that kernel marked as filtered by interface are not checked
+  // again.
+  bool IsScanResultOfInterface(const NL80211PacketView& packet,
+                               uint32_t interface_index);
+  // Reads the key and fingerprint of the BSS in a NL80211_CMD_NEW_SCAN_RESULTS
+  // message without copying it.
+  bool GetBssFingerprint(const NL80211PacketView& packet,
+                         BssKey* key,
+                         BssFingerprint* fingerprint);
   bool GetBssTimestamp(const NL80211NestedAttr& bss,
                        uint64_t* last_seen_since_boot_microseconds);
   bool ParseRadioChainInfos(
       const NL80211NestedAttr& bss,
       std::vector<android::net::wifi::nl80211::RadioChainInfo>
         *radio_chain_infos);
-  bool GetSSIDFromInfoElement(const std::vector<uint8_t>& ie,
+  bool GetSSIDFromInfoElement(const uint8_t* ie,
+                              size_t ie_length,
                               std::vector<uint8_t>* ssid);
+  // Builds the NL80211_CMD_TRIGGER_SCAN request of Scan(), without a
+  // sequence number and port id.
+  NL80211Packet CreateScanRequest(
+      uint32_t interface_index,
+      bool request_random_mac,
+      int scan_type,
+      const std::vector<std::vector<uint8_t>>& ssids,
+      const std::vector<uint32_t>& freqs);
+  // Sends NL80211_CMD_TRIGGER_SCAN request |request| with the next sequence
+  // number.
+  bool SendScanRequest(NL80211Packet* request, int* error_code);
+  // Builds the NL80211_CMD_START_SCHED_SCAN request of StartScheduledScan().
+  NL80211Packet CreateStartSchedScanRequest(
+      uint32_t interface_index,
+      const SchedScanIntervalSetting& interval_setting,
+      int32_t rssi_threshold_2g,
+      int32_t rssi_threshold_5g,
+      int32_t rssi_threshold_6g,
+      const SchedScanReqFlags& req_flags,
+      const std::vector<std::vector<uint8_t>>& scan_ssids,
+      const std::vector<std::vector<uint8_t>>& match_ssids,
+      const std::vector<uint32_t>& freqs);
   // Converts a NL80211_CMD_NEW_SCAN_RESULTS packet to a ScanResult object.
+  // Only copies the optional fields that |fields|, a bit mask of
+  // |IWifiScannerImpl::SCAN_RESULT_FIELD_*| values, asks for.
   bool ParseScanResult(
-      std::unique_ptr<const NL80211Packet> packet,
+      const NL80211PacketView& packet,
+      int32_t fields,
       android::net::wifi::nl80211::NativeScanResult* scan_result);
 
   NetlinkManager* netlink_manager_;
 
+  // A mapping from interface index to its cached scan results.
+  std::map<uint32_t, ScanResultCache> scan_result_cache_;
+  // Interfaces on other radios whose scan results are merged into the cache
+  // of an interface, keyed by the index of that interface.
+  std::map<uint32_t, std::vector<uint32_t>> peer_radio_interfaces_;
+  // The last generation assigned to the scan results of any interface.
+  int64_t last_scan_results_generation_;
+  // Maximum number of BSSs cached per interface.
+  size_t scan_result_cache_capacity_;
+  // Number of BSSs left out of a cache because it was full.
+  uint64_t num_evicted_bss_;
+  MemoryAccount scan_result_memory_;
+  // Channels of the SSIDs of the scan results of all interfaces.
+  ChannelHistory channel_history_;
+  // Parses BSSs of large scan dumps. Null unless SetNumParseThreads() was
+  // called with at least one thread.
+  std::unique_ptr<WorkerPool> parse_pool_;
+
   DISALLOW_COPY_AND_ASSIGN(ScanUtils);
 };
 
@@ -14,25 +14,49 @@
  * limitations under the License.
  */
 
+#define ATRACE_TAG ATRACE_TAG_NETWORK
+
 #include "wificond/scanning/scanner_impl.h"
 
-#include <set>
+#include <algorithm>
+#include <iterator>
 #include <string>
 #include <vector>
 
 #include <android-base/logging.h>
+#include <binder/IPCThreadState.h>
+#include <utils/Trace.h>
 
+#include "wificond/binder_call_dispatcher.h"
 #include "wificond/client_interface_impl.h"
+#include "wificond/flight_recorder.h"
+#include "wificond/logging_utils.h"
+#include "wificond/net/channel_set.h"
+#include "wificond/scanning/scan_result_batch.h"
+#include "wificond/scanning/scan_result_table.h"
+#include "wificond/scanning/scan_results_buffer.h"
 #include "wificond/scanning/scan_utils.h"
 
+using android::base::unique_fd;
 using android::binder::Status;
+using android::IPCThreadState;
+using android::os::ParcelFileDescriptor;
 using android::sp;
+using android::net::wifi::nl80211::BnWifiScannerImpl;
+using android::net::wifi::nl80211::BssWatchSettings;
+using android::net::wifi::nl80211::IBssWatchCallback;
 using android::net::wifi::nl80211::IPnoScanEvent;
 using android::net::wifi::nl80211::IScanEvent;
 using android::net::wifi::nl80211::IWifiScannerImpl;
+using android::net::wifi::nl80211::NativeChannelCongestion;
 using android::net::wifi::nl80211::NativeScanResult;
+using android::net::wifi::nl80211::NativeScanResultsDelta;
+using android::net::wifi::nl80211::NativeScanStats;
+using android::net::wifi::nl80211::PnoNetwork;
 using android::net::wifi::nl80211::PnoSettings;
+using android::net::wifi::nl80211::ScanResultQuery;
 using android::net::wifi::nl80211::SingleScanSettings;
+using android::wificond::ChannelSet;
 
 using std::string;
 using std::vector;
@@ -42,6 +66,37 @@ using std::shared_ptr;
 using namespace std::placeholders;
 
 namespace {
+
+// Async atrace slice from triggering a single scan until kernel reports its
+// results, keyed by interface index.
+const char kSingleScanTraceName[] = "wificond single scan";
+
+// A single scan is considered stuck if kernel doesn't report its end within
+// a base time plus a dwell time per channel. These are a few times what
+// scans take, so that only scans that got lost trip the watchdog.
+constexpr int64_t kScanWatchdogBaseMs = 5000;
+constexpr int64_t kScanWatchdogDwellMs = 100;
+constexpr int64_t kScanWatchdogAccurateDwellMs = 200;
+constexpr int64_t kScanWatchdogSlackMs = 1000;
+
+// 6 GHz Preferred Scanning Channels are channel 5 and every 16th channel
+// after it, on which 6 GHz only APs are found without a Reduced Neighbor
+// Report. See IEEE Std 802.11ax: 26.17.2.3.3.
+constexpr uint32_t kFirstPscFrequency = 5975;
+constexpr uint32_t kPscFrequencySpacing = 80;
+
+constexpr ChannelSet GetPreferredScanningChannels() {
+  ChannelSet channels;
+  for (uint32_t frequency = kFirstPscFrequency;
+       ChannelSet::GetBand(frequency) == ChannelSet::kBand6Ghz;
+       frequency += kPscFrequencySpacing) {
+    channels.Add(frequency);
+  }
+  return channels;
+}
+constexpr ChannelSet kPreferredScanningChannels =
+    GetPreferredScanningChannels();
+
 using android::wificond::WiphyFeatures;
 bool IsScanTypeSupported(int scan_type, const WiphyFeatures& wiphy_features) {
   switch(scan_type) {
@@ -57,9 +112,51 @@ bool IsScanTypeSupported(int scan_type, const WiphyFeatures& wiphy_features) {
   return {};
 }
 
+// Number of scans at the final interval that a shard of rotated PNO networks
+// gets before the next shard is matched.
+constexpr const uint32_t kNumPnoScansPerShard = 2;
+
+// Returns whether |network| is more likely to be in range than
+// |other_network|: networks used more often come first, then the ones used
+// more recently, then hidden ones, which are only found when probed for.
+bool HasHigherPnoPriority(const PnoNetwork* network,
+                          const PnoNetwork* other_network) {
+  if (network->num_connections_ != other_network->num_connections_) {
+    return network->num_connections_ > other_network->num_connections_;
+  }
+  if (network->last_connected_ms_ != other_network->last_connected_ms_) {
+    return network->last_connected_ms_ > other_network->last_connected_ms_;
+  }
+  return network->is_hidden_ && !other_network->is_hidden_;
+}
+
+// Returns how long kernel takes to go through the scan plans of
+// |interval_setting| and then scan |num_final_scans| times at the final
+// interval.
+int64_t GetSchedScanDurationMs(
+    const android::wificond::SchedScanIntervalSetting& interval_setting,
+    uint32_t num_final_scans) {
+  int64_t duration_ms = 0;
+  for (const auto& plan : interval_setting.plans) {
+    duration_ms += static_cast<int64_t>(plan.interval_ms) * plan.n_iterations;
+  }
+  return duration_ms +
+      static_cast<int64_t>(interval_setting.final_interval_ms) *
+          num_final_scans;
+}
+
 constexpr const int kPercentNetworksWithFreq = 30;
 constexpr const int kPnoScanDefaultFreqs[] = {2412, 2417, 2422, 2427, 2432, 2437, 2447, 2452,
     2457, 2462, 5180, 5200, 5220, 5240, 5745, 5765, 5785, 5805};
+
+constexpr ChannelSet GetPnoScanDefaultChannels() {
+  ChannelSet channels;
+  for (int frequency : kPnoScanDefaultFreqs) {
+    channels.Add(frequency);
+  }
+  return channels;
+}
+constexpr ChannelSet kPnoScanDefaultChannels = GetPnoScanDefaultChannels();
 } // namespace
 
 namespace android {
@@ -69,16 +166,33 @@ ScannerImpl::ScannerImpl(uint32_t interface_index,
                          const ScanCapabilities& scan_capabilities,
                          const WiphyFeatures& wiphy_features,
                          ClientInterfaceImpl* client_interface,
-                         ScanUtils* scan_utils)
+                         ScanUtils* scan_utils,
+                         EventLoop* event_loop)
     : valid_(true),
       scan_started_(false),
       pno_scan_started_(false),
+      pno_shard_index_(0),
+      pno_rotation_timer_(EventLoop::kInvalidTimerId),
+      num_pending_restart_stops_(0),
       nodev_counter_(0),
       interface_index_(interface_index),
       scan_capabilities_(scan_capabilities),
       wiphy_features_(wiphy_features),
+      scan_start_time_(0),
+      scan_watchdog_timer_(EventLoop::kInvalidTimerId),
+      num_scan_timeouts_(0),
+      late_scan_end_pending_(false),
+      scan_scheduler_(scan_capabilities.max_num_scan_ssids),
+      sub_scan_bands_(0),
+      split_scan_failed_(false),
+      num_peer_sub_scans_(0),
+      num_peer_sub_scans_started_(0),
+      peer_scan_owner_(nullptr),
+      peer_scan_bands_(0),
       client_interface_(client_interface),
       scan_utils_(scan_utils),
+      event_loop_(event_loop),
+      callback_dispatcher_(nullptr),
       scan_event_handler_(nullptr) {
   // Subscribe one-shot scan result notification from kernel.
   LOG(INFO) << "subscribe scan result for interface with index: "
@@ -94,14 +208,56 @@ ScannerImpl::ScannerImpl(uint32_t interface_index,
                 _1, _2));
 }
 
-ScannerImpl::~ScannerImpl() {}
+ScannerImpl::~ScannerImpl() {
+  CancelPnoShardRotation();
+  CancelScanWatchdog();
+}
 
 void ScannerImpl::Invalidate() {
   LOG(INFO) << "Unsubscribe scan result for interface with index: "
             << (int)interface_index_;
   scan_utils_->UnsubscribeScanResultNotification(interface_index_);
   scan_utils_->UnsubscribeSchedScanResultNotification(interface_index_);
+  scan_scheduler_.Clear();
+  scan_arbiter_.Clear();
+  pending_sub_scans_.clear();
+  external_scan_callbacks_.clear();
+  bss_watches_.clear();
+  CancelPnoShardRotation();
+  CancelScanWatchdog();
   valid_ = false;
+  // Peer radios must not call back into this scanner any more.
+  ScannerImpl* peer_scan_owner = peer_scan_owner_;
+  peer_scan_owner_ = nullptr;
+  if (peer_scan_owner != nullptr) {
+    peer_scan_owner->OnPeerSubScanDone(peer_scan_bands_, false);
+  }
+  for (ScannerImpl* peer : peer_radios_) {
+    if (peer->peer_scan_owner_ == this) {
+      peer->peer_scan_owner_ = nullptr;
+    }
+    vector<ScannerImpl*> peers_of_peer = peer->peer_radios_;
+    peers_of_peer.erase(
+        std::remove(peers_of_peer.begin(), peers_of_peer.end(), this),
+        peers_of_peer.end());
+    peer->SetPeerRadios(peers_of_peer);
+  }
+  peer_radios_.clear();
+  num_peer_sub_scans_ = 0;
+  scan_utils_->SetPeerRadioInterfaces(interface_index_, {});
+}
+
+void ScannerImpl::SetPeerRadios(const vector<ScannerImpl*>& peers) {
+  if (!valid_) {
+    return;
+  }
+  peer_radios_ = peers;
+  vector<uint32_t> peer_interface_indices;
+  for (const ScannerImpl* peer : peer_radios_) {
+    peer_interface_indices.push_back(peer->interface_index_);
+  }
+  scan_utils_->SetPeerRadioInterfaces(interface_index_,
+                                      peer_interface_indices);
 }
 
 bool ScannerImpl::CheckIsValid() {
@@ -113,6 +269,7 @@ bool ScannerImpl::CheckIsValid() {
 }
 
 Status ScannerImpl::getScanResults(vector<NativeScanResult>* out_scan_results) {
+  ATRACE_CALL();
   if (!CheckIsValid()) {
     return Status::ok();
   }
@@ -127,78 +284,430 @@ Status ScannerImpl::getPnoScanResults(
   if (!CheckIsValid()) {
     return Status::ok();
   }
-  if (!scan_utils_->GetScanResult(interface_index_, out_scan_results)) {
+  const SsidMatcher* ssids = GetPnoScanResultSsids();
+  bool success = ssids != nullptr ?
+      scan_utils_->GetScanResult(interface_index_, *ssids, out_scan_results) :
+      scan_utils_->GetScanResult(interface_index_, out_scan_results);
+  if (!success) {
     LOG(ERROR) << "Failed to get scan results via NL80211";
   }
   return Status::ok();
 }
 
+Status ScannerImpl::getScanResultsDelta(int64_t generation,
+                                        NativeScanResultsDelta* out_delta) {
+  if (!CheckIsValid()) {
+    return Status::ok();
+  }
+  if (!scan_utils_->GetScanResultDelta(interface_index_, generation,
+                                       out_delta)) {
+    LOG(ERROR) << "Failed to get scan result delta via NL80211";
+  }
+  return Status::ok();
+}
+
+Status ScannerImpl::getScanResultsMemory(ParcelFileDescriptor* out_memory) {
+  // Like |getScanResults|, failures lead to empty scan results.
+  vector<NativeScanResult> scan_results;
+  if (CheckIsValid() &&
+      !scan_utils_->GetScanResult(interface_index_, &scan_results)) {
+    LOG(ERROR) << "Failed to get scan results via NL80211";
+  }
+  unique_fd memory = ScanResultsBuffer::CreateSharedMemory(scan_results);
+  if (memory.get() < 0) {
+    return Status::fromExceptionCode(Status::EX_ILLEGAL_STATE,
+                                     "Failed to create scan results memory");
+  }
+  *out_memory = ParcelFileDescriptor(std::move(memory));
+  return Status::ok();
+}
+
+Status ScannerImpl::queryScanResults(
+    const ScanResultQuery& query,
+    vector<NativeScanResult>* out_scan_results) {
+  if (!CheckIsValid()) {
+    return Status::ok();
+  }
+  if (!scan_utils_->QueryScanResults(interface_index_, query,
+                                     out_scan_results)) {
+    LOG(ERROR) << "Failed to query scan results via NL80211";
+  }
+  if (query.fields & IWifiScannerImpl::SCAN_RESULT_FIELD_IE_INDEX) {
+    for (auto& scan_result : *out_scan_results) {
+      scan_result.parcel_ie_index = true;
+    }
+  }
+  return Status::ok();
+}
+
 Status ScannerImpl::scan(const SingleScanSettings& scan_settings,
                          bool* out_success) {
+  ATRACE_CALL();
   if (!CheckIsValid()) {
     *out_success = false;
     return Status::ok();
   }
 
-  if (scan_started_) {
-    LOG(WARNING) << "Scan already started";
-  }
-  // Only request MAC address randomization when station is not associated.
-  bool request_random_mac =
-      wiphy_features_.supports_random_mac_oneshot_scan &&
-      !client_interface_->IsAssociated();
-  int scan_type = scan_settings.scan_type_;
+  SingleScanRequest request;
+  request.scan_type = scan_settings.scan_type_;
   if (!IsScanTypeSupported(scan_settings.scan_type_, wiphy_features_)) {
     LOG(DEBUG) << "Ignoring scan type because device does not support it";
-    scan_type = SCAN_TYPE_DEFAULT;
+    request.scan_type = SCAN_TYPE_DEFAULT;
   }
 
   // Initialize it with an empty ssid for a wild card scan.
-  vector<vector<uint8_t>> ssids = {{}};
+  request.ssids = {{}};
 
-  vector<vector<uint8_t>> skipped_scan_ssids;
+  vector<vector<uint8_t>> hidden_ssids;
   for (auto& network : scan_settings.hidden_networks_) {
-    if (ssids.size() + 1 > scan_capabilities_.max_num_scan_ssids) {
-      skipped_scan_ssids.emplace_back(network.ssid_);
-      continue;
-    }
-    ssids.push_back(network.ssid_);
+    hidden_ssids.push_back(network.ssid_);
   }
+  // Hidden SSIDs that don't fit take turns with the others over scans.
+  size_t max_hidden_ssids = scan_capabilities_.max_num_scan_ssids > 0 ?
+      scan_capabilities_.max_num_scan_ssids - 1 : 0;
+  vector<vector<uint8_t>> skipped_scan_ssids;
+  hidden_ssid_rotation_.Pick(hidden_ssids, max_hidden_ssids,
+                             &request.ssids, &skipped_scan_ssids);
 
   LogSsidList(skipped_scan_ssids, "Skip scan ssid for single scan");
 
-  vector<uint32_t> freqs;
   for (auto& channel : scan_settings.channel_settings_) {
-    freqs.push_back(channel.frequency_);
+    request.freqs.push_back(channel.frequency_);
+  }
+  if (scan_settings.enable_channel_hints_ && request.freqs.empty() &&
+      request.ssids.size() > 1 &&
+      GetChannelHints(request.ssids, &request.freqs)) {
+    LOG(INFO) << "Scan for hidden networks on " << request.freqs.size()
+              << " channels they were seen on";
+  }
+  if (scan_settings.enable_6ghz_rnr_planning_ && request.freqs.empty()) {
+    size_t num_6g_freqs = Plan6GhzScan(&request.freqs);
+    LOG(DEBUG) << "Scan " << num_6g_freqs << " 6 GHz channels";
+  }
+
+  uid_t uid = IPCThreadState::self()->getCallingUid();
+  nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+  if (!IsScanBusy() &&
+      scan_utils_->HasUpToDateScanResults(interface_index_) &&
+      scan_arbiter_.TryServeFromRecentScan(request, now)) {
+    LOG(INFO) << "Serve scan request of uid " << uid
+              << " with the results of a recent scan";
+    if (!NotifyWaitingCallers({uid}, true) && scan_event_handler_ != nullptr) {
+      NotifyScanEvent(scan_event_handler_, kScanResultReady);
+    }
+    *out_success = true;
+    return Status::ok();
+  }
+  // Requests that the scan in flight covers cost no scan of their own.
+  bool covered = IsScanBusy() &&
+      scan_scheduler_.IsCoveredByScanInFlight(request);
+  if (!covered && !scan_arbiter_.TryAcquireQuota(uid, now)) {
+    LOG(WARNING) << "Reject scan request of uid " << uid
+                 << ", which is over its scan quota";
+    *out_success = false;
+    return Status::ok();
   }
 
+  // Kernel would reject another scan with EBUSY until the one in flight is
+  // done. The caller is notified when the scan that covers this request
+  // is done.
+  if (IsScanBusy()) {
+    bool follow_up = scan_scheduler_.AddRequest(request);
+    if (follow_up) {
+      LOG(INFO) << "Scan already started, queue a follow-up scan";
+    } else {
+      LOG(INFO) << "Scan already started and covers the request";
+    }
+    scan_arbiter_.AddWaitingCaller(uid, follow_up);
+    *out_success = true;
+    return Status::ok();
+  }
+  if (scan_settings.enable_split_scan_) {
+    *out_success = StartSplitScan(request);
+  } else {
+    *out_success = StartSingleScan(request);
+    if (*out_success) {
+      scan_scheduler_.OnScanStarted(request);
+    }
+  }
+  if (*out_success) {
+    scan_arbiter_.AddWaitingCaller(uid, false);
+  }
+  return Status::ok();
+}
+
+bool ScannerImpl::GetChannelHints(const vector<vector<uint8_t>>& ssids,
+                                  vector<uint32_t>* out_freqs) const {
+  ChannelSet unique_frequencies;
+  for (const auto& ssid : ssids) {
+    if (ssid.empty()) {
+      // Wildcard SSID.
+      continue;
+    }
+    vector<uint32_t> frequencies;
+    if (!scan_utils_->GetChannelHistory(ssid, &frequencies)) {
+      return false;
+    }
+    unique_frequencies |= ChannelSet(frequencies);
+  }
+  out_freqs->clear();
+  unique_frequencies.AppendTo(out_freqs);
+  return true;
+}
+
+size_t ScannerImpl::Plan6GhzScan(vector<uint32_t>* out_freqs) const {
+  const BandInfo& band_info = client_interface_->GetBandInfo();
+  vector<uint32_t> colocated_freqs;
+  scan_utils_->GetColocated6GhzFrequencies(interface_index_,
+                                           &colocated_freqs);
+  const ChannelSet planned_6g_freqs =
+      ChannelSet(colocated_freqs) | kPreferredScanningChannels;
+  for (const vector<uint32_t>* band : {&band_info.band_2g,
+                                       &band_info.band_5g,
+                                       &band_info.band_dfs}) {
+    out_freqs->insert(out_freqs->end(), band->begin(), band->end());
+  }
+  size_t num_6g_freqs = 0;
+  for (uint32_t freq : band_info.band_6g) {
+    if (planned_6g_freqs.Contains(freq)) {
+      out_freqs->push_back(freq);
+      num_6g_freqs++;
+    }
+  }
+  return num_6g_freqs;
+}
+
+bool ScannerImpl::StartSingleScan(const SingleScanRequest& request) {
+  // Only request MAC address randomization when station is not associated.
+  bool request_random_mac =
+      wiphy_features_.supports_random_mac_oneshot_scan &&
+      !client_interface_->IsAssociated();
   int error_code = 0;
-  if (!scan_utils_->Scan(interface_index_, request_random_mac, scan_type,
-                         ssids, freqs, &error_code)) {
+  if (!scan_utils_->Scan(interface_index_, request_random_mac,
+                         request.scan_type, request.ssids, request.freqs,
+                         &scan_request_cache_, &error_code)) {
     if (error_code == ENODEV) {
         nodev_counter_ ++;
         LOG(WARNING) << "Scan failed with error=nodev. counter=" << nodev_counter_;
     }
     CHECK(error_code != ENODEV || nodev_counter_ <= 3)
         << "Driver is in a bad state, restarting wificond";
-    *out_success = false;
-    return Status::ok();
+    return false;
   }
   nodev_counter_ = 0;
+  ATRACE_ASYNC_BEGIN(kSingleScanTraceName, interface_index_);
   scan_started_ = true;
-  *out_success = true;
-  return Status::ok();
+  scan_in_flight_ = request;
+  scan_start_time_ = systemTime(SYSTEM_TIME_MONOTONIC);
+  StartScanWatchdog(request);
+  return true;
+}
+
+void ScannerImpl::StartScanWatchdog(const SingleScanRequest& request) {
+  CancelScanWatchdog();
+  if (event_loop_ == nullptr) {
+    return;
+  }
+  scan_watchdog_timer_ = event_loop_->PostCancelableDelayedTask(
+      [this]() {
+        scan_watchdog_timer_ = EventLoop::kInvalidTimerId;
+        OnScanWatchdogTimeout();
+      },
+      GetScanTimeoutMs(request),
+      kScanWatchdogSlackMs);
+}
+
+void ScannerImpl::CancelScanWatchdog() {
+  if (scan_watchdog_timer_ != EventLoop::kInvalidTimerId) {
+    event_loop_->CancelDelayedTask(scan_watchdog_timer_);
+    scan_watchdog_timer_ = EventLoop::kInvalidTimerId;
+  }
+}
+
+void ScannerImpl::OnScanWatchdogTimeout() {
+  if (!scan_started_) {
+    return;
+  }
+  LOG(ERROR) << "Scan did not complete within "
+             << GetScanTimeoutMs(scan_in_flight_) << "ms, aborting it";
+  num_scan_timeouts_++;
+  // Kernel reports the end of a scan it aborted, as aborted or with results
+  // if the scan completed meanwhile. It has no scan to abort if it lost it.
+  bool late_scan_end_pending = scan_utils_->AbortScan(interface_index_);
+  if (!late_scan_end_pending) {
+    LOG(WARNING) << "Abort scan failed";
+  }
+  // Kernel may never report the end of the scan, so report it as aborted
+  // right away.
+  vector<vector<uint8_t>> ssids;
+  vector<uint32_t> frequencies;
+  OnScanResultsReady(interface_index_, true, ssids, frequencies);
+  // Set after reporting, since the next scan may have started already.
+  late_scan_end_pending_ = late_scan_end_pending;
+}
+
+int64_t ScannerImpl::GetScanTimeoutMs(const SingleScanRequest& request) const {
+  size_t num_channels = request.freqs.size();
+  if (num_channels == 0) {
+    const BandInfo& band_info = client_interface_->GetBandInfo();
+    num_channels = band_info.band_2g.size() + band_info.band_5g.size() +
+        band_info.band_dfs.size() + band_info.band_6g.size();
+  }
+  int64_t dwell_time_ms =
+      request.scan_type == IWifiScannerImpl::SCAN_TYPE_HIGH_ACCURACY ?
+          kScanWatchdogAccurateDwellMs : kScanWatchdogDwellMs;
+  return kScanWatchdogBaseMs +
+      dwell_time_ms * static_cast<int64_t>(num_channels);
+}
+
+bool ScannerImpl::StartSplitScan(const SingleScanRequest& request) {
+  vector<SubScanRequest> sub_scans = ScanRequestScheduler::SplitByBand(
+      request, client_interface_->GetBandInfo());
+  if (sub_scans.size() < 2) {
+    // Nothing to split.
+    if (!StartSingleScan(request)) {
+      return false;
+    }
+    scan_scheduler_.OnScanStarted(request);
+    return true;
+  }
+  if (!StartSingleScan(sub_scans[0].request)) {
+    return false;
+  }
+  // Requests that arrive meanwhile are checked against all the bands.
+  scan_scheduler_.OnScanStarted(request);
+  sub_scan_bands_ = sub_scans[0].bands;
+  split_scan_failed_ = false;
+  pending_sub_scans_.assign(std::make_move_iterator(sub_scans.begin() + 1),
+                            std::make_move_iterator(sub_scans.end()));
+  LOG(INFO) << "Split scan started in " << sub_scans.size() << " sub-scans";
+  StartPeerSubScans();
+  return true;
+}
+
+void ScannerImpl::StartPeerSubScans() {
+  ScannerImpl* peer = nullptr;
+  for (ScannerImpl* candidate : peer_radios_) {
+    if (candidate->IsIdleForPeerScan()) {
+      peer = candidate;
+      break;
+    }
+  }
+  if (peer == nullptr) {
+    return;
+  }
+  size_t own_channels = scan_in_flight_.freqs.size();
+  size_t peer_channels = 0;
+  SubScanRequest peer_sub_scan;
+  peer_sub_scan.bands = 0;
+  std::deque<SubScanRequest> own_sub_scans;
+  for (const SubScanRequest& sub_scan : pending_sub_scans_) {
+    if (peer_channels < own_channels &&
+        peer->SupportsFrequencies(sub_scan.request.freqs)) {
+      if (peer_sub_scan.bands == 0) {
+        peer_sub_scan = sub_scan;
+      } else {
+        peer_sub_scan.bands |= sub_scan.bands;
+        peer_sub_scan.request.freqs.insert(peer_sub_scan.request.freqs.end(),
+                                           sub_scan.request.freqs.begin(),
+                                           sub_scan.request.freqs.end());
+      }
+      peer_channels += sub_scan.request.freqs.size();
+    } else {
+      own_channels += sub_scan.request.freqs.size();
+      own_sub_scans.push_back(sub_scan);
+    }
+  }
+  if (peer_sub_scan.bands == 0 ||
+      !peer->StartSubScanForPeer(peer_sub_scan, this)) {
+    return;
+  }
+  pending_sub_scans_ = std::move(own_sub_scans);
+  num_peer_sub_scans_ = 1;
+  num_peer_sub_scans_started_++;
+  LOG(INFO) << "Scan " << peer_channels << " channels of the split scan"
+            << " on interface " << peer->interface_index_ << " in parallel";
+}
+
+bool ScannerImpl::StartSubScanForPeer(const SubScanRequest& sub_scan,
+                                      ScannerImpl* owner) {
+  if (!IsIdleForPeerScan() || !StartSingleScan(sub_scan.request)) {
+    return false;
+  }
+  // Requests to this radio that arrive meanwhile are queued behind it.
+  scan_scheduler_.OnScanStarted(sub_scan.request);
+  peer_scan_owner_ = owner;
+  peer_scan_bands_ = sub_scan.bands;
+  return true;
+}
+
+void ScannerImpl::OnPeerSubScanDone(int32_t bands, bool success) {
+  if (!valid_ || num_peer_sub_scans_ == 0) {
+    return;
+  }
+  num_peer_sub_scans_--;
+  if (!success) {
+    split_scan_failed_ = true;
+  }
+  if (IsScanBusy()) {
+    if (success && scan_event_handler_ != nullptr) {
+      ATRACE_NAME("IScanEvent::OnPartialScanResultReady");
+      NotifyScanEvent(scan_event_handler_, kPartialScanResultReady, bands);
+    }
+    return;
+  }
+  // This radio finished its own part of the split scan before. The results
+  // are fetched again, now that they include the ones of the peer.
+  success = !split_scan_failed_;
+  split_scan_failed_ = false;
+  bool has_results =
+      success && scan_utils_->UpdateScanResultCache(interface_index_);
+  FinishScan(true, success, has_results, nullptr);
+}
+
+void ScannerImpl::AbortPeerSubScans() {
+  for (ScannerImpl* peer : peer_radios_) {
+    if (peer->peer_scan_owner_ == this &&
+        !scan_utils_->AbortScan(peer->interface_index_)) {
+      LOG(WARNING) << "Abort scan on peer radio failed";
+    }
+  }
+}
+
+bool ScannerImpl::IsScanBusy() const {
+  return scan_started_ || num_peer_sub_scans_ > 0;
+}
+
+bool ScannerImpl::IsIdleForPeerScan() const {
+  return valid_ && !IsScanBusy() && !client_interface_->IsAssociated();
+}
+
+bool ScannerImpl::SupportsFrequencies(const vector<uint32_t>& freqs) const {
+  const BandInfo& band_info = client_interface_->GetBandInfo();
+  ChannelSet supported;
+  for (const vector<uint32_t>* band : {&band_info.band_2g,
+                                       &band_info.band_5g,
+                                       &band_info.band_dfs,
+                                       &band_info.band_6g}) {
+    supported |= ChannelSet(*band);
+  }
+  for (uint32_t freq : freqs) {
+    if (!supported.Contains(freq)) {
+      return false;
+    }
+  }
+  return !freqs.empty();
 }
 
 Status ScannerImpl::startPnoScan(const PnoSettings& pno_settings,
                                  bool* out_success) {
-  pno_settings_ = pno_settings;
+  SetPnoSettings(pno_settings);
   LOG(VERBOSE) << "startPnoScan";
   *out_success = StartPnoScanDefault(pno_settings);
   return Status::ok();
 }
 
-void ScannerImpl::ParsePnoSettings(const PnoSettings& pno_settings,
+void ScannerImpl::ParsePnoSettings(const vector<const PnoNetwork*>& networks,
                                    vector<vector<uint8_t>>* scan_ssids,
                                    vector<vector<uint8_t>>* match_ssids,
                                    vector<uint32_t>* freqs,
@@ -207,85 +716,190 @@ void ScannerImpl::ParsePnoSettings(const PnoSettings& pno_settings,
   const uint8_t kNetworkFlagsDefault = 0;
   vector<vector<uint8_t>> skipped_scan_ssids;
   vector<vector<uint8_t>> skipped_match_ssids;
-  std::set<int32_t> unique_frequencies;
+  ChannelSet unique_frequencies;
   int num_networks_no_freqs = 0;
-  for (auto& network : pno_settings.pno_networks_) {
+  for (const PnoNetwork* network : networks) {
     // Add hidden network ssid.
-    if (network.is_hidden_) {
+    if (network->is_hidden_) {
       if (scan_ssids->size() + 1 >
           scan_capabilities_.max_num_sched_scan_ssids) {
-        skipped_scan_ssids.emplace_back(network.ssid_);
+        skipped_scan_ssids.emplace_back(network->ssid_);
         continue;
       }
-      scan_ssids->push_back(network.ssid_);
+      scan_ssids->push_back(network->ssid_);
     }
 
     if (match_ssids->size() + 1 > scan_capabilities_.max_match_sets) {
-      skipped_match_ssids.emplace_back(network.ssid_);
+      skipped_match_ssids.emplace_back(network->ssid_);
       continue;
     }
-    match_ssids->push_back(network.ssid_);
+    match_ssids->push_back(network->ssid_);
     match_security->push_back(kNetworkFlagsDefault);
 
     // build the set of unique frequencies to scan for.
-    for (const auto& frequency : network.frequencies_) {
-      unique_frequencies.insert(frequency);
+    for (const auto& frequency : network->frequencies_) {
+      if (!unique_frequencies.Add(frequency)) {
+        LOG(WARNING) << "Ignoring invalid pno frequency " << frequency;
+      }
     }
-    if (network.frequencies_.empty()) {
-      num_networks_no_freqs++;
+    if (network->frequencies_.empty()) {
+      // Fall back to the channels the network was seen on before.
+      vector<uint32_t> seen_frequencies;
+      if (scan_utils_->GetChannelHistory(network->ssid_, &seen_frequencies)) {
+        unique_frequencies |= ChannelSet(seen_frequencies);
+      } else {
+        num_networks_no_freqs++;
+      }
     }
   }
 
   // Also scan the default frequencies if there is frequency data passed down but more than 30% of
   // networks don't have frequency data.
-  if (unique_frequencies.size() > 0 && num_networks_no_freqs * 100 / match_ssids->size()
+  if (!unique_frequencies.empty() && num_networks_no_freqs * 100 / match_ssids->size()
       > kPercentNetworksWithFreq) {
-    unique_frequencies.insert(std::begin(kPnoScanDefaultFreqs), std::end(kPnoScanDefaultFreqs));
-  }
-  for (const auto& frequency : unique_frequencies) {
-    freqs->push_back(frequency);
+    unique_frequencies |= kPnoScanDefaultChannels;
   }
+  unique_frequencies.AppendTo(freqs);
   LogSsidList(skipped_scan_ssids, "Skip scan ssid for pno scan");
   LogSsidList(skipped_match_ssids, "Skip match ssid for pno scan");
 }
 
-bool ScannerImpl::StartPnoScanDefault(const PnoSettings& pno_settings) {
-  if (!CheckIsValid()) {
-    return false;
+size_t ScannerImpl::GetNumPnoShards(const PnoSettings& pno_settings) const {
+  size_t num_networks = pno_settings.pno_networks_.size();
+  size_t max_match_sets = scan_capabilities_.max_match_sets;
+  if (!pno_settings.enable_network_rotation_ || max_match_sets == 0 ||
+      num_networks <= max_match_sets) {
+    return 1;
   }
-  if (pno_scan_started_) {
-    LOG(WARNING) << "Pno scan already started";
+  // Half of the match sets are kept for the highest priority networks, the
+  // other networks take turns in the rest.
+  size_t num_rotated_slots = max_match_sets - max_match_sets / 2;
+  size_t num_rotated_networks = num_networks - max_match_sets / 2;
+  return (num_rotated_networks + num_rotated_slots - 1) / num_rotated_slots;
+}
+
+vector<const PnoNetwork*> ScannerImpl::GetPnoShard(
+    const PnoSettings& pno_settings,
+    size_t shard) const {
+  vector<const PnoNetwork*> networks;
+  networks.reserve(pno_settings.pno_networks_.size());
+  for (const PnoNetwork& network : pno_settings.pno_networks_) {
+    networks.push_back(&network);
+  }
+  // Networks of the same priority keep the order of |pno_settings|.
+  std::stable_sort(networks.begin(), networks.end(), HasHigherPnoPriority);
+  size_t num_shards = GetNumPnoShards(pno_settings);
+  if (num_shards == 1) {
+    // ParsePnoSettings() leaves out what does not fit in firmware.
+    return networks;
+  }
+  size_t max_match_sets = scan_capabilities_.max_match_sets;
+  size_t num_pinned_networks = max_match_sets / 2;
+  size_t num_rotated_slots = max_match_sets - num_pinned_networks;
+  size_t num_rotated_networks = networks.size() - num_pinned_networks;
+  vector<const PnoNetwork*> shard_networks(
+      networks.begin(), networks.begin() + num_pinned_networks);
+  // The last shard wraps around to stay full.
+  size_t first_rotated = (shard % num_shards) * num_rotated_slots;
+  for (size_t i = 0; i < num_rotated_slots; i++) {
+    shard_networks.push_back(
+        networks[num_pinned_networks +
+                 (first_rotated + i) % num_rotated_networks]);
   }
+  return shard_networks;
+}
+
+void ScannerImpl::BuildPnoScanRequest(const PnoSettings& pno_settings,
+                                      size_t shard,
+                                      PnoScanRequest* request) {
   // An empty ssid for a wild card scan.
-  vector<vector<uint8_t>> scan_ssids = {{}};
-  vector<vector<uint8_t>> match_ssids;
+  request->scan_ssids = {{}};
+  request->match_ssids.clear();
   vector<uint8_t> unused;
   // Empty frequency list: scan all frequencies.
-  vector<uint32_t> freqs;
+  request->freqs.clear();
 
-  ParsePnoSettings(pno_settings, &scan_ssids, &match_ssids, &freqs, &unused);
+  ParsePnoSettings(GetPnoShard(pno_settings, shard), &request->scan_ssids,
+                   &request->match_ssids, &request->freqs, &unused);
+  request->interval_setting = GenerateIntervalSetting(pno_settings);
+  if (shard != 0) {
+    // Fast scans are only run for the first shard, the other shards join
+    // at the final interval.
+    request->interval_setting.plans.clear();
+  }
+  request->rssi_threshold_2g = pno_settings.min_2g_rssi_;
+  request->rssi_threshold_5g = pno_settings.min_5g_rssi_;
+  request->rssi_threshold_6g = pno_settings.min_6g_rssi_;
   // Only request MAC address randomization when station is not associated.
-  bool request_random_mac = wiphy_features_.supports_random_mac_sched_scan &&
+  request->req_flags.request_random_mac =
+      wiphy_features_.supports_random_mac_sched_scan &&
       !client_interface_->IsAssociated();
   // Always request a low power scan for PNO, if device supports it.
-  bool request_low_power = wiphy_features_.supports_low_power_oneshot_scan;
+  request->req_flags.request_low_power =
+      wiphy_features_.supports_low_power_oneshot_scan;
+  request->req_flags.request_sched_scan_relative_rssi =
+      wiphy_features_.supports_ext_sched_scan_relative_rssi;
+}
+
+bool ScannerImpl::IsSamePnoScanRequest(const PnoScanRequest& request,
+                                       const PnoScanRequest& other_request) {
+  const SchedScanIntervalSetting& interval = request.interval_setting;
+  const SchedScanIntervalSetting& other_interval =
+      other_request.interval_setting;
+  if (interval.final_interval_ms != other_interval.final_interval_ms ||
+      interval.plans.size() != other_interval.plans.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < interval.plans.size(); i++) {
+    if (interval.plans[i].interval_ms != other_interval.plans[i].interval_ms ||
+        interval.plans[i].n_iterations !=
+            other_interval.plans[i].n_iterations) {
+      return false;
+    }
+  }
+  const SchedScanReqFlags& flags = request.req_flags;
+  const SchedScanReqFlags& other_flags = other_request.req_flags;
+  if (request.rssi_threshold_2g != other_request.rssi_threshold_2g ||
+      request.rssi_threshold_5g != other_request.rssi_threshold_5g ||
+      request.rssi_threshold_6g != other_request.rssi_threshold_6g ||
+      flags.request_random_mac != other_flags.request_random_mac ||
+      flags.request_low_power != other_flags.request_low_power ||
+      flags.request_sched_scan_relative_rssi !=
+          other_flags.request_sched_scan_relative_rssi ||
+      request.freqs != other_request.freqs) {
+    return false;
+  }
+  // Kernel does not care about the order of SSIDs.
+  auto is_same_ssid_set = [](vector<vector<uint8_t>> ssids,
+                             vector<vector<uint8_t>> other_ssids) {
+    std::sort(ssids.begin(), ssids.end());
+    std::sort(other_ssids.begin(), other_ssids.end());
+    return ssids == other_ssids;
+  };
+  return is_same_ssid_set(request.scan_ssids, other_request.scan_ssids) &&
+         is_same_ssid_set(request.match_ssids, other_request.match_ssids);
+}
 
-  bool request_sched_scan_relative_rssi = wiphy_features_.supports_ext_sched_scan_relative_rssi;
+bool ScannerImpl::StartPnoScanDefault(const PnoSettings& pno_settings) {
+  if (!CheckIsValid()) {
+    return false;
+  }
+  if (pno_scan_started_) {
+    LOG(WARNING) << "Pno scan already started";
+  }
+  PnoScanRequest request;
+  BuildPnoScanRequest(pno_settings, 0, &request);
 
   int error_code = 0;
-  struct SchedScanReqFlags req_flags = {};
-  req_flags.request_random_mac = request_random_mac;
-  req_flags.request_low_power = request_low_power;
-  req_flags.request_sched_scan_relative_rssi = request_sched_scan_relative_rssi;
   if (!scan_utils_->StartScheduledScan(interface_index_,
-                                       GenerateIntervalSetting(pno_settings),
-                                       pno_settings.min_2g_rssi_,
-                                       pno_settings.min_5g_rssi_,
-                                       pno_settings.min_6g_rssi_,
-                                       req_flags,
-                                       scan_ssids,
-                                       match_ssids,
-                                       freqs,
+                                       request.interval_setting,
+                                       request.rssi_threshold_2g,
+                                       request.rssi_threshold_5g,
+                                       request.rssi_threshold_6g,
+                                       request.req_flags,
+                                       request.scan_ssids,
+                                       request.match_ssids,
+                                       request.freqs,
                                        &error_code)) {
     if (error_code == ENODEV) {
         nodev_counter_ ++;
@@ -296,21 +910,135 @@ bool ScannerImpl::StartPnoScanDefault(const PnoSettings& pno_settings) {
         << "Driver is in a bad state, restarting wificond";
     return false;
   }
-  string freq_string;
-  if (freqs.empty()) {
-    freq_string = "for all supported frequencies";
+  if (request.freqs.empty()) {
+    LOG(INFO) << "Pno scan started for all supported frequencies";
   } else {
-    freq_string = "for frequencies: ";
-    for (uint32_t f : freqs) {
-      freq_string += std::to_string(f) + ", ";
-    }
+    LOG(INFO) << "Pno scan started for frequencies: "
+              << LoggingUtils::FormatFrequencies(request.freqs);
   }
-  LOG(INFO) << "Pno scan started " << freq_string;
   nodev_counter_ = 0;
   pno_scan_started_ = true;
+  pno_scan_request_ = std::move(request);
+  pno_shard_index_ = 0;
+  SchedulePnoShardRotation();
   return true;
 }
 
+Status ScannerImpl::updatePnoScan(const PnoSettings& pno_settings,
+                                  bool* out_success) {
+  if (!pno_scan_started_) {
+    // Nothing to update.
+    return startPnoScan(pno_settings, out_success);
+  }
+  if (!CheckIsValid()) {
+    *out_success = false;
+    return Status::ok();
+  }
+  SetPnoSettings(pno_settings);
+  // Keep matching the shard in use, if networks are still rotated.
+  size_t shard = pno_shard_index_ % GetNumPnoShards(pno_settings);
+  PnoScanRequest request;
+  BuildPnoScanRequest(pno_settings, shard, &request);
+  if (IsSamePnoScanRequest(request, pno_scan_request_)) {
+    LOG(INFO) << "Pno scan is up to date";
+    // Rotation might have been turned on or off without changing the shard
+    // in use.
+    if (GetNumPnoShards(pno_settings) == 1) {
+      CancelPnoShardRotation();
+    } else if (pno_rotation_timer_ == EventLoop::kInvalidTimerId) {
+      SchedulePnoShardRotation();
+    }
+    *out_success = true;
+    return Status::ok();
+  }
+
+  int error_code = 0;
+  if (!scan_utils_->RestartScheduledScan(interface_index_,
+                                         request.interval_setting,
+                                         request.rssi_threshold_2g,
+                                         request.rssi_threshold_5g,
+                                         request.rssi_threshold_6g,
+                                         request.req_flags,
+                                         request.scan_ssids,
+                                         request.match_ssids,
+                                         request.freqs,
+                                         &error_code)) {
+    // The previous scheduled scan might have been stopped already.
+    LOG(ERROR) << "Failed to update pno scan";
+    pno_scan_started_ = false;
+    CancelPnoShardRotation();
+    *out_success = false;
+    return Status::ok();
+  }
+  LOG(INFO) << "Pno scan updated";
+  num_pending_restart_stops_++;
+  pno_scan_request_ = std::move(request);
+  pno_shard_index_ = shard;
+  SchedulePnoShardRotation();
+  *out_success = true;
+  return Status::ok();
+}
+
+void ScannerImpl::RotatePnoShard() {
+  if (!pno_scan_started_ || !CheckIsValid()) {
+    return;
+  }
+  size_t num_shards = GetNumPnoShards(pno_settings_);
+  size_t shard = (pno_shard_index_ + 1) % num_shards;
+  PnoScanRequest request;
+  BuildPnoScanRequest(pno_settings_, shard, &request);
+
+  int error_code = 0;
+  if (!scan_utils_->RestartScheduledScan(interface_index_,
+                                         request.interval_setting,
+                                         request.rssi_threshold_2g,
+                                         request.rssi_threshold_5g,
+                                         request.rssi_threshold_6g,
+                                         request.req_flags,
+                                         request.scan_ssids,
+                                         request.match_ssids,
+                                         request.freqs,
+                                         &error_code)) {
+    LOG(ERROR) << "Failed to rotate pno networks";
+    pno_scan_started_ = false;
+    if (pno_scan_event_handler_ != nullptr) {
+      NotifyPnoScanEvent(kPnoScanFailed);
+    }
+    return;
+  }
+  LOG(INFO) << "Pno networks rotated to shard " << shard + 1
+            << " of " << num_shards;
+  num_pending_restart_stops_++;
+  pno_scan_request_ = std::move(request);
+  pno_shard_index_ = shard;
+  SchedulePnoShardRotation();
+}
+
+void ScannerImpl::SchedulePnoShardRotation() {
+  CancelPnoShardRotation();
+  if (event_loop_ == nullptr || GetNumPnoShards(pno_settings_) == 1) {
+    return;
+  }
+  const SchedScanIntervalSetting& interval_setting =
+      pno_scan_request_.interval_setting;
+  // Rotating late only delays the next shard, so let the wakeup be
+  // coalesced with other ones for up to a scan interval.
+  pno_rotation_timer_ = event_loop_->PostCancelableDelayedTask(
+      [this]() {
+        pno_rotation_timer_ = EventLoop::kInvalidTimerId;
+        RotatePnoShard();
+      },
+      GetSchedScanDurationMs(interval_setting, kNumPnoScansPerShard),
+      interval_setting.final_interval_ms);
+}
+
+void ScannerImpl::CancelPnoShardRotation() {
+  if (pno_rotation_timer_ != EventLoop::kInvalidTimerId) {
+    event_loop_->CancelDelayedTask(pno_rotation_timer_);
+    pno_rotation_timer_ = EventLoop::kInvalidTimerId;
+  }
+}
+
 Status ScannerImpl::stopPnoScan(bool* out_success) {
   *out_success = StopPnoScanDefault();
   return Status::ok();
@@ -324,11 +1052,14 @@ bool ScannerImpl::StopPnoScanDefault() {
   if (!pno_scan_started_) {
     LOG(WARNING) << "No pno scan started";
   }
+  CancelPnoShardRotation();
   if (!scan_utils_->StopScheduledScan(interface_index_)) {
     return false;
   }
   LOG(INFO) << "Pno scan stopped";
   pno_scan_started_ = false;
+  // Stopped events still to come are ignored anyway.
+  num_pending_restart_stops_ = 0;
   return true;
 }
 
@@ -337,13 +1068,19 @@ Status ScannerImpl::abortScan() {
     return Status::ok();
   }
 
-  if (!scan_started_) {
+  if (!IsScanBusy()) {
     LOG(WARNING) << "Scan is not started. Ignore abort request";
     return Status::ok();
   }
-  if (!scan_utils_->AbortScan(interface_index_)) {
+  // Coalesced requests and sub-scans are aborted along with the scan in
+  // flight.
+  scan_scheduler_.Clear();
+  scan_arbiter_.PromoteFollowUpCallers();
+  pending_sub_scans_.clear();
+  if (scan_started_ && !scan_utils_->AbortScan(interface_index_)) {
     LOG(WARNING) << "Abort scan failed";
   }
+  AbortPeerSubScans();
   return Status::ok();
 }
 
@@ -365,6 +1102,103 @@ Status ScannerImpl::unsubscribeScanEvents() {
   return Status::ok();
 }
 
+Status ScannerImpl::registerExternalScanCallback(
+    const sp<IScanEvent>& callback) {
+  if (!CheckIsValid()) {
+    return Status::ok();
+  }
+  for (const auto& it : external_scan_callbacks_) {
+    if (IInterface::asBinder(callback) == IInterface::asBinder(it.callback)) {
+      LOG(WARNING) << "Ignore duplicate external scan callback registration";
+      return Status::ok();
+    }
+  }
+  external_scan_callbacks_.push_back(
+      {IPCThreadState::self()->getCallingUid(), callback});
+  return Status::ok();
+}
+
+Status ScannerImpl::unregisterExternalScanCallback(
+    const sp<IScanEvent>& callback) {
+  for (auto it = external_scan_callbacks_.begin();
+       it != external_scan_callbacks_.end();
+       it++) {
+    if (IInterface::asBinder(callback) == IInterface::asBinder(it->callback)) {
+      external_scan_callbacks_.erase(it);
+      return Status::ok();
+    }
+  }
+  LOG(WARNING) << "Failed to find registered external scan callback"
+               << " to unregister";
+  return Status::ok();
+}
+
+Status ScannerImpl::watchBsses(const BssWatchSettings& settings,
+                               const sp<IBssWatchCallback>& callback,
+                               bool* out_success) {
+  *out_success = false;
+  if (!CheckIsValid()) {
+    return Status::ok();
+  }
+  BssWatchList watch_list;
+  if (!watch_list.Set(settings)) {
+    LOG(ERROR) << "Invalid BSS watch settings";
+    return Status::ok();
+  }
+  auto it = std::find_if(
+      bss_watches_.begin(), bss_watches_.end(),
+      [&callback](const BssWatch& watch) {
+        return IInterface::asBinder(watch.callback) ==
+            IInterface::asBinder(callback);
+      });
+  if (it == bss_watches_.end()) {
+    bss_watches_.push_back({callback, BssWatchList()});
+    it = bss_watches_.end() - 1;
+  }
+  it->watch_list = std::move(watch_list);
+  UpdateBssWatches(&*it);
+  *out_success = true;
+  return Status::ok();
+}
+
+Status ScannerImpl::unwatchBsses(const sp<IBssWatchCallback>& callback) {
+  for (auto it = bss_watches_.begin(); it != bss_watches_.end(); it++) {
+    if (IInterface::asBinder(callback) == IInterface::asBinder(it->callback)) {
+      bss_watches_.erase(it);
+      return Status::ok();
+    }
+  }
+  LOG(WARNING) << "Failed to find BSS watch to stop";
+  return Status::ok();
+}
+
+void ScannerImpl::UpdateBssWatches(BssWatch* watch) {
+  if (bss_watches_.empty()) {
+    return;
+  }
+  // Only the fields that every scan result has are needed.
+  vector<NativeScanResult> scan_results;
+  if (!scan_utils_->QueryScanResults(interface_index_, ScanResultQuery(),
+                                     &scan_results)) {
+    LOG(ERROR) << "Failed to query scan results for BSS watches";
+    return;
+  }
+  for (BssWatch& it : bss_watches_) {
+    if (watch != nullptr && watch != &it) {
+      continue;
+    }
+    NativeScanResultsDelta changes;
+    if (!it.watch_list.Update(scan_results, &changes)) {
+      continue;
+    }
+    sp<IBssWatchCallback> callback = it.callback;
+    CallbackDispatcher::Dispatch(
+        callback_dispatcher_, IInterface::asBinder(callback).get(),
+        CallbackDispatcher::kNoCoalescing,
+        [callback, changes]() { callback->OnWatchedBssesChanged(changes); });
+  }
+}
+
 Status ScannerImpl::subscribePnoScanEvents(const sp<IPnoScanEvent>& handler) {
   if (!CheckIsValid()) {
     return Status::ok();
@@ -387,25 +1221,219 @@ Status ScannerImpl::unsubscribePnoScanEvents() {
 void ScannerImpl::OnScanResultsReady(uint32_t interface_index, bool aborted,
                                      vector<vector<uint8_t>>& ssids,
                                      vector<uint32_t>& frequencies) {
-  if (!scan_started_) {
+  ATRACE_CALL();
+  if (late_scan_end_pending_) {
+    LOG(INFO) << "Ignoring the end of a scan that was aborted before";
+    late_scan_end_pending_ = false;
+    return;
+  }
+  // Framework usually asks for the results right after it is notified.
+  // Fetch them now, so that they are served from the cache and the BSSs
+  // the scan found can be counted.
+  bool has_results =
+      !aborted && scan_utils_->UpdateScanResultCache(interface_index_);
+  CancelScanWatchdog();
+  if (has_results) {
+    UpdateBssWatches();
+  }
+  const bool own_scan = scan_started_;
+  // Set if this scan was a sub-scan of a split scan of a peer radio.
+  ScannerImpl* const peer_scan_owner = own_scan ? peer_scan_owner_ : nullptr;
+  peer_scan_owner_ = nullptr;
+  if (!own_scan) {
     LOG(INFO) << "Received external scan result notification from kernel.";
+    RecordScan(IWifiScannerImpl::SCAN_SOURCE_EXTERNAL,
+               IWifiScannerImpl::SCAN_TYPE_DEFAULT, frequencies, aborted, 0,
+               has_results);
+    if (has_results) {
+      // Nobody waits for the results of scans of other processes.
+      for (const auto& it : external_scan_callbacks_) {
+        NotifyScanEvent(it.callback, kScanResultReady, 0, true);
+      }
+    }
+  } else {
+    ATRACE_ASYNC_END(kSingleScanTraceName, interface_index_);
+    RecordScan(IWifiScannerImpl::SCAN_SOURCE_SINGLE,
+               scan_in_flight_.scan_type, scan_in_flight_.freqs, aborted,
+               systemTime(SYSTEM_TIME_MONOTONIC) - scan_start_time_,
+               has_results);
   }
   scan_started_ = false;
-  if (scan_event_handler_ != nullptr) {
+  if (aborted) {
+    scan_scheduler_.Clear();
+    scan_arbiter_.PromoteFollowUpCallers();
+    pending_sub_scans_.clear();
+    if (num_peer_sub_scans_ > 0) {
+      split_scan_failed_ = true;
+      AbortPeerSubScans();
+    }
+  }
+  if (!pending_sub_scans_.empty()) {
+    if (scan_event_handler_ != nullptr) {
+      ATRACE_NAME("IScanEvent::OnPartialScanResultReady");
+      NotifyScanEvent(scan_event_handler_, kPartialScanResultReady,
+                      sub_scan_bands_);
+    }
+    SubScanRequest sub_scan = std::move(pending_sub_scans_.front());
+    pending_sub_scans_.pop_front();
+    if (StartSingleScan(sub_scan.request)) {
+      sub_scan_bands_ = sub_scan.bands;
+      return;
+    }
+    LOG(WARNING) << "Failed to start the next sub-scan of a split scan";
+    pending_sub_scans_.clear();
+    scan_scheduler_.Clear();
+    scan_arbiter_.PromoteFollowUpCallers();
+    if (num_peer_sub_scans_ > 0) {
+      // Failure is reported once the peer radios are done.
+      split_scan_failed_ = true;
+      AbortPeerSubScans();
+      return;
+    }
+    if (scan_event_handler_ != nullptr) {
+      NotifyScanEvent(scan_event_handler_, kScanFailed);
+    }
+    NotifyWaitingCallers(scan_arbiter_.TakeWaitingCallers(), false);
+    return;
+  }
+  if (num_peer_sub_scans_ > 0) {
+    // Peer radios still scan the other bands of this split scan.
+    if (!aborted && scan_event_handler_ != nullptr) {
+      ATRACE_NAME("IScanEvent::OnPartialScanResultReady");
+      NotifyScanEvent(scan_event_handler_, kPartialScanResultReady,
+                      sub_scan_bands_);
+    }
+    return;
+  }
+  bool success = !aborted && !split_scan_failed_;
+  split_scan_failed_ = false;
+  FinishScan(own_scan, success, has_results, peer_scan_owner);
+}
+
+void ScannerImpl::FinishScan(bool own_scan, bool success, bool has_results,
+                             ScannerImpl* peer_scan_owner) {
+  if (own_scan && success && has_results) {
+    // Requests this scan covers are served by its results for a while.
+    scan_arbiter_.OnScanCompleted(scan_scheduler_.GetScanInFlight(),
+                                  systemTime(SYSTEM_TIME_MONOTONIC));
+  }
+  if (peer_scan_owner != nullptr) {
+    peer_scan_owner->OnPeerSubScanDone(peer_scan_bands_, success);
+  } else if (scan_event_handler_ != nullptr) {
     // TODO: Pass other parameters back once we find framework needs them.
-    if (aborted) {
+    if (!success) {
       LOG(WARNING) << "Scan aborted";
-      scan_event_handler_->OnScanFailed();
+      NotifyScanEvent(scan_event_handler_, kScanFailed);
     } else {
-      scan_event_handler_->OnScanResultReady();
+      ATRACE_NAME("IScanEvent::OnScanResultReady");
+      NotifyScanEvent(scan_event_handler_, kScanResultReady);
     }
   } else {
     LOG(WARNING) << "No scan event handler found.";
   }
+  // The results of this scan are sent to all the callers it served.
+  NotifyWaitingCallers(scan_arbiter_.TakeWaitingCallers(), success);
+
+  SingleScanRequest follow_up_scan;
+  if (scan_scheduler_.TakeFollowUpScan(&follow_up_scan)) {
+    LOG(INFO) << "Start follow-up scan for coalesced scan requests";
+    scan_arbiter_.PromoteFollowUpCallers();
+    if (StartSingleScan(follow_up_scan)) {
+      scan_scheduler_.OnScanStarted(follow_up_scan);
+    } else {
+      if (scan_event_handler_ != nullptr) {
+        NotifyScanEvent(scan_event_handler_, kScanFailed);
+      }
+      NotifyWaitingCallers(scan_arbiter_.TakeWaitingCallers(), false);
+    }
+  }
+}
+
+bool ScannerImpl::NotifyWaitingCallers(const vector<uid_t>& callers,
+                                       bool success) {
+  bool notified = false;
+  for (const auto& it : external_scan_callbacks_) {
+    if (std::find(callers.begin(), callers.end(), it.uid) == callers.end() ||
+        (scan_event_handler_ != nullptr &&
+         IInterface::asBinder(it.callback) ==
+             IInterface::asBinder(scan_event_handler_))) {
+      continue;
+    }
+    if (success) {
+      NotifyScanEvent(it.callback, kScanResultReady);
+    } else {
+      NotifyScanEvent(it.callback, kScanFailed);
+    }
+    notified = true;
+  }
+  return notified;
+}
+
+void ScannerImpl::NotifyScanEvent(const sp<IScanEvent>& listener,
+                                  ScanEventCallback callback,
+                                  int32_t bands,
+                                  bool deferrable) {
+  if (listener == nullptr) {
+    return;
+  }
+  // Partial results of different bands must all be reported.
+  int32_t coalescing_key = callback == kPartialScanResultReady
+      ? CallbackDispatcher::kNoCoalescing : callback;
+  CallbackDispatcher::Dispatch(
+      callback_dispatcher_, IInterface::asBinder(listener).get(),
+      coalescing_key, [listener, callback, bands]() {
+        switch (callback) {
+          case kScanResultReady:
+            listener->OnScanResultReady();
+            break;
+          case kScanFailed:
+            listener->OnScanFailed();
+            break;
+          case kPartialScanResultReady:
+            listener->OnPartialScanResultReady(bands);
+            break;
+          default:
+            break;
+        }
+      }, deferrable);
+}
+
+void ScannerImpl::NotifyPnoScanEvent(ScanEventCallback callback) {
+  if (pno_scan_event_handler_ == nullptr) {
+    return;
+  }
+  sp<IPnoScanEvent> listener = pno_scan_event_handler_;
+  CallbackDispatcher::Dispatch(
+      callback_dispatcher_, IInterface::asBinder(listener).get(), callback,
+      [listener, callback]() {
+        if (callback == kPnoNetworkFound) {
+          listener->OnPnoNetworkFound();
+        } else {
+          listener->OnPnoScanFailed();
+        }
+      });
 }
 
 void ScannerImpl::OnSchedScanResultsReady(uint32_t interface_index,
                                           bool scan_stopped) {
+  if (scan_stopped && num_pending_restart_stops_ > 0) {
+    // The scheduled scan was replaced by a new one.
+    num_pending_restart_stops_--;
+    return;
+  }
+  if (!scan_stopped) {
+    // Framework usually asks for the results right after it is notified.
+    // Fetch them now, so that getPnoScanResults() is served from the cache.
+    bool has_results = scan_utils_->UpdateScanResultCache(interface_index_);
+    if (!has_results) {
+      LOG(ERROR) << "Failed to get pno scan results via NL80211";
+    }
+    RecordScan(IWifiScannerImpl::SCAN_SOURCE_PNO,
+               pno_scan_request_.req_flags.request_low_power ?
+                   IWifiScannerImpl::SCAN_TYPE_LOW_POWER :
+                   IWifiScannerImpl::SCAN_TYPE_DEFAULT,
+               pno_scan_request_.freqs, false, 0, has_results);
+  }
   if (pno_scan_event_handler_ != nullptr) {
     if (scan_stopped) {
       // If |pno_scan_started_| is false.
@@ -413,13 +1441,124 @@ void ScannerImpl::OnSchedScanResultsReady(uint32_t interface_index,
       // See the document for NL80211_CMD_SCHED_SCAN_STOPPED in nl80211.h.
       if (pno_scan_started_) {
         LOG(WARNING) << "Unexpected pno scan stopped event";
-        pno_scan_event_handler_->OnPnoScanFailed();
+        NotifyPnoScanEvent(kPnoScanFailed);
       }
       pno_scan_started_ = false;
+      CancelPnoShardRotation();
     } else {
       LOG(INFO) << "Pno scan result ready event";
-      pno_scan_event_handler_->OnPnoNetworkFound();
+      NotifyPnoScanEvent(kPnoNetworkFound);
+    }
+  }
+}
+
+void ScannerImpl::RecordScan(int32_t source,
+                             int32_t scan_type,
+                             const vector<uint32_t>& freqs,
+                             bool aborted,
+                             nsecs_t latency,
+                             bool has_results) {
+  vector<uint32_t> all_freqs;
+  if (freqs.empty()) {
+    const BandInfo& band_info = client_interface_->GetBandInfo();
+    for (const vector<uint32_t>* band : {&band_info.band_2g,
+                                         &band_info.band_5g,
+                                         &band_info.band_dfs,
+                                         &band_info.band_6g}) {
+      all_freqs.insert(all_freqs.end(), band->begin(), band->end());
+    }
+  }
+  const vector<uint32_t>& scanned_freqs = freqs.empty() ? all_freqs : freqs;
+  int64_t latency_ms = ns2ms(latency);
+  for (int32_t band : {IWifiScannerImpl::SCAN_RESULT_BAND_2G,
+                       IWifiScannerImpl::SCAN_RESULT_BAND_5G,
+                       IWifiScannerImpl::SCAN_RESULT_BAND_6G}) {
+    int64_t num_channels = std::count_if(
+        scanned_freqs.begin(), scanned_freqs.end(),
+        [band](uint32_t freq) {
+          return ScanResultTable::GetBand(freq) == band;
+        });
+    if (num_channels == 0) {
+      continue;
+    }
+    NativeScanStats& stats =
+        scan_stats_[std::make_tuple(source, scan_type, band)];
+    stats.source_ = source;
+    stats.scan_type_ = scan_type;
+    stats.band_ = band;
+    stats.num_scans_++;
+    stats.num_channels_ += num_channels;
+    stats.total_latency_ms_ += latency_ms;
+    stats.max_latency_ms_ = std::max(stats.max_latency_ms_, latency_ms);
+    if (aborted) {
+      stats.num_aborted_scans_++;
+    } else if (has_results) {
+      stats.num_bss_ += scan_utils_->GetNumScanResults(interface_index_, band);
+    }
+  }
+}
+
+Status ScannerImpl::getScanStats(vector<NativeScanStats>* out_scan_stats) {
+  out_scan_stats->clear();
+  for (const auto& stats : scan_stats_) {
+    out_scan_stats->push_back(stats.second);
+  }
+  return Status::ok();
+}
+
+Status ScannerImpl::getChannelCongestion(
+    vector<NativeChannelCongestion>* out_channels) {
+  if (!CheckIsValid()) {
+    return Status::ok();
+  }
+  if (!scan_utils_->GetChannelCongestion(interface_index_, out_channels)) {
+    LOG(ERROR) << "Failed to get scan results via NL80211";
+  }
+  return Status::ok();
+}
+
+void ScannerImpl::DumpScanStats(std::stringstream* ss) const {
+  *ss << "Scan stats:" << std::endl;
+  *ss << "Stuck scans aborted: " << num_scan_timeouts_ << std::endl;
+  *ss << "Scan requests over quota: " << scan_arbiter_.GetNumThrottled()
+      << std::endl;
+  *ss << "Scan requests served by a recent scan: "
+      << scan_arbiter_.GetNumServedByRecentScan() << std::endl;
+  *ss << "Peer radios: " << peer_radios_.size()
+      << ", sub-scans run on them: " << num_peer_sub_scans_started_
+      << std::endl;
+  for (const auto& itr : scan_stats_) {
+    const NativeScanStats& stats = itr.second;
+    *ss << "source " << stats.source_
+        << ", type " << stats.scan_type_
+        << ", band " << stats.band_
+        << ": scans " << stats.num_scans_
+        << ", aborted " << stats.num_aborted_scans_
+        << ", channels " << stats.num_channels_
+        << ", bss " << stats.num_bss_;
+    if (stats.total_latency_ms_ > 0) {
+      *ss << ", latency average "
+          << stats.total_latency_ms_ / stats.num_scans_
+          << "ms, max " << stats.max_latency_ms_ << "ms";
     }
+    *ss << std::endl;
+  }
+}
+
+void ScannerImpl::OnEventsLost() {
+  // The end of an aborted scan may have been lost too.
+  late_scan_end_pending_ = false;
+  scan_utils_->InvalidateScanResultCache(interface_index_);
+  scan_arbiter_.ForgetRecentScan();
+  if (scan_started_) {
+    LOG(WARNING) << "Scan events lost, report pending scan as completed";
+    vector<vector<uint8_t>> ssids;
+    vector<uint32_t> frequencies;
+    OnScanResultsReady(interface_index_, false, ssids, frequencies);
+  }
+  if (pno_scan_started_ && pno_scan_event_handler_ != nullptr) {
+    LOG(WARNING) << "Scan events lost, report pno scan result ready";
+    NotifyPnoScanEvent(kPnoNetworkFound);
   }
 }
 
@@ -451,19 +1590,88 @@ SchedScanIntervalSetting ScannerImpl::GenerateIntervalSetting(
   }
 }
 
-void ScannerImpl::LogSsidList(vector<vector<uint8_t>>& ssid_list,
-                              string prefix) {
+void ScannerImpl::LogSsidList(const vector<vector<uint8_t>>& ssid_list,
+                              const char* prefix) {
   if (ssid_list.empty()) {
     return;
   }
-  string ssid_list_string;
-  for (auto& ssid : ssid_list) {
-    ssid_list_string += string(ssid.begin(), ssid.end());
-    if (&ssid != &ssid_list.back()) {
-      ssid_list_string += ", ";
+  LOG(WARNING) << prefix << ": " << LoggingUtils::FormatSsidList(ssid_list);
+}
+
+status_t ScannerImpl::onTransact(uint32_t code,
+                                 const Parcel& data,
+                                 Parcel* reply,
+                                 uint32_t flags) {
+  FlightRecorder::BinderCallScope call_record(FlightRecord::kScanner, code);
+  status_t status = BinderCallDispatcher::DispatchTransaction(
+      [this, code]() { return IsReadOnlyTransaction(code); },
+      [&]() {
+        if (code == TRANSACTION_getScanResults ||
+            code == TRANSACTION_getPnoScanResults) {
+          return WriteScanResults(data, reply,
+                                  code == TRANSACTION_getPnoScanResults);
+        }
+        return BnWifiScannerImpl::onTransact(code, data, reply, flags);
+      });
+  call_record.SetResult(status);
+  return status;
+}
+
+status_t ScannerImpl::WriteScanResults(const Parcel& data,
+                                       Parcel* reply,
+                                       bool pno_scan_results) {
+  ATRACE_CALL();
+  // Same checks and reply as the generated BnWifiScannerImpl code.
+  if (!data.checkInterface(this)) {
+    return ::android::BAD_TYPE;
+  }
+  // Read-only transactions run on binder threads concurrently, so each
+  // thread keeps a batch of its own.
+  thread_local ScanResultBatch batch;
+  batch.Clear();
+  if (CheckIsValid()) {
+    const SsidMatcher* ssids =
+        pno_scan_results ? GetPnoScanResultSsids() : nullptr;
+    bool success = ssids != nullptr ?
+        scan_utils_->GetScanResultBatch(interface_index_, *ssids, &batch) :
+        scan_utils_->GetScanResultBatch(interface_index_, &batch);
+    if (!success) {
+      LOG(ERROR) << "Failed to get scan results via NL80211";
     }
   }
-  LOG(WARNING) << prefix << ": " << ssid_list_string;
+  status_t status = Status::ok().writeToParcel(reply);
+  if (status != ::android::OK) {
+    return status;
+  }
+  return batch.WriteToParcel(reply);
+}
+
+const SsidMatcher* ScannerImpl::GetPnoScanResultSsids() const {
+  if (!pno_scan_started_ || pno_ssids_.empty()) {
+    return nullptr;
+  }
+  return &pno_ssids_;
+}
+
+void ScannerImpl::SetPnoSettings(const PnoSettings& pno_settings) {
+  pno_settings_ = pno_settings;
+  pno_ssids_ = SsidMatcher();
+  for (const PnoNetwork& network : pno_settings_.pno_networks_) {
+    pno_ssids_.Add(network.ssid_);
+  }
+}
+
+bool ScannerImpl::IsReadOnlyTransaction(uint32_t code) const {
+  switch (code) {
+    case TRANSACTION_getScanResults:
+    case TRANSACTION_getPnoScanResults:
+    case TRANSACTION_getScanResultsDelta:
+    case TRANSACTION_queryScanResults:
+      // Results are only fetched from kernel when the cache is stale.
+      return valid_ && scan_utils_->HasUpToDateScanResults(interface_index_);
+    default:
+      return false;
+  }
 }
 
 }  // namespace wificond
@@ -17,13 +17,27 @@
 #ifndef WIFICOND_SCANNER_IMPL_H_
 #define WIFICOND_SCANNER_IMPL_H_
 
+#include <deque>
+#include <map>
+#include <sstream>
+#include <tuple>
 #include <vector>
 
 #include <android-base/macros.h>
 #include <binder/Status.h>
+#include <utils/Timers.h>
 
 #include "android/net/wifi/nl80211/BnWifiScannerImpl.h"
+#include "wificond/callback_dispatcher.h"
+#include "wificond/event_loop.h"
 #include "wificond/net/netlink_utils.h"
+#include "wificond/scanning/bss_watch_list.h"
+#include "wificond/scanning/hidden_ssid_rotation.h"
+#include "wificond/scanning/network_matcher.h"
+#include "wificond/scanning/scan_arbiter.h"
+#include "wificond/scanning/scan_request_cache.h"
+#include "wificond/scanning/scan_request_scheduler.h"
+#include "wificond/scanning/scan_stats.h"
 #include "wificond/scanning/scan_utils.h"
 
 namespace android {
@@ -38,9 +52,12 @@ class ScannerImpl : public android::net::wifi::nl80211::BnWifiScannerImpl {
               const ScanCapabilities& scan_capabilities,
               const WiphyFeatures& wiphy_features,
               ClientInterfaceImpl* client_interface,
-              ScanUtils* scan_utils);
+              ScanUtils* scan_utils,
+              EventLoop* event_loop);
   ~ScannerImpl();
   // Get the latest single scan results from kernel.
+  // Binder transactions of this and getPnoScanResults() are served by
+  // WriteScanResults() instead.
   ::android::binder::Status getScanResults(
       std::vector<android::net::wifi::nl80211::NativeScanResult>*
           out_scan_results) override;
@@ -49,6 +66,25 @@ class ScannerImpl : public android::net::wifi::nl80211::BnWifiScannerImpl {
   ::android::binder::Status getPnoScanResults(
       std::vector<android::net::wifi::nl80211::NativeScanResult>*
           out_scan_results) override;
+  // Get the single scan results that changed since |generation|.
+  ::android::binder::Status getScanResultsDelta(
+      int64_t generation,
+      ::android::net::wifi::nl80211::NativeScanResultsDelta* out_delta)
+      override;
+  // Get the latest single scan results from kernel in shared memory.
+  ::android::binder::Status getScanResultsMemory(
+      ::android::os::ParcelFileDescriptor* out_memory) override;
+  // Get the latest single scan results matching |query|.
+  ::android::binder::Status queryScanResults(
+      const ::android::net::wifi::nl80211::ScanResultQuery& query,
+      std::vector<android::net::wifi::nl80211::NativeScanResult>*
+          out_scan_results) override;
+  // Scan requests that arrive while a scan is in flight are coalesced into
+  // one follow-up scan, which starts once the scan in flight is done.
+  // Requests that a scan done a moment ago covers are served with its
+  // results. Each caller uid has a quota of scans, see ScanArbiter.
+  // Split scans run one sub-scan per band, see
+  // |SingleScanSettings::enable_split_scan_|.
   ::android::binder::Status scan(
       const android::net::wifi::nl80211::SingleScanSettings&
           scan_settings,
@@ -56,31 +92,216 @@ class ScannerImpl : public android::net::wifi::nl80211::BnWifiScannerImpl {
   ::android::binder::Status startPnoScan(
       const android::net::wifi::nl80211::PnoSettings& pno_settings,
       bool* out_success) override;
+  // Keeps the running scheduled scan if |pno_settings| result in the same
+  // request to kernel.
+  ::android::binder::Status updatePnoScan(
+      const android::net::wifi::nl80211::PnoSettings& pno_settings,
+      bool* out_success) override;
   ::android::binder::Status stopPnoScan(bool* out_success) override;
   ::android::binder::Status abortScan() override;
+  ::android::binder::Status getScanStats(
+      std::vector<android::net::wifi::nl80211::NativeScanStats>*
+          out_scan_stats) override;
+  ::android::binder::Status getChannelCongestion(
+      std::vector<android::net::wifi::nl80211::NativeChannelCongestion>*
+          out_channels) override;
 
   ::android::binder::Status subscribeScanEvents(
       const ::android::sp<::android::net::wifi::nl80211::IScanEvent>& handler) override;
   ::android::binder::Status unsubscribeScanEvents() override;
+  ::android::binder::Status registerExternalScanCallback(
+      const ::android::sp<::android::net::wifi::nl80211::IScanEvent>&
+          callback) override;
+  ::android::binder::Status unregisterExternalScanCallback(
+      const ::android::sp<::android::net::wifi::nl80211::IScanEvent>&
+          callback) override;
+  ::android::binder::Status watchBsses(
+      const ::android::net::wifi::nl80211::BssWatchSettings& settings,
+      const ::android::sp<::android::net::wifi::nl80211::IBssWatchCallback>&
+          callback,
+      bool* out_success) override;
+  ::android::binder::Status unwatchBsses(
+      const ::android::sp<::android::net::wifi::nl80211::IBssWatchCallback>&
+          callback) override;
   ::android::binder::Status subscribePnoScanEvents(
       const ::android::sp<::android::net::wifi::nl80211::IPnoScanEvent>& handler)
       override;
   ::android::binder::Status unsubscribePnoScanEvents() override;
+  // Runs the transaction through BinderCallDispatcher.
+  ::android::status_t onTransact(uint32_t code,
+                                 const ::android::Parcel& data,
+                                 ::android::Parcel* reply,
+                                 uint32_t flags) override;
   void Invalidate();
+  // Scan events might have been lost. Reports pending scans as completed, so
+  // that the framework fetches the latest results from kernel instead of
+  // waiting for a notification that never comes.
+  void OnEventsLost();
+  // Appends the scan stats of this interface to |ss|.
+  void DumpScanStats(std::stringstream* ss) const;
+  // Calls the scan event callbacks through |dispatcher| instead of on the
+  // event loop thread. |dispatcher| must outlive this scanner.
+  void SetCallbackDispatcher(CallbackDispatcher* dispatcher) {
+    callback_dispatcher_ = dispatcher;
+  }
+  // Sets the scanners of client interfaces on the other radios of the
+  // device. Split scans run the sub-scans of some bands on an idle one of
+  // them in parallel, and the scan results of this interface include theirs.
+  // The peers must either outlive this scanner or be invalidated first.
+  void SetPeerRadios(const std::vector<ScannerImpl*>& peers);
 
  private:
   bool CheckIsValid();
+  // Serves getScanResults() and getPnoScanResults() transactions. Scan
+  // results are written to |reply| from a ScanResultBatch, instead of
+  // being copied into a vector of NativeScanResult first.
+  ::android::status_t WriteScanResults(const ::android::Parcel& data,
+                                       ::android::Parcel* reply,
+                                       bool pno_scan_results);
+  // Returns the SSIDs that PNO scan results are limited to, or nullptr if
+  // they are not limited.
+  const SsidMatcher* GetPnoScanResultSsids() const;
+  void SetPnoSettings(
+      const android::net::wifi::nl80211::PnoSettings& pno_settings);
+  // Returns whether transaction |code| only reads cached scan results, so
+  // that it can run outside of the event loop.
+  bool IsReadOnlyTransaction(uint32_t code) const;
+  // Gets the frequencies that networks of |ssids| were seen on before,
+  // skipping the wildcard SSID.
+  // Returns false if one of them was never seen.
+  bool GetChannelHints(const std::vector<std::vector<uint8_t>>& ssids,
+                       std::vector<uint32_t>* out_freqs) const;
+  // Fills |out_freqs| with the supported 2.4 and 5 GHz channels, and the
+  // 6 GHz channels that are Preferred Scanning Channels or that recent scan
+  // results report colocated APs on.
+  // Returns the number of 6 GHz channels.
+  size_t Plan6GhzScan(std::vector<uint32_t>* out_freqs) const;
+  // Triggers a single scan of |request|. Returns whether kernel accepted it.
+  bool StartSingleScan(const SingleScanRequest& request);
+  // Triggers the first sub-scan of |request| split by band. Some of the
+  // other ones are handed to an idle peer radio, the rest are triggered as
+  // the previous one is done.
+  bool StartSplitScan(const SingleScanRequest& request);
+  // Moves pending sub-scans to an idle peer radio, if there is one that
+  // supports their channels. They are balanced so that both radios scan
+  // about as many channels.
+  void StartPeerSubScans();
+  // Runs |sub_scan| of a split scan of |owner| on this radio.
+  // Returns whether kernel accepted it.
+  bool StartSubScanForPeer(const SubScanRequest& sub_scan, ScannerImpl* owner);
+  // Called by the peer radio that ran sub-scans of |bands| for the split
+  // scan of this radio.
+  void OnPeerSubScanDone(int32_t bands, bool success);
+  // Aborts the sub-scans that peer radios run for this radio.
+  void AbortPeerSubScans();
+  // Returns whether a scan of this radio, or a part of it on a peer radio,
+  // is in flight.
+  bool IsScanBusy() const;
+  // Returns whether this radio can run a sub-scan for a peer radio now.
+  bool IsIdleForPeerScan() const;
+  // Returns whether all of |freqs| are supported channels of this radio.
+  bool SupportsFrequencies(const std::vector<uint32_t>& freqs) const;
+  // Reports the end of the scan that was in flight to the subscriber of scan
+  // events, or to |peer_scan_owner| if the scan ran for that peer radio,
+  // and to the callers that waited for it. Then starts the follow-up scan.
+  void FinishScan(bool own_scan, bool success, bool has_results,
+                  ScannerImpl* peer_scan_owner);
+  // Notifies the external scan callbacks registered by |callers| of the end
+  // of the scan they waited for. The subscriber of scan events is not
+  // notified again. Returns whether any callback was notified.
+  bool NotifyWaitingCallers(const std::vector<uid_t>& callers, bool success);
+  struct BssWatch {
+    ::android::sp<::android::net::wifi::nl80211::IBssWatchCallback> callback;
+    BssWatchList watch_list;
+  };
+  // Compares the latest scan results with the BSS watch lists, and notifies
+  // the watchers of their changes. Only |watch| is updated if set.
+  void UpdateBssWatches(BssWatch* watch = nullptr);
+  // Scan event callbacks. These are also the coalescing keys of
+  // |callback_dispatcher_|.
+  enum ScanEventCallback : int32_t {
+    kScanResultReady,
+    kScanFailed,
+    kPartialScanResultReady,
+    kPnoNetworkFound,
+    kPnoScanFailed,
+  };
+  // Calls |callback| of |listener|. |bands| are the
+  // |IWifiScannerImpl::SCAN_RESULT_BAND_*| bits of kPartialScanResultReady.
+  // |deferrable| callbacks may be held back in low power mode.
+  void NotifyScanEvent(
+      const ::android::sp<::android::net::wifi::nl80211::IScanEvent>& listener,
+      ScanEventCallback callback,
+      int32_t bands = 0,
+      bool deferrable = false);
+  // Calls |callback| of |pno_scan_event_handler_|.
+  void NotifyPnoScanEvent(ScanEventCallback callback);
   void OnScanResultsReady(uint32_t interface_index, bool aborted,
                           std::vector<std::vector<uint8_t>>& ssids,
                           std::vector<uint32_t>& frequencies);
   void OnSchedScanResultsReady(uint32_t interface_index, bool scan_stopped);
-  void LogSsidList(std::vector<std::vector<uint8_t>>& ssid_list,
-                   std::string prefix);
+  // Adds a scan of |source| and |scan_type| on |freqs|, or on all supported
+  // channels if |freqs| is empty, to |scan_stats_|. |latency| is 0 if it is
+  // unknown. The BSS yield is only counted if |has_results|, i.e. if the
+  // cached scan results are up to date.
+  void RecordScan(int32_t source,
+                  int32_t scan_type,
+                  const std::vector<uint32_t>& freqs,
+                  bool aborted,
+                  nsecs_t latency,
+                  bool has_results);
+  void LogSsidList(const std::vector<std::vector<uint8_t>>& ssid_list,
+                   const char* prefix);
+  // Scheduled scan request of some PnoSettings, as it is sent to kernel.
+  struct PnoScanRequest {
+    SchedScanIntervalSetting interval_setting;
+    int32_t rssi_threshold_2g;
+    int32_t rssi_threshold_5g;
+    int32_t rssi_threshold_6g;
+    SchedScanReqFlags req_flags;
+    std::vector<std::vector<uint8_t>> scan_ssids;
+    std::vector<std::vector<uint8_t>> match_ssids;
+    std::vector<uint32_t> freqs;
+  };
+  // Builds the request matching the networks of |pno_settings| in |shard|.
+  void BuildPnoScanRequest(
+      const android::net::wifi::nl80211::PnoSettings& pno_settings,
+      size_t shard,
+      PnoScanRequest* request);
+  // Returns the number of shards that the networks of |pno_settings| take
+  // turns in. This is 1 unless network rotation is enabled and firmware can
+  // not match all networks at once.
+  size_t GetNumPnoShards(
+      const android::net::wifi::nl80211::PnoSettings& pno_settings) const;
+  // Returns the networks of |pno_settings| to match in |shard|, from the
+  // highest to the lowest priority.
+  std::vector<const android::net::wifi::nl80211::PnoNetwork*> GetPnoShard(
+      const android::net::wifi::nl80211::PnoSettings& pno_settings,
+      size_t shard) const;
+  // Arms the watchdog of the single scan of |request| that just started. If
+  // kernel doesn't report the end of the scan in time, the scan is aborted
+  // and reported as failed.
+  void StartScanWatchdog(const SingleScanRequest& request);
+  void CancelScanWatchdog();
+  void OnScanWatchdogTimeout();
+  // Returns how long a single scan of |request| may take before it is
+  // considered stuck.
+  int64_t GetScanTimeoutMs(const SingleScanRequest& request) const;
+  // Restarts the scheduled scan with the networks of the next shard.
+  void RotatePnoShard();
+  // (Re)arms the timer of RotatePnoShard() if there are shards to rotate.
+  void SchedulePnoShardRotation();
+  void CancelPnoShardRotation();
+  // Returns whether kernel would scan the same way for |request| and
+  // |other_request|, i.e. whether they only differ in the order of SSIDs.
+  static bool IsSamePnoScanRequest(const PnoScanRequest& request,
+                                   const PnoScanRequest& other_request);
   bool StartPnoScanDefault(
       const android::net::wifi::nl80211::PnoSettings& pno_settings);
   bool StopPnoScanDefault();
   void ParsePnoSettings(
-      const android::net::wifi::nl80211::PnoSettings& pno_settings,
+      const std::vector<const android::net::wifi::nl80211::PnoNetwork*>&
+          networks,
       std::vector<std::vector<uint8_t>>* scan_ssids,
       std::vector<std::vector<uint8_t>>* match_ssids,
       std::vector<uint32_t>* freqs, std::vector<uint8_t>* match_security);
@@ -92,6 +313,18 @@ class ScannerImpl : public android::net::wifi::nl80211::BnWifiScannerImpl {
   bool scan_started_;
   bool pno_scan_started_;
   android::net::wifi::nl80211::PnoSettings pno_settings_;
+  // SSIDs of the networks of |pno_settings_|. While a PNO scan runs, PNO
+  // scan results are limited to BSSs of these networks, like the match
+  // sets of the scheduled scan limit what kernel reports.
+  SsidMatcher pno_ssids_;
+  // Request of the running scheduled scan.
+  PnoScanRequest pno_scan_request_;
+  // Shard of PNO networks matched by the running scheduled scan.
+  size_t pno_shard_index_;
+  EventLoop::TimerId pno_rotation_timer_;
+  // Restarting a scheduled scan stops the previous one first, which kernel
+  // reports as a scheduled scan stopped event of its own.
+  uint32_t num_pending_restart_stops_;
 
   uint32_t nodev_counter_;
   const uint32_t interface_index_;
@@ -100,10 +333,61 @@ class ScannerImpl : public android::net::wifi::nl80211::BnWifiScannerImpl {
   ScanCapabilities scan_capabilities_;
   WiphyFeatures wiphy_features_;
 
+  // Single scan in flight and when it was triggered, for |scan_stats_|.
+  SingleScanRequest scan_in_flight_;
+  nsecs_t scan_start_time_;
+  EventLoop::TimerId scan_watchdog_timer_;
+  // Number of single scans that were aborted because they got stuck.
+  uint32_t num_scan_timeouts_;
+  // Set while kernel still owes the end of a scan that the watchdog aborted
+  // and already reported. That end must not end the scan that runs by then.
+  bool late_scan_end_pending_;
+  // Cost of the scans so far, keyed by scan source, scan type and band.
+  std::map<std::tuple<int32_t, int32_t, int32_t>,
+           android::net::wifi::nl80211::NativeScanStats> scan_stats_;
+
+  ScanRequestScheduler scan_scheduler_;
+  ScanArbiter scan_arbiter_;
+  // Trigger scan requests of the recent single scan settings.
+  ScanRequestCache scan_request_cache_;
+  // Hidden SSIDs that single scans probe for.
+  HiddenSsidRotation hidden_ssid_rotation_;
+  // Sub-scans of the split scan in flight that are still to run.
+  std::deque<SubScanRequest> pending_sub_scans_;
+  // |IWifiScannerImpl::SCAN_RESULT_BAND_*| bits of the sub-scan in flight.
+  int32_t sub_scan_bands_;
+  // Whether a part of the split scan in flight failed.
+  bool split_scan_failed_;
+  // Scanners of client interfaces on the other radios of the device.
+  std::vector<ScannerImpl*> peer_radios_;
+  // Number of sub-scans of the split scan in flight that peer radios run.
+  uint32_t num_peer_sub_scans_;
+  // Number of sub-scans that peer radios ran for this radio so far.
+  uint32_t num_peer_sub_scans_started_;
+  // Peer radio whose sub-scan is in flight on this radio, and its
+  // |IWifiScannerImpl::SCAN_RESULT_BAND_*| bits. Null otherwise.
+  ScannerImpl* peer_scan_owner_;
+  int32_t peer_scan_bands_;
+
   ClientInterfaceImpl* client_interface_;
   ScanUtils* const scan_utils_;
+  // Used to rotate PNO networks. Might be null, then networks are not
+  // rotated.
+  EventLoop* const event_loop_;
+  // Calls the scan event callbacks if set, otherwise they are called right
+  // away.
+  CallbackDispatcher* callback_dispatcher_;
   ::android::sp<::android::net::wifi::nl80211::IPnoScanEvent> pno_scan_event_handler_;
   ::android::sp<::android::net::wifi::nl80211::IScanEvent> scan_event_handler_;
+  struct ExternalScanCallback {
+    uid_t uid;
+    ::android::sp<::android::net::wifi::nl80211::IScanEvent> callback;
+  };
+  // Notified of scans that another process triggered, and of the scans
+  // that the uid which registered them waits for.
+  std::vector<ExternalScanCallback> external_scan_callbacks_;
+  // Notified of changes of the BSSs they watch after scan result updates.
+  std::vector<BssWatch> bss_watches_;
 
   DISALLOW_COPY_AND_ASSIGN(ScannerImpl);
 };
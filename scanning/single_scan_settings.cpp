@@ -28,6 +28,24 @@ namespace android {
 namespace net {
 namespace wifi {
 namespace nl80211 {
+
+namespace {
+
+// Reads a flag of the optional tail of the parcel. Framework versions that
+// predate a flag end the parcel before it, in which case it is false.
+status_t ReadOptionalFlag(const ::android::Parcel* parcel, bool* flag) {
+  *flag = false;
+  if (parcel->dataAvail() == 0) {
+    return ::android::OK;
+  }
+  int32_t value = 0;
+  RETURN_IF_FAILED(parcel->readInt32(&value));
+  *flag = (value != 0);
+  return ::android::OK;
+}
+
+}  // namespace
+
 bool SingleScanSettings::isValidScanType() const {
   return (scan_type_ == IWifiScannerImpl::SCAN_TYPE_LOW_SPAN ||
           scan_type_ == IWifiScannerImpl::SCAN_TYPE_LOW_POWER ||
@@ -54,6 +72,9 @@ status_t SingleScanSettings::writeToParcel(::android::Parcel* parcel) const {
     RETURN_IF_FAILED(parcel->writeInt32(1));
     RETURN_IF_FAILED(network.writeToParcel(parcel));
   }
+  RETURN_IF_FAILED(parcel->writeInt32(enable_split_scan_ ? 1 : 0));
+  RETURN_IF_FAILED(parcel->writeInt32(enable_channel_hints_ ? 1 : 0));
+  RETURN_IF_FAILED(parcel->writeInt32(enable_6ghz_rnr_planning_ ? 1 : 0));
   return ::android::OK;
 }
 
@@ -105,6 +126,9 @@ status_t SingleScanSettings::readFromParcel(const ::android::Parcel* parcel) {
     RETURN_IF_FAILED(network.readFromParcel(parcel));
     hidden_networks_.push_back(network);
   }
+  RETURN_IF_FAILED(ReadOptionalFlag(parcel, &enable_split_scan_));
+  RETURN_IF_FAILED(ReadOptionalFlag(parcel, &enable_channel_hints_));
+  RETURN_IF_FAILED(ReadOptionalFlag(parcel, &enable_6ghz_rnr_planning_));
   return ::android::OK;
 }
 
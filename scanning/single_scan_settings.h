@@ -36,7 +36,10 @@ class SingleScanSettings : public ::android::Parcelable {
   bool operator==(const SingleScanSettings& rhs) const {
     return (scan_type_ == rhs.scan_type_ &&
             channel_settings_ == rhs.channel_settings_ &&
-            hidden_networks_ == rhs.hidden_networks_);
+            hidden_networks_ == rhs.hidden_networks_ &&
+            enable_split_scan_ == rhs.enable_split_scan_ &&
+            enable_channel_hints_ == rhs.enable_channel_hints_ &&
+            enable_6ghz_rnr_planning_ == rhs.enable_6ghz_rnr_planning_);
   }
   ::android::status_t writeToParcel(::android::Parcel* parcel) const override;
   ::android::status_t readFromParcel(const ::android::Parcel* parcel) override;
@@ -44,6 +47,18 @@ class SingleScanSettings : public ::android::Parcelable {
   int32_t scan_type_;
   std::vector<ChannelSettings> channel_settings_;
   std::vector<HiddenNetwork> hidden_networks_;
+  // Scans one band after the other instead of all of them at once, and
+  // reports the results of each band with
+  // IScanEvent::OnPartialScanResultReady().
+  bool enable_split_scan_ = false;
+  // If |channel_settings_| is empty, only scans the channels that the
+  // hidden networks were seen on before, provided that all of them were.
+  bool enable_channel_hints_ = false;
+  // If |channel_settings_| is empty, only scans the 6 GHz channels that
+  // recent scan results advertise APs on in their Reduced Neighbor Report
+  // elements, and the Preferred Scanning Channels, instead of the whole
+  // 6 GHz band.
+  bool enable_6ghz_rnr_planning_ = false;
 
  private:
   bool isValidScanType() const;
@@ -16,30 +16,49 @@
 
 #include "wificond/server.h"
 
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+#include <cstring>
 #include <sstream>
 
-#include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/strings.h>
+#include <android-base/unique_fd.h>
 #include <binder/IPCThreadState.h>
+#include <binder/Parcel.h>
 #include <binder/PermissionCache.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
 
+#include "wificond/binder_call_dispatcher.h"
+#include "wificond/dump_writer.h"
+#include "wificond/flight_recorder.h"
 #include "wificond/logging_utils.h"
 #include "wificond/net/netlink_utils.h"
 #include "wificond/scanning/scan_utils.h"
 
-using android::base::WriteStringToFd;
+using android::base::unique_fd;
 using android::binder::Status;
 using android::sp;
 using android::IBinder;
+using android::net::wifi::nl80211::BnWificond;
 using android::net::wifi::nl80211::IApInterface;
 using android::net::wifi::nl80211::IClientInterface;
 using android::net::wifi::nl80211::IInterfaceEventCallback;
+using android::net::wifi::nl80211::INl80211CommandCallback;
+using android::net::wifi::nl80211::IWificond;
 using android::net::wifi::nl80211::DeviceWiphyCapabilities;
+using android::net::wifi::nl80211::DeviceWiphyInfo;
 using android::wifi_system::InterfaceTool;
 
+using std::array;
 using std::endl;
 using std::placeholders::_1;
+using std::placeholders::_2;
+using std::placeholders::_3;
+using std::placeholders::_4;
 using std::string;
 using std::stringstream;
 using std::unique_ptr;
@@ -52,14 +71,64 @@ namespace {
 
 constexpr const char* kPermissionDump = "android.permission.DUMP";
 
+// Key of the events lost handler of the interface table. No interface has
+// index 0.
+constexpr uint32_t kInterfaceTableEventsLostKey = 0;
+
+// Gets the current MAC address of interface |if_name|. Unlike interface
+// creation, MAC address changes come with no nl80211 event.
+bool GetCurrentMacAddress(const string& if_name,
+                          array<uint8_t, ETH_ALEN>* out_mac_address) {
+  unique_fd sock(socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0));
+  if (sock.get() < 0) {
+    PLOG(ERROR) << "Failed to open socket";
+    return false;
+  }
+  struct ifreq ifr;
+  memset(&ifr, 0, sizeof(ifr));
+  strncpy(ifr.ifr_name, if_name.c_str(), IFNAMSIZ - 1);
+  if (ioctl(sock.get(), SIOCGIFHWADDR, &ifr) != 0) {
+    PLOG(WARNING) << "Failed to get mac address of " << if_name;
+    return false;
+  }
+  memcpy(out_mac_address->data(), ifr.ifr_hwaddr.sa_data, ETH_ALEN);
+  return true;
+}
+
+void FillDeviceWiphyCapabilities(const BandInfo& band_info,
+                                 DeviceWiphyCapabilities* capabilities) {
+  capabilities->is80211nSupported_  = band_info.is_80211n_supported;
+  capabilities->is80211acSupported_ = band_info.is_80211ac_supported;
+  capabilities->is80211axSupported_ = band_info.is_80211ax_supported;
+  capabilities->is160MhzSupported_ = band_info.is_160_mhz_supported;
+  capabilities->is80p80MhzSupported_ = band_info.is_80p80_mhz_supported;
+  capabilities->maxTxStreams_ = band_info.max_tx_streams;
+  capabilities->maxRxStreams_ = band_info.max_rx_streams;
+}
+
 }  // namespace
 
 Server::Server(unique_ptr<InterfaceTool> if_tool,
+               EventLoop* event_loop,
                NetlinkUtils* netlink_utils,
                ScanUtils* scan_utils)
     : if_tool_(std::move(if_tool)),
+      event_loop_(event_loop),
       netlink_utils_(netlink_utils),
-      scan_utils_(scan_utils) {
+      scan_utils_(scan_utils),
+      callback_dispatcher_(nullptr),
+      low_power_mode_(false),
+      wiphy_index_(0),
+      has_reg_domain_(false),
+      wiphy_cache_memory_("wiphy caches"),
+      nl80211_command_relay_(netlink_utils),
+      parcel_memory_("binder parcels"),
+      memory_budget_(0),
+      num_memory_trims_(0) {
+}
+
+bool Server::OpenWiphySnapshot(const string& path) {
+  return wiphy_snapshot_.Open(path);
 }
 
 Status Server::RegisterCallback(const sp<IInterfaceEventCallback>& callback) {
@@ -100,7 +169,9 @@ Status Server::createApInterface(const std::string& iface_name,
       interface.name,
       interface.index,
       netlink_utils_,
-      if_tool_.get()));
+      if_tool_.get(),
+      event_loop_));
+  ap_interface->SetCallbackDispatcher(callback_dispatcher_);
   *created_interface = ap_interface->GetBinder();
   BroadcastApInterfaceReady(ap_interface->GetBinder());
   ap_interfaces_[iface_name] = std::move(ap_interface);
@@ -116,6 +187,7 @@ Status Server::tearDownApInterface(const std::string& iface_name,
     BroadcastApInterfaceTornDown(iter->second->GetBinder());
     ap_interfaces_.erase(iter);
     *out_success = true;
+    InvalidateWiphyInfoCache();
   }
   return Status::ok();
 }
@@ -134,10 +206,14 @@ Status Server::createClientInterface(const std::string& iface_name,
       interface.mac_address,
       if_tool_.get(),
       netlink_utils_,
-      scan_utils_));
+      scan_utils_,
+      event_loop_));
+  client_interface->SetCallbackDispatcher(callback_dispatcher_);
+  client_interface->SetLowPowerMode(low_power_mode_);
   *created_interface = client_interface->GetBinder();
   BroadcastClientInterfaceReady(client_interface->GetBinder());
   client_interfaces_[iface_name] = std::move(client_interface);
+  UpdatePeerRadios();
 
   return Status::ok();
 }
@@ -149,7 +225,9 @@ Status Server::tearDownClientInterface(const std::string& iface_name,
   if (iter != client_interfaces_.end()) {
     BroadcastClientInterfaceTornDown(iter->second->GetBinder());
     client_interfaces_.erase(iter);
+    UpdatePeerRadios();
     *out_success = true;
+    InvalidateWiphyInfoCache();
   }
   return Status::ok();
 }
@@ -167,11 +245,53 @@ Status Server::tearDownInterfaces() {
 
   MarkDownAllInterfaces();
 
-  netlink_utils_->UnsubscribeRegDomainChange(wiphy_index_);
+  for (uint32_t wiphy_index : reg_domain_wiphys_) {
+    netlink_utils_->UnsubscribeRegDomainChange(wiphy_index);
+  }
+  reg_domain_wiphys_.clear();
+  InvalidateWiphyInfoCache();
+  // Without the subscription, the cached regulatory domain may go stale.
+  has_reg_domain_ = false;
+  // The driver may be reloaded with another firmware.
+  wiphy_snapshot_keys_.clear();
 
   return Status::ok();
 }
 
+Status Server::setLowPowerMode(bool enabled) {
+  low_power_mode_ = enabled;
+  if (callback_dispatcher_ != nullptr) {
+    callback_dispatcher_->SetLowPowerMode(enabled);
+  }
+  for (auto& it : client_interfaces_) {
+    it.second->SetLowPowerMode(enabled);
+  }
+  return Status::ok();
+}
+
+Status Server::onTrimMemory(int32_t level) {
+  size_t num_bytes = 0;
+  vector<MemoryAccount> accounts;
+  GetMemoryAccounts(&accounts);
+  for (const MemoryAccount& account : accounts) {
+    num_bytes += account.GetCurrent();
+  }
+  const bool over_budget = memory_budget_ > 0 && num_bytes > memory_budget_;
+  if (level < IWificond::TRIM_MEMORY_RUNNING_LOW && !over_budget) {
+    return Status::ok();
+  }
+  LOG(INFO) << "Trimming memory at level " << level << ", using "
+            << num_bytes << " bytes"
+            << (over_budget ? " over budget" : "");
+  netlink_utils_->TrimMemory();
+  if (level >= IWificond::TRIM_MEMORY_RUNNING_CRITICAL || over_budget) {
+    scan_utils_->TrimScanResultCache();
+    InvalidateWiphyInfoCache();
+  }
+  num_memory_trims_++;
+  return Status::ok();
+}
+
 Status Server::GetClientInterfaces(vector<sp<IBinder>>* out_client_interfaces) {
   vector<sp<android::IBinder>> client_interfaces_binder;
   for (auto& it : client_interfaces_) {
@@ -188,7 +308,7 @@ Status Server::GetApInterfaces(vector<sp<IBinder>>* out_ap_interfaces) {
   return binder::Status::ok();
 }
 
-status_t Server::dump(int fd, const Vector<String16>& /*args*/) {
+status_t Server::dump(int fd, const Vector<String16>& args) {
   if (!PermissionCache::checkCallingPermission(String16(kPermissionDump))) {
     IPCThreadState* ipc = android::IPCThreadState::self();
     LOG(ERROR) << "Caller (uid: " << ipc->getCallingUid()
@@ -196,64 +316,140 @@ status_t Server::dump(int fd, const Vector<String16>& /*args*/) {
     return PERMISSION_DENIED;
   }
 
-  stringstream ss;
-  ss << "Current wiphy index: " << wiphy_index_ << endl;
-  ss << "Cached interfaces list from kernel message: " << endl;
-  for (const auto& iface : interfaces_) {
-    ss << "Interface index: " << iface.index
-       << ", name: " << iface.name
-       << ", mac address: "
-       << LoggingUtils::GetMacString(iface.mac_address) << endl;
-  }
-
-  string country_code;
-  if (netlink_utils_->GetCountryCode(&country_code)) {
-    ss << "Current country code from kernel: " << country_code << endl;
-  } else {
-    ss << "Failed to get country code from kernel." << endl;
+  vector<string> sections;
+  for (const String16& arg : args) {
+    sections.emplace_back(String8(arg).c_str());
+  }
+  // Only cached state is dumped, kernel is never queried from here.
+  DumpWriter writer(fd, sections);
+  writer.WriteSection("interfaces", [this](stringstream* ss) {
+    *ss << "Current wiphy index: " << wiphy_index_ << endl;
+    *ss << "Cached interfaces list from kernel message: " << endl;
+    for (const auto& wiphy : wiphy_interfaces_) {
+      for (const auto& iface : wiphy.second.interfaces) {
+        *ss << "Wiphy index: " << wiphy.first
+            << ", interface index: " << iface.second.index
+            << ", name: " << iface.second.name
+            << ", mac address: "
+            << LoggingUtils::GetMacString(iface.second.mac_address) << endl;
+      }
+    }
+  });
+  writer.WriteSection("regdomain", [this](stringstream* ss) {
+    if (has_reg_domain_) {
+      *ss << "Current country code from kernel: " << reg_domain_.country_code
+          << ", with " << reg_domain_.rules.size() << " regulatory rules"
+          << endl;
+    } else {
+      *ss << "Country code not fetched from kernel yet." << endl;
+    }
+  });
+  writer.WriteSection("netlink-stats", [this](stringstream* ss) {
+    netlink_utils_->DumpCommandLatencies(ss);
+  });
+  writer.WriteSection("scan-cache", [this](stringstream* ss) {
+    scan_utils_->DumpScanResultCache(ss);
+  });
+  writer.WriteSection("memory", [this](stringstream* ss) {
+    size_t num_bytes = 0;
+    vector<MemoryAccount> accounts;
+    GetMemoryAccounts(&accounts);
+    for (const MemoryAccount& account : accounts) {
+      *ss << account.GetName() << ": " << account.GetCurrent()
+          << " bytes, peak " << account.GetPeak() << " bytes" << endl;
+      num_bytes += account.GetCurrent();
+    }
+    *ss << "Total: " << num_bytes << " bytes";
+    if (memory_budget_ > 0) {
+      *ss << ", budget " << memory_budget_ << " bytes";
+    }
+    *ss << endl << "Trimmed " << num_memory_trims_ << " times" << endl;
+  });
+  FlightRecorder* flight_recorder = FlightRecorder::GetInstance();
+  if (flight_recorder != nullptr) {
+    writer.WriteSection("flight-recorder", [flight_recorder](stringstream* ss) {
+      flight_recorder->DumpDecoded(ss);
+    });
+    writer.WriteSection("flight-recorder-raw",
+                        [flight_recorder](stringstream* ss) {
+                          flight_recorder->DumpRaw(ss);
+                        },
+                        true);
+  }
+  writer.WriteSection("event-loop", [this](stringstream* ss) {
+    event_loop_->Dump(ss);
+  });
+  if (callback_dispatcher_ != nullptr) {
+    writer.WriteSection("callbacks", [this](stringstream* ss) {
+      callback_dispatcher_->Dump(ss);
+    });
   }
-
   for (const auto& iface : client_interfaces_) {
-    iface.second->Dump(&ss);
+    writer.WriteSection("client-interfaces", [&iface](stringstream* ss) {
+      iface.second->Dump(ss);
+    });
   }
-
   for (const auto& iface : ap_interfaces_) {
-    iface.second->Dump(&ss);
+    writer.WriteSection("ap-interfaces", [&iface](stringstream* ss) {
+      iface.second->Dump(ss);
+    });
   }
 
-  if (!WriteStringToFd(ss.str(), fd)) {
-    PLOG(ERROR) << "Failed to dump state to fd " << fd;
+  if (!writer.Finish()) {
     return FAILED_TRANSACTION;
   }
-
   return OK;
 }
 
 void Server::MarkDownAllInterfaces() {
-  uint32_t wiphy_index;
-  vector<InterfaceInfo> interfaces;
-  if (netlink_utils_->GetWiphyIndex(&wiphy_index) &&
-      netlink_utils_->GetInterfaces(wiphy_index, &interfaces)) {
-    for (InterfaceInfo& interface : interfaces) {
-      if_tool_->SetUpState(interface.name.c_str(), false);
+  if (wiphy_interfaces_.empty()) {
+    uint32_t wiphy_index;
+    vector<InterfaceInfo> interfaces;
+    if (netlink_utils_->GetWiphyIndex(&wiphy_index) &&
+        netlink_utils_->GetInterfaces(wiphy_index, &interfaces)) {
+      for (InterfaceInfo& interface : interfaces) {
+        if_tool_->SetUpState(interface.name.c_str(), false);
+      }
+    }
+    return;
+  }
+  for (const auto& wiphy : wiphy_interfaces_) {
+    if (wiphy.second.synced) {
+      for (const auto& iface : wiphy.second.interfaces) {
+        if_tool_->SetUpState(iface.second.name.c_str(), false);
+      }
+      continue;
+    }
+    vector<InterfaceInfo> interfaces;
+    if (netlink_utils_->GetInterfaces(wiphy.first, &interfaces)) {
+      for (InterfaceInfo& interface : interfaces) {
+        if_tool_->SetUpState(interface.name.c_str(), false);
+      }
+    }
+  }
+}
+
+void Server::UpdatePeerRadios() {
+  for (auto& it : client_interfaces_) {
+    vector<ScannerImpl*> peers;
+    for (auto& peer : client_interfaces_) {
+      if (peer.second->GetWiphyIndex() != it.second->GetWiphyIndex()) {
+        peers.push_back(peer.second->GetScanner().get());
+      }
     }
+    it.second->GetScanner()->SetPeerRadios(peers);
   }
 }
 
 Status Server::getAvailable2gChannels(
     std::unique_ptr<vector<int32_t>>* out_frequencies) {
-  BandInfo band_info;
-  ScanCapabilities scan_capabilities_ignored;
-  WiphyFeatures wiphy_features_ignored;
-
-  if (!netlink_utils_->GetWiphyInfo(wiphy_index_, &band_info,
-                                    &scan_capabilities_ignored,
-                                    &wiphy_features_ignored)) {
-    LOG(ERROR) << "Failed to get wiphy info from kernel";
+  const WiphyInfo* wiphy_info = GetCachedWiphyInfo();
+  if (wiphy_info == nullptr) {
     out_frequencies->reset(nullptr);
     return Status::ok();
   }
 
+  const BandInfo& band_info = wiphy_info->band_info;
   out_frequencies->reset(
       new vector<int32_t>(band_info.band_2g.begin(), band_info.band_2g.end()));
   return Status::ok();
@@ -261,18 +457,13 @@ Status Server::getAvailable2gChannels(
 
 Status Server::getAvailable5gNonDFSChannels(
     std::unique_ptr<vector<int32_t>>* out_frequencies) {
-  BandInfo band_info;
-  ScanCapabilities scan_capabilities_ignored;
-  WiphyFeatures wiphy_features_ignored;
-
-  if (!netlink_utils_->GetWiphyInfo(wiphy_index_, &band_info,
-                                    &scan_capabilities_ignored,
-                                    &wiphy_features_ignored)) {
-    LOG(ERROR) << "Failed to get wiphy info from kernel";
+  const WiphyInfo* wiphy_info = GetCachedWiphyInfo();
+  if (wiphy_info == nullptr) {
     out_frequencies->reset(nullptr);
     return Status::ok();
   }
 
+  const BandInfo& band_info = wiphy_info->band_info;
   out_frequencies->reset(
       new vector<int32_t>(band_info.band_5g.begin(), band_info.band_5g.end()));
   return Status::ok();
@@ -280,18 +471,13 @@ Status Server::getAvailable5gNonDFSChannels(
 
 Status Server::getAvailableDFSChannels(
     std::unique_ptr<vector<int32_t>>* out_frequencies) {
-  BandInfo band_info;
-  ScanCapabilities scan_capabilities_ignored;
-  WiphyFeatures wiphy_features_ignored;
-
-  if (!netlink_utils_->GetWiphyInfo(wiphy_index_, &band_info,
-                                    &scan_capabilities_ignored,
-                                    &wiphy_features_ignored)) {
-    LOG(ERROR) << "Failed to get wiphy info from kernel";
+  const WiphyInfo* wiphy_info = GetCachedWiphyInfo();
+  if (wiphy_info == nullptr) {
     out_frequencies->reset(nullptr);
     return Status::ok();
   }
 
+  const BandInfo& band_info = wiphy_info->band_info;
   out_frequencies->reset(new vector<int32_t>(band_info.band_dfs.begin(),
                                              band_info.band_dfs.end()));
   return Status::ok();
@@ -299,18 +485,13 @@ Status Server::getAvailableDFSChannels(
 
 Status Server::getAvailable6gChannels(
     std::unique_ptr<vector<int32_t>>* out_frequencies) {
-  BandInfo band_info;
-  ScanCapabilities scan_capabilities_ignored;
-  WiphyFeatures wiphy_features_ignored;
-
-  if (!netlink_utils_->GetWiphyInfo(wiphy_index_, &band_info,
-                                    &scan_capabilities_ignored,
-                                    &wiphy_features_ignored)) {
-    LOG(ERROR) << "Failed to get wiphy info from kernel";
+  const WiphyInfo* wiphy_info = GetCachedWiphyInfo();
+  if (wiphy_info == nullptr) {
     out_frequencies->reset(nullptr);
     return Status::ok();
   }
 
+  const BandInfo& band_info = wiphy_info->band_info;
   out_frequencies->reset(
       new vector<int32_t>(band_info.band_6g.begin(), band_info.band_6g.end()));
   return Status::ok();
@@ -324,58 +505,198 @@ Status Server::getDeviceWiphyCapabilities(
     return Status::ok();
   }
 
-  BandInfo band_info;
-  ScanCapabilities scan_capabilities_ignored;
-  WiphyFeatures wiphy_features_ignored;
-
-  if (!netlink_utils_->GetWiphyInfo(wiphy_index_, &band_info,
-                                    &scan_capabilities_ignored,
-                                    &wiphy_features_ignored)) {
-    LOG(ERROR) << "Failed to get wiphy info from kernel";
+  const WiphyInfo* wiphy_info = GetCachedWiphyInfo();
+  if (wiphy_info == nullptr) {
     capabilities = nullptr;
     return Status::ok();
   }
+  const BandInfo& band_info = wiphy_info->band_info;
 
   capabilities->reset(new DeviceWiphyCapabilities());
+  FillDeviceWiphyCapabilities(band_info, capabilities->get());
+
+  return Status::ok();
+}
+
+Status Server::getDeviceWiphyInfo(
+    const std::string& iface_name,
+    std::unique_ptr<DeviceWiphyInfo>* out_wiphy_info) {
+  if (!RefreshWiphyIndex(iface_name)) {
+    out_wiphy_info->reset(nullptr);
+    return Status::ok();
+  }
+
+  const WiphyInfo* wiphy_info = GetCachedWiphyInfo();
+  if (wiphy_info == nullptr) {
+    out_wiphy_info->reset(nullptr);
+    return Status::ok();
+  }
+  const BandInfo& band_info = wiphy_info->band_info;
 
-  capabilities->get()->is80211nSupported_  = band_info.is_80211n_supported;
-  capabilities->get()->is80211acSupported_ = band_info.is_80211ac_supported;
-  capabilities->get()->is80211axSupported_ = band_info.is_80211ax_supported;
-  capabilities->get()->is160MhzSupported_ = band_info.is_160_mhz_supported;
-  capabilities->get()->is80p80MhzSupported_ = band_info.is_80p80_mhz_supported;
-  capabilities->get()->maxTxStreams_ = band_info.max_tx_streams;
-  capabilities->get()->maxRxStreams_ = band_info.max_rx_streams;
+  out_wiphy_info->reset(new DeviceWiphyInfo());
+  DeviceWiphyInfo* info = out_wiphy_info->get();
+  info->band2gChannels_.assign(band_info.band_2g.begin(),
+                               band_info.band_2g.end());
+  info->band5gNonDfsChannels_.assign(band_info.band_5g.begin(),
+                                     band_info.band_5g.end());
+  info->bandDfsChannels_.assign(band_info.band_dfs.begin(),
+                                band_info.band_dfs.end());
+  info->band6gChannels_.assign(band_info.band_6g.begin(),
+                               band_info.band_6g.end());
+  FillDeviceWiphyCapabilities(band_info, &info->capabilities_);
 
   return Status::ok();
 }
 
+Status Server::sendNl80211Command(
+    const string& iface_name,
+    int32_t command,
+    int32_t flags,
+    const vector<uint8_t>& attributes,
+    const sp<INl80211CommandCallback>& callback,
+    bool* out_success) {
+  *out_success = false;
+  if (callback == nullptr || command < 0 || command > UINT8_MAX) {
+    LOG(ERROR) << "Invalid nl80211 command " << command;
+    return Status::ok();
+  }
+  if (!RefreshWiphyIndex(iface_name) || !SyncInterfaces(wiphy_index_)) {
+    return Status::ok();
+  }
+  const InterfaceInfo* interface = FindInterface(wiphy_index_, iface_name);
+  if (interface == nullptr) {
+    LOG(ERROR) << "No interface " << iface_name << " to run command on";
+    return Status::ok();
+  }
+  uint16_t netlink_flags = 0;
+  if (flags & IWificond::NL80211_COMMAND_FLAG_DUMP) {
+    netlink_flags |= NLM_F_DUMP;
+  }
+  if (flags & IWificond::NL80211_COMMAND_FLAG_ACK) {
+    netlink_flags |= NLM_F_ACK;
+  }
+  *out_success = nl80211_command_relay_.SendCommand(
+      interface->index, static_cast<uint8_t>(command), netlink_flags,
+      attributes, systemTime(SYSTEM_TIME_MONOTONIC),
+      [this, callback](bool success, vector<uint8_t> replies) {
+        CallbackDispatcher::Dispatch(
+            callback_dispatcher_, IInterface::asBinder(callback).get(),
+            CallbackDispatcher::kNoCoalescing,
+            [callback, success, replies]() {
+              callback->OnCommandCompleted(success, replies);
+            });
+      });
+  return Status::ok();
+}
+
 bool Server::SetupInterface(const std::string& iface_name,
                             InterfaceInfo* interface) {
   if (!RefreshWiphyIndex(iface_name)) {
     return false;
   }
 
-  netlink_utils_->SubscribeRegDomainChange(
-          wiphy_index_,
-          std::bind(&Server::OnRegDomainChanged,
-          this,
-          _1));
+  if (reg_domain_wiphys_.insert(wiphy_index_).second) {
+    netlink_utils_->SubscribeRegDomainChange(
+            wiphy_index_,
+            std::bind(&Server::OnRegDomainChanged,
+            this,
+            _1));
+  }
+
+  // The firmware may have changed since the snapshot was taken.
+  string& wiphy_snapshot_key = wiphy_snapshot_keys_[wiphy_index_];
+  if (!WiphySnapshot::GetDeviceKey(iface_name, &wiphy_snapshot_key)) {
+    wiphy_snapshot_key.clear();
+  }
+  // Populate the wiphy info cache so that the channel and capability
+  // queries which typically follow interface setup don't hit the kernel.
+  GetCachedWiphyInfo();
 
-  interfaces_.clear();
-  if (!netlink_utils_->GetInterfaces(wiphy_index_, &interfaces_)) {
+  if (!SyncInterfaces(wiphy_index_)) {
+    return false;
+  }
+  InterfaceInfo* iface = FindInterface(wiphy_index_, iface_name);
+  if (iface == nullptr) {
+    // The event of an interface that was just created may still be queued.
+    wiphy_interfaces_[wiphy_index_].synced = false;
+    if (!SyncInterfaces(wiphy_index_)) {
+      return false;
+    }
+    iface = FindInterface(wiphy_index_, iface_name);
+  }
+  if (iface == nullptr) {
+    LOG(ERROR) << "No usable interface found";
+    return false;
+  }
+  GetCurrentMacAddress(iface_name, &iface->mac_address);
+  *interface = *iface;
+  return true;
+}
+
+bool Server::SyncInterfaces(uint32_t wiphy_index) {
+  const auto iter = wiphy_interfaces_.find(wiphy_index);
+  if (iter == wiphy_interfaces_.end()) {
+    // Subscribe before the dump, so that no change in between is missed.
+    netlink_utils_->SubscribeInterfaceEvent(
+        wiphy_index,
+        std::bind(&Server::OnInterfaceEvent, this, wiphy_index,
+                  _1, _2, _3, _4));
+    netlink_utils_->SubscribeEventsLost(
+        kInterfaceTableEventsLostKey,
+        std::bind(&Server::OnInterfaceEventsLost, this));
+  } else if (iter->second.synced) {
+    return true;
+  }
+  WiphyInterfaces& wiphy = wiphy_interfaces_[wiphy_index];
+
+  vector<InterfaceInfo> interfaces;
+  if (!netlink_utils_->GetInterfaces(wiphy_index, &interfaces)) {
     LOG(ERROR) << "Failed to get interfaces info from kernel";
     return false;
   }
+  wiphy.interfaces.clear();
+  for (auto& iface : interfaces) {
+    wiphy.interfaces[iface.index] = std::move(iface);
+  }
+  wiphy.synced = true;
+  return true;
+}
 
-  for (const auto& iface : interfaces_) {
-    if (iface.name == iface_name) {
-      *interface = iface;
-      return true;
+InterfaceInfo* Server::FindInterface(uint32_t wiphy_index,
+                                     const std::string& iface_name) {
+  for (auto& iface : wiphy_interfaces_[wiphy_index].interfaces) {
+    if (iface.second.name == iface_name) {
+      return &iface.second;
     }
   }
+  return nullptr;
+}
 
-  LOG(ERROR) << "No usable interface found";
-  return false;
+void Server::OnInterfaceEvent(uint32_t wiphy_index,
+                              InterfaceEvent event,
+                              uint32_t if_index,
+                              const std::string& if_name,
+                              const array<uint8_t, ETH_ALEN>& mac_address) {
+  WiphyInterfaces& wiphy = wiphy_interfaces_[wiphy_index];
+  if (!wiphy.synced) {
+    return;
+  }
+  if (event == NEW_INTERFACE) {
+    LOG(DEBUG) << "Interface " << if_name << " was created";
+    wiphy.interfaces[if_index] = InterfaceInfo(if_index, if_name, mac_address);
+  } else {
+    LOG(DEBUG) << "Interface " << if_name << " was deleted";
+    wiphy.interfaces.erase(if_index);
+  }
+  nl80211_command_relay_.Invalidate();
+}
+
+void Server::OnInterfaceEventsLost() {
+  // Dump the interfaces again when they are needed next.
+  for (auto& wiphy : wiphy_interfaces_) {
+    wiphy.second.synced = false;
+  }
+  nl80211_command_relay_.Invalidate();
 }
 
 bool Server::RefreshWiphyIndex(const std::string& iface_name) {
@@ -386,23 +707,124 @@ bool Server::RefreshWiphyIndex(const std::string& iface_name) {
   return true;
 }
 
+const WiphyInfo* Server::GetCachedWiphyInfo() {
+  const auto iter = wiphy_info_cache_.find(wiphy_index_);
+  if (iter != wiphy_info_cache_.end()) {
+    return &iter->second;
+  }
+  const auto key_iter = wiphy_snapshot_keys_.find(wiphy_index_);
+  const string wiphy_snapshot_key = key_iter == wiphy_snapshot_keys_.end() ?
+      string() : key_iter->second;
+  const WiphyInfo* snapshot = wiphy_snapshot_key.empty() ?
+      nullptr : wiphy_snapshot_.Get(wiphy_snapshot_key);
+  if (snapshot != nullptr) {
+    // The snapshot may have been taken in another regulatory domain.
+    const RegDomain* reg_domain = GetCachedRegDomain();
+    WiphyInfo wiphy_info = *snapshot;
+    if (reg_domain != nullptr && !reg_domain->rules.empty() &&
+        NetlinkUtils::ApplyRegDomain(*reg_domain, &wiphy_info.band_info)) {
+      WiphyInfo& cached_wiphy_info = wiphy_info_cache_[wiphy_index_] =
+          std::move(wiphy_info);
+      UpdateWiphyCacheMemory();
+      return &cached_wiphy_info;
+    }
+  }
+  WiphyInfo wiphy_info;
+  if (!netlink_utils_->GetWiphyInfo(wiphy_index_,
+                                    &wiphy_info.band_info,
+                                    &wiphy_info.scan_capabilities,
+                                    &wiphy_info.wiphy_features)) {
+    LOG(ERROR) << "Failed to get wiphy info from kernel";
+    return nullptr;
+  }
+  if (!wiphy_snapshot_key.empty()) {
+    wiphy_snapshot_.Put(wiphy_snapshot_key, wiphy_info);
+  }
+  WiphyInfo* cached_wiphy_info =
+      &(wiphy_info_cache_[wiphy_index_] = std::move(wiphy_info));
+  UpdateWiphyCacheMemory();
+  return cached_wiphy_info;
+}
+
+const RegDomain* Server::GetCachedRegDomain() {
+  if (!has_reg_domain_) {
+    if (!netlink_utils_->GetRegDomain(&reg_domain_)) {
+      LOG(ERROR) << "Failed to get regulatory domain from kernel";
+      return nullptr;
+    }
+    has_reg_domain_ = true;
+    UpdateWiphyCacheMemory();
+  }
+  return &reg_domain_;
+}
+
+void Server::InvalidateWiphyInfoCache() {
+  wiphy_info_cache_.clear();
+  nl80211_command_relay_.Invalidate();
+  UpdateWiphyCacheMemory();
+}
+
+void Server::UpdateWiphyCacheMemory() {
+  size_t num_bytes = reg_domain_.country_code.capacity() +
+      reg_domain_.rules.capacity() * sizeof(RegRule);
+  for (const auto& wiphy_info : wiphy_info_cache_) {
+    const BandInfo& band_info = wiphy_info.second.band_info;
+    num_bytes += sizeof(wiphy_info) +
+        (band_info.band_2g.capacity() + band_info.band_5g.capacity() +
+         band_info.band_dfs.capacity() + band_info.band_6g.capacity() +
+         band_info.band_disabled.capacity()) * sizeof(uint32_t);
+  }
+  wiphy_cache_memory_.Set(num_bytes);
+}
+
+void Server::GetMemoryAccounts(vector<MemoryAccount>* accounts) {
+  netlink_utils_->GetMemoryAccounts(accounts);
+  scan_utils_->GetMemoryAccounts(accounts);
+  accounts->push_back(wiphy_cache_memory_);
+  accounts->push_back(nl80211_command_relay_.GetMemoryAccount());
+  parcel_memory_.Set(Parcel::getGlobalAllocSize());
+  accounts->push_back(parcel_memory_);
+  if (FlightRecorder::GetInstance() != nullptr) {
+    size_t flight_recorder_size =
+        FlightRecorder::GetInstance()->GetMemoryUsage();
+    accounts->emplace_back("flight recorder", flight_recorder_size,
+                           flight_recorder_size);
+  }
+}
+
 void Server::OnRegDomainChanged(std::string& country_code) {
   if (country_code.empty()) {
     LOG(INFO) << "Regulatory domain changed";
   } else {
     LOG(INFO) << "Regulatory domain changed to country: " << country_code;
   }
+  // Change notifications don't carry the rules, so fetch them once and
+  // recompute the cached channel lists from them instead of dumping the
+  // whole wiphy again.
+  has_reg_domain_ = false;
+  const RegDomain* reg_domain = GetCachedRegDomain();
+  bool recomputed = reg_domain != nullptr && !reg_domain->rules.empty();
+  // Channels that the new rules enable need a new wiphy dump.
+  for (auto it = wiphy_info_cache_.begin();
+       recomputed && it != wiphy_info_cache_.end(); ++it) {
+    recomputed = NetlinkUtils::ApplyRegDomain(*reg_domain,
+                                              &it->second.band_info);
+  }
+  if (recomputed) {
+    nl80211_command_relay_.Invalidate();
+    UpdateWiphyCacheMemory();
+  } else {
+    InvalidateWiphyInfoCache();
+  }
   LogSupportedBands();
 }
 
 void Server::LogSupportedBands() {
-  BandInfo band_info;
-  ScanCapabilities scan_capabilities;
-  WiphyFeatures wiphy_features;
-  netlink_utils_->GetWiphyInfo(wiphy_index_,
-                               &band_info,
-                               &scan_capabilities,
-                               &wiphy_features);
+  const WiphyInfo* wiphy_info = GetCachedWiphyInfo();
+  if (wiphy_info == nullptr) {
+    return;
+  }
+  const BandInfo& band_info = wiphy_info->band_info;
 
   stringstream ss;
   for (unsigned int i = 0; i < band_info.band_2g.size(); i++) {
@@ -430,29 +852,73 @@ void Server::LogSupportedBands() {
 
 void Server::BroadcastClientInterfaceReady(
     sp<IClientInterface> network_interface) {
-  for (auto& it : interface_event_callbacks_) {
-    it->OnClientInterfaceReady(network_interface);
+  for (const auto& callback : interface_event_callbacks_) {
+    CallbackDispatcher::Dispatch(
+        callback_dispatcher_, IInterface::asBinder(callback).get(),
+        CallbackDispatcher::kNoCoalescing, [callback, network_interface]() {
+          callback->OnClientInterfaceReady(network_interface);
+        });
   }
 }
 
 void Server::BroadcastApInterfaceReady(
     sp<IApInterface> network_interface) {
-  for (auto& it : interface_event_callbacks_) {
-    it->OnApInterfaceReady(network_interface);
+  for (const auto& callback : interface_event_callbacks_) {
+    CallbackDispatcher::Dispatch(
+        callback_dispatcher_, IInterface::asBinder(callback).get(),
+        CallbackDispatcher::kNoCoalescing, [callback, network_interface]() {
+          callback->OnApInterfaceReady(network_interface);
+        });
   }
 }
 
 void Server::BroadcastClientInterfaceTornDown(
     sp<IClientInterface> network_interface) {
-  for (auto& it : interface_event_callbacks_) {
-    it->OnClientTorndownEvent(network_interface);
+  for (const auto& callback : interface_event_callbacks_) {
+    CallbackDispatcher::Dispatch(
+        callback_dispatcher_, IInterface::asBinder(callback).get(),
+        CallbackDispatcher::kNoCoalescing, [callback, network_interface]() {
+          callback->OnClientTorndownEvent(network_interface);
+        });
   }
 }
 
 void Server::BroadcastApInterfaceTornDown(
     sp<IApInterface> network_interface) {
-  for (auto& it : interface_event_callbacks_) {
-    it->OnApTorndownEvent(network_interface);
+  for (const auto& callback : interface_event_callbacks_) {
+    CallbackDispatcher::Dispatch(
+        callback_dispatcher_, IInterface::asBinder(callback).get(),
+        CallbackDispatcher::kNoCoalescing, [callback, network_interface]() {
+          callback->OnApTorndownEvent(network_interface);
+        });
+  }
+}
+
+status_t Server::onTransact(uint32_t code,
+                            const Parcel& data,
+                            Parcel* reply,
+                            uint32_t flags) {
+  FlightRecorder::BinderCallScope call_record(FlightRecord::kWificond, code);
+  status_t status = BinderCallDispatcher::DispatchTransaction(
+      [this, code]() { return IsReadOnlyTransaction(code); },
+      [&]() { return BnWificond::onTransact(code, data, reply, flags); });
+  call_record.SetResult(status);
+  return status;
+}
+
+bool Server::IsReadOnlyTransaction(uint32_t code) const {
+  switch (code) {
+    case TRANSACTION_GetClientInterfaces:
+    case TRANSACTION_GetApInterfaces:
+      return true;
+    case TRANSACTION_getAvailable2gChannels:
+    case TRANSACTION_getAvailable5gNonDFSChannels:
+    case TRANSACTION_getAvailableDFSChannels:
+    case TRANSACTION_getAvailable6gChannels:
+      // A cache miss queries kernel and fills |wiphy_info_cache_|.
+      return wiphy_info_cache_.find(wiphy_index_) != wiphy_info_cache_.end();
+    default:
+      return false;
   }
 }
 
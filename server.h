@@ -17,7 +17,10 @@
 #ifndef WIFICOND_SERVER_H_
 #define WIFICOND_SERVER_H_
 
+#include <array>
+#include <map>
 #include <memory>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -28,9 +31,16 @@
 #include "android/net/wifi/nl80211/IApInterface.h"
 #include "android/net/wifi/nl80211/IClientInterface.h"
 #include "android/net/wifi/nl80211/IInterfaceEventCallback.h"
+#include "android/net/wifi/nl80211/INl80211CommandCallback.h"
 
 #include "wificond/ap_interface_impl.h"
+#include "wificond/callback_dispatcher.h"
 #include "wificond/client_interface_impl.h"
+#include "wificond/event_loop.h"
+#include "wificond/memory_account.h"
+#include "wificond/net/netlink_utils.h"
+#include "wificond/net/wiphy_snapshot.h"
+#include "wificond/nl80211_command_relay.h"
 
 namespace android {
 namespace wificond {
@@ -39,15 +49,29 @@ class NL80211Packet;
 class NetlinkUtils;
 class ScanUtils;
 
-struct InterfaceInfo;
-
 class Server : public android::net::wifi::nl80211::BnWificond {
  public:
   Server(std::unique_ptr<wifi_system::InterfaceTool> if_tool,
+         EventLoop* event_loop,
          NetlinkUtils* netlink_utils,
          ScanUtils* scan_utils);
   ~Server() override = default;
 
+  // Keeps the wiphy snapshot in the file at |path|, so that it survives
+  // restarts. See WiphySnapshot::Open().
+  // Returns true on success.
+  bool OpenWiphySnapshot(const std::string& path);
+  // Calls the callbacks of the framework, those of the interfaces created
+  // from now on included, through |dispatcher| instead of on the event loop
+  // thread. |dispatcher| must outlive this server.
+  void SetCallbackDispatcher(CallbackDispatcher* dispatcher) {
+    callback_dispatcher_ = dispatcher;
+  }
+  // Sets the memory that the accounted caches and buffers should fit in, in
+  // bytes. Any memory pressure signal trims all of them while they exceed
+  // it. 0 means there is no budget.
+  void SetMemoryBudget(size_t bytes) { memory_budget_ = bytes; }
+
   android::binder::Status RegisterCallback(
       const android::sp<android::net::wifi::nl80211::IInterfaceEventCallback>&
           callback) override;
@@ -87,17 +111,43 @@ class Server : public android::net::wifi::nl80211::BnWificond {
 
   android::binder::Status tearDownInterfaces() override;
 
+  android::binder::Status setLowPowerMode(bool enabled) override;
+
+  android::binder::Status onTrimMemory(int32_t level) override;
+
   android::binder::Status GetClientInterfaces(
       std::vector<android::sp<android::IBinder>>* out_client_ifs) override;
   android::binder::Status GetApInterfaces(
       std::vector<android::sp<android::IBinder>>* out_ap_ifs) override;
   status_t dump(int fd, const Vector<String16>& args) override;
+  // Runs the transaction through BinderCallDispatcher.
+  status_t onTransact(uint32_t code,
+                      const Parcel& data,
+                      Parcel* reply,
+                      uint32_t flags) override;
 
   // Returns device wiphy capabilities for an interface
   android::binder::Status getDeviceWiphyCapabilities(
       const std::string& iface_name,
       ::std::unique_ptr<net::wifi::nl80211::DeviceWiphyCapabilities>* capabilities) override;
 
+  // Returns available channels and device wiphy capabilities for an interface
+  // in one call.
+  android::binder::Status getDeviceWiphyInfo(
+      const std::string& iface_name,
+      ::std::unique_ptr<net::wifi::nl80211::DeviceWiphyInfo>* out_wiphy_info) override;
+
+  // Runs a nl80211 command prebuilt by the caller through
+  // |nl80211_command_relay_|.
+  android::binder::Status sendNl80211Command(
+      const std::string& iface_name,
+      int32_t command,
+      int32_t flags,
+      const std::vector<uint8_t>& attributes,
+      const android::sp<android::net::wifi::nl80211::INl80211CommandCallback>&
+          callback,
+      bool* out_success) override;
+
  private:
   // Request interface information from kernel and setup local interface object.
   // This assumes that interface should be in STATION mode. Even if we setup
@@ -106,6 +156,40 @@ class Server : public android::net::wifi::nl80211::BnWificond {
   // Returns true on success, false otherwise.
   bool SetupInterface(const std::string& iface_name, InterfaceInfo* interface);
   bool RefreshWiphyIndex(const std::string& iface_num);
+  // Makes sure |wiphy_interfaces_| holds the interfaces of wiphy
+  // |wiphy_index|, dumping them from kernel only if they are not tracked yet.
+  // Returns true on success.
+  bool SyncInterfaces(uint32_t wiphy_index);
+  // Returns the interface of wiphy |wiphy_index| named |iface_name|, or
+  // nullptr if there is none.
+  InterfaceInfo* FindInterface(uint32_t wiphy_index,
+                               const std::string& iface_name);
+  void OnInterfaceEvent(uint32_t wiphy_index,
+                        InterfaceEvent event,
+                        uint32_t if_index,
+                        const std::string& if_name,
+                        const std::array<uint8_t, ETH_ALEN>& mac_address);
+  void OnInterfaceEventsLost();
+  // Returns the band, scan capability and feature information of wiphy
+  // |wiphy_index_|. This is served from |wiphy_info_cache_|, or else from
+  // |wiphy_snapshot_|, and only dumped from kernel when neither has it.
+  // Returns nullptr on failure.
+  const WiphyInfo* GetCachedWiphyInfo();
+  // Returns whether transaction |code| only reads cached state, so that it
+  // can run outside of the event loop.
+  bool IsReadOnlyTransaction(uint32_t code) const;
+  // Returns the regulatory domain, served from |reg_domain_| and only
+  // fetched from kernel on a cache miss.
+  // Returns nullptr on failure.
+  const RegDomain* GetCachedRegDomain();
+  // The cache is dropped when interfaces are torn down. A regulatory domain
+  // change only recomputes the channel lists of the cached wiphy info.
+  void InvalidateWiphyInfoCache();
+  // Updates |wiphy_cache_memory_| from |wiphy_info_cache_| and
+  // |reg_domain_|.
+  void UpdateWiphyCacheMemory();
+  // Collects the memory accounts of all subsystems.
+  void GetMemoryAccounts(std::vector<MemoryAccount>* accounts);
   void LogSupportedBands();
   void OnRegDomainChanged(std::string& country_code);
   void BroadcastClientInterfaceReady(
@@ -117,10 +201,17 @@ class Server : public android::net::wifi::nl80211::BnWificond {
   void BroadcastApInterfaceTornDown(
       android::sp<android::net::wifi::nl80211::IApInterface> network_interface);
   void MarkDownAllInterfaces();
+  // Lets the scanner of each client interface run split scans on, and merge
+  // the scan results of, the client interfaces on the other wiphys.
+  void UpdatePeerRadios();
 
   const std::unique_ptr<wifi_system::InterfaceTool> if_tool_;
+  EventLoop* const event_loop_;
   NetlinkUtils* const netlink_utils_;
   ScanUtils* const scan_utils_;
+  CallbackDispatcher* callback_dispatcher_;
+  // Whether the framework asked for the low power mode.
+  bool low_power_mode_;
 
   uint32_t wiphy_index_;
   std::map<std::string, std::unique_ptr<ApInterfaceImpl>> ap_interfaces_;
@@ -128,8 +219,41 @@ class Server : public android::net::wifi::nl80211::BnWificond {
   std::vector<android::sp<android::net::wifi::nl80211::IInterfaceEventCallback>>
       interface_event_callbacks_;
 
-  // Cached interface list from kernel.
-  std::vector<InterfaceInfo> interfaces_;
+  struct WiphyInterfaces {
+    // Interfaces of the wiphy, keyed by interface index.
+    // There are only a few interfaces, so names are looked up linearly.
+    std::map<uint32_t, InterfaceInfo> interfaces;
+    // |interfaces| is only valid if this is true.
+    bool synced = false;
+  };
+  // Interfaces of each wiphy that interfaces were set up on, keyed by wiphy
+  // index. Dumped from kernel once, then kept up to date from interface
+  // events.
+  std::map<uint32_t, WiphyInterfaces> wiphy_interfaces_;
+  // Wiphys subscribed to regulatory domain change notifications.
+  std::set<uint32_t> reg_domain_wiphys_;
+  // Cached wiphy information from kernel, keyed by wiphy index.
+  std::map<uint32_t, WiphyInfo> wiphy_info_cache_;
+  // Cached regulatory domain from kernel, kept up to date from regulatory
+  // domain change notifications. Valid if |has_reg_domain_| is true.
+  RegDomain reg_domain_;
+  bool has_reg_domain_;
+  // Snapshot of the wiphy info of the device, which outlives
+  // |wiphy_info_cache_|.
+  WiphySnapshot wiphy_snapshot_;
+  // Keys of the devices the interfaces were set up on, keyed by wiphy index.
+  std::map<uint32_t, std::string> wiphy_snapshot_keys_;
+  MemoryAccount wiphy_cache_memory_;
+  // Runs the nl80211 commands of sendNl80211Command(). Its replies are
+  // invalidated together with |wiphy_info_cache_|.
+  Nl80211CommandRelay nl80211_command_relay_;
+  // Sampled from libbinder, which owns the parcels, whenever memory usage
+  // is reported.
+  MemoryAccount parcel_memory_;
+  // See SetMemoryBudget().
+  size_t memory_budget_;
+  // Number of memory pressure signals that caches were trimmed on.
+  uint32_t num_memory_trims_;
 
   DISALLOW_COPY_AND_ASSIGN(Server);
 };
@@ -15,7 +15,9 @@
  */
 
 #include <array>
+#include <functional>
 #include <memory>
+#include <utility>
 #include <vector>
 
 #include <linux/if_ether.h>
@@ -25,23 +27,28 @@
 #include <wifi_system_test/mock_interface_tool.h>
 
 #include "wificond/logging_utils.h"
+#include "wificond/tests/fake_event_loop.h"
 #include "wificond/tests/mock_ap_interface_event_callback.h"
 #include "wificond/tests/mock_netlink_manager.h"
 #include "wificond/tests/mock_netlink_utils.h"
 
 #include "wificond/ap_interface_impl.h"
 
+using android::net::wifi::nl80211::IApInterface;
 using android::wifi_system::MockInterfaceTool;
 using android::net::wifi::nl80211::NativeWifiClient;
+using android::net::wifi::nl80211::NativeWifiClientStats;
 using std::array;
 using std::placeholders::_1;
 using std::placeholders::_2;
 using std::unique_ptr;
 using std::vector;
 using testing::NiceMock;
+using testing::DoAll;
 using testing::Invoke;
 using testing::Return;
 using testing::Sequence;
+using testing::SetArgPointee;
 using testing::StrEq;
 using testing::_;
 
@@ -68,6 +75,26 @@ void CaptureChannelSwitchEventHandler(
   *out_handler = handler;
 }
 
+void CaptureEventsLostHandler(
+    OnEventsLostHandler* out_handler,
+    uint32_t interface_index,
+    OnEventsLostHandler handler) {
+  *out_handler = handler;
+}
+
+NativeWifiClient CreateNativeWifiClient(
+    const array<uint8_t, ETH_ALEN>& mac_address) {
+  NativeWifiClient client;
+  client.mac_address_ = vector<uint8_t>(mac_address.begin(), mac_address.end());
+  return client;
+}
+
+StationStats CreateStationStats(const array<uint8_t, ETH_ALEN>& mac_address) {
+  StationStats station;
+  station.mac_address = mac_address;
+  return station;
+}
+
 class ApInterfaceImplTest : public ::testing::Test {
  protected:
   unique_ptr<NiceMock<MockInterfaceTool>> if_tool_{
@@ -76,6 +103,7 @@ class ApInterfaceImplTest : public ::testing::Test {
       new NiceMock<MockNetlinkManager>()};
   unique_ptr<NiceMock<MockNetlinkUtils>> netlink_utils_{
       new NiceMock<MockNetlinkUtils>(netlink_manager_.get())};
+  FakeEventLoop event_loop_;
 
   unique_ptr<ApInterfaceImpl> ap_interface_;
 
@@ -84,7 +112,8 @@ class ApInterfaceImplTest : public ::testing::Test {
         kTestInterfaceName,
         kTestInterfaceIndex,
         netlink_utils_.get(),
-        if_tool_.get()));
+        if_tool_.get(),
+        &event_loop_));
   }
 };  // class ApInterfaceImplTest
 
@@ -96,7 +125,7 @@ TEST_F(ApInterfaceImplTest, CallbackIsCalledOnConnectedClientsChanged) {
       .WillOnce(Invoke(bind(CaptureStationEventHandler, &handler, _1, _2)));
   ap_interface_.reset(new ApInterfaceImpl(
       kTestInterfaceName, kTestInterfaceIndex, netlink_utils_.get(),
-      if_tool_.get()));
+      if_tool_.get(), &event_loop_));
 
   auto binder = ap_interface_->GetBinder();
   sp<MockApInterfaceEventCallback> callback(new MockApInterfaceEventCallback());
@@ -118,7 +147,7 @@ TEST_F(ApInterfaceImplTest, CallbackIsCalledOnConnectedClientsChangedOnlyOnDiff)
       .WillOnce(Invoke(bind(CaptureStationEventHandler, &handler, _1, _2)));
   ap_interface_.reset(new ApInterfaceImpl(
       kTestInterfaceName, kTestInterfaceIndex, netlink_utils_.get(),
-      if_tool_.get()));
+      if_tool_.get(), &event_loop_));
 
   auto binder = ap_interface_->GetBinder();
   sp<MockApInterfaceEventCallback> callback(new MockApInterfaceEventCallback());
@@ -134,13 +163,161 @@ TEST_F(ApInterfaceImplTest, CallbackIsCalledOnConnectedClientsChangedOnlyOnDiff)
   handler(DEL_STATION, fake_mac_address_01);
 }
 
+TEST_F(ApInterfaceImplTest, ResyncsStationsWhenEventsAreLost) {
+  OnStationEventHandler station_handler;
+  OnEventsLostHandler events_lost_handler;
+  EXPECT_CALL(*netlink_utils_, SubscribeStationEvent(kTestInterfaceIndex, _))
+      .WillOnce(Invoke(bind(CaptureStationEventHandler,
+                            &station_handler, _1, _2)));
+  EXPECT_CALL(*netlink_utils_, SubscribeEventsLost(kTestInterfaceIndex, _))
+      .WillOnce(Invoke(bind(CaptureEventsLostHandler,
+                            &events_lost_handler, _1, _2)));
+  ap_interface_.reset(new ApInterfaceImpl(
+      kTestInterfaceName, kTestInterfaceIndex, netlink_utils_.get(),
+      if_tool_.get(), &event_loop_));
+
+  auto binder = ap_interface_->GetBinder();
+  sp<MockApInterfaceEventCallback> callback(new MockApInterfaceEventCallback());
+  bool out_success = false;
+  EXPECT_TRUE(binder->registerCallback(callback, &out_success).isOk());
+  EXPECT_TRUE(out_success);
+
+  EXPECT_CALL(*callback, onConnectedClientsChanged(
+      CreateNativeWifiClient(kFakeMacAddress01), true));
+  station_handler(NEW_STATION, kFakeMacAddress01);
+
+  // The disconnection of station 01 and the connection of station 02 were
+  // lost. Only those changes are reported.
+  vector<StationStats> station_list = {CreateStationStats(kFakeMacAddress02)};
+  EXPECT_CALL(*netlink_utils_, GetStationStatsList(kTestInterfaceIndex, _))
+      .WillOnce(DoAll(SetArgPointee<1>(station_list), Return(true)));
+  EXPECT_CALL(*callback, onConnectedClientsChanged(
+      CreateNativeWifiClient(kFakeMacAddress01), false));
+  EXPECT_CALL(*callback, onConnectedClientsChanged(
+      CreateNativeWifiClient(kFakeMacAddress02), true));
+  events_lost_handler();
+
+  // Nothing changed since the last resync.
+  EXPECT_CALL(*netlink_utils_, GetStationStatsList(kTestInterfaceIndex, _))
+      .WillOnce(DoAll(SetArgPointee<1>(station_list), Return(true)));
+  events_lost_handler();
+}
+
+TEST_F(ApInterfaceImplTest, CanGetConnectedClientStats) {
+  OnStationEventHandler station_handler;
+  EXPECT_CALL(*netlink_utils_, SubscribeStationEvent(kTestInterfaceIndex, _))
+      .WillOnce(Invoke(bind(CaptureStationEventHandler,
+                            &station_handler, _1, _2)));
+  ap_interface_.reset(new ApInterfaceImpl(
+      kTestInterfaceName, kTestInterfaceIndex, netlink_utils_.get(),
+      if_tool_.get(), &event_loop_));
+
+  auto binder = ap_interface_->GetBinder();
+  sp<MockApInterfaceEventCallback> callback(new MockApInterfaceEventCallback());
+  bool out_success = false;
+  EXPECT_TRUE(binder->registerCallback(callback, &out_success).isOk());
+  EXPECT_TRUE(out_success);
+  EXPECT_CALL(*callback, onConnectedClientsChanged(
+      CreateNativeWifiClient(kFakeMacAddress02), true));
+  station_handler(NEW_STATION, kFakeMacAddress02);
+
+  // Kernel reports the stations in any order. Station 01 connected without
+  // an event.
+  StationStats station_01 = CreateStationStats(kFakeMacAddress01);
+  station_01.rx_bytes = 100;
+  StationStats station_02 = CreateStationStats(kFakeMacAddress02);
+  station_02.tx_bytes = 200;
+  station_02.signal_dbm = -60;
+  vector<StationStats> station_list = {station_02, station_01};
+  EXPECT_CALL(*netlink_utils_, GetStationStatsList(kTestInterfaceIndex, _))
+      .WillOnce(DoAll(SetArgPointee<1>(station_list), Return(true)));
+  EXPECT_CALL(*callback, onConnectedClientsChanged(
+      CreateNativeWifiClient(kFakeMacAddress01), true));
+
+  vector<NativeWifiClientStats> client_stats;
+  EXPECT_TRUE(binder->getConnectedClientStats(&client_stats).isOk());
+  ASSERT_EQ(2u, client_stats.size());
+  EXPECT_EQ(vector<uint8_t>(kFakeMacAddress01.begin(), kFakeMacAddress01.end()),
+            client_stats[0].mac_address_);
+  EXPECT_EQ(100, client_stats[0].rx_bytes_);
+  EXPECT_EQ(vector<uint8_t>(kFakeMacAddress02.begin(), kFakeMacAddress02.end()),
+            client_stats[1].mac_address_);
+  EXPECT_EQ(200, client_stats[1].tx_bytes_);
+  EXPECT_EQ(-60, client_stats[1].signal_dbm_);
+}
+
+TEST_F(ApInterfaceImplTest, CoalescesStationChanges) {
+  OnStationEventHandler handler;
+  EXPECT_CALL(*netlink_utils_, SubscribeStationEvent(kTestInterfaceIndex, _))
+      .WillOnce(Invoke(bind(CaptureStationEventHandler, &handler, _1, _2)));
+  ap_interface_.reset(new ApInterfaceImpl(
+      kTestInterfaceName, kTestInterfaceIndex, netlink_utils_.get(),
+      if_tool_.get(), &event_loop_));
+
+  auto binder = ap_interface_->GetBinder();
+  sp<MockApInterfaceEventCallback> callback(new MockApInterfaceEventCallback());
+  bool out_success = false;
+  EXPECT_TRUE(binder->registerCallback(callback, &out_success).isOk());
+  EXPECT_TRUE(out_success);
+  EXPECT_TRUE(binder->setClientChangeCoalescingWindow(
+      500, &out_success).isOk());
+  EXPECT_TRUE(out_success);
+
+  EXPECT_CALL(*callback, onConnectedClientsChanged(_, _)).Times(0);
+  EXPECT_CALL(*callback, onConnectedClientsBatchChanged(_, _)).Times(0);
+  handler(NEW_STATION, kFakeMacAddress01);
+  handler(NEW_STATION, kFakeMacAddress02);
+  handler(DEL_STATION, kFakeMacAddress01);
+  testing::Mock::VerifyAndClearExpectations(callback.get());
+
+  // Station 01 came and left within the window, so only station 02 is
+  // reported.
+  EXPECT_CALL(*callback, onConnectedClientsBatchChanged(
+      vector<NativeWifiClient>{CreateNativeWifiClient(kFakeMacAddress02)},
+      vector<NativeWifiClient>()));
+  ASSERT_EQ(1u, event_loop_.GetNumDelayedTasks());
+  EXPECT_EQ(500, event_loop_.RunDelayedTask());
+}
+
+TEST_F(ApInterfaceImplTest, RejectsInvalidCoalescingWindow) {
+  auto binder = ap_interface_->GetBinder();
+  bool out_success = true;
+  EXPECT_TRUE(binder->setClientChangeCoalescingWindow(
+      -1, &out_success).isOk());
+  EXPECT_FALSE(out_success);
+  out_success = true;
+  EXPECT_TRUE(binder->setClientChangeCoalescingWindow(
+      IApInterface::MAX_CLIENT_CHANGE_COALESCING_WINDOW_MS + 1,
+      &out_success).isOk());
+  EXPECT_FALSE(out_success);
+}
+
+TEST_F(ApInterfaceImplTest, CanGetRankedChannels) {
+  ChannelSurvey busy_channel;
+  busy_channel.frequency = 2412;
+  busy_channel.active_time_ms = 1000;
+  busy_channel.busy_time_ms = 800;
+  ChannelSurvey quiet_channel;
+  quiet_channel.frequency = 5180;
+  quiet_channel.active_time_ms = 1000;
+  quiet_channel.busy_time_ms = 100;
+  vector<ChannelSurvey> surveys = {busy_channel, quiet_channel};
+  EXPECT_CALL(*netlink_utils_, GetChannelSurveys(kTestInterfaceIndex, _))
+      .WillOnce(DoAll(SetArgPointee<1>(surveys), Return(true)));
+
+  auto binder = ap_interface_->GetBinder();
+  vector<int32_t> frequencies;
+  EXPECT_TRUE(binder->getRankedChannels(&frequencies).isOk());
+  EXPECT_EQ((vector<int32_t>{5180, 2412}), frequencies);
+}
+
 TEST_F(ApInterfaceImplTest, CallbackIsCalledOnSoftApChannelSwitched) {
   OnChannelSwitchEventHandler handler;
   EXPECT_CALL(*netlink_utils_, SubscribeChannelSwitchEvent(kTestInterfaceIndex, _))
       .WillOnce(Invoke(bind(CaptureChannelSwitchEventHandler, &handler, _1, _2)));
   ap_interface_.reset(new ApInterfaceImpl(
       kTestInterfaceName, kTestInterfaceIndex, netlink_utils_.get(),
-      if_tool_.get()));
+      if_tool_.get(), &event_loop_));
 
   auto binder = ap_interface_->GetBinder();
   sp<MockApInterfaceEventCallback> callback(new MockApInterfaceEventCallback());
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <array>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "android/net/wifi/nl80211/IWifiScannerImpl.h"
+#include "wificond/associated_bss.h"
+
+using android::net::wifi::nl80211::IWifiScannerImpl;
+using std::array;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr nsecs_t kFakeStartTimeNs = 1000000000;
+constexpr nsecs_t kFakeMaxAgeNs = 100000000;
+constexpr uint32_t kFakeFrequency = 5180;
+const array<uint8_t, ETH_ALEN> kFakeBssid =
+    {{0x12, 0x34, 0x56, 0x78, 0xab, 0xcd}};
+const vector<uint8_t> kFakeSsid = {'G', 'o', 'o', 'g', 'l', 'e'};
+
+// A request that offers HT and VHT and picks WPA2-PSK.
+const vector<uint8_t> kFakeRequestIEs = {
+    // SSID element.
+    0x00, 0x06, 'G', 'o', 'o', 'g', 'l', 'e',
+    // HT Capabilities element.
+    0x2d, 0x1a,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00,
+    // VHT Capabilities element.
+    0xbf, 0x0c,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    // RSN element with CCMP and PSK.
+    0x30, 0x14, 0x01, 0x00,
+    0x00, 0x0f, 0xac, 0x04,
+    0x01, 0x00, 0x00, 0x0f, 0xac, 0x04,
+    0x01, 0x00, 0x00, 0x0f, 0xac, 0x02,
+    0x00, 0x00};
+
+// A response of an HT AP on a 40 MHz channel.
+const vector<uint8_t> kFakeResponseIEs = {
+    // HT Capabilities element.
+    0x2d, 0x1a,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00,
+    // HT Operation element with the secondary channel above.
+    0x3d, 0x16, 0x24, 0x05,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+
+}  // namespace
+
+TEST(AssociatedBssTest, DecodesAssociationIEs) {
+  AssociatedBss bss;
+  EXPECT_FALSE(bss.IsAssociated());
+  bss.OnAssociated(kFakeBssid, kFakeFrequency,
+                   kFakeRequestIEs, kFakeResponseIEs);
+
+  EXPECT_TRUE(bss.IsAssociated());
+  EXPECT_EQ(kFakeBssid, bss.GetBssid());
+  EXPECT_EQ(kFakeSsid, bss.GetSsid());
+  EXPECT_EQ(kFakeFrequency, bss.GetFrequency());
+  EXPECT_EQ(BW_40, bss.GetBandwidth());
+  EXPECT_EQ(IWifiScannerImpl::SCAN_RESULT_SECURITY_RSN |
+                IWifiScannerImpl::SCAN_RESULT_SECURITY_PSK,
+            bss.GetSecurity());
+  // The AP does not support VHT.
+  EXPECT_EQ(IWifiScannerImpl::SCAN_RESULT_WIFI_STANDARD_11N,
+            bss.GetWifiStandard());
+}
+
+TEST(AssociatedBssTest, KeepsUnknownFieldsWithoutIEs) {
+  AssociatedBss bss;
+  bss.OnAssociated(kFakeBssid, 0, {}, {});
+
+  EXPECT_TRUE(bss.IsAssociated());
+  EXPECT_TRUE(bss.GetSsid().empty());
+  EXPECT_EQ(0u, bss.GetFrequency());
+  EXPECT_EQ(BW_INVALID, bss.GetBandwidth());
+  EXPECT_EQ(0, bss.GetSecurity());
+  EXPECT_EQ(IWifiScannerImpl::SCAN_RESULT_WIFI_STANDARD_UNKNOWN,
+            bss.GetWifiStandard());
+}
+
+TEST(AssociatedBssTest, ServesStationInfoWithinMaxAge) {
+  AssociatedBss bss;
+  bss.OnAssociated(kFakeBssid, kFakeFrequency, {}, {});
+  StationInfo station_info;
+  EXPECT_FALSE(bss.GetStationInfo(kFakeStartTimeNs, kFakeMaxAgeNs,
+                                  &station_info));
+
+  bss.SetStationInfo(StationInfo(100, 5, 540, -60, 650), kFakeStartTimeNs);
+  ASSERT_TRUE(bss.GetStationInfo(kFakeStartTimeNs + kFakeMaxAgeNs - 1,
+                                 kFakeMaxAgeNs, &station_info));
+  EXPECT_EQ(100, station_info.station_tx_packets);
+  EXPECT_EQ(-60, station_info.current_rssi);
+  EXPECT_FALSE(bss.GetStationInfo(kFakeStartTimeNs + kFakeMaxAgeNs,
+                                  kFakeMaxAgeNs, &station_info));
+
+  // Station info of a previous BSS or channel is not served.
+  bss.SetStationInfo(StationInfo(100, 5, 540, -60, 650), kFakeStartTimeNs);
+  bss.OnChannelSwitch(5745, BW_80);
+  EXPECT_EQ(5745u, bss.GetFrequency());
+  EXPECT_EQ(BW_80, bss.GetBandwidth());
+  EXPECT_FALSE(bss.GetStationInfo(kFakeStartTimeNs, kFakeMaxAgeNs,
+                                  &station_info));
+  bss.SetStationInfo(StationInfo(100, 5, 540, -60, 650), kFakeStartTimeNs);
+  bss.OnAssociated(kFakeBssid, kFakeFrequency, {}, {});
+  EXPECT_FALSE(bss.GetStationInfo(kFakeStartTimeNs, kFakeMaxAgeNs,
+                                  &station_info));
+}
+
+TEST(AssociatedBssTest, UpdatesRssiOfStationInfo) {
+  AssociatedBss bss;
+  bss.OnAssociated(kFakeBssid, kFakeFrequency, {}, {});
+  bss.SetStationInfo(StationInfo(100, 5, 540, -60, 650), kFakeStartTimeNs);
+  bss.OnRssiChanged(-75);
+
+  StationInfo station_info;
+  ASSERT_TRUE(bss.GetStationInfo(kFakeStartTimeNs, kFakeMaxAgeNs,
+                                 &station_info));
+  EXPECT_EQ(-75, station_info.current_rssi);
+  EXPECT_EQ(100, station_info.station_tx_packets);
+  // The other fields are not refreshed, so the station info is not served
+  // for any longer.
+  EXPECT_FALSE(bss.GetStationInfo(kFakeStartTimeNs + kFakeMaxAgeNs,
+                                  kFakeMaxAgeNs, &station_info));
+}
+
+TEST(AssociatedBssTest, ForgetsBssOnDisassociation) {
+  AssociatedBss bss;
+  bss.OnAssociated(kFakeBssid, kFakeFrequency,
+                   kFakeRequestIEs, kFakeResponseIEs);
+  bss.SetStationInfo(StationInfo(100, 5, 540, -60, 650), kFakeStartTimeNs);
+  bss.OnDisassociated();
+
+  EXPECT_FALSE(bss.IsAssociated());
+  EXPECT_EQ((array<uint8_t, ETH_ALEN>{}), bss.GetBssid());
+  EXPECT_TRUE(bss.GetSsid().empty());
+  EXPECT_EQ(0u, bss.GetFrequency());
+  StationInfo station_info;
+  EXPECT_FALSE(bss.GetStationInfo(kFakeStartTimeNs, kFakeMaxAgeNs,
+                                  &station_info));
+}
+
+}  // namespace wificond
+}  // namespace android
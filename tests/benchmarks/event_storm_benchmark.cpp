@@ -0,0 +1,365 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Synthetic nl80211 event storms, for sizing hotspots with many churning
+// clients and catching throughput regressions of the multicast event path.
+//
+// A producer thread floods a datagram socket with nl80211 multicast events
+// as fast as it can. wificond reads them on its event loop exactly like it
+// reads the asynchronous netlink socket. An event that does not fit in the
+// socket buffer is dropped, like kernel drops multicast events on overrun.
+// Reported counters:
+//   - events_per_second: handled events per second, at saturation.
+//   - dropped: events dropped per storm.
+//   - p50_us, p90_us, p99_us, max_us: latency from sending an event to
+//     running its handler.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <errno.h>
+#include <linux/if_ether.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <android-base/logging.h>
+#include <android-base/unique_fd.h>
+#include <benchmark/benchmark.h>
+#include <utils/Timers.h>
+
+#include "wificond/looper_backed_event_loop.h"
+#include "wificond/net/kernel-header-latest/nl80211.h"
+#include "wificond/net/netlink_manager.h"
+#include "wificond/net/nl80211_attribute.h"
+#include "wificond/net/nl80211_packet.h"
+
+using android::base::unique_fd;
+using std::array;
+using std::deque;
+using std::vector;
+
+namespace android {
+namespace wificond {
+namespace {
+
+constexpr uint16_t kFakeFamilyId = 14;
+constexpr uint32_t kFakeInterfaceIndex = 12;
+constexpr size_t kStormSize = 20000;
+// Number of distinct clients that churn in station storms.
+constexpr size_t kNumStations = 256;
+constexpr int kPollTimeoutMs = 10;
+
+// Types of event in a storm. Events of one type are handled in the order
+// they were sent, so their send times are matched in FIFO order.
+enum EventType {
+  kStationEvent,
+  kScanResultsEvent,
+  kChannelSwitchEvent,
+  kFrameTxStatusEvent,
+  kNumEventTypes,
+};
+
+// Mixes of events that a storm is made of.
+enum StormMix {
+  kStationChurn,
+  kBackToBackScanResults,
+  kChannelSwitches,
+  kFrameTxStatuses,
+  kAllEvents,
+};
+
+struct StormEvent {
+  EventType type;
+  vector<uint8_t> datagram;
+};
+
+// NetlinkManager that knows the nl80211 family without asking kernel, and
+// reads events from a socket of the load generator.
+class StormNetlinkManager : public NetlinkManager {
+ public:
+  explicit StormNetlinkManager(EventLoop* event_loop)
+      : NetlinkManager(event_loop) {}
+  ~StormNetlinkManager() override = default;
+
+  uint16_t GetFamilyId() override { return kFakeFamilyId; }
+
+  void ReceiveEvents(int fd) { ReceivePacketAndRunHandler(fd); }
+};
+
+// Send times of the events in flight, and latencies of the handled ones.
+class LatencyRecorder {
+ public:
+  // Records that an event of |type| is about to be sent.
+  void OnSending(EventType type) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    in_flight_[type].push_back(systemTime(SYSTEM_TIME_MONOTONIC));
+  }
+
+  // Forgets the last event of |type|, which could not be sent.
+  void OnDropped(EventType type) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    in_flight_[type].pop_back();
+    num_dropped_++;
+  }
+
+  void OnHandled(EventType type) {
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (in_flight_[type].empty()) {
+      LOG(ERROR) << "Handled an event that was not sent";
+      return;
+    }
+    latencies_.push_back(now - in_flight_[type].front());
+    in_flight_[type].pop_front();
+  }
+
+  size_t GetNumHandled() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return latencies_.size();
+  }
+
+  size_t GetNumDropped() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return num_dropped_;
+  }
+
+  // Returns the latency below which |percent| percent of the handled events
+  // are, in microseconds.
+  double GetPercentileMicros(double percent) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (latencies_.empty()) {
+      return 0;
+    }
+    size_t rank = std::min(
+        latencies_.size() - 1,
+        static_cast<size_t>(latencies_.size() * percent / 100));
+    std::nth_element(latencies_.begin(),
+                     latencies_.begin() + rank,
+                     latencies_.end());
+    return ns2us(latencies_[rank]);
+  }
+
+ private:
+  std::mutex mutex_;
+  deque<nsecs_t> in_flight_[kNumEventTypes];
+  vector<nsecs_t> latencies_;
+  size_t num_dropped_ = 0;
+};
+
+NL80211Packet CreateEvent(uint8_t command) {
+  NL80211Packet event(kFakeFamilyId, command, 0, 0);
+  event.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, kFakeInterfaceIndex));
+  return event;
+}
+
+StormEvent CreateStationEvent(size_t index) {
+  NL80211Packet event = CreateEvent(
+      (index / kNumStations) % 2 == 0 ? NL80211_CMD_NEW_STATION
+                                      : NL80211_CMD_DEL_STATION);
+  event.AddAttribute(NL80211Attr<array<uint8_t, ETH_ALEN>>(
+      NL80211_ATTR_MAC,
+      {0x02, 0x1a, 0x11, 0x00, 0x00,
+       static_cast<uint8_t>(index % kNumStations)}));
+  return {kStationEvent, event.GetConstData()};
+}
+
+StormEvent CreateScanResultsEvent() {
+  NL80211Packet event = CreateEvent(NL80211_CMD_NEW_SCAN_RESULTS);
+  NL80211NestedAttr ssids(NL80211_ATTR_SCAN_SSIDS);
+  ssids.AddAttribute(NL80211Attr<vector<uint8_t>>(0, {}));
+  event.AddAttribute(ssids);
+  NL80211NestedAttr freqs(NL80211_ATTR_SCAN_FREQUENCIES);
+  for (uint32_t i = 0; i < 25; i++) {
+    freqs.AddAttribute(NL80211Attr<uint32_t>(i, 5180 + 20 * i));
+  }
+  event.AddAttribute(freqs);
+  return {kScanResultsEvent, event.GetConstData()};
+}
+
+StormEvent CreateChannelSwitchEvent(size_t index) {
+  NL80211Packet event = CreateEvent(NL80211_CMD_CH_SWITCH_NOTIFY);
+  event.AddAttribute(NL80211Attr<uint32_t>(
+      NL80211_ATTR_WIPHY_FREQ, index % 2 == 0 ? 5180 : 5745));
+  event.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_CHANNEL_WIDTH, NL80211_CHAN_WIDTH_80));
+  return {kChannelSwitchEvent, event.GetConstData()};
+}
+
+StormEvent CreateFrameTxStatusEvent(size_t index) {
+  NL80211Packet event = CreateEvent(NL80211_CMD_FRAME_TX_STATUS);
+  event.AddAttribute(NL80211Attr<uint64_t>(NL80211_ATTR_COOKIE, index));
+  event.AddFlagAttribute(NL80211_ATTR_ACK);
+  return {kFrameTxStatusEvent, event.GetConstData()};
+}
+
+vector<StormEvent> CreateStorm(StormMix mix) {
+  vector<StormEvent> storm;
+  storm.reserve(kStormSize);
+  for (size_t i = 0; i < kStormSize; i++) {
+    EventType type;
+    switch (mix) {
+      case kStationChurn:
+        type = kStationEvent;
+        break;
+      case kBackToBackScanResults:
+        type = kScanResultsEvent;
+        break;
+      case kChannelSwitches:
+        type = kChannelSwitchEvent;
+        break;
+      case kFrameTxStatuses:
+        type = kFrameTxStatusEvent;
+        break;
+      default:
+        type = static_cast<EventType>(i % kNumEventTypes);
+        break;
+    }
+    switch (type) {
+      case kStationEvent:
+        storm.push_back(CreateStationEvent(i));
+        break;
+      case kScanResultsEvent:
+        storm.push_back(CreateScanResultsEvent());
+        break;
+      case kChannelSwitchEvent:
+        storm.push_back(CreateChannelSwitchEvent(i));
+        break;
+      default:
+        storm.push_back(CreateFrameTxStatusEvent(i));
+        break;
+    }
+  }
+  return storm;
+}
+
+void SubscribeAll(NetlinkManager* netlink_manager, LatencyRecorder* recorder) {
+  netlink_manager->SubscribeStationEvent(
+      kFakeInterfaceIndex,
+      [recorder](StationEvent, const array<uint8_t, ETH_ALEN>&) {
+        recorder->OnHandled(kStationEvent);
+      });
+  netlink_manager->SubscribeScanResultNotification(
+      kFakeInterfaceIndex,
+      [recorder](uint32_t, bool, vector<vector<uint8_t>>&, vector<uint32_t>&) {
+        recorder->OnHandled(kScanResultsEvent);
+      });
+  netlink_manager->SubscribeChannelSwitchEvent(
+      kFakeInterfaceIndex,
+      [recorder](uint32_t, ChannelBandwidth) {
+        recorder->OnHandled(kChannelSwitchEvent);
+      });
+  netlink_manager->SubscribeFrameTxStatusEvent(
+      kFakeInterfaceIndex,
+      [recorder](uint64_t, bool) {
+        recorder->OnHandled(kFrameTxStatusEvent);
+      });
+}
+
+// Sends all events of |storm| on |fd| without waiting, and counts the ones
+// that do not fit in the socket buffer as dropped.
+void SendStorm(int fd,
+               const vector<StormEvent>& storm,
+               LatencyRecorder* recorder) {
+  for (const StormEvent& event : storm) {
+    recorder->OnSending(event.type);
+    ssize_t sent = TEMP_FAILURE_RETRY(
+        send(fd, event.datagram.data(), event.datagram.size(), MSG_DONTWAIT));
+    if (sent < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        PLOG(ERROR) << "Failed to send synthetic event";
+      }
+      recorder->OnDropped(event.type);
+    }
+  }
+}
+
+}  // namespace
+
+// Arg 0 is a |StormMix|.
+static void BM_EventStorm(benchmark::State& state) {
+  const vector<StormEvent> storm =
+      CreateStorm(static_cast<StormMix>(state.range(0)));
+  LatencyRecorder recorder;
+
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                 0, fds) != 0) {
+    state.SkipWithError("Failed to create socket pair");
+    return;
+  }
+  unique_fd send_fd(fds[0]);
+  unique_fd receive_fd(fds[1]);
+  // Buffer as many events as the asynchronous netlink socket of wificond.
+  int buffer_size = NetlinkSocketConfig().async_receive_buffer_size;
+  setsockopt(send_fd.get(), SOL_SOCKET, SO_SNDBUF,
+             &buffer_size, sizeof(buffer_size));
+
+  LooperBackedEventLoop event_loop;
+  StormNetlinkManager netlink_manager(&event_loop);
+  // Events are dispatched through a strand, like on a real interface.
+  netlink_manager.CreateInterfaceStrand(kFakeInterfaceIndex);
+  SubscribeAll(&netlink_manager, &recorder);
+  event_loop.WatchFileDescriptor(
+      receive_fd.get(),
+      EventLoop::kModeInput,
+      [&netlink_manager](int fd) { netlink_manager.ReceiveEvents(fd); });
+
+  for (auto _ : state) {
+    size_t handled_before = recorder.GetNumHandled();
+    size_t dropped_before = recorder.GetNumDropped();
+    auto num_completed = [&]() {
+      return recorder.GetNumHandled() - handled_before +
+          recorder.GetNumDropped() - dropped_before;
+    };
+    std::atomic<bool> sent_all(false);
+    std::thread producer([&]() {
+      SendStorm(send_fd.get(), storm, &recorder);
+      sent_all = true;
+    });
+    while (!sent_all || num_completed() < storm.size()) {
+      event_loop.PollForOne(kPollTimeoutMs);
+    }
+    producer.join();
+  }
+  event_loop.StopWatchFileDescriptor(receive_fd.get());
+
+  size_t num_handled = recorder.GetNumHandled();
+  state.counters["events_per_second"] =
+      benchmark::Counter(num_handled, benchmark::Counter::kIsRate);
+  state.counters["dropped"] = benchmark::Counter(
+      recorder.GetNumDropped(), benchmark::Counter::kAvgIterations);
+  state.counters["p50_us"] = recorder.GetPercentileMicros(50);
+  state.counters["p90_us"] = recorder.GetPercentileMicros(90);
+  state.counters["p99_us"] = recorder.GetPercentileMicros(99);
+  state.counters["max_us"] = recorder.GetPercentileMicros(100);
+}
+BENCHMARK(BM_EventStorm)
+    ->Arg(kStationChurn)
+    ->Arg(kBackToBackScanResults)
+    ->Arg(kChannelSwitches)
+    ->Arg(kFrameTxStatuses)
+    ->Arg(kAllEvents)
+    ->UseRealTime();
+
+}  // namespace wificond
+}  // namespace android
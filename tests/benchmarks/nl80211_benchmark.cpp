@@ -0,0 +1,442 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <linux/if_ether.h>
+#include <unistd.h>
+
+#include <benchmark/benchmark.h>
+#include <binder/Parcel.h>
+
+#include "android/net/wifi/nl80211/IWifiScannerImpl.h"
+#include "wificond/net/kernel-header-latest/nl80211.h"
+#include "wificond/net/netlink_manager.h"
+#include "wificond/net/netlink_utils.h"
+#include "wificond/net/nl80211_attribute.h"
+#include "wificond/net/nl80211_packet.h"
+#include "wificond/net/nl80211_packet_view.h"
+#include "wificond/scanning/scan_result.h"
+#include "wificond/scanning/scan_result_batch.h"
+#include "wificond/scanning/scan_result_query.h"
+#include "wificond/scanning/scan_utils.h"
+
+using android::net::wifi::nl80211::IWifiScannerImpl;
+using android::net::wifi::nl80211::NativeScanResult;
+using android::net::wifi::nl80211::ScanResultQuery;
+using std::array;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace android {
+namespace wificond {
+namespace {
+
+constexpr uint16_t kFakeFamilyId = 14;
+constexpr uint32_t kFakeSequenceNumber = 1984;
+constexpr uint32_t kFakeInterfaceIndex = 12;
+constexpr uint32_t kFakeWiphyIndex = 0;
+constexpr uint32_t kFakeGeneration = 87;
+
+const uint8_t kHtMcsSet[] = {0xff, 0xff, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+                             0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0};
+const uint8_t kVhtMcsSet[] = {0xfa, 0xff, 0x0, 0x0, 0xfa, 0xff, 0x0, 0x0};
+const uint8_t kHeMcsSet[] = {0xfa, 0xff, 0xfa, 0xff};
+const uint8_t kVhtCap[] = {0x92, 0x71, 0x80, 0x33};
+const uint8_t kHeCapPhy[] = {0x0e, 0x20, 0x02, 0xc0, 0x0f, 0x43,
+                             0x95, 0x18, 0x00, 0xcc, 0x00};
+
+// NetlinkManager that answers every request with canned replies, without
+// any socket, so that the benchmarks only measure wificond's own code.
+class FakeNetlinkManager : public NetlinkManager {
+ public:
+  FakeNetlinkManager() : NetlinkManager(nullptr) {}
+  ~FakeNetlinkManager() override = default;
+
+  bool Start() override { return true; }
+  bool IsStarted() const override { return true; }
+  uint32_t GetSequenceNumber() override { return kFakeSequenceNumber; }
+  uint16_t GetFamilyId() override { return kFakeFamilyId; }
+
+  bool SendMessageAndGetResponses(
+      const NL80211Packet& packet,
+      vector<unique_ptr<const NL80211Packet>>* response) override {
+    for (const auto& reply : replies_) {
+      response->push_back(std::make_unique<NL80211Packet>(reply));
+    }
+    return true;
+  }
+
+  bool SendMessageAndStreamResponses(
+      const NL80211Packet& packet,
+      std::function<void(const NL80211PacketView&)> handler) override {
+    for (const auto& reply : replies_) {
+      handler(reply.GetView());
+    }
+    return true;
+  }
+
+  void SetReplies(vector<NL80211Packet> replies) {
+    replies_ = std::move(replies);
+  }
+
+ private:
+  vector<NL80211Packet> replies_;
+};
+
+void AppendElement(vector<uint8_t>* ie, uint8_t id, size_t length) {
+  ie->push_back(id);
+  ie->push_back(length);
+  for (size_t i = 0; i < length; i++) {
+    ie->push_back(static_cast<uint8_t>(id + i));
+  }
+}
+
+// Returns information elements laid out like the beacon of a typical
+// enterprise 802.11ax access point, about 300 bytes.
+vector<uint8_t> CreateInformationElements(const string& ssid) {
+  vector<uint8_t> ie = {0x00, static_cast<uint8_t>(ssid.size())};
+  ie.insert(ie.end(), ssid.begin(), ssid.end());
+  AppendElement(&ie, 1, 8);     // Supported rates
+  AppendElement(&ie, 3, 1);     // DS parameter set
+  AppendElement(&ie, 5, 4);     // TIM
+  AppendElement(&ie, 7, 6);     // Country
+  AppendElement(&ie, 11, 5);    // BSS load
+  AppendElement(&ie, 45, 26);   // HT capabilities
+  AppendElement(&ie, 48, 20);   // RSN
+  AppendElement(&ie, 50, 4);    // Extended supported rates
+  AppendElement(&ie, 61, 22);   // HT operation
+  AppendElement(&ie, 70, 5);    // RM enabled capabilities
+  AppendElement(&ie, 127, 10);  // Extended capabilities
+  AppendElement(&ie, 191, 12);  // VHT capabilities
+  AppendElement(&ie, 192, 5);   // VHT operation
+  AppendElement(&ie, 255, 27);  // HE capabilities
+  AppendElement(&ie, 255, 7);   // HE operation
+  AppendElement(&ie, 221, 24);  // WMM
+  AppendElement(&ie, 221, 28);  // Vendor specific
+  AppendElement(&ie, 221, 40);  // WPS
+  return ie;
+}
+
+NL80211Packet CreateScanResult(size_t index) {
+  static const uint32_t kFrequencies[] = {
+      2412, 2437, 2462, 5180, 5200, 5220, 5240, 5500, 5745, 5785};
+  array<uint8_t, ETH_ALEN> bssid = {
+      0x02, 0x1a, 0x11, 0x00, static_cast<uint8_t>(index >> 8),
+      static_cast<uint8_t>(index)};
+  NL80211Packet scan_result(
+      kFakeFamilyId,
+      NL80211_CMD_NEW_SCAN_RESULTS,
+      kFakeSequenceNumber,
+      getpid());
+  scan_result.AddFlag(NLM_F_MULTI);
+  scan_result.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_GENERATION, kFakeGeneration));
+  scan_result.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, kFakeInterfaceIndex));
+  scan_result.AddAttribute(NL80211Attr<uint64_t>(NL80211_ATTR_WDEV, 1));
+
+  NL80211NestedAttr bss(NL80211_ATTR_BSS);
+  bss.AddAttribute(NL80211Attr<array<uint8_t, ETH_ALEN>>(
+      NL80211_BSS_BSSID, bssid));
+  bss.AddAttribute(NL80211Attr<uint32_t>(
+      NL80211_BSS_FREQUENCY,
+      kFrequencies[index % (sizeof(kFrequencies) / sizeof(kFrequencies[0]))]));
+  bss.AddAttribute(NL80211Attr<uint64_t>(NL80211_BSS_TSF, 1234567890));
+  bss.AddAttribute(NL80211Attr<uint16_t>(NL80211_BSS_BEACON_INTERVAL, 100));
+  bss.AddAttribute(NL80211Attr<uint16_t>(NL80211_BSS_CAPABILITY, 0x1411));
+  vector<uint8_t> ie =
+      CreateInformationElements("Office-" + std::to_string(index % 40));
+  bss.AddAttribute(NL80211Attr<vector<uint8_t>>(
+      NL80211_BSS_INFORMATION_ELEMENTS, ie));
+  bss.AddAttribute(NL80211Attr<vector<uint8_t>>(NL80211_BSS_BEACON_IES, ie));
+  bss.AddAttribute(NL80211Attr<int32_t>(
+      NL80211_BSS_SIGNAL_MBM, -4000 - static_cast<int32_t>(index % 50) * 100));
+  bss.AddAttribute(NL80211Attr<uint32_t>(NL80211_BSS_SEEN_MS_AGO, 120));
+  bss.AddAttribute(NL80211Attr<uint64_t>(
+      NL80211_BSS_LAST_SEEN_BOOTTIME, 123456000000));
+  NL80211NestedAttr chain_signal(NL80211_BSS_CHAIN_SIGNAL);
+  chain_signal.AddAttribute(NL80211Attr<int8_t>(0, -42));
+  chain_signal.AddAttribute(NL80211Attr<int8_t>(1, -45));
+  bss.AddAttribute(chain_signal);
+  scan_result.AddAttribute(bss);
+  return scan_result;
+}
+
+vector<NL80211Packet> CreateScanDump(size_t num_bss) {
+  vector<NL80211Packet> scan_dump;
+  for (size_t i = 0; i < num_bss; i++) {
+    scan_dump.push_back(CreateScanResult(i));
+  }
+  return scan_dump;
+}
+
+void AppendBandPhyAttributes(NL80211NestedAttr* band) {
+  band->AddAttribute(NL80211Attr<uint16_t>(NL80211_BAND_ATTR_HT_CAPA, 0x19ef));
+  band->AddAttribute(NL80211Attr<vector<uint8_t>>(
+      NL80211_BAND_ATTR_HT_MCS_SET,
+      vector<uint8_t>(kHtMcsSet, kHtMcsSet + sizeof(kHtMcsSet))));
+  band->AddAttribute(NL80211Attr<vector<uint8_t>>(
+      NL80211_BAND_ATTR_VHT_CAPA,
+      vector<uint8_t>(kVhtCap, kVhtCap + sizeof(kVhtCap))));
+  band->AddAttribute(NL80211Attr<vector<uint8_t>>(
+      NL80211_BAND_ATTR_VHT_MCS_SET,
+      vector<uint8_t>(kVhtMcsSet, kVhtMcsSet + sizeof(kVhtMcsSet))));
+  NL80211NestedAttr iftype_data(NL80211_BAND_ATTR_IFTYPE_DATA);
+  NL80211NestedAttr iftype_data_station(1);
+  iftype_data_station.AddAttribute(NL80211Attr<vector<uint8_t>>(
+      NL80211_BAND_IFTYPE_ATTR_HE_CAP_PHY,
+      vector<uint8_t>(kHeCapPhy, kHeCapPhy + sizeof(kHeCapPhy))));
+  iftype_data_station.AddAttribute(NL80211Attr<vector<uint8_t>>(
+      NL80211_BAND_IFTYPE_ATTR_HE_CAP_MCS_SET,
+      vector<uint8_t>(kHeMcsSet, kHeMcsSet + sizeof(kHeMcsSet))));
+  iftype_data.AddAttribute(iftype_data_station);
+  band->AddAttribute(iftype_data);
+}
+
+// Returns one message of a split wiphy dump, holding band |band_index| with
+// the channels from |first_frequency| to |last_frequency|.
+NL80211Packet CreateWiphyBandMessage(int band_index,
+                                     uint32_t first_frequency,
+                                     uint32_t last_frequency) {
+  NL80211NestedAttr freqs(NL80211_BAND_ATTR_FREQS);
+  int freq_index = 0;
+  for (uint32_t frequency = first_frequency; frequency <= last_frequency;
+       frequency += (band_index == 0 ? 5 : 20)) {
+    NL80211NestedAttr freq(freq_index++);
+    freq.AddAttribute(NL80211Attr<uint32_t>(NL80211_FREQUENCY_ATTR_FREQ,
+                                            frequency));
+    freq.AddAttribute(NL80211Attr<uint32_t>(NL80211_FREQUENCY_ATTR_MAX_TX_POWER,
+                                            2000));
+    if (frequency >= 5260 && frequency <= 5720) {
+      freq.AddFlagAttribute(NL80211_FREQUENCY_ATTR_NO_IR);
+      freq.AddFlagAttribute(NL80211_FREQUENCY_ATTR_RADAR);
+      freq.AddAttribute(NL80211Attr<uint32_t>(NL80211_FREQUENCY_ATTR_DFS_STATE,
+                                              NL80211_DFS_USABLE));
+    }
+    freqs.AddAttribute(freq);
+  }
+  NL80211NestedAttr band(band_index);
+  band.AddAttribute(freqs);
+  AppendBandPhyAttributes(&band);
+  NL80211NestedAttr bands(NL80211_ATTR_WIPHY_BANDS);
+  bands.AddAttribute(band);
+
+  NL80211Packet message(
+      kFakeFamilyId,
+      NL80211_CMD_NEW_WIPHY,
+      kFakeSequenceNumber,
+      getpid());
+  message.AddFlag(NLM_F_MULTI);
+  message.AddAttribute(NL80211Attr<uint32_t>(NL80211_ATTR_WIPHY,
+                                             kFakeWiphyIndex));
+  message.AddAttribute(bands);
+  return message;
+}
+
+// Returns a split wiphy dump of a 2.4GHz, 5GHz and 6GHz capable device.
+vector<NL80211Packet> CreateSplitWiphyDump() {
+  NL80211Packet capabilities(
+      kFakeFamilyId,
+      NL80211_CMD_NEW_WIPHY,
+      kFakeSequenceNumber,
+      getpid());
+  capabilities.AddFlag(NLM_F_MULTI);
+  capabilities.AddAttribute(NL80211Attr<uint32_t>(NL80211_ATTR_WIPHY,
+                                                  kFakeWiphyIndex));
+  capabilities.AddAttribute(
+      NL80211Attr<string>(NL80211_ATTR_WIPHY_NAME, "phy0"));
+  capabilities.AddAttribute(
+      NL80211Attr<uint8_t>(NL80211_ATTR_MAX_NUM_SCAN_SSIDS, 16));
+  capabilities.AddAttribute(
+      NL80211Attr<uint8_t>(NL80211_ATTR_MAX_NUM_SCHED_SCAN_SSIDS, 16));
+  capabilities.AddAttribute(
+      NL80211Attr<uint8_t>(NL80211_ATTR_MAX_MATCH_SETS, 16));
+  capabilities.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_MAX_NUM_SCHED_SCAN_PLANS, 2));
+  capabilities.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_MAX_SCAN_PLAN_INTERVAL, 7200));
+  capabilities.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_MAX_SCAN_PLAN_ITERATIONS, 100));
+  capabilities.AddAttribute(NL80211Attr<uint32_t>(
+      NL80211_ATTR_FEATURE_FLAGS,
+      NL80211_FEATURE_SCAN_RANDOM_MAC_ADDR |
+          NL80211_FEATURE_SCHED_SCAN_RANDOM_MAC_ADDR));
+  capabilities.AddAttribute(NL80211Attr<vector<uint8_t>>(
+      NL80211_ATTR_EXT_FEATURES, vector<uint8_t>(8, 0xff)));
+
+  return {capabilities,
+          CreateWiphyBandMessage(0, 2412, 2472),
+          CreateWiphyBandMessage(1, 5180, 5500),
+          CreateWiphyBandMessage(1, 5520, 5885),
+          CreateWiphyBandMessage(3, 5955, 7115)};
+}
+
+NL80211Packet CreateTriggerScanRequest(size_t num_freqs) {
+  NL80211Packet trigger_scan(
+      kFakeFamilyId,
+      NL80211_CMD_TRIGGER_SCAN,
+      kFakeSequenceNumber,
+      getpid());
+  trigger_scan.AddFlag(NLM_F_ACK);
+  trigger_scan.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, kFakeInterfaceIndex));
+  NL80211NestedAttr ssids(NL80211_ATTR_SCAN_SSIDS);
+  ssids.AddAttribute(NL80211Attr<vector<uint8_t>>(0, {}));
+  ssids.AddAttribute(NL80211Attr<vector<uint8_t>>(1, {'h', 'i', 'd', 'e'}));
+  trigger_scan.AddAttribute(ssids);
+  NL80211NestedAttr freqs(NL80211_ATTR_SCAN_FREQUENCIES);
+  for (size_t i = 0; i < num_freqs; i++) {
+    freqs.AddAttribute(NL80211Attr<uint32_t>(i, 5180 + 20 * i));
+  }
+  trigger_scan.AddAttribute(freqs);
+  trigger_scan.AddAttribute(NL80211Attr<uint32_t>(
+      NL80211_ATTR_SCAN_FLAGS, NL80211_SCAN_FLAG_RANDOM_ADDR));
+  return trigger_scan;
+}
+
+// Returns every field of every BSS of a scan dump.
+vector<NativeScanResult> ParseScanDump(size_t num_bss) {
+  FakeNetlinkManager netlink_manager;
+  netlink_manager.SetReplies(CreateScanDump(num_bss));
+  ScanUtils scan_utils(&netlink_manager);
+  ScanResultQuery query;
+  query.fields = IWifiScannerImpl::SCAN_RESULT_FIELD_ALL;
+  vector<NativeScanResult> scan_results;
+  scan_utils.QueryScanResults(kFakeInterfaceIndex, query, &scan_results);
+  return scan_results;
+}
+
+}  // namespace
+
+static void BM_PacketConstruction(benchmark::State& state) {
+  for (auto _ : state) {
+    NL80211Packet get_station(
+        kFakeFamilyId,
+        NL80211_CMD_GET_STATION,
+        kFakeSequenceNumber,
+        getpid());
+    get_station.AddAttribute(
+        NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, kFakeInterfaceIndex));
+    get_station.AddAttribute(NL80211Attr<array<uint8_t, ETH_ALEN>>(
+        NL80211_ATTR_MAC, {0x02, 0x1a, 0x11, 0x00, 0x01, 0x02}));
+    benchmark::DoNotOptimize(get_station.GetConstData().data());
+  }
+}
+BENCHMARK(BM_PacketConstruction);
+
+static void BM_NestedAttributeBuilding(benchmark::State& state) {
+  for (auto _ : state) {
+    NL80211Packet trigger_scan = CreateTriggerScanRequest(state.range(0));
+    benchmark::DoNotOptimize(trigger_scan.GetConstData().data());
+  }
+}
+BENCHMARK(BM_NestedAttributeBuilding)->Arg(8)->Arg(64);
+
+static void BM_GetAttributeValue(benchmark::State& state) {
+  NL80211Packet scan_result = CreateScanResult(0);
+  for (auto _ : state) {
+    uint32_t interface_index;
+    uint32_t generation;
+    NL80211NestedAttr bss(0);
+    uint32_t frequency;
+    int32_t signal_mbm;
+    benchmark::DoNotOptimize(
+        scan_result.GetAttributeValue(NL80211_ATTR_IFINDEX,
+                                      &interface_index) &&
+        scan_result.GetAttributeValue(NL80211_ATTR_GENERATION,
+                                      &generation) &&
+        scan_result.GetAttribute(NL80211_ATTR_BSS, &bss) &&
+        bss.GetAttributeValue(NL80211_BSS_FREQUENCY, &frequency) &&
+        bss.GetAttributeValue(NL80211_BSS_SIGNAL_MBM, &signal_mbm));
+  }
+}
+BENCHMARK(BM_GetAttributeValue);
+
+// Parses every field of every BSS of a scan dump, through |QueryScanResults|
+// because it does not cache the results.
+static void BM_ParseScanResults(benchmark::State& state) {
+  FakeNetlinkManager netlink_manager;
+  netlink_manager.SetReplies(CreateScanDump(state.range(0)));
+  ScanUtils scan_utils(&netlink_manager);
+  ScanResultQuery query;
+  query.fields = IWifiScannerImpl::SCAN_RESULT_FIELD_ALL;
+  for (auto _ : state) {
+    vector<NativeScanResult> scan_results;
+    scan_utils.QueryScanResults(kFakeInterfaceIndex, query, &scan_results);
+    benchmark::DoNotOptimize(scan_results.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ParseScanResults)->Arg(30)->Arg(300);
+
+// Marshals scan results one NativeScanResult at a time, like a generated
+// NativeScanResult[] reply does.
+static void BM_WriteScanResults(benchmark::State& state) {
+  vector<NativeScanResult> scan_results = ParseScanDump(state.range(0));
+  for (auto _ : state) {
+    Parcel parcel;
+    parcel.writeInt32(scan_results.size());
+    for (const auto& scan_result : scan_results) {
+      parcel.writeInt32(1);
+      scan_result.writeToParcel(&parcel);
+    }
+    benchmark::DoNotOptimize(parcel.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_WriteScanResults)->Arg(30)->Arg(300);
+
+// Marshals the same scan results from a ScanResultBatch, like
+// getScanResults() replies.
+static void BM_WriteScanResultBatch(benchmark::State& state) {
+  ScanResultBatch batch;
+  batch.Assign(ParseScanDump(state.range(0)));
+  for (auto _ : state) {
+    Parcel parcel;
+    batch.WriteToParcel(&parcel);
+    benchmark::DoNotOptimize(parcel.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_WriteScanResultBatch)->Arg(30)->Arg(300);
+
+static void BM_GetWiphyInfoSplitDump(benchmark::State& state) {
+  FakeNetlinkManager netlink_manager;
+  NetlinkUtils netlink_utils(&netlink_manager);
+  netlink_utils.supports_split_wiphy_dump_ = true;
+  netlink_manager.SetReplies(CreateSplitWiphyDump());
+  for (auto _ : state) {
+    BandInfo band_info;
+    ScanCapabilities scan_capabilities;
+    WiphyFeatures wiphy_features;
+    benchmark::DoNotOptimize(netlink_utils.GetWiphyInfo(kFakeWiphyIndex,
+                                                        &band_info,
+                                                        &scan_capabilities,
+                                                        &wiphy_features));
+  }
+}
+BENCHMARK(BM_GetWiphyInfoSplitDump);
+
+}  // namespace wificond
+}  // namespace android
+
+BENCHMARK_MAIN();
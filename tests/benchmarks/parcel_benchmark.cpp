@@ -0,0 +1,331 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Marshalling cost of the parcelables of the wificond binder interfaces, at
+// the sizes of a busy environment: hundreds of scan results, dozens of PNO
+// networks, every channel of a tri-band radio.
+//
+// Lists are marshalled as typed arrays and settings as single parcelables,
+// like generated code marshals T[] and T arguments and replies. Read
+// benchmarks parse the parcel that the matching write benchmark produces.
+// Reported counters:
+//   - bytes_per_op: size of the parcel written or read by an iteration.
+// The time of an iteration is the time per operation.
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include <linux/if_ether.h>
+
+#include <benchmark/benchmark.h>
+#include <binder/Parcel.h>
+
+#include "android/net/wifi/nl80211/IWifiScannerImpl.h"
+#include "wificond/client/native_wifi_client.h"
+#include "wificond/device_wiphy_capabilities.h"
+#include "wificond/device_wiphy_info.h"
+#include "wificond/scanning/channel_settings.h"
+#include "wificond/scanning/hidden_network.h"
+#include "wificond/scanning/info_element_location.h"
+#include "wificond/scanning/pno_network.h"
+#include "wificond/scanning/pno_settings.h"
+#include "wificond/scanning/radio_chain_info.h"
+#include "wificond/scanning/scan_result.h"
+#include "wificond/scanning/single_scan_settings.h"
+
+using android::net::wifi::nl80211::ChannelSettings;
+using android::net::wifi::nl80211::DeviceWiphyCapabilities;
+using android::net::wifi::nl80211::DeviceWiphyInfo;
+using android::net::wifi::nl80211::HiddenNetwork;
+using android::net::wifi::nl80211::IWifiScannerImpl;
+using android::net::wifi::nl80211::InfoElementLocation;
+using android::net::wifi::nl80211::NativeScanResult;
+using android::net::wifi::nl80211::NativeWifiClient;
+using android::net::wifi::nl80211::PnoNetwork;
+using android::net::wifi::nl80211::PnoSettings;
+using android::net::wifi::nl80211::RadioChainInfo;
+using android::net::wifi::nl80211::SingleScanSettings;
+using std::string;
+using std::vector;
+
+namespace android {
+namespace wificond {
+namespace {
+
+const int32_t k2gFrequencies[] = {
+    2412, 2417, 2422, 2427, 2432, 2437, 2442, 2447, 2452, 2457, 2462};
+const int32_t k5gFrequencies[] = {
+    5180, 5200, 5220, 5240, 5745, 5765, 5785, 5805, 5825};
+const int32_t kDfsFrequencies[] = {
+    5260, 5280, 5300, 5320, 5500, 5520, 5540, 5560, 5580, 5600, 5620, 5640,
+    5660, 5680, 5700, 5720};
+
+// Returns the frequency of the |index|th 20MHz channel of a tri-band radio,
+// the 6GHz channels last.
+int32_t GetFrequency(size_t index) {
+  const size_t num_2g = sizeof(k2gFrequencies) / sizeof(k2gFrequencies[0]);
+  const size_t num_5g = sizeof(k5gFrequencies) / sizeof(k5gFrequencies[0]);
+  const size_t num_dfs =
+      sizeof(kDfsFrequencies) / sizeof(kDfsFrequencies[0]);
+  if (index < num_2g) {
+    return k2gFrequencies[index];
+  }
+  index -= num_2g;
+  if (index < num_5g) {
+    return k5gFrequencies[index];
+  }
+  index -= num_5g;
+  if (index < num_dfs) {
+    return kDfsFrequencies[index];
+  }
+  index -= num_dfs;
+  return 5955 + 20 * static_cast<int32_t>(index % 59);
+}
+
+vector<uint8_t> CreateSsid(const string& prefix, size_t index) {
+  string ssid = prefix + std::to_string(index);
+  return vector<uint8_t>(ssid.begin(), ssid.end());
+}
+
+// Returns a scan result with about 300 bytes of information elements and an
+// index of 18 elements, like the beacon of a typical enterprise 802.11ax
+// access point.
+NativeScanResult CreateScanResult(size_t index) {
+  NativeScanResult scan_result;
+  scan_result.ssid = CreateSsid("Office-", index % 40);
+  scan_result.bssid = {{0x02, 0x1a, 0x11, 0x00,
+                        static_cast<uint8_t>(index >> 8),
+                        static_cast<uint8_t>(index)}};
+  scan_result.info_element.assign(300, static_cast<uint8_t>(index));
+  for (int32_t i = 0; i < 18; i++) {
+    scan_result.info_element_index.push_back(
+        InfoElementLocation(i * 13 % 256, 0, i * 16, 14));
+  }
+  scan_result.frequency = GetFrequency(index % 36);
+  scan_result.signal_mbm = -4000 - static_cast<int32_t>(index % 50) * 100;
+  scan_result.tsf = 1234567890;
+  scan_result.capability = 0x1411;
+  scan_result.associated = index == 0;
+  scan_result.radio_chain_infos = {RadioChainInfo(0, -42),
+                                   RadioChainInfo(1, -45)};
+  return scan_result;
+}
+
+vector<NativeScanResult> CreateScanResults(size_t num_results) {
+  vector<NativeScanResult> scan_results;
+  for (size_t i = 0; i < num_results; i++) {
+    scan_results.push_back(CreateScanResult(i));
+  }
+  return scan_results;
+}
+
+// Returns the settings of a scan of |num_channels| channels for
+// |num_hidden_networks| hidden networks.
+SingleScanSettings CreateSingleScanSettings(size_t num_channels,
+                                            size_t num_hidden_networks) {
+  SingleScanSettings settings;
+  settings.scan_type_ = IWifiScannerImpl::SCAN_TYPE_HIGH_ACCURACY;
+  for (size_t i = 0; i < num_channels; i++) {
+    ChannelSettings channel;
+    channel.frequency_ = GetFrequency(i);
+    settings.channel_settings_.push_back(channel);
+  }
+  for (size_t i = 0; i < num_hidden_networks; i++) {
+    HiddenNetwork network;
+    network.ssid_ = CreateSsid("Hidden-", i);
+    settings.hidden_networks_.push_back(network);
+  }
+  return settings;
+}
+
+// Returns PNO settings of |num_networks| saved networks, each with the
+// frequencies it was last seen on.
+PnoSettings CreatePnoSettings(size_t num_networks) {
+  PnoSettings settings;
+  settings.interval_ms_ = 20000;
+  settings.min_2g_rssi_ = -83;
+  settings.min_5g_rssi_ = -80;
+  settings.min_6g_rssi_ = -77;
+  settings.enable_network_rotation_ = true;
+  for (size_t i = 0; i < num_networks; i++) {
+    PnoNetwork network;
+    network.is_hidden_ = i % 8 == 0;
+    network.ssid_ = CreateSsid("Saved-", i);
+    for (size_t j = 0; j < 4; j++) {
+      network.frequencies_.push_back(GetFrequency(i + j * 9));
+    }
+    network.num_connections_ = static_cast<int32_t>(i);
+    network.last_connected_ms_ = 1600000000000 + i;
+    settings.pno_networks_.push_back(network);
+  }
+  return settings;
+}
+
+DeviceWiphyCapabilities CreateDeviceWiphyCapabilities() {
+  DeviceWiphyCapabilities capabilities;
+  capabilities.is80211nSupported_ = true;
+  capabilities.is80211acSupported_ = true;
+  capabilities.is80211axSupported_ = true;
+  capabilities.is160MhzSupported_ = true;
+  capabilities.is80p80MhzSupported_ = false;
+  capabilities.maxTxStreams_ = 2;
+  capabilities.maxRxStreams_ = 2;
+  return capabilities;
+}
+
+// Returns the channels and capabilities of a tri-band radio.
+DeviceWiphyInfo CreateDeviceWiphyInfo() {
+  DeviceWiphyInfo info;
+  info.band2gChannels_.assign(std::begin(k2gFrequencies),
+                              std::end(k2gFrequencies));
+  info.band5gNonDfsChannels_.assign(std::begin(k5gFrequencies),
+                                    std::end(k5gFrequencies));
+  info.bandDfsChannels_.assign(std::begin(kDfsFrequencies),
+                               std::end(kDfsFrequencies));
+  for (int32_t i = 0; i < 59; i++) {
+    info.band6gChannels_.push_back(5955 + 20 * i);
+  }
+  info.capabilities_ = CreateDeviceWiphyCapabilities();
+  return info;
+}
+
+// Returns the clients of a soft AP.
+vector<NativeWifiClient> CreateNativeWifiClients(size_t num_clients) {
+  vector<NativeWifiClient> clients;
+  for (size_t i = 0; i < num_clients; i++) {
+    NativeWifiClient client;
+    client.mac_address_ = {0x02, 0x1a, 0x11, 0x01,
+                           static_cast<uint8_t>(i >> 8),
+                           static_cast<uint8_t>(i)};
+    clients.push_back(client);
+  }
+  return clients;
+}
+
+void ReportBytesPerOp(benchmark::State& state, size_t bytes) {
+  state.counters["bytes_per_op"] = bytes;
+  state.SetBytesProcessed(state.iterations() * bytes);
+}
+
+}  // namespace
+
+template <typename T>
+static void BM_WriteParcelables(benchmark::State& state,
+                                const vector<T>& values) {
+  size_t bytes = 0;
+  for (auto _ : state) {
+    Parcel parcel;
+    parcel.writeParcelableVector(values);
+    bytes = parcel.dataSize();
+    benchmark::DoNotOptimize(parcel.data());
+  }
+  ReportBytesPerOp(state, bytes);
+}
+
+template <typename T>
+static void BM_ReadParcelables(benchmark::State& state,
+                               const vector<T>& values) {
+  Parcel parcel;
+  parcel.writeParcelableVector(values);
+  for (auto _ : state) {
+    parcel.setDataPosition(0);
+    vector<T> read_values;
+    if (parcel.readParcelableVector(&read_values) != OK) {
+      state.SkipWithError("Failed to read parcelables");
+      break;
+    }
+    benchmark::DoNotOptimize(read_values.data());
+  }
+  ReportBytesPerOp(state, parcel.dataSize());
+}
+
+template <typename T>
+static void BM_WriteParcelable(benchmark::State& state, const T& value) {
+  size_t bytes = 0;
+  for (auto _ : state) {
+    Parcel parcel;
+    parcel.writeParcelable(value);
+    bytes = parcel.dataSize();
+    benchmark::DoNotOptimize(parcel.data());
+  }
+  ReportBytesPerOp(state, bytes);
+}
+
+template <typename T>
+static void BM_ReadParcelable(benchmark::State& state, const T& value) {
+  Parcel parcel;
+  parcel.writeParcelable(value);
+  for (auto _ : state) {
+    parcel.setDataPosition(0);
+    T read_value;
+    if (parcel.readParcelable(&read_value) != OK) {
+      state.SkipWithError("Failed to read parcelable");
+      break;
+    }
+    benchmark::DoNotOptimize(&read_value);
+  }
+  ReportBytesPerOp(state, parcel.dataSize());
+}
+
+// Scan results, e.g. the reply of getScanResults().
+BENCHMARK_CAPTURE(BM_WriteParcelables, NativeScanResult_30,
+                  CreateScanResults(30));
+BENCHMARK_CAPTURE(BM_WriteParcelables, NativeScanResult_300,
+                  CreateScanResults(300));
+BENCHMARK_CAPTURE(BM_ReadParcelables, NativeScanResult_30,
+                  CreateScanResults(30));
+BENCHMARK_CAPTURE(BM_ReadParcelables, NativeScanResult_300,
+                  CreateScanResults(300));
+
+// Scan requests, from a single channel scan to a full tri-band one.
+BENCHMARK_CAPTURE(BM_WriteParcelable, SingleScanSettings_1,
+                  CreateSingleScanSettings(1, 1));
+BENCHMARK_CAPTURE(BM_WriteParcelable, SingleScanSettings_95,
+                  CreateSingleScanSettings(95, 16));
+BENCHMARK_CAPTURE(BM_ReadParcelable, SingleScanSettings_1,
+                  CreateSingleScanSettings(1, 1));
+BENCHMARK_CAPTURE(BM_ReadParcelable, SingleScanSettings_95,
+                  CreateSingleScanSettings(95, 16));
+
+// PNO requests with a few and with many saved networks.
+BENCHMARK_CAPTURE(BM_WriteParcelable, PnoSettings_8, CreatePnoSettings(8));
+BENCHMARK_CAPTURE(BM_WriteParcelable, PnoSettings_64, CreatePnoSettings(64));
+BENCHMARK_CAPTURE(BM_ReadParcelable, PnoSettings_8, CreatePnoSettings(8));
+BENCHMARK_CAPTURE(BM_ReadParcelable, PnoSettings_64, CreatePnoSettings(64));
+
+// Wiphy capabilities alone, and with the channels of every band.
+BENCHMARK_CAPTURE(BM_WriteParcelable, DeviceWiphyCapabilities,
+                  CreateDeviceWiphyCapabilities());
+BENCHMARK_CAPTURE(BM_ReadParcelable, DeviceWiphyCapabilities,
+                  CreateDeviceWiphyCapabilities());
+BENCHMARK_CAPTURE(BM_WriteParcelable, DeviceWiphyInfo,
+                  CreateDeviceWiphyInfo());
+BENCHMARK_CAPTURE(BM_ReadParcelable, DeviceWiphyInfo,
+                  CreateDeviceWiphyInfo());
+
+// Clients of a soft AP, e.g. the arguments of onConnectedClientsBatchChanged().
+BENCHMARK_CAPTURE(BM_WriteParcelables, NativeWifiClient_10,
+                  CreateNativeWifiClients(10));
+BENCHMARK_CAPTURE(BM_WriteParcelables, NativeWifiClient_100,
+                  CreateNativeWifiClients(100));
+BENCHMARK_CAPTURE(BM_ReadParcelables, NativeWifiClient_10,
+                  CreateNativeWifiClients(10));
+BENCHMARK_CAPTURE(BM_ReadParcelables, NativeWifiClient_100,
+                  CreateNativeWifiClients(100));
+
+}  // namespace wificond
+}  // namespace android
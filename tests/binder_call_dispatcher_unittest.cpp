@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2016, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <shared_mutex>
+#include <thread>
+
+#include <gtest/gtest.h>
+#include <utils/Errors.h>
+
+#include "wificond/binder_call_dispatcher.h"
+#include "wificond/tests/fake_event_loop.h"
+
+namespace android {
+namespace wificond {
+
+class BinderCallDispatcherTest : public ::testing::Test {
+ protected:
+  void TearDown() override {
+    BinderCallDispatcher::SetInstance(nullptr);
+  }
+
+  FakeEventLoop event_loop_{FakeEventLoop::kQueueTasks};
+  BinderCallDispatcher dispatcher_{&event_loop_};
+};
+
+TEST_F(BinderCallDispatcherTest, RunsTransactionDirectlyWithoutInstance) {
+  bool checked_read_only = false;
+  EXPECT_EQ(BAD_VALUE, BinderCallDispatcher::DispatchTransaction(
+      [&checked_read_only]() { return checked_read_only = true; },
+      []() { return BAD_VALUE; }));
+  // Every transaction already runs on the event loop thread.
+  EXPECT_FALSE(checked_read_only);
+  EXPECT_FALSE(event_loop_.HasTasks());
+}
+
+TEST_F(BinderCallDispatcherTest, RunsReadOnlyTransactionOnCallingThread) {
+  BinderCallDispatcher::SetInstance(&dispatcher_);
+  const std::thread::id calling_thread = std::this_thread::get_id();
+  std::thread::id transaction_thread;
+  EXPECT_EQ(NO_ERROR, BinderCallDispatcher::DispatchTransaction(
+      []() { return true; },
+      [&transaction_thread]() {
+        transaction_thread = std::this_thread::get_id();
+        return NO_ERROR;
+      }));
+  EXPECT_EQ(calling_thread, transaction_thread);
+  EXPECT_FALSE(event_loop_.HasTasks());
+}
+
+TEST_F(BinderCallDispatcherTest, PostsOtherTransactionsToEventLoop) {
+  BinderCallDispatcher::SetInstance(&dispatcher_);
+  const std::thread::id loop_thread = std::this_thread::get_id();
+  std::thread::id transaction_thread;
+  status_t result = UNKNOWN_ERROR;
+  std::thread binder_thread([&]() {
+    result = BinderCallDispatcher::DispatchTransaction(
+        []() { return false; },
+        [&transaction_thread]() {
+          transaction_thread = std::this_thread::get_id();
+          return NO_ERROR;
+        });
+  });
+  event_loop_.RunOneTask();
+  binder_thread.join();
+  EXPECT_EQ(NO_ERROR, result);
+  EXPECT_EQ(loop_thread, transaction_thread);
+}
+
+TEST_F(BinderCallDispatcherTest, ReadOnlyTransactionWaitsForStateLock) {
+  BinderCallDispatcher::SetInstance(&dispatcher_);
+  std::atomic<bool> ran(false);
+  std::thread binder_thread;
+  {
+    // The event loop holds the lock while a callback runs.
+    std::unique_lock<std::shared_mutex> lock(*dispatcher_.GetStateLock());
+    binder_thread = std::thread([&ran]() {
+      BinderCallDispatcher::DispatchTransaction(
+          []() { return true; },
+          [&ran]() {
+            ran = true;
+            return NO_ERROR;
+          });
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_FALSE(ran);
+  }
+  binder_thread.join();
+  EXPECT_TRUE(ran);
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <array>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "wificond/scanning/bss_watch_list.h"
+
+using android::net::wifi::nl80211::BssWatchSettings;
+using android::net::wifi::nl80211::NativeScanResult;
+using android::net::wifi::nl80211::NativeScanResultsDelta;
+using std::array;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+const array<uint8_t, ETH_ALEN> kFakeBssid = {
+    {0xc0, 0xee, 0xfb, 0x12, 0x34, 0x56}};
+const array<uint8_t, ETH_ALEN> kFakeOtherBssid = {
+    {0xc0, 0xee, 0xfb, 0x12, 0x34, 0x57}};
+constexpr int32_t kFakeSignalDeltaMbm = 500;
+constexpr uint32_t kFakeFrequency = 5180;
+
+BssWatchSettings CreateSettings(const array<uint8_t, ETH_ALEN>& bssid) {
+  BssWatchSettings settings;
+  BssWatchSettings::WatchedBss bss;
+  bss.bssid.assign(bssid.begin(), bssid.end());
+  bss.signal_delta_mbm = kFakeSignalDeltaMbm;
+  settings.bsses.push_back(bss);
+  return settings;
+}
+
+NativeScanResult CreateScanResult(const array<uint8_t, ETH_ALEN>& bssid,
+                                  int32_t signal_mbm) {
+  NativeScanResult scan_result;
+  scan_result.bssid = bssid;
+  scan_result.frequency = kFakeFrequency;
+  scan_result.signal_mbm = signal_mbm;
+  return scan_result;
+}
+
+}  // namespace
+
+TEST(BssWatchListTest, RejectsInvalidSettings) {
+  BssWatchList watch_list;
+  BssWatchSettings settings = CreateSettings(kFakeBssid);
+  settings.bsses[0].bssid.pop_back();
+  EXPECT_FALSE(watch_list.Set(settings));
+  EXPECT_TRUE(watch_list.empty());
+
+  settings = CreateSettings(kFakeBssid);
+  settings.bsses[0].signal_delta_mbm = -1;
+  EXPECT_FALSE(watch_list.Set(settings));
+  EXPECT_TRUE(watch_list.Set(CreateSettings(kFakeBssid)));
+  EXPECT_FALSE(watch_list.empty());
+}
+
+TEST(BssWatchListTest, ReportsSignalChangesOverThreshold) {
+  BssWatchList watch_list;
+  ASSERT_TRUE(watch_list.Set(CreateSettings(kFakeBssid)));
+
+  NativeScanResultsDelta changes;
+  ASSERT_TRUE(watch_list.Update({CreateScanResult(kFakeBssid, -6000),
+                                 CreateScanResult(kFakeOtherBssid, -6000)},
+                                &changes));
+  ASSERT_EQ(1u, changes.updated_scan_results.size());
+  EXPECT_EQ(kFakeBssid, changes.updated_scan_results[0].bssid);
+
+  changes = NativeScanResultsDelta();
+  EXPECT_FALSE(watch_list.Update(
+      {CreateScanResult(kFakeBssid, -6000 - kFakeSignalDeltaMbm + 1)},
+      &changes));
+  EXPECT_TRUE(changes.updated_scan_results.empty());
+
+  // Changes are compared with the last reported signal, so that a slow drift
+  // is reported too.
+  EXPECT_TRUE(watch_list.Update(
+      {CreateScanResult(kFakeBssid, -6000 - kFakeSignalDeltaMbm)},
+      &changes));
+  ASSERT_EQ(1u, changes.updated_scan_results.size());
+  EXPECT_EQ(-6000 - kFakeSignalDeltaMbm,
+            changes.updated_scan_results[0].signal_mbm);
+}
+
+TEST(BssWatchListTest, ReportsDisappearedBss) {
+  BssWatchList watch_list;
+  ASSERT_TRUE(watch_list.Set(CreateSettings(kFakeBssid)));
+  NativeScanResultsDelta changes;
+  ASSERT_TRUE(
+      watch_list.Update({CreateScanResult(kFakeBssid, -6000)}, &changes));
+
+  changes = NativeScanResultsDelta();
+  ASSERT_TRUE(watch_list.Update({}, &changes));
+  EXPECT_TRUE(changes.updated_scan_results.empty());
+  ASSERT_EQ(1u, changes.removed_bssids.size());
+  EXPECT_EQ(kFakeBssid, changes.removed_bssids[0]);
+  EXPECT_EQ(vector<uint32_t>{kFakeFrequency}, changes.removed_frequencies);
+
+  changes = NativeScanResultsDelta();
+  EXPECT_FALSE(watch_list.Update({}, &changes));
+}
+
+}  // namespace wificond
+}  // namespace android
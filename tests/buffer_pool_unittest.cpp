@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "wificond/net/buffer_pool.h"
+
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+TEST(BufferPoolTest, ReusesStorageOfReleasedBuffers) {
+  vector<uint8_t> buffer = BufferPool<uint8_t>::Acquire(100);
+  EXPECT_LE(100u, buffer.capacity());
+  EXPECT_TRUE(buffer.empty());
+  buffer.resize(100, 1);
+  const uint8_t* storage = buffer.data();
+  BufferPool<uint8_t>::Release(std::move(buffer));
+
+  // Any size of the same size class gets the same storage back, emptied.
+  vector<uint8_t> reused = BufferPool<uint8_t>::Acquire(120);
+  EXPECT_TRUE(reused.empty());
+  reused.resize(1);
+  EXPECT_EQ(storage, reused.data());
+}
+
+TEST(BufferPoolTest, ServesSmallerSizesFromLargerBuffers) {
+  vector<uint32_t> buffer;
+  buffer.reserve(1000);
+  const uint32_t* storage = buffer.data();
+  BufferPool<uint32_t>::Release(std::move(buffer));
+
+  // The buffer holds 512 elements of the next smaller size class.
+  vector<uint32_t> reused = BufferPool<uint32_t>::Acquire(500);
+  EXPECT_LE(500u, reused.capacity());
+  EXPECT_EQ(storage, reused.data());
+}
+
+TEST(BufferPoolTest, DoesNotPoolLargeBuffers) {
+  size_t size = BufferPool<uint8_t>::kMaxCapacity + 1;
+  vector<uint8_t> buffer = BufferPool<uint8_t>::Acquire(size);
+  EXPECT_LE(size, buffer.capacity());
+  BufferPool<uint8_t>::Release(std::move(buffer));
+  // Nothing was kept for a buffer of the largest size class.
+  vector<uint8_t> other =
+      BufferPool<uint8_t>::Acquire(BufferPool<uint8_t>::kMaxCapacity);
+  EXPECT_EQ(BufferPool<uint8_t>::kMaxCapacity, other.capacity());
+}
+
+TEST(BufferPoolTest, CanTrimReleasedBuffers) {
+  BufferPool<uint8_t>::Trim();
+  vector<uint8_t> buffer = BufferPool<uint8_t>::Acquire(100);
+  const size_t capacity = buffer.capacity();
+  BufferPool<uint8_t>::Release(std::move(buffer));
+  EXPECT_EQ(capacity, BufferPool<uint8_t>::GetCachedBytes());
+  EXPECT_LE(capacity, BufferPool<uint8_t>::GetPeakCachedBytes());
+
+  BufferPool<uint8_t>::Trim();
+  EXPECT_EQ(0u, BufferPool<uint8_t>::GetCachedBytes());
+  EXPECT_LE(capacity, BufferPool<uint8_t>::GetPeakCachedBytes());
+}
+
+}  // namespace wificond
+}  // namespace android
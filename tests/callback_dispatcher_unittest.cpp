@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "wificond/callback_dispatcher.h"
+
+using std::mutex;
+using std::string;
+using std::unique_lock;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+const int kListener1 = 1;
+const int kListener2 = 2;
+const int kBlockingListener = 3;
+
+// Records the callbacks that were called, and holds up the dispatch thread
+// until it is opened.
+class CallbackRecorder {
+ public:
+  std::function<void()> Record(const string& name) {
+    return [this, name]() {
+      std::lock_guard<mutex> guard(lock_);
+      called_.push_back(name);
+      changed_.notify_all();
+    };
+  }
+  std::function<void()> Block() {
+    return [this]() {
+      unique_lock<mutex> guard(lock_);
+      blocked_ = true;
+      changed_.notify_all();
+      changed_.wait(guard, [this]() { return open_; });
+    };
+  }
+  void WaitUntilBlocked() {
+    unique_lock<mutex> guard(lock_);
+    changed_.wait(guard, [this]() { return blocked_; });
+  }
+  void Open() {
+    std::lock_guard<mutex> guard(lock_);
+    open_ = true;
+    changed_.notify_all();
+  }
+  vector<string> WaitForCalls(size_t num_calls) {
+    unique_lock<mutex> guard(lock_);
+    changed_.wait(guard, [this, num_calls]() {
+      return called_.size() >= num_calls;
+    });
+    return called_;
+  }
+
+ private:
+  mutex lock_;
+  std::condition_variable changed_;
+  vector<string> called_;
+  bool blocked_ = false;
+  bool open_ = false;
+};
+
+}  // namespace
+
+TEST(CallbackDispatcherTest, CallsCallbacksRightAwayWithoutDispatcher) {
+  CallbackRecorder recorder;
+  CallbackDispatcher::Dispatch(nullptr, &kListener1,
+                               CallbackDispatcher::kNoCoalescing,
+                               recorder.Record("a"));
+  EXPECT_EQ(vector<string>{"a"}, recorder.WaitForCalls(1));
+}
+
+TEST(CallbackDispatcherTest, CallsCallbacksOfAListenerInOrder) {
+  CallbackRecorder recorder;
+  CallbackDispatcher dispatcher;
+  for (const string& name : {"a", "b", "c"}) {
+    dispatcher.Post(&kListener1, CallbackDispatcher::kNoCoalescing,
+                    recorder.Record(name));
+  }
+  EXPECT_EQ((vector<string>{"a", "b", "c"}), recorder.WaitForCalls(3));
+}
+
+TEST(CallbackDispatcherTest, ListenersTakeTurns) {
+  CallbackRecorder recorder;
+  CallbackDispatcher dispatcher;
+  dispatcher.Post(&kBlockingListener, CallbackDispatcher::kNoCoalescing,
+                  recorder.Block());
+  recorder.WaitUntilBlocked();
+  for (const string& name : {"a1", "a2", "a3"}) {
+    dispatcher.Post(&kListener1, CallbackDispatcher::kNoCoalescing,
+                    recorder.Record(name));
+  }
+  dispatcher.Post(&kListener2, CallbackDispatcher::kNoCoalescing,
+                  recorder.Record("b1"));
+  recorder.Open();
+  EXPECT_EQ((vector<string>{"a1", "b1", "a2", "a3"}),
+            recorder.WaitForCalls(4));
+}
+
+TEST(CallbackDispatcherTest, CoalescesLastQueuedCallback) {
+  constexpr int32_t kKey = 1;
+  CallbackRecorder recorder;
+  CallbackDispatcher dispatcher;
+  dispatcher.Post(&kBlockingListener, CallbackDispatcher::kNoCoalescing,
+                  recorder.Block());
+  recorder.WaitUntilBlocked();
+  dispatcher.Post(&kListener1, kKey, recorder.Record("a"));
+  dispatcher.Post(&kListener1, kKey, recorder.Record("b"));
+  dispatcher.Post(&kListener1, CallbackDispatcher::kNoCoalescing,
+                  recorder.Record("c"));
+  dispatcher.Post(&kListener1, kKey, recorder.Record("d"));
+  recorder.Open();
+  EXPECT_EQ((vector<string>{"b", "c", "d"}), recorder.WaitForCalls(3));
+}
+
+TEST(CallbackDispatcherTest, DropsOldestCoalescableCallbacksOfFullQueue) {
+  CallbackRecorder recorder;
+  CallbackDispatcher dispatcher;
+  dispatcher.Post(&kBlockingListener, CallbackDispatcher::kNoCoalescing,
+                  recorder.Block());
+  recorder.WaitUntilBlocked();
+  dispatcher.Post(&kListener1, CallbackDispatcher::kNoCoalescing,
+                  recorder.Record("first"));
+  for (size_t i = 1; i < CallbackDispatcher::kMaxQueuedCallbacks + 2; i++) {
+    // Every callback has a key of its own, so none is coalesced.
+    dispatcher.Post(&kListener1, static_cast<int32_t>(i),
+                    recorder.Record(std::to_string(i)));
+  }
+  recorder.Open();
+  vector<string> called =
+      recorder.WaitForCalls(CallbackDispatcher::kMaxQueuedCallbacks);
+  ASSERT_EQ(CallbackDispatcher::kMaxQueuedCallbacks, called.size());
+  EXPECT_EQ("first", called[0]);
+  EXPECT_EQ("3", called[1]);
+
+  std::stringstream ss;
+  dispatcher.Dump(&ss);
+  EXPECT_NE(string::npos, ss.str().find("dropped: 2"));
+}
+
+TEST(CallbackDispatcherTest, DropsSupersededCallbacksOfFullQueueFirst) {
+  constexpr int32_t kKey = 1000;
+  CallbackRecorder recorder;
+  CallbackDispatcher dispatcher;
+  dispatcher.Post(&kBlockingListener, CallbackDispatcher::kNoCoalescing,
+                  recorder.Block());
+  recorder.WaitUntilBlocked();
+  dispatcher.Post(&kListener1, 1, recorder.Record("1"));
+  dispatcher.Post(&kListener1, kKey, recorder.Record("a"));
+  for (size_t i = 2; i < CallbackDispatcher::kMaxQueuedCallbacks; i++) {
+    dispatcher.Post(&kListener1, CallbackDispatcher::kNoCoalescing,
+                    recorder.Record(std::to_string(i)));
+  }
+  dispatcher.Post(&kListener1, kKey, recorder.Record("b"));
+  recorder.Open();
+  vector<string> called =
+      recorder.WaitForCalls(CallbackDispatcher::kMaxQueuedCallbacks);
+  ASSERT_EQ(CallbackDispatcher::kMaxQueuedCallbacks, called.size());
+  EXPECT_EQ("1", called.front());
+  EXPECT_EQ("b", called.back());
+  EXPECT_EQ(called.end(), std::find(called.begin(), called.end(), "a"));
+}
+
+TEST(CallbackDispatcherTest, NeverDropsCallbacksThatAreNotCoalesced) {
+  CallbackRecorder recorder;
+  CallbackDispatcher dispatcher;
+  dispatcher.Post(&kBlockingListener, CallbackDispatcher::kNoCoalescing,
+                  recorder.Block());
+  recorder.WaitUntilBlocked();
+  constexpr size_t kNumCallbacks = CallbackDispatcher::kMaxQueuedCallbacks + 2;
+  for (size_t i = 0; i < kNumCallbacks; i++) {
+    dispatcher.Post(&kListener1, CallbackDispatcher::kNoCoalescing,
+                    recorder.Record(std::to_string(i)));
+  }
+  recorder.Open();
+  vector<string> called = recorder.WaitForCalls(kNumCallbacks);
+  ASSERT_EQ(kNumCallbacks, called.size());
+  EXPECT_EQ("0", called.front());
+  EXPECT_EQ(std::to_string(kNumCallbacks - 1), called.back());
+
+  std::stringstream ss;
+  dispatcher.Dump(&ss);
+  EXPECT_NE(string::npos, ss.str().find("dropped: 0"));
+}
+
+TEST(CallbackDispatcherTest, HoldsBackDeferrableCallbacksInLowPowerMode) {
+  CallbackRecorder recorder;
+  CallbackDispatcher dispatcher;
+  dispatcher.SetLowPowerMode(true);
+  dispatcher.Post(&kListener1, CallbackDispatcher::kNoCoalescing,
+                  recorder.Record("a"), true);
+  dispatcher.Post(&kListener2, CallbackDispatcher::kNoCoalescing,
+                  recorder.Record("b"), true);
+  // Callbacks that are not deferrable go first, after those held back for
+  // the same listener.
+  dispatcher.Post(&kListener1, CallbackDispatcher::kNoCoalescing,
+                  recorder.Record("c"));
+  EXPECT_EQ((vector<string>{"a", "c"}), recorder.WaitForCalls(2));
+
+  dispatcher.SetLowPowerMode(false);
+  EXPECT_EQ((vector<string>{"a", "c", "b"}), recorder.WaitForCalls(3));
+}
+
+}  // namespace wificond
+}  // namespace android
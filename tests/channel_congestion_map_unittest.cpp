@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "wificond/scanning/channel_congestion_map.h"
+#include "wificond/scanning/info_element_utils.h"
+
+using android::net::wifi::nl80211::NativeChannelCongestion;
+using android::net::wifi::nl80211::NativeScanResult;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+const vector<uint8_t> kSsidElement = {0x00, 0x02, 'a', 'b'};
+
+// Returns a scan result on |frequency|, with a BSS Load element of
+// |station_count| stations and |channel_utilization| if |has_load|.
+NativeScanResult CreateScanResult(uint32_t frequency,
+                                  bool has_load,
+                                  uint16_t station_count = 0,
+                                  uint8_t channel_utilization = 0) {
+  NativeScanResult scan_result;
+  scan_result.frequency = frequency;
+  scan_result.info_element = kSsidElement;
+  if (has_load) {
+    scan_result.info_element.insert(
+        scan_result.info_element.end(),
+        {11, 0x05, static_cast<uint8_t>(station_count & 0xff),
+         static_cast<uint8_t>(station_count >> 8), channel_utilization,
+         0x00, 0x00});
+  }
+  InfoElementUtils::IndexInfoElements(scan_result.info_element.data(),
+                                      scan_result.info_element.size(),
+                                      &scan_result.info_element_index);
+  return scan_result;
+}
+
+}  // namespace
+
+TEST(ChannelCongestionMapTest, AggregatesBssLoadPerChannel) {
+  ChannelCongestionMap map;
+  map.Assign({CreateScanResult(5180, true, 10, 100),
+              CreateScanResult(2412, true, 4, 200),
+              CreateScanResult(5180, true, 6, 50),
+              CreateScanResult(5180, false)});
+  const vector<NativeChannelCongestion>& channels = map.GetChannels();
+  ASSERT_EQ(2u, channels.size());
+
+  EXPECT_EQ(2412, channels[0].frequency_);
+  EXPECT_EQ(1, channels[0].num_bss_);
+  EXPECT_EQ(1, channels[0].num_bss_with_load_);
+  EXPECT_EQ(4, channels[0].num_stations_);
+  EXPECT_EQ(200, channels[0].channel_utilization_);
+
+  EXPECT_EQ(5180, channels[1].frequency_);
+  EXPECT_EQ(3, channels[1].num_bss_);
+  EXPECT_EQ(2, channels[1].num_bss_with_load_);
+  EXPECT_EQ(16, channels[1].num_stations_);
+  EXPECT_EQ(75, channels[1].channel_utilization_);
+  // 29% utilization, and 3 of kMaxBssPerChannel BSSs share the rest.
+  EXPECT_EQ(29 + 71 * 15 / 100, channels[1].congestion_percent_);
+}
+
+TEST(ChannelCongestionMapTest, UsesDensityWithoutBssLoad) {
+  ChannelCongestionMap map;
+  vector<NativeScanResult> scan_results;
+  for (int32_t i = 0; i < ChannelCongestionMap::kMaxBssPerChannel + 5; i++) {
+    scan_results.push_back(CreateScanResult(2437, false));
+  }
+  scan_results.push_back(CreateScanResult(2462, false));
+  map.Assign(scan_results);
+  const vector<NativeChannelCongestion>& channels = map.GetChannels();
+  ASSERT_EQ(2u, channels.size());
+  EXPECT_EQ(-1, channels[0].channel_utilization_);
+  EXPECT_EQ(100, channels[0].congestion_percent_);
+  EXPECT_EQ(100 / ChannelCongestionMap::kMaxBssPerChannel,
+            channels[1].congestion_percent_);
+}
+
+TEST(ChannelCongestionMapTest, IsRebuiltOnAssign) {
+  ChannelCongestionMap map;
+  map.Assign({CreateScanResult(2412, false)});
+  map.Assign({CreateScanResult(5180, false)});
+  ASSERT_EQ(1u, map.GetChannels().size());
+  EXPECT_EQ(5180, map.GetChannels()[0].frequency_);
+}
+
+}  // namespace wificond
+}  // namespace android
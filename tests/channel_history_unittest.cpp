@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/test_utils.h>
+#include <gtest/gtest.h>
+
+#include "wificond/scanning/channel_history.h"
+
+using std::string;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+const vector<uint8_t> kFakeSsid = {'G', 'u', 'e', 's', 't'};
+const vector<uint8_t> kFakeSsid1 = {'H', 'o', 'm', 'e'};
+
+}  // namespace
+
+TEST(ChannelHistoryTest, KeepsMostRecentlySeenFrequenciesFirst) {
+  ChannelHistory channel_history;
+  vector<uint32_t> frequencies;
+  EXPECT_FALSE(channel_history.Get(kFakeSsid, &frequencies));
+
+  channel_history.Add(kFakeSsid, 2412);
+  channel_history.Add(kFakeSsid, 5180);
+  channel_history.Add(kFakeSsid1, 2437);
+  channel_history.Add(kFakeSsid, 2412);
+  ASSERT_TRUE(channel_history.Get(kFakeSsid, &frequencies));
+  EXPECT_EQ((vector<uint32_t>{2412, 5180}), frequencies);
+  ASSERT_TRUE(channel_history.Get(kFakeSsid1, &frequencies));
+  EXPECT_EQ(vector<uint32_t>{2437}, frequencies);
+}
+
+TEST(ChannelHistoryTest, ForgetsLeastRecentlySeenFrequency) {
+  ChannelHistory channel_history;
+  for (uint32_t i = 0; i <= ChannelHistory::kMaxFrequencies; i++) {
+    channel_history.Add(kFakeSsid, 5180 + 20 * i);
+  }
+  vector<uint32_t> frequencies;
+  ASSERT_TRUE(channel_history.Get(kFakeSsid, &frequencies));
+  ASSERT_EQ(ChannelHistory::kMaxFrequencies, frequencies.size());
+  EXPECT_EQ(5180 + 20 * ChannelHistory::kMaxFrequencies, frequencies.front());
+  EXPECT_EQ(5200u, frequencies.back());
+}
+
+TEST(ChannelHistoryTest, KeepsRecentlySeenSsidsWhenFull) {
+  ChannelHistory channel_history;
+  // Twice as many SSIDs as there are entries.
+  vector<vector<uint8_t>> ssids;
+  for (size_t i = 0; i < 2 * ChannelHistory::kNumEntries; i++) {
+    ssids.push_back({static_cast<uint8_t>(i & 0xff),
+                     static_cast<uint8_t>(i >> 8)});
+    channel_history.Add(ssids.back(), 2412);
+    vector<uint32_t> frequencies;
+    EXPECT_TRUE(channel_history.Get(ssids.back(), &frequencies));
+  }
+  size_t num_known_ssids = 0;
+  for (const auto& ssid : ssids) {
+    vector<uint32_t> frequencies;
+    if (channel_history.Get(ssid, &frequencies)) {
+      num_known_ssids++;
+    }
+  }
+  EXPECT_LE(num_known_ssids, ChannelHistory::kNumEntries);
+}
+
+TEST(ChannelHistoryTest, IgnoresNetworksWithoutSsid) {
+  ChannelHistory channel_history;
+  channel_history.Add({}, 2412);
+  vector<uint32_t> frequencies;
+  EXPECT_FALSE(channel_history.Get({}, &frequencies));
+}
+
+TEST(ChannelHistoryTest, PersistsInFile) {
+  TemporaryFile history_file;
+  {
+    ChannelHistory channel_history;
+    ASSERT_TRUE(channel_history.Open(history_file.path));
+    channel_history.Add(kFakeSsid, 5180);
+  }
+  ChannelHistory channel_history;
+  ASSERT_TRUE(channel_history.Open(history_file.path));
+  vector<uint32_t> frequencies;
+  ASSERT_TRUE(channel_history.Get(kFakeSsid, &frequencies));
+  EXPECT_EQ(vector<uint32_t>{5180}, frequencies);
+}
+
+TEST(ChannelHistoryTest, DiscardsFileOfUnknownLayout) {
+  TemporaryFile history_file;
+  ASSERT_TRUE(android::base::WriteStringToFile(
+      string(ChannelHistory::GetSize(), 'x'), history_file.path));
+  ChannelHistory channel_history;
+  ASSERT_TRUE(channel_history.Open(history_file.path));
+  vector<uint32_t> frequencies;
+  EXPECT_FALSE(channel_history.Get(kFakeSsid, &frequencies));
+  channel_history.Add(kFakeSsid, 5180);
+  EXPECT_TRUE(channel_history.Get(kFakeSsid, &frequencies));
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "wificond/net/channel_set.h"
+
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+static_assert(ChannelSet::GetChannel(2412) == 1, "2.4 GHz channel 1");
+static_assert(ChannelSet::GetChannel(2484) == 14, "2.4 GHz channel 14");
+static_assert(ChannelSet::GetChannel(5180) == 36, "5 GHz channel 36");
+static_assert(ChannelSet::GetChannel(5935) == 2, "6 GHz channel 2");
+static_assert(ChannelSet::GetChannel(7115) == 233, "6 GHz channel 233");
+static_assert(ChannelSet::GetChannelFrequency(ChannelSet::kBand6Ghz, 5) ==
+                  5975,
+              "6 GHz channel 5");
+
+TEST(ChannelSetTest, MapsFrequenciesToChannels) {
+  for (uint32_t channel = 1; channel <= 14; channel++) {
+    uint32_t frequency =
+        ChannelSet::GetChannelFrequency(ChannelSet::kBand2Ghz, channel);
+    EXPECT_EQ(ChannelSet::kBand2Ghz, ChannelSet::GetBand(frequency));
+    EXPECT_EQ(channel, ChannelSet::GetChannel(frequency));
+  }
+  for (uint32_t channel = 1; channel <= 233; channel++) {
+    uint32_t frequency =
+        ChannelSet::GetChannelFrequency(ChannelSet::kBand6Ghz, channel);
+    EXPECT_EQ(ChannelSet::kBand6Ghz, ChannelSet::GetBand(frequency));
+    EXPECT_EQ(channel, ChannelSet::GetChannel(frequency));
+  }
+  EXPECT_EQ(0u, ChannelSet::GetChannelFrequency(ChannelSet::kBand2Ghz, 15));
+  EXPECT_EQ(ChannelSet::kBandNone, ChannelSet::GetBand(2400));
+  EXPECT_EQ(ChannelSet::kBandNone, ChannelSet::GetBand(5182));
+  EXPECT_EQ(0u, ChannelSet::GetChannel(5945));
+}
+
+TEST(ChannelSetTest, CanAddAndRemoveFrequencies) {
+  ChannelSet channels;
+  EXPECT_TRUE(channels.empty());
+  EXPECT_TRUE(channels.Add(2412));
+  EXPECT_TRUE(channels.Add(5180));
+  EXPECT_TRUE(channels.Add(7115));
+  EXPECT_FALSE(channels.Add(4000));
+  EXPECT_EQ(3u, channels.size());
+  EXPECT_TRUE(channels.Contains(5180));
+  EXPECT_FALSE(channels.Contains(5200));
+  EXPECT_FALSE(channels.Contains(4000));
+
+  channels.Remove(5180);
+  EXPECT_FALSE(channels.Contains(5180));
+  EXPECT_EQ(2u, channels.size());
+}
+
+TEST(ChannelSetTest, ListsFrequenciesInIncreasingOrder) {
+  ChannelSet channels(vector<uint32_t>{5975, 2484, 5180, 2412, 5180, 5935});
+  vector<uint32_t> frequencies;
+  channels.AppendTo(&frequencies);
+  EXPECT_EQ((vector<uint32_t>{2412, 2484, 5180, 5935, 5975}), frequencies);
+}
+
+TEST(ChannelSetTest, CanCombineSets) {
+  ChannelSet lhs(vector<uint32_t>{2412, 5180, 5975});
+  ChannelSet rhs(vector<uint32_t>{5180, 5975, 6055});
+  EXPECT_EQ(ChannelSet(vector<uint32_t>{2412, 5180, 5975, 6055}), lhs | rhs);
+  EXPECT_EQ(ChannelSet(vector<uint32_t>{5180, 5975}), lhs & rhs);
+  EXPECT_EQ(ChannelSet(vector<uint32_t>{2412}), lhs - rhs);
+  EXPECT_EQ(ChannelSet(vector<uint32_t>{5975}),
+            lhs & ChannelSet::GetBandChannels(ChannelSet::kBand6Ghz));
+}
+
+}  // namespace wificond
+}  // namespace android
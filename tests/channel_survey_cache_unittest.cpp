@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "wificond/channel_survey_cache.h"
+
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+ChannelSurvey CreateSurvey(uint32_t frequency,
+                           uint64_t active_time_ms,
+                           uint64_t busy_time_ms,
+                           uint64_t tx_time_ms) {
+  ChannelSurvey survey;
+  survey.frequency = frequency;
+  survey.active_time_ms = active_time_ms;
+  survey.busy_time_ms = busy_time_ms;
+  survey.tx_time_ms = tx_time_ms;
+  return survey;
+}
+
+}  // namespace
+
+TEST(ChannelSurveyCacheTest, RanksLeastBusyChannelsFirst) {
+  ChannelSurveyCache cache;
+  // Busy 50%, 10% and 30% of the time.
+  cache.Update({CreateSurvey(2412, 1000, 500, 0),
+                CreateSurvey(2437, 1000, 100, 0),
+                CreateSurvey(2462, 1000, 300, 0)});
+  vector<uint32_t> frequencies;
+  cache.GetRankedFrequencies(&frequencies);
+  EXPECT_EQ((vector<uint32_t>{2437, 2462, 2412}), frequencies);
+}
+
+TEST(ChannelSurveyCacheTest, DoesNotCountOwnTransmissions) {
+  ChannelSurveyCache cache;
+  // 2412 is busy with our own transmissions only.
+  cache.Update({CreateSurvey(2412, 1000, 600, 600),
+                CreateSurvey(2437, 1000, 100, 0)});
+  vector<uint32_t> frequencies;
+  cache.GetRankedFrequencies(&frequencies);
+  EXPECT_EQ((vector<uint32_t>{2412, 2437}), frequencies);
+}
+
+TEST(ChannelSurveyCacheTest, OnlyCountsTimeSinceLastUpdate) {
+  ChannelSurveyCache cache;
+  cache.Update({CreateSurvey(2412, 1000, 0, 0),
+                CreateSurvey(2437, 1000, 400, 0)});
+  // 2412 was busy the whole time since the first update, 2437 not at all.
+  // Averaged with the first update, 2412 is 50% busy and 2437 20%.
+  cache.Update({CreateSurvey(2412, 2000, 1000, 0),
+                CreateSurvey(2437, 2000, 400, 0)});
+  vector<uint32_t> frequencies;
+  cache.GetRankedFrequencies(&frequencies);
+  EXPECT_EQ((vector<uint32_t>{2437, 2412}), frequencies);
+}
+
+TEST(ChannelSurveyCacheTest, KeepsChannelsMissingFromUpdates) {
+  ChannelSurveyCache cache;
+  cache.Update({CreateSurvey(5180, 1000, 200, 0)});
+  cache.Update({CreateSurvey(2412, 1000, 100, 0)});
+  // No time passed on 5180, so it keeps its busy ratio.
+  cache.Update({CreateSurvey(5180, 1000, 200, 0)});
+  vector<uint32_t> frequencies;
+  cache.GetRankedFrequencies(&frequencies);
+  EXPECT_EQ((vector<uint32_t>{2412, 5180}), frequencies);
+}
+
+TEST(ChannelSurveyCacheTest, RanksQuieterChannelFirstOnTie) {
+  ChannelSurveyCache cache;
+  ChannelSurvey noisy = CreateSurvey(2412, 1000, 100, 0);
+  noisy.has_noise = true;
+  noisy.noise_dbm = -80;
+  ChannelSurvey quiet = CreateSurvey(2437, 1000, 100, 0);
+  quiet.has_noise = true;
+  quiet.noise_dbm = -95;
+  ChannelSurvey unknown = CreateSurvey(2462, 1000, 100, 0);
+  cache.Update({noisy, quiet, unknown});
+  vector<uint32_t> frequencies;
+  cache.GetRankedFrequencies(&frequencies);
+  EXPECT_EQ((vector<uint32_t>{2437, 2412, 2462}), frequencies);
+}
+
+TEST(ChannelSurveyCacheTest, SkipsChannelsWithoutActiveTime) {
+  ChannelSurveyCache cache;
+  cache.Update({CreateSurvey(2412, 0, 0, 0),
+                CreateSurvey(2437, 1000, 100, 0)});
+  vector<uint32_t> frequencies;
+  cache.GetRankedFrequencies(&frequencies);
+  EXPECT_EQ(vector<uint32_t>{2437}, frequencies);
+}
+
+}  // namespace wificond
+}  // namespace android
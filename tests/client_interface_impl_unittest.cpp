@@ -14,26 +14,49 @@
  * limitations under the License.
  */
 
+#include <sys/mman.h>
+
 #include <array>
+#include <functional>
 #include <memory>
+#include <utility>
 #include <vector>
 
+#include <binder/Binder.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <wifi_system_test/mock_interface_tool.h>
 
 #include "wificond/client_interface_impl.h"
+#include "wificond/net/kernel-header-latest/nl80211.h"
+#include "wificond/net/mlme_event.h"
+#include "wificond/net/nl80211_packet.h"
+#include "wificond/scanning/scan_result.h"
+#include "wificond/tests/fake_event_loop.h"
+#include "wificond/tests/mock_i_send_mgmt_frame_batch_event.h"
 #include "wificond/tests/mock_i_send_mgmt_frame_event.h"
+#include "wificond/tests/mock_link_quality_event_callback.h"
 #include "wificond/tests/mock_netlink_manager.h"
 #include "wificond/tests/mock_netlink_utils.h"
 #include "wificond/tests/mock_scan_utils.h"
 
+using android::base::unique_fd;
+using android::net::wifi::nl80211::IClientInterface;
+using android::net::wifi::nl80211::ILinkQualityEventCallback;
+using android::net::wifi::nl80211::ISendMgmtFrameEvent;
+using android::net::wifi::nl80211::NativeConnectionStats;
+using android::net::wifi::nl80211::NativeScanResult;
 using android::wifi_system::MockInterfaceTool;
 using std::unique_ptr;
 using std::vector;
 using testing::Mock;
 using testing::NiceMock;
+using testing::DoAll;
+using testing::ElementsAre;
 using testing::Return;
+using testing::SaveArg;
+using testing::SetArgPointee;
+using testing::SizeIs;
 using testing::StrictMock;
 using testing::_;
 
@@ -48,6 +71,94 @@ const uint64_t kCookie = 42;
 const int32_t kAutoMcs = -1;
 const int32_t kMcs = 5;
 const uint8_t kTestFrame[] = {0x00, 0x01, 0x02, 0x03};
+const std::array<uint8_t, ETH_ALEN> kTestBssid =
+    {0xc0, 0x3f, 0x0e, 0x77, 0xe8, 0x7f};
+const uint32_t kTestFrequency = 5180;
+const uint16_t kTestFamilyId = 14;
+
+// HT Operation element with primary channel 36.
+const vector<uint8_t> kTestHtOperationIE = {
+    0x3d, 0x16, 0x24, 0x05, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+
+// |frequency| and |response_ies| are not added to the event if they are
+// empty.
+unique_ptr<MlmeRoamEvent> CreateRoamEvent(
+    uint32_t frequency = 0,
+    const vector<uint8_t>& response_ies = {}) {
+  NL80211Packet roam(kTestFamilyId, NL80211_CMD_ROAM, 0, 0);
+  roam.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, kTestInterfaceIndex));
+  roam.AddAttribute(
+      NL80211Attr<std::array<uint8_t, ETH_ALEN>>(NL80211_ATTR_MAC,
+                                                  kTestBssid));
+  if (frequency != 0) {
+    roam.AddAttribute(
+        NL80211Attr<uint32_t>(NL80211_ATTR_WIPHY_FREQ, frequency));
+  }
+  if (!response_ies.empty()) {
+    roam.AddAttribute(
+        NL80211Attr<vector<uint8_t>>(NL80211_ATTR_RESP_IE, response_ies));
+  }
+  NL80211PacketView view = roam.GetView();
+  return MlmeRoamEvent::InitFromPacket(&view);
+}
+
+unique_ptr<MlmeDisconnectEvent> CreateDisconnectEvent() {
+  NL80211Packet disconnect(kTestFamilyId, NL80211_CMD_DISCONNECT, 0, 0);
+  disconnect.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, kTestInterfaceIndex));
+  disconnect.AddAttribute(
+      NL80211Attr<std::array<uint8_t, ETH_ALEN>>(NL80211_ATTR_MAC,
+                                                  kTestBssid));
+  NL80211PacketView view = disconnect.GetView();
+  return MlmeDisconnectEvent::InitFromPacket(&view);
+}
+
+// Reads the statistics of link stats memory |memory| like the framework.
+bool ReadLinkStats(int memory, LinkStats* out_stats) {
+  void* page = mmap(nullptr, LinkStatsPage::kPageSize, PROT_READ, MAP_SHARED,
+                    memory, 0);
+  if (page == MAP_FAILED) {
+    return false;
+  }
+  bool success = LinkStatsPage::Read(static_cast<const uint8_t*>(page),
+                                     LinkStatsPage::kPageSize, out_stats);
+  munmap(page, LinkStatsPage::kPageSize);
+  return success;
+}
+
+// Binder of a link statistics user, whose death is triggered by the test.
+class FakeTokenBinder : public BBinder {
+ public:
+  status_t linkToDeath(const sp<DeathRecipient>& recipient,
+                       void* cookie,
+                       uint32_t flags) override {
+    death_recipient_ = recipient;
+    return OK;
+  }
+
+  status_t unlinkToDeath(const wp<DeathRecipient>& recipient,
+                         void* cookie,
+                         uint32_t flags,
+                         wp<DeathRecipient>* out_recipient) override {
+    death_recipient_.clear();
+    return OK;
+  }
+
+  bool IsWatched() const { return death_recipient_ != nullptr; }
+
+  void Die() {
+    sp<DeathRecipient> death_recipient = death_recipient_.promote();
+    if (death_recipient != nullptr) {
+      death_recipient->binderDied(this);
+    }
+  }
+
+ private:
+  wp<DeathRecipient> death_recipient_;
+};
 
 class ClientInterfaceImplTest : public ::testing::Test {
  protected:
@@ -62,7 +173,8 @@ class ClientInterfaceImplTest : public ::testing::Test {
    */
   void SetUp(WiphyFeatures wiphy_features) {
     EXPECT_CALL(*netlink_utils_,
-                SubscribeMlmeEvent(kTestInterfaceIndex, _));
+                SubscribeMlmeEvent(kTestInterfaceIndex, _))
+        .WillOnce(SaveArg<1>(&mlme_event_handler_));
     EXPECT_CALL(*netlink_utils_,
                 GetWiphyInfo(kTestWiphyIndex, _, _, _))
       .WillOnce([wiphy_features](uint32_t wiphy_index, BandInfo* out_band_info,
@@ -78,7 +190,8 @@ class ClientInterfaceImplTest : public ::testing::Test {
           frame_tx_status_event_handler_ = handler;
         });
     EXPECT_CALL(*netlink_utils_,
-                SubscribeChannelSwitchEvent(kTestInterfaceIndex, _));
+                SubscribeChannelSwitchEvent(kTestInterfaceIndex, _))
+        .WillOnce(SaveArg<1>(&channel_switch_event_handler_));
     client_interface_.reset(new ClientInterfaceImpl{
         kTestWiphyIndex,
         kTestInterfaceName,
@@ -86,7 +199,8 @@ class ClientInterfaceImplTest : public ::testing::Test {
         std::array<uint8_t, ETH_ALEN>{0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
         if_tool_.get(),
         netlink_utils_.get(),
-        scan_utils_.get()});
+        scan_utils_.get(),
+        &event_loop_});
   }
 
   void TearDown() override {
@@ -98,6 +212,7 @@ class ClientInterfaceImplTest : public ::testing::Test {
                 UnsubscribeChannelSwitchEvent(kTestInterfaceIndex));
   }
 
+  FakeEventLoop event_loop_;
   unique_ptr<NiceMock<MockInterfaceTool>> if_tool_{
       new NiceMock<MockInterfaceTool>};
   unique_ptr<NiceMock<MockNetlinkManager>> netlink_manager_{
@@ -108,6 +223,8 @@ class ClientInterfaceImplTest : public ::testing::Test {
       new NiceMock<MockScanUtils>(netlink_manager_.get())};
   unique_ptr<ClientInterfaceImpl> client_interface_;
   OnFrameTxStatusEventHandler frame_tx_status_event_handler_;
+  OnChannelSwitchEventHandler channel_switch_event_handler_;
+  MlmeEventHandler* mlme_event_handler_ = nullptr;
   sp<StrictMock<MockISendMgmtFrameEvent>> send_mgmt_frame_event_{
       new StrictMock<MockISendMgmtFrameEvent>()};
 };  // class ClientInterfaceImplTest
@@ -279,13 +396,8 @@ TEST_F(ClientInterfaceImplTest, SendMgmtFrameNoTxCallbackTriggered) {
 
 /**
  * Second transmission was started even though no Tx Status event was received
- * for the first transmission. Should discard first transmission, and second
- * transmission should work normally.
- *
- * Since timeout of this SendMgmtFrame() is managed by framework, and framework
- * does not notify wificond when the call times out, wificond should still work
- * when a second call is made, even though it seems as though the first call is
- * still incomplete.
+ * for the first transmission. Both transmissions are tracked, and each tx
+ * status is reported to the callback of its frame.
  */
 TEST_F(ClientInterfaceImplTest, SendMgmtFrameSecondTxWhileFirstTxIncomplete) {
   EXPECT_CALL(*netlink_utils_,
@@ -303,7 +415,7 @@ TEST_F(ClientInterfaceImplTest, SendMgmtFrameSecondTxWhileFirstTxIncomplete) {
       return true;
     });
 
-  // first transmission; no tx status
+  // first transmission; no tx status yet
   client_interface_->SendMgmtFrame(
       vector<uint8_t>(std::begin(kTestFrame), std::end(kTestFrame)),
       send_mgmt_frame_event_, kAutoMcs);
@@ -314,15 +426,73 @@ TEST_F(ClientInterfaceImplTest, SendMgmtFrameSecondTxWhileFirstTxIncomplete) {
   EXPECT_CALL(*send_mgmt_frame_event2,
       OnFailure(send_mgmt_frame_event_->SEND_MGMT_FRAME_ERROR_NO_ACK));
 
-  // second transmission; yes tx status
+  // second transmission; its tx status arrives first
   client_interface_->SendMgmtFrame(
       vector<uint8_t>(std::begin(kTestFrame), std::end(kTestFrame)),
       send_mgmt_frame_event2, kAutoMcs);
   frame_tx_status_event_handler_(kCookie + 1, false);
 
-  // now trigger tx status for first call; nothing should happen (implicitly
-  // verified by StrictMock).
-  frame_tx_status_event_handler_(kCookie, false);
+  EXPECT_CALL(*send_mgmt_frame_event_, OnAck(_));
+  frame_tx_status_event_handler_(kCookie, true);
+  EXPECT_EQ(0u, event_loop_.GetNumDelayedTasks());
+}
+
+/**
+ * No tx status was received before the timeout.
+ */
+TEST_F(ClientInterfaceImplTest, SendMgmtFrameTimeout) {
+  EXPECT_CALL(*netlink_utils_,
+      SendMgmtFrame(kTestInterfaceIndex,
+          vector<uint8_t>(std::begin(kTestFrame), std::end(kTestFrame)),
+          kAutoMcs, _))
+    .WillOnce([](uint32_t interface_index, const vector<uint8_t>& frame,
+        int32_t mcs, uint64_t* out_cookie) {
+      *out_cookie = kCookie;
+      return true;
+    });
+
+  client_interface_->SendMgmtFrame(
+      vector<uint8_t>(std::begin(kTestFrame), std::end(kTestFrame)),
+      send_mgmt_frame_event_, kAutoMcs);
+
+  EXPECT_CALL(*send_mgmt_frame_event_,
+      OnFailure(send_mgmt_frame_event_->SEND_MGMT_FRAME_ERROR_TIMEOUT));
+  ASSERT_EQ(1u, event_loop_.GetNumDelayedTasks());
+  EXPECT_EQ(ClientInterfaceImpl::kFrameTxTimeoutMs,
+            event_loop_.RunDelayedTask());
+
+  // A late tx status is dropped.
+  frame_tx_status_event_handler_(kCookie, true);
+}
+
+/**
+ * Frames beyond the limit of frames in flight are rejected.
+ */
+TEST_F(ClientInterfaceImplTest, SendMgmtFrameTooManyInFlight) {
+  uint64_t next_cookie = kCookie;
+  EXPECT_CALL(*netlink_utils_,
+      SendMgmtFrame(kTestInterfaceIndex,
+          vector<uint8_t>(std::begin(kTestFrame), std::end(kTestFrame)),
+          kAutoMcs, _))
+    .Times(ClientInterfaceImpl::kMaxPendingFrameTxs)
+    .WillRepeatedly([&next_cookie](uint32_t interface_index,
+        const vector<uint8_t>& frame, int32_t mcs, uint64_t* out_cookie) {
+      *out_cookie = next_cookie++;
+      return true;
+    });
+  EXPECT_CALL(*send_mgmt_frame_event_, OnAck(_))
+      .Times(ClientInterfaceImpl::kMaxPendingFrameTxs);
+  EXPECT_CALL(*send_mgmt_frame_event_,
+      OnFailure(send_mgmt_frame_event_->SEND_MGMT_FRAME_ERROR_ALREADY_STARTED));
+
+  for (size_t i = 0; i <= ClientInterfaceImpl::kMaxPendingFrameTxs; i++) {
+    client_interface_->SendMgmtFrame(
+        vector<uint8_t>(std::begin(kTestFrame), std::end(kTestFrame)),
+        send_mgmt_frame_event_, kAutoMcs);
+  }
+  for (uint64_t cookie = kCookie; cookie < next_cookie; cookie++) {
+    frame_tx_status_event_handler_(cookie, true);
+  }
 }
 
 /**
@@ -371,5 +541,402 @@ TEST_F(ClientInterfaceImplTest, SendMgmtFrameInternalStateResetBetweenCalls) {
   frame_tx_status_event_handler_(new_cookie, false);
 }
 
+/**
+ * Frames of a batch are sent |spacing_ms| apart, and their results are
+ * reported together once the last frame completed.
+ */
+TEST_F(ClientInterfaceImplTest, SendMgmtFrameBatch) {
+  constexpr int32_t kSpacingMs = 20;
+  WiphyFeatures wiphy_features;
+  wiphy_features.supports_tx_mgmt_frame_mcs = true;
+  SetUp(wiphy_features);
+  sp<StrictMock<MockISendMgmtFrameBatchEvent>> batch_event{
+      new StrictMock<MockISendMgmtFrameBatchEvent>()};
+
+  vector<int32_t> mcs_rates;
+  uint64_t next_cookie = kCookie;
+  EXPECT_CALL(*netlink_utils_,
+      SendMgmtFrame(kTestInterfaceIndex,
+          vector<uint8_t>(std::begin(kTestFrame), std::end(kTestFrame)),
+          _, _))
+    .Times(3)
+    .WillRepeatedly([&mcs_rates, &next_cookie](uint32_t interface_index,
+        const vector<uint8_t>& frame, int32_t mcs, uint64_t* out_cookie) {
+      mcs_rates.push_back(mcs);
+      *out_cookie = next_cookie++;
+      return true;
+    });
+
+  client_interface_->SendMgmtFrameBatch(
+      vector<uint8_t>(std::begin(kTestFrame), std::end(kTestFrame)),
+      batch_event, {0, 3, 7}, kSpacingMs);
+  EXPECT_EQ(vector<int32_t>({0}), mcs_rates);
+  frame_tx_status_event_handler_(kCookie, true);
+
+  EXPECT_EQ(kSpacingMs, event_loop_.RunDelayedTask());
+  EXPECT_EQ(vector<int32_t>({0, 3}), mcs_rates);
+  frame_tx_status_event_handler_(kCookie + 1, false);
+
+  EXPECT_EQ(kSpacingMs, event_loop_.RunDelayedTask());
+  EXPECT_EQ(vector<int32_t>({0, 3, 7}), mcs_rates);
+
+  // The last frame times out.
+  EXPECT_CALL(*batch_event, OnResults(
+      SizeIs(3),
+      ElementsAre(0,
+                  ISendMgmtFrameEvent::SEND_MGMT_FRAME_ERROR_NO_ACK,
+                  ISendMgmtFrameEvent::SEND_MGMT_FRAME_ERROR_TIMEOUT)));
+  EXPECT_EQ(ClientInterfaceImpl::kFrameTxTimeoutMs,
+            event_loop_.RunDelayedTask());
+  EXPECT_EQ(0u, event_loop_.GetNumDelayedTasks());
+}
+
+/**
+ * Frames that fail right away still complete the batch.
+ */
+TEST_F(ClientInterfaceImplTest, SendMgmtFrameBatchMcsUnsupported) {
+  sp<StrictMock<MockISendMgmtFrameBatchEvent>> batch_event{
+      new StrictMock<MockISendMgmtFrameBatchEvent>()};
+  EXPECT_CALL(*netlink_utils_, SendMgmtFrame(_, _, _, _)).Times(0);
+
+  client_interface_->SendMgmtFrameBatch(
+      vector<uint8_t>(std::begin(kTestFrame), std::end(kTestFrame)),
+      batch_event, {kMcs, kMcs}, 0);
+
+  EXPECT_CALL(*batch_event, OnResults(
+      ElementsAre(0, 0),
+      ElementsAre(
+          ISendMgmtFrameEvent::SEND_MGMT_FRAME_ERROR_MCS_UNSUPPORTED,
+          ISendMgmtFrameEvent::SEND_MGMT_FRAME_ERROR_MCS_UNSUPPORTED)));
+  EXPECT_EQ(0, event_loop_.RunDelayedTask());
+  EXPECT_EQ(0u, event_loop_.GetNumDelayedTasks());
+}
+
+/**
+ * The associate frequency is taken from the interface, so that no scan result
+ * dump is needed.
+ */
+TEST_F(ClientInterfaceImplTest, GetsAssociateFrequencyFromInterface) {
+  EXPECT_CALL(*netlink_utils_,
+              GetInterfaceFrequency(kTestInterfaceIndex, _))
+      .WillOnce(DoAll(SetArgPointee<1>(kTestFrequency), Return(true)));
+  EXPECT_CALL(*scan_utils_, QueryScanResults(_, _, _)).Times(0);
+  mlme_event_handler_->OnRoam(CreateRoamEvent());
+
+  EXPECT_CALL(*netlink_utils_, GetStationInfo(kTestInterfaceIndex,
+                                              kTestBssid, _))
+      .WillOnce(Return(true));
+  vector<int32_t> signal_poll_results;
+  EXPECT_TRUE(client_interface_->SignalPoll(&signal_poll_results));
+  ASSERT_EQ(4u, signal_poll_results.size());
+  EXPECT_EQ(static_cast<int32_t>(kTestFrequency), signal_poll_results[2]);
+}
+
+/**
+ * The associate frequency falls back to the associated scan result if the
+ * driver does not report the frequency of the interface.
+ */
+TEST_F(ClientInterfaceImplTest, GetsAssociateFrequencyFromScanResults) {
+  NativeScanResult associated_bss;
+  associated_bss.bssid = kTestBssid;
+  associated_bss.frequency = kTestFrequency;
+  associated_bss.associated = true;
+  vector<NativeScanResult> scan_results = {associated_bss};
+  EXPECT_CALL(*netlink_utils_,
+              GetInterfaceFrequency(kTestInterfaceIndex, _))
+      .WillOnce(Return(false));
+  EXPECT_CALL(*scan_utils_, QueryScanResults(kTestInterfaceIndex, _, _))
+      .WillOnce(DoAll(SetArgPointee<2>(scan_results), Return(true)));
+  mlme_event_handler_->OnRoam(CreateRoamEvent());
+
+  EXPECT_CALL(*netlink_utils_, GetStationInfo(kTestInterfaceIndex,
+                                              kTestBssid, _))
+      .WillOnce(Return(true));
+  vector<int32_t> signal_poll_results;
+  EXPECT_TRUE(client_interface_->SignalPoll(&signal_poll_results));
+  ASSERT_EQ(4u, signal_poll_results.size());
+  EXPECT_EQ(static_cast<int32_t>(kTestFrequency), signal_poll_results[2]);
+}
+
+/**
+ * The associate frequency is taken from the roam event without querying
+ * kernel if the event reports it.
+ */
+TEST_F(ClientInterfaceImplTest, GetsAssociateFrequencyFromRoamEvent) {
+  EXPECT_CALL(*netlink_utils_, GetInterfaceFrequency(_, _)).Times(0);
+  EXPECT_CALL(*scan_utils_, QueryScanResults(_, _, _)).Times(0);
+  unique_ptr<MlmeRoamEvent> roam_event = CreateRoamEvent(kTestFrequency);
+  ASSERT_NE(nullptr, roam_event);
+  EXPECT_EQ(kTestFrequency, roam_event->GetFrequency());
+  EXPECT_TRUE(roam_event->GetResponseIEs().empty());
+  EXPECT_GT(roam_event->GetTimestampNanos(), 0);
+  mlme_event_handler_->OnRoam(std::move(roam_event));
+
+  EXPECT_CALL(*netlink_utils_, GetStationInfo(kTestInterfaceIndex,
+                                              kTestBssid, _))
+      .WillOnce(Return(true));
+  vector<int32_t> signal_poll_results;
+  EXPECT_TRUE(client_interface_->SignalPoll(&signal_poll_results));
+  ASSERT_EQ(4u, signal_poll_results.size());
+  EXPECT_EQ(static_cast<int32_t>(kTestFrequency), signal_poll_results[2]);
+}
+
+/**
+ * Without NL80211_ATTR_WIPHY_FREQ the frequency of a roam event comes from
+ * the HT Operation element of the reassociation response.
+ */
+TEST_F(ClientInterfaceImplTest, GetsAssociateFrequencyFromResponseIEs) {
+  EXPECT_CALL(*netlink_utils_, GetInterfaceFrequency(_, _)).Times(0);
+  unique_ptr<MlmeRoamEvent> roam_event =
+      CreateRoamEvent(0, kTestHtOperationIE);
+  ASSERT_NE(nullptr, roam_event);
+  EXPECT_EQ(kTestHtOperationIE, roam_event->GetResponseIEs());
+  EXPECT_EQ(kTestFrequency, roam_event->GetFrequency());
+  mlme_event_handler_->OnRoam(std::move(roam_event));
+
+  EXPECT_CALL(*netlink_utils_, GetStationInfo(kTestInterfaceIndex,
+                                              kTestBssid, _))
+      .WillOnce(Return(true));
+  vector<int32_t> signal_poll_results;
+  EXPECT_TRUE(client_interface_->SignalPoll(&signal_poll_results));
+  ASSERT_EQ(4u, signal_poll_results.size());
+  EXPECT_EQ(static_cast<int32_t>(kTestFrequency), signal_poll_results[2]);
+}
+
+/**
+ * Signal polls and packet counter queries that come back to back share one
+ * station info request.
+ */
+TEST_F(ClientInterfaceImplTest, SharesStationInfoWithinPollingWindow) {
+  EXPECT_CALL(*netlink_utils_, GetInterfaceFrequency(kTestInterfaceIndex, _))
+      .WillOnce(DoAll(SetArgPointee<1>(kTestFrequency), Return(true)));
+  mlme_event_handler_->OnRoam(CreateRoamEvent());
+
+  StationInfo station_info(100, 5, 540, -60, 650);
+  EXPECT_CALL(*netlink_utils_, GetStationInfo(kTestInterfaceIndex,
+                                              kTestBssid, _))
+      .WillOnce(DoAll(SetArgPointee<2>(station_info), Return(true)));
+  vector<int32_t> signal_poll_results;
+  EXPECT_TRUE(client_interface_->SignalPoll(&signal_poll_results));
+  vector<int32_t> packet_counters;
+  EXPECT_TRUE(client_interface_->GetPacketCounters(&packet_counters));
+  vector<int32_t> station_info_results;
+  EXPECT_TRUE(client_interface_->PollStationInfo(&station_info_results));
+
+  EXPECT_EQ(vector<int32_t>({-60, 54, static_cast<int32_t>(kTestFrequency), 65}),
+            signal_poll_results);
+  EXPECT_EQ(vector<int32_t>({100, 5}), packet_counters);
+  EXPECT_EQ(vector<int32_t>({-60, 54, static_cast<int32_t>(kTestFrequency), 65,
+                             100, 5}),
+            station_info_results);
+}
+
+/**
+ * A channel switch moves the associated BSS without querying kernel for its
+ * frequency, and station info measured on the old channel is not reused.
+ */
+TEST_F(ClientInterfaceImplTest, FollowsChannelSwitchOfAssociatedBss) {
+  EXPECT_CALL(*netlink_utils_, GetInterfaceFrequency(_, _)).Times(0);
+  mlme_event_handler_->OnRoam(CreateRoamEvent(kTestFrequency));
+
+  EXPECT_CALL(*netlink_utils_, GetStationInfo(kTestInterfaceIndex,
+                                              kTestBssid, _))
+      .Times(2)
+      .WillRepeatedly(Return(true));
+  vector<int32_t> signal_poll_results;
+  EXPECT_TRUE(client_interface_->SignalPoll(&signal_poll_results));
+  ASSERT_TRUE(channel_switch_event_handler_);
+  channel_switch_event_handler_(5745, BW_80);
+  signal_poll_results.clear();
+  EXPECT_TRUE(client_interface_->SignalPoll(&signal_poll_results));
+  ASSERT_EQ(4u, signal_poll_results.size());
+  EXPECT_EQ(5745, signal_poll_results[2]);
+}
+
+/**
+ * Connection quality monitor events are forwarded to the link quality
+ * callback until it is unregistered.
+ */
+TEST_F(ClientInterfaceImplTest, ForwardsCqmEventsToLinkQualityCallback) {
+  sp<StrictMock<MockLinkQualityEventCallback>> callback(
+      new StrictMock<MockLinkQualityEventCallback>());
+  OnCqmEventHandler cqm_event_handler;
+  EXPECT_CALL(*netlink_utils_, SetCqmRssiConfig(kTestInterfaceIndex, -70, 4))
+      .WillOnce(Return(true));
+  EXPECT_CALL(*netlink_utils_,
+              SetCqmTxErrorConfig(kTestInterfaceIndex, 20, _, _))
+      .WillOnce(Return(true));
+  EXPECT_CALL(*netlink_utils_, SubscribeCqmEvent(kTestInterfaceIndex, _))
+      .WillOnce(SaveArg<1>(&cqm_event_handler));
+  EXPECT_TRUE(client_interface_->RegisterLinkQualityCallback(
+      callback, -70, 4, 20));
+
+  EXPECT_CALL(*callback, onLinkQualityChanged(
+      ILinkQualityEventCallback::LINK_QUALITY_RSSI_LOW, -72, 0));
+  cqm_event_handler(CQM_RSSI_LOW, -72, 0);
+  EXPECT_CALL(*callback, onLinkQualityChanged(
+      ILinkQualityEventCallback::LINK_QUALITY_PACKET_LOSS, 0, 10));
+  cqm_event_handler(CQM_PACKET_LOSS, 0, 10);
+
+  EXPECT_CALL(*netlink_utils_, UnsubscribeCqmEvent(kTestInterfaceIndex));
+  EXPECT_CALL(*netlink_utils_, SetCqmRssiConfig(kTestInterfaceIndex, 0, 0));
+  EXPECT_CALL(*netlink_utils_,
+              SetCqmTxErrorConfig(kTestInterfaceIndex, 0, 0, 0));
+  client_interface_->UnregisterLinkQualityCallback();
+}
+
+/**
+ * The connection quality monitor is disabled when the interface is torn down
+ * with a link quality callback still registered.
+ */
+TEST_F(ClientInterfaceImplTest, DisablesCqmOnDestruction) {
+  sp<StrictMock<MockLinkQualityEventCallback>> callback(
+      new StrictMock<MockLinkQualityEventCallback>());
+  EXPECT_CALL(*netlink_utils_, SetCqmRssiConfig(kTestInterfaceIndex, -70, 4))
+      .WillOnce(Return(true));
+  EXPECT_CALL(*netlink_utils_, SubscribeCqmEvent(kTestInterfaceIndex, _));
+  EXPECT_TRUE(client_interface_->RegisterLinkQualityCallback(
+      callback, -70, 4, 0));
+
+  EXPECT_CALL(*netlink_utils_, UnsubscribeCqmEvent(kTestInterfaceIndex));
+  EXPECT_CALL(*netlink_utils_, SetCqmRssiConfig(kTestInterfaceIndex, 0, 0));
+  EXPECT_CALL(*netlink_utils_,
+              SetCqmTxErrorConfig(kTestInterfaceIndex, 0, 0, 0));
+  // |client_interface_| is destroyed along with the fixture.
+}
+
+/**
+ * Registering fails if the driver does not support RSSI monitoring, so that
+ * the framework keeps polling.
+ */
+TEST_F(ClientInterfaceImplTest, CannotRegisterLinkQualityCallbackWithoutCqm) {
+  sp<StrictMock<MockLinkQualityEventCallback>> callback(
+      new StrictMock<MockLinkQualityEventCallback>());
+  EXPECT_CALL(*netlink_utils_, SetCqmRssiConfig(kTestInterfaceIndex, -70, 4))
+      .WillOnce(Return(false));
+  EXPECT_CALL(*netlink_utils_, SubscribeCqmEvent(_, _)).Times(0);
+  EXPECT_FALSE(client_interface_->RegisterLinkQualityCallback(
+      callback, -70, 4, 0));
+}
+
+/**
+ * The link statistics memory is refreshed periodically and on connection
+ * events, until it is released.
+ */
+TEST_F(ClientInterfaceImplTest, RefreshesLinkStatsMemory) {
+  EXPECT_CALL(*netlink_utils_, GetInterfaceFrequency(kTestInterfaceIndex, _))
+      .WillOnce(DoAll(SetArgPointee<1>(kTestFrequency), Return(true)));
+  // Nothing is fetched for the memory before it is requested.
+  EXPECT_CALL(*netlink_utils_, GetStationInfo(_, _, _)).Times(0);
+  mlme_event_handler_->OnRoam(CreateRoamEvent());
+  Mock::VerifyAndClearExpectations(netlink_utils_.get());
+
+  StationInfo station_info(100, 5, 540, -60, 650);
+  EXPECT_CALL(*netlink_utils_, GetStationInfo(kTestInterfaceIndex,
+                                              kTestBssid, _))
+      .WillRepeatedly(DoAll(SetArgPointee<2>(station_info), Return(true)));
+  sp<FakeTokenBinder> token = new FakeTokenBinder();
+  unique_fd memory;
+  ASSERT_TRUE(client_interface_->EnableLinkStatsPage(token, 1, &memory));
+  EXPECT_TRUE(token->IsWatched());
+  LinkStats stats;
+  ASSERT_TRUE(ReadLinkStats(memory.get(), &stats));
+  EXPECT_TRUE(stats.associated);
+  EXPECT_EQ(-60, stats.rssi_dbm);
+  EXPECT_EQ(kTestFrequency, stats.frequency_mhz);
+  EXPECT_EQ(54u, stats.tx_bitrate_mbps);
+  EXPECT_EQ(65u, stats.rx_bitrate_mbps);
+  EXPECT_EQ(100, stats.tx_packets);
+  EXPECT_EQ(5, stats.tx_failed);
+
+  // Short intervals are rounded up, and the refresh keeps rescheduling
+  // itself.
+  ASSERT_EQ(1u, event_loop_.GetNumDelayedTasks());
+  EXPECT_EQ(IClientInterface::MIN_LINK_STATS_REFRESH_INTERVAL_MS,
+            event_loop_.RunDelayedTask());
+  EXPECT_EQ(1u, event_loop_.GetNumDelayedTasks());
+
+  mlme_event_handler_->OnDisconnect(CreateDisconnectEvent());
+  ASSERT_TRUE(ReadLinkStats(memory.get(), &stats));
+  EXPECT_FALSE(stats.associated);
+
+  client_interface_->DisableLinkStatsPage();
+  EXPECT_EQ(0u, event_loop_.GetNumDelayedTasks());
+  EXPECT_FALSE(token->IsWatched());
+}
+
+/**
+ * Kernel is not polled for link statistics while not associated.
+ */
+TEST_F(ClientInterfaceImplTest, PausesLinkStatsRefreshWhileNotAssociated) {
+  EXPECT_CALL(*netlink_utils_, GetStationInfo(_, _, _)).Times(0);
+  sp<FakeTokenBinder> token = new FakeTokenBinder();
+  unique_fd memory;
+  ASSERT_TRUE(client_interface_->EnableLinkStatsPage(
+      token, IClientInterface::MIN_LINK_STATS_REFRESH_INTERVAL_MS, &memory));
+  LinkStats stats;
+  ASSERT_TRUE(ReadLinkStats(memory.get(), &stats));
+  EXPECT_FALSE(stats.associated);
+  EXPECT_EQ(0u, event_loop_.GetNumDelayedTasks());
+  Mock::VerifyAndClearExpectations(netlink_utils_.get());
+
+  // The periodic refresh starts with the association.
+  EXPECT_CALL(*netlink_utils_, GetInterfaceFrequency(kTestInterfaceIndex, _))
+      .WillOnce(DoAll(SetArgPointee<1>(kTestFrequency), Return(true)));
+  StationInfo station_info(100, 5, 540, -60, 650);
+  EXPECT_CALL(*netlink_utils_, GetStationInfo(kTestInterfaceIndex,
+                                              kTestBssid, _))
+      .WillRepeatedly(DoAll(SetArgPointee<2>(station_info), Return(true)));
+  mlme_event_handler_->OnRoam(CreateRoamEvent());
+  EXPECT_EQ(1u, event_loop_.GetNumDelayedTasks());
+
+  // And stops with the disconnection.
+  mlme_event_handler_->OnDisconnect(CreateDisconnectEvent());
+  EXPECT_EQ(0u, event_loop_.GetNumDelayedTasks());
+}
+
+/**
+ * The link statistics memory is released when its user dies.
+ */
+TEST_F(ClientInterfaceImplTest, ReleasesLinkStatsMemoryWhenUserDies) {
+  EXPECT_CALL(*netlink_utils_, GetInterfaceFrequency(kTestInterfaceIndex, _))
+      .WillOnce(DoAll(SetArgPointee<1>(kTestFrequency), Return(true)));
+  mlme_event_handler_->OnRoam(CreateRoamEvent());
+  StationInfo station_info(100, 5, 540, -60, 650);
+  EXPECT_CALL(*netlink_utils_, GetStationInfo(kTestInterfaceIndex,
+                                              kTestBssid, _))
+      .WillRepeatedly(DoAll(SetArgPointee<2>(station_info), Return(true)));
+  sp<FakeTokenBinder> token = new FakeTokenBinder();
+  unique_fd memory;
+  ASSERT_TRUE(client_interface_->EnableLinkStatsPage(token, 1, &memory));
+  ASSERT_EQ(1u, event_loop_.GetNumDelayedTasks());
+
+  token->Die();
+  EXPECT_EQ(0u, event_loop_.GetNumDelayedTasks());
+  EXPECT_FALSE(token->IsWatched());
+}
+
+TEST_F(ClientInterfaceImplTest, RecordsConnectionTimeline) {
+  EXPECT_CALL(*netlink_utils_,
+              GetInterfaceFrequency(kTestInterfaceIndex, _))
+      .WillOnce(DoAll(SetArgPointee<1>(kTestFrequency), Return(true)));
+  mlme_event_handler_->OnRoam(CreateRoamEvent());
+  mlme_event_handler_->OnDisconnect(CreateDisconnectEvent());
+
+  NativeConnectionStats connection_stats;
+  client_interface_->GetConnectionStats(&connection_stats);
+  EXPECT_EQ(1, connection_stats.num_connects_);
+  EXPECT_EQ(1, connection_stats.num_disconnects_);
+  ASSERT_EQ(2u, connection_stats.events_.size());
+  EXPECT_EQ(IClientInterface::CONNECTION_EVENT_ROAM,
+            connection_stats.events_[0].type_);
+  EXPECT_EQ(vector<uint8_t>(kTestBssid.begin(), kTestBssid.end()),
+            connection_stats.events_[0].bssid_);
+  EXPECT_EQ(IClientInterface::CONNECTION_EVENT_DISCONNECT,
+            connection_stats.events_[1].type_);
+  EXPECT_EQ(vector<uint8_t>(kTestBssid.begin(), kTestBssid.end()),
+            connection_stats.events_[1].previous_bssid_);
+}
+
 }  // namespace wificond
 }  // namespace android
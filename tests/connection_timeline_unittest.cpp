@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <array>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "android/net/wifi/nl80211/IClientInterface.h"
+#include "wificond/connection_timeline.h"
+
+using android::net::wifi::nl80211::IClientInterface;
+using android::net::wifi::nl80211::NativeConnectionStats;
+using std::array;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr int64_t kNanosPerMilli = 1000000;
+constexpr int64_t kFakeStartTimeNs = 1000 * kNanosPerMilli;
+const array<uint8_t, ETH_ALEN> kFakeBssid1 =
+    {{0x12, 0x34, 0x56, 0x78, 0xab, 0xcd}};
+const array<uint8_t, ETH_ALEN> kFakeBssid2 =
+    {{0x12, 0x34, 0x56, 0x78, 0xab, 0xce}};
+
+}  // namespace
+
+TEST(ConnectionTimelineTest, MeasuresConnectLatency) {
+  ConnectionTimeline timeline;
+  timeline.OnAuthenticate(kFakeStartTimeNs, kFakeBssid1, false);
+  timeline.OnAssociate(kFakeStartTimeNs + 80 * kNanosPerMilli,
+                       kFakeBssid1, 0, false);
+
+  const NativeConnectionStats& stats = timeline.GetStats();
+  EXPECT_EQ(1, stats.num_connects_);
+  EXPECT_EQ(0, stats.num_roams_);
+  EXPECT_EQ((vector<int32_t>{0, 1, 0, 0, 0, 0, 0}),
+            stats.connect_latency_histogram_);
+  ASSERT_EQ(2u, stats.events_.size());
+  EXPECT_EQ(IClientInterface::CONNECTION_EVENT_AUTHENTICATE,
+            stats.events_[0].type_);
+  EXPECT_EQ(-1, stats.events_[0].latency_ms_);
+  EXPECT_EQ(IClientInterface::CONNECTION_EVENT_ASSOCIATE,
+            stats.events_[1].type_);
+  EXPECT_EQ(80, stats.events_[1].latency_ms_);
+  EXPECT_EQ(vector<uint8_t>(kFakeBssid1.begin(), kFakeBssid1.end()),
+            stats.events_[1].bssid_);
+  EXPECT_TRUE(stats.events_[1].previous_bssid_.empty());
+}
+
+TEST(ConnectionTimelineTest, MeasuresRoamLatency) {
+  ConnectionTimeline timeline;
+  timeline.OnConnect(kFakeStartTimeNs, kFakeBssid1, 0, false);
+  timeline.OnAuthenticate(kFakeStartTimeNs + 5000 * kNanosPerMilli,
+                          kFakeBssid2, false);
+  timeline.OnAssociate(kFakeStartTimeNs + 8000 * kNanosPerMilli,
+                       kFakeBssid2, 0, false);
+
+  const NativeConnectionStats& stats = timeline.GetStats();
+  EXPECT_EQ(1, stats.num_connects_);
+  EXPECT_EQ(1, stats.num_roams_);
+  // The connect did not start with an authentication.
+  EXPECT_EQ((vector<int32_t>{0, 0, 0, 0, 0, 0, 0}),
+            stats.connect_latency_histogram_);
+  EXPECT_EQ((vector<int32_t>{0, 0, 0, 0, 0, 0, 1}),
+            stats.roam_latency_histogram_);
+  ASSERT_EQ(3u, stats.events_.size());
+  EXPECT_EQ(3000, stats.events_[2].latency_ms_);
+  EXPECT_EQ(vector<uint8_t>(kFakeBssid2.begin(), kFakeBssid2.end()),
+            stats.events_[2].bssid_);
+  EXPECT_EQ(vector<uint8_t>(kFakeBssid1.begin(), kFakeBssid1.end()),
+            stats.events_[2].previous_bssid_);
+}
+
+TEST(ConnectionTimelineTest, CountsConnectOfAssociatedBssOnce) {
+  ConnectionTimeline timeline;
+  timeline.OnAuthenticate(kFakeStartTimeNs, kFakeBssid1, false);
+  timeline.OnAssociate(kFakeStartTimeNs + 40 * kNanosPerMilli,
+                       kFakeBssid1, 0, false);
+  timeline.OnConnect(kFakeStartTimeNs + 50 * kNanosPerMilli,
+                     kFakeBssid1, 0, false);
+
+  const NativeConnectionStats& stats = timeline.GetStats();
+  EXPECT_EQ(1, stats.num_connects_);
+  EXPECT_EQ(0, stats.num_roams_);
+  EXPECT_EQ((vector<int32_t>{1, 0, 0, 0, 0, 0, 0}),
+            stats.connect_latency_histogram_);
+}
+
+TEST(ConnectionTimelineTest, CountsFailuresAndDisconnects) {
+  ConnectionTimeline timeline;
+  timeline.OnAuthenticate(kFakeStartTimeNs, kFakeBssid1, true);
+  timeline.OnConnect(kFakeStartTimeNs + 10 * kNanosPerMilli,
+                     kFakeBssid1, 17, false);
+  timeline.OnConnect(kFakeStartTimeNs + 20 * kNanosPerMilli,
+                     kFakeBssid1, 0, false);
+  timeline.OnDisassociate(kFakeStartTimeNs + 30 * kNanosPerMilli);
+  timeline.OnDisconnect(kFakeStartTimeNs + 40 * kNanosPerMilli);
+
+  const NativeConnectionStats& stats = timeline.GetStats();
+  EXPECT_EQ(2, stats.num_connect_failures_);
+  EXPECT_EQ(1, stats.num_connects_);
+  EXPECT_EQ(1, stats.num_disconnects_);
+  ASSERT_EQ(5u, stats.events_.size());
+  EXPECT_TRUE(stats.events_[0].is_timeout_);
+  EXPECT_EQ(17, stats.events_[1].status_code_);
+  EXPECT_EQ(vector<uint8_t>(kFakeBssid1.begin(), kFakeBssid1.end()),
+            stats.events_[3].previous_bssid_);
+}
+
+TEST(ConnectionTimelineTest, DropsStaleAttempts) {
+  ConnectionTimeline timeline;
+  timeline.OnAuthenticate(kFakeStartTimeNs, kFakeBssid1, false);
+  timeline.OnAssociate(
+      kFakeStartTimeNs +
+          (ConnectionTimeline::kMaxAttemptMs + 1) * kNanosPerMilli,
+      kFakeBssid1, 0, false);
+
+  const NativeConnectionStats& stats = timeline.GetStats();
+  EXPECT_EQ(1, stats.num_connects_);
+  EXPECT_EQ((vector<int32_t>{0, 0, 0, 0, 0, 0, 0}),
+            stats.connect_latency_histogram_);
+}
+
+TEST(ConnectionTimelineTest, KeepsLatestEvents) {
+  ConnectionTimeline timeline;
+  for (size_t i = 0; i < ConnectionTimeline::kMaxEvents + 1; i++) {
+    timeline.OnDisconnect(kFakeStartTimeNs + i * kNanosPerMilli);
+  }
+  const NativeConnectionStats& stats = timeline.GetStats();
+  ASSERT_EQ(ConnectionTimeline::kMaxEvents, stats.events_.size());
+  EXPECT_EQ(kFakeStartTimeNs + kNanosPerMilli,
+            stats.events_.front().timestamp_ns_);
+}
+
+}  // namespace wificond
+}  // namespace android
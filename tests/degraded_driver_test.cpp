@@ -0,0 +1,298 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <linux/netlink.h>
+#include <unistd.h>
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <utils/Timers.h>
+
+#include "android/net/wifi/nl80211/IWifiScannerImpl.h"
+#include "wificond/net/kernel-header-latest/nl80211.h"
+#include "wificond/net/nl80211_packet.h"
+#include "wificond/scanning/scan_result.h"
+#include "wificond/scanning/scan_utils.h"
+#include "wificond/tests/fake_event_loop.h"
+#include "wificond/tests/fault_injecting_netlink_manager.h"
+#include "wificond/tests/mock_netlink_manager.h"
+
+using android::net::wifi::nl80211::IWifiScannerImpl;
+using android::net::wifi::nl80211::NativeScanResult;
+using std::function;
+using std::unique_ptr;
+using std::vector;
+using testing::Invoke;
+using testing::NiceMock;
+using testing::Return;
+using testing::SaveArg;
+using testing::_;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr uint16_t kFakeFamilyId = 14;
+constexpr uint32_t kFakeInterfaceIndex = 12;
+constexpr uint32_t kFakeSequenceNumber = 1984;
+constexpr int kFakeResponseTimeoutMs = 50;
+// Long enough to tell a request that waited for it from one that did not.
+constexpr int kFakeHungDriverDelayMs = 10000;
+const std::array<uint8_t, ETH_ALEN> kFakeBssid1 =
+    {0x45, 0x54, 0xad, 0x67, 0x98, 0xf6};
+const std::array<uint8_t, ETH_ALEN> kFakeBssid2 =
+    {0x45, 0x54, 0xad, 0x67, 0x98, 0xf7};
+
+NL80211Packet CreateAck() {
+  vector<uint8_t> data(NLMSG_HDRLEN + NLA_ALIGN(sizeof(int)), 0);
+  nlmsghdr* nl_header = reinterpret_cast<nlmsghdr*>(data.data());
+  nl_header->nlmsg_len = data.size();
+  nl_header->nlmsg_type = NLMSG_ERROR;
+  nl_header->nlmsg_seq = kFakeSequenceNumber;
+  nl_header->nlmsg_pid = getpid();
+  return NL80211Packet(data);
+}
+
+NL80211Packet CreateScanResult(const std::array<uint8_t, ETH_ALEN>& bssid) {
+  NL80211Packet scan_result(
+      kFakeFamilyId,
+      NL80211_CMD_NEW_SCAN_RESULTS,
+      kFakeSequenceNumber,
+      getpid());
+  scan_result.AddFlag(NLM_F_MULTI);
+  scan_result.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_GENERATION, 1));
+  scan_result.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, kFakeInterfaceIndex));
+  NL80211NestedAttr bss(NL80211_ATTR_BSS);
+  bss.AddAttribute(NL80211Attr<std::array<uint8_t, ETH_ALEN>>(
+      NL80211_BSS_BSSID, bssid));
+  bss.AddAttribute(NL80211Attr<uint32_t>(NL80211_BSS_FREQUENCY, 2412));
+  bss.AddAttribute(NL80211Attr<vector<uint8_t>>(
+      NL80211_BSS_INFORMATION_ELEMENTS, {0x00, 0x02, 'a', 'b'}));
+  bss.AddAttribute(NL80211Attr<uint64_t>(
+      NL80211_BSS_LAST_SEEN_BOOTTIME, 123456000));
+  bss.AddAttribute(NL80211Attr<int32_t>(NL80211_BSS_SIGNAL_MBM, -4500));
+  bss.AddAttribute(NL80211Attr<uint16_t>(NL80211_BSS_CAPABILITY, 0));
+  scan_result.AddAttribute(bss);
+  return scan_result;
+}
+
+int64_t GetElapsedMs(nsecs_t start_time) {
+  return ns2ms(systemTime(SYSTEM_TIME_MONOTONIC) - start_time);
+}
+
+}  // namespace
+
+// Checks how the users of NetlinkManager behave when the driver is slow,
+// fails requests or loses events.
+// These tests wait for real time, which is why they are not unit tests.
+class DegradedDriverTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ON_CALL(netlink_manager_, GetFamilyId())
+        .WillByDefault(Return(kFakeFamilyId));
+    ON_CALL(netlink_manager_, SendMessageAndGetResponses(_, _))
+        .WillByDefault(Invoke(
+            [](const NL80211Packet& request,
+               vector<unique_ptr<const NL80211Packet>>* response) {
+              response->push_back(std::make_unique<NL80211Packet>(CreateAck()));
+              return true;
+            }));
+  }
+
+  bool Scan(int* error_code) {
+    return scan_utils_.Scan(kFakeInterfaceIndex, false,
+                            IWifiScannerImpl::SCAN_TYPE_DEFAULT, {}, {},
+                            error_code);
+  }
+
+  NL80211Packet CreateRequest(uint8_t command) {
+    return NL80211Packet(kFakeFamilyId, command, kFakeSequenceNumber,
+                         getpid());
+  }
+
+  FakeEventLoop event_loop_;
+  NiceMock<MockNetlinkManager> netlink_manager_;
+  FaultInjectingNetlinkManager faulty_netlink_manager_{&event_loop_,
+                                                       &netlink_manager_};
+  ScanUtils scan_utils_{&faulty_netlink_manager_};
+};
+
+TEST_F(DegradedDriverTest, BusyDriverRejectsScan) {
+  FaultInjectingNetlinkManager::CommandFaults faults;
+  faults.error = EBUSY;
+  faulty_netlink_manager_.SetCommandFaults(NL80211_CMD_TRIGGER_SCAN, faults);
+  EXPECT_CALL(netlink_manager_, SendMessageAndGetResponses(_, _)).Times(0);
+
+  int error_code = 0;
+  EXPECT_FALSE(Scan(&error_code));
+  EXPECT_EQ(EBUSY, error_code);
+}
+
+TEST_F(DegradedDriverTest, SlowDriverDelaysScan) {
+  FaultInjectingNetlinkManager::CommandFaults faults;
+  faults.delay_ms = kFakeResponseTimeoutMs / 2;
+  faulty_netlink_manager_.SetResponseTimeout(NL80211_CMD_TRIGGER_SCAN,
+                                             kFakeResponseTimeoutMs);
+  faulty_netlink_manager_.SetCommandFaults(NL80211_CMD_TRIGGER_SCAN, faults);
+
+  const nsecs_t start_time = systemTime(SYSTEM_TIME_MONOTONIC);
+  int error_code = 0;
+  EXPECT_TRUE(Scan(&error_code));
+  EXPECT_GE(GetElapsedMs(start_time), faults.delay_ms);
+}
+
+TEST_F(DegradedDriverTest, HungDriverBlocksScanNoLongerThanTimeout) {
+  FaultInjectingNetlinkManager::CommandFaults faults;
+  faults.delay_ms = kFakeHungDriverDelayMs;
+  faulty_netlink_manager_.SetResponseTimeout(NL80211_CMD_TRIGGER_SCAN,
+                                             kFakeResponseTimeoutMs);
+  faulty_netlink_manager_.SetCommandFaults(NL80211_CMD_TRIGGER_SCAN, faults);
+  EXPECT_CALL(netlink_manager_, SendMessageAndGetResponses(_, _)).Times(0);
+
+  const nsecs_t start_time = systemTime(SYSTEM_TIME_MONOTONIC);
+  int error_code = 0;
+  EXPECT_FALSE(Scan(&error_code));
+  const int64_t elapsed_ms = GetElapsedMs(start_time);
+  EXPECT_GE(elapsed_ms, kFakeResponseTimeoutMs);
+  EXPECT_LT(elapsed_ms, kFakeHungDriverDelayMs / 2);
+}
+
+TEST_F(DegradedDriverTest, TruncatedScanDumpIsNotCached) {
+  const vector<NL80211Packet> dump = {CreateScanResult(kFakeBssid1),
+                                      CreateScanResult(kFakeBssid2)};
+  EXPECT_CALL(netlink_manager_, SendMessageAndStreamResponses(_, _))
+      .Times(2)
+      .WillRepeatedly(Invoke(
+          [&dump](const NL80211Packet& request,
+                  function<void(const NL80211PacketView&)> handler) {
+            for (const auto& scan_result : dump) {
+              handler(scan_result.GetView());
+            }
+            return true;
+          }));
+  FaultInjectingNetlinkManager::CommandFaults faults;
+  faults.max_dump_messages = 1;
+  faulty_netlink_manager_.SetResponseTimeout(NL80211_CMD_GET_SCAN,
+                                             kFakeResponseTimeoutMs);
+  faulty_netlink_manager_.SetCommandFaults(NL80211_CMD_GET_SCAN, faults);
+
+  vector<NativeScanResult> scan_results;
+  EXPECT_FALSE(scan_utils_.GetScanResult(kFakeInterfaceIndex, &scan_results));
+
+  // The next query goes to kernel again instead of serving the partial dump.
+  faulty_netlink_manager_.ClearFaults();
+  EXPECT_TRUE(scan_utils_.GetScanResult(kFakeInterfaceIndex, &scan_results));
+  EXPECT_EQ(2u, scan_results.size());
+}
+
+TEST_F(DegradedDriverTest, DroppedScanNotificationIsReportedAsLost) {
+  OnScanResultsReadyHandler kernel_handler;
+  EXPECT_CALL(netlink_manager_,
+              SubscribeScanResultNotification(kFakeInterfaceIndex, _))
+      .WillOnce(SaveArg<1>(&kernel_handler));
+  int num_notifications = 0;
+  faulty_netlink_manager_.SubscribeScanResultNotification(
+      kFakeInterfaceIndex,
+      [&num_notifications](uint32_t interface_index, bool aborted,
+                           vector<vector<uint8_t>>& ssids,
+                           vector<uint32_t>& frequencies) {
+        num_notifications++;
+      });
+  int num_losses = 0;
+  faulty_netlink_manager_.SubscribeEventsLost(
+      kFakeInterfaceIndex, [&num_losses]() { num_losses++; });
+  faulty_netlink_manager_.DropEvents(NL80211_CMD_NEW_SCAN_RESULTS, 1, true);
+
+  vector<vector<uint8_t>> ssids;
+  vector<uint32_t> frequencies;
+  kernel_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+  EXPECT_EQ(0, num_notifications);
+  EXPECT_EQ(1, num_losses);
+  kernel_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+  EXPECT_EQ(1, num_notifications);
+  EXPECT_EQ(1, num_losses);
+}
+
+TEST_F(DegradedDriverTest, SlowDriverDoesNotBlockAsyncRequest) {
+  EXPECT_CALL(netlink_manager_, SendMessageAsync(_, _))
+      .WillOnce(Invoke([](const NL80211Packet& request,
+                          OnResponsesReceivedHandler handler) {
+        vector<unique_ptr<const NL80211Packet>> responses;
+        responses.push_back(std::make_unique<NL80211Packet>(CreateAck()));
+        handler(true, std::move(responses));
+        return true;
+      }));
+  FaultInjectingNetlinkManager::CommandFaults faults;
+  faults.delay_ms = kFakeResponseTimeoutMs / 2;
+  faulty_netlink_manager_.SetResponseTimeout(NL80211_CMD_GET_STATION,
+                                             kFakeResponseTimeoutMs);
+  faulty_netlink_manager_.SetCommandFaults(NL80211_CMD_GET_STATION, faults);
+
+  const nsecs_t start_time = systemTime(SYSTEM_TIME_MONOTONIC);
+  bool completed = false;
+  size_t num_responses = 0;
+  EXPECT_TRUE(faulty_netlink_manager_.SendMessageAsync(
+      CreateRequest(NL80211_CMD_GET_STATION),
+      [&completed, &num_responses](
+          bool success, vector<unique_ptr<const NL80211Packet>> responses) {
+        completed = success;
+        num_responses = responses.size();
+      }));
+  EXPECT_LT(GetElapsedMs(start_time), faults.delay_ms);
+  EXPECT_FALSE(completed);
+
+  // The reply is handled by the event loop once it arrived.
+  ASSERT_EQ(1u, event_loop_.GetNumDelayedTasks());
+  EXPECT_EQ(faults.delay_ms, event_loop_.RunDelayedTask());
+  EXPECT_TRUE(completed);
+  EXPECT_EQ(1u, num_responses);
+}
+
+TEST_F(DegradedDriverTest, AsyncRequestToHungDriverTimesOut) {
+  EXPECT_CALL(netlink_manager_, SendMessageAsync(_, _)).Times(0);
+  FaultInjectingNetlinkManager::CommandFaults faults;
+  faults.delay_ms = kFakeHungDriverDelayMs;
+  faulty_netlink_manager_.SetResponseTimeout(NL80211_CMD_GET_STATION,
+                                             kFakeResponseTimeoutMs);
+  faulty_netlink_manager_.SetCommandFaults(NL80211_CMD_GET_STATION, faults);
+
+  int num_calls = 0;
+  bool succeeded = true;
+  EXPECT_TRUE(faulty_netlink_manager_.SendMessageAsync(
+      CreateRequest(NL80211_CMD_GET_STATION),
+      [&num_calls, &succeeded](
+          bool success, vector<unique_ptr<const NL80211Packet>> responses) {
+        num_calls++;
+        succeeded = success;
+      }));
+  ASSERT_EQ(1u, event_loop_.GetNumDelayedTasks());
+  EXPECT_EQ(kFakeResponseTimeoutMs, event_loop_.RunDelayedTask());
+  EXPECT_EQ(1, num_calls);
+  EXPECT_FALSE(succeeded);
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/test_utils.h>
+#include <gtest/gtest.h>
+
+#include "wificond/dump_writer.h"
+
+using android::base::ReadFileToString;
+using std::string;
+using std::stringstream;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+// Writes sections "a", "b" twice, and "c" with |writer|.
+void WriteSections(DumpWriter* writer) {
+  writer->WriteSection("a", [](stringstream* ss) { *ss << "A\n"; });
+  writer->WriteSection("b", [](stringstream* ss) { *ss << "B1\n"; });
+  writer->WriteSection("b", [](stringstream* ss) { *ss << "B2\n"; });
+  writer->WriteSection("c", [](stringstream* ss) { *ss << "C\n"; });
+}
+
+}  // namespace
+
+class DumpWriterTest : public ::testing::Test {
+ protected:
+  string Dump(const vector<string>& sections) {
+    DumpWriter writer(dump_file_.fd, sections);
+    WriteSections(&writer);
+    EXPECT_TRUE(writer.Finish());
+    string dump;
+    EXPECT_TRUE(ReadFileToString(dump_file_.path, &dump));
+    return dump;
+  }
+
+  TemporaryFile dump_file_;
+};
+
+TEST_F(DumpWriterTest, WritesAllSectionsByDefault) {
+  EXPECT_EQ("A\nB1\nB2\nC\n", Dump({}));
+}
+
+TEST_F(DumpWriterTest, WritesPickedSections) {
+  EXPECT_EQ("B1\nB2\nC\n", Dump({"c", "b"}));
+}
+
+TEST_F(DumpWriterTest, ListsSectionsForUnknownSection) {
+  EXPECT_EQ("A\nUnknown dump sections: d\nDump sections: a, b, c\n",
+            Dump({"a", "d"}));
+}
+
+TEST_F(DumpWriterTest, WritesOptionalSectionOnlyIfPicked) {
+  auto dump = [](stringstream* ss) { *ss << "R\n"; };
+  {
+    DumpWriter writer(dump_file_.fd, {});
+    writer.WriteSection("raw", dump, true);
+    EXPECT_TRUE(writer.Finish());
+  }
+  {
+    DumpWriter writer(dump_file_.fd, {"raw"});
+    writer.WriteSection("raw", dump, true);
+    EXPECT_TRUE(writer.Finish());
+  }
+  string dump_output;
+  EXPECT_TRUE(ReadFileToString(dump_file_.path, &dump_output));
+  EXPECT_EQ("R\n", dump_output);
+}
+
+TEST_F(DumpWriterTest, StopsAfterFailedWrite) {
+  DumpWriter writer(-1, {});
+  int num_dumped_sections = 0;
+  auto dump = [&num_dumped_sections](stringstream* ss) {
+    num_dumped_sections++;
+    *ss << "A\n";
+  };
+  writer.WriteSection("a", dump);
+  writer.WriteSection("b", dump);
+  EXPECT_EQ(1, num_dumped_sections);
+  EXPECT_FALSE(writer.Finish());
+}
+
+}  // namespace wificond
+}  // namespace android
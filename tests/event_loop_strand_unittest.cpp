@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2016, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <memory>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "wificond/event_loop_strand.h"
+#include "wificond/looper_backed_event_loop.h"
+
+using std::string;
+using std::unique_ptr;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+const int kTimeoutMs = 100;
+
+}  // namespace
+
+class EventLoopStrandTest : public ::testing::Test {
+ protected:
+  // Runs the tasks of |event_loop_| until none is left.
+  void RunPendingTasks() {
+    string previous_log;
+    do {
+      previous_log = log_;
+      event_loop_->PollForOne(0);
+    } while (log_ != previous_log);
+  }
+
+  unique_ptr<LooperBackedEventLoop> event_loop_{new LooperBackedEventLoop()};
+  string log_;
+};
+
+TEST_F(EventLoopStrandTest, RunsTasksInOrder) {
+  EventLoopStrand strand(event_loop_.get());
+  strand.PostTask([this]() { log_ += "1"; });
+  strand.PostTask([this]() { log_ += "2"; });
+  strand.PostTask([this]() { log_ += "3"; });
+  RunPendingTasks();
+  EXPECT_EQ("123", log_);
+}
+
+TEST_F(EventLoopStrandTest, InterleavesTasksOfDifferentStrands) {
+  EventLoopStrand client_strand(event_loop_.get());
+  EventLoopStrand ap_strand(event_loop_.get());
+  client_strand.PostTask([this]() { log_ += "c1"; });
+  client_strand.PostTask([this]() { log_ += "c2"; });
+  client_strand.PostTask([this]() { log_ += "c3"; });
+  ap_strand.PostTask([this]() { log_ += "a1"; });
+  RunPendingTasks();
+  // The AP task does not wait for all client tasks.
+  EXPECT_EQ("c1a1c2c3", log_);
+}
+
+TEST_F(EventLoopStrandTest, RunsDelayedTaskOnStrand) {
+  EventLoopStrand strand(event_loop_.get());
+  strand.PostDelayedTask([this]() { log_ += "delayed"; }, 10);
+  event_loop_->PollForOne(kTimeoutMs);
+  RunPendingTasks();
+  EXPECT_EQ("delayed", log_);
+}
+
+TEST_F(EventLoopStrandTest, DropsPendingTasksOnDestruction) {
+  unique_ptr<EventLoopStrand> strand(new EventLoopStrand(event_loop_.get()));
+  strand->PostTask([this]() { log_ += "1"; });
+  strand->PostDelayedTask([this]() { log_ += "2"; }, 0);
+  strand.reset();
+  RunPendingTasks();
+  EXPECT_EQ("", log_);
+}
+
+TEST_F(EventLoopStrandTest, CanBeDestroyedByItsOwnTask) {
+  unique_ptr<EventLoopStrand> strand(new EventLoopStrand(event_loop_.get()));
+  strand->PostTask([this, &strand]() {
+    log_ += "1";
+    strand.reset();
+  });
+  strand->PostTask([this]() { log_ += "2"; });
+  RunPendingTasks();
+  EXPECT_EQ("1", log_);
+}
+
+}  // namespace wificond
+}  // namespace android
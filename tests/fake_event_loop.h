@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_TESTS_FAKE_EVENT_LOOP_H_
+#define WIFICOND_TESTS_FAKE_EVENT_LOOP_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include "wificond/event_loop.h"
+
+namespace android {
+namespace wificond {
+
+// Event loop whose delayed tasks are run by the test.
+// Posted tasks run right away on the posting thread, unless the loop is
+// created with |kQueueTasks|. They are then queued, and the test runs them
+// one by one with RunOneTask(), which makes the test thread act as the event
+// loop thread for tasks posted from other threads.
+class FakeEventLoop : public EventLoop {
+ public:
+  enum PostMode {
+    kRunTasks,
+    kQueueTasks,
+  };
+
+  explicit FakeEventLoop(PostMode post_mode = kRunTasks)
+      : post_mode_(post_mode) {}
+
+  void PostTask(const std::function<void()>& callback) override {
+    if (post_mode_ == kRunTasks) {
+      callback();
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(callback);
+    task_posted_.notify_one();
+  }
+
+  void PostDelayedTask(const std::function<void()>& callback,
+                       int64_t delay_ms) override {
+    PostCancelableDelayedTask(callback, delay_ms, 0);
+  }
+
+  TimerId PostCancelableDelayedTask(const std::function<void()>& callback,
+                                    int64_t delay_ms,
+                                    int64_t slack_ms) override {
+    delayed_tasks_[++last_timer_id_] = {delay_ms, callback};
+    return last_timer_id_;
+  }
+
+  bool CancelDelayedTask(TimerId timer_id) override {
+    return delayed_tasks_.erase(timer_id) > 0;
+  }
+
+  bool WatchFileDescriptor(int fd,
+                           ReadyMode mode,
+                           const std::function<void(int)>& callback) override {
+    return false;
+  }
+
+  bool StopWatchFileDescriptor(int fd) override {
+    return false;
+  }
+
+  size_t GetNumDelayedTasks() const {
+    return delayed_tasks_.size();
+  }
+
+  // Runs the oldest delayed task. Returns its delay.
+  int64_t RunDelayedTask() {
+    auto task = delayed_tasks_.begin()->second;
+    delayed_tasks_.erase(delayed_tasks_.begin());
+    task.second();
+    return task.first;
+  }
+
+  // Waits for a queued task and runs it.
+  void RunOneTask() {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      task_posted_.wait(lock, [this]() { return !tasks_.empty(); });
+      task = tasks_.front();
+      tasks_.pop_front();
+    }
+    task();
+  }
+
+  bool HasTasks() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return !tasks_.empty();
+  }
+
+ private:
+  const PostMode post_mode_;
+  TimerId last_timer_id_ = kInvalidTimerId;
+  std::map<TimerId, std::pair<int64_t, std::function<void()>>> delayed_tasks_;
+  // Tasks queued in |kQueueTasks| mode, which other threads may post.
+  std::mutex mutex_;
+  std::condition_variable task_posted_;
+  std::deque<std::function<void()>> tasks_;
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_TESTS_FAKE_EVENT_LOOP_H_
@@ -0,0 +1,640 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/tests/fault_injecting_netlink_manager.h"
+
+#include <chrono>
+#include <thread>
+
+#include <linux/netlink.h>
+
+#include <android-base/logging.h>
+
+#include "wificond/net/kernel-header-latest/nl80211.h"
+#include "wificond/net/nl80211_packet.h"
+#include "wificond/net/nl80211_packet_view.h"
+
+using std::function;
+using std::map;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+// Default response timeouts of NetlinkManager.
+constexpr int kDefaultResponseTimeoutMs = 300;
+constexpr int kDefaultDumpResponseTimeoutMs = 1000;
+
+void Sleep(int delay_ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+}
+
+// Creates the NLMSG_ERROR message that kernel would answer |request| with
+// to report |error|.
+unique_ptr<const NL80211Packet> CreateErrorReply(const NL80211Packet& request,
+                                                 int error) {
+  vector<uint8_t> data(NLMSG_HDRLEN + NLMSG_ALIGN(sizeof(nlmsgerr)), 0);
+  nlmsghdr* nl_header = reinterpret_cast<nlmsghdr*>(data.data());
+  nl_header->nlmsg_len = data.size();
+  nl_header->nlmsg_type = NLMSG_ERROR;
+  nl_header->nlmsg_seq = request.GetMessageSequence();
+  nl_header->nlmsg_pid = request.GetPortId();
+  nlmsgerr* error_message =
+      reinterpret_cast<nlmsgerr*>(data.data() + NLMSG_HDRLEN);
+  error_message->error = -error;
+  error_message->msg =
+      *reinterpret_cast<const nlmsghdr*>(request.GetConstData().data());
+  return std::make_unique<const NL80211Packet>(data);
+}
+
+}  // namespace
+
+FaultInjectingNetlinkManager::MlmeEventFilter::MlmeEventFilter(
+    FaultInjectingNetlinkManager* owner,
+    MlmeEventHandler* handler)
+    : owner_(owner),
+      handler_(handler) {
+}
+
+void FaultInjectingNetlinkManager::MlmeEventFilter::OnConnect(
+    unique_ptr<MlmeConnectEvent> event) {
+  if (!owner_->ShouldDropEvent(NL80211_CMD_CONNECT)) {
+    handler_->OnConnect(std::move(event));
+  }
+}
+
+void FaultInjectingNetlinkManager::MlmeEventFilter::OnRoam(
+    unique_ptr<MlmeRoamEvent> event) {
+  if (!owner_->ShouldDropEvent(NL80211_CMD_ROAM)) {
+    handler_->OnRoam(std::move(event));
+  }
+}
+
+void FaultInjectingNetlinkManager::MlmeEventFilter::OnAuthenticate(
+    unique_ptr<MlmeAuthenticateEvent> event) {
+  if (!owner_->ShouldDropEvent(NL80211_CMD_AUTHENTICATE)) {
+    handler_->OnAuthenticate(std::move(event));
+  }
+}
+
+void FaultInjectingNetlinkManager::MlmeEventFilter::OnAssociate(
+    unique_ptr<MlmeAssociateEvent> event) {
+  if (!owner_->ShouldDropEvent(NL80211_CMD_ASSOCIATE)) {
+    handler_->OnAssociate(std::move(event));
+  }
+}
+
+void FaultInjectingNetlinkManager::MlmeEventFilter::OnDisconnect(
+    unique_ptr<MlmeDisconnectEvent> event) {
+  if (!owner_->ShouldDropEvent(NL80211_CMD_DISCONNECT)) {
+    handler_->OnDisconnect(std::move(event));
+  }
+}
+
+void FaultInjectingNetlinkManager::MlmeEventFilter::OnDisassociate(
+    unique_ptr<MlmeDisassociateEvent> event) {
+  if (!owner_->ShouldDropEvent(NL80211_CMD_DISASSOCIATE)) {
+    handler_->OnDisassociate(std::move(event));
+  }
+}
+
+FaultInjectingNetlinkManager::FaultInjectingNetlinkManager(
+    EventLoop* event_loop,
+    NetlinkManager* netlink_manager)
+    : NetlinkManager(event_loop),
+      event_loop_(event_loop),
+      netlink_manager_(netlink_manager) {
+}
+
+FaultInjectingNetlinkManager::~FaultInjectingNetlinkManager() {
+  // Delayed tasks refer to this object.
+  for (EventLoop::TimerId timer_id : pending_tasks_) {
+    event_loop_->CancelDelayedTask(timer_id);
+  }
+}
+
+void FaultInjectingNetlinkManager::SetCommandFaults(
+    uint8_t command, const CommandFaults& faults) {
+  command_faults_[command] = faults;
+}
+
+void FaultInjectingNetlinkManager::DropEvents(uint8_t command,
+                                              uint32_t count,
+                                              bool report_loss) {
+  events_to_drop_[command] = count;
+  if (report_loss) {
+    report_lost_events_.insert(command);
+  } else {
+    report_lost_events_.erase(command);
+  }
+}
+
+void FaultInjectingNetlinkManager::ClearFaults() {
+  command_faults_.clear();
+  events_to_drop_.clear();
+  report_lost_events_.clear();
+}
+
+bool FaultInjectingNetlinkManager::Start() {
+  return netlink_manager_->Start();
+}
+
+bool FaultInjectingNetlinkManager::IsStarted() const {
+  return netlink_manager_->IsStarted();
+}
+
+uint32_t FaultInjectingNetlinkManager::GetSequenceNumber() {
+  return netlink_manager_->GetSequenceNumber();
+}
+
+uint16_t FaultInjectingNetlinkManager::GetFamilyId() {
+  return netlink_manager_->GetFamilyId();
+}
+
+bool FaultInjectingNetlinkManager::RegisterHandlerAndSendMessage(
+    const NL80211Packet& packet,
+    function<void(unique_ptr<const NL80211Packet>)> handler) {
+  const CommandFaults faults = GetFaults(packet);
+  if (faults.delay_ms > GetResponseTimeoutMs(packet)) {
+    // The handler of a request without reply is never run.
+    return true;
+  }
+  if (faults.error != 0) {
+    std::shared_ptr<const NL80211Packet> reply =
+        CreateErrorReply(packet, faults.error);
+    PostDelayedTask([handler, reply]() {
+      handler(std::make_unique<const NL80211Packet>(*reply));
+    }, faults.delay_ms);
+    return true;
+  }
+  if (faults.delay_ms == 0) {
+    return netlink_manager_->RegisterHandlerAndSendMessage(packet, handler);
+  }
+  return netlink_manager_->RegisterHandlerAndSendMessage(
+      packet,
+      [this, handler, delay_ms = faults.delay_ms](
+          unique_ptr<const NL80211Packet> reply) {
+        std::shared_ptr<const NL80211Packet> shared_reply(std::move(reply));
+        PostDelayedTask([handler, shared_reply]() {
+          handler(std::make_unique<const NL80211Packet>(*shared_reply));
+        }, delay_ms);
+      });
+}
+
+bool FaultInjectingNetlinkManager::SendMessageAsync(
+    const NL80211Packet& packet,
+    OnResponsesReceivedHandler handler) {
+  const CommandFaults faults = GetFaults(packet);
+  const int timeout_ms = GetResponseTimeoutMs(packet);
+  if (faults.delay_ms > timeout_ms) {
+    PostDelayedTask([handler]() {
+      handler(false, {});
+    }, timeout_ms);
+    return true;
+  }
+  if (faults.error != 0) {
+    std::shared_ptr<const NL80211Packet> reply =
+        CreateErrorReply(packet, faults.error);
+    PostDelayedTask([handler, reply]() {
+      vector<unique_ptr<const NL80211Packet>> responses;
+      responses.push_back(std::make_unique<const NL80211Packet>(*reply));
+      handler(true, std::move(responses));
+    }, faults.delay_ms);
+    return true;
+  }
+  if (faults.delay_ms == 0 && faults.max_dump_messages == 0) {
+    return netlink_manager_->SendMessageAsync(packet, handler);
+  }
+  return netlink_manager_->SendMessageAsync(
+      packet,
+      [this, handler, faults, timeout_ms](
+          bool success,
+          vector<unique_ptr<const NL80211Packet>> responses) {
+        if (success && faults.max_dump_messages != 0 &&
+            responses.size() > faults.max_dump_messages) {
+          PostDelayedTask([handler]() {
+            handler(false, {});
+          }, timeout_ms);
+          return;
+        }
+        auto shared_responses =
+            std::make_shared<vector<unique_ptr<const NL80211Packet>>>(
+                std::move(responses));
+        PostDelayedTask([handler, success, shared_responses]() {
+          handler(success, std::move(*shared_responses));
+        }, faults.delay_ms);
+      });
+}
+
+bool FaultInjectingNetlinkManager::SendMessageAndGetResponses(
+    const NL80211Packet& packet,
+    vector<unique_ptr<const NL80211Packet>>* response) {
+  const CommandFaults faults = GetFaults(packet);
+  if (!WaitForReply(packet)) {
+    return false;
+  }
+  if (faults.error != 0) {
+    response->push_back(CreateErrorReply(packet, faults.error));
+    return true;
+  }
+  if (!netlink_manager_->SendMessageAndGetResponses(packet, response)) {
+    return false;
+  }
+  if (faults.max_dump_messages != 0 &&
+      response->size() > faults.max_dump_messages) {
+    response->resize(faults.max_dump_messages);
+    Sleep(GetResponseTimeoutMs(packet));
+    return false;
+  }
+  return true;
+}
+
+bool FaultInjectingNetlinkManager::SendMessageAndStreamResponses(
+    const NL80211Packet& packet,
+    function<void(const NL80211PacketView&)> handler) {
+  const CommandFaults faults = GetFaults(packet);
+  if (!WaitForReply(packet)) {
+    return false;
+  }
+  if (faults.error != 0) {
+    handler(CreateErrorReply(packet, faults.error)->GetView());
+    return true;
+  }
+  if (faults.max_dump_messages == 0) {
+    return netlink_manager_->SendMessageAndStreamResponses(packet, handler);
+  }
+  size_t num_messages = 0;
+  bool success = netlink_manager_->SendMessageAndStreamResponses(
+      packet,
+      [&handler, &num_messages, &faults](const NL80211PacketView& message) {
+        if (num_messages++ < faults.max_dump_messages) {
+          handler(message);
+        }
+      });
+  if (success && num_messages > faults.max_dump_messages) {
+    Sleep(GetResponseTimeoutMs(packet));
+    return false;
+  }
+  return success;
+}
+
+bool FaultInjectingNetlinkManager::SendMessagesAndGetResponses(
+    const vector<const NL80211Packet*>& packets,
+    vector<vector<unique_ptr<const NL80211Packet>>>* responses) {
+  // The replies of a batch arrive together, as late as the slowest one.
+  int delay_ms = 0;
+  bool timed_out = false;
+  int timeout_ms = 0;
+  vector<const NL80211Packet*> sent_packets;
+  for (const NL80211Packet* packet : packets) {
+    const CommandFaults faults = GetFaults(*packet);
+    const int packet_timeout_ms = GetResponseTimeoutMs(*packet);
+    delay_ms = std::max(delay_ms, faults.delay_ms);
+    timeout_ms = std::max(timeout_ms, packet_timeout_ms);
+    timed_out |= faults.delay_ms > packet_timeout_ms;
+    if (faults.error == 0) {
+      sent_packets.push_back(packet);
+    }
+  }
+  if (timed_out) {
+    Sleep(timeout_ms);
+    return false;
+  }
+  Sleep(delay_ms);
+  vector<vector<unique_ptr<const NL80211Packet>>> sent_responses;
+  if (!sent_packets.empty() &&
+      !netlink_manager_->SendMessagesAndGetResponses(sent_packets,
+                                                     &sent_responses)) {
+    return false;
+  }
+  responses->clear();
+  responses->resize(packets.size());
+  size_t sent_index = 0;
+  for (size_t i = 0; i < packets.size(); i++) {
+    const CommandFaults faults = GetFaults(*packets[i]);
+    if (faults.error != 0) {
+      (*responses)[i].push_back(CreateErrorReply(*packets[i], faults.error));
+    } else if (sent_index < sent_responses.size()) {
+      (*responses)[i] = std::move(sent_responses[sent_index++]);
+    }
+  }
+  return true;
+}
+
+void FaultInjectingNetlinkManager::SetResponseTimeout(uint8_t command,
+                                                      int timeout_ms) {
+  if (timeout_ms <= 0) {
+    response_timeouts_ms_.erase(command);
+  } else {
+    response_timeouts_ms_[command] = timeout_ms;
+  }
+  netlink_manager_->SetResponseTimeout(command, timeout_ms);
+}
+
+CommandLatencyStats FaultInjectingNetlinkManager::GetCommandLatencyStats(
+    uint16_t message_type, uint8_t command) const {
+  return netlink_manager_->GetCommandLatencyStats(message_type, command);
+}
+
+void FaultInjectingNetlinkManager::DumpCommandLatencies(
+    std::stringstream* ss) const {
+  netlink_manager_->DumpCommandLatencies(ss);
+}
+
+bool FaultInjectingNetlinkManager::StartCapture(const string& path) {
+  return netlink_manager_->StartCapture(path);
+}
+
+void FaultInjectingNetlinkManager::StopCapture() {
+  netlink_manager_->StopCapture();
+}
+
+bool FaultInjectingNetlinkManager::SubscribeToEvents(const string& group) {
+  return netlink_manager_->SubscribeToEvents(group);
+}
+
+void FaultInjectingNetlinkManager::SubscribeScanResultNotification(
+    uint32_t interface_index,
+    OnScanResultsReadyHandler handler) {
+  netlink_manager_->SubscribeScanResultNotification(
+      interface_index,
+      [this, handler](uint32_t interface_index,
+                      bool aborted,
+                      vector<vector<uint8_t>>& ssids,
+                      vector<uint32_t>& frequencies) {
+        if (!ShouldDropEvent(aborted ? NL80211_CMD_SCAN_ABORTED
+                                     : NL80211_CMD_NEW_SCAN_RESULTS)) {
+          handler(interface_index, aborted, ssids, frequencies);
+        }
+      });
+}
+
+void FaultInjectingNetlinkManager::UnsubscribeScanResultNotification(
+    uint32_t interface_index) {
+  netlink_manager_->UnsubscribeScanResultNotification(interface_index);
+}
+
+void FaultInjectingNetlinkManager::SubscribeMlmeEvent(
+    uint32_t interface_index,
+    MlmeEventHandler* handler) {
+  unique_ptr<MlmeEventFilter> filter(new MlmeEventFilter(this, handler));
+  netlink_manager_->SubscribeMlmeEvent(interface_index, filter.get());
+  mlme_event_filters_[interface_index] = std::move(filter);
+}
+
+void FaultInjectingNetlinkManager::UnsubscribeMlmeEvent(
+    uint32_t interface_index) {
+  netlink_manager_->UnsubscribeMlmeEvent(interface_index);
+  mlme_event_filters_.erase(interface_index);
+}
+
+void FaultInjectingNetlinkManager::SubscribeSchedScanResultNotification(
+    uint32_t interface_index,
+    OnSchedScanResultsReadyHandler handler) {
+  netlink_manager_->SubscribeSchedScanResultNotification(
+      interface_index,
+      [this, handler](uint32_t interface_index, bool scan_stopped) {
+        if (!ShouldDropEvent(scan_stopped ? NL80211_CMD_SCHED_SCAN_STOPPED
+                                          : NL80211_CMD_SCHED_SCAN_RESULTS)) {
+          handler(interface_index, scan_stopped);
+        }
+      });
+}
+
+void FaultInjectingNetlinkManager::UnsubscribeSchedScanResultNotification(
+    uint32_t interface_index) {
+  netlink_manager_->UnsubscribeSchedScanResultNotification(interface_index);
+}
+
+void FaultInjectingNetlinkManager::SubscribeRegDomainChange(
+    uint32_t wiphy_index,
+    OnRegDomainChangedHandler handler) {
+  netlink_manager_->SubscribeRegDomainChange(
+      wiphy_index,
+      [this, handler](string& country_code) {
+        if (!ShouldDropEvent(NL80211_CMD_REG_CHANGE)) {
+          handler(country_code);
+        }
+      });
+}
+
+void FaultInjectingNetlinkManager::UnsubscribeRegDomainChange(
+    uint32_t wiphy_index) {
+  netlink_manager_->UnsubscribeRegDomainChange(wiphy_index);
+}
+
+void FaultInjectingNetlinkManager::SubscribeInterfaceEvent(
+    uint32_t wiphy_index,
+    OnInterfaceEventHandler handler) {
+  netlink_manager_->SubscribeInterfaceEvent(
+      wiphy_index,
+      [this, handler](InterfaceEvent event,
+                      uint32_t if_index,
+                      const string& if_name,
+                      const std::array<uint8_t, ETH_ALEN>& mac_address) {
+        if (!ShouldDropEvent(event == NEW_INTERFACE
+                                 ? NL80211_CMD_NEW_INTERFACE
+                                 : NL80211_CMD_DEL_INTERFACE)) {
+          handler(event, if_index, if_name, mac_address);
+        }
+      });
+}
+
+void FaultInjectingNetlinkManager::UnsubscribeInterfaceEvent(
+    uint32_t wiphy_index) {
+  netlink_manager_->UnsubscribeInterfaceEvent(wiphy_index);
+}
+
+void FaultInjectingNetlinkManager::SubscribeStationEvent(
+    uint32_t interface_index,
+    OnStationEventHandler handler) {
+  netlink_manager_->SubscribeStationEvent(
+      interface_index,
+      [this, handler](StationEvent event,
+                      const std::array<uint8_t, ETH_ALEN>& mac_address) {
+        if (!ShouldDropEvent(event == NEW_STATION ? NL80211_CMD_NEW_STATION
+                                                  : NL80211_CMD_DEL_STATION)) {
+          handler(event, mac_address);
+        }
+      });
+}
+
+void FaultInjectingNetlinkManager::UnsubscribeStationEvent(
+    uint32_t interface_index) {
+  netlink_manager_->UnsubscribeStationEvent(interface_index);
+}
+
+void FaultInjectingNetlinkManager::SubscribeChannelSwitchEvent(
+    uint32_t interface_index,
+    OnChannelSwitchEventHandler handler) {
+  netlink_manager_->SubscribeChannelSwitchEvent(
+      interface_index,
+      [this, handler](uint32_t frequency, ChannelBandwidth bandwidth) {
+        if (!ShouldDropEvent(NL80211_CMD_CH_SWITCH_NOTIFY)) {
+          handler(frequency, bandwidth);
+        }
+      });
+}
+
+void FaultInjectingNetlinkManager::UnsubscribeChannelSwitchEvent(
+    uint32_t interface_index) {
+  netlink_manager_->UnsubscribeChannelSwitchEvent(interface_index);
+}
+
+void FaultInjectingNetlinkManager::SubscribeFrameTxStatusEvent(
+    uint32_t interface_index,
+    OnFrameTxStatusEventHandler handler) {
+  netlink_manager_->SubscribeFrameTxStatusEvent(
+      interface_index,
+      [this, handler](uint64_t cookie, bool was_acked) {
+        if (!ShouldDropEvent(NL80211_CMD_FRAME_TX_STATUS)) {
+          handler(cookie, was_acked);
+        }
+      });
+}
+
+void FaultInjectingNetlinkManager::UnsubscribeFrameTxStatusEvent(
+    uint32_t interface_index) {
+  netlink_manager_->UnsubscribeFrameTxStatusEvent(interface_index);
+}
+
+void FaultInjectingNetlinkManager::SubscribeCqmEvent(
+    uint32_t interface_index,
+    OnCqmEventHandler handler) {
+  netlink_manager_->SubscribeCqmEvent(
+      interface_index,
+      [this, handler](CqmEvent event, int32_t rssi_dbm, uint32_t packets) {
+        if (!ShouldDropEvent(NL80211_CMD_NOTIFY_CQM)) {
+          handler(event, rssi_dbm, packets);
+        }
+      });
+}
+
+void FaultInjectingNetlinkManager::UnsubscribeCqmEvent(
+    uint32_t interface_index) {
+  netlink_manager_->UnsubscribeCqmEvent(interface_index);
+}
+
+void FaultInjectingNetlinkManager::Subscribe(uint8_t command,
+                                             uint32_t interface_index,
+                                             OnEventHandler handler) {
+  netlink_manager_->Subscribe(
+      command,
+      interface_index,
+      [this, command, handler](const NL80211PacketView& packet) {
+        if (!ShouldDropEvent(command)) {
+          handler(packet);
+        }
+      });
+}
+
+void FaultInjectingNetlinkManager::Unsubscribe(uint8_t command,
+                                               uint32_t interface_index) {
+  netlink_manager_->Unsubscribe(command, interface_index);
+}
+
+void FaultInjectingNetlinkManager::SubscribeEventsLost(
+    uint32_t interface_index,
+    OnEventsLostHandler handler) {
+  events_lost_handlers_[interface_index] = handler;
+  netlink_manager_->SubscribeEventsLost(interface_index, handler);
+}
+
+void FaultInjectingNetlinkManager::UnsubscribeEventsLost(
+    uint32_t interface_index) {
+  events_lost_handlers_.erase(interface_index);
+  netlink_manager_->UnsubscribeEventsLost(interface_index);
+}
+
+void FaultInjectingNetlinkManager::CreateInterfaceStrand(
+    uint32_t interface_index) {
+  netlink_manager_->CreateInterfaceStrand(interface_index);
+}
+
+void FaultInjectingNetlinkManager::DestroyInterfaceStrand(
+    uint32_t interface_index) {
+  netlink_manager_->DestroyInterfaceStrand(interface_index);
+}
+
+FaultInjectingNetlinkManager::CommandFaults
+FaultInjectingNetlinkManager::GetFaults(const NL80211Packet& packet) const {
+  auto itr = command_faults_.find(packet.GetCommand());
+  if (itr == command_faults_.end()) {
+    return CommandFaults();
+  }
+  return itr->second;
+}
+
+int FaultInjectingNetlinkManager::GetResponseTimeoutMs(
+    const NL80211Packet& packet) const {
+  auto itr = response_timeouts_ms_.find(packet.GetCommand());
+  if (itr != response_timeouts_ms_.end()) {
+    return itr->second;
+  }
+  return packet.IsDump() ? kDefaultDumpResponseTimeoutMs
+                         : kDefaultResponseTimeoutMs;
+}
+
+bool FaultInjectingNetlinkManager::WaitForReply(const NL80211Packet& packet) {
+  const int delay_ms = GetFaults(packet).delay_ms;
+  const int timeout_ms = GetResponseTimeoutMs(packet);
+  if (delay_ms > timeout_ms) {
+    Sleep(timeout_ms);
+    LOG(ERROR) << "Injected timeout of request with command "
+               << static_cast<int>(packet.GetCommand());
+    return false;
+  }
+  Sleep(delay_ms);
+  return true;
+}
+
+void FaultInjectingNetlinkManager::PostDelayedTask(
+    const function<void()>& task, int64_t delay_ms) {
+  // |timer_id| is only known once the task is posted.
+  auto timer_id = std::make_shared<EventLoop::TimerId>(
+      EventLoop::kInvalidTimerId);
+  *timer_id = event_loop_->PostCancelableDelayedTask(
+      [this, task, timer_id]() {
+        pending_tasks_.erase(*timer_id);
+        task();
+      },
+      delay_ms,
+      0);
+  pending_tasks_.insert(*timer_id);
+}
+
+bool FaultInjectingNetlinkManager::ShouldDropEvent(uint8_t command) {
+  auto itr = events_to_drop_.find(command);
+  if (itr == events_to_drop_.end() || itr->second == 0) {
+    return false;
+  }
+  itr->second--;
+  if (report_lost_events_.count(command) > 0) {
+    // Handlers might unsubscribe.
+    const map<uint32_t, OnEventsLostHandler> handlers = events_lost_handlers_;
+    for (const auto& it : handlers) {
+      it.second();
+    }
+  }
+  return true;
+}
+
+}  // namespace wificond
+}  // namespace android
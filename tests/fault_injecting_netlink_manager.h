@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_TEST_FAULT_INJECTING_NETLINK_MANAGER_H_
+#define WIFICOND_TEST_FAULT_INJECTING_NETLINK_MANAGER_H_
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "wificond/net/mlme_event_handler.h"
+#include "wificond/net/netlink_manager.h"
+
+namespace android {
+namespace wificond {
+
+// NetlinkManager decorator that makes |netlink_manager| look like the
+// netlink interface of a degraded driver, so that tests can check how its
+// users cope with slow, failing or lossy kernel traffic.
+// Faults are set per nl80211 command. Commands of other generic netlink
+// families share the faults of the nl80211 command that has the same value,
+// like they share response timeouts.
+//   - A request is answered |delay_ms| late. Synchronous requests block the
+//     caller in the meantime, like the real NetlinkManager does. Requests
+//     whose reply would arrive after their response timeout fail once the
+//     timeout expired, without reaching |netlink_manager|.
+//   - A request is answered with a NLMSG_ERROR carrying |error|, e.g. EBUSY
+//     or ENODEV, without reaching |netlink_manager|.
+//   - A dump ends after |max_dump_messages| messages. Its NLMSG_DONE never
+//     arrives, so the request fails once its response timeout expired.
+//   - Multicast events are dropped before they reach their handlers, see
+//     |DropEvents|.
+// Like NetlinkManager, this class is not thread-safe.
+class FaultInjectingNetlinkManager : public NetlinkManager {
+ public:
+  struct CommandFaults {
+    int delay_ms = 0;
+    // 0 if the request is answered as usual.
+    int error = 0;
+    // 0 if dumps are complete.
+    size_t max_dump_messages = 0;
+  };
+
+  // |event_loop| runs the handlers of delayed asynchronous requests.
+  // |netlink_manager| is not owned and must outlive this object.
+  FaultInjectingNetlinkManager(EventLoop* event_loop,
+                               NetlinkManager* netlink_manager);
+  ~FaultInjectingNetlinkManager() override;
+
+  // Replaces the faults of requests with nl80211 command |command|.
+  void SetCommandFaults(uint8_t command, const CommandFaults& faults);
+  // Drops the next |count| multicast events with nl80211 command |command|.
+  // If |report_loss| is true, the handlers subscribed with
+  // |SubscribeEventsLost| are run after each dropped event, like kernel
+  // reports ENOBUFS. An event that has both a typed and a generic handler
+  // counts once for each.
+  void DropEvents(uint8_t command, uint32_t count, bool report_loss);
+  // Removes all faults, including events still to be dropped.
+  void ClearFaults();
+
+  bool Start() override;
+  bool IsStarted() const override;
+  uint32_t GetSequenceNumber() override;
+  uint16_t GetFamilyId() override;
+
+  bool RegisterHandlerAndSendMessage(
+      const NL80211Packet& packet,
+      std::function<void(std::unique_ptr<const NL80211Packet>)> handler)
+      override;
+  bool SendMessageAsync(const NL80211Packet& packet,
+                        OnResponsesReceivedHandler handler) override;
+  bool SendMessageAndGetResponses(
+      const NL80211Packet& packet,
+      std::vector<std::unique_ptr<const NL80211Packet>>* response) override;
+  bool SendMessageAndStreamResponses(
+      const NL80211Packet& packet,
+      std::function<void(const NL80211PacketView&)> handler) override;
+  bool SendMessagesAndGetResponses(
+      const std::vector<const NL80211Packet*>& packets,
+      std::vector<std::vector<std::unique_ptr<const NL80211Packet>>>*
+          responses) override;
+
+  void SetResponseTimeout(uint8_t command, int timeout_ms) override;
+  CommandLatencyStats GetCommandLatencyStats(uint16_t message_type,
+                                             uint8_t command) const override;
+  void DumpCommandLatencies(std::stringstream* ss) const override;
+  bool StartCapture(const std::string& path) override;
+  void StopCapture() override;
+  bool SubscribeToEvents(const std::string& group) override;
+
+  void SubscribeScanResultNotification(
+      uint32_t interface_index,
+      OnScanResultsReadyHandler handler) override;
+  void UnsubscribeScanResultNotification(uint32_t interface_index) override;
+  void SubscribeMlmeEvent(uint32_t interface_index,
+                          MlmeEventHandler* handler) override;
+  void UnsubscribeMlmeEvent(uint32_t interface_index) override;
+  void SubscribeSchedScanResultNotification(
+      uint32_t interface_index,
+      OnSchedScanResultsReadyHandler handler) override;
+  void UnsubscribeSchedScanResultNotification(
+      uint32_t interface_index) override;
+  void SubscribeRegDomainChange(uint32_t wiphy_index,
+                                OnRegDomainChangedHandler handler) override;
+  void UnsubscribeRegDomainChange(uint32_t wiphy_index) override;
+  void SubscribeInterfaceEvent(uint32_t wiphy_index,
+                               OnInterfaceEventHandler handler) override;
+  void UnsubscribeInterfaceEvent(uint32_t wiphy_index) override;
+  void SubscribeStationEvent(uint32_t interface_index,
+                             OnStationEventHandler handler) override;
+  void UnsubscribeStationEvent(uint32_t interface_index) override;
+  void SubscribeChannelSwitchEvent(
+      uint32_t interface_index,
+      OnChannelSwitchEventHandler handler) override;
+  void UnsubscribeChannelSwitchEvent(uint32_t interface_index) override;
+  void SubscribeFrameTxStatusEvent(
+      uint32_t interface_index,
+      OnFrameTxStatusEventHandler handler) override;
+  void UnsubscribeFrameTxStatusEvent(uint32_t interface_index) override;
+  void SubscribeCqmEvent(uint32_t interface_index,
+                         OnCqmEventHandler handler) override;
+  void UnsubscribeCqmEvent(uint32_t interface_index) override;
+  void Subscribe(uint8_t command,
+                 uint32_t interface_index,
+                 OnEventHandler handler) override;
+  void Unsubscribe(uint8_t command, uint32_t interface_index) override;
+  void SubscribeEventsLost(uint32_t interface_index,
+                           OnEventsLostHandler handler) override;
+  void UnsubscribeEventsLost(uint32_t interface_index) override;
+  void CreateInterfaceStrand(uint32_t interface_index) override;
+  void DestroyInterfaceStrand(uint32_t interface_index) override;
+
+ private:
+  // Forwards the MLME events that are not dropped to a MlmeEventHandler.
+  class MlmeEventFilter : public MlmeEventHandler {
+   public:
+    MlmeEventFilter(FaultInjectingNetlinkManager* owner,
+                    MlmeEventHandler* handler);
+    void OnConnect(std::unique_ptr<MlmeConnectEvent> event) override;
+    void OnRoam(std::unique_ptr<MlmeRoamEvent> event) override;
+    void OnAuthenticate(
+        std::unique_ptr<MlmeAuthenticateEvent> event) override;
+    void OnAssociate(std::unique_ptr<MlmeAssociateEvent> event) override;
+    void OnDisconnect(std::unique_ptr<MlmeDisconnectEvent> event) override;
+    void OnDisassociate(
+        std::unique_ptr<MlmeDisassociateEvent> event) override;
+
+   private:
+    FaultInjectingNetlinkManager* owner_;
+    MlmeEventHandler* handler_;
+  };
+
+  // Returns the faults of requests like |packet|.
+  CommandFaults GetFaults(const NL80211Packet& packet) const;
+  int GetResponseTimeoutMs(const NL80211Packet& packet) const;
+  // Blocks for the delay of the reply to |packet|, or its response timeout
+  // if that is shorter.
+  // Returns false if the reply arrives too late.
+  bool WaitForReply(const NL80211Packet& packet);
+  // Runs |task| on |event_loop_| after |delay_ms|, unless this object is
+  // destroyed first.
+  void PostDelayedTask(const std::function<void()>& task, int64_t delay_ms);
+  // Returns true if an event with nl80211 command |command| must be dropped.
+  bool ShouldDropEvent(uint8_t command);
+
+  EventLoop* event_loop_;
+  NetlinkManager* netlink_manager_;
+  std::map<uint8_t, CommandFaults> command_faults_;
+  // Number of events still to be dropped, for each nl80211 command.
+  std::map<uint8_t, uint32_t> events_to_drop_;
+  // Commands whose dropped events are reported as lost.
+  std::set<uint8_t> report_lost_events_;
+  std::map<uint8_t, int> response_timeouts_ms_;
+  std::map<uint32_t, OnEventsLostHandler> events_lost_handlers_;
+  std::map<uint32_t, std::unique_ptr<MlmeEventFilter>> mlme_event_filters_;
+  // Delayed tasks that did not run yet.
+  std::set<EventLoop::TimerId> pending_tasks_;
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_TEST_FAULT_INJECTING_NETLINK_MANAGER_H_
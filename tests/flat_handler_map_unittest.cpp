@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2016, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <functional>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "wificond/net/flat_handler_map.h"
+
+using std::function;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+const uint32_t kInterfaceIndex1 = 3;
+const uint32_t kInterfaceIndex2 = 12;
+const uint32_t kInterfaceIndex3 = 27;
+
+}  // namespace
+
+TEST(FlatHandlerMapTest, CanFindHandlers) {
+  FlatHandlerMap<function<int()>> handlers;
+  EXPECT_TRUE(handlers.empty());
+  handlers[kInterfaceIndex2] = [] { return 2; };
+  handlers[kInterfaceIndex1] = [] { return 1; };
+  EXPECT_EQ(2u, handlers.size());
+
+  auto handler = handlers.find(kInterfaceIndex1);
+  ASSERT_NE(handlers.end(), handler);
+  EXPECT_EQ(1, handler->second());
+  handler = handlers.find(kInterfaceIndex2);
+  ASSERT_NE(handlers.end(), handler);
+  EXPECT_EQ(2, handler->second());
+  EXPECT_EQ(handlers.end(), handlers.find(kInterfaceIndex3));
+}
+
+TEST(FlatHandlerMapTest, NewHandlerReplacesRegisteredHandler) {
+  FlatHandlerMap<function<int()>> handlers;
+  handlers[kInterfaceIndex1] = [] { return 1; };
+  handlers[kInterfaceIndex1] = [] { return 2; };
+  EXPECT_EQ(1u, handlers.size());
+  EXPECT_EQ(2, handlers.find(kInterfaceIndex1)->second());
+}
+
+TEST(FlatHandlerMapTest, CanEraseHandlers) {
+  FlatHandlerMap<function<int()>> handlers;
+  handlers[kInterfaceIndex1] = [] { return 1; };
+  handlers[kInterfaceIndex2] = [] { return 2; };
+  EXPECT_EQ(1u, handlers.erase(kInterfaceIndex1));
+  EXPECT_EQ(0u, handlers.erase(kInterfaceIndex3));
+  EXPECT_EQ(handlers.end(), handlers.find(kInterfaceIndex1));
+  EXPECT_NE(handlers.end(), handlers.find(kInterfaceIndex2));
+  EXPECT_EQ(1u, handlers.erase(kInterfaceIndex2));
+  EXPECT_TRUE(handlers.empty());
+}
+
+TEST(FlatHandlerMapTest, IteratesInIndexOrder) {
+  FlatHandlerMap<int> handlers;
+  handlers[kInterfaceIndex3] = 3;
+  handlers[kInterfaceIndex1] = 1;
+  handlers[kInterfaceIndex2] = 2;
+  vector<uint32_t> indexes;
+  for (const auto& handler : handlers) {
+    indexes.push_back(handler.first);
+  }
+  EXPECT_EQ(vector<uint32_t>({kInterfaceIndex1, kInterfaceIndex2,
+                              kInterfaceIndex3}),
+            indexes);
+}
+
+}  // namespace wificond
+}  // namespace android
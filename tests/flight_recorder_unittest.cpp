@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <errno.h>
+#include <linux/netlink.h>
+
+#include <gtest/gtest.h>
+
+#include "wificond/flight_recorder.h"
+
+using std::string;
+using std::stringstream;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr uint8_t kFakeCommand = 32;
+constexpr uint32_t kFakeInterfaceIndex = 12;
+constexpr uint32_t kFakeSequenceNumber = 42;
+
+FlightRecord CreateRecord(uint32_t sequence) {
+  FlightRecord record;
+  record.type = FlightRecord::kNetlinkSent;
+  record.command = kFakeCommand;
+  record.interface_index = kFakeInterfaceIndex;
+  record.sequence = sequence;
+  return record;
+}
+
+}  // namespace
+
+TEST(FlightRecorderTest, KeepsLatestRecordsInOrder) {
+  FlightRecorder recorder(4);
+  for (uint32_t i = 0; i < 6; i++) {
+    recorder.Add(CreateRecord(kFakeSequenceNumber + i));
+  }
+  vector<FlightRecord> records;
+  recorder.GetRecords(&records);
+  ASSERT_EQ(4u, records.size());
+  for (uint32_t i = 0; i < 4; i++) {
+    EXPECT_EQ(kFakeSequenceNumber + 2 + i, records[i].sequence);
+    EXPECT_EQ(kFakeInterfaceIndex, records[i].interface_index);
+    EXPECT_NE(0, records[i].timestamp_ns);
+  }
+}
+
+TEST(FlightRecorderTest, CanDumpRecords) {
+  FlightRecorder recorder;
+  FlightRecord record = CreateRecord(kFakeSequenceNumber);
+  record.timestamp_ns = 1000000;
+  recorder.Add(record);
+
+  stringstream decoded;
+  recorder.DumpDecoded(&decoded, 3000000);
+  EXPECT_NE(string::npos, decoded.str().find(
+      "-2.000ms nl-sent cmd=32 seq=42 if=12 len=0"));
+
+  stringstream raw;
+  recorder.DumpRaw(&raw);
+  string header;
+  string line;
+  ASSERT_TRUE(std::getline(raw, header));
+  EXPECT_EQ("flight-recorder version=1 record_size=32 records=1", header);
+  ASSERT_TRUE(std::getline(raw, line));
+  EXPECT_EQ(2 * sizeof(FlightRecord), line.size());
+}
+
+TEST(FlightRecorderTest, CanDumpControlMessageRecords) {
+  FlightRecorder recorder;
+  FlightRecord ack = CreateRecord(kFakeSequenceNumber);
+  ack.type = FlightRecord::kNetlinkReceived;
+  ack.command = 0;
+  ack.interface_index = 0;
+  ack.control_type = NLMSG_ERROR;
+  recorder.Add(ack);
+  FlightRecord error = ack;
+  error.status = ENODEV;
+  recorder.Add(error);
+  FlightRecord done = ack;
+  done.control_type = NLMSG_DONE;
+  recorder.Add(done);
+
+  stringstream decoded;
+  recorder.DumpDecoded(&decoded);
+  EXPECT_NE(string::npos, decoded.str().find(
+      "nl-received error errno=0 seq=42 len=0"));
+  EXPECT_NE(string::npos, decoded.str().find(
+      "nl-received error errno=19 seq=42 len=0"));
+  EXPECT_NE(string::npos, decoded.str().find(
+      "nl-received done seq=42 len=0"));
+  EXPECT_EQ(string::npos, decoded.str().find("cmd="));
+}
+
+TEST(FlightRecorderTest, CanRecordFromSeveralThreads) {
+  constexpr size_t kNumThreads = 4;
+  constexpr uint32_t kNumRecordsPerThread = 10000;
+  FlightRecorder recorder(64);
+  vector<std::thread> threads;
+  for (size_t i = 0; i < kNumThreads; i++) {
+    threads.emplace_back([&recorder]() {
+      for (uint32_t j = 0; j < kNumRecordsPerThread; j++) {
+        recorder.Add(CreateRecord(j));
+      }
+    });
+  }
+  vector<FlightRecord> records;
+  recorder.GetRecords(&records);
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  records.clear();
+  recorder.GetRecords(&records);
+  EXPECT_EQ(64u, records.size());
+  for (const FlightRecord& record : records) {
+    EXPECT_EQ(kFakeInterfaceIndex, record.interface_index);
+  }
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <set>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "wificond/scanning/hidden_ssid_rotation.h"
+
+using std::set;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+const vector<uint8_t> kFakeSsid1 = {'a'};
+const vector<uint8_t> kFakeSsid2 = {'b'};
+const vector<uint8_t> kFakeSsid3 = {'c'};
+const vector<uint8_t> kFakeSsid4 = {'d'};
+const vector<uint8_t> kFakeSsid5 = {'e'};
+
+}  // namespace
+
+TEST(HiddenSsidRotationTest, PicksAllSsidsThatFit) {
+  HiddenSsidRotation rotation;
+  vector<vector<uint8_t>> picked;
+  vector<vector<uint8_t>> skipped;
+  rotation.Pick({kFakeSsid1, kFakeSsid2}, 2, &picked, &skipped);
+  EXPECT_EQ((vector<vector<uint8_t>>{kFakeSsid1, kFakeSsid2}), picked);
+  EXPECT_TRUE(skipped.empty());
+}
+
+TEST(HiddenSsidRotationTest, RotatesSsidsThatDontFit) {
+  HiddenSsidRotation rotation;
+  const vector<vector<uint8_t>> ssids = {kFakeSsid1, kFakeSsid2, kFakeSsid3};
+
+  vector<vector<uint8_t>> picked;
+  vector<vector<uint8_t>> skipped;
+  rotation.Pick(ssids, 2, &picked, &skipped);
+  EXPECT_EQ((vector<vector<uint8_t>>{kFakeSsid1, kFakeSsid2}), picked);
+  EXPECT_EQ(vector<vector<uint8_t>>{kFakeSsid3}, skipped);
+
+  // |kFakeSsid3| was never probed, then |kFakeSsid1| comes first.
+  picked.clear();
+  skipped.clear();
+  rotation.Pick(ssids, 2, &picked, &skipped);
+  EXPECT_EQ((vector<vector<uint8_t>>{kFakeSsid1, kFakeSsid3}), picked);
+  EXPECT_EQ(vector<vector<uint8_t>>{kFakeSsid2}, skipped);
+
+  // |kFakeSsid2| was probed the longest ago, then |kFakeSsid1| comes first.
+  picked.clear();
+  skipped.clear();
+  rotation.Pick(ssids, 2, &picked, &skipped);
+  EXPECT_EQ((vector<vector<uint8_t>>{kFakeSsid1, kFakeSsid2}), picked);
+  EXPECT_EQ(vector<vector<uint8_t>>{kFakeSsid3}, skipped);
+}
+
+TEST(HiddenSsidRotationTest, CoversAllSsidsWithinBoundedNumberOfPicks) {
+  HiddenSsidRotation rotation;
+  const vector<vector<uint8_t>> ssids =
+      {kFakeSsid1, kFakeSsid2, kFakeSsid3, kFakeSsid4, kFakeSsid5};
+  // With room for 2 of 5 SSIDs, any 3 consecutive picks cover all of them.
+  vector<set<vector<uint8_t>>> picks;
+  for (int i = 0; i < 10; i++) {
+    vector<vector<uint8_t>> picked;
+    vector<vector<uint8_t>> skipped;
+    rotation.Pick(ssids, 2, &picked, &skipped);
+    EXPECT_EQ(2u, picked.size());
+    EXPECT_EQ(3u, skipped.size());
+    picks.emplace_back(picked.begin(), picked.end());
+  }
+  for (size_t i = 0; i + 3 <= picks.size(); i++) {
+    set<vector<uint8_t>> covered;
+    for (size_t j = i; j < i + 3; j++) {
+      covered.insert(picks[j].begin(), picks[j].end());
+    }
+    EXPECT_EQ(ssids.size(), covered.size());
+  }
+}
+
+TEST(HiddenSsidRotationTest, PicksNewSsidsFirst) {
+  HiddenSsidRotation rotation;
+  vector<vector<uint8_t>> picked;
+  vector<vector<uint8_t>> skipped;
+  rotation.Pick({kFakeSsid1, kFakeSsid2}, 1, &picked, &skipped);
+  EXPECT_EQ(vector<vector<uint8_t>>{kFakeSsid1}, picked);
+
+  picked.clear();
+  skipped.clear();
+  rotation.Pick({kFakeSsid1, kFakeSsid3}, 1, &picked, &skipped);
+  EXPECT_EQ(vector<vector<uint8_t>>{kFakeSsid3}, picked);
+  EXPECT_EQ(vector<vector<uint8_t>>{kFakeSsid1}, skipped);
+}
+
+TEST(HiddenSsidRotationTest, CanPickNoSsid) {
+  HiddenSsidRotation rotation;
+  vector<vector<uint8_t>> picked;
+  vector<vector<uint8_t>> skipped;
+  rotation.Pick({kFakeSsid1, kFakeSsid2}, 0, &picked, &skipped);
+  EXPECT_TRUE(picked.empty());
+  EXPECT_EQ((vector<vector<uint8_t>>{kFakeSsid1, kFakeSsid2}), skipped);
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <array>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "android/net/wifi/nl80211/IWifiScannerImpl.h"
+#include "wificond/scanning/info_element_utils.h"
+
+using android::net::wifi::nl80211::IWifiScannerImpl;
+using android::net::wifi::nl80211::InfoElementLocation;
+using android::net::wifi::nl80211::NativeScanResult;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+const vector<uint8_t> kSsidElement = {0x00, 0x02, 'a', 'b'};
+const vector<uint8_t> kHtCapabilitiesElement = {45, 0x02, 0x00, 0x00};
+const vector<uint8_t> kVhtCapabilitiesElement = {191, 0x02, 0x00, 0x00};
+const vector<uint8_t> kHeCapabilitiesElement = {255, 0x03, 35, 0x00, 0x00};
+// RSN with CCMP and the SAE and PSK AKM suites.
+const vector<uint8_t> kRsnSaeTransitionElement = {
+    48, 0x16,
+    0x01, 0x00,
+    0x00, 0x0f, 0xac, 0x04,
+    0x01, 0x00, 0x00, 0x0f, 0xac, 0x04,
+    0x02, 0x00, 0x00, 0x0f, 0xac, 0x08, 0x00, 0x0f, 0xac, 0x02};
+// WPA with TKIP and the PSK AKM suite.
+const vector<uint8_t> kWpaPskElement = {
+    221, 0x16,
+    0x00, 0x50, 0xf2, 0x01,
+    0x01, 0x00,
+    0x00, 0x50, 0xf2, 0x02,
+    0x01, 0x00, 0x00, 0x50, 0xf2, 0x02,
+    0x01, 0x00, 0x00, 0x50, 0xf2, 0x02};
+// HT operation on channel 36 with the secondary channel above it.
+const vector<uint8_t> kHt40OperationElement = {61, 0x03, 36, 0x01, 0x00};
+// VHT operation on an 160 MHz channel centered on channel 50.
+const vector<uint8_t> kVht160OperationElement = {192, 0x03, 0x01, 42, 50};
+// HE operation with a 6 GHz Operation Information field for a 160 MHz
+// channel centered on channel 15.
+const vector<uint8_t> kHe6Ghz160OperationElement = {
+    255, 0x0c, 36,
+    0x00, 0x00, 0x02,
+    0x00,
+    0x00, 0x00,
+    1, 0x03, 7, 15, 0x00};
+// Reduced Neighbor Report of an AP on channel 37 of operating class 131 with
+// a BSSID and a short SSID, two APs on channel 36 of operating class 115
+// with a TBTT offset only, and an AP of an unknown operating class.
+const vector<uint8_t> kReducedNeighborReportElement = {
+    201, 0x1b,
+    0x00, 0x0c, 131, 37,
+    0xff, 0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc, 0x78, 0x56, 0x34, 0x12, 0x00,
+    0x10, 0x01, 115, 36,
+    0x01,
+    0x02,
+    0x00, 0x01, 200, 1,
+    0x05};
+// BSS Load of 300 stations and a channel utilization of 128.
+const vector<uint8_t> kBssLoadElement = {11, 0x05, 0x2c, 0x01, 128, 0x00, 0x00};
+constexpr uint16_t kCapabilityPrivacy = 1 << 4;
+
+vector<uint8_t> Concat(const vector<vector<uint8_t>>& elements) {
+  vector<uint8_t> ie;
+  for (const auto& element : elements) {
+    ie.insert(ie.end(), element.begin(), element.end());
+  }
+  return ie;
+}
+
+NativeScanResult Decode(const vector<uint8_t>& ie, uint16_t capability) {
+  vector<InfoElementLocation> index;
+  EXPECT_TRUE(InfoElementUtils::IndexInfoElements(ie.data(), ie.size(),
+                                                  &index));
+  NativeScanResult scan_result;
+  InfoElementUtils::DecodeInfoElements(ie.data(), index, capability,
+                                       &scan_result);
+  return scan_result;
+}
+
+}  // namespace
+
+TEST(InfoElementUtilsTest, CanIndexInfoElements) {
+  vector<uint8_t> ie = Concat(
+      {kSsidElement, kHtCapabilitiesElement, kHeCapabilitiesElement});
+  vector<InfoElementLocation> index;
+  EXPECT_TRUE(InfoElementUtils::IndexInfoElements(ie.data(), ie.size(),
+                                                  &index));
+  vector<InfoElementLocation> expected_index = {
+      {0, 0, 2, 2}, {45, 0, 6, 2}, {255, 35, 10, 3}};
+  EXPECT_EQ(expected_index, index);
+
+  const InfoElementLocation* he_capabilities =
+      InfoElementUtils::Find(index, 255, 35);
+  ASSERT_NE(nullptr, he_capabilities);
+  EXPECT_EQ(10, he_capabilities->offset);
+  EXPECT_EQ(nullptr, InfoElementUtils::Find(index, 255, 36));
+
+  vector<uint8_t> ssid;
+  EXPECT_TRUE(InfoElementUtils::GetSsid(ie.data(), index, &ssid));
+  EXPECT_EQ(vector<uint8_t>({'a', 'b'}), ssid);
+}
+
+TEST(InfoElementUtilsTest, CanIndexElementsBeforeOverrunningElement) {
+  vector<uint8_t> ie = Concat({kSsidElement, {45, 0x04, 0x00}});
+  vector<InfoElementLocation> index;
+  EXPECT_FALSE(InfoElementUtils::IndexInfoElements(ie.data(), ie.size(),
+                                                   &index));
+  ASSERT_EQ(1u, index.size());
+  vector<uint8_t> ssid;
+  EXPECT_TRUE(InfoElementUtils::GetSsid(ie.data(), index, &ssid));
+}
+
+TEST(InfoElementUtilsTest, CanDecodeSecurity) {
+  EXPECT_EQ(IWifiScannerImpl::SCAN_RESULT_SECURITY_RSN |
+                IWifiScannerImpl::SCAN_RESULT_SECURITY_PSK |
+                IWifiScannerImpl::SCAN_RESULT_SECURITY_SAE,
+            Decode(Concat({kSsidElement, kRsnSaeTransitionElement}),
+                   kCapabilityPrivacy).security);
+  EXPECT_EQ(IWifiScannerImpl::SCAN_RESULT_SECURITY_WPA |
+                IWifiScannerImpl::SCAN_RESULT_SECURITY_PSK,
+            Decode(Concat({kSsidElement, kWpaPskElement}),
+                   kCapabilityPrivacy).security);
+  EXPECT_EQ(IWifiScannerImpl::SCAN_RESULT_SECURITY_WEP,
+            Decode(kSsidElement, kCapabilityPrivacy).security);
+  EXPECT_EQ(0, Decode(kSsidElement, 0).security);
+}
+
+TEST(InfoElementUtilsTest, CanDecodeChannelWidth) {
+  EXPECT_EQ(IWifiScannerImpl::SCAN_RESULT_CHANNEL_WIDTH_UNKNOWN,
+            Decode(kSsidElement, 0).channel_width);
+  EXPECT_EQ(IWifiScannerImpl::SCAN_RESULT_CHANNEL_WIDTH_40MHZ,
+            Decode(Concat({kSsidElement, kHt40OperationElement}),
+                   0).channel_width);
+  EXPECT_EQ(IWifiScannerImpl::SCAN_RESULT_CHANNEL_WIDTH_160MHZ,
+            Decode(Concat({kSsidElement, kHt40OperationElement,
+                           kVht160OperationElement}),
+                   0).channel_width);
+  EXPECT_EQ(IWifiScannerImpl::SCAN_RESULT_CHANNEL_WIDTH_160MHZ,
+            Decode(Concat({kSsidElement, kHe6Ghz160OperationElement}),
+                   0).channel_width);
+}
+
+TEST(InfoElementUtilsTest, CanDecodeWifiStandard) {
+  EXPECT_EQ(IWifiScannerImpl::SCAN_RESULT_WIFI_STANDARD_LEGACY,
+            Decode(kSsidElement, 0).wifi_standard);
+  EXPECT_EQ(IWifiScannerImpl::SCAN_RESULT_WIFI_STANDARD_11N,
+            Decode(Concat({kSsidElement, kHtCapabilitiesElement}),
+                   0).wifi_standard);
+  EXPECT_EQ(IWifiScannerImpl::SCAN_RESULT_WIFI_STANDARD_11AC,
+            Decode(Concat({kSsidElement, kHtCapabilitiesElement,
+                           kVhtCapabilitiesElement}),
+                   0).wifi_standard);
+  EXPECT_EQ(IWifiScannerImpl::SCAN_RESULT_WIFI_STANDARD_11AX,
+            Decode(Concat({kSsidElement, kHtCapabilitiesElement,
+                           kVhtCapabilitiesElement, kHeCapabilitiesElement}),
+                   0).wifi_standard);
+}
+
+TEST(InfoElementUtilsTest, CanGetReducedNeighbors) {
+  vector<uint8_t> ie = Concat({kSsidElement, kReducedNeighborReportElement});
+  vector<InfoElementLocation> index;
+  ASSERT_TRUE(InfoElementUtils::IndexInfoElements(ie.data(), ie.size(),
+                                                  &index));
+  vector<ReducedNeighbor> neighbors;
+  InfoElementUtils::GetReducedNeighbors(ie.data(), index, &neighbors);
+  ASSERT_EQ(3u, neighbors.size());
+
+  EXPECT_EQ(6135u, neighbors[0].frequency);
+  EXPECT_TRUE(neighbors[0].has_bssid);
+  EXPECT_EQ((std::array<uint8_t, ETH_ALEN>{0x12, 0x34, 0x56, 0x78, 0x9a,
+                                           0xbc}),
+            neighbors[0].bssid);
+  EXPECT_TRUE(neighbors[0].has_short_ssid);
+  EXPECT_EQ(0x12345678u, neighbors[0].short_ssid);
+
+  for (size_t i = 1; i < neighbors.size(); i++) {
+    EXPECT_EQ(5180u, neighbors[i].frequency);
+    EXPECT_FALSE(neighbors[i].has_bssid);
+    EXPECT_FALSE(neighbors[i].has_short_ssid);
+  }
+}
+
+TEST(InfoElementUtilsTest, CanSkipTruncatedNeighborApInformation) {
+  vector<uint8_t> ie = Concat({kSsidElement, kReducedNeighborReportElement});
+  // Leaves out the last byte of the first Neighbor AP Information field.
+  ie[kSsidElement.size() + 1] = 15;
+  ie.resize(kSsidElement.size() + 2 + 15);
+  vector<InfoElementLocation> index;
+  ASSERT_TRUE(InfoElementUtils::IndexInfoElements(ie.data(), ie.size(),
+                                                  &index));
+  vector<ReducedNeighbor> neighbors;
+  InfoElementUtils::GetReducedNeighbors(ie.data(), index, &neighbors);
+  EXPECT_TRUE(neighbors.empty());
+}
+
+TEST(InfoElementUtilsTest, CanGetBssLoad) {
+  vector<uint8_t> ie = Concat({kSsidElement, kBssLoadElement});
+  vector<InfoElementLocation> index;
+  ASSERT_TRUE(InfoElementUtils::IndexInfoElements(ie.data(), ie.size(),
+                                                  &index));
+  BssLoad bss_load;
+  ASSERT_TRUE(InfoElementUtils::GetBssLoad(ie.data(), index, &bss_load));
+  EXPECT_EQ(300u, bss_load.station_count);
+  EXPECT_EQ(128u, bss_load.channel_utilization);
+}
+
+TEST(InfoElementUtilsTest, CanSkipTruncatedBssLoad) {
+  vector<uint8_t> ie = Concat({kSsidElement, {11, 0x02, 0x01, 0x00}});
+  vector<InfoElementLocation> index;
+  ASSERT_TRUE(InfoElementUtils::IndexInfoElements(ie.data(), ie.size(),
+                                                  &index));
+  BssLoad bss_load;
+  EXPECT_FALSE(InfoElementUtils::GetBssLoad(ie.data(), index, &bss_load));
+}
+
+}  // namespace wificond
+}  // namespace android
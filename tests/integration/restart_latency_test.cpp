@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <binder/IServiceManager.h>
+#include <binder/ProcessState.h>
+#include <gtest/gtest.h>
+#include <utils/String16.h>
+#include <utils/StrongPointer.h>
+
+#include "android/net/wifi/nl80211/BnScanEvent.h"
+#include "android/net/wifi/nl80211/IClientInterface.h"
+#include "android/net/wifi/nl80211/IWifiScannerImpl.h"
+#include "android/net/wifi/nl80211/IWificond.h"
+#include "wificond/ipc_constants.h"
+#include "wificond/scanning/single_scan_settings.h"
+#include "wificond/tests/integration/process_utils.h"
+#include "wificond/tests/shell_utils.h"
+
+using android::base::StringPrintf;
+using android::binder::Status;
+using android::net::wifi::nl80211::BnScanEvent;
+using android::net::wifi::nl80211::IClientInterface;
+using android::net::wifi::nl80211::IWificond;
+using android::net::wifi::nl80211::IWifiScannerImpl;
+using android::net::wifi::nl80211::SingleScanSettings;
+using android::wificond::ipc_constants::kServiceName;
+using android::wificond::tests::integration::IsBinderServiceRegistered;
+using android::wificond::tests::integration::RunShellCommand;
+using android::wificond::tests::integration::ScopedDevModeWificond;
+using android::wificond::tests::integration::WaitForTrue;
+using android::wificond::tests::integration::WificondIsDead;
+using std::string;
+using std::vector;
+
+namespace android {
+namespace wificond {
+namespace {
+
+const char kInterfaceName[] = "wlan0";
+constexpr int kNumIterations = 10;
+constexpr int kScanTimeoutSeconds = 15;
+
+using Clock = std::chrono::steady_clock;
+
+// Waits for the scan it is subscribed to to complete.
+class ScanEventWaiter : public BnScanEvent {
+ public:
+  Status OnScanResultReady() override {
+    Complete(true);
+    return Status::ok();
+  }
+  Status OnScanFailed() override {
+    Complete(false);
+    return Status::ok();
+  }
+  Status OnPartialScanResultReady(int bands) override {
+    return Status::ok();
+  }
+
+  // Returns whether the scan succeeded within |timeout_seconds|.
+  bool WaitForScan(int timeout_seconds) {
+    std::unique_lock<std::mutex> lock(lock_);
+    if (!condition_.wait_for(lock, std::chrono::seconds(timeout_seconds),
+                             [this]() { return done_; })) {
+      return false;
+    }
+    return succeeded_;
+  }
+
+ private:
+  void Complete(bool succeeded) {
+    std::lock_guard<std::mutex> lock(lock_);
+    done_ = true;
+    succeeded_ = succeeded;
+    condition_.notify_all();
+  }
+
+  std::mutex lock_;
+  std::condition_variable condition_;
+  bool done_ = false;
+  bool succeeded_ = false;
+};
+
+double MillisecondsSince(Clock::time_point start_time) {
+  return std::chrono::duration<double, std::milli>(
+      Clock::now() - start_time).count();
+}
+
+// Returns the |percentile|th percentile of |samples|, with the nearest rank
+// method.
+double GetPercentile(vector<double> samples, int percentile) {
+  std::sort(samples.begin(), samples.end());
+  size_t rank = (percentile * samples.size() + 99) / 100;
+  return samples[std::max<size_t>(rank, 1) - 1];
+}
+
+// Latencies of the steps of a wificond restart, from "start wificond".
+struct RestartLatency {
+  double service_registered_ms;
+  double client_interface_created_ms;
+  double scan_done_ms;
+};
+
+// Restarts wificond, and measures how long it takes until it is registered,
+// a client interface is created, and the first scan on it succeeds.
+void MeasureRestart(RestartLatency* latency) {
+  RunShellCommand("stop wificond");
+  ASSERT_TRUE(WaitForTrue(WificondIsDead,
+                          ScopedDevModeWificond::kWificondDeathTimeoutSeconds));
+
+  Clock::time_point start_time = Clock::now();
+  RunShellCommand("start wificond");
+  ASSERT_TRUE(WaitForTrue(std::bind(IsBinderServiceRegistered, kServiceName),
+                          ScopedDevModeWificond::kWificondStartTimeoutSeconds));
+  latency->service_registered_ms = MillisecondsSince(start_time);
+
+  sp<IWificond> service;
+  ASSERT_EQ(NO_ERROR, getService(String16(kServiceName), &service));
+  ASSERT_NE(nullptr, service.get());
+  sp<IClientInterface> client_interface;
+  ASSERT_TRUE(service->createClientInterface(
+      kInterfaceName, &client_interface).isOk());
+  ASSERT_NE(nullptr, client_interface.get());
+  latency->client_interface_created_ms = MillisecondsSince(start_time);
+
+  sp<IWifiScannerImpl> scanner;
+  ASSERT_TRUE(client_interface->getWifiScannerImpl(&scanner).isOk());
+  ASSERT_NE(nullptr, scanner.get());
+  sp<ScanEventWaiter> scan_event_waiter(new ScanEventWaiter);
+  ASSERT_TRUE(scanner->subscribeScanEvents(scan_event_waiter).isOk());
+  SingleScanSettings settings;
+  settings.scan_type_ = IWifiScannerImpl::SCAN_TYPE_DEFAULT;
+  bool scan_started = false;
+  ASSERT_TRUE(scanner->scan(settings, &scan_started).isOk());
+  ASSERT_TRUE(scan_started);
+  ASSERT_TRUE(scan_event_waiter->WaitForScan(kScanTimeoutSeconds));
+  latency->scan_done_ms = MillisecondsSince(start_time);
+
+  EXPECT_TRUE(service->tearDownInterfaces().isOk());
+}
+
+void ReportPercentiles(const char* step, const vector<double>& samples) {
+  for (int percentile : {50, 90, 100}) {
+    double value = GetPercentile(samples, percentile);
+    string key = StringPrintf("%s_p%d_ms", step, percentile);
+    ::testing::Test::RecordProperty(key, StringPrintf("%.1f", value));
+    LOG(INFO) << key << ": " << value;
+  }
+}
+
+}  // namespace
+
+// Measures the latency of the Wi-Fi recovery path that restarts wificond, to
+// track it across driver and firmware releases. Percentiles are recorded as
+// test properties.
+TEST(RestartLatencyTest, MeasureRestartToFirstScan) {
+  // Scan events arrive on binder threads of this process.
+  ProcessState::self()->startThreadPool();
+  ScopedDevModeWificond dev_mode;
+  dev_mode.EnterDevModeOrDie();
+
+  vector<double> service_registered_ms;
+  vector<double> client_interface_created_ms;
+  vector<double> scan_done_ms;
+  for (int i = 0; i < kNumIterations; i++) {
+    RestartLatency latency;
+    MeasureRestart(&latency);
+    if (HasFatalFailure()) {
+      return;
+    }
+    service_registered_ms.push_back(latency.service_registered_ms);
+    client_interface_created_ms.push_back(
+        latency.client_interface_created_ms);
+    scan_done_ms.push_back(latency.scan_done_ms);
+  }
+  ReportPercentiles("service_registered", service_registered_ms);
+  ReportPercentiles("client_interface_created", client_interface_created_ms);
+  ReportPercentiles("first_scan_done", scan_done_ms);
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "wificond/keystore_blob_cache.h"
+
+using std::string;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr nsecs_t kFakeTtl = s2ns(10);
+constexpr nsecs_t kFakeNow = s2ns(1000);
+const char kFakeCertificateAlias[] = "CACERT_corp";
+const char kFakeOtherCertificateAlias[] = "USRCERT_corp";
+const vector<uint8_t> kFakeCertificate = {0x30, 0x82, 0x01, 0x0a};
+
+}  // namespace
+
+TEST(KeystoreBlobCacheTest, CanGetCachedBlob) {
+  KeystoreBlobCache cache(kFakeTtl);
+  vector<uint8_t> blob;
+  EXPECT_FALSE(cache.Get(kFakeCertificateAlias, kFakeNow, &blob));
+
+  cache.Put(kFakeCertificateAlias, kFakeCertificate, kFakeNow);
+  EXPECT_TRUE(cache.Get(kFakeCertificateAlias, kFakeNow + kFakeTtl - 1, &blob));
+  EXPECT_EQ(kFakeCertificate, blob);
+  EXPECT_FALSE(cache.Get(kFakeOtherCertificateAlias, kFakeNow, &blob));
+}
+
+TEST(KeystoreBlobCacheTest, ExpiresBlobAfterTtl) {
+  KeystoreBlobCache cache(kFakeTtl);
+  cache.Put(kFakeCertificateAlias, kFakeCertificate, kFakeNow);
+  vector<uint8_t> blob;
+  EXPECT_FALSE(cache.Get(kFakeCertificateAlias, kFakeNow + kFakeTtl, &blob));
+  // Putting the blob again starts a new TTL.
+  cache.Put(kFakeCertificateAlias, kFakeCertificate, kFakeNow + kFakeTtl);
+  EXPECT_TRUE(cache.Get(kFakeCertificateAlias, kFakeNow + kFakeTtl, &blob));
+}
+
+TEST(KeystoreBlobCacheTest, CanInvalidateAllBlobs) {
+  KeystoreBlobCache cache(kFakeTtl);
+  cache.Put(kFakeCertificateAlias, kFakeCertificate, kFakeNow);
+  cache.Put(kFakeOtherCertificateAlias, kFakeCertificate, kFakeNow);
+  cache.Invalidate();
+  vector<uint8_t> blob;
+  EXPECT_FALSE(cache.Get(kFakeCertificateAlias, kFakeNow, &blob));
+  EXPECT_FALSE(cache.Get(kFakeOtherCertificateAlias, kFakeNow, &blob));
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <cstring>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "wificond/link_stats_page.h"
+
+using ::android::base::unique_fd;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr int64_t kFakeTimestampNs = 0x123456789a;
+constexpr int32_t kFakeRssi = -62;
+constexpr uint32_t kFakeFrequency = 5745;
+constexpr uint32_t kFakeTxBitrate = 866;
+constexpr uint32_t kFakeRxBitrate = 780;
+constexpr int32_t kFakeTxPackets = 10000;
+constexpr int32_t kFakeTxFailed = 12;
+constexpr size_t kSequenceOffset = 8;
+
+LinkStats CreateLinkStats() {
+  LinkStats stats;
+  stats.associated = true;
+  stats.timestamp_ns = kFakeTimestampNs;
+  stats.rssi_dbm = kFakeRssi;
+  stats.frequency_mhz = kFakeFrequency;
+  stats.tx_bitrate_mbps = kFakeTxBitrate;
+  stats.rx_bitrate_mbps = kFakeRxBitrate;
+  stats.tx_packets = kFakeTxPackets;
+  stats.tx_failed = kFakeTxFailed;
+  return stats;
+}
+
+}  // namespace
+
+TEST(LinkStatsPageTest, CanReadUpdatesThroughReadOnlyMapping) {
+  LinkStatsPage page;
+  ASSERT_TRUE(page.Init());
+  unique_fd fd = page.GetReadOnlyFd();
+  ASSERT_GE(fd.get(), 0);
+
+  struct stat memory_stat;
+  ASSERT_EQ(0, fstat(fd.get(), &memory_stat));
+  size_t size = memory_stat.st_size;
+  EXPECT_EQ(LinkStatsPage::kPageSize, size);
+  // Readers cannot modify the statistics.
+  EXPECT_EQ(MAP_FAILED, mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                             MAP_SHARED, fd.get(), 0));
+
+  void* memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd.get(), 0);
+  ASSERT_NE(MAP_FAILED, memory);
+  const uint8_t* buffer = static_cast<const uint8_t*>(memory);
+  LinkStats stats;
+  ASSERT_TRUE(LinkStatsPage::Read(buffer, size, &stats));
+  EXPECT_FALSE(stats.associated);
+
+  // The mapping follows updates without being mapped again.
+  page.Update(CreateLinkStats());
+  ASSERT_TRUE(LinkStatsPage::Read(buffer, size, &stats));
+  munmap(memory, size);
+  EXPECT_TRUE(stats.associated);
+  EXPECT_EQ(kFakeTimestampNs, stats.timestamp_ns);
+  EXPECT_EQ(kFakeRssi, stats.rssi_dbm);
+  EXPECT_EQ(kFakeFrequency, stats.frequency_mhz);
+  EXPECT_EQ(kFakeTxBitrate, stats.tx_bitrate_mbps);
+  EXPECT_EQ(kFakeRxBitrate, stats.rx_bitrate_mbps);
+  EXPECT_EQ(kFakeTxPackets, stats.tx_packets);
+  EXPECT_EQ(kFakeTxFailed, stats.tx_failed);
+}
+
+TEST(LinkStatsPageTest, RejectsPageBeingWritten) {
+  LinkStatsPage page;
+  ASSERT_TRUE(page.Init());
+  page.Update(CreateLinkStats());
+  unique_fd fd = page.GetReadOnlyFd();
+  ASSERT_GE(fd.get(), 0);
+  void* memory = mmap(nullptr, LinkStatsPage::kPageSize, PROT_READ,
+                      MAP_SHARED, fd.get(), 0);
+  ASSERT_NE(MAP_FAILED, memory);
+  vector<uint8_t> buffer(static_cast<const uint8_t*>(memory),
+                         static_cast<const uint8_t*>(memory) +
+                             LinkStatsPage::kPageSize);
+  munmap(memory, LinkStatsPage::kPageSize);
+
+  LinkStats stats;
+  EXPECT_TRUE(LinkStatsPage::Read(buffer.data(), buffer.size(), &stats));
+  // Freeze the page in the middle of an update.
+  uint32_t sequence;
+  memcpy(&sequence, buffer.data() + kSequenceOffset, sizeof(sequence));
+  sequence++;
+  memcpy(buffer.data() + kSequenceOffset, &sequence, sizeof(sequence));
+  EXPECT_FALSE(LinkStatsPage::Read(buffer.data(), buffer.size(), &stats));
+}
+
+TEST(LinkStatsPageTest, RejectsTruncatedPage) {
+  LinkStatsPage page;
+  ASSERT_TRUE(page.Init());
+  unique_fd fd = page.GetReadOnlyFd();
+  ASSERT_GE(fd.get(), 0);
+  void* memory = mmap(nullptr, LinkStatsPage::kPageSize, PROT_READ,
+                      MAP_SHARED, fd.get(), 0);
+  ASSERT_NE(MAP_FAILED, memory);
+  LinkStats stats;
+  EXPECT_FALSE(LinkStatsPage::Read(static_cast<const uint8_t*>(memory), 16,
+                                   &stats));
+  munmap(memory, LinkStatsPage::kPageSize);
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include <linux/if_ether.h>
+
+#include <gtest/gtest.h>
+
+#include "wificond/fixed_string.h"
+#include "wificond/log_rate_limiter.h"
+#include "wificond/logging_utils.h"
+
+using std::array;
+using std::string;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+const array<uint8_t, ETH_ALEN> kFakeMacAddress = {
+    {0xc0, 0xee, 0xfb, 0x0a, 0x34, 0x56}};
+const vector<uint8_t> kFakeSsid = {'G', 'o', 'o', 'g', 'l', 'e'};
+const vector<uint8_t> kFakeSsidWithControlCharacters = {'a', '\n', 0xff, '\\'};
+constexpr uint32_t kFakeMaxMessages = 2;
+constexpr nsecs_t kFakeInterval = s2ns(1);
+
+}  // namespace
+
+TEST(FixedStringTest, CanAppendFormattedText) {
+  FixedString<16> str;
+  EXPECT_TRUE(str.empty());
+  str.Appendf("%d-%s", 42, "abc");
+  str.Append('!');
+  EXPECT_STREQ("42-abc!", str.c_str());
+  EXPECT_EQ(7u, str.size());
+  EXPECT_FALSE(str.truncated());
+}
+
+TEST(FixedStringTest, MarksTruncatedText) {
+  FixedString<8> str;
+  str.Appendf("%s", "0123");
+  str.Appendf("%s", "456789");
+  EXPECT_STREQ("0123...", str.c_str());
+  EXPECT_TRUE(str.truncated());
+  // Nothing is appended after truncation.
+  str.Append('a');
+  EXPECT_STREQ("0123...", str.c_str());
+}
+
+TEST(LoggingUtilsTest, CanFormatMac) {
+  EXPECT_STREQ("c0:ee:fb:0a:34:56",
+               LoggingUtils::FormatMac(kFakeMacAddress).c_str());
+  EXPECT_EQ("c0:ee:fb:0a:34:56", LoggingUtils::GetMacString(kFakeMacAddress));
+}
+
+TEST(LoggingUtilsTest, CanFormatSsid) {
+  EXPECT_STREQ("Google", LoggingUtils::FormatSsid(kFakeSsid).c_str());
+  EXPECT_STREQ("a\\x0a\\xff\\x5c",
+               LoggingUtils::FormatSsid(kFakeSsidWithControlCharacters)
+                   .c_str());
+  // An SSID of only escaped bytes fits.
+  auto ssid = LoggingUtils::FormatSsid(vector<uint8_t>(32, 0));
+  EXPECT_FALSE(ssid.truncated());
+  EXPECT_EQ(128u, ssid.size());
+}
+
+TEST(LoggingUtilsTest, CanFormatLists) {
+  EXPECT_STREQ("Google, , Google",
+               LoggingUtils::FormatSsidList({kFakeSsid, {}, kFakeSsid})
+                   .c_str());
+  EXPECT_STREQ("2412, 5180",
+               LoggingUtils::FormatFrequencies({2412, 5180}).c_str());
+  EXPECT_STREQ("", LoggingUtils::FormatFrequencies({}).c_str());
+  auto frequencies =
+      LoggingUtils::FormatFrequencies(vector<uint32_t>(200, 5180));
+  EXPECT_TRUE(frequencies.truncated());
+}
+
+TEST(LogRateLimiterTest, SuppressesMessagesOverLimit) {
+  LogRateLimiter limiter(kFakeMaxMessages, kFakeInterval);
+  nsecs_t now = s2ns(100);
+  EXPECT_TRUE(limiter.ShouldLog(now));
+  EXPECT_STREQ("", limiter.TakeSuppressedNote().c_str());
+  EXPECT_TRUE(limiter.ShouldLog(now));
+  EXPECT_FALSE(limiter.ShouldLog(now));
+  EXPECT_FALSE(limiter.ShouldLog(now + kFakeInterval - 1));
+  EXPECT_EQ(2u, limiter.GetNumSuppressed());
+
+  // Messages are let through again in the next interval, and the first one
+  // reports the suppressed messages.
+  EXPECT_TRUE(limiter.ShouldLog(now + kFakeInterval));
+  EXPECT_STREQ("(2 similar messages suppressed) ",
+               limiter.TakeSuppressedNote().c_str());
+  EXPECT_EQ(0u, limiter.GetNumSuppressed());
+}
+
+TEST(LogRateLimiterTest, OnlyEvaluatesMessageWhenLogged) {
+  LogRateLimiter limiter(kFakeMaxMessages, s2ns(3600));
+  int num_evaluated = 0;
+  auto evaluate = [&num_evaluated]() { return ++num_evaluated; };
+  for (int i = 0; i < 5; i++) {
+    LOG_RATE_LIMITED(INFO, limiter) << "Fake message " << evaluate();
+  }
+  EXPECT_EQ(static_cast<int>(kFakeMaxMessages), num_evaluated);
+  EXPECT_EQ(3u, limiter.GetNumSuppressed());
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -15,8 +15,13 @@
  */
 
 #include <string.h>
+#include <unistd.h>
 
 #include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include <android-base/logging.h>
 #include <android-base/unique_fd.h>
@@ -104,6 +109,142 @@ TEST_F(WificondLooperBackedEventLoopTest,
   EXPECT_TRUE(task_executed);
 }
 
+TEST_F(WificondLooperBackedEventLoopTest,
+       LooperBackedEventLoopPostTaskWithPriorityTest) {
+  std::string order;
+  event_loop_->PostTaskWithPriority([&order]() { order += "low "; },
+                                    EventLoop::kPriorityLow);
+  event_loop_->PostTask([&order]() { order += "normal "; });
+  event_loop_->PostTaskWithPriority([&order]() { order += "high1 "; },
+                                    EventLoop::kPriorityHigh);
+  event_loop_->PostTaskWithPriority([&order]() { order += "high2 "; },
+                                    EventLoop::kPriorityHigh);
+  event_loop_->PollForOne(0);
+  EXPECT_EQ("high1 high2 normal low ", order);
+}
+
+TEST_F(WificondLooperBackedEventLoopTest,
+       LooperBackedEventLoopRunsTasksPostedByTasksOnNextWakeupTest) {
+  std::string order;
+  event_loop_->PostTaskWithPriority(
+      [this, &order]() {
+        order += "first ";
+        event_loop_->PostTaskWithPriority([&order]() { order += "high "; },
+                                          EventLoop::kPriorityHigh);
+      },
+      EventLoop::kPriorityNormal);
+  event_loop_->PostTaskWithPriority([&order]() { order += "low "; },
+                                    EventLoop::kPriorityLow);
+  event_loop_->PollForOne(0);
+  // The new task overtakes the low priority task, but does not extend the
+  // batch.
+  EXPECT_EQ("first high ", order);
+  event_loop_->PollForOne(0);
+  EXPECT_EQ("first high low ", order);
+}
+
+TEST_F(WificondLooperBackedEventLoopTest,
+       LooperBackedEventLoopPostTaskFromManyThreadsTest) {
+  const int kNumThreads = 4;
+  const int kNumTasksPerThread = 100;
+  int num_executed_tasks = 0;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; i++) {
+    threads.emplace_back([this, &num_executed_tasks]() {
+      for (int j = 0; j < kNumTasksPerThread; j++) {
+        event_loop_->PostTask([&num_executed_tasks]() {
+          num_executed_tasks++;
+        });
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  // All tasks were posted by now, so one wakeup runs them all.
+  event_loop_->PollForOne(0);
+  EXPECT_EQ(kNumThreads * kNumTasksPerThread, num_executed_tasks);
+}
+
+TEST_F(WificondLooperBackedEventLoopTest,
+       LooperBackedEventLoopRunsMoreTasksThanItsPoolHoldsTest) {
+  // More than the pool of task nodes holds, so that some are allocated.
+  const int kNumTasks = 1000;
+  std::vector<int> high_tasks;
+  std::vector<int> low_tasks;
+  for (int round = 0; round < 2; round++) {
+    high_tasks.clear();
+    low_tasks.clear();
+    for (int i = 0; i < kNumTasks; i++) {
+      if (i % 2 == 0) {
+        event_loop_->PostTaskWithPriority(
+            [&high_tasks, &low_tasks, i]() {
+              EXPECT_TRUE(low_tasks.empty());
+              high_tasks.push_back(i);
+            },
+            EventLoop::kPriorityHigh);
+      } else {
+        event_loop_->PostTaskWithPriority(
+            [&low_tasks, i]() { low_tasks.push_back(i); },
+            EventLoop::kPriorityLow);
+      }
+    }
+    // The nodes of the first round are reused by the second one.
+    event_loop_->PollForOne(0);
+    ASSERT_EQ(static_cast<size_t>(kNumTasks / 2), high_tasks.size());
+    ASSERT_EQ(static_cast<size_t>(kNumTasks / 2), low_tasks.size());
+    for (int i = 0; i < kNumTasks / 2; i++) {
+      EXPECT_EQ(2 * i, high_tasks[i]);
+      EXPECT_EQ(2 * i + 1, low_tasks[i]);
+    }
+  }
+}
+
+TEST_F(WificondLooperBackedEventLoopTest,
+       LooperBackedEventLoopDropsTasksOnDestructionTest) {
+  bool task_executed = false;
+  event_loop_->PostTask([&task_executed]() { task_executed = true; });
+  event_loop_->PostDelayedTask([&task_executed]() { task_executed = true; },
+                               0);
+  event_loop_.reset(new LooperBackedEventLoop());
+  event_loop_->TriggerExit();
+  event_loop_->Poll();
+  EXPECT_FALSE(task_executed);
+}
+
+TEST_F(WificondLooperBackedEventLoopTest,
+       LooperBackedEventLoopCancelDelayedTaskTest) {
+  bool task_executed = false;
+  EventLoop::TimerId timer_id = event_loop_->PostCancelableDelayedTask(
+      [&task_executed]() { task_executed = true; }, 10, 0);
+  EXPECT_NE(EventLoop::kInvalidTimerId, timer_id);
+  EXPECT_TRUE(event_loop_->CancelDelayedTask(timer_id));
+  EXPECT_FALSE(event_loop_->CancelDelayedTask(timer_id));
+  event_loop_->PostDelayedTask([this]() { event_loop_->TriggerExit(); }, 50);
+  event_loop_->Poll();
+  EXPECT_FALSE(task_executed);
+}
+
+TEST_F(WificondLooperBackedEventLoopTest,
+       LooperBackedEventLoopCoalescesDelayedTasksTest) {
+  std::string order;
+  // The first task may wait for the second one.
+  event_loop_->PostCancelableDelayedTask(
+      [&order]() { order += "first "; }, 10, 200);
+  event_loop_->PostCancelableDelayedTask(
+      [this, &order]() {
+        order += "second ";
+        event_loop_->TriggerExit();
+      },
+      100, 0);
+  event_loop_->PollForOne(50);
+  EXPECT_EQ("", order);
+  StopWatch stopWatch("CoalescedTasks");
+  event_loop_->Poll();
+  EXPECT_EQ("first second ", order);
+  EXPECT_NEAR(50, ns2ms(stopWatch.elapsedTime()), kTimingToleranceMs);
+}
+
 TEST_F(WificondLooperBackedEventLoopTest, LooperBackedEventLoopWatchFdInputReadyTest) {
   Pipe pipe;
   bool read_result = false;
@@ -162,5 +303,25 @@ TEST_F(WificondLooperBackedEventLoopTest, LooperBackedEventLoopStopWatchFdTest)
   EXPECT_EQ(false, read_result);
 }
 
+TEST_F(WificondLooperBackedEventLoopTest, LooperBackedEventLoopDumpTest) {
+  Pipe pipe;
+  EXPECT_TRUE(event_loop_->WatchFileDescriptor(
+      pipe.receive_fd,
+      EventLoop::kModeInput,
+      [&pipe, this](int fd) {
+          pipe.readSignal();
+          usleep(20 * 1000);
+          event_loop_->TriggerExit();}));
+  event_loop_->SetFileDescriptorLabel(pipe.receive_fd, "test pipe");
+  event_loop_->PostTask([&pipe]() { pipe.writeSignal(); });
+  event_loop_->Poll();
+
+  std::stringstream ss;
+  event_loop_->Dump(&ss);
+  EXPECT_NE(std::string::npos, ss.str().find("test pipe callbacks: 1,"));
+  EXPECT_NE(std::string::npos,
+            ss.str().find("Longest handler: test pipe callback"));
+}
+
 }  // namespace wificond
 }  // namespace android
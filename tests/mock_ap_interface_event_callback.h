@@ -34,6 +34,9 @@ class MockApInterfaceEventCallback
   MOCK_METHOD0(onAsBinder, IBinder*());
   MOCK_METHOD2(onConnectedClientsChanged, ::android::binder::Status(
     const android::net::wifi::nl80211::NativeWifiClient &, bool isConnected));
+  MOCK_METHOD2(onConnectedClientsBatchChanged, ::android::binder::Status(
+    const std::vector<android::net::wifi::nl80211::NativeWifiClient>&,
+    const std::vector<android::net::wifi::nl80211::NativeWifiClient>&));
   MOCK_METHOD2(onSoftApChannelSwitched, ::android::binder::Status(int, int));
 };
 
@@ -44,7 +44,8 @@ MockClientInterfaceImpl::MockClientInterfaceImpl(
         std::array<uint8_t, ETH_ALEN>(kTestInterfaceMacAddress),
         interface_tool,
         netlink_utils,
-        scan_utils) {}
+        scan_utils,
+        nullptr) {}
 
 }  // namespace wificond
 }  // namespace android
@@ -38,8 +38,19 @@ class MockNetlinkManager : public NetlinkManager {
   MOCK_CONST_METHOD0(IsStarted, bool());
   MOCK_METHOD2(SendMessageAndGetResponses,
       bool(const NL80211Packet&, std::vector<std::unique_ptr<const NL80211Packet>>*));
+  MOCK_METHOD2(SendMessagesAndGetResponses,
+      bool(const std::vector<const NL80211Packet*>&,
+           std::vector<std::vector<std::unique_ptr<const NL80211Packet>>>*));
+  MOCK_METHOD2(SendMessageAndStreamResponses,
+      bool(const NL80211Packet&, std::function<void(const NL80211PacketView&)>));
   MOCK_METHOD2(RegisterHandlerAndSendMessage,
       bool(const NL80211Packet&, std::function<void(std::unique_ptr<const NL80211Packet>)>));
+  MOCK_METHOD2(SendMessageAsync,
+      bool(const NL80211Packet&, OnResponsesReceivedHandler));
+  MOCK_METHOD2(SubscribeScanResultNotification,
+      void(uint32_t, OnScanResultsReadyHandler));
+  MOCK_METHOD2(SubscribeSchedScanResultNotification,
+      void(uint32_t, OnSchedScanResultsReadyHandler));
 };  // class MockNetlinkManager
 
 }  // namespace wificond
@@ -34,9 +34,18 @@ class MockNetlinkUtils : public NetlinkUtils {
                bool(uint32_t* out_wiphy_index, const std::string& iface_name));
   MOCK_METHOD1(UnsubscribeMlmeEvent, void(uint32_t interface_index));
   MOCK_METHOD1(UnsubscribeRegDomainChange, void(uint32_t wiphy_index));
+  MOCK_METHOD1(UnsubscribeInterfaceEvent, void(uint32_t wiphy_index));
   MOCK_METHOD1(UnsubscribeStationEvent, void(uint32_t interface_index));
   MOCK_METHOD1(UnsubscribeChannelSwitchEvent, void(uint32_t interface_index));
   MOCK_METHOD1(UnsubscribeFrameTxStatusEvent, void(uint32_t interface_index));
+  MOCK_METHOD1(UnsubscribeEventsLost, void(uint32_t interface_index));
+  MOCK_METHOD1(UnsubscribeCqmEvent, void(uint32_t interface_index));
+  MOCK_METHOD1(CreateInterfaceStrand, void(uint32_t interface_index));
+  MOCK_METHOD1(DestroyInterfaceStrand, void(uint32_t interface_index));
+  MOCK_METHOD1(DumpCommandLatencies, void(std::stringstream* ss));
+  MOCK_METHOD1(GetMemoryAccounts,
+               void(std::vector<MemoryAccount>* accounts));
+  MOCK_METHOD0(TrimMemory, void());
   MOCK_METHOD1(GetProtocolFeatures, bool(uint32_t* features));
 
   MOCK_METHOD2(SetInterfaceMode,
@@ -47,6 +56,9 @@ class MockNetlinkUtils : public NetlinkUtils {
   MOCK_METHOD2(SubscribeRegDomainChange,
                void(uint32_t wiphy_index,
                     OnRegDomainChangedHandler handler));
+  MOCK_METHOD2(SubscribeInterfaceEvent,
+               void(uint32_t wiphy_index,
+                    OnInterfaceEventHandler handler));
   MOCK_METHOD2(SubscribeStationEvent,
                void(uint32_t interface_index,
                     OnStationEventHandler handler));
@@ -56,7 +68,24 @@ class MockNetlinkUtils : public NetlinkUtils {
   MOCK_METHOD2(SubscribeFrameTxStatusEvent,
                void(uint32_t interface_index,
                     OnFrameTxStatusEventHandler handler));
+  MOCK_METHOD2(SubscribeEventsLost,
+               void(uint32_t interface_index,
+                    OnEventsLostHandler handler));
+  MOCK_METHOD2(SubscribeCqmEvent,
+               void(uint32_t interface_index,
+                    OnCqmEventHandler handler));
+  MOCK_METHOD3(SetCqmRssiConfig,
+               bool(uint32_t interface_index,
+                    int32_t rssi_threshold_dbm,
+                    uint32_t rssi_hysteresis_db));
+  MOCK_METHOD4(SetCqmTxErrorConfig,
+               bool(uint32_t interface_index,
+                    uint32_t rate_percent,
+                    uint32_t packets,
+                    uint32_t interval_seconds));
 
+  MOCK_METHOD2(GetInterfaceFrequency,
+               bool(uint32_t interface_index, uint32_t* out_frequency));
   MOCK_METHOD2(GetInterfaces,
                bool(uint32_t wiphy_index,
                     std::vector<InterfaceInfo>* interfaces));
@@ -65,11 +94,32 @@ class MockNetlinkUtils : public NetlinkUtils {
                     BandInfo* band_info,
                     ScanCapabilities* scan_capabilities,
                     WiphyFeatures* wiphy_features));
+  MOCK_METHOD3(GetStationInfo,
+               bool(uint32_t interface_index,
+                    const std::array<uint8_t, ETH_ALEN>& mac_address,
+                    StationInfo* out_station_info));
+  MOCK_METHOD2(GetStationList,
+               bool(uint32_t interface_index,
+                    std::vector<std::array<uint8_t, ETH_ALEN>>*
+                        out_mac_addresses));
+  MOCK_METHOD1(GetRegDomain, bool(RegDomain* out_reg_domain));
+  MOCK_METHOD2(GetChannelSurveys,
+               bool(uint32_t interface_index,
+                    std::vector<ChannelSurvey>* out_surveys));
+  MOCK_METHOD2(GetStationStatsList,
+               bool(uint32_t interface_index,
+                    std::vector<StationStats>* out_station_stats));
   MOCK_METHOD4(SendMgmtFrame,
                bool(uint32_t interface_index,
                     const std::vector<uint8_t>& frame,
                     int32_t mcs,
                     uint64_t* out_cookie));
+  MOCK_METHOD5(SendCommandAsync,
+               bool(uint32_t interface_index,
+                    uint8_t command,
+                    uint16_t flags,
+                    const std::vector<uint8_t>& attributes,
+                    OnCommandRepliesHandler handler));
 
 };  // class MockNetlinkUtils
 
@@ -16,11 +16,26 @@
 
 #include "wificond/tests/mock_scan_utils.h"
 
+using std::vector;
+using testing::_;
+using testing::Invoke;
+
 namespace android {
 namespace wificond {
 
 MockScanUtils::MockScanUtils(NetlinkManager* netlink_manager)
     : ScanUtils(netlink_manager) {
+  ON_CALL(*this, Scan(_, _, _, _, _, _, _))
+      .WillByDefault(Invoke([this](uint32_t interface_index,
+                                   bool request_random_mac,
+                                   int scan_type,
+                                   const vector<vector<uint8_t>>& ssids,
+                                   const vector<uint32_t>& freqs,
+                                   ScanRequestCache* request_cache,
+                                   int* error_code) {
+        return Scan(interface_index, request_random_mac, scan_type, ssids,
+                    freqs, error_code);
+      }));
 }
 
 }  // namespace wificond
@@ -19,6 +19,7 @@
 
 #include <gmock/gmock.h>
 
+#include "wificond/scanning/network_matcher.h"
 #include "wificond/scanning/scan_utils.h"
 
 namespace android {
@@ -37,9 +38,50 @@ class MockScanUtils : public ScanUtils {
   MOCK_METHOD2(SubscribeScanResultNotification,void(
       uint32_t interface_index,
       OnScanResultsReadyHandler handler));
+  MOCK_METHOD2(SubscribeSchedScanResultNotification, void(
+      uint32_t interface_index,
+      OnSchedScanResultsReadyHandler handler));
   MOCK_METHOD2(GetScanResult, bool(
       uint32_t interface_index,
       std::vector<android::net::wifi::nl80211::NativeScanResult>* out_scan_results));
+  MOCK_METHOD2(GetScanResultBatch, bool(
+      uint32_t interface_index,
+      ScanResultBatch* out_batch));
+  MOCK_METHOD3(GetScanResult, bool(
+      uint32_t interface_index,
+      const SsidMatcher& ssids,
+      std::vector<android::net::wifi::nl80211::NativeScanResult>* out_scan_results));
+  MOCK_METHOD3(GetScanResultBatch, bool(
+      uint32_t interface_index,
+      const SsidMatcher& ssids,
+      ScanResultBatch* out_batch));
+  MOCK_CONST_METHOD1(HasUpToDateScanResults, bool(uint32_t interface_index));
+  MOCK_METHOD1(UpdateScanResultCache, bool(uint32_t interface_index));
+  MOCK_METHOD3(QueryScanResults, bool(
+      uint32_t interface_index,
+      const android::net::wifi::nl80211::ScanResultQuery& query,
+      std::vector<android::net::wifi::nl80211::NativeScanResult>* out_scan_results));
+  MOCK_METHOD3(GetScanResultDelta, bool(
+      uint32_t interface_index,
+      int64_t generation,
+      android::net::wifi::nl80211::NativeScanResultsDelta* out_delta));
+  MOCK_METHOD2(SetPeerRadioInterfaces, void(
+      uint32_t interface_index,
+      const std::vector<uint32_t>& peer_interface_indices));
+  MOCK_CONST_METHOD2(GetNumScanResults, size_t(
+      uint32_t interface_index,
+      int32_t band));
+  MOCK_CONST_METHOD2(GetColocated6GhzFrequencies, void(
+      uint32_t interface_index,
+      std::vector<uint32_t>* out_frequencies));
+  MOCK_METHOD2(GetChannelCongestion, bool(
+      uint32_t interface_index,
+      std::vector<android::net::wifi::nl80211::NativeChannelCongestion>*
+          out_channels));
+  MOCK_CONST_METHOD2(GetChannelHistory, bool(
+      const std::vector<uint8_t>& ssid,
+      std::vector<uint32_t>* out_frequencies));
+  MOCK_METHOD0(TrimScanResultCache, void());
 
   MOCK_METHOD6(Scan, bool(
       uint32_t interface_index,
@@ -48,6 +90,15 @@ class MockScanUtils : public ScanUtils {
       const std::vector<std::vector<uint8_t>>& ssids,
       const std::vector<uint32_t>& freqs,
       int* error_code));
+  // Calls the mock above by default, so that tests can expect either.
+  MOCK_METHOD7(Scan, bool(
+      uint32_t interface_index,
+      bool request_random_mac,
+      int scan_type,
+      const std::vector<std::vector<uint8_t>>& ssids,
+      const std::vector<uint32_t>& freqs,
+      ScanRequestCache* request_cache,
+      int* error_code));
 
   MOCK_METHOD10(StartScheduledScan, bool(
       uint32_t interface_index,
@@ -61,6 +112,18 @@ class MockScanUtils : public ScanUtils {
       const std::vector<uint32_t>& freqs,
       int* error_code));
 
+  MOCK_METHOD10(RestartScheduledScan, bool(
+      uint32_t interface_index,
+      const SchedScanIntervalSetting& interval_setting,
+      int32_t rssi_threshold_2g,
+      int32_t rssi_threshold_5g,
+      int32_t rssi_threshold_6g,
+      const SchedScanReqFlags& req_flags,
+      const std::vector<std::vector<uint8_t>>& scan_ssids,
+      const std::vector<std::vector<uint8_t>>& match_ssids,
+      const std::vector<uint32_t>& freqs,
+      int* error_code));
+
 };  // class MockScanUtils
 
 }  // namespace wificond
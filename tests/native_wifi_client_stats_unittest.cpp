@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "wificond/client/native_wifi_client_stats.h"
+
+using ::android::net::wifi::nl80211::NativeWifiClientStats;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+const vector<uint8_t> kMacAddress = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06 };
+const int64_t kRxBytes = 5000000000;
+const int64_t kTxBytes = 1234;
+const int32_t kSignalDbm = -55;
+const int32_t kInactiveTimeMs = 300;
+const int32_t kConnectedTimeS = 60;
+
+}  // namespace
+
+class NativeWifiClientStatsTest : public ::testing::Test {
+};
+
+TEST_F(NativeWifiClientStatsTest, NativeWifiClientStatsParcelableTest) {
+  NativeWifiClientStats client_stats;
+  client_stats.mac_address_ = kMacAddress;
+  client_stats.rx_bytes_ = kRxBytes;
+  client_stats.tx_bytes_ = kTxBytes;
+  client_stats.signal_dbm_ = kSignalDbm;
+  client_stats.inactive_time_ms_ = kInactiveTimeMs;
+  client_stats.connected_time_s_ = kConnectedTimeS;
+
+  Parcel parcel;
+  EXPECT_EQ(::android::OK, client_stats.writeToParcel(&parcel));
+
+  NativeWifiClientStats client_stats_copy;
+  parcel.setDataPosition(0);
+  EXPECT_EQ(::android::OK, client_stats_copy.readFromParcel(&parcel));
+
+  EXPECT_EQ(client_stats, client_stats_copy);
+
+  NativeWifiClientStats client_stats_other = client_stats;
+  client_stats_other.tx_bytes_++;
+  EXPECT_FALSE(client_stats == client_stats_other);
+}
+
+}  // namespace wificond
+}  // namespace android
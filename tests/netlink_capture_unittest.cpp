@@ -0,0 +1,300 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <linux/genetlink.h>
+#include <linux/netlink.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <android-base/test_utils.h>
+#include <gtest/gtest.h>
+
+#include "wificond/flight_recorder.h"
+#include "wificond/looper_backed_event_loop.h"
+#include "wificond/net/kernel-header-latest/nl80211.h"
+#include "wificond/net/netlink_capture.h"
+#include "wificond/net/netlink_manager.h"
+#include "wificond/net/nl80211_attribute.h"
+#include "wificond/net/nl80211_packet.h"
+#include "wificond/tests/replay_netlink_manager.h"
+
+using std::array;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr uint16_t kFakeFamilyId = 0x1c;
+constexpr uint32_t kFakeSequenceNumber = 1;
+constexpr uint32_t kFakeInterfaceIndex = 12;
+constexpr uint32_t kFakeWiphyIndex = 3;
+const char kFakeInterfaceName[] = "wlan0";
+const array<uint8_t, ETH_ALEN> kFakeMacAddress = {
+    {0xc0, 0xee, 0xfb, 0x12, 0x34, 0x56}};
+
+void WritePacket(NetlinkCaptureWriter* writer,
+                 NetlinkCaptureRecord::Direction direction,
+                 bool async_socket,
+                 const NL80211Packet& packet) {
+  const vector<uint8_t>& data = packet.GetConstData();
+  struct iovec iov = {const_cast<uint8_t*>(data.data()), data.size()};
+  writer->Write(direction, async_socket, &iov, 1);
+}
+
+// Creates the NLMSG_ERROR message that kernel replies to request
+// |sequence| with. An |error_code| of 0 makes an ACK.
+NL80211Packet CreateErrorMessage(uint32_t sequence, int error_code) {
+  vector<uint8_t> data(NLMSG_HDRLEN + NLMSG_ALIGN(sizeof(nlmsgerr)), 0);
+  nlmsghdr* nl_header = reinterpret_cast<nlmsghdr*>(data.data());
+  nl_header->nlmsg_len = data.size();
+  nl_header->nlmsg_type = NLMSG_ERROR;
+  nl_header->nlmsg_seq = sequence;
+  nl_header->nlmsg_pid = getpid();
+  nlmsgerr* error_message =
+      reinterpret_cast<nlmsgerr*>(data.data() + NLMSG_HDRLEN);
+  error_message->error = -error_code;
+  // The echoed request header is not made of nl80211 attributes.
+  error_message->msg.nlmsg_type = kFakeFamilyId;
+  return NL80211Packet(data);
+}
+
+// Writes a nl80211 family discovery to |writer|.
+void WriteFamilyDiscovery(NetlinkCaptureWriter* writer) {
+  NL80211Packet get_family_request(GENL_ID_CTRL,
+                                   CTRL_CMD_GETFAMILY,
+                                   kFakeSequenceNumber,
+                                   getpid());
+  get_family_request.AddAttribute(
+      NL80211Attr<string>(CTRL_ATTR_FAMILY_NAME, NL80211_GENL_NAME));
+  WritePacket(writer, NetlinkCaptureRecord::kSent, false, get_family_request);
+
+  NL80211Packet new_family(GENL_ID_CTRL,
+                           CTRL_CMD_NEWFAMILY,
+                           kFakeSequenceNumber,
+                           getpid());
+  new_family.AddAttribute(
+      NL80211Attr<uint16_t>(CTRL_ATTR_FAMILY_ID, kFakeFamilyId));
+  new_family.AddAttribute(
+      NL80211Attr<string>(CTRL_ATTR_FAMILY_NAME, NL80211_GENL_NAME));
+  WritePacket(writer, NetlinkCaptureRecord::kReceived, false, new_family);
+}
+
+// Writes a capture of a nl80211 family discovery, followed by a station
+// event.
+void WriteFakeCapture(const string& path) {
+  NetlinkCaptureWriter writer;
+  ASSERT_TRUE(writer.Open(path));
+  WriteFamilyDiscovery(&writer);
+
+  NL80211Packet new_station(kFakeFamilyId, NL80211_CMD_NEW_STATION, 0, 0);
+  new_station.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, kFakeInterfaceIndex));
+  new_station.AddAttribute(
+      NL80211Attr<array<uint8_t, ETH_ALEN>>(NL80211_ATTR_MAC, kFakeMacAddress));
+  WritePacket(&writer, NetlinkCaptureRecord::kReceived, true, new_station);
+}
+
+}  // namespace
+
+class NetlinkCaptureTest : public ::testing::Test {
+ protected:
+  LooperBackedEventLoop event_loop_;
+  TemporaryFile capture_file_;
+};
+
+TEST_F(NetlinkCaptureTest, CanReadBackRecords) {
+  WriteFakeCapture(capture_file_.path);
+
+  vector<NetlinkCaptureRecord> records;
+  ASSERT_TRUE(ReadNetlinkCapture(capture_file_.path, &records));
+  ASSERT_EQ(3u, records.size());
+  EXPECT_EQ(NetlinkCaptureRecord::kSent, records[0].direction);
+  EXPECT_FALSE(records[0].async_socket);
+  EXPECT_EQ(NetlinkCaptureRecord::kReceived, records[1].direction);
+  EXPECT_FALSE(records[1].async_socket);
+  EXPECT_EQ(NetlinkCaptureRecord::kReceived, records[2].direction);
+  EXPECT_TRUE(records[2].async_socket);
+  EXPECT_LE(records[0].timestamp, records[2].timestamp);
+
+  NL80211Packet station_event(records[2].data);
+  EXPECT_TRUE(station_event.IsValid());
+  EXPECT_EQ(NL80211_CMD_NEW_STATION, station_event.GetCommand());
+}
+
+TEST_F(NetlinkCaptureTest, CanDropTruncatedRecord) {
+  WriteFakeCapture(capture_file_.path);
+  struct stat file_stat;
+  ASSERT_EQ(0, stat(capture_file_.path, &file_stat));
+  ASSERT_EQ(0, truncate(capture_file_.path, file_stat.st_size - 1));
+
+  vector<NetlinkCaptureRecord> records;
+  ASSERT_TRUE(ReadNetlinkCapture(capture_file_.path, &records));
+  EXPECT_EQ(2u, records.size());
+}
+
+TEST_F(NetlinkCaptureTest, CanReplayFamilyDiscoveryAndEvents) {
+  WriteFakeCapture(capture_file_.path);
+
+  ReplayNetlinkManager netlink_manager(&event_loop_);
+  ASSERT_TRUE(netlink_manager.LoadCapture(capture_file_.path));
+  ASSERT_TRUE(netlink_manager.Start());
+  EXPECT_EQ(kFakeFamilyId, netlink_manager.GetFamilyId());
+
+  vector<array<uint8_t, ETH_ALEN>> new_stations;
+  netlink_manager.SubscribeStationEvent(
+      kFakeInterfaceIndex,
+      [&new_stations](StationEvent event,
+                      const array<uint8_t, ETH_ALEN>& mac_address) {
+        if (event == NEW_STATION) {
+          new_stations.push_back(mac_address);
+        }
+      });
+  EXPECT_EQ(1u, netlink_manager.ReplayEvents());
+  ASSERT_EQ(1u, new_stations.size());
+  EXPECT_EQ(kFakeMacAddress, new_stations[0]);
+}
+
+TEST_F(NetlinkCaptureTest, HandlerCanSubscribeWhileBeingRun) {
+  WriteFakeCapture(capture_file_.path);
+
+  ReplayNetlinkManager netlink_manager(&event_loop_);
+  ASSERT_TRUE(netlink_manager.LoadCapture(capture_file_.path));
+  ASSERT_TRUE(netlink_manager.Start());
+
+  vector<string> events;
+  const string kTag = "station event of " + string(kFakeInterfaceName);
+  netlink_manager.SubscribeStationEvent(
+      kFakeInterfaceIndex,
+      [&netlink_manager, &events, kTag](
+          StationEvent event, const array<uint8_t, ETH_ALEN>& mac_address) {
+        // Moves the entry of this handler around and then removes it.
+        for (uint32_t if_index = 0; if_index < kFakeInterfaceIndex;
+             if_index++) {
+          netlink_manager.SubscribeStationEvent(
+              if_index,
+              [](StationEvent, const array<uint8_t, ETH_ALEN>&) {});
+        }
+        netlink_manager.UnsubscribeStationEvent(kFakeInterfaceIndex);
+        // The captures of this handler must still be valid.
+        events.push_back(kTag);
+      });
+  EXPECT_EQ(1u, netlink_manager.ReplayEvents());
+  EXPECT_EQ(vector<string>{kTag}, events);
+}
+
+TEST_F(NetlinkCaptureTest, CanReplayInterfaceEvents) {
+  {
+    NetlinkCaptureWriter writer;
+    ASSERT_TRUE(writer.Open(capture_file_.path));
+    WriteFamilyDiscovery(&writer);
+    NL80211Packet del_interface(
+        kFakeFamilyId, NL80211_CMD_DEL_INTERFACE, 0, 0);
+    del_interface.AddAttribute(
+        NL80211Attr<uint32_t>(NL80211_ATTR_WIPHY, kFakeWiphyIndex));
+    del_interface.AddAttribute(
+        NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, kFakeInterfaceIndex));
+    del_interface.AddAttribute(
+        NL80211Attr<string>(NL80211_ATTR_IFNAME, kFakeInterfaceName));
+    del_interface.AddAttribute(
+        NL80211Attr<array<uint8_t, ETH_ALEN>>(NL80211_ATTR_MAC,
+                                              kFakeMacAddress));
+    WritePacket(&writer, NetlinkCaptureRecord::kReceived, true, del_interface);
+  }
+
+  ReplayNetlinkManager netlink_manager(&event_loop_);
+  ASSERT_TRUE(netlink_manager.LoadCapture(capture_file_.path));
+  ASSERT_TRUE(netlink_manager.Start());
+  vector<string> deleted_interfaces;
+  netlink_manager.SubscribeInterfaceEvent(
+      kFakeWiphyIndex,
+      [&deleted_interfaces](InterfaceEvent event,
+                            uint32_t if_index,
+                            const string& if_name,
+                            const array<uint8_t, ETH_ALEN>& mac_address) {
+        EXPECT_EQ(kFakeInterfaceIndex, if_index);
+        EXPECT_EQ(kFakeMacAddress, mac_address);
+        if (event == DEL_INTERFACE) {
+          deleted_interfaces.push_back(if_name);
+        }
+      });
+  EXPECT_EQ(1u, netlink_manager.ReplayEvents());
+  EXPECT_EQ(vector<string>{kFakeInterfaceName}, deleted_interfaces);
+}
+
+TEST_F(NetlinkCaptureTest, RecordsAckAndErrorRepliesAsSuch) {
+  {
+    NetlinkCaptureWriter writer;
+    ASSERT_TRUE(writer.Open(capture_file_.path));
+    WriteFamilyDiscovery(&writer);
+    WritePacket(&writer, NetlinkCaptureRecord::kReceived, true,
+                CreateErrorMessage(kFakeSequenceNumber + 1, 0));
+    WritePacket(&writer, NetlinkCaptureRecord::kReceived, true,
+                CreateErrorMessage(kFakeSequenceNumber + 2, ENODEV));
+  }
+
+  ReplayNetlinkManager netlink_manager(&event_loop_);
+  ASSERT_TRUE(netlink_manager.LoadCapture(capture_file_.path));
+  ASSERT_TRUE(netlink_manager.Start());
+  FlightRecorder recorder;
+  FlightRecorder::SetInstance(&recorder);
+  EXPECT_EQ(2u, netlink_manager.ReplayEvents());
+  FlightRecorder::SetInstance(nullptr);
+
+  vector<FlightRecord> records;
+  recorder.GetRecords(&records);
+  ASSERT_EQ(2u, records.size());
+  EXPECT_EQ(NLMSG_ERROR, records[0].control_type);
+  EXPECT_EQ(0, records[0].command);
+  EXPECT_EQ(0, records[0].status);
+  EXPECT_EQ(0u, records[0].interface_index);
+  EXPECT_EQ(NLMSG_ERROR, records[1].control_type);
+  EXPECT_EQ(0, records[1].command);
+  EXPECT_EQ(ENODEV, records[1].status);
+
+  std::stringstream decoded;
+  recorder.DumpDecoded(&decoded);
+  EXPECT_NE(string::npos, decoded.str().find(
+      "nl-received error errno=0 seq=2"));
+  EXPECT_NE(string::npos, decoded.str().find(
+      "nl-received error errno=19 seq=3"));
+}
+
+TEST_F(NetlinkCaptureTest, CanReplayRecordedFamilyDiscovery) {
+  NetlinkManager netlink_manager(&event_loop_);
+  ASSERT_TRUE(netlink_manager.StartCapture(capture_file_.path));
+  ASSERT_TRUE(netlink_manager.Start());
+  netlink_manager.StopCapture();
+
+  ReplayNetlinkManager replay_netlink_manager(&event_loop_);
+  ASSERT_TRUE(replay_netlink_manager.LoadCapture(capture_file_.path));
+  ASSERT_TRUE(replay_netlink_manager.Start());
+  EXPECT_EQ(netlink_manager.GetFamilyId(),
+            replay_netlink_manager.GetFamilyId());
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2016, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <map>
+#include <vector>
+
+#include <linux/genetlink.h>
+#include <linux/netlink.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <android-base/unique_fd.h>
+#include <gtest/gtest.h>
+
+#include "wificond/net/kernel-header-latest/nl80211.h"
+#include "wificond/net/netlink_event_filter.h"
+#include "wificond/net/nl80211_attribute.h"
+#include "wificond/net/nl80211_packet.h"
+
+using android::base::unique_fd;
+using std::map;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr uint16_t kFakeFamilyId = 14;
+constexpr uint16_t kFakeOtherFamilyId = 15;
+constexpr uint32_t kFakeSequenceNumber = 162;
+constexpr uint32_t kFakeInterfaceIndex1 = 3;
+constexpr uint32_t kFakeInterfaceIndex2 = 0x01020304;
+constexpr uint32_t kFakeUnsubscribedInterfaceIndex = 4;
+
+// Attaches the filter to one netlink socket and sends messages to it from
+// another one. Kernel runs the filter on unicast messages the same way as on
+// multicast events.
+class NetlinkEventFilterTest : public ::testing::Test {
+ protected:
+  unique_fd receiver_fd_;
+  unique_fd sender_fd_;
+  uint32_t receiver_port_id_;
+
+  void SetUp() override {
+    ASSERT_TRUE(SetupSocket(&receiver_fd_, &receiver_port_id_));
+    uint32_t sender_port_id;
+    ASSERT_TRUE(SetupSocket(&sender_fd_, &sender_port_id));
+  }
+
+  bool SetupSocket(unique_fd* netlink_fd, uint32_t* port_id) {
+    netlink_fd->reset(
+        socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_GENERIC));
+    if (netlink_fd->get() < 0) {
+      return false;
+    }
+    struct sockaddr_nl nladdr = {};
+    nladdr.nl_family = AF_NETLINK;
+    if (bind(netlink_fd->get(),
+             reinterpret_cast<struct sockaddr*>(&nladdr),
+             sizeof(nladdr)) < 0) {
+      return false;
+    }
+    socklen_t nladdr_length = sizeof(nladdr);
+    if (getsockname(netlink_fd->get(),
+                    reinterpret_cast<struct sockaddr*>(&nladdr),
+                    &nladdr_length) < 0) {
+      return false;
+    }
+    *port_id = nladdr.nl_pid;
+    return true;
+  }
+
+  void AttachFilter(const map<uint8_t, EventFilterRule>& rules) {
+    vector<sock_filter> program;
+    ASSERT_TRUE(BuildEventFilter(kFakeFamilyId, rules, &program));
+    struct sock_fprog filter;
+    filter.len = program.size();
+    filter.filter = program.data();
+    ASSERT_EQ(0, setsockopt(receiver_fd_.get(), SOL_SOCKET, SO_ATTACH_FILTER,
+                            &filter, sizeof(filter)));
+  }
+
+  // Returns true if |packet| passes the filter.
+  bool SendAndReceive(const NL80211Packet& packet) {
+    struct sockaddr_nl nladdr = {};
+    nladdr.nl_family = AF_NETLINK;
+    nladdr.nl_pid = receiver_port_id_;
+    const vector<uint8_t>& data = packet.GetConstData();
+    EXPECT_EQ(static_cast<ssize_t>(data.size()),
+              sendto(sender_fd_.get(), data.data(), data.size(), 0,
+                     reinterpret_cast<struct sockaddr*>(&nladdr),
+                     sizeof(nladdr)));
+    uint8_t buffer[256];
+    return recv(receiver_fd_.get(), buffer, sizeof(buffer),
+                MSG_DONTWAIT) == static_cast<ssize_t>(data.size());
+  }
+};
+
+NL80211Packet CreateEvent(uint8_t command, uint32_t interface_index) {
+  NL80211Packet event(kFakeFamilyId, command, 0, 0);
+  event.AddAttribute(NL80211Attr<uint32_t>(NL80211_ATTR_WIPHY, 1));
+  event.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, interface_index));
+  return event;
+}
+
+}  // namespace
+
+TEST_F(NetlinkEventFilterTest, AcceptsEventsOfSubscribedInterfaces) {
+  map<uint8_t, EventFilterRule> rules;
+  rules[NL80211_CMD_NEW_STATION].interface_indexes =
+      {kFakeInterfaceIndex1, kFakeInterfaceIndex2};
+  AttachFilter(rules);
+
+  EXPECT_TRUE(SendAndReceive(
+      CreateEvent(NL80211_CMD_NEW_STATION, kFakeInterfaceIndex1)));
+  EXPECT_TRUE(SendAndReceive(
+      CreateEvent(NL80211_CMD_NEW_STATION, kFakeInterfaceIndex2)));
+  EXPECT_FALSE(SendAndReceive(
+      CreateEvent(NL80211_CMD_NEW_STATION, kFakeUnsubscribedInterfaceIndex)));
+}
+
+TEST_F(NetlinkEventFilterTest, DropsEventsOfUnsubscribedCommands) {
+  map<uint8_t, EventFilterRule> rules;
+  rules[NL80211_CMD_NEW_STATION].interface_indexes = {kFakeInterfaceIndex1};
+  rules[NL80211_CMD_REG_CHANGE].accept_all = true;
+  AttachFilter(rules);
+
+  EXPECT_FALSE(SendAndReceive(
+      CreateEvent(NL80211_CMD_NEW_SCAN_RESULTS, kFakeInterfaceIndex1)));
+  EXPECT_TRUE(SendAndReceive(
+      NL80211Packet(kFakeFamilyId, NL80211_CMD_REG_CHANGE, 0, 0)));
+  // Events without an interface index cannot match an interface rule.
+  EXPECT_FALSE(SendAndReceive(
+      NL80211Packet(kFakeFamilyId, NL80211_CMD_NEW_STATION, 0, 0)));
+}
+
+TEST_F(NetlinkEventFilterTest, AcceptsMessagesOtherThanEvents) {
+  AttachFilter(map<uint8_t, EventFilterRule>());
+
+  EXPECT_FALSE(SendAndReceive(
+      CreateEvent(NL80211_CMD_NEW_STATION, kFakeInterfaceIndex1)));
+  // A reply to one of our own requests.
+  EXPECT_TRUE(SendAndReceive(NL80211Packet(
+      kFakeFamilyId, NL80211_CMD_NEW_STATION, kFakeSequenceNumber, 0)));
+  EXPECT_TRUE(SendAndReceive(
+      NL80211Packet(kFakeOtherFamilyId, NL80211_CMD_NEW_STATION, 0, 0)));
+}
+
+}  // namespace wificond
+}  // namespace android
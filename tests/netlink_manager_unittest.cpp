@@ -15,11 +15,22 @@
  */
 
 #include <memory>
+#include <string>
+#include <vector>
+
+#include <linux/genetlink.h>
+#include <unistd.h>
 
 #include <gtest/gtest.h>
 
 #include "wificond/looper_backed_event_loop.h"
+#include "wificond/net/kernel-header-latest/nl80211.h"
 #include "wificond/net/netlink_manager.h"
+#include "wificond/net/nl80211_packet.h"
+
+using std::string;
+using std::unique_ptr;
+using std::vector;
 
 namespace android {
 namespace wificond {
@@ -41,5 +52,186 @@ TEST_F(NetlinkManagerTest, CanSetupNetlinkManagerInARowTest) {
   EXPECT_TRUE(netlink_manager.Start());
 }
 
+TEST_F(NetlinkManagerTest, CanReceiveMultipartDumpTest) {
+  NetlinkManager netlink_manager(event_loop_.get());
+  ASSERT_TRUE(netlink_manager.Start());
+
+  NL80211Packet dump_families_request(GENL_ID_CTRL,
+                                      CTRL_CMD_GETFAMILY,
+                                      netlink_manager.GetSequenceNumber(),
+                                      getpid());
+  dump_families_request.AddFlag(NLM_F_DUMP);
+  vector<unique_ptr<const NL80211Packet>> responses;
+  EXPECT_TRUE(netlink_manager.SendMessageAndGetResponses(dump_families_request,
+                                                         &responses));
+  // At least nlctrl and nl80211 families are registered.
+  EXPECT_LE(2u, responses.size());
+  for (const auto& packet : responses) {
+    EXPECT_EQ(GENL_ID_CTRL, packet->GetMessageType());
+    EXPECT_EQ(CTRL_CMD_NEWFAMILY, packet->GetCommand());
+  }
+}
+
+TEST_F(NetlinkManagerTest, CanSendMessageAsyncTest) {
+  NetlinkManager netlink_manager(event_loop_.get());
+  ASSERT_TRUE(netlink_manager.Start());
+
+  NL80211Packet get_family_request(GENL_ID_CTRL,
+                                   CTRL_CMD_GETFAMILY,
+                                   netlink_manager.GetSequenceNumber(),
+                                   getpid());
+  get_family_request.AddAttribute(
+      NL80211Attr<string>(CTRL_ATTR_FAMILY_NAME, NL80211_GENL_NAME));
+
+  bool handler_called = false;
+  bool request_success = false;
+  size_t num_responses = 0;
+  EXPECT_TRUE(netlink_manager.SendMessageAsync(
+      get_family_request,
+      [&](bool success, vector<unique_ptr<const NL80211Packet>> responses) {
+        handler_called = true;
+        request_success = success;
+        num_responses = responses.size();
+      }));
+  // The reply is only received while the event loop is running.
+  EXPECT_FALSE(handler_called);
+  for (int i = 0; i < 10 && !handler_called; i++) {
+    event_loop_->PollForOne(100);
+  }
+  EXPECT_TRUE(handler_called);
+  EXPECT_TRUE(request_success);
+  EXPECT_EQ(1u, num_responses);
+}
+
+TEST_F(NetlinkManagerTest, DestroyingCancelsAsyncRequestTimeoutTest) {
+  bool handler_called = false;
+  {
+    NetlinkManager netlink_manager(event_loop_.get());
+    ASSERT_TRUE(netlink_manager.Start());
+    NL80211Packet get_family_request(GENL_ID_CTRL,
+                                     CTRL_CMD_GETFAMILY,
+                                     netlink_manager.GetSequenceNumber(),
+                                     getpid());
+    get_family_request.AddAttribute(
+        NL80211Attr<string>(CTRL_ATTR_FAMILY_NAME, NL80211_GENL_NAME));
+    EXPECT_TRUE(netlink_manager.SendMessageAsync(
+        get_family_request,
+        [&](bool success, vector<unique_ptr<const NL80211Packet>> responses) {
+          handler_called = true;
+        }));
+  }
+  // The timeout of the request would have fired by now, had it not been
+  // canceled along with the manager it refers to.
+  for (int i = 0; i < 5; i++) {
+    event_loop_->PollForOne(100);
+  }
+  EXPECT_FALSE(handler_called);
+}
+
+TEST_F(NetlinkManagerTest, CanSendBatchedMessagesTest) {
+  NetlinkManager netlink_manager(event_loop_.get());
+  ASSERT_TRUE(netlink_manager.Start());
+
+  NL80211Packet get_nl80211_family(GENL_ID_CTRL,
+                                   CTRL_CMD_GETFAMILY,
+                                   netlink_manager.GetSequenceNumber(),
+                                   getpid());
+  get_nl80211_family.AddAttribute(
+      NL80211Attr<string>(CTRL_ATTR_FAMILY_NAME, NL80211_GENL_NAME));
+  NL80211Packet get_ctrl_family(GENL_ID_CTRL,
+                                CTRL_CMD_GETFAMILY,
+                                netlink_manager.GetSequenceNumber(),
+                                getpid());
+  get_ctrl_family.AddAttribute(
+      NL80211Attr<string>(CTRL_ATTR_FAMILY_NAME, "nlctrl"));
+
+  vector<vector<unique_ptr<const NL80211Packet>>> responses;
+  EXPECT_TRUE(netlink_manager.SendMessagesAndGetResponses(
+      {&get_nl80211_family, &get_ctrl_family}, &responses));
+  ASSERT_EQ(2u, responses.size());
+  ASSERT_EQ(1u, responses[0].size());
+  ASSERT_EQ(1u, responses[1].size());
+  string family_name;
+  EXPECT_TRUE(responses[0][0]->GetAttributeValue(CTRL_ATTR_FAMILY_NAME,
+                                                 &family_name));
+  EXPECT_EQ(NL80211_GENL_NAME, family_name);
+  EXPECT_TRUE(responses[1][0]->GetAttributeValue(CTRL_ATTR_FAMILY_NAME,
+                                                 &family_name));
+  EXPECT_EQ("nlctrl", family_name);
+}
+
+TEST_F(NetlinkManagerTest, CannotBatchDumpRequestsTest) {
+  NetlinkManager netlink_manager(event_loop_.get());
+  ASSERT_TRUE(netlink_manager.Start());
+
+  NL80211Packet get_family_request(GENL_ID_CTRL,
+                                   CTRL_CMD_GETFAMILY,
+                                   netlink_manager.GetSequenceNumber(),
+                                   getpid());
+  get_family_request.AddAttribute(
+      NL80211Attr<string>(CTRL_ATTR_FAMILY_NAME, NL80211_GENL_NAME));
+  NL80211Packet dump_families_request(GENL_ID_CTRL,
+                                      CTRL_CMD_GETFAMILY,
+                                      netlink_manager.GetSequenceNumber(),
+                                      getpid());
+  dump_families_request.AddFlag(NLM_F_DUMP);
+
+  vector<vector<unique_ptr<const NL80211Packet>>> responses;
+  EXPECT_FALSE(netlink_manager.SendMessagesAndGetResponses(
+      {&get_family_request, &dump_families_request}, &responses));
+}
+
+TEST_F(NetlinkManagerTest, RecordsCommandLatencyTest) {
+  NetlinkManager netlink_manager(event_loop_.get());
+  ASSERT_TRUE(netlink_manager.Start());
+  // Start() looks up the nl80211 family itself.
+  CommandLatencyStats stats_before =
+      netlink_manager.GetCommandLatencyStats(GENL_ID_CTRL, CTRL_CMD_GETFAMILY);
+
+  NL80211Packet get_family_request(GENL_ID_CTRL,
+                                   CTRL_CMD_GETFAMILY,
+                                   netlink_manager.GetSequenceNumber(),
+                                   getpid());
+  get_family_request.AddAttribute(
+      NL80211Attr<string>(CTRL_ATTR_FAMILY_NAME, NL80211_GENL_NAME));
+  vector<unique_ptr<const NL80211Packet>> responses;
+  EXPECT_TRUE(netlink_manager.SendMessageAndGetResponses(get_family_request,
+                                                         &responses));
+
+  CommandLatencyStats stats =
+      netlink_manager.GetCommandLatencyStats(GENL_ID_CTRL, CTRL_CMD_GETFAMILY);
+  EXPECT_EQ(stats_before.num_completed + 1, stats.num_completed);
+  EXPECT_EQ(stats_before.num_failed, stats.num_failed);
+  EXPECT_LT(0, stats.max_latency);
+  EXPECT_LE(stats.max_latency, stats.total_latency);
+  EXPECT_EQ(stats_before.num_messages + 1, stats.num_messages);
+  EXPECT_LT(stats_before.num_bytes, stats.num_bytes);
+  uint32_t num_histogram_entries = 0;
+  for (uint32_t bucket : stats.latency_histogram) {
+    num_histogram_entries += bucket;
+  }
+  EXPECT_EQ(stats.num_completed, num_histogram_entries);
+}
+
+TEST_F(NetlinkManagerTest, CountsErrorRepliesTest) {
+  NetlinkManager netlink_manager(event_loop_.get());
+  ASSERT_TRUE(netlink_manager.Start());
+
+  NL80211Packet get_family_request(GENL_ID_CTRL,
+                                   CTRL_CMD_GETFAMILY,
+                                   netlink_manager.GetSequenceNumber(),
+                                   getpid());
+  get_family_request.AddAttribute(
+      NL80211Attr<string>(CTRL_ATTR_FAMILY_NAME, "no_such_family"));
+  int error_code = 0;
+  EXPECT_TRUE(netlink_manager.SendMessageAndGetAckOrError(get_family_request,
+                                                          &error_code));
+  EXPECT_NE(0, error_code);
+
+  CommandLatencyStats stats =
+      netlink_manager.GetCommandLatencyStats(GENL_ID_CTRL, CTRL_CMD_GETFAMILY);
+  EXPECT_EQ(1u, stats.num_errors);
+}
+
 }  // namespace wificond
 }  // namespace android
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vector>
+
+#include <linux/netlink.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <android-base/unique_fd.h>
+#include <gtest/gtest.h>
+
+#include "wificond/net/kernel-header-latest/nl80211.h"
+#include "wificond/net/netlink_receive_thread.h"
+#include "wificond/net/nl80211_packet.h"
+
+using android::base::unique_fd;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr uint16_t kFakeFamilyId = 0x1c;
+constexpr uint32_t kFakeSequenceNumber = 42;
+constexpr uint32_t kFakeInterfaceIndex = 12;
+
+}  // namespace
+
+class NetlinkReceiveThreadTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    int fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, fds));
+    socket_fd_.reset(fds[0]);
+    peer_fd_.reset(fds[1]);
+  }
+
+  void Send(const vector<uint8_t>& datagram) {
+    ASSERT_EQ(static_cast<ssize_t>(datagram.size()),
+              write(peer_fd_.get(), datagram.data(), datagram.size()));
+  }
+
+  // Consumes records until |num_records| were handled.
+  vector<NetlinkReceiveRecord> ConsumeRecords(NetlinkReceiveThread* thread,
+                                              size_t num_records) {
+    vector<NetlinkReceiveRecord> records;
+    struct pollfd fd = {thread->GetNotificationFd(), POLLIN, 0};
+    while (records.size() < num_records && poll(&fd, 1, 1000) == 1) {
+      thread->ConsumeRecords([&records](const NetlinkReceiveRecord& record) {
+        records.push_back(record);
+      });
+    }
+    return records;
+  }
+
+  unique_fd socket_fd_;
+  unique_fd peer_fd_;
+};
+
+TEST_F(NetlinkReceiveThreadTest, SplitsDatagramsIntoMessages) {
+  NL80211Packet scan_results(
+      kFakeFamilyId, NL80211_CMD_NEW_SCAN_RESULTS, 0, 0);
+  scan_results.AddAttributeValue<uint32_t>(NL80211_ATTR_IFINDEX,
+                                           kFakeInterfaceIndex);
+  NL80211Packet done(NLMSG_DONE, 0, kFakeSequenceNumber, 0);
+  vector<uint8_t> datagram = scan_results.GetConstData();
+  datagram.insert(datagram.end(), done.GetConstData().begin(),
+                  done.GetConstData().end());
+
+  NetlinkReceiveThread thread;
+  ASSERT_TRUE(thread.Start(socket_fd_.get()));
+  Send(datagram);
+  vector<NetlinkReceiveRecord> records = ConsumeRecords(&thread, 2);
+  ASSERT_EQ(2u, records.size());
+  EXPECT_EQ(NetlinkReceiveRecord::kMessage, records[0].type);
+  EXPECT_EQ(scan_results.GetConstData(), records[0].data);
+  EXPECT_TRUE(records[0].first_in_datagram);
+  EXPECT_EQ(NetlinkReceiveRecord::kMessage, records[1].type);
+  EXPECT_EQ(done.GetConstData(), records[1].data);
+  EXPECT_FALSE(records[1].first_in_datagram);
+}
+
+TEST_F(NetlinkReceiveThreadTest, WaitsForRoomInFullRing) {
+  constexpr size_t kNumDatagrams = 20;
+  NetlinkReceiveThread thread(4);
+  ASSERT_TRUE(thread.Start(socket_fd_.get()));
+  for (size_t i = 0; i < kNumDatagrams; i++) {
+    Send(NL80211Packet(kFakeFamilyId, NL80211_CMD_NEW_SCAN_RESULTS,
+                       kFakeSequenceNumber + i, 0).GetConstData());
+  }
+  vector<NetlinkReceiveRecord> records = ConsumeRecords(&thread, kNumDatagrams);
+  ASSERT_EQ(kNumDatagrams, records.size());
+  for (size_t i = 0; i < kNumDatagrams; i++) {
+    EXPECT_EQ(kFakeSequenceNumber + i,
+              reinterpret_cast<const nlmsghdr*>(
+                  records[i].data.data())->nlmsg_seq);
+  }
+  EXPECT_GT(thread.GetNumRingFullWaits(), 0u);
+  thread.Stop();
+}
+
+TEST_F(NetlinkReceiveThreadTest, ReportsTruncatedDatagram) {
+  NL80211Packet large_reply(kFakeFamilyId, NL80211_CMD_NEW_SCAN_RESULTS,
+                            kFakeSequenceNumber, 0);
+  large_reply.AddAttribute(
+      NL80211Attr<vector<uint8_t>>(NL80211_ATTR_IE,
+                                   vector<uint8_t>(16 * 1024)));
+  NetlinkReceiveThread thread;
+  ASSERT_TRUE(thread.Start(socket_fd_.get()));
+  Send(large_reply.GetConstData());
+  vector<NetlinkReceiveRecord> records = ConsumeRecords(&thread, 1);
+  ASSERT_EQ(1u, records.size());
+  EXPECT_EQ(NetlinkReceiveRecord::kTruncated, records[0].type);
+  EXPECT_EQ(kFakeSequenceNumber, records[0].sequence);
+}
+
+}  // namespace wificond
+}  // namespace android
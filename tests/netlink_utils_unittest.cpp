@@ -31,8 +31,10 @@ using std::string;
 using std::unique_ptr;
 using std::vector;
 using testing::DoAll;
+using testing::Invoke;
 using testing::NiceMock;
 using testing::Return;
+using testing::SaveArg;
 using testing::_;
 
 namespace android {
@@ -431,6 +433,46 @@ TEST_F(NetlinkUtilsTest, CanHandleSetIntrerfaceModeError) {
                                                 NetlinkUtils::STATION_MODE));
 }
 
+TEST_F(NetlinkUtilsTest, CanSetCqmRssiConfig) {
+  // Mock a ACK response from kernel.
+  vector<NL80211Packet> response = {CreateControlMessageAck()};
+  const int32_t kFakeRssiThreshold = -70;
+  const uint32_t kFakeRssiHysteresis = 4;
+
+  EXPECT_CALL(*netlink_manager_, SendMessageAndGetResponses(_, _)).
+      WillOnce(DoAll(
+          [&](const NL80211Packet& request,
+              vector<unique_ptr<const NL80211Packet>>* responses) {
+            EXPECT_EQ(NL80211_CMD_SET_CQM, request.GetCommand());
+            NL80211NestedAttr cqm(0);
+            ASSERT_TRUE(request.GetAttribute(NL80211_ATTR_CQM, &cqm));
+            int32_t threshold;
+            uint32_t hysteresis;
+            EXPECT_TRUE(cqm.GetAttributeValue(NL80211_ATTR_CQM_RSSI_THOLD,
+                                              &threshold));
+            EXPECT_TRUE(cqm.GetAttributeValue(NL80211_ATTR_CQM_RSSI_HYST,
+                                              &hysteresis));
+            EXPECT_EQ(kFakeRssiThreshold, threshold);
+            EXPECT_EQ(kFakeRssiHysteresis, hysteresis);
+          },
+          MakeupResponse(response), Return(true)));
+
+  EXPECT_TRUE(netlink_utils_->SetCqmRssiConfig(kFakeInterfaceIndex,
+                                               kFakeRssiThreshold,
+                                               kFakeRssiHysteresis));
+}
+
+TEST_F(NetlinkUtilsTest, CanHandleSetCqmTxErrorConfigError) {
+  // Mock an error response from kernel.
+  vector<NL80211Packet> response = {CreateControlMessageError(kFakeErrorCode)};
+
+  EXPECT_CALL(*netlink_manager_, SendMessageAndGetResponses(_, _)).
+      WillOnce(DoAll(MakeupResponse(response), Return(true)));
+
+  EXPECT_FALSE(netlink_utils_->SetCqmTxErrorConfig(kFakeInterfaceIndex,
+                                                   10, 50, 5));
+}
+
 TEST_F(NetlinkUtilsTest, CanGetInterfaces) {
   NL80211Packet new_interface(
       netlink_manager_->GetFamilyId(),
@@ -566,6 +608,269 @@ TEST_F(NetlinkUtilsTest, CanHandleGetInterfacesError) {
   EXPECT_FALSE(netlink_utils_->GetInterfaces(kFakeWiphyIndex, &interfaces));
 }
 
+TEST_F(NetlinkUtilsTest, CanGetInterfaceFrequency) {
+  constexpr uint32_t kFakeFrequency = 5180;
+  NL80211Packet new_interface(
+      netlink_manager_->GetFamilyId(),
+      NL80211_CMD_NEW_INTERFACE,
+      netlink_manager_->GetSequenceNumber(),
+      getpid());
+  new_interface.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, kFakeInterfaceIndex));
+  new_interface.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_WIPHY_FREQ, kFakeFrequency));
+  vector<NL80211Packet> response = {new_interface};
+
+  EXPECT_CALL(*netlink_manager_, SendMessageAndGetResponses(_, _)).
+      WillOnce(DoAll(MakeupResponse(response), Return(true)));
+
+  uint32_t frequency;
+  EXPECT_TRUE(netlink_utils_->GetInterfaceFrequency(kFakeInterfaceIndex,
+                                                    &frequency));
+  EXPECT_EQ(kFakeFrequency, frequency);
+}
+
+TEST_F(NetlinkUtilsTest, CanHandleInterfaceWithoutFrequency) {
+  // Kernel does not report a frequency for interfaces that are not on a
+  // channel, e.g. disconnected station interfaces.
+  NL80211Packet new_interface(
+      netlink_manager_->GetFamilyId(),
+      NL80211_CMD_NEW_INTERFACE,
+      netlink_manager_->GetSequenceNumber(),
+      getpid());
+  new_interface.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, kFakeInterfaceIndex));
+  vector<NL80211Packet> response = {new_interface};
+
+  EXPECT_CALL(*netlink_manager_, SendMessageAndGetResponses(_, _)).
+      WillOnce(DoAll(MakeupResponse(response), Return(true)));
+
+  uint32_t frequency;
+  EXPECT_FALSE(netlink_utils_->GetInterfaceFrequency(kFakeInterfaceIndex,
+                                                     &frequency));
+}
+
+TEST_F(NetlinkUtilsTest, CanGetStationList) {
+  vector<NL80211Packet> response;
+  for (const auto& mac_address :
+       {kFakeInterfaceMacAddress, kFakeInterfaceMacAddress1}) {
+    NL80211Packet new_station(
+        netlink_manager_->GetFamilyId(),
+        NL80211_CMD_NEW_STATION,
+        netlink_manager_->GetSequenceNumber(),
+        getpid());
+    new_station.AddAttribute(
+        NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, kFakeInterfaceIndex));
+    new_station.AddAttribute(
+        NL80211Attr<std::array<uint8_t, ETH_ALEN>>(NL80211_ATTR_MAC,
+                                                    mac_address));
+    response.push_back(new_station);
+  }
+
+  EXPECT_CALL(*netlink_manager_, SendMessageAndGetResponses(_, _)).
+      WillOnce(DoAll(MakeupResponse(response), Return(true)));
+
+  vector<std::array<uint8_t, ETH_ALEN>> stations;
+  EXPECT_TRUE(netlink_utils_->GetStationList(kFakeInterfaceIndex, &stations));
+  ASSERT_EQ(2u, stations.size());
+  EXPECT_EQ(kFakeInterfaceMacAddress, stations[0]);
+  EXPECT_EQ(kFakeInterfaceMacAddress1, stations[1]);
+}
+
+TEST_F(NetlinkUtilsTest, CanHandleGetStationListError) {
+  // Mock an error response from kernel.
+  vector<NL80211Packet> response = {CreateControlMessageError(kFakeErrorCode)};
+
+  EXPECT_CALL(*netlink_manager_, SendMessageAndGetResponses(_, _)).
+      WillOnce(DoAll(MakeupResponse(response), Return(true)));
+
+  vector<std::array<uint8_t, ETH_ALEN>> stations;
+  EXPECT_FALSE(netlink_utils_->GetStationList(kFakeInterfaceIndex, &stations));
+}
+
+TEST_F(NetlinkUtilsTest, CanGetStationInfo) {
+  constexpr uint32_t kFakeTxPackets = 100;
+  constexpr uint32_t kFakeTxFailed = 3;
+  constexpr int8_t kFakeSignalDbm = -55;
+  constexpr uint32_t kFakeTxBitrate = 650;
+  NL80211Packet new_station(
+      netlink_manager_->GetFamilyId(),
+      NL80211_CMD_NEW_STATION,
+      netlink_manager_->GetSequenceNumber(),
+      getpid());
+  NL80211NestedAttr sta_info(NL80211_ATTR_STA_INFO);
+  sta_info.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_STA_INFO_TX_PACKETS, kFakeTxPackets));
+  sta_info.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_STA_INFO_TX_FAILED, kFakeTxFailed));
+  sta_info.AddAttribute(
+      NL80211Attr<int8_t>(NL80211_STA_INFO_SIGNAL, kFakeSignalDbm));
+  NL80211NestedAttr tx_bitrate(NL80211_STA_INFO_TX_BITRATE);
+  tx_bitrate.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_RATE_INFO_BITRATE32, kFakeTxBitrate));
+  sta_info.AddAttribute(tx_bitrate);
+  // A rx bitrate without NL80211_RATE_INFO_BITRATE32 is reported as 0.
+  sta_info.AddAttribute(NL80211NestedAttr(NL80211_STA_INFO_RX_BITRATE));
+  new_station.AddAttribute(sta_info);
+  vector<NL80211Packet> response = {new_station};
+
+  EXPECT_CALL(*netlink_manager_, SendMessageAndGetResponses(_, _)).
+      WillOnce(DoAll(MakeupResponse(response), Return(true)));
+
+  StationInfo station_info;
+  EXPECT_TRUE(netlink_utils_->GetStationInfo(kFakeInterfaceIndex,
+                                             kFakeInterfaceMacAddress,
+                                             &station_info));
+  EXPECT_EQ(static_cast<int32_t>(kFakeTxPackets),
+            station_info.station_tx_packets);
+  EXPECT_EQ(static_cast<int32_t>(kFakeTxFailed),
+            station_info.station_tx_failed);
+  EXPECT_EQ(kFakeSignalDbm, station_info.current_rssi);
+  EXPECT_EQ(kFakeTxBitrate, station_info.station_tx_bitrate);
+  EXPECT_EQ(0u, station_info.station_rx_bitrate);
+}
+
+TEST_F(NetlinkUtilsTest, CanHandleStationInfoWithoutSignal) {
+  NL80211Packet new_station(
+      netlink_manager_->GetFamilyId(),
+      NL80211_CMD_NEW_STATION,
+      netlink_manager_->GetSequenceNumber(),
+      getpid());
+  NL80211NestedAttr sta_info(NL80211_ATTR_STA_INFO);
+  sta_info.AddAttribute(NL80211Attr<uint32_t>(NL80211_STA_INFO_TX_PACKETS, 1));
+  sta_info.AddAttribute(NL80211Attr<uint32_t>(NL80211_STA_INFO_TX_FAILED, 0));
+  new_station.AddAttribute(sta_info);
+  vector<NL80211Packet> response = {new_station};
+
+  EXPECT_CALL(*netlink_manager_, SendMessageAndGetResponses(_, _)).
+      WillOnce(DoAll(MakeupResponse(response), Return(true)));
+
+  StationInfo station_info;
+  EXPECT_FALSE(netlink_utils_->GetStationInfo(kFakeInterfaceIndex,
+                                              kFakeInterfaceMacAddress,
+                                              &station_info));
+}
+
+TEST_F(NetlinkUtilsTest, CanGetStationStatsList) {
+  constexpr uint64_t kFakeRxBytes = 5000000000;
+  constexpr uint32_t kFakeTxBytes = 1234;
+  constexpr int8_t kFakeSignalDbm = -55;
+  constexpr uint32_t kFakeInactiveTimeMs = 300;
+  constexpr uint32_t kFakeConnectedTimeS = 60;
+  NL80211Packet new_station(
+      netlink_manager_->GetFamilyId(),
+      NL80211_CMD_NEW_STATION,
+      netlink_manager_->GetSequenceNumber(),
+      getpid());
+  new_station.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, kFakeInterfaceIndex));
+  new_station.AddAttribute(
+      NL80211Attr<std::array<uint8_t, ETH_ALEN>>(NL80211_ATTR_MAC,
+                                                  kFakeInterfaceMacAddress));
+  NL80211NestedAttr sta_info(NL80211_ATTR_STA_INFO);
+  sta_info.AddAttribute(
+      NL80211Attr<uint64_t>(NL80211_STA_INFO_RX_BYTES64, kFakeRxBytes));
+  // Only the 32 bit tx byte counter is reported.
+  sta_info.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_STA_INFO_TX_BYTES, kFakeTxBytes));
+  sta_info.AddAttribute(
+      NL80211Attr<int8_t>(NL80211_STA_INFO_SIGNAL, kFakeSignalDbm));
+  sta_info.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_STA_INFO_INACTIVE_TIME,
+                            kFakeInactiveTimeMs));
+  sta_info.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_STA_INFO_CONNECTED_TIME,
+                            kFakeConnectedTimeS));
+  new_station.AddAttribute(sta_info);
+  // A station without statistics.
+  NL80211Packet new_station1(
+      netlink_manager_->GetFamilyId(),
+      NL80211_CMD_NEW_STATION,
+      netlink_manager_->GetSequenceNumber(),
+      getpid());
+  new_station1.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, kFakeInterfaceIndex));
+  new_station1.AddAttribute(
+      NL80211Attr<std::array<uint8_t, ETH_ALEN>>(NL80211_ATTR_MAC,
+                                                  kFakeInterfaceMacAddress1));
+  vector<NL80211Packet> response = {new_station, new_station1};
+
+  EXPECT_CALL(*netlink_manager_, SendMessageAndGetResponses(_, _)).
+      WillOnce(DoAll(MakeupResponse(response), Return(true)));
+
+  vector<StationStats> stations;
+  EXPECT_TRUE(netlink_utils_->GetStationStatsList(kFakeInterfaceIndex,
+                                                  &stations));
+  ASSERT_EQ(2u, stations.size());
+  EXPECT_EQ(kFakeInterfaceMacAddress, stations[0].mac_address);
+  EXPECT_EQ(kFakeRxBytes, stations[0].rx_bytes);
+  EXPECT_EQ(kFakeTxBytes, stations[0].tx_bytes);
+  EXPECT_EQ(kFakeSignalDbm, stations[0].signal_dbm);
+  EXPECT_EQ(kFakeInactiveTimeMs, stations[0].inactive_time_ms);
+  EXPECT_EQ(kFakeConnectedTimeS, stations[0].connected_time_s);
+  EXPECT_EQ(kFakeInterfaceMacAddress1, stations[1].mac_address);
+  EXPECT_EQ(0u, stations[1].rx_bytes);
+  EXPECT_EQ(0u, stations[1].tx_bytes);
+}
+
+TEST_F(NetlinkUtilsTest, CanGetChannelSurveys) {
+  constexpr int8_t kFakeNoiseDbm = -92;
+  constexpr uint64_t kFakeActiveTimeMs = 5000000000;
+  constexpr uint64_t kFakeBusyTimeMs = 1200;
+  constexpr uint64_t kFakeTxTimeMs = 300;
+  NL80211Packet new_survey(
+      netlink_manager_->GetFamilyId(),
+      NL80211_CMD_NEW_SURVEY_RESULTS,
+      netlink_manager_->GetSequenceNumber(),
+      getpid());
+  new_survey.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, kFakeInterfaceIndex));
+  NL80211NestedAttr survey_info(NL80211_ATTR_SURVEY_INFO);
+  survey_info.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_SURVEY_INFO_FREQUENCY, kFakeFrequency2));
+  survey_info.AddAttribute(
+      NL80211Attr<int8_t>(NL80211_SURVEY_INFO_NOISE, kFakeNoiseDbm));
+  survey_info.AddFlagAttribute(NL80211_SURVEY_INFO_IN_USE);
+  survey_info.AddAttribute(
+      NL80211Attr<uint64_t>(NL80211_SURVEY_INFO_TIME, kFakeActiveTimeMs));
+  survey_info.AddAttribute(
+      NL80211Attr<uint64_t>(NL80211_SURVEY_INFO_TIME_BUSY, kFakeBusyTimeMs));
+  survey_info.AddAttribute(
+      NL80211Attr<uint64_t>(NL80211_SURVEY_INFO_TIME_TX, kFakeTxTimeMs));
+  new_survey.AddAttribute(survey_info);
+  // A channel without counters.
+  NL80211Packet new_survey1(
+      netlink_manager_->GetFamilyId(),
+      NL80211_CMD_NEW_SURVEY_RESULTS,
+      netlink_manager_->GetSequenceNumber(),
+      getpid());
+  NL80211NestedAttr survey_info1(NL80211_ATTR_SURVEY_INFO);
+  survey_info1.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_SURVEY_INFO_FREQUENCY, kFakeFrequency1));
+  new_survey1.AddAttribute(survey_info1);
+  vector<NL80211Packet> response = {new_survey, new_survey1};
+
+  EXPECT_CALL(*netlink_manager_, SendMessageAndGetResponses(_, _)).
+      WillOnce(DoAll(MakeupResponse(response), Return(true)));
+
+  vector<ChannelSurvey> surveys;
+  EXPECT_TRUE(netlink_utils_->GetChannelSurveys(kFakeInterfaceIndex,
+                                                &surveys));
+  ASSERT_EQ(2u, surveys.size());
+  EXPECT_EQ(kFakeFrequency2, surveys[0].frequency);
+  EXPECT_TRUE(surveys[0].in_use);
+  EXPECT_TRUE(surveys[0].has_noise);
+  EXPECT_EQ(kFakeNoiseDbm, surveys[0].noise_dbm);
+  EXPECT_EQ(kFakeActiveTimeMs, surveys[0].active_time_ms);
+  EXPECT_EQ(kFakeBusyTimeMs, surveys[0].busy_time_ms);
+  EXPECT_EQ(0u, surveys[0].rx_time_ms);
+  EXPECT_EQ(kFakeTxTimeMs, surveys[0].tx_time_ms);
+  EXPECT_EQ(kFakeFrequency1, surveys[1].frequency);
+  EXPECT_FALSE(surveys[1].in_use);
+  EXPECT_FALSE(surveys[1].has_noise);
+  EXPECT_EQ(0u, surveys[1].active_time_ms);
+}
+
 TEST_F(NetlinkUtilsTest, CanGetWiphyInfo) {
   SetSplitWiphyDumpSupported(false);
   NL80211Packet new_wiphy(
@@ -845,6 +1150,57 @@ TEST_F(NetlinkUtilsTest, CanGetWiphyInfoSplitDump) {
 }
 
 
+TEST_F(NetlinkUtilsTest, CanGetWiphyInfoSplitDumpWithCapabilitiesFirst) {
+  SetSplitWiphyDumpSupported(true);
+
+  // Scan capabilities come before any band, and the bands are spread over
+  // the following messages.
+  NL80211Packet new_wiphy_packet1(
+      netlink_manager_->GetFamilyId(),
+      NL80211_CMD_NEW_WIPHY,
+      netlink_manager_->GetSequenceNumber(),
+      getpid());
+  new_wiphy_packet1.AddAttribute(NL80211Attr<uint32_t>(NL80211_ATTR_WIPHY,
+                                                       kFakeWiphyIndex));
+  AppendScanCapabilitiesAttributes(&new_wiphy_packet1, false);
+
+  NL80211Packet new_wiphy_packet2(
+      netlink_manager_->GetFamilyId(),
+      NL80211_CMD_NEW_WIPHY,
+      netlink_manager_->GetSequenceNumber(),
+      getpid());
+  new_wiphy_packet2.AddAttribute(NL80211Attr<uint32_t>(NL80211_ATTR_WIPHY,
+                                                       kFakeWiphyIndex));
+  new_wiphy_packet2.AddAttribute(GenerateBandsAttributeFor2g());
+
+  NL80211Packet new_wiphy_packet3(
+      netlink_manager_->GetFamilyId(),
+      NL80211_CMD_NEW_WIPHY,
+      netlink_manager_->GetSequenceNumber(),
+      getpid());
+  new_wiphy_packet3.AddAttribute(NL80211Attr<uint32_t>(NL80211_ATTR_WIPHY,
+                                                       kFakeWiphyIndex));
+  new_wiphy_packet3.AddAttribute(GenerateBandsAttributeFor5gAndDfs());
+  AppendWiphyFeaturesAttributes(&new_wiphy_packet3);
+
+  vector<NL80211Packet> get_wiphy_response =
+      {new_wiphy_packet1, new_wiphy_packet2, new_wiphy_packet3};
+
+  EXPECT_CALL(*netlink_manager_, SendMessageAndGetResponses(_, _)).
+      WillOnce(DoAll(MakeupResponse(get_wiphy_response), Return(true)));
+
+  BandInfo band_info;
+  ScanCapabilities scan_capabilities;
+  WiphyFeatures wiphy_features;
+  EXPECT_TRUE(netlink_utils_->GetWiphyInfo(kFakeWiphyIndex,
+                                           &band_info,
+                                           &scan_capabilities,
+                                           &wiphy_features));
+  VerifyBandInfo(band_info);
+  VerifyScanCapabilities(scan_capabilities, false);
+  VerifyWiphyFeatures(wiphy_features);
+}
+
 TEST_F(NetlinkUtilsTest, CanHandleGetWiphyInfoError) {
   SetSplitWiphyDumpSupported(false);
 
@@ -918,6 +1274,87 @@ TEST_F(NetlinkUtilsTest, CanGetCountryCode) {
   EXPECT_EQ(kFakeCountryCode, country_code);
 }
 
+TEST_F(NetlinkUtilsTest, CanGetRegDomain) {
+  NL80211Packet get_reg_response(
+      netlink_manager_->GetFamilyId(),
+      NL80211_CMD_GET_REG,
+      netlink_manager_->GetSequenceNumber(),
+      getpid());
+  get_reg_response.AddAttribute(
+      NL80211Attr<string>(NL80211_ATTR_REG_ALPHA2, kFakeCountryCode));
+  NL80211NestedAttr rule_2g(1);
+  rule_2g.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_FREQ_RANGE_START, 2402000));
+  rule_2g.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_FREQ_RANGE_END, 2472000));
+  rule_2g.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_FREQ_RANGE_MAX_BW, 40000));
+  rule_2g.AddAttribute(NL80211Attr<uint32_t>(NL80211_ATTR_REG_RULE_FLAGS, 0));
+  NL80211NestedAttr rule_dfs(2);
+  rule_dfs.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_FREQ_RANGE_START, 5250000));
+  rule_dfs.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_FREQ_RANGE_END, 5330000));
+  rule_dfs.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_FREQ_RANGE_MAX_BW, 80000));
+  rule_dfs.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_REG_RULE_FLAGS, NL80211_RRF_DFS));
+  NL80211NestedAttr rules(NL80211_ATTR_REG_RULES);
+  rules.AddAttribute(rule_2g);
+  rules.AddAttribute(rule_dfs);
+  get_reg_response.AddAttribute(rules);
+  vector<NL80211Packet> response = {get_reg_response};
+
+  EXPECT_CALL(*netlink_manager_, SendMessageAndGetResponses(_, _)).
+      WillOnce(DoAll(MakeupResponse(response), Return(true)));
+
+  RegDomain reg_domain;
+  EXPECT_TRUE(netlink_utils_->GetRegDomain(&reg_domain));
+  EXPECT_EQ(kFakeCountryCode, reg_domain.country_code);
+  ASSERT_EQ(2u, reg_domain.rules.size());
+  EXPECT_EQ(2402000u, reg_domain.rules[0].start_freq_khz);
+  EXPECT_EQ(2472000u, reg_domain.rules[0].end_freq_khz);
+  EXPECT_EQ(40000u, reg_domain.rules[0].max_bandwidth_khz);
+  EXPECT_EQ(0u, reg_domain.rules[0].flags);
+  EXPECT_EQ(5250000u, reg_domain.rules[1].start_freq_khz);
+  EXPECT_EQ(static_cast<uint32_t>(NL80211_RRF_DFS), reg_domain.rules[1].flags);
+}
+
+TEST_F(NetlinkUtilsTest, CanApplyRegDomain) {
+  BandInfo band_info;
+  band_info.band_2g = {kFakeFrequency1, kFakeFrequency2, kFakeFrequency3};
+  band_info.band_5g = {kFakeFrequency4, kFakeFrequency5};
+  band_info.band_disabled = {kFakeFrequency6};
+
+  RegDomain reg_domain;
+  reg_domain.rules = {{2402000, 2472000, 40000, 0},
+                      {5170000, 5250000, 80000, 0},
+                      {5350000, 5470000, 80000, NL80211_RRF_DFS}};
+  EXPECT_TRUE(NetlinkUtils::ApplyRegDomain(reg_domain, &band_info));
+  EXPECT_EQ(vector<uint32_t>({kFakeFrequency1, kFakeFrequency2}),
+            band_info.band_2g);
+  EXPECT_EQ(vector<uint32_t>({kFakeFrequency4}), band_info.band_5g);
+  EXPECT_EQ(vector<uint32_t>({kFakeFrequency5}), band_info.band_dfs);
+  EXPECT_EQ(vector<uint32_t>({kFakeFrequency3, kFakeFrequency6}),
+            band_info.band_disabled);
+}
+
+TEST_F(NetlinkUtilsTest, ApplyRegDomainKeepsRestrictionsOfWiphyDump) {
+  // The driver disables one channel and only allows passive scanning on
+  // another one, though no regulatory rule requires it.
+  BandInfo band_info;
+  band_info.band_5g = {kFakeFrequency4};
+  band_info.band_dfs = {kFakeFrequency5};
+  band_info.band_disabled = {kFakeFrequency6};
+
+  RegDomain reg_domain;
+  reg_domain.rules = {{5170000, 5730000, 80000, 0}};
+  EXPECT_FALSE(NetlinkUtils::ApplyRegDomain(reg_domain, &band_info));
+  EXPECT_EQ(vector<uint32_t>({kFakeFrequency4}), band_info.band_5g);
+  EXPECT_EQ(vector<uint32_t>({kFakeFrequency5}), band_info.band_dfs);
+  EXPECT_EQ(vector<uint32_t>({kFakeFrequency6}), band_info.band_disabled);
+}
+
 TEST_F(NetlinkUtilsTest, CanHandleGetCountryCodeError) {
   // Mock an error response from kernel.
   vector<NL80211Packet> response = {CreateControlMessageError(kFakeErrorCode)};
@@ -964,5 +1401,109 @@ TEST_F(NetlinkUtilsTest, CanHandleSendMgmtFrameError) {
       kFakeMcs, &cookie_ignored));
 }
 
+TEST_F(NetlinkUtilsTest, CanSendCommandAsync) {
+  NL80211Attr<uint32_t> vendor_id(NL80211_ATTR_VENDOR_ID, 0x001018);
+  vector<uint8_t> attributes(vendor_id.GetConstData());
+
+  bool sent_expected_packet = false;
+  OnResponsesReceivedHandler sent_handler;
+  EXPECT_CALL(*netlink_manager_, SendMessageAsync(_, _))
+      .WillOnce(Invoke([&](const NL80211Packet& packet,
+                           OnResponsesReceivedHandler handler) {
+        uint32_t if_index = 0;
+        uint32_t vendor = 0;
+        sent_expected_packet =
+            packet.GetCommand() == NL80211_CMD_VENDOR &&
+            (packet.GetFlags() & NLM_F_ACK) &&
+            packet.GetAttributeValue(NL80211_ATTR_IFINDEX, &if_index) &&
+            if_index == kFakeInterfaceIndex &&
+            packet.GetAttributeValue(NL80211_ATTR_VENDOR_ID, &vendor) &&
+            vendor == 0x001018;
+        sent_handler = handler;
+        return true;
+      }));
+
+  bool replies_received = false;
+  vector<uint8_t> replies;
+  EXPECT_TRUE(netlink_utils_->SendCommandAsync(
+      kFakeInterfaceIndex, NL80211_CMD_VENDOR, NLM_F_ACK, attributes,
+      [&](bool success, vector<uint8_t> command_replies) {
+        replies_received = success;
+        replies = std::move(command_replies);
+      }));
+  EXPECT_TRUE(sent_expected_packet);
+  ASSERT_TRUE(sent_handler);
+
+  NL80211Packet vendor_reply(
+      netlink_manager_->GetFamilyId(),
+      NL80211_CMD_VENDOR,
+      netlink_manager_->GetSequenceNumber(),
+      getpid());
+  NL80211Packet ack = CreateControlMessageAck();
+  vector<unique_ptr<const NL80211Packet>> responses;
+  responses.emplace_back(new NL80211Packet(vendor_reply));
+  responses.emplace_back(new NL80211Packet(ack));
+  sent_handler(true, std::move(responses));
+
+  EXPECT_TRUE(replies_received);
+  vector<uint8_t> expected_replies(vendor_reply.GetConstData());
+  expected_replies.insert(expected_replies.end(),
+                          ack.GetConstData().begin(),
+                          ack.GetConstData().end());
+  EXPECT_EQ(expected_replies, replies);
+}
+
+TEST_F(NetlinkUtilsTest, FailsCommandWithOversizedReplies) {
+  OnResponsesReceivedHandler sent_handler;
+  EXPECT_CALL(*netlink_manager_, SendMessageAsync(_, _))
+      .WillOnce(DoAll(SaveArg<1>(&sent_handler), Return(true)));
+
+  bool completed = false;
+  bool replies_received = true;
+  vector<uint8_t> replies;
+  EXPECT_TRUE(netlink_utils_->SendCommandAsync(
+      kFakeInterfaceIndex, NL80211_CMD_GET_STATION, NLM_F_DUMP, {},
+      [&](bool success, vector<uint8_t> command_replies) {
+        completed = true;
+        replies_received = success;
+        replies = std::move(command_replies);
+      }));
+  ASSERT_TRUE(sent_handler);
+
+  NL80211Packet station_reply(
+      netlink_manager_->GetFamilyId(),
+      NL80211_CMD_NEW_STATION,
+      netlink_manager_->GetSequenceNumber(),
+      getpid());
+  station_reply.AddAttribute(NL80211Attr<vector<uint8_t>>(
+      NL80211_ATTR_IE, vector<uint8_t>(1024)));
+  vector<unique_ptr<const NL80211Packet>> responses;
+  size_t size = 0;
+  while (size <= NetlinkUtils::kMaxCommandRepliesSize) {
+    responses.emplace_back(new NL80211Packet(station_reply));
+    size += station_reply.GetConstData().size();
+  }
+  sent_handler(true, std::move(responses));
+
+  EXPECT_TRUE(completed);
+  EXPECT_FALSE(replies_received);
+  EXPECT_TRUE(replies.empty());
+}
+
+TEST_F(NetlinkUtilsTest, CanRejectCommandNamingAnotherInterface) {
+  NL80211Attr<uint32_t> if_index(NL80211_ATTR_IFINDEX, kFakeInterfaceIndex + 1);
+  vector<uint8_t> attributes(if_index.GetConstData());
+  EXPECT_CALL(*netlink_manager_, SendMessageAsync(_, _)).Times(0);
+
+  EXPECT_FALSE(netlink_utils_->SendCommandAsync(
+      kFakeInterfaceIndex, NL80211_CMD_GET_STATION, NLM_F_DUMP, attributes,
+      [](bool, vector<uint8_t>) {}));
+  // Truncated attributes are rejected as well.
+  attributes.resize(attributes.size() - 1);
+  EXPECT_FALSE(netlink_utils_->SendCommandAsync(
+      kFakeInterfaceIndex, NL80211_CMD_GET_STATION, NLM_F_DUMP, attributes,
+      [](bool, vector<uint8_t>) {}));
+}
+
 }  // namespace wificond
 }  // namespace android
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <array>
+#include <vector>
+
+#include <linux/if_ether.h>
+
+#include <gtest/gtest.h>
+
+#include "wificond/scanning/network_matcher.h"
+
+using std::array;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+const array<uint8_t, ETH_ALEN> kFakeBssid1 =
+    {{0x12, 0x34, 0x56, 0x78, 0xab, 0xcd}};
+const array<uint8_t, ETH_ALEN> kFakeBssid2 =
+    {{0x12, 0x34, 0x56, 0x78, 0xab, 0xce}};
+
+}  // namespace
+
+TEST(NetworkMatcherTest, MatchesSsidsOfTheSet) {
+  SsidMatcher matcher({{'a', 'b'}, {'c', 'd', 'e'}, {}});
+  EXPECT_FALSE(matcher.empty());
+  EXPECT_TRUE(matcher.Matches(vector<uint8_t>{'a', 'b'}));
+  EXPECT_TRUE(matcher.Matches(vector<uint8_t>{'c', 'd', 'e'}));
+  EXPECT_TRUE(matcher.Matches(vector<uint8_t>{}));
+  EXPECT_FALSE(matcher.Matches(vector<uint8_t>{'a'}));
+  EXPECT_FALSE(matcher.Matches(vector<uint8_t>{'a', 'c'}));
+  EXPECT_FALSE(matcher.Matches(vector<uint8_t>{'a', 'b', 0}));
+}
+
+TEST(NetworkMatcherTest, MatchesSsidsOfAnyLength) {
+  vector<uint8_t> longest(32, 'x');
+  vector<uint8_t> too_long(40, 'y');
+  SsidMatcher matcher({longest, too_long});
+  EXPECT_TRUE(matcher.Matches(longest));
+  EXPECT_TRUE(matcher.Matches(too_long));
+  longest.back() = 'z';
+  too_long.back() = 'z';
+  EXPECT_FALSE(matcher.Matches(longest));
+  EXPECT_FALSE(matcher.Matches(too_long));
+}
+
+TEST(NetworkMatcherTest, MatchesManySsids) {
+  SsidMatcher matcher;
+  EXPECT_TRUE(matcher.empty());
+  for (int i = 0; i < 500; i += 2) {
+    matcher.Add({'n', static_cast<uint8_t>(i >> 8), static_cast<uint8_t>(i)});
+  }
+  for (int i = 0; i < 500; i++) {
+    EXPECT_EQ(i % 2 == 0, matcher.Matches(vector<uint8_t>{
+        'n', static_cast<uint8_t>(i >> 8), static_cast<uint8_t>(i)}));
+  }
+}
+
+TEST(NetworkMatcherTest, MatchesBssidsOfTheSet) {
+  BssidMatcher matcher;
+  EXPECT_TRUE(matcher.empty());
+  EXPECT_TRUE(matcher.Add(
+      vector<uint8_t>(kFakeBssid1.begin(), kFakeBssid1.end())));
+  EXPECT_FALSE(matcher.Add({0x12, 0x34}));
+  EXPECT_FALSE(matcher.empty());
+  EXPECT_TRUE(matcher.Matches(kFakeBssid1));
+  EXPECT_FALSE(matcher.Matches(kFakeBssid2));
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -14,12 +14,16 @@
  * limitations under the License.
  */
 
+#include <array>
 #include <memory>
 
+#include <linux/if_ether.h>
+
 #include <gtest/gtest.h>
 
 #include "wificond/net/kernel-header-latest/nl80211.h"
 #include "wificond/net/nl80211_attribute.h"
+#include "wificond/net/nl80211_attribute_schema.h"
 
 namespace android {
 namespace wificond {
@@ -47,6 +51,24 @@ const uint8_t kValidU32AttrBuffer[] = {
     0x01, 0x00, // nla_type
     0xf1, 0x12, 0x12, 0x2a // payload
 };
+struct SchemaTestFields {
+  uint32_t u32_value = 0;
+  uint8_t u8_value = 0;
+  bool flag = false;
+  uint32_t nested_u32_value = 0;
+  std::array<uint8_t, ETH_ALEN> mac_address{};
+};
+
+constexpr auto kSchemaTestNestedSchema = MakeNL80211AttrSchema(
+    NL80211ValueField<&SchemaTestFields::nested_u32_value>(1, true));
+
+constexpr auto kSchemaTestSchema = MakeNL80211AttrSchema(
+    NL80211ValueField<&SchemaTestFields::u32_value>(1, true),
+    NL80211ValueField<&SchemaTestFields::u8_value>(2),
+    NL80211FlagField<&SchemaTestFields::flag>(3),
+    NL80211NestedField<kSchemaTestNestedSchema>(4),
+    NL80211ValueField<&SchemaTestFields::mac_address>(300));
+
 const uint8_t kBufferContainsStringWithTrailingZero[] = {
     0x0a, 0x00, // nla_len = 10
     0x01, 0x00, // nla_type
@@ -338,5 +360,140 @@ TEST(NL80211AttributeTest, MergeNestedAttributes) {
   EXPECT_TRUE(value2 == kU32Value2);
 }
 
+TEST(NL80211AttributeTest, LookupAfterAddingAttributesToNestedAttribute) {
+  NL80211NestedAttr nested_attr(0);
+  nested_attr.AddAttribute(NL80211Attr<uint32_t>(1, kU32Value1));
+  uint32_t value;
+  // This builds the attribute index.
+  EXPECT_TRUE(nested_attr.GetAttributeValue(1, &value));
+  EXPECT_FALSE(nested_attr.HasAttribute(2));
+  // The index must pick up attributes appended after the first lookup.
+  nested_attr.AddAttribute(NL80211Attr<uint32_t>(2, kU32Value2));
+  EXPECT_TRUE(nested_attr.GetAttributeValue(2, &value));
+  EXPECT_EQ(kU32Value2, value);
+}
+
+TEST(NL80211AttributeTest, LookupReturnsFirstAttributeWithDuplicatedId) {
+  NL80211NestedAttr nested_attr(0);
+  nested_attr.AddAttribute(NL80211Attr<uint32_t>(1, kU32Value1));
+  nested_attr.AddAttribute(NL80211Attr<uint32_t>(1, kU32Value2));
+  uint32_t value;
+  EXPECT_TRUE(nested_attr.GetAttributeValue(1, &value));
+  EXPECT_EQ(kU32Value1, value);
+}
+
+TEST(NL80211AttributeTest, LookupAttributeWithLargeId) {
+  NL80211NestedAttr nested_attr(0);
+  nested_attr.AddAttribute(NL80211Attr<uint32_t>(1, kU32Value1));
+  nested_attr.AddAttribute(NL80211Attr<uint32_t>(1000, kU32Value2));
+  uint32_t value;
+  EXPECT_TRUE(nested_attr.GetAttributeValue(1000, &value));
+  EXPECT_EQ(kU32Value2, value);
+  EXPECT_TRUE(nested_attr.GetAttributeValue(1, &value));
+  EXPECT_EQ(kU32Value1, value);
+}
+
+TEST(NL80211AttributeTest, GetAttributePayloadFromNestedAttribute) {
+  NL80211NestedAttr nested_attr(0);
+  nested_attr.AddAttribute(NL80211Attr<std::vector<uint8_t>>(
+      1, std::vector<uint8_t>(kMacAddress, kMacAddress + sizeof(kMacAddress))));
+  const uint8_t* payload = nullptr;
+  size_t payload_length = 0;
+  ASSERT_TRUE(nested_attr.GetAttributePayload(1, &payload, &payload_length));
+  EXPECT_EQ(sizeof(kMacAddress), payload_length);
+  EXPECT_EQ(0, memcmp(kMacAddress, payload, payload_length));
+  // The payload points into the buffer of |nested_attr|.
+  const std::vector<uint8_t>& data = nested_attr.GetConstData();
+  EXPECT_TRUE(payload > data.data() && payload < data.data() + data.size());
+  EXPECT_FALSE(nested_attr.GetAttributePayload(2, &payload, &payload_length));
+}
+
+TEST(NL80211AttributeTest, CannotGetIntegralValueWithWrongSize) {
+  NL80211NestedAttr nested_attr(0);
+  nested_attr.AddAttribute(NL80211Attr<uint16_t>(1, kU16Value1));
+  uint32_t u32_value;
+  EXPECT_FALSE(nested_attr.GetAttributeValue(1, &u32_value));
+  uint16_t u16_value;
+  EXPECT_TRUE(nested_attr.GetAttributeValue(1, &u16_value));
+  EXPECT_EQ(kU16Value1, u16_value);
+}
+
+TEST(NL80211AttributeTest, GetStringValueFromNestedAttribute) {
+  NL80211NestedAttr nested_attr(0);
+  nested_attr.AddAttribute(NL80211Attr<std::string>(1, kIFName));
+  std::string value;
+  EXPECT_TRUE(nested_attr.GetAttributeValue(1, &value));
+  EXPECT_EQ(kIFName, value);
+}
+
+TEST(NL80211AttributeTest, DecodeAttributesWithSchema) {
+  NL80211NestedAttr nested_attr(4);
+  nested_attr.AddAttribute(NL80211Attr<uint32_t>(1, kU32Value2));
+  NL80211NestedAttr attrs(0);
+  attrs.AddAttribute(NL80211Attr<uint32_t>(1, kU32Value1));
+  attrs.AddAttribute(NL80211Attr<uint8_t>(2, kU8Value1));
+  attrs.AddFlagAttribute(3);
+  attrs.AddAttribute(nested_attr);
+  attrs.AddAttribute(NL80211Attr<std::vector<uint8_t>>(
+      300, std::vector<uint8_t>(kMacAddress, kMacAddress + ETH_ALEN)));
+  // Attributes that are not part of the schema are skipped.
+  attrs.AddAttribute(NL80211Attr<uint32_t>(5, kU32Value2));
+  // Only the first attribute with an id is decoded.
+  attrs.AddAttribute(NL80211Attr<uint32_t>(1, kU32Value2));
+
+  const std::vector<uint8_t>& data = attrs.GetConstData();
+  SchemaTestFields fields;
+  ASSERT_TRUE(kSchemaTestSchema.Decode(
+      data.data() + NLA_HDRLEN, data.size() - NLA_HDRLEN, &fields));
+  EXPECT_EQ(kU32Value1, fields.u32_value);
+  EXPECT_EQ(kU8Value1, fields.u8_value);
+  EXPECT_TRUE(fields.flag);
+  EXPECT_EQ(kU32Value2, fields.nested_u32_value);
+  EXPECT_EQ(0, memcmp(kMacAddress, fields.mac_address.data(), ETH_ALEN));
+}
+
+TEST(NL80211AttributeTest, SchemaLeavesInvalidOptionalAttributeUntouched) {
+  NL80211NestedAttr attrs(0);
+  attrs.AddAttribute(NL80211Attr<uint32_t>(1, kU32Value1));
+  // The u8 field is sent with the wrong size.
+  attrs.AddAttribute(NL80211Attr<uint32_t>(2, kU32Value2));
+
+  const std::vector<uint8_t>& data = attrs.GetConstData();
+  SchemaTestFields fields;
+  ASSERT_TRUE(kSchemaTestSchema.Decode(
+      data.data() + NLA_HDRLEN, data.size() - NLA_HDRLEN, &fields));
+  EXPECT_EQ(kU32Value1, fields.u32_value);
+  EXPECT_EQ(0u, fields.u8_value);
+  EXPECT_FALSE(fields.flag);
+}
+
+TEST(NL80211AttributeTest, SchemaFailsOnMissingOrInvalidRequiredAttribute) {
+  NL80211NestedAttr missing(0);
+  missing.AddAttribute(NL80211Attr<uint8_t>(2, kU8Value1));
+  SchemaTestFields fields;
+  const std::vector<uint8_t>& missing_data = missing.GetConstData();
+  EXPECT_FALSE(kSchemaTestSchema.Decode(missing_data.data() + NLA_HDRLEN,
+                                        missing_data.size() - NLA_HDRLEN,
+                                        &fields));
+
+  NL80211NestedAttr invalid(0);
+  invalid.AddAttribute(NL80211Attr<uint8_t>(1, kU8Value1));
+  const std::vector<uint8_t>& invalid_data = invalid.GetConstData();
+  EXPECT_FALSE(kSchemaTestSchema.Decode(invalid_data.data() + NLA_HDRLEN,
+                                        invalid_data.size() - NLA_HDRLEN,
+                                        &fields));
+
+  // A required attribute of an optional nested attribute only invalidates
+  // the nested attribute.
+  NL80211NestedAttr empty_nested(4);
+  NL80211NestedAttr nested(0);
+  nested.AddAttribute(NL80211Attr<uint32_t>(1, kU32Value1));
+  nested.AddAttribute(empty_nested);
+  const std::vector<uint8_t>& nested_data = nested.GetConstData();
+  EXPECT_TRUE(kSchemaTestSchema.Decode(nested_data.data() + NLA_HDRLEN,
+                                       nested_data.size() - NLA_HDRLEN,
+                                       &fields));
+}
+
 }  // namespace wificond
 }  // namespace android
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <memory>
+#include <vector>
+
+#include <linux/netlink.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "wificond/net/kernel-header-latest/nl80211.h"
+#include "wificond/nl80211_command_relay.h"
+#include "wificond/tests/mock_netlink_manager.h"
+#include "wificond/tests/mock_netlink_utils.h"
+
+using std::unique_ptr;
+using std::vector;
+using testing::DoAll;
+using testing::NiceMock;
+using testing::Return;
+using testing::SaveArg;
+using testing::_;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr uint32_t kFakeInterfaceIndex = 12;
+const vector<uint8_t> kFakeReplies = {0x01, 0x02, 0x03, 0x04};
+
+}  // namespace
+
+class Nl80211CommandRelayTest : public ::testing::Test {
+ protected:
+  // Sends |command| without attributes, and counts the successful replies
+  // in |*num_replies|.
+  bool SendCommand(uint8_t command, nsecs_t now, int* num_replies) {
+    return relay_.SendCommand(
+        kFakeInterfaceIndex, command, NLM_F_DUMP, vector<uint8_t>(), now,
+        [num_replies](bool success, vector<uint8_t> replies) {
+          if (success && replies == kFakeReplies) {
+            (*num_replies)++;
+          }
+        });
+  }
+
+  unique_ptr<NiceMock<MockNetlinkManager>> netlink_manager_{
+      new NiceMock<MockNetlinkManager>()};
+  unique_ptr<NiceMock<MockNetlinkUtils>> netlink_utils_{
+      new NiceMock<MockNetlinkUtils>(netlink_manager_.get())};
+  Nl80211CommandRelay relay_{netlink_utils_.get()};
+};
+
+TEST_F(Nl80211CommandRelayTest, CanRefuseCommandsWithSideEffects) {
+  EXPECT_CALL(*netlink_utils_, SendCommandAsync(_, _, _, _, _)).Times(0);
+  int num_replies = 0;
+  EXPECT_FALSE(SendCommand(NL80211_CMD_DEL_INTERFACE, 0, &num_replies));
+  EXPECT_FALSE(SendCommand(NL80211_CMD_TRIGGER_SCAN, 0, &num_replies));
+  EXPECT_TRUE(Nl80211CommandRelay::IsCommandAllowed(NL80211_CMD_VENDOR));
+}
+
+TEST_F(Nl80211CommandRelayTest, CanMergeIdenticalQueriesInFlight) {
+  OnCommandRepliesHandler handler;
+  EXPECT_CALL(*netlink_utils_,
+              SendCommandAsync(kFakeInterfaceIndex, NL80211_CMD_GET_STATION,
+                               NLM_F_DUMP, _, _))
+      .WillOnce(DoAll(SaveArg<4>(&handler), Return(true)));
+
+  int num_replies = 0;
+  EXPECT_TRUE(SendCommand(NL80211_CMD_GET_STATION, 0, &num_replies));
+  EXPECT_TRUE(SendCommand(NL80211_CMD_GET_STATION, 0, &num_replies));
+  ASSERT_TRUE(handler);
+  handler(true, kFakeReplies);
+  EXPECT_EQ(2, num_replies);
+
+  // Station info is not cached.
+  EXPECT_CALL(*netlink_utils_, SendCommandAsync(_, _, _, _, _))
+      .WillOnce(Return(true));
+  EXPECT_TRUE(SendCommand(NL80211_CMD_GET_STATION, 0, &num_replies));
+}
+
+TEST_F(Nl80211CommandRelayTest, CanServeStableQueriesFromCache) {
+  OnCommandRepliesHandler handler;
+  EXPECT_CALL(*netlink_utils_, SendCommandAsync(_, NL80211_CMD_GET_WIPHY,
+                                                _, _, _))
+      .Times(2)
+      .WillRepeatedly(DoAll(SaveArg<4>(&handler), Return(true)));
+
+  int num_replies = 0;
+  EXPECT_TRUE(SendCommand(NL80211_CMD_GET_WIPHY, 0, &num_replies));
+  ASSERT_TRUE(handler);
+  handler(true, kFakeReplies);
+  EXPECT_GT(relay_.GetMemoryAccount().GetCurrent(), 0u);
+
+  EXPECT_TRUE(SendCommand(NL80211_CMD_GET_WIPHY,
+                          Nl80211CommandRelay::kReplyCacheTtl - 1,
+                          &num_replies));
+  EXPECT_EQ(2, num_replies);
+
+  // Expired and invalidated replies are fetched again.
+  EXPECT_TRUE(SendCommand(NL80211_CMD_GET_WIPHY,
+                          Nl80211CommandRelay::kReplyCacheTtl,
+                          &num_replies));
+  relay_.Invalidate();
+  handler(true, kFakeReplies);
+  EXPECT_EQ(3, num_replies);
+  EXPECT_EQ(0u, relay_.GetMemoryAccount().GetCurrent());
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -14,13 +14,17 @@
  * limitations under the License.
  */
 
+#include <errno.h>
+
 #include <memory>
+#include <vector>
 
 #include <gtest/gtest.h>
 
 #include "wificond/net/kernel-header-latest/nl80211.h"
 #include "wificond/net/nl80211_attribute.h"
 #include "wificond/net/nl80211_packet.h"
+#include "wificond/net/nl80211_packet_view.h"
 
 using std::string;
 
@@ -86,6 +90,28 @@ const unsigned char kNL80211_CMD_NEW_STATION[] = {
     0x04, 0x00, 0x15, 0x00,
 };
 
+// Error EINVAL with message "bad freq", acked with NETLINK_CAP_ACK set.
+const unsigned char kCappedExtendedAck[] = {
+    0x34, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x03,
+    0x05, 0x00, 0x00, 0x00, 0x7b, 0x00, 0x00, 0x00,
+    0xea, 0xff, 0xff, 0xff, 0x14, 0x00, 0x00, 0x00,
+    0x13, 0x00, 0x05, 0x00, 0x05, 0x00, 0x00, 0x00,
+    0x7b, 0x00, 0x00, 0x00, 0x0d, 0x00, 0x01, 0x00,
+    0x62, 0x61, 0x64, 0x20, 0x66, 0x72, 0x65, 0x71,
+    0x00, 0x00, 0x00, 0x00,
+};
+
+// Same error, acked without NETLINK_CAP_ACK, i.e. echoing the request.
+const unsigned char kUncappedExtendedAck[] = {
+    0x38, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x02,
+    0x05, 0x00, 0x00, 0x00, 0x7b, 0x00, 0x00, 0x00,
+    0xea, 0xff, 0xff, 0xff, 0x14, 0x00, 0x00, 0x00,
+    0x13, 0x00, 0x05, 0x00, 0x05, 0x00, 0x00, 0x00,
+    0x7b, 0x00, 0x00, 0x00, 0x21, 0x01, 0x00, 0x00,
+    0x0d, 0x00, 0x01, 0x00, 0x62, 0x61, 0x64, 0x20,
+    0x66, 0x72, 0x65, 0x71, 0x00, 0x00, 0x00, 0x00,
+};
+
 }  // namespace
 
 TEST(NL80211PacketTest, CanConstructValidNL80211Packet) {
@@ -170,6 +196,49 @@ TEST(NL80211PacketTest, AddNestedAttributesToNL80211Packet) {
   EXPECT_FALSE(netlink_packet.HasAttribute(3));
 }
 
+TEST(NL80211PacketTest, BuildNestedAttributesInPlace) {
+  const std::vector<uint8_t> kSsid = {'s', 's', 'i', 'd', '1'};
+  NL80211Packet expected_packet(kNLMsgType,
+                                kGenNLCommand,
+                                kNLMsgSequenceNumber,
+                                kPortId);
+  NL80211NestedAttr outer_attr(1);
+  NL80211NestedAttr inner_attr(2);
+  inner_attr.AddAttribute(NL80211Attr<std::vector<uint8_t>>(3, kSsid));
+  inner_attr.AddAttribute(NL80211Attr<uint16_t>(4, kU16Value1));
+  outer_attr.AddAttribute(inner_attr);
+  outer_attr.AddAttribute(NL80211Attr<std::vector<uint8_t>>(5, {}));
+  expected_packet.AddAttribute(outer_attr);
+  expected_packet.AddAttribute(NL80211Attr<uint32_t>(6, kU32Value1));
+
+  NL80211Packet netlink_packet(kNLMsgType,
+                               kGenNLCommand,
+                               kNLMsgSequenceNumber,
+                               kPortId);
+  size_t size = expected_packet.GetConstData().size() -
+      netlink_packet.GetConstData().size();
+  netlink_packet.Reserve(size);
+  const uint8_t* buffer = netlink_packet.GetConstData().data();
+  size_t outer_marker = netlink_packet.BeginNestedAttribute(1);
+  size_t inner_marker = netlink_packet.BeginNestedAttribute(2);
+  netlink_packet.AddAttributeBytes(3, kSsid.data(), kSsid.size());
+  netlink_packet.AddAttributeValue<uint16_t>(4, kU16Value1);
+  netlink_packet.EndNestedAttribute(inner_marker);
+  netlink_packet.AddAttributeBytes(5, nullptr, 0);
+  netlink_packet.EndNestedAttribute(outer_marker);
+  netlink_packet.AddAttributeValue<uint32_t>(6, kU32Value1);
+
+  EXPECT_TRUE(netlink_packet.IsValid());
+  EXPECT_EQ(expected_packet.GetConstData(), netlink_packet.GetConstData());
+  // The reserved buffer was large enough.
+  EXPECT_EQ(buffer, netlink_packet.GetConstData().data());
+  NL80211NestedAttr nested_attr(0);
+  ASSERT_TRUE(netlink_packet.GetAttribute(1, &nested_attr));
+  EXPECT_TRUE(nested_attr.HasAttribute(2));
+  EXPECT_TRUE(nested_attr.HasAttribute(5));
+  EXPECT_FALSE(netlink_packet.HasAttribute(3));
+}
+
 TEST(NL80211PacketTest, CannotGetMissingAttributeFromNL80211Packet) {
   NL80211Packet netlink_packet(kNLMsgType,
                                kGenNLCommand,
@@ -278,5 +347,98 @@ TEST(NL80211PacketTest, ParseCMDNewStation) {
   EXPECT_EQ(kNewStationExpectedGeneration, value);
 }
 
+TEST(NL80211PacketTest, ParseCMDAssociateFromView) {
+  NL80211PacketView view(kNL80211_CMD_ASSOCIATE,
+                         sizeof(kNL80211_CMD_ASSOCIATE));
+  EXPECT_TRUE(view.IsValid());
+  EXPECT_EQ(kNL80211FamilyId, view.GetMessageType());
+  EXPECT_EQ(NL80211_CMD_ASSOCIATE, view.GetCommand());
+  uint32_t value;
+  EXPECT_TRUE(view.GetAttributeValue(NL80211_ATTR_IFINDEX, &value));
+  EXPECT_EQ(kExpectedIfIndex, value);
+  EXPECT_TRUE(view.HasAttribute(NL80211_ATTR_FRAME));
+  EXPECT_FALSE(view.HasAttribute(NL80211_ATTR_MAC));
+}
+
+TEST(NL80211PacketTest, CannotParseTruncatedView) {
+  // The netlink header claims more bytes than the view covers.
+  NL80211PacketView view(kNL80211_CMD_ASSOCIATE,
+                         sizeof(kNL80211_CMD_ASSOCIATE) - 8);
+  EXPECT_FALSE(view.IsValid());
+}
+
+TEST(NL80211PacketTest, CanCreateOwnedPacketFromView) {
+  NL80211PacketView view(kNL80211_CMD_NEW_STATION,
+                         sizeof(kNL80211_CMD_NEW_STATION));
+  NL80211Packet netlink_packet(view);
+  EXPECT_TRUE(netlink_packet.IsValid());
+  EXPECT_EQ(std::vector<uint8_t>(
+                kNL80211_CMD_NEW_STATION,
+                kNL80211_CMD_NEW_STATION + sizeof(kNL80211_CMD_NEW_STATION)),
+            netlink_packet.GetConstData());
+  // The owned packet does not alias the original buffer.
+  EXPECT_NE(view.GetData(), netlink_packet.GetView().GetData());
+  EXPECT_EQ(view.GetSize(), netlink_packet.GetView().GetSize());
+}
+
+TEST(NL80211PacketTest, CanGetExtendedAckMessage) {
+  NL80211Packet capped_ack(std::vector<uint8_t>(
+      kCappedExtendedAck, kCappedExtendedAck + sizeof(kCappedExtendedAck)));
+  ASSERT_TRUE(capped_ack.IsValid());
+  EXPECT_EQ(NLMSG_ERROR, capped_ack.GetMessageType());
+  EXPECT_EQ(EINVAL, capped_ack.GetErrorCode());
+  string message;
+  EXPECT_TRUE(capped_ack.GetExtendedAckMessage(&message));
+  EXPECT_EQ("bad freq", message);
+
+  NL80211PacketView uncapped_ack(kUncappedExtendedAck,
+                                 sizeof(kUncappedExtendedAck));
+  ASSERT_TRUE(uncapped_ack.IsValid());
+  EXPECT_EQ(EINVAL, uncapped_ack.GetErrorCode());
+  message.clear();
+  EXPECT_TRUE(uncapped_ack.GetExtendedAckMessage(&message));
+  EXPECT_EQ("bad freq", message);
+}
+
+TEST(NL80211PacketTest, CannotGetMissingExtendedAckMessage) {
+  std::vector<uint8_t> data(kCappedExtendedAck,
+                            kCappedExtendedAck + sizeof(kCappedExtendedAck));
+  // Clear NLM_F_ACK_TLVS, as if NETLINK_EXT_ACK was not set.
+  data[7] &= ~(NLM_F_ACK_TLVS >> 8);
+  NL80211Packet ack(data);
+  ASSERT_TRUE(ack.IsValid());
+  EXPECT_EQ(EINVAL, ack.GetErrorCode());
+  string message;
+  EXPECT_FALSE(ack.GetExtendedAckMessage(&message));
+}
+
+TEST(NL80211PacketTest, ReusesMemoryOfFreedPackets) {
+  const NL80211Packet* packet = new NL80211Packet(
+      kNLMsgType, kGenNLCommand, kNLMsgSequenceNumber, kPortId);
+  const void* memory = packet;
+  const uint8_t* data = packet->GetConstData().data();
+  delete packet;
+
+  std::unique_ptr<const NL80211Packet> reused(new NL80211Packet(
+      kNLMsgType, kGenNLCommand, kNLMsgSequenceNumber, kPortId));
+  EXPECT_EQ(memory, reused.get());
+  EXPECT_EQ(data, reused->GetConstData().data());
+  EXPECT_TRUE(reused->IsValid());
+}
+
+TEST(NL80211PacketTest, CanGrowPooledBuffer) {
+  NL80211Packet packet(kNLMsgType, kGenNLCommand, kNLMsgSequenceNumber,
+                       kPortId);
+  for (uint32_t i = 0; i < 100; i++) {
+    packet.AddAttributeValue<uint32_t>(i + 1, i);
+  }
+  ASSERT_TRUE(packet.IsValid());
+  for (uint32_t i = 0; i < 100; i++) {
+    uint32_t value;
+    EXPECT_TRUE(packet.GetAttributeValue(i + 1, &value));
+    EXPECT_EQ(i, value);
+  }
+}
+
 }  // namespace wificond
 }  // namespace android
@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/tests/replay_netlink_manager.h"
+
+#include <linux/netlink.h>
+
+#include <android-base/logging.h>
+
+#include "wificond/net/nl80211_packet.h"
+#include "wificond/net/nl80211_packet_view.h"
+
+using std::function;
+using std::make_pair;
+using std::map;
+using std::pair;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+// Runs |visitor| on every valid message of |datagram|, until it returns false.
+void ForEachMessage(const vector<uint8_t>& datagram,
+                    const function<bool(const NL80211PacketView&)>& visitor) {
+  const uint8_t* ptr = datagram.data();
+  const uint8_t* end = ptr + datagram.size();
+  while (ptr + sizeof(nlmsghdr) <= end) {
+    const nlmsghdr* nl_header = reinterpret_cast<const nlmsghdr*>(ptr);
+    NL80211PacketView packet(
+        ptr,
+        std::min(static_cast<size_t>(nl_header->nlmsg_len),
+                 static_cast<size_t>(end - ptr)));
+    if (!packet.IsValid() || !visitor(packet)) {
+      return;
+    }
+    ptr += NLMSG_ALIGN(nl_header->nlmsg_len);
+  }
+}
+
+void AppendPacket(vector<unique_ptr<const NL80211Packet>>* vec,
+                  const NL80211PacketView& packet) {
+  vec->push_back(std::make_unique<const NL80211Packet>(packet));
+}
+
+}  // namespace
+
+ReplayNetlinkManager::ReplayNetlinkManager(EventLoop* event_loop)
+    : NetlinkManager(event_loop),
+      replay_started_(false) {
+}
+
+bool ReplayNetlinkManager::LoadCapture(const string& path) {
+  vector<NetlinkCaptureRecord> records;
+  if (!ReadNetlinkCapture(path, &records)) {
+    return false;
+  }
+  records_ = std::move(records);
+  replies_.clear();
+  next_reply_.clear();
+
+  // Where the reply to the request with a sequence number goes.
+  map<uint32_t, pair<pair<uint16_t, uint8_t>, size_t>> pending;
+  for (const NetlinkCaptureRecord& record : records_) {
+    if (record.async_socket) {
+      continue;
+    }
+    if (record.direction == NetlinkCaptureRecord::kSent) {
+      ForEachMessage(record.data, [&](const NL80211PacketView& packet) {
+        auto key = make_pair(packet.GetMessageType(), packet.GetCommand());
+        uint32_t sequence = packet.GetMessageSequence();
+        replies_[key].push_back({sequence, {}});
+        pending[sequence] = make_pair(key, replies_[key].size() - 1);
+        return true;
+      });
+      continue;
+    }
+    ForEachMessage(record.data, [&](const NL80211PacketView& packet) {
+      auto itr = pending.find(packet.GetMessageSequence());
+      if (itr == pending.end()) {
+        return true;
+      }
+      RecordedReply& reply = replies_[itr->second.first][itr->second.second];
+      if (reply.datagrams.empty() || reply.datagrams.back() != &record.data) {
+        reply.datagrams.push_back(&record.data);
+      }
+      return true;
+    });
+  }
+  return true;
+}
+
+bool ReplayNetlinkManager::Start() {
+  if (replay_started_) {
+    return true;
+  }
+  if (!DiscoverFamilyId()) {
+    return false;
+  }
+  replay_started_ = true;
+  return true;
+}
+
+bool ReplayNetlinkManager::IsStarted() const {
+  return replay_started_;
+}
+
+bool ReplayNetlinkManager::SendMessageAndGetResponses(
+    const NL80211Packet& packet,
+    vector<unique_ptr<const NL80211Packet>>* response) {
+  return ReplayReply(packet, std::bind(AppendPacket, response,
+                                       std::placeholders::_1));
+}
+
+bool ReplayNetlinkManager::SendMessagesAndGetResponses(
+    const vector<const NL80211Packet*>& packets,
+    vector<vector<unique_ptr<const NL80211Packet>>>* responses) {
+  responses->clear();
+  responses->resize(packets.size());
+  for (size_t i = 0; i < packets.size(); i++) {
+    if (!SendMessageAndGetResponses(*packets[i], &(*responses)[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ReplayNetlinkManager::SendMessageAndStreamResponses(
+    const NL80211Packet& packet,
+    function<void(const NL80211PacketView&)> handler) {
+  return ReplayReply(packet, handler);
+}
+
+size_t ReplayNetlinkManager::ReplayEvents() {
+  size_t num_datagrams = 0;
+  for (const NetlinkCaptureRecord& record : records_) {
+    if (!record.async_socket ||
+        record.direction != NetlinkCaptureRecord::kReceived) {
+      continue;
+    }
+    RunHandlersForDatagram(record.data.data(), record.data.size());
+    num_datagrams++;
+  }
+  return num_datagrams;
+}
+
+bool ReplayNetlinkManager::ReplayReply(
+    const NL80211Packet& packet,
+    const function<void(const NL80211PacketView&)>& handler) {
+  auto key = make_pair(packet.GetMessageType(), packet.GetCommand());
+  auto itr = replies_.find(key);
+  if (itr == replies_.end() || itr->second.empty()) {
+    LOG(ERROR) << "No recorded reply for message type "
+               << packet.GetMessageType()
+               << " command " << static_cast<int>(packet.GetCommand());
+    return false;
+  }
+  size_t& next = next_reply_[key];
+  const RecordedReply& reply = itr->second[next];
+  next = (next + 1) % itr->second.size();
+
+  // Mirrors NetlinkManager: a multipart reply ends with NLMSG_DONE, any other
+  // reply is a single message.
+  bool done = false;
+  for (const vector<uint8_t>* datagram : reply.datagrams) {
+    ForEachMessage(*datagram, [&](const NL80211PacketView& message) {
+      if (message.GetMessageSequence() != reply.sequence) {
+        return true;
+      }
+      uint16_t message_type = message.GetMessageType();
+      if (message_type == NLMSG_DONE || message_type == NLMSG_NOOP) {
+        done = true;
+        return false;
+      }
+      handler(message);
+      done = !message.IsMulti();
+      return !done;
+    });
+    if (done) {
+      break;
+    }
+  }
+  return true;
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_TEST_REPLAY_NETLINK_MANAGER_H_
+#define WIFICOND_TEST_REPLAY_NETLINK_MANAGER_H_
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "wificond/net/netlink_capture.h"
+#include "wificond/net/netlink_manager.h"
+
+namespace android {
+namespace wificond {
+
+// NetlinkManager backend that serves traffic recorded with
+// NetlinkManager::StartCapture instead of talking to kernel, so that parsing
+// and dispatch can be benchmarked and regression tested off-device.
+//   - A synchronous request is answered with the replies that were recorded
+//     for a request with the same message type and command. Requests with
+//     the same command get the recorded replies in turn, starting over once
+//     all were served.
+//   - |ReplayEvents| feeds the datagrams recorded on the asynchronous socket,
+//     i.e. multicast events, through the regular dispatch path, as fast as
+//     possible.
+class ReplayNetlinkManager : public NetlinkManager {
+ public:
+  explicit ReplayNetlinkManager(EventLoop* event_loop);
+  ~ReplayNetlinkManager() override = default;
+
+  // Loads the capture file at |path|, replacing any capture loaded before.
+  // Returns true on success.
+  bool LoadCapture(const std::string& path);
+
+  // Discovers the nl80211 family from the capture.
+  bool Start() override;
+  bool IsStarted() const override;
+
+  bool SendMessageAndGetResponses(
+      const NL80211Packet& packet,
+      std::vector<std::unique_ptr<const NL80211Packet>>* response) override;
+  bool SendMessagesAndGetResponses(
+      const std::vector<const NL80211Packet*>& packets,
+      std::vector<std::vector<std::unique_ptr<const NL80211Packet>>>*
+          responses) override;
+  bool SendMessageAndStreamResponses(
+      const NL80211Packet& packet,
+      std::function<void(const NL80211PacketView&)> handler) override;
+
+  // Runs the handlers of every datagram received on the asynchronous socket
+  // during the capture.
+  // Returns the number of datagrams replayed.
+  size_t ReplayEvents();
+
+ private:
+  // Datagrams received in reply to one recorded request.
+  // A datagram might also carry replies to other requests of a batch.
+  struct RecordedReply {
+    uint32_t sequence;
+    std::vector<const std::vector<uint8_t>*> datagrams;
+  };
+
+  // Runs |handler| on every message of the next recorded reply to a request
+  // like |packet|, up to NLMSG_DONE.
+  // Returns false if no such request was recorded.
+  bool ReplayReply(const NL80211Packet& packet,
+                   const std::function<void(const NL80211PacketView&)>& handler);
+
+  std::vector<NetlinkCaptureRecord> records_;
+  // Recorded replies, keyed by message type and command of their request.
+  std::map<std::pair<uint16_t, uint8_t>, std::vector<RecordedReply>> replies_;
+  // Index of the reply to serve next, for each key of |replies_|.
+  std::map<std::pair<uint16_t, uint8_t>, size_t> next_reply_;
+  bool replay_started_;
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_TEST_REPLAY_NETLINK_MANAGER_H_
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "wificond/net/request_table.h"
+
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr uint32_t kNumSlots = RequestTable<int>::kNumSlots;
+
+}  // namespace
+
+TEST(RequestTableTest, CanAddFindAndEraseRequests) {
+  RequestTable<int> table;
+  EXPECT_TRUE(table.empty());
+  table[1] = 10;
+  table[2] = 20;
+  EXPECT_EQ(2u, table.size());
+  ASSERT_NE(nullptr, table.Find(1));
+  EXPECT_EQ(10, *table.Find(1));
+  EXPECT_EQ(nullptr, table.Find(3));
+  EXPECT_EQ(1u, table.erase(1));
+  EXPECT_EQ(0u, table.erase(1));
+  EXPECT_EQ(nullptr, table.Find(1));
+  EXPECT_EQ(1u, table.size());
+}
+
+TEST(RequestTableTest, KeepsRequestsThatShareASlot) {
+  RequestTable<int> table;
+  table[5] = 1;
+  int* first = &table[5];
+  table[5 + kNumSlots] = 2;
+  table[5 + 2 * kNumSlots] = 3;
+  EXPECT_EQ(3u, table.size());
+  EXPECT_EQ(first, table.Find(5));
+  EXPECT_EQ(2, *table.Find(5 + kNumSlots));
+  EXPECT_EQ(3, *table.Find(5 + 2 * kNumSlots));
+
+  EXPECT_EQ(1u, table.erase(5));
+  EXPECT_EQ(nullptr, table.Find(5));
+  EXPECT_EQ(2, *table.Find(5 + kNumSlots));
+  EXPECT_EQ(1u, table.erase(5 + kNumSlots));
+  EXPECT_EQ(3, *table.Find(5 + 2 * kNumSlots));
+  EXPECT_EQ(1u, table.size());
+}
+
+TEST(RequestTableTest, CanWrapAroundSequenceNumbers) {
+  RequestTable<int> table;
+  const uint32_t last = UINT32_MAX;
+  table[last] = 1;
+  table[0] = 2;
+  EXPECT_EQ(1, *table.Find(last));
+  EXPECT_EQ(2, *table.Find(0));
+  vector<uint32_t> sequences;
+  table.GetSequences(&sequences);
+  EXPECT_EQ(2u, sequences.size());
+}
+
+TEST(RequestTableTest, ReleasesValuesOfErasedRequests) {
+  RequestTable<std::function<void()>> table;
+  auto captured = std::make_shared<int>(0);
+  table[1] = [captured]() {};
+  EXPECT_EQ(2, captured.use_count());
+  table.erase(1);
+  EXPECT_EQ(1, captured.use_count());
+}
+
+TEST(RequestTableTest, FindsExpiredRequests) {
+  RequestTable<int> table;
+  EXPECT_EQ(0, table.GetEarliestDeadline());
+  table[1];
+  table[2];
+  table[2 + kNumSlots];
+  table[3];
+  EXPECT_EQ(0, table.GetEarliestDeadline());
+  table.SetDeadline(1, 300);
+  table.SetDeadline(2, 200);
+  table.SetDeadline(2 + kNumSlots, 100);
+  EXPECT_EQ(100, table.GetEarliestDeadline());
+
+  vector<uint32_t> expired;
+  table.GetExpired(200, &expired);
+  std::sort(expired.begin(), expired.end());
+  EXPECT_EQ((vector<uint32_t>{2, 2 + kNumSlots}), expired);
+
+  table.erase(2);
+  table.erase(2 + kNumSlots);
+  EXPECT_EQ(300, table.GetEarliestDeadline());
+  // A request added again to a freed slot has no deadline.
+  table[2];
+  EXPECT_EQ(300, table.GetEarliestDeadline());
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <private/android_filesystem_config.h>
+
+#include "wificond/scanning/scan_arbiter.h"
+
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr uid_t kFakeUid1 = 10001;
+constexpr uid_t kFakeUid2 = 10002;
+constexpr size_t kFakeMaxScansPerWindow = 2;
+constexpr nsecs_t kFakeQuotaWindow = s2ns(60);
+constexpr nsecs_t kFakeRecentScanWindow = s2ns(2);
+constexpr nsecs_t kFakeStartTime = s2ns(1000);
+
+SingleScanRequest CreateRequest(vector<uint32_t> freqs) {
+  SingleScanRequest request;
+  request.ssids = {{}};
+  request.freqs = std::move(freqs);
+  return request;
+}
+
+}  // namespace
+
+TEST(ScanArbiterTest, LimitsScansPerUid) {
+  ScanArbiter arbiter(kFakeMaxScansPerWindow, kFakeQuotaWindow,
+                      kFakeRecentScanWindow);
+  EXPECT_TRUE(arbiter.TryAcquireQuota(kFakeUid1, kFakeStartTime));
+  EXPECT_TRUE(arbiter.TryAcquireQuota(kFakeUid1, kFakeStartTime + s2ns(1)));
+  EXPECT_FALSE(arbiter.TryAcquireQuota(kFakeUid1, kFakeStartTime + s2ns(2)));
+  // Quotas are per uid.
+  EXPECT_TRUE(arbiter.TryAcquireQuota(kFakeUid2, kFakeStartTime + s2ns(2)));
+  // The first scan leaves the window.
+  EXPECT_TRUE(arbiter.TryAcquireQuota(kFakeUid1,
+                                      kFakeStartTime + kFakeQuotaWindow));
+  EXPECT_FALSE(arbiter.TryAcquireQuota(kFakeUid1,
+                                       kFakeStartTime + kFakeQuotaWindow));
+  EXPECT_EQ(2u, arbiter.GetNumThrottled());
+}
+
+TEST(ScanArbiterTest, DoesNotLimitWifiStack) {
+  ScanArbiter arbiter(kFakeMaxScansPerWindow, kFakeQuotaWindow,
+                      kFakeRecentScanWindow);
+  for (int i = 0; i < 10; i++) {
+    EXPECT_TRUE(arbiter.TryAcquireQuota(AID_SYSTEM, kFakeStartTime));
+    EXPECT_TRUE(arbiter.TryAcquireQuota(AID_WIFI, kFakeStartTime));
+  }
+  EXPECT_EQ(0u, arbiter.GetNumThrottled());
+}
+
+TEST(ScanArbiterTest, ServesRequestsCoveredByRecentScan) {
+  ScanArbiter arbiter(kFakeMaxScansPerWindow, kFakeQuotaWindow,
+                      kFakeRecentScanWindow);
+  EXPECT_FALSE(arbiter.TryServeFromRecentScan(CreateRequest({2412}),
+                                              kFakeStartTime));
+  arbiter.OnScanCompleted(CreateRequest({2412, 5180}), kFakeStartTime);
+  EXPECT_TRUE(arbiter.TryServeFromRecentScan(CreateRequest({2412}),
+                                             kFakeStartTime + s2ns(1)));
+  EXPECT_FALSE(arbiter.TryServeFromRecentScan(CreateRequest({2437}),
+                                              kFakeStartTime + s2ns(1)));
+  EXPECT_FALSE(arbiter.TryServeFromRecentScan(
+      CreateRequest({2412}), kFakeStartTime + kFakeRecentScanWindow));
+  EXPECT_EQ(1u, arbiter.GetNumServedByRecentScan());
+
+  arbiter.OnScanCompleted(CreateRequest({}), kFakeStartTime);
+  arbiter.ForgetRecentScan();
+  EXPECT_FALSE(arbiter.TryServeFromRecentScan(CreateRequest({2412}),
+                                              kFakeStartTime));
+}
+
+TEST(ScanArbiterTest, TracksWaitingCallers) {
+  ScanArbiter arbiter;
+  arbiter.AddWaitingCaller(kFakeUid1, false);
+  arbiter.AddWaitingCaller(kFakeUid1, false);
+  arbiter.AddWaitingCaller(kFakeUid2, true);
+  EXPECT_EQ(vector<uid_t>{kFakeUid1}, arbiter.TakeWaitingCallers());
+  EXPECT_TRUE(arbiter.TakeWaitingCallers().empty());
+
+  arbiter.PromoteFollowUpCallers();
+  EXPECT_EQ(vector<uid_t>{kFakeUid2}, arbiter.TakeWaitingCallers());
+
+  arbiter.AddWaitingCaller(kFakeUid1, false);
+  arbiter.AddWaitingCaller(kFakeUid2, true);
+  arbiter.Clear();
+  arbiter.PromoteFollowUpCallers();
+  EXPECT_TRUE(arbiter.TakeWaitingCallers().empty());
+}
+
+}  // namespace wificond
+}  // namespace android
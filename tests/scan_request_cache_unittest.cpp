@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "wificond/net/kernel-header-latest/nl80211.h"
+#include "wificond/scanning/scan_request_cache.h"
+
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr uint16_t kFakeFamilyId = 0x1c;
+constexpr uint32_t kFakeInterfaceIndex = 12;
+constexpr uint32_t kFakePeerInterfaceIndex = 13;
+constexpr int kFakeScanType = 0;
+const vector<vector<uint8_t>> kFakeSsids = {{'s', 's', 'i', 'd'}, {}};
+const vector<uint32_t> kFakeFrequencies = {2412, 5180};
+
+NL80211Packet CreateTriggerScan(uint32_t interface_index) {
+  NL80211Packet trigger_scan(kFakeFamilyId, NL80211_CMD_TRIGGER_SCAN, 0, 0);
+  trigger_scan.AddAttributeValue<uint32_t>(NL80211_ATTR_IFINDEX,
+                                           interface_index);
+  return trigger_scan;
+}
+
+}  // namespace
+
+TEST(ScanRequestCacheTest, FindsTemplateOfSameSettingsOnly) {
+  ScanRequestCache cache;
+  EXPECT_EQ(nullptr, cache.Find(kFakeInterfaceIndex, false, kFakeScanType,
+                                kFakeSsids, kFakeFrequencies));
+  NL80211Packet* request = cache.Insert(
+      kFakeInterfaceIndex, false, kFakeScanType, kFakeSsids, kFakeFrequencies,
+      CreateTriggerScan(kFakeInterfaceIndex));
+  EXPECT_EQ(request, cache.Find(kFakeInterfaceIndex, false, kFakeScanType,
+                                kFakeSsids, kFakeFrequencies));
+
+  EXPECT_EQ(nullptr, cache.Find(kFakePeerInterfaceIndex, false,
+                                kFakeScanType, kFakeSsids, kFakeFrequencies));
+  EXPECT_EQ(nullptr, cache.Find(kFakeInterfaceIndex, true, kFakeScanType,
+                                kFakeSsids, kFakeFrequencies));
+  EXPECT_EQ(nullptr, cache.Find(kFakeInterfaceIndex, false, kFakeScanType,
+                                {}, kFakeFrequencies));
+  EXPECT_EQ(nullptr, cache.Find(kFakeInterfaceIndex, false, kFakeScanType,
+                                kFakeSsids, {2412}));
+  // Same bytes, split into other SSIDs.
+  EXPECT_EQ(nullptr, cache.Find(kFakeInterfaceIndex, false, kFakeScanType,
+                                {{'s', 's'}, {'i', 'd'}}, kFakeFrequencies));
+}
+
+TEST(ScanRequestCacheTest, EvictsLeastRecentlyUsedTemplate) {
+  ScanRequestCache cache;
+  for (uint32_t i = 0; i < ScanRequestCache::kMaxNumTemplates; i++) {
+    cache.Insert(kFakeInterfaceIndex, false, kFakeScanType, kFakeSsids,
+                 {2412 + 5 * i}, CreateTriggerScan(kFakeInterfaceIndex));
+  }
+  // The first template is used again, so the second one is evicted.
+  EXPECT_NE(nullptr, cache.Find(kFakeInterfaceIndex, false, kFakeScanType,
+                                kFakeSsids, {2412}));
+  cache.Insert(kFakeInterfaceIndex, false, kFakeScanType, kFakeSsids,
+               {5180}, CreateTriggerScan(kFakeInterfaceIndex));
+  EXPECT_EQ(ScanRequestCache::kMaxNumTemplates, cache.GetNumTemplates());
+  EXPECT_NE(nullptr, cache.Find(kFakeInterfaceIndex, false, kFakeScanType,
+                                kFakeSsids, {2412}));
+  EXPECT_EQ(nullptr, cache.Find(kFakeInterfaceIndex, false, kFakeScanType,
+                                kFakeSsids, {2417}));
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "android/net/wifi/nl80211/IWifiScannerImpl.h"
+#include "wificond/scanning/scan_request_scheduler.h"
+
+using ::android::net::wifi::nl80211::IWifiScannerImpl;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+constexpr size_t kFakeMaxNumScanSsids = 3;
+const vector<uint8_t> kFakeSsid1 = {'G', 'o', 'o', 'g', 'l', 'e'};
+const vector<uint8_t> kFakeSsid2 = {'A', 'n', 'd', 'r', 'o', 'i', 'd'};
+const vector<uint8_t> kFakeSsid3 = {'W', 'i', 'f', 'i'};
+
+SingleScanRequest CreateRequest(vector<vector<uint8_t>> hidden_ssids,
+                                vector<uint32_t> freqs) {
+  SingleScanRequest request;
+  request.ssids = {{}};
+  request.ssids.insert(request.ssids.end(), hidden_ssids.begin(),
+                       hidden_ssids.end());
+  request.freqs = std::move(freqs);
+  return request;
+}
+
+}  // namespace
+
+TEST(ScanRequestSchedulerTest, SkipsRequestCoveredByScanInFlight) {
+  ScanRequestScheduler scheduler(kFakeMaxNumScanSsids);
+  scheduler.OnScanStarted(CreateRequest({kFakeSsid1}, {}));
+
+  EXPECT_FALSE(scheduler.AddRequest(CreateRequest({}, {2412, 5180})));
+  EXPECT_FALSE(scheduler.AddRequest(CreateRequest({kFakeSsid1}, {})));
+  EXPECT_FALSE(scheduler.HasFollowUpScan());
+  // High accuracy scans are not served by scans of other types.
+  SingleScanRequest high_accuracy_request = CreateRequest({}, {2412});
+  high_accuracy_request.scan_type = IWifiScannerImpl::SCAN_TYPE_HIGH_ACCURACY;
+  EXPECT_TRUE(scheduler.AddRequest(high_accuracy_request));
+}
+
+TEST(ScanRequestSchedulerTest, MergesRequestsIntoFollowUpScan) {
+  ScanRequestScheduler scheduler(kFakeMaxNumScanSsids);
+  scheduler.OnScanStarted(CreateRequest({}, {2412}));
+
+  EXPECT_TRUE(scheduler.AddRequest(CreateRequest({kFakeSsid1}, {2412, 5180})));
+  EXPECT_TRUE(scheduler.AddRequest(CreateRequest({kFakeSsid2}, {5180, 5955})));
+  // Only 2 hidden SSIDs fit next to the wild card one.
+  EXPECT_TRUE(scheduler.AddRequest(CreateRequest({kFakeSsid3}, {5955})));
+
+  SingleScanRequest follow_up_scan;
+  ASSERT_TRUE(scheduler.TakeFollowUpScan(&follow_up_scan));
+  EXPECT_EQ(IWifiScannerImpl::SCAN_TYPE_DEFAULT, follow_up_scan.scan_type);
+  EXPECT_EQ(vector<vector<uint8_t>>({{}, kFakeSsid1, kFakeSsid2}),
+            follow_up_scan.ssids);
+  EXPECT_EQ(vector<uint32_t>({2412, 5180, 5955}), follow_up_scan.freqs);
+  EXPECT_FALSE(scheduler.TakeFollowUpScan(&follow_up_scan));
+}
+
+TEST(ScanRequestSchedulerTest, MergesRequestForAllFrequencies) {
+  ScanRequestScheduler scheduler(kFakeMaxNumScanSsids);
+  scheduler.OnScanStarted(CreateRequest({}, {2412}));
+
+  SingleScanRequest low_span_request = CreateRequest({}, {5180});
+  low_span_request.scan_type = IWifiScannerImpl::SCAN_TYPE_LOW_SPAN;
+  EXPECT_TRUE(scheduler.AddRequest(low_span_request));
+  SingleScanRequest high_accuracy_request = CreateRequest({}, {});
+  high_accuracy_request.scan_type = IWifiScannerImpl::SCAN_TYPE_HIGH_ACCURACY;
+  EXPECT_TRUE(scheduler.AddRequest(high_accuracy_request));
+
+  SingleScanRequest follow_up_scan;
+  ASSERT_TRUE(scheduler.TakeFollowUpScan(&follow_up_scan));
+  EXPECT_EQ(IWifiScannerImpl::SCAN_TYPE_HIGH_ACCURACY,
+            follow_up_scan.scan_type);
+  EXPECT_TRUE(follow_up_scan.freqs.empty());
+}
+
+TEST(ScanRequestSchedulerTest, SplitsRequestByBand) {
+  SingleScanRequest request = CreateRequest({kFakeSsid1}, {5955, 2412, 5180});
+  request.scan_type = IWifiScannerImpl::SCAN_TYPE_LOW_SPAN;
+  // 58320 is in none of the bands.
+  request.freqs.push_back(58320);
+
+  vector<SubScanRequest> sub_scans =
+      ScanRequestScheduler::SplitByBand(request, BandInfo());
+  ASSERT_EQ(3u, sub_scans.size());
+  EXPECT_EQ(IWifiScannerImpl::SCAN_RESULT_BAND_2G, sub_scans[0].bands);
+  EXPECT_EQ(vector<uint32_t>({2412}), sub_scans[0].request.freqs);
+  EXPECT_EQ(IWifiScannerImpl::SCAN_RESULT_BAND_5G, sub_scans[1].bands);
+  EXPECT_EQ(vector<uint32_t>({5180}), sub_scans[1].request.freqs);
+  EXPECT_EQ(IWifiScannerImpl::SCAN_RESULT_BAND_6G, sub_scans[2].bands);
+  EXPECT_EQ(vector<uint32_t>({5955, 58320}), sub_scans[2].request.freqs);
+  for (const SubScanRequest& sub_scan : sub_scans) {
+    EXPECT_EQ(IWifiScannerImpl::SCAN_TYPE_LOW_SPAN,
+              sub_scan.request.scan_type);
+    EXPECT_EQ(request.ssids, sub_scan.request.ssids);
+  }
+}
+
+TEST(ScanRequestSchedulerTest, SplitsRequestForAllFrequenciesByBand) {
+  BandInfo band_info;
+  band_info.band_2g = {2412, 2437};
+  band_info.band_5g = {5180};
+  band_info.band_dfs = {5260};
+
+  vector<SubScanRequest> sub_scans =
+      ScanRequestScheduler::SplitByBand(CreateRequest({}, {}), band_info);
+  ASSERT_EQ(2u, sub_scans.size());
+  EXPECT_EQ(vector<uint32_t>({2412, 2437}), sub_scans[0].request.freqs);
+  EXPECT_EQ(vector<uint32_t>({5180, 5260}), sub_scans[1].request.freqs);
+  // Frequencies are unknown without band info.
+  EXPECT_TRUE(ScanRequestScheduler::SplitByBand(CreateRequest({}, {}),
+                                                BandInfo()).empty());
+}
+
+TEST(ScanRequestSchedulerTest, ClearDropsFollowUpScan) {
+  ScanRequestScheduler scheduler(kFakeMaxNumScanSsids);
+  scheduler.OnScanStarted(CreateRequest({}, {2412}));
+  EXPECT_TRUE(scheduler.AddRequest(CreateRequest({}, {5180})));
+
+  scheduler.Clear();
+  SingleScanRequest follow_up_scan;
+  EXPECT_FALSE(scheduler.TakeFollowUpScan(&follow_up_scan));
+}
+
+}  // namespace wificond
+}  // namespace android
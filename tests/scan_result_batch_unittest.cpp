@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include <array>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "wificond/scanning/scan_result.h"
+#include "wificond/scanning/scan_result_batch.h"
+
+using ::android::net::wifi::nl80211::NativeScanResult;
+using ::android::net::wifi::nl80211::RadioChainInfo;
+using std::array;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+const array<uint8_t, ETH_ALEN> kFakeBssid1 =
+    {0x45, 0x54, 0xad, 0x67, 0x98, 0xf6};
+const array<uint8_t, ETH_ALEN> kFakeBssid2 =
+    {0x45, 0x54, 0xad, 0x67, 0x98, 0xf7};
+constexpr uint32_t kFakeFrequency = 5240;
+constexpr int32_t kFakeSignalMbm = -3200;
+constexpr uint64_t kFakeTsf = 1200;
+constexpr uint16_t kFakeCapability = 0x11;
+
+vector<NativeScanResult> CreateScanResults() {
+  vector<NativeScanResult> scan_results(2);
+  scan_results[0].ssid = {'a', 'b', 'c'};
+  scan_results[0].bssid = kFakeBssid1;
+  scan_results[0].info_element = {0x00, 0x03, 'a', 'b', 'c'};
+  scan_results[0].frequency = kFakeFrequency;
+  scan_results[0].signal_mbm = kFakeSignalMbm;
+  scan_results[0].tsf = kFakeTsf;
+  scan_results[0].capability = kFakeCapability;
+  scan_results[0].associated = true;
+  scan_results[0].radio_chain_infos = {RadioChainInfo(0, -56),
+                                       RadioChainInfo(1, -64)};
+  scan_results[0].info_element_index.emplace_back(0, 0, 2, 3);
+  scan_results[0].security = 1;
+  scan_results[0].channel_width = 2;
+  scan_results[0].wifi_standard = 4;
+  // A hidden network, without any of the variable length fields.
+  scan_results[1].bssid = kFakeBssid2;
+  scan_results[1].frequency = kFakeFrequency;
+  scan_results[1].signal_mbm = kFakeSignalMbm;
+  scan_results[1].tsf = kFakeTsf;
+  scan_results[1].capability = 0;
+  scan_results[1].associated = false;
+  return scan_results;
+}
+
+}  // namespace
+
+TEST(ScanResultBatchTest, WritesSameParcelAsVector) {
+  vector<NativeScanResult> scan_results = CreateScanResults();
+  ScanResultBatch batch;
+  batch.Assign(scan_results);
+
+  Parcel parcel;
+  ASSERT_EQ(::android::OK, batch.WriteToParcel(&parcel));
+  EXPECT_EQ(batch.GetParcelSize(), parcel.dataSize());
+
+  // The layout of Parcel::writeParcelableVector().
+  Parcel expected_parcel;
+  expected_parcel.writeInt32(scan_results.size());
+  for (const auto& scan_result : scan_results) {
+    expected_parcel.writeInt32(1);
+    ASSERT_EQ(::android::OK, scan_result.writeToParcel(&expected_parcel));
+  }
+  ASSERT_EQ(expected_parcel.dataSize(), parcel.dataSize());
+  EXPECT_EQ(0, memcmp(expected_parcel.data(), parcel.data(),
+                      parcel.dataSize()));
+}
+
+TEST(ScanResultBatchTest, CanGetScanResults) {
+  vector<NativeScanResult> scan_results = CreateScanResults();
+  ScanResultBatch batch;
+  batch.Assign(scan_results);
+  ASSERT_EQ(scan_results.size(), batch.size());
+  for (size_t i = 0; i < batch.size(); i++) {
+    NativeScanResult scan_result = batch.Get(i);
+    EXPECT_EQ(scan_results[i].ssid, scan_result.ssid);
+    EXPECT_EQ(scan_results[i].bssid, scan_result.bssid);
+    EXPECT_EQ(scan_results[i].info_element, scan_result.info_element);
+    EXPECT_EQ(scan_results[i].frequency, scan_result.frequency);
+    EXPECT_EQ(scan_results[i].signal_mbm, scan_result.signal_mbm);
+    EXPECT_EQ(scan_results[i].tsf, scan_result.tsf);
+    EXPECT_EQ(scan_results[i].capability, scan_result.capability);
+    EXPECT_EQ(scan_results[i].associated, scan_result.associated);
+    EXPECT_EQ(scan_results[i].radio_chain_infos,
+              scan_result.radio_chain_infos);
+    EXPECT_EQ(scan_results[i].info_element_index,
+              scan_result.info_element_index);
+    EXPECT_EQ(scan_results[i].security, scan_result.security);
+    EXPECT_EQ(scan_results[i].channel_width, scan_result.channel_width);
+    EXPECT_EQ(scan_results[i].wifi_standard, scan_result.wifi_standard);
+  }
+}
+
+TEST(ScanResultBatchTest, CanReuseClearedBatch) {
+  vector<NativeScanResult> scan_results = CreateScanResults();
+  ScanResultBatch batch;
+  batch.Assign(scan_results);
+  batch.Clear();
+  EXPECT_TRUE(batch.empty());
+
+  batch.Add(scan_results[1]);
+  ASSERT_EQ(1u, batch.size());
+  EXPECT_EQ(kFakeBssid2, batch.Get(0).bssid);
+  EXPECT_TRUE(batch.Get(0).ssid.empty());
+}
+
+}  // namespace wificond
+}  // namespace android
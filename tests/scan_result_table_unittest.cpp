@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <array>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "android/net/wifi/nl80211/IWifiScannerImpl.h"
+#include "wificond/scanning/scan_result.h"
+#include "wificond/scanning/scan_result_query.h"
+#include "wificond/scanning/scan_result_table.h"
+
+using ::android::net::wifi::nl80211::IWifiScannerImpl;
+using ::android::net::wifi::nl80211::NativeScanResult;
+using ::android::net::wifi::nl80211::ScanResultQuery;
+using std::array;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+NativeScanResult CreateScanResult(uint8_t bssid_suffix,
+                                  uint32_t frequency,
+                                  int32_t signal_mbm,
+                                  bool associated) {
+  NativeScanResult scan_result;
+  scan_result.bssid = {0x45, 0x54, 0xad, 0x67, 0x98, bssid_suffix};
+  scan_result.frequency = frequency;
+  scan_result.signal_mbm = signal_mbm;
+  scan_result.associated = associated;
+  return scan_result;
+}
+
+// Rows 0 to 4.
+vector<NativeScanResult> CreateScanResults() {
+  return {CreateScanResult(0, 2412, -6000, false),
+          CreateScanResult(1, 5180, -4500, true),
+          CreateScanResult(2, 5955, -7000, false),
+          CreateScanResult(3, 5180, -5000, false),
+          // Not in any of the bands of IWifiScannerImpl.
+          CreateScanResult(4, 58320, -4000, false)};
+}
+
+}  // namespace
+
+TEST(ScanResultTableTest, CanAssign) {
+  vector<NativeScanResult> scan_results = CreateScanResults();
+  ScanResultTable table;
+  table.Assign(scan_results);
+  ASSERT_EQ(scan_results.size(), table.size());
+  for (size_t row = 0; row < table.size(); row++) {
+    EXPECT_EQ(scan_results[row].bssid, table.GetBssid(row));
+    EXPECT_EQ(scan_results[row].frequency, table.GetFrequency(row));
+    EXPECT_EQ(scan_results[row].signal_mbm, table.GetSignalMbm(row));
+    EXPECT_EQ(scan_results[row].associated, table.IsAssociated(row));
+  }
+}
+
+TEST(ScanResultTableTest, CanFilter) {
+  ScanResultTable table;
+  table.Assign(CreateScanResults());
+
+  ScanResultQuery query;
+  vector<uint32_t> rows;
+  table.Filter(query, &rows);
+  EXPECT_EQ(vector<uint32_t>({0, 1, 2, 3, 4}), rows);
+
+  query.bands = IWifiScannerImpl::SCAN_RESULT_BAND_5G |
+                IWifiScannerImpl::SCAN_RESULT_BAND_6G;
+  rows.clear();
+  table.Filter(query, &rows);
+  EXPECT_EQ(vector<uint32_t>({1, 2, 3}), rows);
+
+  query.min_signal_mbm = -5000;
+  rows.clear();
+  table.Filter(query, &rows);
+  EXPECT_EQ(vector<uint32_t>({1, 3}), rows);
+
+  query.associated_only = true;
+  rows.clear();
+  table.Filter(query, &rows);
+  EXPECT_EQ(vector<uint32_t>({1}), rows);
+}
+
+TEST(ScanResultTableTest, CanKeepStrongest) {
+  ScanResultTable table;
+  table.Assign(CreateScanResults());
+
+  vector<uint32_t> rows = {0, 1, 2, 3, 4};
+  table.KeepStrongest(3, &rows);
+  EXPECT_EQ(vector<uint32_t>({4, 1, 3}), rows);
+
+  rows = {0, 2, 3};
+  table.KeepStrongest(5, &rows);
+  EXPECT_EQ(vector<uint32_t>({3, 0, 2}), rows);
+}
+
+}  // namespace wificond
+}  // namespace android
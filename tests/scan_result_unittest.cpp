@@ -21,9 +21,13 @@
 
 #include <gtest/gtest.h>
 
+#include "android/net/wifi/nl80211/IWifiScannerImpl.h"
 #include "wificond/scanning/scan_result.h"
+#include "wificond/scanning/scan_results_delta.h"
 
+using ::android::net::wifi::nl80211::IWifiScannerImpl;
 using ::android::net::wifi::nl80211::NativeScanResult;
+using ::android::net::wifi::nl80211::NativeScanResultsDelta;
 using ::android::net::wifi::nl80211::RadioChainInfo;
 using std::array;
 using std::vector;
@@ -45,6 +49,10 @@ constexpr int16_t kFakeCapability = 0;
 constexpr bool kFakeAssociated = true;
 constexpr int32_t kFakeRadioChainIds[] = { 0, 1 };
 constexpr int32_t kFakeRadioChainLevels[] = { -56, -64};
+constexpr int64_t kFakeGeneration = 7;
+const array<uint8_t, ETH_ALEN> kFakeRemovedBssid =
+    {0x45, 0x54, 0xad, 0x67, 0x98, 0xf7};
+constexpr uint32_t kFakeRemovedFrequency = 2412;
 
 }  // namespace
 
@@ -64,11 +72,19 @@ TEST_F(ScanResultTest, ParcelableTest) {
   NativeScanResult scan_result(ssid, bssid, ie, kFakeFrequency,
       kFakeSignalMbm, kFakeTsf, kFakeCapability, kFakeAssociated,
       radio_chain_infos);
+  scan_result.info_element_index.emplace_back(5, 0, 2, 2);
+  scan_result.security = IWifiScannerImpl::SCAN_RESULT_SECURITY_RSN |
+                         IWifiScannerImpl::SCAN_RESULT_SECURITY_SAE;
+  scan_result.channel_width =
+      IWifiScannerImpl::SCAN_RESULT_CHANNEL_WIDTH_80MHZ;
+  scan_result.wifi_standard = IWifiScannerImpl::SCAN_RESULT_WIFI_STANDARD_11AX;
+  scan_result.parcel_ie_index = true;
 
   Parcel parcel;
   EXPECT_EQ(::android::OK, scan_result.writeToParcel(&parcel));
 
   NativeScanResult scan_result_copy;
+  scan_result_copy.parcel_ie_index = true;
   parcel.setDataPosition(0);
   EXPECT_EQ(::android::OK, scan_result_copy.readFromParcel(&parcel));
 
@@ -85,6 +101,70 @@ TEST_F(ScanResultTest, ParcelableTest) {
   EXPECT_EQ(kFakeRadioChainIds[1], scan_result_copy.radio_chain_infos[1].chain_id);
   EXPECT_EQ(kFakeRadioChainLevels[0], scan_result_copy.radio_chain_infos[0].level);
   EXPECT_EQ(kFakeRadioChainLevels[1], scan_result_copy.radio_chain_infos[1].level);
+  EXPECT_EQ(scan_result.info_element_index,
+            scan_result_copy.info_element_index);
+  EXPECT_EQ(scan_result.security, scan_result_copy.security);
+  EXPECT_EQ(scan_result.channel_width, scan_result_copy.channel_width);
+  EXPECT_EQ(scan_result.wifi_standard, scan_result_copy.wifi_standard);
+}
+
+// Unless asked for, the parcel ends after the radio chain infos, like the
+// framework reads it.
+TEST_F(ScanResultTest, ParcelableKeepsLayoutWithoutIeIndex) {
+  std::vector<uint8_t> ssid(kFakeSsid, kFakeSsid + sizeof(kFakeSsid));
+  array<uint8_t, ETH_ALEN> bssid = kFakeBssid;
+  std::vector<uint8_t> ie(kFakeIE, kFakeIE + sizeof(kFakeIE));
+  std::vector<RadioChainInfo> radio_chain_infos;
+  NativeScanResult scan_result(ssid, bssid, ie, kFakeFrequency,
+      kFakeSignalMbm, kFakeTsf, kFakeCapability, kFakeAssociated,
+      radio_chain_infos);
+  scan_result.info_element_index.emplace_back(5, 0, 2, 2);
+  scan_result.wifi_standard = IWifiScannerImpl::SCAN_RESULT_WIFI_STANDARD_11AX;
+
+  Parcel parcel;
+  EXPECT_EQ(::android::OK, scan_result.writeToParcel(&parcel));
+
+  NativeScanResult scan_result_copy;
+  parcel.setDataPosition(0);
+  ASSERT_EQ(::android::OK, scan_result_copy.readFromParcel(&parcel));
+  EXPECT_EQ(0u, parcel.dataAvail());
+  EXPECT_EQ(bssid, scan_result_copy.bssid);
+  EXPECT_TRUE(scan_result_copy.info_element_index.empty());
+  EXPECT_EQ(IWifiScannerImpl::SCAN_RESULT_WIFI_STANDARD_UNKNOWN,
+            scan_result_copy.wifi_standard);
+}
+
+TEST_F(ScanResultTest, DeltaParcelableTest) {
+  std::vector<uint8_t> ssid(kFakeSsid, kFakeSsid + sizeof(kFakeSsid));
+  array<uint8_t, ETH_ALEN> bssid = kFakeBssid;
+  std::vector<uint8_t> ie(kFakeIE, kFakeIE + sizeof(kFakeIE));
+  std::vector<RadioChainInfo> radio_chain_infos;
+
+  NativeScanResultsDelta delta;
+  delta.generation = kFakeGeneration;
+  delta.is_full = false;
+  delta.updated_scan_results.emplace_back(ssid, bssid, ie, kFakeFrequency,
+      kFakeSignalMbm, kFakeTsf, kFakeCapability, kFakeAssociated,
+      radio_chain_infos);
+  delta.removed_bssids.push_back(kFakeRemovedBssid);
+  delta.removed_frequencies.push_back(kFakeRemovedFrequency);
+
+  Parcel parcel;
+  EXPECT_EQ(::android::OK, delta.writeToParcel(&parcel));
+
+  NativeScanResultsDelta delta_copy;
+  parcel.setDataPosition(0);
+  EXPECT_EQ(::android::OK, delta_copy.readFromParcel(&parcel));
+
+  EXPECT_EQ(kFakeGeneration, delta_copy.generation);
+  EXPECT_FALSE(delta_copy.is_full);
+  ASSERT_EQ(1u, delta_copy.updated_scan_results.size());
+  EXPECT_EQ(bssid, delta_copy.updated_scan_results[0].bssid);
+  EXPECT_EQ(ie, delta_copy.updated_scan_results[0].info_element);
+  ASSERT_EQ(1u, delta_copy.removed_bssids.size());
+  EXPECT_EQ(kFakeRemovedBssid, delta_copy.removed_bssids[0]);
+  ASSERT_EQ(1u, delta_copy.removed_frequencies.size());
+  EXPECT_EQ(kFakeRemovedFrequency, delta_copy.removed_frequencies[0]);
 }
 
 }  // namespace wificond
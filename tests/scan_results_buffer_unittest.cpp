@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <vector>
+
+#include <linux/if_ether.h>
+
+#include <gtest/gtest.h>
+
+#include "wificond/scanning/scan_result.h"
+#include "wificond/scanning/scan_results_buffer.h"
+
+using ::android::base::unique_fd;
+using ::android::net::wifi::nl80211::NativeScanResult;
+using ::android::net::wifi::nl80211::RadioChainInfo;
+using std::array;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+const uint8_t kFakeSsid[] = {'G', 'u', 'e', 's', 't'};
+const array<uint8_t, ETH_ALEN> kFakeBssid1 =
+    {0x45, 0x54, 0xad, 0x67, 0x98, 0xf6};
+const array<uint8_t, ETH_ALEN> kFakeBssid2 =
+    {0x45, 0x54, 0xad, 0x67, 0x98, 0xf7};
+const uint8_t kFakeIE[] = {0x00, 0x05, 'G', 'u', 'e', 's', 't', 0x01};
+constexpr uint32_t kFakeFrequency = 5240;
+constexpr int32_t kFakeSignalMbm = -3200;
+constexpr uint64_t kFakeTsf = 0x123456789abcdef0;
+constexpr uint16_t kFakeCapability = 0x0411;
+constexpr int32_t kFakeRadioChainId = 1;
+constexpr int32_t kFakeRadioChainLevel = -64;
+
+vector<NativeScanResult> CreateScanResults() {
+  vector<uint8_t> ssid(kFakeSsid, kFakeSsid + sizeof(kFakeSsid));
+  vector<uint8_t> ie(kFakeIE, kFakeIE + sizeof(kFakeIE));
+  array<uint8_t, ETH_ALEN> bssid1 = kFakeBssid1;
+  array<uint8_t, ETH_ALEN> bssid2 = kFakeBssid2;
+  vector<RadioChainInfo> radio_chain_infos;
+  radio_chain_infos.emplace_back(kFakeRadioChainId, kFakeRadioChainLevel);
+  vector<RadioChainInfo> no_radio_chain_infos;
+  vector<uint8_t> empty;
+
+  vector<NativeScanResult> scan_results;
+  scan_results.emplace_back(ssid, bssid1, ie, kFakeFrequency, kFakeSignalMbm,
+                            kFakeTsf, kFakeCapability, true,
+                            radio_chain_infos);
+  scan_results.emplace_back(empty, bssid2, empty, kFakeFrequency,
+                            kFakeSignalMbm, kFakeTsf, kFakeCapability, false,
+                            no_radio_chain_infos);
+  return scan_results;
+}
+
+void ExpectEqual(const NativeScanResult& expected,
+                 const NativeScanResult& actual) {
+  EXPECT_EQ(expected.ssid, actual.ssid);
+  EXPECT_EQ(expected.bssid, actual.bssid);
+  EXPECT_EQ(expected.info_element, actual.info_element);
+  EXPECT_EQ(expected.frequency, actual.frequency);
+  EXPECT_EQ(expected.signal_mbm, actual.signal_mbm);
+  EXPECT_EQ(expected.tsf, actual.tsf);
+  EXPECT_EQ(expected.capability, actual.capability);
+  EXPECT_EQ(expected.associated, actual.associated);
+  ASSERT_EQ(expected.radio_chain_infos.size(),
+            actual.radio_chain_infos.size());
+  for (size_t i = 0; i < expected.radio_chain_infos.size(); i++) {
+    EXPECT_EQ(expected.radio_chain_infos[i].chain_id,
+              actual.radio_chain_infos[i].chain_id);
+    EXPECT_EQ(expected.radio_chain_infos[i].level,
+              actual.radio_chain_infos[i].level);
+  }
+}
+
+}  // namespace
+
+TEST(ScanResultsBufferTest, CanWriteAndReadScanResults) {
+  vector<NativeScanResult> scan_results = CreateScanResults();
+  vector<uint8_t> buffer(ScanResultsBuffer::GetSize(scan_results), 0);
+  ScanResultsBuffer::Write(scan_results, buffer.data());
+
+  vector<NativeScanResult> scan_results_copy;
+  EXPECT_TRUE(ScanResultsBuffer::Read(buffer.data(), buffer.size(),
+                                      &scan_results_copy));
+  ASSERT_EQ(scan_results.size(), scan_results_copy.size());
+  for (size_t i = 0; i < scan_results.size(); i++) {
+    ExpectEqual(scan_results[i], scan_results_copy[i]);
+  }
+}
+
+TEST(ScanResultsBufferTest, RejectsTruncatedBuffer) {
+  vector<NativeScanResult> scan_results = CreateScanResults();
+  vector<uint8_t> buffer(ScanResultsBuffer::GetSize(scan_results), 0);
+  ScanResultsBuffer::Write(scan_results, buffer.data());
+
+  vector<NativeScanResult> scan_results_copy;
+  EXPECT_FALSE(ScanResultsBuffer::Read(buffer.data(), buffer.size() - 1,
+                                       &scan_results_copy));
+  EXPECT_FALSE(ScanResultsBuffer::Read(buffer.data(), 8, &scan_results_copy));
+}
+
+TEST(ScanResultsBufferTest, CanCreateSealedSharedMemory) {
+  vector<NativeScanResult> scan_results = CreateScanResults();
+  unique_fd fd = ScanResultsBuffer::CreateSharedMemory(scan_results);
+  ASSERT_GE(fd.get(), 0);
+
+  struct stat memory_stat;
+  ASSERT_EQ(0, fstat(fd.get(), &memory_stat));
+  size_t size = memory_stat.st_size;
+  EXPECT_EQ(ScanResultsBuffer::GetSize(scan_results), size);
+  // Receivers cannot modify the scan results.
+  EXPECT_EQ(MAP_FAILED, mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                             MAP_SHARED, fd.get(), 0));
+
+  void* memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd.get(), 0);
+  ASSERT_NE(MAP_FAILED, memory);
+  vector<NativeScanResult> scan_results_copy;
+  EXPECT_TRUE(ScanResultsBuffer::Read(static_cast<const uint8_t*>(memory),
+                                      size, &scan_results_copy));
+  munmap(memory, size);
+  ASSERT_EQ(scan_results.size(), scan_results_copy.size());
+  ExpectEqual(scan_results[0], scan_results_copy[0]);
+}
+
+}  // namespace wificond
+}  // namespace android
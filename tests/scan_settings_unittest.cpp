@@ -101,6 +101,9 @@ TEST_F(ScanSettingsTest, SingleScanSettingsParcelableTest) {
 
   scan_settings.channel_settings_ = {channel, channel1, channel2};
   scan_settings.hidden_networks_ = {network};
+  scan_settings.enable_split_scan_ = true;
+  scan_settings.enable_channel_hints_ = true;
+  scan_settings.enable_6ghz_rnr_planning_ = true;
 
   Parcel parcel;
   EXPECT_EQ(::android::OK, scan_settings.writeToParcel(&parcel));
@@ -112,6 +115,38 @@ TEST_F(ScanSettingsTest, SingleScanSettingsParcelableTest) {
   EXPECT_EQ(scan_settings, scan_settings_copy);
 }
 
+// Framework versions that do not know about the optional flags after the
+// hidden networks still scan.
+TEST_F(ScanSettingsTest, SingleScanSettingsParcelableReadsLayoutWithoutTail) {
+  Parcel parcel;
+  parcel.writeInt32(IWifiScannerImpl::SCAN_TYPE_LOW_SPAN);
+  parcel.writeInt32(1);
+  // A non-null ChannelSettings.
+  parcel.writeInt32(1);
+  parcel.writeInt32(kFakeFrequency);
+  parcel.writeInt32(1);
+  // A non-null HiddenNetwork.
+  parcel.writeInt32(1);
+  parcel.writeByteVector(
+      vector<uint8_t>(kFakeSsid, kFakeSsid + sizeof(kFakeSsid)));
+
+  SingleScanSettings scan_settings;
+  parcel.setDataPosition(0);
+  ASSERT_EQ(::android::OK, scan_settings.readFromParcel(&parcel));
+  EXPECT_EQ(0u, parcel.dataAvail());
+  EXPECT_EQ(IWifiScannerImpl::SCAN_TYPE_LOW_SPAN, scan_settings.scan_type_);
+  ASSERT_EQ(1u, scan_settings.channel_settings_.size());
+  EXPECT_EQ(kFakeFrequency,
+            static_cast<uint32_t>(
+                scan_settings.channel_settings_[0].frequency_));
+  ASSERT_EQ(1u, scan_settings.hidden_networks_.size());
+  EXPECT_EQ(vector<uint8_t>(kFakeSsid, kFakeSsid + sizeof(kFakeSsid)),
+            scan_settings.hidden_networks_[0].ssid_);
+  EXPECT_FALSE(scan_settings.enable_split_scan_);
+  EXPECT_FALSE(scan_settings.enable_channel_hints_);
+  EXPECT_FALSE(scan_settings.enable_6ghz_rnr_planning_);
+}
+
 TEST_F(ScanSettingsTest, SingleScanSettingsParcelableWriteInvalidScanType) {
   SingleScanSettings scan_settings;
 
@@ -159,11 +194,14 @@ TEST_F(ScanSettingsTest, PnoSettingsParcelableTest) {
   network1.ssid_ =
       vector<uint8_t>(kFakeSsid1, kFakeSsid1 + sizeof(kFakeSsid1));
   network1.is_hidden_ = false;
+  network1.num_connections_ = 3;
+  network1.last_connected_ms_ = 1000;
 
   pno_settings.interval_ms_ = kFakePnoIntervalMs;
   pno_settings.min_2g_rssi_ = kFakePnoMin2gRssi;
   pno_settings.min_5g_rssi_ = kFakePnoMin5gRssi;
   pno_settings.min_6g_rssi_ = kFakePnoMin6gRssi;
+  pno_settings.enable_network_rotation_ = true;
 
   pno_settings.pno_networks_ = {network, network1};
 
@@ -177,6 +215,40 @@ TEST_F(ScanSettingsTest, PnoSettingsParcelableTest) {
   EXPECT_EQ(pno_settings, pno_settings_copy);
 }
 
+// Framework versions that do not know about the optional tail of
+// PnoSettings still start PNO scans.
+TEST_F(ScanSettingsTest, PnoSettingsParcelableReadsLayoutWithoutTail) {
+  Parcel parcel;
+  parcel.writeInt64(kFakePnoIntervalMs);
+  parcel.writeInt32(kFakePnoMin2gRssi);
+  parcel.writeInt32(kFakePnoMin5gRssi);
+  parcel.writeInt32(kFakePnoMin6gRssi);
+  parcel.writeInt32(1);
+  // A non-null PnoNetwork.
+  parcel.writeInt32(1);
+  parcel.writeInt32(1);
+  parcel.writeByteVector(
+      vector<uint8_t>(kFakeSsid, kFakeSsid + sizeof(kFakeSsid)));
+  parcel.writeInt32Vector({static_cast<int32_t>(kFakeFrequency)});
+
+  PnoSettings pno_settings;
+  parcel.setDataPosition(0);
+  ASSERT_EQ(::android::OK, pno_settings.readFromParcel(&parcel));
+  EXPECT_EQ(0u, parcel.dataAvail());
+  EXPECT_EQ(kFakePnoIntervalMs, pno_settings.interval_ms_);
+  EXPECT_EQ(kFakePnoMin6gRssi, pno_settings.min_6g_rssi_);
+  EXPECT_FALSE(pno_settings.enable_network_rotation_);
+  ASSERT_EQ(1u, pno_settings.pno_networks_.size());
+  const PnoNetwork& network = pno_settings.pno_networks_[0];
+  EXPECT_TRUE(network.is_hidden_);
+  EXPECT_EQ(vector<uint8_t>(kFakeSsid, kFakeSsid + sizeof(kFakeSsid)),
+            network.ssid_);
+  EXPECT_EQ(vector<int32_t>{static_cast<int32_t>(kFakeFrequency)},
+            network.frequencies_);
+  EXPECT_EQ(0, network.num_connections_);
+  EXPECT_EQ(0, network.last_connected_ms_);
+}
+
 
 
 }  // namespace wificond
@@ -16,15 +16,20 @@
 
 #include <functional>
 #include <memory>
+#include <sstream>
+#include <string>
 #include <vector>
 
 #include <linux/netlink.h>
 
 #include <gtest/gtest.h>
+#include <utils/Timers.h>
 
 #include "android/net/wifi/nl80211/IWifiScannerImpl.h"
 #include "wificond/net/kernel-header-latest/nl80211.h"
 #include "wificond/scanning/scan_result.h"
+#include "wificond/scanning/scan_result_query.h"
+#include "wificond/scanning/scan_results_delta.h"
 #include "wificond/scanning/scan_utils.h"
 #include "wificond/tests/mock_netlink_manager.h"
 
@@ -38,10 +43,14 @@ using testing::Invoke;
 using testing::NiceMock;
 using testing::Not;
 using testing::Return;
+using testing::SaveArg;
 using testing::_;
 
 using android::net::wifi::nl80211::IWifiScannerImpl;
+using android::net::wifi::nl80211::NativeChannelCongestion;
 using android::net::wifi::nl80211::NativeScanResult;
+using android::net::wifi::nl80211::NativeScanResultsDelta;
+using android::net::wifi::nl80211::ScanResultQuery;
 
 namespace android {
 namespace wificond {
@@ -59,6 +68,21 @@ constexpr bool kFakeUseRandomMAC = true;
 constexpr bool kFakeRequestLowPower = true;
 constexpr bool kFakeRequestSchedScanRelativeRssi = true;
 constexpr int kFakeScanType = IWifiScannerImpl::SCAN_TYPE_LOW_SPAN;
+constexpr uint16_t kFakeFamilyId = 14;
+constexpr uint32_t kFakeFrequency = 2412;
+constexpr uint32_t kFakeFrequency5g = 5180;
+constexpr uint32_t kFakeGeneration = 87;
+constexpr uint64_t kFakeLastSeenNanoSeconds = 123456000;
+constexpr int32_t kFakeSignalMbm = -4500;
+constexpr int32_t kFakeUpdatedSignalMbm = -5000;
+const std::array<uint8_t, ETH_ALEN> kFakeBssid1 =
+    {0x45, 0x54, 0xad, 0x67, 0x98, 0xf6};
+const std::array<uint8_t, ETH_ALEN> kFakeBssid2 =
+    {0x45, 0x54, 0xad, 0x67, 0x98, 0xf7};
+const std::array<uint8_t, ETH_ALEN> kFakeBssid3 =
+    {0x45, 0x54, 0xad, 0x67, 0x98, 0xf8};
+// A single SSID element with SSID "ab".
+const vector<uint8_t> kFakeInformationElements = {0x00, 0x02, 'a', 'b'};
 
 // Currently, control messages are only created by the kernel and sent to us.
 // Therefore NL80211Packet doesn't have corresponding constructor.
@@ -97,6 +121,52 @@ bool AppendMessageAndReturn(
   return mock_return_value;
 }
 
+NL80211Packet CreateScanResult(const std::array<uint8_t, ETH_ALEN>& bssid,
+                               uint64_t last_seen_since_boot_nanoseconds,
+                               int32_t signal_mbm,
+                               uint32_t generation,
+                               uint32_t frequency = kFakeFrequency,
+                               bool associated = false) {
+  NL80211Packet scan_result(
+      kFakeFamilyId,
+      NL80211_CMD_NEW_SCAN_RESULTS,
+      kFakeSequenceNumber,
+      getpid());
+  scan_result.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_GENERATION, generation));
+  scan_result.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, kFakeInterfaceIndex));
+  NL80211NestedAttr bss(NL80211_ATTR_BSS);
+  bss.AddAttribute(NL80211Attr<std::array<uint8_t, ETH_ALEN>>(
+      NL80211_BSS_BSSID, bssid));
+  bss.AddAttribute(NL80211Attr<uint32_t>(NL80211_BSS_FREQUENCY, frequency));
+  bss.AddAttribute(NL80211Attr<vector<uint8_t>>(
+      NL80211_BSS_INFORMATION_ELEMENTS, kFakeInformationElements));
+  bss.AddAttribute(NL80211Attr<uint64_t>(
+      NL80211_BSS_LAST_SEEN_BOOTTIME, last_seen_since_boot_nanoseconds));
+  bss.AddAttribute(NL80211Attr<int32_t>(NL80211_BSS_SIGNAL_MBM, signal_mbm));
+  bss.AddAttribute(NL80211Attr<uint16_t>(NL80211_BSS_CAPABILITY, 0));
+  if (associated) {
+    bss.AddAttribute(NL80211Attr<uint32_t>(NL80211_BSS_STATUS,
+                                           NL80211_BSS_STATUS_ASSOCIATED));
+  }
+  scan_result.AddAttribute(bss);
+  return scan_result;
+}
+
+// Mocks a scan dump that returns |scan_results|.
+std::function<bool(const NL80211Packet&,
+                   std::function<void(const NL80211PacketView&)>)>
+ReplyScanDump(const vector<NL80211Packet>* scan_results) {
+  return [scan_results](const NL80211Packet& request,
+                        std::function<void(const NL80211PacketView&)> handler) {
+    for (const auto& scan_result : *scan_results) {
+      handler(scan_result.GetView());
+    }
+    return true;
+  };
+}
+
 }  // namespace
 
 class ScanUtilsTest : public ::testing::Test {
@@ -104,6 +174,9 @@ class ScanUtilsTest : public ::testing::Test {
   virtual void SetUp() {
     ON_CALL(netlink_manager_,
             SendMessageAndGetResponses(_, _)).WillByDefault(Return(true));
+    ON_CALL(netlink_manager_,
+            SendMessageAndStreamResponses(_, _)).WillByDefault(Return(true));
+    ON_CALL(netlink_manager_, GetFamilyId()).WillByDefault(Return(kFakeFamilyId));
   }
 
   NiceMock<MockNetlinkManager> netlink_manager_;
@@ -134,7 +207,7 @@ TEST_F(ScanUtilsTest, CanGetScanResult) {
   vector<NativeScanResult> scan_results;
   EXPECT_CALL(
       netlink_manager_,
-      SendMessageAndGetResponses(
+      SendMessageAndStreamResponses(
           DoesNL80211PacketMatchCommand(NL80211_CMD_GET_SCAN), _));
 
   // We don't use EXPECT_TRUE here because we need to mock a complete
@@ -145,6 +218,667 @@ TEST_F(ScanUtilsTest, CanGetScanResult) {
   scan_utils_.GetScanResult(kFakeInterfaceIndex, &scan_results);
 }
 
+TEST_F(ScanUtilsTest, CanSkipUninterestingScanResultsWhileStreaming) {
+  vector<NativeScanResult> scan_results;
+  NL80211Packet error = CreateControlMessageError(kFakeErrorCode);
+  NL80211Packet other_interface_result(
+      netlink_manager_.GetFamilyId(),
+      NL80211_CMD_NEW_SCAN_RESULTS,
+      kFakeSequenceNumber,
+      getpid());
+  other_interface_result.AddAttribute(
+      NL80211Attr<uint32_t>(NL80211_ATTR_IFINDEX, kFakeInterfaceIndex + 1));
+  EXPECT_CALL(
+      netlink_manager_,
+      SendMessageAndStreamResponses(
+          DoesNL80211PacketMatchCommand(NL80211_CMD_GET_SCAN), _)).
+      WillOnce(Invoke([&](const NL80211Packet& request,
+                          std::function<void(const NL80211PacketView&)> handler) {
+        handler(error.GetView());
+        handler(other_interface_result.GetView());
+        return true;
+      }));
+  EXPECT_TRUE(scan_utils_.GetScanResult(kFakeInterfaceIndex, &scan_results));
+  EXPECT_TRUE(scan_results.empty());
+}
+
+TEST_F(ScanUtilsTest, TrustsKernelFilteredScanDump) {
+  // The interface index of the result is not checked again once kernel
+  // reports that it filtered the dump.
+  vector<NL80211Packet> dump = {
+      CreateScanResult(kFakeBssid1, kFakeLastSeenNanoSeconds, kFakeSignalMbm,
+                       kFakeGeneration)};
+  dump[0].AddFlag(NLM_F_MULTI | NLM_F_DUMP_FILTERED);
+  EXPECT_CALL(netlink_manager_, SendMessageAndStreamResponses(_, _)).
+      WillOnce(Invoke(ReplyScanDump(&dump)));
+  vector<NativeScanResult> scan_results;
+  EXPECT_TRUE(scan_utils_.GetScanResult(kFakeInterfaceIndex + 1,
+                                        &scan_results));
+  ASSERT_EQ(1u, scan_results.size());
+  EXPECT_EQ(kFakeBssid1, scan_results[0].bssid);
+}
+
+TEST_F(ScanUtilsTest, CachesScanResultsUntilScanResultNotification) {
+  OnScanResultsReadyHandler notification_handler;
+  EXPECT_CALL(netlink_manager_,
+              SubscribeScanResultNotification(kFakeInterfaceIndex, _)).
+      WillOnce(SaveArg<1>(&notification_handler));
+  scan_utils_.SubscribeScanResultNotification(
+      kFakeInterfaceIndex,
+      [](uint32_t, bool, vector<vector<uint8_t>>&, vector<uint32_t>&) {});
+
+  vector<NL80211Packet> dump = {
+      CreateScanResult(kFakeBssid1, kFakeLastSeenNanoSeconds, kFakeSignalMbm,
+                       kFakeGeneration)};
+  EXPECT_CALL(netlink_manager_, SendMessageAndStreamResponses(_, _)).
+      WillOnce(Invoke(ReplyScanDump(&dump)));
+  vector<NativeScanResult> scan_results;
+  EXPECT_TRUE(scan_utils_.GetScanResult(kFakeInterfaceIndex, &scan_results));
+  ASSERT_EQ(1u, scan_results.size());
+  EXPECT_EQ(kFakeBssid1, scan_results[0].bssid);
+
+  // Kernel is not queried again until new scan results are available.
+  scan_results.clear();
+  EXPECT_TRUE(scan_utils_.GetScanResult(kFakeInterfaceIndex, &scan_results));
+  ASSERT_EQ(1u, scan_results.size());
+  EXPECT_EQ(kFakeBssid1, scan_results[0].bssid);
+
+  vector<vector<uint8_t>> ssids;
+  vector<uint32_t> frequencies;
+  notification_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+  dump.clear();
+  dump.push_back(CreateScanResult(kFakeBssid1, kFakeLastSeenNanoSeconds,
+                                  kFakeSignalMbm, kFakeGeneration + 1));
+  dump.push_back(CreateScanResult(kFakeBssid2, kFakeLastSeenNanoSeconds,
+                                  kFakeSignalMbm, kFakeGeneration + 1));
+  EXPECT_CALL(netlink_manager_, SendMessageAndStreamResponses(_, _)).
+      WillOnce(Invoke(ReplyScanDump(&dump)));
+  scan_results.clear();
+  EXPECT_TRUE(scan_utils_.GetScanResult(kFakeInterfaceIndex, &scan_results));
+  EXPECT_EQ(2u, scan_results.size());
+}
+
+TEST_F(ScanUtilsTest, CanUpdateScanResultCacheAheadOfTime) {
+  OnSchedScanResultsReadyHandler notification_handler;
+  EXPECT_CALL(netlink_manager_,
+              SubscribeSchedScanResultNotification(kFakeInterfaceIndex, _)).
+      WillOnce(SaveArg<1>(&notification_handler));
+  scan_utils_.SubscribeSchedScanResultNotification(
+      kFakeInterfaceIndex, [](uint32_t, bool) {});
+  notification_handler(kFakeInterfaceIndex, false);
+  EXPECT_FALSE(scan_utils_.HasUpToDateScanResults(kFakeInterfaceIndex));
+
+  vector<NL80211Packet> dump = {
+      CreateScanResult(kFakeBssid1, kFakeLastSeenNanoSeconds, kFakeSignalMbm,
+                       kFakeGeneration)};
+  EXPECT_CALL(netlink_manager_, SendMessageAndStreamResponses(_, _)).
+      WillOnce(Invoke(ReplyScanDump(&dump)));
+  EXPECT_TRUE(scan_utils_.UpdateScanResultCache(kFakeInterfaceIndex));
+  EXPECT_TRUE(scan_utils_.HasUpToDateScanResults(kFakeInterfaceIndex));
+
+  // The results are served from the cache.
+  vector<NativeScanResult> scan_results;
+  EXPECT_TRUE(scan_utils_.GetScanResult(kFakeInterfaceIndex, &scan_results));
+  ASSERT_EQ(1u, scan_results.size());
+  EXPECT_EQ(kFakeBssid1, scan_results[0].bssid);
+}
+
+TEST_F(ScanUtilsTest, ReusesScanResultsWhenGenerationIsUnchanged) {
+  vector<NL80211Packet> dump = {
+      CreateScanResult(kFakeBssid1, kFakeLastSeenNanoSeconds, kFakeSignalMbm,
+                       kFakeGeneration)};
+  vector<NL80211Packet> unchanged_dump = {
+      CreateScanResult(kFakeBssid1, kFakeLastSeenNanoSeconds + 1,
+                       kFakeUpdatedSignalMbm, kFakeGeneration)};
+  EXPECT_CALL(netlink_manager_, SendMessageAndStreamResponses(_, _)).
+      WillOnce(Invoke(ReplyScanDump(&dump))).
+      WillOnce(Invoke(ReplyScanDump(&unchanged_dump))).
+      WillOnce(Invoke(ReplyScanDump(&unchanged_dump)));
+  vector<NativeScanResult> scan_results;
+  EXPECT_TRUE(scan_utils_.GetScanResult(kFakeInterfaceIndex, &scan_results));
+
+  // The dump is not parsed because kernel reports the same generation.
+  // This is only done after scan result notifications.
+  OnScanResultsReadyHandler notification_handler;
+  EXPECT_CALL(netlink_manager_,
+              SubscribeScanResultNotification(kFakeInterfaceIndex, _)).
+      WillOnce(SaveArg<1>(&notification_handler));
+  scan_utils_.SubscribeScanResultNotification(
+      kFakeInterfaceIndex,
+      [](uint32_t, bool, vector<vector<uint8_t>>&, vector<uint32_t>&) {});
+  vector<vector<uint8_t>> ssids;
+  vector<uint32_t> frequencies;
+  notification_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+  scan_results.clear();
+  EXPECT_TRUE(scan_utils_.GetScanResult(kFakeInterfaceIndex, &scan_results));
+  ASSERT_EQ(1u, scan_results.size());
+  EXPECT_EQ(kFakeSignalMbm, scan_results[0].signal_mbm);
+
+  // An explicit invalidation makes it parse updated BSSs again.
+  scan_utils_.InvalidateScanResultCache(kFakeInterfaceIndex);
+  scan_results.clear();
+  EXPECT_TRUE(scan_utils_.GetScanResult(kFakeInterfaceIndex, &scan_results));
+  ASSERT_EQ(1u, scan_results.size());
+  EXPECT_EQ(kFakeUpdatedSignalMbm, scan_results[0].signal_mbm);
+}
+
+TEST_F(ScanUtilsTest, ReparsesOnlyUpdatedBss) {
+  vector<NL80211Packet> dump = {
+      CreateScanResult(kFakeBssid1, kFakeLastSeenNanoSeconds, kFakeSignalMbm,
+                       kFakeGeneration),
+      CreateScanResult(kFakeBssid2, kFakeLastSeenNanoSeconds, kFakeSignalMbm,
+                       kFakeGeneration)};
+  // The BSS with an unchanged timestamp still carries the old signal
+  // strength, so that reuse of the cached result can be observed.
+  vector<NL80211Packet> updated_dump = {
+      CreateScanResult(kFakeBssid1, kFakeLastSeenNanoSeconds,
+                       kFakeUpdatedSignalMbm, kFakeGeneration + 1),
+      CreateScanResult(kFakeBssid2, kFakeLastSeenNanoSeconds + 1,
+                       kFakeUpdatedSignalMbm, kFakeGeneration + 1)};
+  EXPECT_CALL(netlink_manager_, SendMessageAndStreamResponses(_, _)).
+      WillOnce(Invoke(ReplyScanDump(&dump))).
+      WillOnce(Invoke(ReplyScanDump(&updated_dump)));
+  vector<NativeScanResult> scan_results;
+  EXPECT_TRUE(scan_utils_.GetScanResult(kFakeInterfaceIndex, &scan_results));
+
+  scan_utils_.InvalidateScanResultCache(kFakeInterfaceIndex);
+  scan_results.clear();
+  EXPECT_TRUE(scan_utils_.GetScanResult(kFakeInterfaceIndex, &scan_results));
+  ASSERT_EQ(2u, scan_results.size());
+  EXPECT_EQ(kFakeBssid1, scan_results[0].bssid);
+  EXPECT_EQ(kFakeSignalMbm, scan_results[0].signal_mbm);
+  EXPECT_EQ(kFakeBssid2, scan_results[1].bssid);
+  EXPECT_EQ(kFakeUpdatedSignalMbm, scan_results[1].signal_mbm);
+}
+
+TEST_F(ScanUtilsTest, MergesScanResultsOfPeerRadios) {
+  constexpr uint32_t kFakePeerInterfaceIndex = kFakeInterfaceIndex + 1;
+  vector<NL80211Packet> dump = {
+      CreateScanResult(kFakeBssid1, kFakeLastSeenNanoSeconds, kFakeSignalMbm,
+                       kFakeGeneration)};
+  // The peer radio found the same BSS, and the BSS it is associated with.
+  vector<NL80211Packet> peer_dump = {
+      CreateScanResult(kFakeBssid1, kFakeLastSeenNanoSeconds,
+                       kFakeUpdatedSignalMbm, kFakeGeneration),
+      CreateScanResult(kFakeBssid2, kFakeLastSeenNanoSeconds, kFakeSignalMbm,
+                       kFakeGeneration, kFakeFrequency5g, true)};
+  for (NL80211Packet& packet : peer_dump) {
+    packet.AddFlag(NLM_F_MULTI | NLM_F_DUMP_FILTERED);
+  }
+  EXPECT_CALL(netlink_manager_, SendMessageAndStreamResponses(
+      DoesNL80211PacketHaveAttributeWithUint32Value(
+          NL80211_ATTR_IFINDEX, kFakeInterfaceIndex), _)).
+      WillOnce(Invoke(ReplyScanDump(&dump)));
+  EXPECT_CALL(netlink_manager_, SendMessageAndStreamResponses(
+      DoesNL80211PacketHaveAttributeWithUint32Value(
+          NL80211_ATTR_IFINDEX, kFakePeerInterfaceIndex), _)).
+      WillOnce(Invoke(ReplyScanDump(&peer_dump)));
+  scan_utils_.SetPeerRadioInterfaces(kFakeInterfaceIndex,
+                                     {kFakePeerInterfaceIndex});
+
+  vector<NativeScanResult> scan_results;
+  EXPECT_TRUE(scan_utils_.GetScanResult(kFakeInterfaceIndex, &scan_results));
+  ASSERT_EQ(2u, scan_results.size());
+  EXPECT_EQ(kFakeBssid1, scan_results[0].bssid);
+  EXPECT_EQ(kFakeSignalMbm, scan_results[0].signal_mbm);
+  EXPECT_EQ(kFakeBssid2, scan_results[1].bssid);
+  EXPECT_FALSE(scan_results[1].associated);
+}
+
+TEST_F(ScanUtilsTest, ParsesLargeScanDumpOnWorkerThreads) {
+  // Spans a few full batches and a partial one.
+  constexpr size_t kNumBss = 300;
+  vector<NL80211Packet> dump;
+  for (size_t i = 0; i < kNumBss; i++) {
+    std::array<uint8_t, ETH_ALEN> bssid = kFakeBssid1;
+    bssid[4] = static_cast<uint8_t>(i >> 8);
+    bssid[5] = static_cast<uint8_t>(i);
+    dump.push_back(CreateScanResult(bssid, kFakeLastSeenNanoSeconds + i,
+                                    kFakeSignalMbm, kFakeGeneration));
+  }
+  EXPECT_CALL(netlink_manager_, SendMessageAndStreamResponses(_, _)).
+      WillOnce(Invoke(ReplyScanDump(&dump)));
+  scan_utils_.SetNumParseThreads(2);
+
+  vector<NativeScanResult> scan_results;
+  EXPECT_TRUE(scan_utils_.GetScanResult(kFakeInterfaceIndex, &scan_results));
+  ASSERT_EQ(kNumBss, scan_results.size());
+  // Results keep the order of the dump.
+  for (size_t i = 0; i < kNumBss; i++) {
+    EXPECT_EQ(static_cast<uint8_t>(i), scan_results[i].bssid[5]);
+  }
+}
+
+TEST_F(ScanUtilsTest, RemembersChannelsOfScanResults) {
+  vector<NL80211Packet> dump = {
+      CreateScanResult(kFakeBssid1, kFakeLastSeenNanoSeconds, kFakeSignalMbm,
+                       kFakeGeneration),
+      CreateScanResult(kFakeBssid2, kFakeLastSeenNanoSeconds, kFakeSignalMbm,
+                       kFakeGeneration, kFakeFrequency5g)};
+  EXPECT_CALL(netlink_manager_, SendMessageAndStreamResponses(_, _)).
+      WillOnce(Invoke(ReplyScanDump(&dump)));
+  vector<uint8_t> ssid = {'a', 'b'};
+  vector<uint32_t> frequencies;
+  EXPECT_FALSE(scan_utils_.GetChannelHistory(ssid, &frequencies));
+
+  vector<NativeScanResult> scan_results;
+  EXPECT_TRUE(scan_utils_.GetScanResult(kFakeInterfaceIndex, &scan_results));
+  ASSERT_TRUE(scan_utils_.GetChannelHistory(ssid, &frequencies));
+  EXPECT_EQ((vector<uint32_t>{kFakeFrequency5g, kFakeFrequency}),
+            frequencies);
+}
+
+TEST_F(ScanUtilsTest, CanCountScanResultsByBand) {
+  vector<NL80211Packet> dump = {
+      CreateScanResult(kFakeBssid1, kFakeLastSeenNanoSeconds, kFakeSignalMbm,
+                       kFakeGeneration),
+      CreateScanResult(kFakeBssid2, kFakeLastSeenNanoSeconds, kFakeSignalMbm,
+                       kFakeGeneration, kFakeFrequency5g)};
+  EXPECT_CALL(netlink_manager_, SendMessageAndStreamResponses(_, _)).
+      WillOnce(Invoke(ReplyScanDump(&dump)));
+  EXPECT_EQ(0u, scan_utils_.GetNumScanResults(
+      kFakeInterfaceIndex, IWifiScannerImpl::SCAN_RESULT_BAND_2G));
+
+  ASSERT_TRUE(scan_utils_.UpdateScanResultCache(kFakeInterfaceIndex));
+  EXPECT_EQ(1u, scan_utils_.GetNumScanResults(
+      kFakeInterfaceIndex, IWifiScannerImpl::SCAN_RESULT_BAND_2G));
+  EXPECT_EQ(1u, scan_utils_.GetNumScanResults(
+      kFakeInterfaceIndex, IWifiScannerImpl::SCAN_RESULT_BAND_5G));
+  EXPECT_EQ(0u, scan_utils_.GetNumScanResults(
+      kFakeInterfaceIndex, IWifiScannerImpl::SCAN_RESULT_BAND_6G));
+}
+
+TEST_F(ScanUtilsTest, CanGetChannelCongestion) {
+  vector<NL80211Packet> dump = {
+      CreateScanResult(kFakeBssid1, kFakeLastSeenNanoSeconds, kFakeSignalMbm,
+                       kFakeGeneration),
+      CreateScanResult(kFakeBssid2, kFakeLastSeenNanoSeconds, kFakeSignalMbm,
+                       kFakeGeneration, kFakeFrequency5g)};
+  EXPECT_CALL(netlink_manager_, SendMessageAndStreamResponses(_, _)).
+      WillOnce(Invoke(ReplyScanDump(&dump)));
+
+  vector<NativeChannelCongestion> channels;
+  ASSERT_TRUE(scan_utils_.GetChannelCongestion(kFakeInterfaceIndex,
+                                               &channels));
+  ASSERT_EQ(2u, channels.size());
+  EXPECT_LT(channels[0].frequency_, channels[1].frequency_);
+  EXPECT_EQ(1, channels[0].num_bss_);
+  EXPECT_EQ(1, channels[1].num_bss_);
+}
+
+TEST_F(ScanUtilsTest, CanGetScanResultDelta) {
+  vector<NL80211Packet> dump;
+  dump.push_back(CreateScanResult(kFakeBssid1, kFakeLastSeenNanoSeconds,
+                                  kFakeSignalMbm, kFakeGeneration));
+  EXPECT_CALL(netlink_manager_, SendMessageAndStreamResponses(_, _)).
+      WillRepeatedly(Invoke(ReplyScanDump(&dump)));
+
+  NativeScanResultsDelta full_delta;
+  EXPECT_TRUE(scan_utils_.GetScanResultDelta(kFakeInterfaceIndex, 0,
+                                             &full_delta));
+  EXPECT_TRUE(full_delta.is_full);
+  ASSERT_EQ(1u, full_delta.updated_scan_results.size());
+  EXPECT_EQ(kFakeBssid1, full_delta.updated_scan_results[0].bssid);
+
+  // Nothing changed.
+  NativeScanResultsDelta empty_delta;
+  EXPECT_TRUE(scan_utils_.GetScanResultDelta(
+      kFakeInterfaceIndex, full_delta.generation, &empty_delta));
+  EXPECT_FALSE(empty_delta.is_full);
+  EXPECT_EQ(full_delta.generation, empty_delta.generation);
+  EXPECT_TRUE(empty_delta.updated_scan_results.empty());
+  EXPECT_TRUE(empty_delta.removed_bssids.empty());
+
+  // |kFakeBssid1| expired and |kFakeBssid2| showed up.
+  dump.clear();
+  dump.push_back(CreateScanResult(kFakeBssid2, kFakeLastSeenNanoSeconds,
+                                  kFakeSignalMbm, kFakeGeneration + 1));
+  scan_utils_.InvalidateScanResultCache(kFakeInterfaceIndex);
+  NativeScanResultsDelta delta;
+  EXPECT_TRUE(scan_utils_.GetScanResultDelta(
+      kFakeInterfaceIndex, full_delta.generation, &delta));
+  EXPECT_FALSE(delta.is_full);
+  EXPECT_GT(delta.generation, full_delta.generation);
+  ASSERT_EQ(1u, delta.updated_scan_results.size());
+  EXPECT_EQ(kFakeBssid2, delta.updated_scan_results[0].bssid);
+  ASSERT_EQ(1u, delta.removed_bssids.size());
+  EXPECT_EQ(kFakeBssid1, delta.removed_bssids[0]);
+  ASSERT_EQ(1u, delta.removed_frequencies.size());
+  EXPECT_EQ(kFakeFrequency, delta.removed_frequencies[0]);
+}
+
+TEST_F(ScanUtilsTest, GetsFullScanResultDeltaForUnknownGeneration) {
+  vector<NL80211Packet> dump;
+  dump.push_back(CreateScanResult(kFakeBssid1, kFakeLastSeenNanoSeconds,
+                                  kFakeSignalMbm, kFakeGeneration));
+  EXPECT_CALL(netlink_manager_, SendMessageAndStreamResponses(_, _)).
+      WillRepeatedly(Invoke(ReplyScanDump(&dump)));
+  NativeScanResultsDelta delta;
+  EXPECT_TRUE(scan_utils_.GetScanResultDelta(kFakeInterfaceIndex, 0, &delta));
+
+  // A generation from the future, e.g. from before a restart.
+  NativeScanResultsDelta future_delta;
+  EXPECT_TRUE(scan_utils_.GetScanResultDelta(
+      kFakeInterfaceIndex, delta.generation + 1, &future_delta));
+  EXPECT_TRUE(future_delta.is_full);
+  EXPECT_EQ(1u, future_delta.updated_scan_results.size());
+}
+
+TEST_F(ScanUtilsTest, CanTrimScanResultCache) {
+  vector<NL80211Packet> dump;
+  dump.push_back(CreateScanResult(kFakeBssid1, kFakeLastSeenNanoSeconds,
+                                  kFakeSignalMbm, kFakeGeneration));
+  EXPECT_CALL(netlink_manager_, SendMessageAndStreamResponses(_, _)).
+      WillRepeatedly(Invoke(ReplyScanDump(&dump)));
+  NativeScanResultsDelta delta;
+  EXPECT_TRUE(scan_utils_.GetScanResultDelta(kFakeInterfaceIndex, 0, &delta));
+
+  vector<MemoryAccount> accounts;
+  scan_utils_.GetMemoryAccounts(&accounts);
+  ASSERT_EQ(1u, accounts.size());
+  EXPECT_GT(accounts[0].GetCurrent(), 0u);
+  const size_t peak = accounts[0].GetPeak();
+
+  scan_utils_.TrimScanResultCache();
+  accounts.clear();
+  scan_utils_.GetMemoryAccounts(&accounts);
+  ASSERT_EQ(1u, accounts.size());
+  EXPECT_EQ(0u, accounts[0].GetCurrent());
+  EXPECT_EQ(peak, accounts[0].GetPeak());
+
+  // The scan results are dumped again, and reported in full.
+  NativeScanResultsDelta full_delta;
+  EXPECT_TRUE(scan_utils_.GetScanResultDelta(
+      kFakeInterfaceIndex, delta.generation, &full_delta));
+  EXPECT_TRUE(full_delta.is_full);
+  EXPECT_EQ(1u, full_delta.updated_scan_results.size());
+}
+
+TEST_F(ScanUtilsTest, EvictsLeastRecentlySeenBssOnceCacheIsFull) {
+  scan_utils_.SetScanResultCacheCapacity(2);
+  // The associated BSS is kept although it was seen least recently.
+  vector<NL80211Packet> dump = {
+      CreateScanResult(kFakeBssid1, kFakeLastSeenNanoSeconds, kFakeSignalMbm,
+                       kFakeGeneration, kFakeFrequency, true),
+      CreateScanResult(kFakeBssid2, kFakeLastSeenNanoSeconds + 1000,
+                       kFakeSignalMbm, kFakeGeneration),
+      CreateScanResult(kFakeBssid3, kFakeLastSeenNanoSeconds + 2000,
+                       kFakeSignalMbm, kFakeGeneration)};
+  EXPECT_CALL(netlink_manager_, SendMessageAndStreamResponses(_, _)).
+      WillRepeatedly(Invoke(ReplyScanDump(&dump)));
+  NativeScanResultsDelta full_delta;
+  EXPECT_TRUE(scan_utils_.GetScanResultDelta(kFakeInterfaceIndex, 0,
+                                             &full_delta));
+  ASSERT_EQ(2u, full_delta.updated_scan_results.size());
+  EXPECT_EQ(kFakeBssid1, full_delta.updated_scan_results[0].bssid);
+  EXPECT_EQ(kFakeBssid3, full_delta.updated_scan_results[1].bssid);
+
+  // |kFakeBssid2| is seen again and evicts |kFakeBssid3|, which is reported
+  // as expired.
+  dump.clear();
+  dump.push_back(CreateScanResult(kFakeBssid1, kFakeLastSeenNanoSeconds,
+                                  kFakeSignalMbm, kFakeGeneration + 1,
+                                  kFakeFrequency, true));
+  dump.push_back(CreateScanResult(kFakeBssid2, kFakeLastSeenNanoSeconds + 3000,
+                                  kFakeSignalMbm, kFakeGeneration + 1));
+  dump.push_back(CreateScanResult(kFakeBssid3, kFakeLastSeenNanoSeconds + 2000,
+                                  kFakeSignalMbm, kFakeGeneration + 1));
+  scan_utils_.InvalidateScanResultCache(kFakeInterfaceIndex);
+  NativeScanResultsDelta delta;
+  EXPECT_TRUE(scan_utils_.GetScanResultDelta(
+      kFakeInterfaceIndex, full_delta.generation, &delta));
+  EXPECT_FALSE(delta.is_full);
+  ASSERT_EQ(1u, delta.updated_scan_results.size());
+  EXPECT_EQ(kFakeBssid2, delta.updated_scan_results[0].bssid);
+  ASSERT_EQ(1u, delta.removed_bssids.size());
+  EXPECT_EQ(kFakeBssid3, delta.removed_bssids[0]);
+
+  std::stringstream ss;
+  scan_utils_.DumpScanResultCache(&ss);
+  EXPECT_NE(std::string::npos, ss.str().find("2 BSSs evicted"));
+}
+
+TEST_F(ScanUtilsTest, CanQueryScanResultsWithoutParsingAllFields) {
+  vector<NL80211Packet> dump;
+  dump.push_back(CreateScanResult(kFakeBssid1, kFakeLastSeenNanoSeconds,
+                                  kFakeSignalMbm, kFakeGeneration,
+                                  kFakeFrequency, true));
+  dump.push_back(CreateScanResult(kFakeBssid2, kFakeLastSeenNanoSeconds,
+                                  kFakeSignalMbm, kFakeGeneration,
+                                  kFakeFrequency5g, false));
+  // The query does not fill the scan result cache.
+  EXPECT_CALL(netlink_manager_, SendMessageAndStreamResponses(_, _)).
+      Times(2).
+      WillRepeatedly(Invoke(ReplyScanDump(&dump)));
+
+  ScanResultQuery query;
+  query.associated_only = true;
+  vector<NativeScanResult> scan_results;
+  EXPECT_TRUE(scan_utils_.QueryScanResults(kFakeInterfaceIndex, query,
+                                           &scan_results));
+  ASSERT_EQ(1u, scan_results.size());
+  EXPECT_EQ(kFakeBssid1, scan_results[0].bssid);
+  EXPECT_EQ(kFakeFrequency, scan_results[0].frequency);
+  EXPECT_TRUE(scan_results[0].associated);
+  EXPECT_TRUE(scan_results[0].ssid.empty());
+  EXPECT_TRUE(scan_results[0].info_element.empty());
+
+  scan_results.clear();
+  EXPECT_TRUE(scan_utils_.GetScanResult(kFakeInterfaceIndex, &scan_results));
+  EXPECT_EQ(2u, scan_results.size());
+}
+
+TEST_F(ScanUtilsTest, CanQueryInfoElementIndex) {
+  vector<NL80211Packet> dump;
+  dump.push_back(CreateScanResult(kFakeBssid1, kFakeLastSeenNanoSeconds,
+                                  kFakeSignalMbm, kFakeGeneration));
+  EXPECT_CALL(netlink_manager_, SendMessageAndStreamResponses(_, _)).
+      WillOnce(Invoke(ReplyScanDump(&dump)));
+
+  ScanResultQuery query;
+  query.fields = IWifiScannerImpl::SCAN_RESULT_FIELD_SSID |
+                 IWifiScannerImpl::SCAN_RESULT_FIELD_IE_INDEX;
+  vector<NativeScanResult> scan_results;
+  EXPECT_TRUE(scan_utils_.QueryScanResults(kFakeInterfaceIndex, query,
+                                           &scan_results));
+  ASSERT_EQ(1u, scan_results.size());
+  EXPECT_EQ(vector<uint8_t>({'a', 'b'}), scan_results[0].ssid);
+  ASSERT_EQ(1u, scan_results[0].info_element_index.size());
+  EXPECT_EQ(0, scan_results[0].info_element_index[0].id);
+  EXPECT_EQ(2, scan_results[0].info_element_index[0].offset);
+  EXPECT_EQ(2, scan_results[0].info_element_index[0].length);
+  EXPECT_EQ(0, scan_results[0].security);
+  EXPECT_EQ(IWifiScannerImpl::SCAN_RESULT_WIFI_STANDARD_LEGACY,
+            scan_results[0].wifi_standard);
+}
+
+TEST_F(ScanUtilsTest, CanQueryScanResultsFromCache) {
+  vector<NL80211Packet> dump;
+  dump.push_back(CreateScanResult(kFakeBssid1, kFakeLastSeenNanoSeconds,
+                                  kFakeSignalMbm, kFakeGeneration,
+                                  kFakeFrequency, true));
+  dump.push_back(CreateScanResult(kFakeBssid2, kFakeLastSeenNanoSeconds,
+                                  kFakeSignalMbm, kFakeGeneration,
+                                  kFakeFrequency5g, false));
+  EXPECT_CALL(netlink_manager_, SendMessageAndStreamResponses(_, _)).
+      WillOnce(Invoke(ReplyScanDump(&dump)));
+  vector<NativeScanResult> scan_results;
+  EXPECT_TRUE(scan_utils_.GetScanResult(kFakeInterfaceIndex, &scan_results));
+
+  ScanResultQuery query;
+  query.fields = IWifiScannerImpl::SCAN_RESULT_FIELD_SSID;
+  query.bands = IWifiScannerImpl::SCAN_RESULT_BAND_5G;
+  query.ssid = {'a', 'b'};
+  scan_results.clear();
+  EXPECT_TRUE(scan_utils_.QueryScanResults(kFakeInterfaceIndex, query,
+                                           &scan_results));
+  ASSERT_EQ(1u, scan_results.size());
+  EXPECT_EQ(kFakeBssid2, scan_results[0].bssid);
+  EXPECT_EQ(query.ssid, scan_results[0].ssid);
+  EXPECT_TRUE(scan_results[0].info_element.empty());
+
+  query.min_signal_mbm = kFakeSignalMbm + 1;
+  scan_results.clear();
+  EXPECT_TRUE(scan_utils_.QueryScanResults(kFakeInterfaceIndex, query,
+                                           &scan_results));
+  EXPECT_TRUE(scan_results.empty());
+}
+
+TEST_F(ScanUtilsTest, CanQueryScanResultsOfSsidsExcludingBssids) {
+  vector<NL80211Packet> dump;
+  dump.push_back(CreateScanResult(kFakeBssid1, kFakeLastSeenNanoSeconds,
+                                  kFakeSignalMbm, kFakeGeneration));
+  dump.push_back(CreateScanResult(kFakeBssid2, kFakeLastSeenNanoSeconds,
+                                  kFakeSignalMbm, kFakeGeneration));
+  EXPECT_CALL(netlink_manager_, SendMessageAndStreamResponses(_, _)).
+      WillRepeatedly(Invoke(ReplyScanDump(&dump)));
+
+  ScanResultQuery query;
+  query.ssids = {{'x'}, {'a', 'b'}};
+  query.excluded_bssids = {
+      vector<uint8_t>(kFakeBssid1.begin(), kFakeBssid1.end())};
+  // Without a cache, BSSs are matched while streaming.
+  vector<NativeScanResult> scan_results;
+  EXPECT_TRUE(scan_utils_.QueryScanResults(kFakeInterfaceIndex, query,
+                                           &scan_results));
+  ASSERT_EQ(1u, scan_results.size());
+  EXPECT_EQ(kFakeBssid2, scan_results[0].bssid);
+  // SSIDs are only matched, not returned.
+  EXPECT_TRUE(scan_results[0].ssid.empty());
+
+  scan_results.clear();
+  EXPECT_TRUE(scan_utils_.GetScanResult(kFakeInterfaceIndex, &scan_results));
+  scan_results.clear();
+  EXPECT_TRUE(scan_utils_.QueryScanResults(kFakeInterfaceIndex, query,
+                                           &scan_results));
+  ASSERT_EQ(1u, scan_results.size());
+  EXPECT_EQ(kFakeBssid2, scan_results[0].bssid);
+
+  query.ssids = {{'x'}};
+  scan_results.clear();
+  EXPECT_TRUE(scan_utils_.QueryScanResults(kFakeInterfaceIndex, query,
+                                           &scan_results));
+  EXPECT_TRUE(scan_results.empty());
+}
+
+TEST_F(ScanUtilsTest, CanQueryStrongestScanResults) {
+  vector<NL80211Packet> dump;
+  dump.push_back(CreateScanResult(kFakeBssid1, kFakeLastSeenNanoSeconds,
+                                  kFakeUpdatedSignalMbm, kFakeGeneration));
+  dump.push_back(CreateScanResult(kFakeBssid2, kFakeLastSeenNanoSeconds,
+                                  kFakeSignalMbm, kFakeGeneration));
+  EXPECT_CALL(netlink_manager_, SendMessageAndStreamResponses(_, _)).
+      WillOnce(Invoke(ReplyScanDump(&dump)));
+
+  ScanResultQuery query;
+  query.max_results = 1;
+  // Without a cache, results are picked while streaming.
+  vector<NativeScanResult> scan_results;
+  EXPECT_TRUE(scan_utils_.QueryScanResults(kFakeInterfaceIndex, query,
+                                           &scan_results));
+  ASSERT_EQ(1u, scan_results.size());
+  EXPECT_EQ(kFakeBssid2, scan_results[0].bssid);
+
+  scan_results.clear();
+  EXPECT_CALL(netlink_manager_, SendMessageAndStreamResponses(_, _)).
+      WillOnce(Invoke(ReplyScanDump(&dump)));
+  EXPECT_TRUE(scan_utils_.GetScanResult(kFakeInterfaceIndex, &scan_results));
+
+  // From the cache.
+  query.max_results = 2;
+  scan_results.clear();
+  EXPECT_TRUE(scan_utils_.QueryScanResults(kFakeInterfaceIndex, query,
+                                           &scan_results));
+  ASSERT_EQ(2u, scan_results.size());
+  EXPECT_EQ(kFakeBssid2, scan_results[0].bssid);
+  EXPECT_EQ(kFakeBssid1, scan_results[1].bssid);
+}
+
+TEST_F(ScanUtilsTest, CanQueryStrongestScanResultsPerSsidAndBand) {
+  vector<NL80211Packet> dump;
+  dump.push_back(CreateScanResult(kFakeBssid1, kFakeLastSeenNanoSeconds,
+                                  kFakeUpdatedSignalMbm, kFakeGeneration));
+  dump.push_back(CreateScanResult(kFakeBssid2, kFakeLastSeenNanoSeconds,
+                                  kFakeSignalMbm, kFakeGeneration));
+  dump.push_back(CreateScanResult(kFakeBssid3, kFakeLastSeenNanoSeconds,
+                                  kFakeUpdatedSignalMbm - 100,
+                                  kFakeGeneration, kFakeFrequency5g));
+  EXPECT_CALL(netlink_manager_, SendMessageAndStreamResponses(_, _)).
+      WillOnce(Invoke(ReplyScanDump(&dump)));
+
+  // All BSSs have the same SSID, which is only parsed for the cap.
+  ScanResultQuery query;
+  query.max_results_per_ssid = 1;
+  vector<NativeScanResult> scan_results;
+  EXPECT_TRUE(scan_utils_.QueryScanResults(kFakeInterfaceIndex, query,
+                                           &scan_results));
+  ASSERT_EQ(1u, scan_results.size());
+  EXPECT_EQ(kFakeBssid2, scan_results[0].bssid);
+  EXPECT_TRUE(scan_results[0].ssid.empty());
+
+  scan_results.clear();
+  EXPECT_CALL(netlink_manager_, SendMessageAndStreamResponses(_, _)).
+      WillOnce(Invoke(ReplyScanDump(&dump)));
+  EXPECT_TRUE(scan_utils_.GetScanResult(kFakeInterfaceIndex, &scan_results));
+
+  // From the cache, the strongest BSS of each band.
+  query.max_results_per_ssid = 0;
+  query.max_results_per_band = 1;
+  scan_results.clear();
+  EXPECT_TRUE(scan_utils_.QueryScanResults(kFakeInterfaceIndex, query,
+                                           &scan_results));
+  ASSERT_EQ(2u, scan_results.size());
+  EXPECT_EQ(kFakeBssid2, scan_results[0].bssid);
+  EXPECT_EQ(kFakeBssid3, scan_results[1].bssid);
+
+  // The overall limit applies on top of the caps.
+  query.max_results = 1;
+  scan_results.clear();
+  EXPECT_TRUE(scan_utils_.QueryScanResults(kFakeInterfaceIndex, query,
+                                           &scan_results));
+  ASSERT_EQ(1u, scan_results.size());
+  EXPECT_EQ(kFakeBssid2, scan_results[0].bssid);
+}
+
+TEST_F(ScanUtilsTest, CanQueryFreshScanResults) {
+  uint64_t now_nanoseconds = systemTime(SYSTEM_TIME_BOOTTIME);
+  vector<NL80211Packet> dump;
+  dump.push_back(CreateScanResult(kFakeBssid1, now_nanoseconds - s2ns(60),
+                                  kFakeSignalMbm, kFakeGeneration));
+  dump.push_back(CreateScanResult(kFakeBssid2, now_nanoseconds,
+                                  kFakeSignalMbm, kFakeGeneration));
+  EXPECT_CALL(netlink_manager_, SendMessageAndStreamResponses(_, _)).
+      Times(2).
+      WillRepeatedly(Invoke(ReplyScanDump(&dump)));
+
+  ScanResultQuery query;
+  query.fields = IWifiScannerImpl::SCAN_RESULT_FIELD_ALL;
+  query.max_age_ms = 30000;
+  // Without a cache, stale results are skipped while streaming.
+  vector<NativeScanResult> scan_results;
+  EXPECT_TRUE(scan_utils_.QueryScanResults(kFakeInterfaceIndex, query,
+                                           &scan_results));
+  ASSERT_EQ(1u, scan_results.size());
+  EXPECT_EQ(kFakeBssid2, scan_results[0].bssid);
+
+  scan_results.clear();
+  EXPECT_TRUE(scan_utils_.GetScanResult(kFakeInterfaceIndex, &scan_results));
+  EXPECT_EQ(2u, scan_results.size());
+
+  // From the cache.
+  scan_results.clear();
+  EXPECT_TRUE(scan_utils_.QueryScanResults(kFakeInterfaceIndex, query,
+                                           &scan_results));
+  ASSERT_EQ(1u, scan_results.size());
+  EXPECT_EQ(kFakeBssid2, scan_results[0].bssid);
+
+  query.max_age_ms = 0;
+  scan_results.clear();
+  EXPECT_TRUE(scan_utils_.QueryScanResults(kFakeInterfaceIndex, query,
+                                           &scan_results));
+  EXPECT_EQ(2u, scan_results.size());
+}
+
 TEST_F(ScanUtilsTest, CanSendScanRequest) {
   NL80211Packet response = CreateControlMessageAck();
   EXPECT_CALL(
@@ -160,6 +894,44 @@ TEST_F(ScanUtilsTest, CanSendScanRequest) {
   // and frequencies.
 }
 
+TEST_F(ScanUtilsTest, ReusesScanRequestOfSameSettings) {
+  NL80211Packet response = CreateControlMessageAck();
+  vector<vector<uint8_t>> requests;
+  vector<uint32_t> sequences;
+  EXPECT_CALL(
+      netlink_manager_,
+      SendMessageAndGetResponses(
+          DoesNL80211PacketMatchCommand(NL80211_CMD_TRIGGER_SCAN), _)).
+      Times(2).
+      WillRepeatedly(Invoke([&](const NL80211Packet& request,
+                                vector<unique_ptr<const NL80211Packet>>*
+                                    responses) {
+        requests.push_back(request.GetConstData());
+        sequences.push_back(request.GetMessageSequence());
+        return AppendMessageAndReturn(response, true, request, responses);
+      }));
+
+  EXPECT_CALL(netlink_manager_, GetSequenceNumber()).
+      WillOnce(Return(kFakeSequenceNumber)).
+      WillOnce(Return(kFakeSequenceNumber + 1));
+  ScanRequestCache request_cache;
+  const vector<vector<uint8_t>> ssids = {{'s', 's', 'i', 'd'}};
+  const vector<uint32_t> freqs = {kFakeFrequency, kFakeFrequency5g};
+  int errno_ignored;
+  for (int i = 0; i < 2; i++) {
+    EXPECT_TRUE(scan_utils_.Scan(kFakeInterfaceIndex, kFakeUseRandomMAC,
+                                 kFakeScanType, ssids, freqs, &request_cache,
+                                 &errno_ignored));
+  }
+  EXPECT_EQ(1u, request_cache.GetNumTemplates());
+  // Only the sequence number differs.
+  ASSERT_EQ(2u, requests.size());
+  EXPECT_NE(sequences[0], sequences[1]);
+  NL80211Packet second_request(requests[1]);
+  second_request.SetMessageSequence(sequences[0]);
+  EXPECT_EQ(requests[0], second_request.GetConstData());
+}
+
 TEST_F(ScanUtilsTest, CanSendScanRequestWithRandomAddr) {
   NL80211Packet response = CreateControlMessageAck();
   EXPECT_CALL(
@@ -375,6 +1147,38 @@ TEST_F(ScanUtilsTest, CanSpecifySingleIntervalForSchedScanRequest) {
       req_flags, {}, {}, {}, &errno_ignored);
 }
 
+TEST_F(ScanUtilsTest, CanRestartSchedScanWithOneBatch) {
+  EXPECT_CALL(netlink_manager_, SendMessagesAndGetResponses(_, _))
+      .WillOnce(Invoke([](
+          const vector<const NL80211Packet*>& packets,
+          vector<vector<unique_ptr<const NL80211Packet>>>* responses) {
+        EXPECT_EQ(2u, packets.size());
+        if (packets.size() != 2) {
+          return false;
+        }
+        EXPECT_EQ(NL80211_CMD_STOP_SCHED_SCAN, packets[0]->GetCommand());
+        EXPECT_EQ(NL80211_CMD_START_SCHED_SCAN, packets[1]->GetCommand());
+        responses->clear();
+        responses->resize(2);
+        // No scheduled scan was running.
+        (*responses)[0].push_back(std::make_unique<const NL80211Packet>(
+            CreateControlMessageError(ENOENT)));
+        (*responses)[1].push_back(std::make_unique<const NL80211Packet>(
+            CreateControlMessageAck()));
+        return true;
+      }));
+  const SchedScanReqFlags req_flags = {
+    kFakeUseRandomMAC, kFakeRequestLowPower, kFakeRequestSchedScanRelativeRssi
+  };
+  int error_code = -1;
+  EXPECT_TRUE(scan_utils_.RestartScheduledScan(
+      kFakeInterfaceIndex,
+      SchedScanIntervalSetting(),
+      kFake2gRssiThreshold, kFake5gRssiThreshold, kFake6gRssiThreshold,
+      req_flags, {}, {}, {}, &error_code));
+  EXPECT_EQ(0, error_code);
+}
+
 TEST_F(ScanUtilsTest, CanPrioritizeLastSeenSinceBootNetlinkAttribute) {
   constexpr uint64_t kLastSeenTimestampNanoSeconds = 123456;
   constexpr uint64_t kBssTsfTimestampMicroSeconds = 654321;
@@ -14,31 +14,53 @@
  * limitations under the License.
  */
 
+#include <sstream>
+#include <string>
 #include <vector>
 
+#include <unistd.h>
+
+#include <binder/IPCThreadState.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <wifi_system_test/mock_interface_tool.h>
 #include "android/net/wifi/nl80211/IWifiScannerImpl.h"
+#include "wificond/scanning/channel_settings.h"
 #include "wificond/scanning/scanner_impl.h"
+#include "wificond/tests/fake_event_loop.h"
+#include "wificond/tests/mock_bss_watch_callback.h"
 #include "wificond/tests/mock_client_interface_impl.h"
+#include "wificond/tests/mock_i_scan_event.h"
 #include "wificond/tests/mock_netlink_manager.h"
 #include "wificond/tests/mock_netlink_utils.h"
 #include "wificond/tests/mock_scan_utils.h"
 
+using ::android::IPCThreadState;
 using ::android::binder::Status;
+using ::android::os::ParcelFileDescriptor;
+using ::android::net::wifi::nl80211::BssWatchSettings;
+using ::android::net::wifi::nl80211::ChannelSettings;
+using ::android::net::wifi::nl80211::HiddenNetwork;
 using ::android::net::wifi::nl80211::IWifiScannerImpl;
 using ::android::net::wifi::nl80211::SingleScanSettings;
 using ::android::net::wifi::nl80211::PnoNetwork;
 using ::android::net::wifi::nl80211::PnoSettings;
 using ::android::net::wifi::nl80211::NativeScanResult;
+using ::android::net::wifi::nl80211::NativeScanResultsDelta;
+using ::android::net::wifi::nl80211::NativeScanStats;
+using ::android::net::wifi::nl80211::ScanResultQuery;
 using ::android::wifi_system::MockInterfaceTool;
+using ::testing::DoAll;
 using ::testing::Eq;
 using ::testing::Invoke;
+using ::testing::Mock;
 using ::testing::NiceMock;
 using ::testing::Return;
+using ::testing::SaveArg;
+using ::testing::SetArgPointee;
 using ::testing::_;
 using std::shared_ptr;
+using std::string;
 using std::unique_ptr;
 using std::vector;
 
@@ -50,6 +72,8 @@ namespace wificond {
 namespace {
 
 constexpr uint32_t kFakeInterfaceIndex = 12;
+// Uid of a binder client other than the wifi stack, e.g. a vendor service.
+constexpr uid_t kFakeVendorUid = 10042;
 constexpr uint32_t kFakeScanIntervalMs = 10000;
 
 // This is a helper function to mock the behavior of ScanUtils::Scan()
@@ -70,6 +94,34 @@ bool ReturnErrorCodeForScanRequest(
   return false;
 }
 
+SingleScanSettings CreateScanSettings(const vector<int32_t>& frequencies) {
+  SingleScanSettings scan_settings;
+  scan_settings.scan_type_ = IWifiScannerImpl::SCAN_TYPE_LOW_SPAN;
+  for (int32_t frequency : frequencies) {
+    ChannelSettings channel;
+    channel.frequency_ = frequency;
+    scan_settings.channel_settings_.push_back(channel);
+  }
+  return scan_settings;
+}
+
+// Makes binder calls from this thread look like they come from |uid| while
+// it is in scope.
+class ScopedCallingUid {
+ public:
+  explicit ScopedCallingUid(uid_t uid)
+      : identity_(IPCThreadState::self()->clearCallingIdentity()) {
+    IPCThreadState::self()->restoreCallingIdentity(
+        (static_cast<int64_t>(uid) << 32) | getpid());
+  }
+  ~ScopedCallingUid() {
+    IPCThreadState::self()->restoreCallingIdentity(identity_);
+  }
+
+ private:
+  const int64_t identity_;
+};
+
 bool CaptureSchedScanIntervalSetting(
     uint32_t /* interface_index */,
     const SchedScanIntervalSetting&  interval_setting,
@@ -105,6 +157,7 @@ bool CaptureSchedScanReqFlags(
 
 class ScannerTest : public ::testing::Test {
  protected:
+  FakeEventLoop event_loop_;
   unique_ptr<ScannerImpl> scanner_impl_;
   NiceMock<MockNetlinkManager> netlink_manager_;
   NiceMock<MockNetlinkUtils> netlink_utils_{&netlink_manager_};
@@ -124,7 +177,8 @@ TEST_F(ScannerTest, TestSingleScan) {
   scanner_impl_.reset(new ScannerImpl(kFakeInterfaceIndex,
                                       scan_capabilities_, wiphy_features_,
                                       &client_interface_impl_,
-                                      &scan_utils_));
+                                      &scan_utils_,
+                                      &event_loop_));
   EXPECT_TRUE(scanner_impl_->scan(SingleScanSettings(), &success).isOk());
   EXPECT_TRUE(success);
 }
@@ -136,7 +190,8 @@ TEST_F(ScannerTest, TestSingleScanForLowSpanScan) {
   wiphy_features_.supports_low_span_oneshot_scan = true;
   ScannerImpl scanner_impl(kFakeInterfaceIndex, scan_capabilities_,
                            wiphy_features_, &client_interface_impl_,
-                           &scan_utils_);
+                           &scan_utils_,
+                           &event_loop_);
   SingleScanSettings settings;
   settings.scan_type_ = IWifiScannerImpl::SCAN_TYPE_LOW_SPAN;
   bool success = false;
@@ -151,7 +206,8 @@ TEST_F(ScannerTest, TestSingleScanForLowPowerScan) {
   wiphy_features_.supports_low_power_oneshot_scan = true;
   ScannerImpl scanner_impl(kFakeInterfaceIndex, scan_capabilities_,
                            wiphy_features_, &client_interface_impl_,
-                           &scan_utils_);
+                           &scan_utils_,
+                           &event_loop_);
   SingleScanSettings settings;
   settings.scan_type_ = IWifiScannerImpl::SCAN_TYPE_LOW_POWER;
   bool success = false;
@@ -166,7 +222,8 @@ TEST_F(ScannerTest, TestSingleScanForHighAccuracyScan) {
   wiphy_features_.supports_high_accuracy_oneshot_scan = true;
   ScannerImpl scanner_impl(kFakeInterfaceIndex, scan_capabilities_,
                            wiphy_features_, &client_interface_impl_,
-                           &scan_utils_);
+                           &scan_utils_,
+                           &event_loop_);
   SingleScanSettings settings;
   settings.scan_type_ = IWifiScannerImpl::SCAN_TYPE_HIGH_ACCURACY;
   bool success = false;
@@ -180,7 +237,8 @@ TEST_F(ScannerTest, TestSingleScanForLowSpanScanWithNoWiphySupport) {
       WillOnce(Return(true));
   ScannerImpl scanner_impl(kFakeInterfaceIndex, scan_capabilities_,
                            wiphy_features_, &client_interface_impl_,
-                           &scan_utils_);
+                           &scan_utils_,
+                           &event_loop_);
   SingleScanSettings settings;
   settings.scan_type_ = IWifiScannerImpl::SCAN_TYPE_LOW_SPAN;
   bool success = false;
@@ -194,7 +252,8 @@ TEST_F(ScannerTest, TestSingleScanForLowPowerScanWithNoWiphySupport) {
       WillOnce(Return(true));
   ScannerImpl scanner_impl(kFakeInterfaceIndex, scan_capabilities_,
                            wiphy_features_, &client_interface_impl_,
-                           &scan_utils_);
+                           &scan_utils_,
+                           &event_loop_);
   SingleScanSettings settings;
   settings.scan_type_ = IWifiScannerImpl::SCAN_TYPE_LOW_POWER;
   bool success = false;
@@ -208,7 +267,8 @@ TEST_F(ScannerTest, TestSingleScanForHighAccuracyScanWithNoWiphySupport) {
       WillOnce(Return(true));
   ScannerImpl scanner_impl(kFakeInterfaceIndex, scan_capabilities_,
                            wiphy_features_, &client_interface_impl_,
-                           &scan_utils_);
+                           &scan_utils_,
+                           &event_loop_);
   SingleScanSettings settings;
   settings.scan_type_ = IWifiScannerImpl::SCAN_TYPE_HIGH_ACCURACY;
   bool success = false;
@@ -220,7 +280,8 @@ TEST_F(ScannerTest, TestSingleScanFailure) {
   scanner_impl_.reset(new ScannerImpl(kFakeInterfaceIndex,
                                       scan_capabilities_, wiphy_features_,
                                       &client_interface_impl_,
-                                      &scan_utils_));
+                                      &scan_utils_,
+                                      &event_loop_));
   EXPECT_CALL(
       scan_utils_,
       Scan(_, _, _, _, _, _)).
@@ -237,7 +298,8 @@ TEST_F(ScannerTest, TestProcessAbortsOnScanReturningNoDeviceErrorSeveralTimes) {
   scanner_impl_.reset(new ScannerImpl(kFakeInterfaceIndex,
                                       scan_capabilities_, wiphy_features_,
                                       &client_interface_impl_,
-                                      &scan_utils_));
+                                      &scan_utils_,
+                                      &event_loop_));
   ON_CALL(
       scan_utils_,
       Scan(_, _, _, _, _, _)).
@@ -261,7 +323,8 @@ TEST_F(ScannerTest, TestAbortScan) {
   scanner_impl_.reset(new ScannerImpl(kFakeInterfaceIndex,
                                       scan_capabilities_, wiphy_features_,
                                       &client_interface_impl_,
-                                      &scan_utils_));
+                                      &scan_utils_,
+                                      &event_loop_));
   EXPECT_CALL(scan_utils_, Scan(_, _, _, _, _, _))
       .WillOnce(Return(true));
   EXPECT_TRUE(
@@ -276,26 +339,214 @@ TEST_F(ScannerTest, TestAbortScanNotIssuedIfNoOngoingScan) {
   scanner_impl_.reset(new ScannerImpl(kFakeInterfaceIndex,
                                       scan_capabilities_, wiphy_features_,
                                       &client_interface_impl_,
-                                      &scan_utils_));
+                                      &scan_utils_,
+                                      &event_loop_));
   EXPECT_CALL(scan_utils_, AbortScan(_)).Times(0);
   EXPECT_TRUE(scanner_impl_->abortScan().isOk());
 }
 
+TEST_F(ScannerTest, TestCoalesceScansRequestedWhileScanInFlight) {
+  OnScanResultsReadyHandler scan_results_handler;
+  EXPECT_CALL(scan_utils_,
+              SubscribeScanResultNotification(kFakeInterfaceIndex, _))
+      .WillOnce(SaveArg<1>(&scan_results_handler));
+  scanner_impl_.reset(new ScannerImpl(kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_,
+                                      &scan_utils_,
+                                      &event_loop_));
+  SingleScanSettings scan_settings_2g = CreateScanSettings({2412});
+  SingleScanSettings scan_settings_5g = CreateScanSettings({5180});
+
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, _, Eq(vector<uint32_t>{2412}), _))
+      .WillOnce(Return(true));
+  bool success = false;
+  EXPECT_TRUE(scanner_impl_->scan(scan_settings_2g, &success).isOk());
+  EXPECT_TRUE(success);
+  // Neither request triggers a scan while the first one is in flight.
+  success = false;
+  EXPECT_TRUE(scanner_impl_->scan(scan_settings_2g, &success).isOk());
+  EXPECT_TRUE(success);
+  success = false;
+  EXPECT_TRUE(scanner_impl_->scan(scan_settings_5g, &success).isOk());
+  EXPECT_TRUE(success);
+  Mock::VerifyAndClearExpectations(&scan_utils_);
+
+  // The 5GHz request is served by a follow-up scan.
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, _, Eq(vector<uint32_t>{5180}), _))
+      .WillOnce(Return(true));
+  vector<vector<uint8_t>> ssids;
+  vector<uint32_t> frequencies;
+  scan_results_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+}
+
+TEST_F(ScannerTest, TestSplitScanScansOneBandAfterTheOther) {
+  OnScanResultsReadyHandler scan_results_handler;
+  EXPECT_CALL(scan_utils_,
+              SubscribeScanResultNotification(kFakeInterfaceIndex, _))
+      .WillOnce(SaveArg<1>(&scan_results_handler));
+  scanner_impl_.reset(new ScannerImpl(kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_,
+                                      &scan_utils_,
+                                      &event_loop_));
+  SingleScanSettings scan_settings = CreateScanSettings({5180, 2412, 5955});
+  scan_settings.enable_split_scan_ = true;
+  vector<vector<uint8_t>> ssids;
+  vector<uint32_t> frequencies;
+
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, _, Eq(vector<uint32_t>{2412}), _))
+      .WillOnce(Return(true));
+  bool success = false;
+  EXPECT_TRUE(scanner_impl_->scan(scan_settings, &success).isOk());
+  EXPECT_TRUE(success);
+  Mock::VerifyAndClearExpectations(&scan_utils_);
+
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, _, Eq(vector<uint32_t>{5180}), _))
+      .WillOnce(Return(true));
+  scan_results_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+  Mock::VerifyAndClearExpectations(&scan_utils_);
+
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, _, Eq(vector<uint32_t>{5955}), _))
+      .WillOnce(Return(true));
+  scan_results_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+  Mock::VerifyAndClearExpectations(&scan_utils_);
+
+  // The split scan is done after the 6GHz sub-scan.
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, _, _, _)).Times(0);
+  scan_results_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+}
+
+TEST_F(ScannerTest, TestSplitScanRunsSubScansOnIdlePeerRadio) {
+  constexpr uint32_t kFakePeerInterfaceIndex = kFakeInterfaceIndex + 1;
+  BandInfo band_info;
+  band_info.band_2g = {2412};
+  band_info.band_5g = {5180};
+  band_info.band_6g = {5955};
+  ON_CALL(netlink_utils_, GetWiphyInfo(_, _, _, _)).
+      WillByDefault(DoAll(SetArgPointee<1>(band_info), Return(true)));
+  NiceMock<MockClientInterfaceImpl> peer_client_interface_impl{
+      &if_tool_, &netlink_utils_, &scan_utils_};
+  OnScanResultsReadyHandler scan_results_handler;
+  OnScanResultsReadyHandler peer_scan_results_handler;
+  EXPECT_CALL(scan_utils_,
+              SubscribeScanResultNotification(kFakeInterfaceIndex, _))
+      .WillOnce(SaveArg<1>(&scan_results_handler));
+  EXPECT_CALL(scan_utils_,
+              SubscribeScanResultNotification(kFakePeerInterfaceIndex, _))
+      .WillOnce(SaveArg<1>(&peer_scan_results_handler));
+  scanner_impl_.reset(new ScannerImpl(kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_,
+                                      &scan_utils_,
+                                      &event_loop_));
+  ScannerImpl peer_scanner_impl(kFakePeerInterfaceIndex,
+                                scan_capabilities_, wiphy_features_,
+                                &peer_client_interface_impl,
+                                &scan_utils_,
+                                &event_loop_);
+  // Scan results of the peer radio are merged into those of this one.
+  EXPECT_CALL(scan_utils_,
+              SetPeerRadioInterfaces(kFakeInterfaceIndex,
+                                     vector<uint32_t>{kFakePeerInterfaceIndex}));
+  scanner_impl_->SetPeerRadios({&peer_scanner_impl});
+  sp<NiceMock<MockIScanEvent>> scan_event(new NiceMock<MockIScanEvent>());
+  EXPECT_TRUE(scanner_impl_->subscribeScanEvents(scan_event).isOk());
+  SingleScanSettings scan_settings = CreateScanSettings({5180, 2412, 5955});
+  scan_settings.enable_split_scan_ = true;
+  vector<vector<uint8_t>> ssids;
+  vector<uint32_t> frequencies;
+
+  // The peer radio scans 5GHz while this one scans 2.4GHz.
+  EXPECT_CALL(scan_utils_, Scan(kFakeInterfaceIndex, _, _, _,
+                                Eq(vector<uint32_t>{2412}), _))
+      .WillOnce(Return(true));
+  EXPECT_CALL(scan_utils_, Scan(kFakePeerInterfaceIndex, _, _, _,
+                                Eq(vector<uint32_t>{5180}), _))
+      .WillOnce(Return(true));
+  bool success = false;
+  EXPECT_TRUE(scanner_impl_->scan(scan_settings, &success).isOk());
+  EXPECT_TRUE(success);
+  Mock::VerifyAndClearExpectations(&scan_utils_);
+
+  EXPECT_CALL(scan_utils_, Scan(kFakeInterfaceIndex, _, _, _,
+                                Eq(vector<uint32_t>{5955}), _))
+      .WillOnce(Return(true));
+  EXPECT_CALL(*scan_event, OnPartialScanResultReady(
+      IWifiScannerImpl::SCAN_RESULT_BAND_2G));
+  scan_results_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+  Mock::VerifyAndClearExpectations(&scan_utils_);
+
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, _, _, _)).Times(0);
+  EXPECT_CALL(*scan_event, OnPartialScanResultReady(
+      IWifiScannerImpl::SCAN_RESULT_BAND_5G));
+  peer_scan_results_handler(kFakePeerInterfaceIndex, false, ssids,
+                            frequencies);
+  Mock::VerifyAndClearExpectations(scan_event.get());
+
+  // The split scan is done once both radios are.
+  EXPECT_CALL(*scan_event, OnScanResultReady());
+  scan_results_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+}
+
 TEST_F(ScannerTest, TestGetScanResults) {
   vector<NativeScanResult> scan_results;
   scanner_impl_.reset(new ScannerImpl(kFakeInterfaceIndex,
                                       scan_capabilities_, wiphy_features_,
                                       &client_interface_impl_,
-                                      &scan_utils_));
+                                      &scan_utils_,
+                                      &event_loop_));
   EXPECT_CALL(scan_utils_, GetScanResult(_, _)).WillOnce(Return(true));
   EXPECT_TRUE(scanner_impl_->getScanResults(&scan_results).isOk());
 }
 
+TEST_F(ScannerTest, TestGetScanResultsDelta) {
+  constexpr int64_t kFakeGeneration = 42;
+  NativeScanResultsDelta delta;
+  scanner_impl_.reset(new ScannerImpl(kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_,
+                                      &scan_utils_,
+                                      &event_loop_));
+  EXPECT_CALL(scan_utils_,
+              GetScanResultDelta(kFakeInterfaceIndex, kFakeGeneration, _))
+      .WillOnce(Return(true));
+  EXPECT_TRUE(
+      scanner_impl_->getScanResultsDelta(kFakeGeneration, &delta).isOk());
+}
+
+TEST_F(ScannerTest, TestQueryScanResults) {
+  ScanResultQuery query;
+  vector<NativeScanResult> scan_results;
+  scanner_impl_.reset(new ScannerImpl(kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_,
+                                      &scan_utils_,
+                                      &event_loop_));
+  EXPECT_CALL(scan_utils_, QueryScanResults(kFakeInterfaceIndex, _, _))
+      .WillOnce(Return(true));
+  EXPECT_TRUE(scanner_impl_->queryScanResults(query, &scan_results).isOk());
+}
+
+TEST_F(ScannerTest, TestGetScanResultsMemory) {
+  ParcelFileDescriptor memory;
+  scanner_impl_.reset(new ScannerImpl(kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_,
+                                      &scan_utils_,
+                                      &event_loop_));
+  EXPECT_CALL(scan_utils_, GetScanResult(kFakeInterfaceIndex, _))
+      .WillOnce(Return(true));
+  EXPECT_TRUE(scanner_impl_->getScanResultsMemory(&memory).isOk());
+  EXPECT_GE(memory.get().get(), 0);
+}
+
 TEST_F(ScannerTest, TestStartPnoScanViaNetlink) {
   bool success = false;
   ScannerImpl scanner_impl(kFakeInterfaceIndex, scan_capabilities_,
                            wiphy_features_, &client_interface_impl_,
-                           &scan_utils_);
+                           &scan_utils_,
+                           &event_loop_);
   EXPECT_CALL(
       scan_utils_,
       StartScheduledScan(_, _, _, _, _,  _, _, _, _, _)).
@@ -309,7 +560,8 @@ TEST_F(ScannerTest, TestStartPnoScanViaNetlinkWithLowPowerScanWiphySupport) {
   wiphy_features_.supports_low_power_oneshot_scan = true;
   ScannerImpl scanner_impl(kFakeInterfaceIndex, scan_capabilities_,
                            wiphy_features_, &client_interface_impl_,
-                           &scan_utils_);
+                           &scan_utils_,
+                           &event_loop_);
   SchedScanReqFlags req_flags = {};
   EXPECT_CALL(
       scan_utils_,
@@ -322,12 +574,43 @@ TEST_F(ScannerTest, TestStartPnoScanViaNetlinkWithLowPowerScanWiphySupport) {
   EXPECT_TRUE(req_flags.request_low_power);
 }
 
+TEST_F(ScannerTest, TestUpdatePnoScanOnlyRestartsOnChange) {
+  ScannerImpl scanner_impl(kFakeInterfaceIndex, scan_capabilities_,
+                           wiphy_features_, &client_interface_impl_,
+                           &scan_utils_,
+                           &event_loop_);
+  PnoSettings pno_settings;
+  pno_settings.interval_ms_ = kFakeScanIntervalMs;
+  bool success = false;
+  EXPECT_CALL(scan_utils_,
+              StartScheduledScan(_, _, _, _, _, _, _, _, _, _))
+      .WillOnce(Return(true));
+  EXPECT_TRUE(scanner_impl.startPnoScan(pno_settings, &success).isOk());
+  EXPECT_TRUE(success);
+
+  // Nothing that kernel scans for changed.
+  EXPECT_CALL(scan_utils_,
+              RestartScheduledScan(_, _, _, _, _, _, _, _, _, _)).Times(0);
+  EXPECT_TRUE(scanner_impl.updatePnoScan(pno_settings, &success).isOk());
+  EXPECT_TRUE(success);
+  Mock::VerifyAndClearExpectations(&scan_utils_);
+
+  pno_settings.min_5g_rssi_ -= 5;
+  EXPECT_CALL(scan_utils_,
+              RestartScheduledScan(_, _, _, _, _, _, _, _, _, _))
+      .WillOnce(Return(true));
+  EXPECT_CALL(scan_utils_, StopScheduledScan(_)).Times(0);
+  EXPECT_TRUE(scanner_impl.updatePnoScan(pno_settings, &success).isOk());
+  EXPECT_TRUE(success);
+}
+
 TEST_F(ScannerTest, TestStopPnoScanViaNetlink) {
   bool success = false;
   scanner_impl_.reset(new ScannerImpl(kFakeInterfaceIndex,
                                       scan_capabilities_, wiphy_features_,
                                       &client_interface_impl_,
-                                      &scan_utils_));
+                                      &scan_utils_,
+                                      &event_loop_));
   // StopScheduledScan() will be called no matter if there is an ongoing
   // scheduled scan or not. This is for making the system more robust.
   EXPECT_CALL(scan_utils_, StopScheduledScan(_)).WillOnce(Return(true));
@@ -335,6 +618,66 @@ TEST_F(ScannerTest, TestStopPnoScanViaNetlink) {
   EXPECT_TRUE(success);
 }
 
+TEST_F(ScannerTest, TestFetchPnoScanResultsOnResultsEvent) {
+  OnSchedScanResultsReadyHandler sched_scan_results_handler;
+  EXPECT_CALL(scan_utils_,
+              SubscribeSchedScanResultNotification(kFakeInterfaceIndex, _))
+      .WillOnce(SaveArg<1>(&sched_scan_results_handler));
+  scanner_impl_.reset(new ScannerImpl(kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_,
+                                      &scan_utils_,
+                                      &event_loop_));
+
+  EXPECT_CALL(scan_utils_, UpdateScanResultCache(kFakeInterfaceIndex))
+      .WillOnce(Return(true));
+  sched_scan_results_handler(kFakeInterfaceIndex, false);
+  Mock::VerifyAndClearExpectations(&scan_utils_);
+
+  // There are no new results when the scan stopped.
+  EXPECT_CALL(scan_utils_, UpdateScanResultCache(_)).Times(0);
+  sched_scan_results_handler(kFakeInterfaceIndex, true);
+}
+
+TEST_F(ScannerTest, TestPnoScanResultsAreLimitedToPnoNetworks) {
+  bool success = false;
+  ScannerImpl scanner_impl(kFakeInterfaceIndex, scan_capabilities_,
+                           wiphy_features_, &client_interface_impl_,
+                           &scan_utils_,
+                           &event_loop_);
+  PnoSettings pno_settings;
+  PnoNetwork network;
+  network.is_hidden_ = false;
+  network.ssid_ = {'a', 'b'};
+  pno_settings.pno_networks_.push_back(network);
+  EXPECT_CALL(
+      scan_utils_,
+      StartScheduledScan(_, _, _, _, _, _, _, _, _, _)).
+          WillOnce(Return(true));
+  EXPECT_TRUE(scanner_impl.startPnoScan(pno_settings, &success).isOk());
+  EXPECT_TRUE(success);
+
+  EXPECT_CALL(scan_utils_, GetScanResult(kFakeInterfaceIndex, _, _))
+      .WillOnce(Invoke([](uint32_t /* interface_index */,
+                          const SsidMatcher& ssids,
+                          vector<NativeScanResult>* /* scan_results */) {
+        EXPECT_TRUE(ssids.Matches(vector<uint8_t>{'a', 'b'}));
+        EXPECT_FALSE(ssids.Matches(vector<uint8_t>{'c'}));
+        return true;
+      }));
+  vector<NativeScanResult> scan_results;
+  EXPECT_TRUE(scanner_impl.getPnoScanResults(&scan_results).isOk());
+  Mock::VerifyAndClearExpectations(&scan_utils_);
+
+  // All scan results are returned once the PNO scan stopped.
+  EXPECT_CALL(scan_utils_, StopScheduledScan(kFakeInterfaceIndex))
+      .WillOnce(Return(true));
+  EXPECT_TRUE(scanner_impl.stopPnoScan(&success).isOk());
+  EXPECT_CALL(scan_utils_, GetScanResult(kFakeInterfaceIndex, _))
+      .WillOnce(Return(true));
+  EXPECT_TRUE(scanner_impl.getPnoScanResults(&scan_results).isOk());
+}
+
 TEST_F(ScannerTest, TestGenerateScanPlansIfDeviceSupports) {
   ScanCapabilities scan_capabilities_scan_plan_supported(
       0 /* max_num_scan_ssids */,
@@ -348,7 +691,8 @@ TEST_F(ScannerTest, TestGenerateScanPlansIfDeviceSupports) {
       kFakeInterfaceIndex,
       scan_capabilities_scan_plan_supported, wiphy_features_,
       &client_interface_impl_,
-      &scan_utils_);
+      &scan_utils_,
+      &event_loop_);
 
   PnoSettings pno_settings;
   pno_settings.interval_ms_ = kFakeScanIntervalMs;
@@ -382,7 +726,8 @@ TEST_F(ScannerTest, TestGenerateSingleIntervalIfDeviceDoesNotSupportScanPlan) {
       kFakeInterfaceIndex,
       scan_capabilities_no_scan_plan_support, wiphy_features_,
       &client_interface_impl_,
-      &scan_utils_);
+      &scan_utils_,
+      &event_loop_);
   PnoSettings pno_settings;
   pno_settings.interval_ms_ = kFakeScanIntervalMs;
 
@@ -407,7 +752,8 @@ TEST_F(ScannerTest, TestGetScanResultsOnInvalidatedScannerImpl) {
   scanner_impl_.reset(new ScannerImpl(kFakeInterfaceIndex,
                                       scan_capabilities_, wiphy_features_,
                                       &client_interface_impl_,
-                                      &scan_utils_));
+                                      &scan_utils_,
+                                      &event_loop_));
   scanner_impl_->Invalidate();
   EXPECT_CALL(scan_utils_, GetScanResult(_, _))
       .Times(0)
@@ -427,7 +773,8 @@ TEST_F(ScannerTest, TestStartPnoScanWithNonEmptyFrequencyList) {
       PnoSettings::kFastScanIterations);
   ScannerImpl scanner_impl(kFakeInterfaceIndex, scan_capabilities_test_frequencies,
                            wiphy_features_, &client_interface_impl_,
-                           &scan_utils_);
+                           &scan_utils_,
+                           &event_loop_);
 
   PnoSettings pno_settings;
   PnoNetwork network;
@@ -458,7 +805,8 @@ TEST_F(ScannerTest, TestStartPnoScanWithFrequencyListNoDuplicates) {
       PnoSettings::kFastScanIterations);
   ScannerImpl scanner_impl(kFakeInterfaceIndex, scan_capabilities_test_frequencies,
                            wiphy_features_, &client_interface_impl_,
-                           &scan_utils_);
+                           &scan_utils_,
+                           &event_loop_);
 
   PnoSettings pno_settings;
   PnoNetwork network;
@@ -497,7 +845,8 @@ TEST_F(ScannerTest, TestStartPnoScanWithFrequencyListFallbackMechanism) {
       PnoSettings::kFastScanIterations);
   ScannerImpl scanner_impl(kFakeInterfaceIndex, scan_capabilities_test_frequencies,
                            wiphy_features_, &client_interface_impl_,
-                           &scan_utils_);
+                           &scan_utils_,
+                           &event_loop_);
 
   PnoSettings pno_settings;
   PnoNetwork network;
@@ -533,7 +882,8 @@ TEST_F(ScannerTest, TestStartPnoScanEmptyList) {
       PnoSettings::kFastScanIterations);
   ScannerImpl scanner_impl(kFakeInterfaceIndex, scan_capabilities_test_frequencies,
                            wiphy_features_, &client_interface_impl_,
-                           &scan_utils_);
+                           &scan_utils_,
+                           &event_loop_);
 
   PnoSettings pno_settings;
   PnoNetwork network;
@@ -550,5 +900,672 @@ TEST_F(ScannerTest, TestStartPnoScanEmptyList) {
   EXPECT_TRUE(success);
 }
 
+// Verify that networks which firmware has no room for are the least used
+// ones.
+TEST_F(ScannerTest, TestStartPnoScanPrioritizesNetworks) {
+  bool success = false;
+  ScanCapabilities scan_capabilities_test_networks(
+      1 /* max_num_scan_ssids */,
+      2 /* max_num_sched_scan_ssids */,
+      3 /* max_match_sets */,
+      0,
+      kFakeScanIntervalMs * PnoSettings::kSlowScanIntervalMultiplier / 1000,
+      PnoSettings::kFastScanIterations);
+  ScannerImpl scanner_impl(kFakeInterfaceIndex, scan_capabilities_test_networks,
+                           wiphy_features_, &client_interface_impl_,
+                           &scan_utils_,
+                           &event_loop_);
+
+  PnoSettings pno_settings;
+  PnoNetwork network;
+  network.is_hidden_ = false;
+  network.ssid_ = {'a'};
+  network.num_connections_ = 1;
+  pno_settings.pno_networks_.push_back(network);
+  network.ssid_ = {'b'};
+  network.num_connections_ = 5;
+  pno_settings.pno_networks_.push_back(network);
+  network.ssid_ = {'c'};
+  network.last_connected_ms_ = 1000;
+  pno_settings.pno_networks_.push_back(network);
+  network.ssid_ = {'d'};
+  network.is_hidden_ = true;
+  network.num_connections_ = 1;
+  network.last_connected_ms_ = 0;
+  pno_settings.pno_networks_.push_back(network);
+
+  vector<vector<uint8_t>> expected_scan_ssids = {{}, {'d'}};
+  vector<vector<uint8_t>> expected_match_ssids = {{'c'}, {'b'}, {'d'}};
+  EXPECT_CALL(
+      scan_utils_,
+      StartScheduledScan(_, _, _, _, _, _, Eq(expected_scan_ssids),
+                         Eq(expected_match_ssids), _, _)).
+          WillOnce(Return(true));
+  EXPECT_TRUE(scanner_impl.startPnoScan(pno_settings, &success).isOk());
+  EXPECT_TRUE(success);
+  // All networks fit in a single shard.
+  EXPECT_EQ(0u, event_loop_.GetNumDelayedTasks());
+}
+
+// Verify that networks which firmware has no room for take turns, while the
+// most used ones are always matched.
+TEST_F(ScannerTest, TestStartPnoScanRotatesNetworks) {
+  bool success = false;
+  ScanCapabilities scan_capabilities_test_networks(
+      1 /* max_num_scan_ssids */,
+      1 /* max_num_sched_scan_ssids */,
+      4 /* max_match_sets */,
+      0,
+      kFakeScanIntervalMs * PnoSettings::kSlowScanIntervalMultiplier / 1000,
+      PnoSettings::kFastScanIterations);
+  ScannerImpl scanner_impl(kFakeInterfaceIndex, scan_capabilities_test_networks,
+                           wiphy_features_, &client_interface_impl_,
+                           &scan_utils_,
+                           &event_loop_);
+
+  PnoSettings pno_settings;
+  pno_settings.interval_ms_ = kFakeScanIntervalMs;
+  pno_settings.enable_network_rotation_ = true;
+  for (uint8_t i = 0; i < 7; i++) {
+    PnoNetwork network;
+    network.is_hidden_ = false;
+    network.ssid_ = {static_cast<uint8_t>('0' + i)};
+    network.num_connections_ = 10 - i;
+    pno_settings.pno_networks_.push_back(network);
+  }
+
+  vector<vector<uint8_t>> match_ssids;
+  EXPECT_CALL(
+      scan_utils_,
+      StartScheduledScan(_, _, _, _, _, _, _, _, _, _)).
+          WillOnce(DoAll(SaveArg<7>(&match_ssids), Return(true)));
+  EXPECT_TRUE(scanner_impl.startPnoScan(pno_settings, &success).isOk());
+  EXPECT_TRUE(success);
+  EXPECT_EQ((vector<vector<uint8_t>>{{'0'}, {'1'}, {'2'}, {'3'}}),
+            match_ssids);
+  Mock::VerifyAndClearExpectations(&scan_utils_);
+
+  SchedScanIntervalSetting interval_setting;
+  EXPECT_CALL(
+      scan_utils_,
+      RestartScheduledScan(_, _, _, _, _, _, _, _, _, _)).
+          WillRepeatedly(DoAll(SaveArg<1>(&interval_setting),
+                               SaveArg<7>(&match_ssids),
+                               Return(true)));
+  EXPECT_CALL(scan_utils_, StartScheduledScan(_, _, _, _, _, _, _, _, _, _))
+      .Times(0);
+  ASSERT_EQ(1u, event_loop_.GetNumDelayedTasks());
+  EXPECT_EQ(2 * kFakeScanIntervalMs, event_loop_.RunDelayedTask());
+  EXPECT_EQ((vector<vector<uint8_t>>{{'0'}, {'1'}, {'4'}, {'5'}}),
+            match_ssids);
+  EXPECT_TRUE(interval_setting.plans.empty());
+
+  // The last shard wraps around.
+  ASSERT_EQ(1u, event_loop_.GetNumDelayedTasks());
+  event_loop_.RunDelayedTask();
+  EXPECT_EQ((vector<vector<uint8_t>>{{'0'}, {'1'}, {'6'}, {'2'}}),
+            match_ssids);
+
+  ASSERT_EQ(1u, event_loop_.GetNumDelayedTasks());
+  event_loop_.RunDelayedTask();
+  EXPECT_EQ((vector<vector<uint8_t>>{{'0'}, {'1'}, {'2'}, {'3'}}),
+            match_ssids);
+
+  EXPECT_CALL(scan_utils_, StopScheduledScan(_)).WillOnce(Return(true));
+  EXPECT_TRUE(scanner_impl.stopPnoScan(&success).isOk());
+  EXPECT_TRUE(success);
+  EXPECT_EQ(0u, event_loop_.GetNumDelayedTasks());
+}
+
+// Verify that a network without frequency data is scanned for on the
+// channels it was seen on before.
+TEST_F(ScannerTest, TestStartPnoScanWithChannelHistory) {
+  bool success = false;
+  ScanCapabilities scan_capabilities_test_frequencies(
+      1 /* max_num_scan_ssids */,
+      1 /* max_num_sched_scan_ssids */,
+      2 /* max_match_sets */,
+      0,
+      kFakeScanIntervalMs * PnoSettings::kSlowScanIntervalMultiplier / 1000,
+      PnoSettings::kFastScanIterations);
+  ScannerImpl scanner_impl(kFakeInterfaceIndex, scan_capabilities_test_frequencies,
+                           wiphy_features_, &client_interface_impl_,
+                           &scan_utils_,
+                           &event_loop_);
+
+  PnoSettings pno_settings;
+  PnoNetwork network;
+  PnoNetwork network2;
+  network.is_hidden_ = false;
+  network.ssid_ = {'a'};
+  network.frequencies_.push_back(2412);
+  network2.is_hidden_ = false;
+  network2.ssid_ = {'b'};
+  pno_settings.pno_networks_.push_back(network);
+  pno_settings.pno_networks_.push_back(network2);
+
+  EXPECT_CALL(scan_utils_, GetChannelHistory(network2.ssid_, _)).
+      WillOnce(DoAll(SetArgPointee<1>(vector<uint32_t>{5180}), Return(true)));
+  EXPECT_CALL(
+      scan_utils_,
+      StartScheduledScan(_, _, _, _, _, _, _, _,
+                         Eq(vector<uint32_t>{2412, 5180}), _)).
+          WillOnce(Return(true));
+  EXPECT_TRUE(scanner_impl.startPnoScan(pno_settings, &success).isOk());
+  EXPECT_TRUE(success);
+}
+
+// Verify that a scan for hidden networks with channel hints only scans the
+// channels they were seen on, unless one of them was never seen.
+TEST_F(ScannerTest, TestSingleScanForHiddenNetworksWithChannelHints) {
+  OnScanResultsReadyHandler scan_results_handler;
+  EXPECT_CALL(scan_utils_,
+              SubscribeScanResultNotification(kFakeInterfaceIndex, _))
+      .WillOnce(SaveArg<1>(&scan_results_handler));
+  ScanCapabilities scan_capabilities_test_hidden_networks(
+      3 /* max_num_scan_ssids */,
+      1 /* max_num_sched_scan_ssids */,
+      1 /* max_match_sets */,
+      0,
+      kFakeScanIntervalMs * PnoSettings::kSlowScanIntervalMultiplier / 1000,
+      PnoSettings::kFastScanIterations);
+  scanner_impl_.reset(new ScannerImpl(kFakeInterfaceIndex,
+                                      scan_capabilities_test_hidden_networks,
+                                      wiphy_features_,
+                                      &client_interface_impl_,
+                                      &scan_utils_,
+                                      &event_loop_));
+
+  SingleScanSettings scan_settings = CreateScanSettings({});
+  scan_settings.enable_channel_hints_ = true;
+  HiddenNetwork network;
+  network.ssid_ = {'a'};
+  scan_settings.hidden_networks_.push_back(network);
+  network.ssid_ = {'b'};
+  scan_settings.hidden_networks_.push_back(network);
+
+  EXPECT_CALL(scan_utils_, GetChannelHistory(vector<uint8_t>{'a'}, _)).
+      WillRepeatedly(DoAll(SetArgPointee<1>(vector<uint32_t>{5180, 2437}),
+                           Return(true)));
+  EXPECT_CALL(scan_utils_, GetChannelHistory(vector<uint8_t>{'b'}, _)).
+      WillOnce(DoAll(SetArgPointee<1>(vector<uint32_t>{2437}), Return(true))).
+      WillOnce(Return(false));
+  EXPECT_CALL(scan_utils_,
+              Scan(_, _, _, _, Eq(vector<uint32_t>{2437, 5180}), _)).
+      WillOnce(Return(true));
+  bool success = false;
+  EXPECT_TRUE(scanner_impl_->scan(scan_settings, &success).isOk());
+  EXPECT_TRUE(success);
+  vector<vector<uint8_t>> ssids;
+  vector<uint32_t> frequencies;
+  scan_results_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+
+  // |b| is not known anymore, so all channels are scanned.
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, _, Eq(vector<uint32_t>{}), _)).
+      WillOnce(Return(true));
+  success = false;
+  EXPECT_TRUE(scanner_impl_->scan(scan_settings, &success).isOk());
+  EXPECT_TRUE(success);
+}
+
+// Verify that hidden networks that don't fit in a scan request take turns
+// with the others over consecutive scans.
+TEST_F(ScannerTest, TestSingleScanRotatesHiddenNetworks) {
+  OnScanResultsReadyHandler scan_results_handler;
+  EXPECT_CALL(scan_utils_,
+              SubscribeScanResultNotification(kFakeInterfaceIndex, _))
+      .WillOnce(SaveArg<1>(&scan_results_handler));
+  ScanCapabilities scan_capabilities_test_hidden_networks(
+      2 /* max_num_scan_ssids */,
+      1 /* max_num_sched_scan_ssids */,
+      1 /* max_match_sets */,
+      0,
+      kFakeScanIntervalMs * PnoSettings::kSlowScanIntervalMultiplier / 1000,
+      PnoSettings::kFastScanIterations);
+  scanner_impl_.reset(new ScannerImpl(kFakeInterfaceIndex,
+                                      scan_capabilities_test_hidden_networks,
+                                      wiphy_features_,
+                                      &client_interface_impl_,
+                                      &scan_utils_,
+                                      &event_loop_));
+
+  SingleScanSettings scan_settings = CreateScanSettings({});
+  HiddenNetwork network;
+  network.ssid_ = {'a'};
+  scan_settings.hidden_networks_.push_back(network);
+  network.ssid_ = {'b'};
+  scan_settings.hidden_networks_.push_back(network);
+
+  vector<vector<uint8_t>> ssids;
+  vector<uint32_t> frequencies;
+  for (const vector<uint8_t>& hidden_ssid :
+           {vector<uint8_t>{'a'}, vector<uint8_t>{'b'}, vector<uint8_t>{'a'}}) {
+    EXPECT_CALL(scan_utils_,
+                Scan(_, _, _, Eq(vector<vector<uint8_t>>{{}, hidden_ssid}),
+                     _, _)).
+        WillOnce(Return(true));
+    bool success = false;
+    EXPECT_TRUE(scanner_impl_->scan(scan_settings, &success).isOk());
+    EXPECT_TRUE(success);
+    scan_results_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+  }
+}
+
+TEST_F(ScannerTest, TestScanOnlyPlanned6GhzChannels) {
+  BandInfo band_info;
+  band_info.band_2g = {2412};
+  band_info.band_5g = {5180};
+  band_info.band_6g = {5955, 5975, 6135, 6155};
+  EXPECT_CALL(netlink_utils_, GetWiphyInfo(_, _, _, _)).
+      WillOnce(DoAll(SetArgPointee<1>(band_info), Return(true)));
+  NiceMock<MockClientInterfaceImpl> client_interface_impl{
+      &if_tool_, &netlink_utils_, &scan_utils_};
+  scanner_impl_.reset(new ScannerImpl(kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl,
+                                      &scan_utils_,
+                                      &event_loop_));
+  SingleScanSettings scan_settings = CreateScanSettings({});
+  scan_settings.enable_6ghz_rnr_planning_ = true;
+
+  // 5975 MHz is a Preferred Scanning Channel, and an AP on 6135 MHz is
+  // colocated with a BSS of a recent scan.
+  EXPECT_CALL(scan_utils_,
+              GetColocated6GhzFrequencies(kFakeInterfaceIndex, _)).
+      WillOnce(SetArgPointee<1>(vector<uint32_t>{6135}));
+  EXPECT_CALL(scan_utils_,
+              Scan(_, _, _, _,
+                   Eq(vector<uint32_t>{2412, 5180, 5975, 6135}), _)).
+      WillOnce(Return(true));
+  bool success = false;
+  EXPECT_TRUE(scanner_impl_->scan(scan_settings, &success).isOk());
+  EXPECT_TRUE(success);
+}
+
+TEST_F(ScannerTest, TestRecordScanStatsPerSourceAndBand) {
+  OnScanResultsReadyHandler scan_results_handler;
+  EXPECT_CALL(scan_utils_,
+              SubscribeScanResultNotification(kFakeInterfaceIndex, _))
+      .WillOnce(SaveArg<1>(&scan_results_handler));
+  scanner_impl_.reset(new ScannerImpl(kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_,
+                                      &scan_utils_,
+                                      &event_loop_));
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, _, _, _)).WillOnce(Return(true));
+  bool success = false;
+  EXPECT_TRUE(scanner_impl_->scan(CreateScanSettings({2412, 2437, 5180}),
+                                  &success).isOk());
+  EXPECT_TRUE(success);
+
+  EXPECT_CALL(scan_utils_, UpdateScanResultCache(kFakeInterfaceIndex))
+      .WillOnce(Return(true));
+  EXPECT_CALL(scan_utils_, GetNumScanResults(
+      kFakeInterfaceIndex, IWifiScannerImpl::SCAN_RESULT_BAND_2G))
+      .WillOnce(Return(3));
+  EXPECT_CALL(scan_utils_, GetNumScanResults(
+      kFakeInterfaceIndex, IWifiScannerImpl::SCAN_RESULT_BAND_5G))
+      .WillOnce(Return(1));
+  vector<vector<uint8_t>> ssids;
+  vector<uint32_t> frequencies;
+  scan_results_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+
+  // A scan that another process triggered and aborted.
+  frequencies = {5180};
+  scan_results_handler(kFakeInterfaceIndex, true, ssids, frequencies);
+
+  vector<NativeScanStats> scan_stats;
+  EXPECT_TRUE(scanner_impl_->getScanStats(&scan_stats).isOk());
+  ASSERT_EQ(3u, scan_stats.size());
+  EXPECT_EQ(IWifiScannerImpl::SCAN_SOURCE_SINGLE, scan_stats[0].source_);
+  EXPECT_EQ(IWifiScannerImpl::SCAN_TYPE_DEFAULT, scan_stats[0].scan_type_);
+  EXPECT_EQ(IWifiScannerImpl::SCAN_RESULT_BAND_2G, scan_stats[0].band_);
+  EXPECT_EQ(1, scan_stats[0].num_scans_);
+  EXPECT_EQ(2, scan_stats[0].num_channels_);
+  EXPECT_EQ(3, scan_stats[0].num_bss_);
+  EXPECT_EQ(IWifiScannerImpl::SCAN_RESULT_BAND_5G, scan_stats[1].band_);
+  EXPECT_EQ(1, scan_stats[1].num_channels_);
+  EXPECT_EQ(1, scan_stats[1].num_bss_);
+  EXPECT_EQ(IWifiScannerImpl::SCAN_SOURCE_EXTERNAL, scan_stats[2].source_);
+  EXPECT_EQ(IWifiScannerImpl::SCAN_RESULT_BAND_5G, scan_stats[2].band_);
+  EXPECT_EQ(1, scan_stats[2].num_aborted_scans_);
+  EXPECT_EQ(0, scan_stats[2].num_bss_);
+}
+
+TEST_F(ScannerTest, TestNotifyExternalScanCallbacksOfExternalScans) {
+  OnScanResultsReadyHandler scan_results_handler;
+  EXPECT_CALL(scan_utils_,
+              SubscribeScanResultNotification(kFakeInterfaceIndex, _))
+      .WillOnce(SaveArg<1>(&scan_results_handler));
+  scanner_impl_.reset(new ScannerImpl(kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_,
+                                      &scan_utils_,
+                                      &event_loop_));
+  sp<NiceMock<MockIScanEvent>> callback(new NiceMock<MockIScanEvent>());
+  {
+    ScopedCallingUid calling_uid(kFakeVendorUid);
+    EXPECT_TRUE(scanner_impl_->registerExternalScanCallback(callback).isOk());
+  }
+  vector<vector<uint8_t>> ssids;
+  vector<uint32_t> frequencies;
+
+  // Results are only reported once they are in the cache.
+  EXPECT_CALL(scan_utils_, UpdateScanResultCache(kFakeInterfaceIndex))
+      .WillOnce(Return(false))
+      .WillOnce(Return(true));
+  EXPECT_CALL(*callback, OnScanResultReady()).Times(1);
+  scan_results_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+  scan_results_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+  Mock::VerifyAndClearExpectations(callback.get());
+
+  // Scans that other callers requested are not reported.
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, _, _, _)).WillOnce(Return(true));
+  bool success = false;
+  EXPECT_TRUE(scanner_impl_->scan(CreateScanSettings({}), &success).isOk());
+  EXPECT_CALL(scan_utils_, UpdateScanResultCache(_))
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(*callback, OnScanResultReady()).Times(0);
+  scan_results_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+
+  EXPECT_TRUE(scanner_impl_->unregisterExternalScanCallback(callback).isOk());
+  scan_results_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+}
+
+TEST_F(ScannerTest, TestNotifyBssWatchOfSignalChanges) {
+  OnScanResultsReadyHandler scan_results_handler;
+  EXPECT_CALL(scan_utils_,
+              SubscribeScanResultNotification(kFakeInterfaceIndex, _))
+      .WillOnce(SaveArg<1>(&scan_results_handler));
+  scanner_impl_.reset(new ScannerImpl(kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_,
+                                      &scan_utils_,
+                                      &event_loop_));
+  NativeScanResult scan_result;
+  scan_result.bssid = {{0xc0, 0xee, 0xfb, 0x12, 0x34, 0x56}};
+  scan_result.frequency = 5180;
+  scan_result.signal_mbm = -6000;
+  BssWatchSettings settings;
+  BssWatchSettings::WatchedBss bss;
+  bss.bssid.assign(scan_result.bssid.begin(), scan_result.bssid.end());
+  bss.signal_delta_mbm = 500;
+  settings.bsses.push_back(bss);
+  sp<NiceMock<MockBssWatchCallback>> callback(
+      new NiceMock<MockBssWatchCallback>());
+
+  // The watched BSS is reported right away if it is present.
+  EXPECT_CALL(scan_utils_, QueryScanResults(kFakeInterfaceIndex, _, _))
+      .WillRepeatedly(DoAll(SetArgPointee<2>(vector<NativeScanResult>{
+                                scan_result}),
+                            Return(true)));
+  EXPECT_CALL(*callback, OnWatchedBssesChanged(_)).Times(1);
+  bool success = false;
+  EXPECT_TRUE(scanner_impl_->watchBsses(settings, callback, &success).isOk());
+  EXPECT_TRUE(success);
+  Mock::VerifyAndClearExpectations(callback.get());
+
+  // Results with a signal change below the threshold are not reported.
+  vector<vector<uint8_t>> ssids;
+  vector<uint32_t> frequencies;
+  EXPECT_CALL(scan_utils_, UpdateScanResultCache(kFakeInterfaceIndex))
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(*callback, OnWatchedBssesChanged(_)).Times(0);
+  scan_results_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+  Mock::VerifyAndClearExpectations(callback.get());
+
+  scan_result.signal_mbm = -6500;
+  EXPECT_CALL(scan_utils_, QueryScanResults(kFakeInterfaceIndex, _, _))
+      .WillRepeatedly(DoAll(SetArgPointee<2>(vector<NativeScanResult>{
+                                scan_result}),
+                            Return(true)));
+  EXPECT_CALL(*callback, OnWatchedBssesChanged(_)).Times(1);
+  scan_results_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+  Mock::VerifyAndClearExpectations(callback.get());
+
+  EXPECT_TRUE(scanner_impl_->unwatchBsses(callback).isOk());
+  EXPECT_CALL(*callback, OnWatchedBssesChanged(_)).Times(0);
+  EXPECT_CALL(scan_utils_, QueryScanResults(_, _, _)).Times(0);
+  scan_results_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+}
+
+// Verify that a single scan that kernel never reports the end of is aborted
+// and reported as failed.
+TEST_F(ScannerTest, TestAbortStuckScan) {
+  OnScanResultsReadyHandler scan_results_handler;
+  EXPECT_CALL(scan_utils_,
+              SubscribeScanResultNotification(kFakeInterfaceIndex, _))
+      .WillOnce(SaveArg<1>(&scan_results_handler));
+  scanner_impl_.reset(new ScannerImpl(kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_,
+                                      &scan_utils_,
+                                      &event_loop_));
+  sp<NiceMock<MockIScanEvent>> scan_event(new NiceMock<MockIScanEvent>());
+  EXPECT_TRUE(scanner_impl_->subscribeScanEvents(scan_event).isOk());
+  vector<vector<uint8_t>> ssids;
+  vector<uint32_t> frequencies;
+
+  // The watchdog is disarmed once kernel reports the end of the scan.
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, _, _, _)).
+      WillRepeatedly(Return(true));
+  bool success = false;
+  EXPECT_TRUE(scanner_impl_->scan(CreateScanSettings({2412, 5180}),
+                                  &success).isOk());
+  EXPECT_TRUE(success);
+  EXPECT_EQ(1u, event_loop_.GetNumDelayedTasks());
+  EXPECT_CALL(*scan_event, OnScanResultReady());
+  EXPECT_CALL(*scan_event, OnScanFailed()).Times(0);
+  scan_results_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+  EXPECT_EQ(0u, event_loop_.GetNumDelayedTasks());
+  Mock::VerifyAndClearExpectations(scan_event.get());
+
+  EXPECT_TRUE(scanner_impl_->scan(CreateScanSettings({2412, 5180}),
+                                  &success).isOk());
+  EXPECT_TRUE(success);
+  ASSERT_EQ(1u, event_loop_.GetNumDelayedTasks());
+  EXPECT_CALL(scan_utils_, AbortScan(kFakeInterfaceIndex)).
+      WillOnce(Return(true));
+  EXPECT_CALL(*scan_event, OnScanFailed());
+  EXPECT_LT(0, event_loop_.RunDelayedTask());
+  Mock::VerifyAndClearExpectations(scan_event.get());
+
+  // New scans can be started again.
+  EXPECT_TRUE(scanner_impl_->scan(CreateScanSettings({2412}),
+                                  &success).isOk());
+  EXPECT_TRUE(success);
+  std::stringstream ss;
+  scanner_impl_->DumpScanStats(&ss);
+  EXPECT_NE(string::npos, ss.str().find("Stuck scans aborted: 1"));
+}
+
+// Verify that the end of an aborted stuck scan, which kernel reports late,
+// does not end the scan that was started after the abort.
+TEST_F(ScannerTest, TestIgnoreLateEndOfAbortedScan) {
+  OnScanResultsReadyHandler scan_results_handler;
+  EXPECT_CALL(scan_utils_,
+              SubscribeScanResultNotification(kFakeInterfaceIndex, _))
+      .WillOnce(SaveArg<1>(&scan_results_handler));
+  scanner_impl_.reset(new ScannerImpl(kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_,
+                                      &scan_utils_,
+                                      &event_loop_));
+  sp<NiceMock<MockIScanEvent>> scan_event(new NiceMock<MockIScanEvent>());
+  EXPECT_TRUE(scanner_impl_->subscribeScanEvents(scan_event).isOk());
+  vector<vector<uint8_t>> ssids;
+  vector<uint32_t> frequencies;
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, _, _, _)).
+      WillRepeatedly(Return(true));
+
+  bool success = false;
+  EXPECT_TRUE(scanner_impl_->scan(CreateScanSettings({2412, 5180}),
+                                  &success).isOk());
+  EXPECT_TRUE(success);
+  EXPECT_CALL(scan_utils_, AbortScan(kFakeInterfaceIndex)).
+      WillOnce(Return(true));
+  EXPECT_CALL(*scan_event, OnScanFailed());
+  ASSERT_EQ(1u, event_loop_.GetNumDelayedTasks());
+  event_loop_.RunDelayedTask();
+  Mock::VerifyAndClearExpectations(scan_event.get());
+
+  EXPECT_TRUE(scanner_impl_->scan(CreateScanSettings({2412}),
+                                  &success).isOk());
+  EXPECT_TRUE(success);
+  // Kernel reports that it aborted the first scan.
+  EXPECT_CALL(*scan_event, OnScanFailed()).Times(0);
+  EXPECT_CALL(*scan_event, OnScanResultReady()).Times(0);
+  scan_results_handler(kFakeInterfaceIndex, true, ssids, frequencies);
+  Mock::VerifyAndClearExpectations(scan_event.get());
+  EXPECT_EQ(1u, event_loop_.GetNumDelayedTasks());
+
+  // The end of the second scan is reported as usual.
+  EXPECT_CALL(*scan_event, OnScanResultReady());
+  scan_results_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+  EXPECT_EQ(0u, event_loop_.GetNumDelayedTasks());
+}
+
+// Verify that a scan request that a scan done a moment ago covers is served
+// with the results of that scan.
+TEST_F(ScannerTest, TestServeScanRequestFromRecentScan) {
+  OnScanResultsReadyHandler scan_results_handler;
+  EXPECT_CALL(scan_utils_,
+              SubscribeScanResultNotification(kFakeInterfaceIndex, _))
+      .WillOnce(SaveArg<1>(&scan_results_handler));
+  scanner_impl_.reset(new ScannerImpl(kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_,
+                                      &scan_utils_,
+                                      &event_loop_));
+  sp<NiceMock<MockIScanEvent>> scan_event(new NiceMock<MockIScanEvent>());
+  EXPECT_TRUE(scanner_impl_->subscribeScanEvents(scan_event).isOk());
+  vector<vector<uint8_t>> ssids;
+  vector<uint32_t> frequencies;
+  ON_CALL(scan_utils_, UpdateScanResultCache(_)).WillByDefault(Return(true));
+  ON_CALL(scan_utils_, HasUpToDateScanResults(_)).WillByDefault(Return(true));
+
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, _, _, _)).WillOnce(Return(true));
+  bool success = false;
+  EXPECT_TRUE(scanner_impl_->scan(CreateScanSettings({2412, 5180}),
+                                  &success).isOk());
+  EXPECT_TRUE(success);
+  scan_results_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+  Mock::VerifyAndClearExpectations(&scan_utils_);
+
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, _, _, _)).Times(0);
+  EXPECT_CALL(*scan_event, OnScanResultReady());
+  success = false;
+  EXPECT_TRUE(scanner_impl_->scan(CreateScanSettings({2412}),
+                                  &success).isOk());
+  EXPECT_TRUE(success);
+  Mock::VerifyAndClearExpectations(&scan_utils_);
+  Mock::VerifyAndClearExpectations(scan_event.get());
+
+  // Channels the recent scan did not cover are scanned.
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, _, Eq(vector<uint32_t>{2437}), _))
+      .WillOnce(Return(true));
+  EXPECT_TRUE(scanner_impl_->scan(CreateScanSettings({2437}),
+                                  &success).isOk());
+  EXPECT_TRUE(success);
+  std::stringstream ss;
+  scanner_impl_->DumpScanStats(&ss);
+  EXPECT_NE(string::npos,
+            ss.str().find("Scan requests served by a recent scan: 1"));
+}
+
+// Verify that callers other than the wifi stack are limited to a quota of
+// scans.
+TEST_F(ScannerTest, TestRejectScansOverQuota) {
+  OnScanResultsReadyHandler scan_results_handler;
+  EXPECT_CALL(scan_utils_,
+              SubscribeScanResultNotification(kFakeInterfaceIndex, _))
+      .WillOnce(SaveArg<1>(&scan_results_handler));
+  scanner_impl_.reset(new ScannerImpl(kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_,
+                                      &scan_utils_,
+                                      &event_loop_));
+  vector<vector<uint8_t>> ssids;
+  vector<uint32_t> frequencies;
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, _, _, _))
+      .Times(ScanArbiter::kDefaultMaxScansPerWindow)
+      .WillRepeatedly(Return(true));
+  bool success = false;
+  {
+    ScopedCallingUid calling_uid(kFakeVendorUid);
+    for (size_t i = 0; i < ScanArbiter::kDefaultMaxScansPerWindow; i++) {
+      EXPECT_TRUE(scanner_impl_->scan(CreateScanSettings({2412}),
+                                      &success).isOk());
+      EXPECT_TRUE(success);
+      scan_results_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+    }
+    EXPECT_TRUE(scanner_impl_->scan(CreateScanSettings({2412}),
+                                    &success).isOk());
+    EXPECT_FALSE(success);
+  }
+  Mock::VerifyAndClearExpectations(&scan_utils_);
+
+  // Other callers still have their quota.
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, _, _, _)).WillOnce(Return(true));
+  EXPECT_TRUE(scanner_impl_->scan(CreateScanSettings({2412}),
+                                  &success).isOk());
+  EXPECT_TRUE(success);
+  std::stringstream ss;
+  scanner_impl_->DumpScanStats(&ss);
+  EXPECT_NE(string::npos, ss.str().find("Scan requests over quota: 1"));
+}
+
+// Verify that the results of a scan are sent to all the callers that wait
+// for it.
+TEST_F(ScannerTest, TestNotifyAllCallersWaitingForScan) {
+  OnScanResultsReadyHandler scan_results_handler;
+  EXPECT_CALL(scan_utils_,
+              SubscribeScanResultNotification(kFakeInterfaceIndex, _))
+      .WillOnce(SaveArg<1>(&scan_results_handler));
+  scanner_impl_.reset(new ScannerImpl(kFakeInterfaceIndex,
+                                      scan_capabilities_, wiphy_features_,
+                                      &client_interface_impl_,
+                                      &scan_utils_,
+                                      &event_loop_));
+  sp<NiceMock<MockIScanEvent>> scan_event(new NiceMock<MockIScanEvent>());
+  EXPECT_TRUE(scanner_impl_->subscribeScanEvents(scan_event).isOk());
+  sp<NiceMock<MockIScanEvent>> callback(new NiceMock<MockIScanEvent>());
+  vector<vector<uint8_t>> ssids;
+  vector<uint32_t> frequencies;
+  ON_CALL(scan_utils_, UpdateScanResultCache(_)).WillByDefault(Return(true));
+
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, _, _, _)).WillOnce(Return(true));
+  bool success = false;
+  EXPECT_TRUE(scanner_impl_->scan(CreateScanSettings({2412, 5180}),
+                                  &success).isOk());
+  EXPECT_TRUE(success);
+  {
+    ScopedCallingUid calling_uid(kFakeVendorUid);
+    EXPECT_TRUE(scanner_impl_->registerExternalScanCallback(callback).isOk());
+    // The scan in flight covers this request, so no scan of its own is
+    // triggered.
+    EXPECT_TRUE(scanner_impl_->scan(CreateScanSettings({5180}),
+                                    &success).isOk());
+    EXPECT_TRUE(success);
+  }
+  EXPECT_CALL(*scan_event, OnScanResultReady());
+  EXPECT_CALL(*callback, OnScanResultReady());
+  scan_results_handler(kFakeInterfaceIndex, false, ssids, frequencies);
+  Mock::VerifyAndClearExpectations(scan_event.get());
+  Mock::VerifyAndClearExpectations(callback.get());
+
+  // Callers waiting for an aborted scan are told that it failed.
+  EXPECT_CALL(scan_utils_, Scan(_, _, _, _, _, _)).WillOnce(Return(true));
+  {
+    ScopedCallingUid calling_uid(kFakeVendorUid);
+    EXPECT_TRUE(scanner_impl_->scan(CreateScanSettings({2437}),
+                                    &success).isOk());
+    EXPECT_TRUE(success);
+  }
+  EXPECT_CALL(*scan_event, OnScanFailed());
+  EXPECT_CALL(*callback, OnScanFailed());
+  scan_results_handler(kFakeInterfaceIndex, true, ssids, frequencies);
+}
+
 }  // namespace wificond
 }  // namespace android
@@ -22,22 +22,32 @@
 #include <wifi_system_test/mock_interface_tool.h>
 
 #include "android/net/wifi/nl80211/IApInterface.h"
+#include "wificond/looper_backed_event_loop.h"
+#include "wificond/net/kernel-header-latest/nl80211.h"
 #include "wificond/tests/mock_netlink_manager.h"
 #include "wificond/tests/mock_netlink_utils.h"
+#include "wificond/tests/mock_nl80211_command_callback.h"
 #include "wificond/tests/mock_scan_utils.h"
 #include "wificond/server.h"
 
+using android::net::wifi::nl80211::DeviceWiphyInfo;
 using android::net::wifi::nl80211::IApInterface;
 using android::net::wifi::nl80211::IClientInterface;
+using android::net::wifi::nl80211::IWificond;
 using android::wifi_system::InterfaceTool;
 using android::wifi_system::MockInterfaceTool;
+using std::string;
 using std::unique_ptr;
 using std::vector;
 using testing::Eq;
+using testing::DoAll;
 using testing::Invoke;
+using testing::Mock;
 using testing::NiceMock;
 using testing::Return;
+using testing::SaveArg;
 using testing::Sequence;
+using testing::SetArgPointee;
 using testing::StrEq;
 using testing::_;
 
@@ -53,7 +63,7 @@ const char kFakeInterfaceNameP2p[] = "testif-p2p0";
 const char kFateInterfaceNameInvalid[] = "testif-invalid";
 const uint32_t kFakeInterfaceIndex = 34;
 const uint32_t kFakeInterfaceIndex1 = 36;
-const uint32_t kFakeInterfaceIndexP2p = 36;
+const uint32_t kFakeInterfaceIndexP2p = 38;
 const std::array<uint8_t, ETH_ALEN> kFakeInterfaceMacAddress = {0x45, 0x54, 0xad, 0x67, 0x98, 0xf6};
 const std::array<uint8_t, ETH_ALEN> kFakeInterfaceMacAddress1 = {0x05, 0x04, 0xef, 0x27, 0x12, 0xff};
 const std::array<uint8_t, ETH_ALEN> kFakeInterfaceMacAddressP2p = {0x15, 0x24, 0xef, 0x27, 0x12, 0xff};
@@ -87,6 +97,7 @@ class ServerTest : public ::testing::Test {
   }
 
   NiceMock<MockInterfaceTool>* if_tool_ = new NiceMock<MockInterfaceTool>;
+  LooperBackedEventLoop event_loop_;
 
   unique_ptr<NiceMock<MockNetlinkManager>> netlink_manager_{
       new NiceMock<MockNetlinkManager>()};
@@ -114,6 +125,7 @@ class ServerTest : public ::testing::Test {
   };
 
   Server server_{unique_ptr<InterfaceTool>(if_tool_),
+                 &event_loop_,
                  netlink_utils_.get(),
                  scan_utils_.get()};
 };  // class ServerTest
@@ -233,5 +245,276 @@ TEST_F(ServerTest, CanDestroyApAndClientInterfaces) {
 
   EXPECT_TRUE(server_.tearDownInterfaces().isOk());
 }
+
+TEST_F(ServerTest, TracksInterfacesFromInterfaceEvents) {
+  OnInterfaceEventHandler interface_handler;
+  EXPECT_CALL(*netlink_utils_, SubscribeInterfaceEvent(_, _))
+      .WillOnce(SaveArg<1>(&interface_handler));
+  // Interfaces are only dumped for the first setup.
+  EXPECT_CALL(*netlink_utils_, GetInterfaces(_, _))
+      .WillOnce(Invoke(bind(
+          MockGetInterfacesResponse, mock_interfaces, true, _1, _2)));
+  sp<IApInterface> ap_if;
+  EXPECT_TRUE(server_.createApInterface(kFakeInterfaceName1, &ap_if).isOk());
+  EXPECT_NE(nullptr, ap_if.get());
+  EXPECT_TRUE(server_.tearDownInterfaces().isOk());
+
+  const char kFakeNewInterfaceName[] = "testif-new";
+  interface_handler(NEW_INTERFACE, 40, kFakeNewInterfaceName,
+                    kFakeInterfaceMacAddress);
+  interface_handler(DEL_INTERFACE, kFakeInterfaceIndex1, kFakeInterfaceName1,
+                    kFakeInterfaceMacAddress1);
+
+  sp<IClientInterface> client_if;
+  EXPECT_TRUE(server_.createClientInterface(
+      kFakeNewInterfaceName, &client_if).isOk());
+  EXPECT_NE(nullptr, client_if.get());
+  EXPECT_CALL(*if_tool_, SetUpState(StrEq(kFakeNewInterfaceName), Eq(false)))
+      .Times(2);
+  EXPECT_CALL(*if_tool_, SetUpState(StrEq(kFakeInterfaceName1), Eq(false)))
+      .Times(0);
+  EXPECT_TRUE(server_.tearDownInterfaces().isOk());
+}
+
+TEST_F(ServerTest, TracksInterfacesOfEachWiphy) {
+  constexpr uint32_t kFakeWiphyIndex1 = 1;
+  ON_CALL(*netlink_utils_, GetWiphyIndex(_, StrEq(kFakeInterfaceName1)))
+      .WillByDefault(DoAll(SetArgPointee<0>(kFakeWiphyIndex1), Return(true)));
+  // Each wiphy is subscribed to once.
+  EXPECT_CALL(*netlink_utils_, SubscribeInterfaceEvent(0, _));
+  EXPECT_CALL(*netlink_utils_, SubscribeInterfaceEvent(kFakeWiphyIndex1, _));
+  EXPECT_CALL(*netlink_utils_, SubscribeRegDomainChange(0, _));
+  EXPECT_CALL(*netlink_utils_, SubscribeRegDomainChange(kFakeWiphyIndex1, _));
+  // The scanners of client interfaces on different wiphys are peers.
+  EXPECT_CALL(*scan_utils_, SetPeerRadioInterfaces(_, _))
+      .Times(testing::AnyNumber());
+  EXPECT_CALL(*scan_utils_,
+              SetPeerRadioInterfaces(kFakeInterfaceIndex,
+                                     vector<uint32_t>{kFakeInterfaceIndex1}));
+  EXPECT_CALL(*scan_utils_,
+              SetPeerRadioInterfaces(kFakeInterfaceIndex1,
+                                     vector<uint32_t>{kFakeInterfaceIndex}));
+
+  sp<IClientInterface> client_if;
+  EXPECT_TRUE(server_.createClientInterface(
+      kFakeInterfaceName, &client_if).isOk());
+  EXPECT_NE(nullptr, client_if.get());
+  sp<IClientInterface> client_if1;
+  EXPECT_TRUE(server_.createClientInterface(
+      kFakeInterfaceName1, &client_if1).isOk());
+  EXPECT_NE(nullptr, client_if1.get());
+  // Setting up another interface of a tracked wiphy subscribes to nothing.
+  sp<IApInterface> ap_if;
+  EXPECT_TRUE(server_.createApInterface(kFakeInterfaceNameP2p, &ap_if).isOk());
+  EXPECT_NE(nullptr, ap_if.get());
+
+  EXPECT_CALL(*netlink_utils_, UnsubscribeRegDomainChange(0));
+  EXPECT_CALL(*netlink_utils_, UnsubscribeRegDomainChange(kFakeWiphyIndex1));
+  EXPECT_TRUE(server_.tearDownInterfaces().isOk());
+}
+
+TEST_F(ServerTest, CachesWiphyInfoAcrossChannelQueries) {
+  sp<IApInterface> ap_if;
+  // Wiphy info is dumped once when the interface is set up.
+  EXPECT_CALL(*netlink_utils_, GetWiphyInfo(_, _, _, _))
+      .WillOnce(Return(true));
+  EXPECT_TRUE(server_.createApInterface(kFakeInterfaceName, &ap_if).isOk());
+
+  unique_ptr<vector<int32_t>> frequencies;
+  EXPECT_TRUE(server_.getAvailable2gChannels(&frequencies).isOk());
+  EXPECT_NE(nullptr, frequencies);
+  EXPECT_TRUE(server_.getAvailable5gNonDFSChannels(&frequencies).isOk());
+  EXPECT_NE(nullptr, frequencies);
+  EXPECT_TRUE(server_.getAvailableDFSChannels(&frequencies).isOk());
+  EXPECT_NE(nullptr, frequencies);
+  EXPECT_TRUE(server_.getAvailable6gChannels(&frequencies).isOk());
+  EXPECT_NE(nullptr, frequencies);
+}
+
+TEST_F(ServerTest, InvalidatesWiphyInfoCacheOnTeardown) {
+  sp<IApInterface> ap_if;
+  EXPECT_CALL(*netlink_utils_, GetWiphyInfo(_, _, _, _))
+      .Times(2)
+      .WillRepeatedly(Return(true));
+  EXPECT_TRUE(server_.createApInterface(kFakeInterfaceName, &ap_if).isOk());
+
+  bool success = false;
+  EXPECT_TRUE(server_.tearDownApInterface(kFakeInterfaceName, &success).isOk());
+  EXPECT_TRUE(success);
+
+  unique_ptr<vector<int32_t>> frequencies;
+  EXPECT_TRUE(server_.getAvailable2gChannels(&frequencies).isOk());
+  EXPECT_NE(nullptr, frequencies);
+}
+
+TEST_F(ServerTest, TrimsCachesOnlyUnderCriticalMemoryPressure) {
+  sp<IApInterface> ap_if;
+  EXPECT_CALL(*netlink_utils_, GetWiphyInfo(_, _, _, _))
+      .Times(2)
+      .WillRepeatedly(Return(true));
+  EXPECT_TRUE(server_.createApInterface(kFakeInterfaceName, &ap_if).isOk());
+
+  // Moderate pressure within budget leaves everything alone.
+  EXPECT_CALL(*netlink_utils_, TrimMemory()).Times(0);
+  EXPECT_CALL(*scan_utils_, TrimScanResultCache()).Times(0);
+  EXPECT_TRUE(server_.onTrimMemory(
+      IWificond::TRIM_MEMORY_RUNNING_MODERATE).isOk());
+  Mock::VerifyAndClearExpectations(netlink_utils_.get());
+  Mock::VerifyAndClearExpectations(scan_utils_.get());
+
+  // Low memory only releases netlink buffers.
+  EXPECT_CALL(*netlink_utils_, TrimMemory());
+  EXPECT_CALL(*scan_utils_, TrimScanResultCache()).Times(0);
+  EXPECT_TRUE(server_.onTrimMemory(IWificond::TRIM_MEMORY_RUNNING_LOW).isOk());
+  Mock::VerifyAndClearExpectations(netlink_utils_.get());
+  Mock::VerifyAndClearExpectations(scan_utils_.get());
+
+  // Critical memory drops the caches, so that wiphy info is dumped again.
+  EXPECT_CALL(*netlink_utils_, TrimMemory());
+  EXPECT_CALL(*scan_utils_, TrimScanResultCache());
+  EXPECT_TRUE(server_.onTrimMemory(
+      IWificond::TRIM_MEMORY_RUNNING_CRITICAL).isOk());
+  EXPECT_CALL(*netlink_utils_, GetWiphyInfo(_, _, _, _))
+      .WillOnce(Return(true));
+  unique_ptr<vector<int32_t>> frequencies;
+  EXPECT_TRUE(server_.getAvailable2gChannels(&frequencies).isOk());
+  EXPECT_NE(nullptr, frequencies);
+}
+
+TEST_F(ServerTest, TrimsCachesUnderAnyMemoryPressureOverBudget) {
+  sp<IApInterface> ap_if;
+  EXPECT_CALL(*netlink_utils_, GetWiphyInfo(_, _, _, _))
+      .WillOnce(Return(true));
+  EXPECT_TRUE(server_.createApInterface(kFakeInterfaceName, &ap_if).isOk());
+  // Any cached wiphy info is over this budget.
+  server_.SetMemoryBudget(1);
+
+  EXPECT_CALL(*netlink_utils_, TrimMemory());
+  EXPECT_CALL(*scan_utils_, TrimScanResultCache());
+  EXPECT_TRUE(server_.onTrimMemory(
+      IWificond::TRIM_MEMORY_RUNNING_MODERATE).isOk());
+}
+
+TEST_F(ServerTest, RecomputesChannelsOnRegDomainChange) {
+  OnRegDomainChangedHandler reg_domain_handler;
+  EXPECT_CALL(*netlink_utils_, SubscribeRegDomainChange(_, _))
+      .WillOnce(SaveArg<1>(&reg_domain_handler));
+  BandInfo band_info;
+  band_info.band_2g = {2412, 2437};
+  band_info.band_5g = {5180, 5260};
+  // Wiphy info is only dumped when the interface is set up.
+  EXPECT_CALL(*netlink_utils_, GetWiphyInfo(_, _, _, _))
+      .WillOnce(DoAll(SetArgPointee<1>(band_info), Return(true)));
+  sp<IApInterface> ap_if;
+  EXPECT_TRUE(server_.createApInterface(kFakeInterfaceName, &ap_if).isOk());
+
+  // The new regulatory domain drops channel 6 and requires DFS on channel
+  // 52.
+  RegDomain reg_domain;
+  reg_domain.country_code = "FR";
+  reg_domain.rules = {{2402000, 2422000, 20000, 0},
+                      {5170000, 5250000, 80000, 0},
+                      {5250000, 5330000, 80000, NL80211_RRF_DFS}};
+  EXPECT_CALL(*netlink_utils_, GetRegDomain(_))
+      .WillOnce(DoAll(SetArgPointee<0>(reg_domain), Return(true)));
+  string country_code = "FR";
+  reg_domain_handler(country_code);
+
+  unique_ptr<vector<int32_t>> frequencies;
+  EXPECT_TRUE(server_.getAvailable2gChannels(&frequencies).isOk());
+  EXPECT_EQ(vector<int32_t>({2412}), *frequencies);
+  EXPECT_TRUE(server_.getAvailable5gNonDFSChannels(&frequencies).isOk());
+  EXPECT_EQ(vector<int32_t>({5180}), *frequencies);
+  EXPECT_TRUE(server_.getAvailableDFSChannels(&frequencies).isOk());
+  EXPECT_EQ(vector<int32_t>({5260}), *frequencies);
+}
+
+TEST_F(ServerTest, DumpsWiphyAgainIfRegDomainEnablesChannels) {
+  OnRegDomainChangedHandler reg_domain_handler;
+  EXPECT_CALL(*netlink_utils_, SubscribeRegDomainChange(_, _))
+      .WillOnce(SaveArg<1>(&reg_domain_handler));
+  BandInfo band_info;
+  band_info.band_5g = {5180};
+  band_info.band_disabled = {5260};
+  BandInfo new_band_info;
+  new_band_info.band_5g = {5180};
+  new_band_info.band_dfs = {5260};
+  EXPECT_CALL(*netlink_utils_, GetWiphyInfo(_, _, _, _))
+      .WillOnce(DoAll(SetArgPointee<1>(band_info), Return(true)))
+      .WillOnce(DoAll(SetArgPointee<1>(new_band_info), Return(true)));
+  sp<IApInterface> ap_if;
+  EXPECT_TRUE(server_.createApInterface(kFakeInterfaceName, &ap_if).isOk());
+
+  // Only a new dump tells whether the driver enables channel 52 now.
+  RegDomain reg_domain;
+  reg_domain.country_code = "FR";
+  reg_domain.rules = {{5170000, 5250000, 80000, 0},
+                      {5250000, 5330000, 80000, NL80211_RRF_DFS}};
+  EXPECT_CALL(*netlink_utils_, GetRegDomain(_))
+      .WillOnce(DoAll(SetArgPointee<0>(reg_domain), Return(true)));
+  string country_code = "FR";
+  reg_domain_handler(country_code);
+
+  unique_ptr<vector<int32_t>> frequencies;
+  EXPECT_TRUE(server_.getAvailableDFSChannels(&frequencies).isOk());
+  EXPECT_EQ(vector<int32_t>({5260}), *frequencies);
+}
+
+TEST_F(ServerTest, CanGetDeviceWiphyInfoInOneCall) {
+  BandInfo band_info;
+  band_info.band_2g = {2412, 2437};
+  band_info.band_5g = {5180};
+  band_info.band_dfs = {5260, 5280};
+  band_info.band_6g = {5955};
+  band_info.is_80211ac_supported = true;
+  band_info.max_tx_streams = 2;
+  EXPECT_CALL(*netlink_utils_, GetWiphyInfo(_, _, _, _))
+      .WillOnce(DoAll(SetArgPointee<1>(band_info), Return(true)));
+
+  unique_ptr<DeviceWiphyInfo> wiphy_info;
+  EXPECT_TRUE(
+      server_.getDeviceWiphyInfo(kFakeInterfaceName, &wiphy_info).isOk());
+  ASSERT_NE(nullptr, wiphy_info);
+  EXPECT_EQ(vector<int32_t>({2412, 2437}), wiphy_info->band2gChannels_);
+  EXPECT_EQ(vector<int32_t>({5180}), wiphy_info->band5gNonDfsChannels_);
+  EXPECT_EQ(vector<int32_t>({5260, 5280}), wiphy_info->bandDfsChannels_);
+  EXPECT_EQ(vector<int32_t>({5955}), wiphy_info->band6gChannels_);
+  EXPECT_TRUE(wiphy_info->capabilities_.is80211acSupported_);
+  EXPECT_FALSE(wiphy_info->capabilities_.is80211axSupported_);
+  EXPECT_EQ(2u, wiphy_info->capabilities_.maxTxStreams_);
+}
+
+TEST_F(ServerTest, CanRelayNl80211CommandOfInterface) {
+  const vector<uint8_t> replies = {0x01, 0x02, 0x03, 0x04};
+  OnCommandRepliesHandler handler;
+  EXPECT_CALL(*netlink_utils_,
+              SendCommandAsync(kFakeInterfaceIndex, NL80211_CMD_GET_STATION,
+                               NLM_F_DUMP, _, _))
+      .WillOnce(DoAll(SaveArg<4>(&handler), Return(true)));
+  sp<NiceMock<MockNl80211CommandCallback>> callback(
+      new NiceMock<MockNl80211CommandCallback>());
+
+  bool success = false;
+  EXPECT_TRUE(server_.sendNl80211Command(
+      kFakeInterfaceName, NL80211_CMD_GET_STATION,
+      IWificond::NL80211_COMMAND_FLAG_DUMP, vector<uint8_t>(), callback,
+      &success).isOk());
+  EXPECT_TRUE(success);
+  ASSERT_TRUE(handler);
+
+  EXPECT_CALL(*callback, OnCommandCompleted(true, Eq(replies)));
+  handler(true, replies);
+
+  // Commands with side effects and unknown interfaces are refused.
+  EXPECT_TRUE(server_.sendNl80211Command(
+      kFakeInterfaceName, NL80211_CMD_DEL_INTERFACE, 0, vector<uint8_t>(),
+      callback, &success).isOk());
+  EXPECT_FALSE(success);
+  EXPECT_TRUE(server_.sendNl80211Command(
+      kFateInterfaceNameInvalid, NL80211_CMD_GET_STATION, 0,
+      vector<uint8_t>(), callback, &success).isOk());
+  EXPECT_FALSE(success);
+}
+
 }  // namespace wificond
 }  // namespace android
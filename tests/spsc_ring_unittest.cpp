@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "wificond/net/spsc_ring.h"
+
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+TEST(SpscRingTest, RoundsUpCapacityAndStopsWhenFull) {
+  SpscRing<int> ring(3);
+  EXPECT_EQ(4u, ring.capacity());
+  EXPECT_EQ(nullptr, ring.Front());
+  for (int i = 0; i < 4; i++) {
+    int* slot = ring.BeginPush();
+    ASSERT_NE(nullptr, slot);
+    *slot = i;
+    ring.CommitPush();
+  }
+  EXPECT_EQ(nullptr, ring.BeginPush());
+
+  ASSERT_NE(nullptr, ring.Front());
+  EXPECT_EQ(0, *ring.Front());
+  ring.Pop();
+  EXPECT_NE(nullptr, ring.BeginPush());
+}
+
+TEST(SpscRingTest, SlotsKeepTheirBuffers) {
+  SpscRing<vector<int>> ring(1);
+  ring.BeginPush()->assign(100, 1);
+  ring.CommitPush();
+  ring.Pop();
+  EXPECT_GE(ring.BeginPush()->capacity(), 100u);
+}
+
+TEST(SpscRingTest, HandsOverElementsBetweenThreadsInOrder) {
+  constexpr int kNumElements = 100000;
+  SpscRing<int> ring(64);
+  std::thread producer([&ring]() {
+    for (int i = 0; i < kNumElements; i++) {
+      int* slot;
+      while ((slot = ring.BeginPush()) == nullptr) {
+        std::this_thread::yield();
+      }
+      *slot = i;
+      ring.CommitPush();
+    }
+  });
+  for (int i = 0; i < kNumElements; i++) {
+    int* element;
+    while ((element = ring.Front()) == nullptr) {
+      std::this_thread::yield();
+    }
+    ASSERT_EQ(i, *element);
+    ring.Pop();
+  }
+  producer.join();
+}
+
+}  // namespace wificond
+}  // namespace android
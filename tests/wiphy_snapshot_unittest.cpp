@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/test_utils.h>
+#include <gtest/gtest.h>
+
+#include "wificond/net/wiphy_snapshot.h"
+
+using std::string;
+using std::vector;
+
+namespace android {
+namespace wificond {
+
+namespace {
+
+const char kFakeDeviceKey[] = "phy0 fakedriver 4.19 1.2.3 0000:01:00.0";
+const char kFakeDeviceKey1[] = "phy0 fakedriver 4.19 1.2.4 0000:01:00.0";
+
+WiphyInfo CreateWiphyInfo() {
+  WiphyInfo wiphy_info;
+  wiphy_info.band_info.band_2g = {2412, 2437};
+  wiphy_info.band_info.band_5g = {5180};
+  wiphy_info.band_info.band_dfs = {5260};
+  wiphy_info.band_info.band_disabled = {5845};
+  wiphy_info.band_info.is_80211ac_supported = true;
+  wiphy_info.band_info.max_tx_streams = 2;
+  wiphy_info.scan_capabilities = ScanCapabilities(10, 16, 8, 2, 3600, 10);
+  wiphy_info.wiphy_features.supports_random_mac_oneshot_scan = true;
+  wiphy_info.wiphy_features.supports_ext_sched_scan_relative_rssi = false;
+  return wiphy_info;
+}
+
+}  // namespace
+
+TEST(WiphySnapshotTest, OnlyServesSnapshotOfSameDevice) {
+  WiphySnapshot wiphy_snapshot;
+  EXPECT_EQ(nullptr, wiphy_snapshot.Get(kFakeDeviceKey));
+
+  wiphy_snapshot.Put(kFakeDeviceKey, CreateWiphyInfo());
+  const WiphyInfo* wiphy_info = wiphy_snapshot.Get(kFakeDeviceKey);
+  ASSERT_NE(nullptr, wiphy_info);
+  EXPECT_EQ(vector<uint32_t>({2412, 2437}), wiphy_info->band_info.band_2g);
+  // The firmware was updated.
+  EXPECT_EQ(nullptr, wiphy_snapshot.Get(kFakeDeviceKey1));
+}
+
+TEST(WiphySnapshotTest, PersistsInFile) {
+  TemporaryFile snapshot_file;
+  {
+    WiphySnapshot wiphy_snapshot;
+    ASSERT_TRUE(wiphy_snapshot.Open(snapshot_file.path));
+    wiphy_snapshot.Put(kFakeDeviceKey, CreateWiphyInfo());
+  }
+  WiphySnapshot wiphy_snapshot;
+  ASSERT_TRUE(wiphy_snapshot.Open(snapshot_file.path));
+  const WiphyInfo* wiphy_info = wiphy_snapshot.Get(kFakeDeviceKey);
+  ASSERT_NE(nullptr, wiphy_info);
+  const WiphyInfo expected = CreateWiphyInfo();
+  EXPECT_EQ(expected.band_info.band_2g, wiphy_info->band_info.band_2g);
+  EXPECT_EQ(expected.band_info.band_5g, wiphy_info->band_info.band_5g);
+  EXPECT_EQ(expected.band_info.band_dfs, wiphy_info->band_info.band_dfs);
+  EXPECT_EQ(expected.band_info.band_6g, wiphy_info->band_info.band_6g);
+  EXPECT_EQ(expected.band_info.band_disabled,
+            wiphy_info->band_info.band_disabled);
+  EXPECT_TRUE(wiphy_info->band_info.is_80211ac_supported);
+  EXPECT_FALSE(wiphy_info->band_info.is_80211ax_supported);
+  EXPECT_EQ(2u, wiphy_info->band_info.max_tx_streams);
+  EXPECT_EQ(16u, wiphy_info->scan_capabilities.max_num_sched_scan_ssids);
+  EXPECT_EQ(3600u, wiphy_info->scan_capabilities.max_scan_plan_interval);
+  EXPECT_TRUE(wiphy_info->wiphy_features.supports_random_mac_oneshot_scan);
+  EXPECT_FALSE(wiphy_info->wiphy_features.supports_random_mac_sched_scan);
+}
+
+TEST(WiphySnapshotTest, DiscardsFileOfUnknownLayout) {
+  TemporaryFile snapshot_file;
+  ASSERT_TRUE(android::base::WriteStringToFile(string(64, 'x'),
+                                               snapshot_file.path));
+  WiphySnapshot wiphy_snapshot;
+  ASSERT_TRUE(wiphy_snapshot.Open(snapshot_file.path));
+  EXPECT_EQ(nullptr, wiphy_snapshot.Get(kFakeDeviceKey));
+}
+
+}  // namespace wificond
+}  // namespace android
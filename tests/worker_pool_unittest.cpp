@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "wificond/worker_pool.h"
+
+using std::mutex;
+using std::unique_lock;
+
+namespace android {
+namespace wificond {
+
+TEST(WorkerPoolTest, RunsAllTasks) {
+  constexpr int kNumTasks = 100;
+  mutex lock;
+  std::condition_variable done;
+  int num_done = 0;
+  {
+    WorkerPool pool(4);
+    EXPECT_EQ(4u, pool.GetNumThreads());
+    for (int i = 0; i < kNumTasks; i++) {
+      pool.PostTask([&]() {
+        std::lock_guard<mutex> guard(lock);
+        num_done++;
+        done.notify_one();
+      });
+    }
+    unique_lock<mutex> guard(lock);
+    done.wait(guard, [&]() { return num_done == kNumTasks; });
+  }
+  EXPECT_EQ(kNumTasks, num_done);
+}
+
+TEST(WorkerPoolTest, RunsTasksOffTheCallingThread) {
+  mutex lock;
+  std::condition_variable done;
+  bool has_run = false;
+  std::thread::id task_thread;
+  WorkerPool pool(1);
+  pool.PostTask([&]() {
+    std::lock_guard<mutex> guard(lock);
+    task_thread = std::this_thread::get_id();
+    has_run = true;
+    done.notify_one();
+  });
+  unique_lock<mutex> guard(lock);
+  done.wait(guard, [&]() { return has_run; });
+  EXPECT_NE(std::this_thread::get_id(), task_thread);
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -17,34 +17,146 @@
 #include <unistd.h>
 #include <sys/capability.h>
 
+#include <mutex>
+#include <string>
+#include <vector>
+
 #include <android-base/logging.h>
 #include <android-base/macros.h>
 #include <android/hidl/manager/1.2/IServiceManager.h>
 #include <android/system/wifi/keystore/1.0/IKeystore.h>
+#include <binder/IServiceManager.h>
 #include <hidl/HidlTransportSupport.h>
 
 #include <wifikeystorehal/keystore.h>
 
+#include "wificond/keystore_blob_cache.h"
 #include "wifi_keystore_hal_connector.h"
 
 using android::hardware::configureRpcThreadpool;
+using android::hardware::hidl_string;
+using android::hardware::hidl_vec;
+using android::hardware::Return;
 using android::system::wifi::keystore::V1_0::IKeystore;
 using android::system::wifi::keystore::V1_0::implementation::Keystore;
+using std::lock_guard;
+using std::mutex;
+using std::string;
+using std::vector;
 
 namespace android {
 namespace wificond {
 
-void WifiKeystoreHalConnector::start() {
+namespace {
+
+// Service that the wifi keystore HAL looks blobs up from.
+const char kKeystoreServiceName[] = "android.security.keystore";
+
+// Serves certificates and public keys from KeystoreBlobCache, and forwards
+// everything else to |keystore_|.
+// Cached blobs are dropped when keystore dies, since it may come back with
+// other blobs, e.g. after the credential storage was reset.
+class CachingKeystore : public IKeystore, public IBinder::DeathRecipient {
+ public:
+  explicit CachingKeystore(const sp<IKeystore>& keystore)
+      : keystore_(keystore) {}
+
+  Return<void> getBlob(const hidl_string& key, getBlob_cb hidl_cb) override {
+    vector<uint8_t> blob;
+    if (blob_cache_.Get(key, &blob)) {
+      hidl_cb(KeystoreStatusCode::SUCCESS, blob);
+      return Return<void>();
+    }
+    WatchKeystore();
+    return keystore_->getBlob(
+        key,
+        [this, &key, &hidl_cb](KeystoreStatusCode status,
+                               const hidl_vec<uint8_t>& value) {
+          if (status == KeystoreStatusCode::SUCCESS) {
+            blob_cache_.Put(key, value);
+          }
+          hidl_cb(status, value);
+        });
+  }
+
+  Return<void> getPublicKey(const hidl_string& key_id,
+                            getPublicKey_cb hidl_cb) override {
+    vector<uint8_t> public_key;
+    if (public_key_cache_.Get(key_id, &public_key)) {
+      hidl_cb(KeystoreStatusCode::SUCCESS, public_key);
+      return Return<void>();
+    }
+    WatchKeystore();
+    return keystore_->getPublicKey(
+        key_id,
+        [this, &key_id, &hidl_cb](KeystoreStatusCode status,
+                                  const hidl_vec<uint8_t>& value) {
+          if (status == KeystoreStatusCode::SUCCESS) {
+            public_key_cache_.Put(key_id, value);
+          }
+          hidl_cb(status, value);
+        });
+  }
+
+  // Signing uses the private key, so it always goes through keystore.
+  Return<void> sign(const hidl_string& key_id,
+                    const hidl_vec<uint8_t>& data_to_sign,
+                    sign_cb hidl_cb) override {
+    return keystore_->sign(key_id, data_to_sign, hidl_cb);
+  }
+
+  void binderDied(const wp<IBinder>& who) override {
+    LOG(INFO) << "Keystore died, dropping cached keystore blobs";
+    {
+      lock_guard<mutex> lock(keystore_binder_mutex_);
+      keystore_binder_.clear();
+    }
+    blob_cache_.Invalidate();
+    public_key_cache_.Invalidate();
+  }
+
+ private:
+  // Makes sure that binderDied() is called when the current keystore
+  // instance dies. Blobs cached before this is called are from the same
+  // instance, since they are only cached after a lookup that called this.
+  void WatchKeystore() {
+    lock_guard<mutex> lock(keystore_binder_mutex_);
+    if (keystore_binder_ != nullptr) {
+      return;
+    }
+    sp<IBinder> binder = defaultServiceManager()->checkService(
+        String16(kKeystoreServiceName));
+    if (binder == nullptr) {
+      return;
+    }
+    if (binder->linkToDeath(this) != OK) {
+      LOG(WARNING) << "Failed to watch keystore, blobs are cached until they "
+                   << "expire";
+      return;
+    }
+    keystore_binder_ = binder;
+  }
+
+  const sp<IKeystore> keystore_;
+  KeystoreBlobCache blob_cache_;
+  KeystoreBlobCache public_key_cache_;
+  mutex keystore_binder_mutex_;
+  sp<IBinder> keystore_binder_;
+};
+
+}  // namespace
+
+void WifiKeystoreHalConnector::start(size_t num_threads) {
   /**
    * Register the wifi keystore HAL service to run in passthrough mode.
-   * This will spawn off a new thread which will service the HIDL
+   * This will spawn off new threads which will service the HIDL
    * transactions.
    */
-  configureRpcThreadpool(1, false /* callerWillJoin */);
-  android::sp<IKeystore> wifiKeystoreHalService = new Keystore();
+  configureRpcThreadpool(num_threads, false /* callerWillJoin */);
+  android::sp<IKeystore> wifiKeystoreHalService =
+      new CachingKeystore(new Keystore());
   android::status_t err = wifiKeystoreHalService->registerAsService();
   CHECK(err == android::OK) << "Cannot register wifi keystore HAL service: " << err;
 }
 }  // namespace wificond
 }  // namespace android
-
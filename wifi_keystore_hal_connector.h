@@ -17,16 +17,27 @@
 #ifndef WIFICOND_WIFI_KEYSTORE_HAL_CONNECTOR_H_
 #define WIFICOND_WIFI_KEYSTORE_HAL_CONNECTOR_H_
 
+#include <stddef.h>
+
+#include <android-base/macros.h>
+
 namespace android {
 namespace wificond {
 
 // Class for loading the wifi keystore HAL service.
+// Public blobs, i.e. certificates and public keys, are served from a short
+// lived cache, so that enterprise networks that reconnect at the same time
+// don't each go through keystore for the same certificates.
 class WifiKeystoreHalConnector {
  public:
+  static constexpr size_t kDefaultNumThreads = 1;
+
   WifiKeystoreHalConnector() = default;
   ~WifiKeystoreHalConnector() = default;
 
-  void start();
+  // Registers the service, which serves lookups of wpa_supplicant on
+  // |num_threads| HIDL threads.
+  void start(size_t num_threads = kDefaultNumThreads);
 
   DISALLOW_COPY_AND_ASSIGN(WifiKeystoreHalConnector);
 };
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wificond/worker_pool.h"
+
+#include <algorithm>
+#include <utility>
+
+using std::function;
+using std::lock_guard;
+using std::mutex;
+using std::unique_lock;
+
+namespace android {
+namespace wificond {
+
+WorkerPool::WorkerPool(size_t num_threads)
+    : stopping_(false) {
+  num_threads = std::max<size_t>(num_threads, 1);
+  for (size_t i = 0; i < num_threads; i++) {
+    threads_.emplace_back(&WorkerPool::RunTasks, this);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    lock_guard<mutex> lock(mutex_);
+    stopping_ = true;
+    tasks_.clear();
+  }
+  task_posted_.notify_all();
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+}
+
+void WorkerPool::PostTask(const function<void()>& task) {
+  {
+    lock_guard<mutex> lock(mutex_);
+    tasks_.push_back(task);
+  }
+  task_posted_.notify_one();
+}
+
+void WorkerPool::RunTasks() {
+  while (true) {
+    function<void()> task;
+    {
+      unique_lock<mutex> lock(mutex_);
+      task_posted_.wait(lock, [this]() {
+        return stopping_ || !tasks_.empty();
+      });
+      if (stopping_) {
+        return;
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
+
+}  // namespace wificond
+}  // namespace android
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFICOND_WORKER_POOL_H_
+#define WIFICOND_WORKER_POOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <android-base/macros.h>
+
+namespace android {
+namespace wificond {
+
+// WorkerPool runs tasks on threads of its own, for CPU bound work that would
+// otherwise hold up the event loop thread. Tasks may run in any order and
+// at the same time, so they must not touch state of the event loop thread
+// that is not handed to them. Tasks that have not started are dropped when
+// the pool is destroyed, which waits for the running ones.
+class WorkerPool {
+ public:
+  // Starts |num_threads| worker threads, at least one.
+  explicit WorkerPool(size_t num_threads);
+  ~WorkerPool();
+
+  void PostTask(const std::function<void()>& task);
+  size_t GetNumThreads() const { return threads_.size(); }
+
+ private:
+  void RunTasks();
+
+  std::mutex mutex_;
+  std::condition_variable task_posted_;
+  std::deque<std::function<void()>> tasks_;
+  bool stopping_;
+  std::vector<std::thread> threads_;
+
+  DISALLOW_COPY_AND_ASSIGN(WorkerPool);
+};
+
+}  // namespace wificond
+}  // namespace android
+
+#endif  // WIFICOND_WORKER_POOL_H_